@@ -75,6 +75,8 @@ char  *cfs_curproc_comm(void);
 
 /* check if task is running in compat mode.*/
 int cfs_curproc_is_32bit(void);
+
+int cfs_get_environ(const char *key, char *value, int value_len);
 #endif
 
 typedef __u32 cfs_cap_t;
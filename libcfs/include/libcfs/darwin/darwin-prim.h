@@ -382,6 +382,7 @@ void cfs_timer_init(struct cfs_timer *t, void (*func)(unsigned long), void *arg)
 void cfs_timer_done(struct cfs_timer *t);
 void cfs_timer_arm(struct cfs_timer *t, cfs_time_t deadline);
 void cfs_timer_disarm(struct cfs_timer *t);
+void cfs_timer_disarm_sync(struct cfs_timer *t);
 int  cfs_timer_is_armed(struct cfs_timer *t);
 
 cfs_time_t cfs_timer_deadline(struct cfs_timer *t);
@@ -0,0 +1,125 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * libcfs/include/libcfs/libcfs_cpu.h
+ *
+ * CPU partitions (CPT).
+ *
+ * A CPU partition is a set of CPUs, normally sharing one NUMA node, that
+ * a subsystem can use to keep its locks, queues and threads local: e.g. a
+ * ptlrpc service gives every partition its own request queues and service
+ * threads, so requests arriving on one partition never bounce cache lines
+ * of another.
+ *
+ * - the number of partitions is fixed when libcfs is loaded, see the
+ *   cpu_npartitions module parameter (0 means "pick automatically");
+ * - every possible CPU belongs to exactly one partition;
+ * - userspace (liblustre) and non-Linux kernels always have a single
+ *   partition 0, so callers don't need any #ifdef.
+ */
+
+#ifndef __LIBCFS_CPU_H__
+#define __LIBCFS_CPU_H__
+
+/** no particular partition, i.e. no CPU affinity */
+#define CFS_CPT_ANY             (-1)
+
+#if defined(__linux__) && defined(__KERNEL__)
+
+/** number of CPU partitions */
+int cfs_cpt_number(void);
+/** number of online CPUs in partition \a cpt */
+int cfs_cpt_weight(int cpt);
+/** partition which \a cpu belongs to */
+int cfs_cpt_of_cpu(int cpu);
+/** partition of the CPU the caller is running on */
+int cfs_cpt_current(void);
+/** bind the current thread to CPUs of partition \a cpt */
+int cfs_cpt_bind(int cpt);
+/** NUMA node that memory for partition \a cpt should come from */
+int cfs_cpt_spread_node(int cpt);
+
+/** allocate memory local to partition \a cpt */
+void *cfs_cpt_malloc(int cpt, size_t nr_bytes, u_int32_t flags);
+void *cfs_cpt_vmalloc(int cpt, size_t nr_bytes);
+
+int  cfs_cpu_init(void);
+void cfs_cpu_fini(void);
+
+#else /* !__linux__ || !__KERNEL__ */
+
+static inline int cfs_cpt_number(void)
+{
+        return 1;
+}
+
+static inline int cfs_cpt_weight(int cpt)
+{
+        return cfs_num_online_cpus();
+}
+
+static inline int cfs_cpt_of_cpu(int cpu)
+{
+        return 0;
+}
+
+static inline int cfs_cpt_current(void)
+{
+        return 0;
+}
+
+static inline int cfs_cpt_bind(int cpt)
+{
+        return 0;
+}
+
+static inline int cfs_cpt_spread_node(int cpt)
+{
+        return 0;
+}
+
+#define cfs_cpt_malloc(cpt, nr_bytes, flags)    cfs_alloc(nr_bytes, flags)
+#define cfs_cpt_vmalloc(cpt, nr_bytes)          cfs_alloc_large(nr_bytes)
+
+#define cfs_cpu_init()                          (0)
+#define cfs_cpu_fini()                          do {} while (0)
+
+#endif /* __linux__ && __KERNEL__ */
+
+/** iterate over all CPU partitions */
+#define cfs_cpt_for_each(i)                                     \
+        for (i = 0; i < cfs_cpt_number(); i++)
+
+#endif /* __LIBCFS_CPU_H__ */
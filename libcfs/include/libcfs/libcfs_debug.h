@@ -55,6 +55,7 @@ extern cfs_duration_t libcfs_console_max_delay;
 extern cfs_duration_t libcfs_console_min_delay;
 extern unsigned int libcfs_console_backoff;
 extern unsigned int libcfs_debug_binary;
+extern unsigned int libcfs_debug_deferred;
 extern char libcfs_debug_file_path_arr[PATH_MAX];
 
 int libcfs_debug_mask2str(char *str, int size, int mask, int is_subsys);
@@ -84,6 +85,9 @@ struct ptldebug_header {
 
 
 #define PH_FLAG_FIRST_RECORD 1
+/* the record holds a format and its arguments, not text; such records are
+ * formatted before they leave the kernel, see libcfs_debug_deferred */
+#define PH_FLAG_DEFERRED     2
 
 /* Debugging subsystems (32 bits, non-overlapping) */
 /* keep these in sync with lnet/utils/debug.c and lnet/libcfs/debug.c */
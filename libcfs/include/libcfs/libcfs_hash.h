@@ -214,6 +214,12 @@ enum cfs_hash_tag {
          * change on hash table is non-blocking
          */
         CFS_HASH_NBLK_CHANGE    = 1 << 13,
+        /**
+         * lookups walk buckets under RCU instead of bucket lock, items
+         * must be freed after a grace period and their keys never change,
+         * see cfs_hash_bd_lookup_rcu()
+         */
+        CFS_HASH_RCU            = 1 << 14,
         /** NB, we typed hs_flags as  __u16, please change it
          * if you need to extend >=16 flags */
 };
@@ -368,6 +374,12 @@ typedef struct cfs_hash_ops {
         void     (*hs_put_locked)(cfs_hash_t *hs, cfs_hlist_node_t *hnode);
         /** it's called before removing of @hnode */
         void     (*hs_exit)(cfs_hash_t *hs, cfs_hlist_node_t *hnode);
+        /**
+         * get refcount of item without bucket-lock, under rcu_read_lock,
+         * return 0 and take nothing if item is being freed, it's only
+         * required by CFS_HASH_RCU
+         */
+        int      (*hs_get_rcu)(cfs_hash_t *hs, cfs_hlist_node_t *hnode);
 } cfs_hash_ops_t;
 
 /** total number of buckets in @hs */
@@ -478,6 +490,12 @@ cfs_hash_with_nblk_change(cfs_hash_t *hs)
         return (hs->hs_flags & CFS_HASH_NBLK_CHANGE) != 0;
 }
 
+static inline int
+cfs_hash_with_rcu(cfs_hash_t *hs)
+{
+        return (hs->hs_flags & CFS_HASH_RCU) != 0;
+}
+
 static inline int
 cfs_hash_is_exiting(cfs_hash_t *hs)
 {       /* cfs_hash_destroy is called */
@@ -546,6 +564,14 @@ cfs_hash_get(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
         return CFS_HOP(hs, get)(hs, hnode);
 }
 
+static inline int
+cfs_hash_get_rcu(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
+{
+        LASSERT(CFS_HOP(hs, get_rcu) != NULL);
+
+        return CFS_HOP(hs, get_rcu)(hs, hnode);
+}
+
 static inline void
 cfs_hash_put_locked(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
 {
@@ -685,6 +711,8 @@ static inline cfs_hlist_head_t *cfs_hash_bd_hhead(cfs_hash_t *hs,
 
 cfs_hlist_node_t *cfs_hash_bd_lookup_locked(cfs_hash_t *hs,
                                             cfs_hash_bd_t *bd, void *key);
+cfs_hlist_node_t *cfs_hash_bd_lookup_rcu(cfs_hash_t *hs,
+                                         cfs_hash_bd_t *bd, void *key);
 cfs_hlist_node_t *cfs_hash_bd_findadd_locked(cfs_hash_t *hs,
                                              cfs_hash_bd_t *bd, void *key,
                                              cfs_hlist_node_t *hnode,
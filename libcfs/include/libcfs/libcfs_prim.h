@@ -86,6 +86,8 @@ void cfs_timer_init(cfs_timer_t *t, cfs_timer_func_t *func, void *arg);
 void cfs_timer_done(cfs_timer_t *t);
 void cfs_timer_arm(cfs_timer_t *t, cfs_time_t deadline);
 void cfs_timer_disarm(cfs_timer_t *t);
+/* disarm, and wait for a callback already running to return */
+void cfs_timer_disarm_sync(cfs_timer_t *t);
 int  cfs_timer_is_armed(cfs_timer_t *t);
 cfs_time_t cfs_timer_deadline(cfs_timer_t *t);
 
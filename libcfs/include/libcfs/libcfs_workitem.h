@@ -42,8 +42,17 @@
  * - a workitem always runs in thread context.
  * - a workitem can be concurrent with other workitems but is strictly
  *   serialized with respect to itself.
- * - no CPU affinity, a workitem does not necessarily run on the same CPU
- *   that schedules it. However, this might change in the future.
+ * - a workitem runs on the CPU partition (CPT) given as its scheduler id.
+ *   A CFS_WI_SCHED_ANY workitem is not bound: it runs on the partition
+ *   cfs_wi_schedule() was last called on while it was idle.  Each
+ *   partition has its own scheduler threads, bound to its CPUs, so
+ *   background work stays off other partitions' cores.
+ * - a workitem has a priority, CFS_WI_PRIO_NORMAL unless changed with
+ *   cfs_wi_set_prio(); a scheduler always runs its highest priority
+ *   workitems first.
+ * - a workitem can belong to a class (cfs_wi_class_t) which bounds how
+ *   many workitems of the class run at once over all schedulers; the
+ *   others wait until one of them completes.
  * - if a workitem is scheduled again before it has a chance to run, it
  *   runs only once.
  * - if a workitem is scheduled while it runs, it runs again after it
@@ -56,6 +65,7 @@
  *   affect others.
  * - a workitem runs inside a kernel thread so there's no user space to access.
  * - do not use a workitem if the scheduling latency can't be tolerated.
+ * - cfs_wi_schedule() can be called from softirq context, e.g. a timer.
  *
  * When wi_action returns non-zero, it means the workitem has either been
  * freed or reused and workitem scheduler won't touch it any more.
@@ -64,6 +74,36 @@
 #ifndef __LIBCFS_WORKITEM_H__
 #define __LIBCFS_WORKITEM_H__
 
+/** workitem priorities, highest first */
+enum {
+        CFS_WI_PRIO_HIGH        = 0,
+        CFS_WI_PRIO_NORMAL,
+        CFS_WI_PRIO_LOW,
+        CFS_WI_PRIO_NR,
+};
+
+/**
+ * A class of workitems of which at most wc_max run at the same time.
+ */
+typedef struct cfs_wi_class {
+        /** name, for debugging */
+        const char      *wc_name;
+        /** max # workitems of this class running at once */
+        int              wc_max;
+        /** # running, protected by the workitem global lock */
+        int              wc_running;
+        /** scheduled workitems waiting for one of the running to finish */
+        cfs_list_t       wc_blocked;
+} cfs_wi_class_t;
+
+#define CFS_WI_CLASS_INIT(class, name, max)                             \
+{                                                                       \
+        .wc_name        = (name),                                       \
+        .wc_max         = (max),                                        \
+        .wc_running     = 0,                                            \
+        .wc_blocked     = CFS_LIST_HEAD_INIT((class).wc_blocked),       \
+}
+
 struct cfs_workitem;
 
 typedef int (*cfs_wi_action_t) (struct cfs_workitem *);
@@ -74,17 +114,28 @@ typedef struct cfs_workitem {
         cfs_wi_action_t  wi_action;
         /** arg for working function */
         void            *wi_data;
+        /** class bounding concurrency, or NULL */
+        cfs_wi_class_t  *wi_class;
+        /** when it was queued to run, for latency stats */
+        cfs_time_t       wi_queued;
         /** scheduler id, can be negative */
         short            wi_sched_id;
+        /** partition a CFS_WI_SCHED_ANY workitem is on, only changed by
+         * cfs_wi_schedule() while it is neither scheduled nor running */
+        short            wi_cpt;
+        /** CFS_WI_PRIO_* */
+        unsigned char    wi_prio;
         /** in running */
         unsigned short   wi_running:1;
         /** scheduled */
         unsigned short   wi_scheduled:1;
+        /** on wi_class->wc_blocked */
+        unsigned short   wi_blocked:1;
 } cfs_workitem_t;
 
 /**
- * positive values are reserved as CPU id of future implementation of
- * per-cpu scheduler, so user can "bind" workitem on specific CPU.
+ * Non-negative values are CPU partition numbers, a workitem scheduled
+ * with one runs on that partition.
  */
 #define CFS_WI_SCHED_ANY        (-1)
 #define CFS_WI_SCHED_SERIAL     (-2)
@@ -96,14 +147,37 @@ cfs_wi_init(cfs_workitem_t *wi, void *data,
         CFS_INIT_LIST_HEAD(&wi->wi_list);
 
         wi->wi_sched_id  = sched_id;
+        wi->wi_cpt       = 0;
+        wi->wi_prio      = CFS_WI_PRIO_NORMAL;
+        wi->wi_class     = NULL;
         wi->wi_running   = 0;
         wi->wi_scheduled = 0;
+        wi->wi_blocked   = 0;
         wi->wi_data      = data;
         wi->wi_action    = action;
 }
 
+/* only before the workitem is first scheduled */
+static inline void
+cfs_wi_set_prio(cfs_workitem_t *wi, int prio)
+{
+        LASSERT(prio >= 0 && prio < CFS_WI_PRIO_NR);
+        LASSERT(!wi->wi_scheduled && !wi->wi_running);
+        wi->wi_prio = prio;
+}
+
+/* only before the workitem is first scheduled */
+static inline void
+cfs_wi_set_class(cfs_workitem_t *wi, cfs_wi_class_t *wc)
+{
+        LASSERT(!wi->wi_scheduled && !wi->wi_running);
+        wi->wi_class = wc;
+}
+
+void cfs_wi_class_init(cfs_wi_class_t *wc, const char *name, int max);
 void cfs_wi_exit(cfs_workitem_t *wi);
 int  cfs_wi_cancel(cfs_workitem_t *wi);
+void cfs_wi_cancel_sync(cfs_workitem_t *wi);
 void cfs_wi_schedule(cfs_workitem_t *wi);
 int  cfs_wi_startup(void);
 void cfs_wi_shutdown(void);
@@ -111,6 +185,8 @@ void cfs_wi_shutdown(void);
 #ifdef __KERNEL__
 /** # workitem scheduler loops before reschedule */
 #define CFS_WI_RESCHED    128
+
+int cfs_wi_stats_print(char *buf, int size);
 #else
 int cfs_wi_check_events(void);
 #endif
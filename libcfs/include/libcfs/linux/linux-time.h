@@ -277,6 +277,15 @@ static inline int cfs_time_beforeq_64(__u64 t1, __u64 t2)
 
 #define cfs_gettimeofday(tv) do_gettimeofday(tv)
 
+/* nanoseconds of wall clock time, to time short code paths */
+static inline __u64 cfs_time_current_ns(void)
+{
+        struct timespec ts;
+
+        getnstimeofday(&ts);
+        return (__u64)ts.tv_sec * ONE_BILLION + ts.tv_nsec;
+}
+
 #endif /* __LIBCFS_LINUX_LINUX_TIME_H__ */
 /*
  * Local variables:
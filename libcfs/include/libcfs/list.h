@@ -81,6 +81,41 @@ typedef struct hlist_node cfs_hlist_node_t;
 #define CFS_INIT_HLIST_HEAD(p)		   INIT_HLIST_HEAD(p)
 #define CFS_INIT_HLIST_NODE(p)		   INIT_HLIST_NODE(p)
 
+#include <linux/rcupdate.h>
+
+/*
+ * hlist_add_*_rcu() moved to <linux/rculist.h> in 2.6.26, open-code them
+ * so all the kernels we build against can publish a node to RCU readers.
+ */
+static inline void cfs_hlist_add_head_rcu(cfs_hlist_node_t *n,
+                                          cfs_hlist_head_t *h)
+{
+        cfs_hlist_node_t *first = h->first;
+
+        n->next = first;
+        n->pprev = &h->first;
+        smp_wmb();
+        if (first != NULL)
+                first->pprev = &n->next;
+        h->first = n;
+}
+
+static inline void cfs_hlist_add_after_rcu(cfs_hlist_node_t *n,
+                                           cfs_hlist_node_t *next)
+{
+        next->next = n->next;
+        next->pprev = &n->next;
+        smp_wmb();
+        n->next = next;
+        if (next->next != NULL)
+                next->next->pprev = &next->next;
+}
+
+/* walk an hlist under rcu_read_lock(), racing with the _rcu writers above */
+#define cfs_hlist_for_each_rcu(pos, head)                                   \
+        for (pos = rcu_dereference((head)->first); pos != NULL;             \
+             pos = rcu_dereference(pos->next))
+
 #else /* !defined (__linux__) || !defined(__KERNEL__) */
 
 /*
@@ -444,6 +479,11 @@ static inline void cfs_hlist_add_after(cfs_hlist_node_t *n,
 	for (pos = (head)->first; pos && (n = pos->next, 1); \
 	     pos = n)
 
+/* no RCU readers outside the linux kernel, plain list ops will do */
+#define cfs_hlist_add_head_rcu(n, h)       cfs_hlist_add_head(n, h)
+#define cfs_hlist_add_after_rcu(n, next)   cfs_hlist_add_after(n, next)
+#define cfs_hlist_for_each_rcu(pos, head)  cfs_hlist_for_each(pos, head)
+
 /**
  * Iterate over an hlist of given type
  * \param tpos	 the type * to use as a loop counter.
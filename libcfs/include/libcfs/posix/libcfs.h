@@ -106,6 +106,15 @@
 #include <libcfs/user-bitops.h>
 
 # define cfs_gettimeofday(tv) gettimeofday(tv, NULL);
+
+/* nanoseconds of wall clock time, to time short code paths */
+static inline __u64 cfs_time_current_ns(void)
+{
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+        return (__u64)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000;
+}
 typedef unsigned long long cfs_cycles_t;
 
 #define IS_ERR(a) ((unsigned long)(a) > (unsigned long)-1000L)
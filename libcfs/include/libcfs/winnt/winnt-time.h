@@ -125,6 +125,16 @@ static inline void cfs_gettimeofday(struct timeval *tv)
     tv->tv_usec = (suseconds_t) (Time.QuadPart % 10000000) / 10;
 }
 
+/* nanoseconds of wall clock time, to time short code paths */
+static inline __u64 cfs_time_current_ns(void)
+{
+    LARGE_INTEGER Time;
+
+    KeQuerySystemTime(&Time);
+
+    return (__u64)Time.QuadPart * 100;
+}
+
 static inline LONGLONG JIFFIES()
 {
     LARGE_INTEGER Tick;
@@ -535,6 +535,11 @@ void cfs_timer_disarm(struct cfs_timer *t)
         ktimer_disarm(&t->t);
 }
 
+void cfs_timer_disarm_sync(struct cfs_timer *t)
+{
+        ktimer_disarm(&t->t);
+}
+
 int  cfs_timer_is_armed(struct cfs_timer *t)
 {
         return ktimer_is_armed(&t->t);
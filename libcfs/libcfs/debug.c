@@ -93,6 +93,11 @@ EXPORT_SYMBOL(libcfs_console_backoff);
 unsigned int libcfs_debug_binary = 1;
 EXPORT_SYMBOL(libcfs_debug_binary);
 
+unsigned int libcfs_debug_deferred;
+CFS_MODULE_PARM(libcfs_debug_deferred, "i", uint, 0644,
+                "Lustre kernel debug log formats messages when dumped");
+EXPORT_SYMBOL(libcfs_debug_deferred);
+
 unsigned int libcfs_stack;
 EXPORT_SYMBOL(libcfs_stack);
 
@@ -234,6 +234,30 @@ cfs_hash_lock_setup(cfs_hash_t *hs)
         }
 }
 
+/*
+ * lockless readers of CFS_HASH_RCU tables can see @hnode as soon as it's
+ * linked, so it must be published with a barrier.
+ */
+static inline void
+cfs_hash_hlist_add_head(cfs_hash_t *hs, cfs_hlist_node_t *hnode,
+                        cfs_hlist_head_t *hhead)
+{
+        if (cfs_hash_with_rcu(hs))
+                cfs_hlist_add_head_rcu(hnode, hhead);
+        else
+                cfs_hlist_add_head(hnode, hhead);
+}
+
+static inline void
+cfs_hash_hlist_add_after(cfs_hash_t *hs, cfs_hlist_node_t *prev,
+                         cfs_hlist_node_t *hnode)
+{
+        if (cfs_hash_with_rcu(hs))
+                cfs_hlist_add_after_rcu(prev, hnode);
+        else
+                cfs_hlist_add_after(prev, hnode);
+}
+
 /**
  * Simple hash head without depth tracking
  * new element is always added to head of hlist
@@ -260,7 +284,7 @@ static int
 cfs_hash_hh_hnode_add(cfs_hash_t *hs, cfs_hash_bd_t *bd,
                       cfs_hlist_node_t *hnode)
 {
-        cfs_hlist_add_head(hnode, cfs_hash_hh_hhead(hs, bd));
+        cfs_hash_hlist_add_head(hs, hnode, cfs_hash_hh_hhead(hs, bd));
         return -1; /* unknown depth */
 }
 
@@ -302,7 +326,7 @@ cfs_hash_hd_hnode_add(cfs_hash_t *hs, cfs_hash_bd_t *bd,
 {
         cfs_hash_head_dep_t *hh = container_of(cfs_hash_hd_hhead(hs, bd),
                                                cfs_hash_head_dep_t, hd_head);
-        cfs_hlist_add_head(hnode, &hh->hd_head);
+        cfs_hash_hlist_add_head(hs, hnode, &hh->hd_head);
         return ++hh->hd_depth;
 }
 
@@ -348,9 +372,9 @@ cfs_hash_dh_hnode_add(cfs_hash_t *hs, cfs_hash_bd_t *bd,
                                             cfs_hash_dhead_t, dh_head);
 
         if (dh->dh_tail != NULL) /* not empty */
-                cfs_hlist_add_after(dh->dh_tail, hnode);
+                cfs_hash_hlist_add_after(hs, dh->dh_tail, hnode);
         else /* empty list */
-                cfs_hlist_add_head(hnode, &dh->dh_head);
+                cfs_hash_hlist_add_head(hs, hnode, &dh->dh_head);
         dh->dh_tail = hnode;
         return -1; /* unknown depth */
 }
@@ -403,9 +427,9 @@ cfs_hash_dd_hnode_add(cfs_hash_t *hs, cfs_hash_bd_t *bd,
                                                 cfs_hash_dhead_dep_t, dd_head);
 
         if (dh->dd_tail != NULL) /* not empty */
-                cfs_hlist_add_after(dh->dd_tail, hnode);
+                cfs_hash_hlist_add_after(hs, dh->dd_tail, hnode);
         else /* empty list */
-                cfs_hlist_add_head(hnode, &dh->dd_head);
+                cfs_hash_hlist_add_head(hs, hnode, &dh->dd_head);
         dh->dd_tail = hnode;
         return ++dh->dd_depth;
 }
@@ -662,6 +686,42 @@ cfs_hash_bd_lookup_locked(cfs_hash_t *hs, cfs_hash_bd_t *bd, void *key)
 }
 CFS_EXPORT_SYMBOL(cfs_hash_bd_lookup_locked);
 
+/**
+ * Lockless lookup of @key in @bd of a CFS_HASH_RCU hash, an item is
+ * returned with a reference taken by ops->hs_get_rcu().  Writers still
+ * serialize on the bucket lock, but a concurrent delete can cut the walk
+ * short, so NULL only means the caller has to search again under the
+ * bucket lock.  It always returns NULL without CFS_HASH_RCU, and outside
+ * of the linux kernel.
+ */
+cfs_hlist_node_t *
+cfs_hash_bd_lookup_rcu(cfs_hash_t *hs, cfs_hash_bd_t *bd, void *key)
+{
+#if defined(__linux__) && defined(__KERNEL__)
+        cfs_hlist_node_t  *hnode;
+
+        if (!cfs_hash_with_rcu(hs))
+                return NULL;
+
+        rcu_read_lock();
+        cfs_hlist_for_each_rcu(hnode, cfs_hash_bd_hhead(hs, bd)) {
+                if (!cfs_hash_keycmp(hs, key, hnode))
+                        continue;
+
+                /* item is being freed, take the slow path */
+                if (!cfs_hash_get_rcu(hs, hnode))
+                        hnode = NULL;
+                break;
+        }
+        rcu_read_unlock();
+
+        return hnode;
+#else
+        return NULL;
+#endif
+}
+CFS_EXPORT_SYMBOL(cfs_hash_bd_lookup_rcu);
+
 cfs_hlist_node_t *
 cfs_hash_bd_findadd_locked(cfs_hash_t *hs, cfs_hash_bd_t *bd,
                            void *key, cfs_hlist_node_t *hnode,
@@ -942,6 +1002,11 @@ cfs_hash_buckets_realloc(cfs_hash_t *hs, cfs_hash_bucket_t **old_bkts,
         return new_bkts;
 }
 
+/* rehashing walks and allocates a lot of memory, bound how many tables
+ * do it at once */
+static cfs_wi_class_t cfs_hash_rehash_wic =
+        CFS_WI_CLASS_INIT(cfs_hash_rehash_wic, "hash_rehash", 2);
+
 /**
  * Initialize new libcfs hash, where:
  * @name     - Descriptive hash name
@@ -982,6 +1047,7 @@ static void cfs_hash_depth_wi_init(cfs_hash_t *hs)
         cfs_spin_lock_init(&hs->hs_dep_lock);
         cfs_wi_init(&hs->hs_dep_wi, hs,
                     cfs_hash_dep_print, CFS_WI_SCHED_ANY);
+        cfs_wi_set_prio(&hs->hs_dep_wi, CFS_WI_PRIO_LOW);
 }
 
 static void cfs_hash_depth_wi_cancel(cfs_hash_t *hs)
@@ -1038,6 +1104,10 @@ cfs_hash_create(char *name, unsigned cur_bits, unsigned max_bits,
                      (flags & CFS_HASH_NO_LOCK) == 0));
         LASSERT(ergo((flags & CFS_HASH_REHASH_KEY) != 0,
                       ops->hs_keycpy != NULL));
+        /* buckets and keys of a RCU hash never move under readers */
+        LASSERT(ergo((flags & CFS_HASH_RCU) != 0,
+                     (flags & (CFS_HASH_REHASH | CFS_HASH_REHASH_KEY)) == 0 &&
+                     ops->hs_get_rcu != NULL));
 
         len = (flags & CFS_HASH_BIGNAME) == 0 ?
               CFS_HASH_NAME_LEN : CFS_HASH_BIGNAME_LEN;
@@ -1065,6 +1135,8 @@ cfs_hash_create(char *name, unsigned cur_bits, unsigned max_bits,
         hs->hs_rehash_bits = 0;
         cfs_wi_init(&hs->hs_rehash_wi, hs,
                     cfs_hash_rehash_worker, CFS_WI_SCHED_ANY);
+        cfs_wi_set_prio(&hs->hs_rehash_wi, CFS_WI_PRIO_LOW);
+        cfs_wi_set_class(&hs->hs_rehash_wi, &cfs_hash_rehash_wic);
         cfs_hash_depth_wi_init(hs);
 
         if (cfs_hash_with_rehash(hs))
@@ -1351,6 +1423,14 @@ cfs_hash_lookup(cfs_hash_t *hs, void *key)
         cfs_hlist_node_t     *hnode;
         cfs_hash_bd_t         bds[2];
 
+        if (cfs_hash_with_rcu(hs)) {
+                /* no rehash, so no hs_rwlock and only one bucket */
+                cfs_hash_bd_get(hs, key, &bds[0]);
+                hnode = cfs_hash_bd_lookup_rcu(hs, &bds[0], key);
+                if (hnode != NULL)
+                        return cfs_hash_object(hs, hnode);
+        }
+
         cfs_hash_lock(hs, 0);
         cfs_hash_dual_bd_get_and_lock(hs, key, bds, 0);
 
@@ -1981,6 +2061,7 @@ void cfs_hash_rehash_key(cfs_hash_t *hs, void *old_key,
         cfs_hash_bd_t        old_bds[2];
         cfs_hash_bd_t        new_bd;
 
+        LASSERT(!cfs_hash_with_rcu(hs));
         LASSERT(!cfs_hlist_unhashed(hnode));
 
         cfs_hash_lock(hs, 0);
@@ -0,0 +1,213 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * libcfs/libcfs/linux/linux-cpu.c
+ *
+ * CPU partition table, see libcfs/include/libcfs/libcfs_cpu.h
+ */
+
+#define DEBUG_SUBSYSTEM S_LNET
+
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/vmalloc.h>
+#include <libcfs/libcfs.h>
+
+static int cpu_npartitions;
+CFS_MODULE_PARM(cpu_npartitions, "i", int, 0444,
+                "# of CPU partitions, 0 to pick one per NUMA node "
+                "(or one per 4 cores on non-NUMA systems)");
+
+/** upper limit of CPU partitions */
+#define CFS_CPT_MAX             64
+/** # of cores per partition on a single-node system */
+#define CFS_CPT_NCPUS_DEFAULT   4
+
+static struct cfs_cpt_data {
+        /** # of partitions */
+        int             cpt_number;
+        /** partition of each possible CPU */
+        int             cpt_of_cpu[CFS_NR_CPUS];
+        /** CPUs of each partition */
+        cpumask_t       cpt_masks[CFS_CPT_MAX];
+        /** preferred NUMA node of each partition */
+        int             cpt_nodes[CFS_CPT_MAX];
+} cfs_cpt_data;
+
+int cfs_cpt_number(void)
+{
+        return cfs_cpt_data.cpt_number;
+}
+EXPORT_SYMBOL(cfs_cpt_number);
+
+int cfs_cpt_weight(int cpt)
+{
+        cpumask_t mask;
+
+        LASSERT(cpt >= 0 && cpt < cfs_cpt_data.cpt_number);
+
+        cpus_and(mask, cfs_cpt_data.cpt_masks[cpt], cpu_online_map);
+        return cpus_weight(mask);
+}
+EXPORT_SYMBOL(cfs_cpt_weight);
+
+int cfs_cpt_of_cpu(int cpu)
+{
+        LASSERT(cpu >= 0 && cpu < CFS_NR_CPUS);
+
+        return cfs_cpt_data.cpt_of_cpu[cpu];
+}
+EXPORT_SYMBOL(cfs_cpt_of_cpu);
+
+int cfs_cpt_current(void)
+{
+        int cpt = cfs_cpt_of_cpu(get_cpu());
+
+        put_cpu();
+        return cpt;
+}
+EXPORT_SYMBOL(cfs_cpt_current);
+
+int cfs_cpt_bind(int cpt)
+{
+        cpumask_t mask;
+
+        if (cpt == CFS_CPT_ANY || cfs_cpt_data.cpt_number == 1)
+                return 0;
+
+        LASSERT(cpt >= 0 && cpt < cfs_cpt_data.cpt_number);
+
+        cpus_and(mask, cfs_cpt_data.cpt_masks[cpt], cpu_online_map);
+        if (cpus_empty(mask)) {
+                CDEBUG(D_INFO, "No online CPU in partition %d\n", cpt);
+                return -EINVAL;
+        }
+
+        return cfs_set_cpus_allowed(cfs_current(), mask);
+}
+EXPORT_SYMBOL(cfs_cpt_bind);
+
+int cfs_cpt_spread_node(int cpt)
+{
+        if (cpt == CFS_CPT_ANY)
+                return -1;
+
+        LASSERT(cpt >= 0 && cpt < cfs_cpt_data.cpt_number);
+
+        return cfs_cpt_data.cpt_nodes[cpt];
+}
+EXPORT_SYMBOL(cfs_cpt_spread_node);
+
+void *cfs_cpt_vmalloc(int cpt, size_t nr_bytes)
+{
+        int node = cfs_cpt_spread_node(cpt);
+
+        if (node < 0)
+                return vmalloc(nr_bytes);
+
+        return vmalloc_node(nr_bytes, node);
+}
+EXPORT_SYMBOL(cfs_cpt_vmalloc);
+
+static int cfs_cpt_auto_number(void)
+{
+        int ncpus = num_online_cpus();
+        int nnodes = 1;
+
+#ifdef CONFIG_NUMA
+        nnodes = num_online_nodes();
+#endif
+        if (nnodes > 1)
+                return min(nnodes, CFS_CPT_MAX);
+
+        return max(1, min(ncpus / CFS_CPT_NCPUS_DEFAULT, CFS_CPT_MAX));
+}
+
+int cfs_cpu_init(void)
+{
+        struct cfs_cpt_data *cd = &cfs_cpt_data;
+        int                  ncpus = 0;
+        int                  node;
+        int                  cpu;
+        int                  i;
+
+        memset(cd, 0, sizeof(*cd));
+
+        cd->cpt_number = cpu_npartitions > 0 ?
+                         cpu_npartitions : cfs_cpt_auto_number();
+        if (cd->cpt_number > CFS_CPT_MAX)
+                cd->cpt_number = CFS_CPT_MAX;
+        if (cd->cpt_number > num_possible_cpus())
+                cd->cpt_number = num_possible_cpus();
+
+        for (i = 0; i < cd->cpt_number; i++) {
+                cpus_clear(cd->cpt_masks[i]);
+                cd->cpt_nodes[i] = -1;
+        }
+
+        /* Walk CPUs node by node and cut the sequence into equal slices,
+         * so a partition never spans two nodes unless it has to. */
+        for (node = 0; node < MAX_NUMNODES; node++) {
+                cfs_for_each_possible_cpu(cpu) {
+                        int cpt;
+
+                        if (cpu_to_node(cpu) != node &&
+                            !(node == 0 && cpu_to_node(cpu) < 0))
+                                continue;
+
+                        cpt = ncpus * cd->cpt_number / num_possible_cpus();
+                        cd->cpt_of_cpu[cpu] = cpt;
+                        cpu_set(cpu, cd->cpt_masks[cpt]);
+                        if (cd->cpt_nodes[cpt] < 0)
+                                cd->cpt_nodes[cpt] = max(node, 0);
+                        ncpus++;
+                }
+        }
+        LASSERT(ncpus == num_possible_cpus());
+
+        for (i = 0; i < cd->cpt_number; i++) {
+                CDEBUG(D_INFO, "CPU partition %d: %d CPUs, node %d\n",
+                       i, cpus_weight(cd->cpt_masks[i]), cd->cpt_nodes[i]);
+        }
+
+        return 0;
+}
+
+void cfs_cpu_fini(void)
+{
+        cfs_cpt_data.cpt_number = 1;
+}
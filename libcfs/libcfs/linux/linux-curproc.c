@@ -41,6 +41,7 @@
  */
 
 #include <linux/sched.h>
+#include <linux/mm.h>
 #include <linux/fs_struct.h>
 
 #include <linux/compat.h>
@@ -215,6 +216,127 @@ int cfs_curproc_is_32bit(void)
 #endif
 }
 
+/*
+ * Copy \a len bytes of the user memory of \a mm at \a addr into \a buf.
+ * Like access_process_vm(), but for a caller that already holds mmap_sem
+ * for read, which access_process_vm() would take again.
+ *
+ * Returns the number of bytes copied.
+ */
+static int cfs_access_mm(struct mm_struct *mm, unsigned long addr,
+                         void *buf, int len)
+{
+        struct vm_area_struct *vma;
+        struct page           *page;
+        char                  *maddr;
+        int                    copied = 0;
+
+        while (len > 0) {
+                int offset = addr & (CFS_PAGE_SIZE - 1);
+                int bytes = min_t(int, len, CFS_PAGE_SIZE - offset);
+
+                if (get_user_pages(current, mm, addr, 1, 0, 1,
+                                   &page, &vma) <= 0)
+                        break;
+
+                maddr = kmap(page);
+                memcpy(buf, maddr + offset, bytes);
+                kunmap(page);
+                page_cache_release(page);
+
+                len -= bytes;
+                buf += bytes;
+                addr += bytes;
+                copied += bytes;
+        }
+        return copied;
+}
+
+/**
+ * Copy the value of environment variable \a key of the current process
+ * into \a value, which is \a value_len bytes long.
+ *
+ * The environment lives in user memory of the process and is read with
+ * mmap_sem held for read.  This may run from a page fault or mmap() path
+ * that already holds mmap_sem, so the lookup is given up rather than
+ * waiting behind a writer.
+ *
+ * \retval 0 on success
+ * \retval -ENOENT if the variable is not set
+ * \retval -EOVERFLOW if its value does not fit into \a value
+ * \retval -EDEADLK if mmap_sem could not be taken without waiting
+ * \retval -EINVAL for kernel threads, which have no environment
+ */
+int cfs_get_environ(const char *key, char *value, int value_len)
+{
+        struct mm_struct *mm;
+        char             *buffer;
+        unsigned long     addr;
+        int               key_len = strlen(key);
+        int               rc = -ENOENT;
+        ENTRY;
+
+        LIBCFS_ALLOC(buffer, CFS_PAGE_SIZE);
+        if (buffer == NULL)
+                RETURN(-ENOMEM);
+
+        mm = get_task_mm(current);
+        if (mm == NULL) {
+                LIBCFS_FREE(buffer, CFS_PAGE_SIZE);
+                RETURN(-EINVAL);
+        }
+
+        if (!down_read_trylock(&mm->mmap_sem)) {
+                mmput(mm);
+                LIBCFS_FREE(buffer, CFS_PAGE_SIZE);
+                RETURN(-EDEADLK);
+        }
+
+        addr = mm->env_start;
+        while (addr < mm->env_end) {
+                int   this_len = min_t(int, mm->env_end - addr, CFS_PAGE_SIZE);
+                int   scan_len = this_len;
+                char *entry = buffer;
+
+                if (cfs_access_mm(mm, addr, buffer, this_len) != this_len)
+                        break;
+
+                /* "key=value" entries are separated by '\0' */
+                while (scan_len > 0) {
+                        char *end = memscan(entry, '\0', scan_len);
+                        int   entry_len = end - entry;
+
+                        if (entry_len == scan_len) {
+                                /* entry crosses the buffer boundary, reread
+                                 * it at the start of the next chunk */
+                                if (scan_len == this_len)
+                                        GOTO(out, rc = -EINVAL);
+                                break;
+                        }
+
+                        if (entry_len > key_len && entry[key_len] == '=' &&
+                            memcmp(entry, key, key_len) == 0) {
+                                entry += key_len + 1;
+                                entry_len -= key_len + 1;
+                                if (entry_len >= value_len)
+                                        GOTO(out, rc = -EOVERFLOW);
+                                memcpy(value, entry, entry_len);
+                                value[entry_len] = '\0';
+                                GOTO(out, rc = 0);
+                        }
+
+                        scan_len -= entry_len + 1;
+                        entry = end + 1;
+                }
+                addr += this_len - scan_len;
+        }
+out:
+        up_read(&mm->mmap_sem);
+        mmput(mm);
+        LIBCFS_FREE(buffer, CFS_PAGE_SIZE);
+        RETURN(rc);
+}
+
 EXPORT_SYMBOL(cfs_curproc_uid);
 EXPORT_SYMBOL(cfs_curproc_pid);
 EXPORT_SYMBOL(cfs_curproc_euid);
@@ -234,6 +356,7 @@ EXPORT_SYMBOL(cfs_curproc_cap_pack);
 EXPORT_SYMBOL(cfs_curproc_cap_unpack);
 EXPORT_SYMBOL(cfs_capable);
 EXPORT_SYMBOL(cfs_curproc_is_32bit);
+EXPORT_SYMBOL(cfs_get_environ);
 
 /*
  * Local variables:
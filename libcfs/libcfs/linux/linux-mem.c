@@ -71,6 +71,21 @@ cfs_alloc(size_t nr_bytes, u_int32_t flags)
 	return ptr;
 }
 
+void *
+cfs_cpt_malloc(int cpt, size_t nr_bytes, u_int32_t flags)
+{
+        void *ptr;
+        int   node = cfs_cpt_spread_node(cpt);
+
+        if (node < 0)
+                return cfs_alloc(nr_bytes, flags);
+
+        ptr = kmalloc_node(nr_bytes, cfs_alloc_flags_to_gfp(flags), node);
+        if (ptr != NULL && (flags & CFS_ALLOC_ZERO))
+                memset(ptr, 0, nr_bytes);
+        return ptr;
+}
+
 void
 cfs_free(void *addr)
 {
@@ -165,6 +180,7 @@ EXPORT_SYMBOL(cfs_mem_is_in_cache);
 
 EXPORT_SYMBOL(cfs_alloc);
 EXPORT_SYMBOL(cfs_free);
+EXPORT_SYMBOL(cfs_cpt_malloc);
 EXPORT_SYMBOL(cfs_alloc_large);
 EXPORT_SYMBOL(cfs_free_large);
 EXPORT_SYMBOL(cfs_alloc_page);
@@ -241,6 +241,12 @@ void cfs_timer_disarm(cfs_timer_t *t)
 }
 EXPORT_SYMBOL(cfs_timer_disarm);
 
+void cfs_timer_disarm_sync(cfs_timer_t *t)
+{
+        del_timer_sync(t);
+}
+EXPORT_SYMBOL(cfs_timer_disarm_sync);
+
 int  cfs_timer_is_armed(cfs_timer_t *t)
 {
         return timer_pending(t);
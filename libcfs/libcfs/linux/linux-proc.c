@@ -107,6 +107,9 @@ enum {
         PSDEV_LNET_DEBUG_LOG_UPCALL, /* debug log upcall script */
         PSDEV_LNET_WATCHDOG_RATELIMIT,  /* ratelimit watchdog messages  */
         PSDEV_LNET_FORCE_LBUG,    /* hook to force an LBUG */
+        PSDEV_LNET_DEBUG_DEFERRED, /* format debug messages when dumped */
+        PSDEV_LNET_DEBUG_DEFERRED_RECORDS, /* debug messages stored unformatted */
+        PSDEV_LNET_WORKITEM_STATS, /* workitem scheduler stats */
 };
 #else
 #define CTL_LNET                        CTL_UNNUMBERED
@@ -129,6 +132,9 @@ enum {
 #define PSDEV_LNET_DEBUG_LOG_UPCALL     CTL_UNNUMBERED
 #define PSDEV_LNET_WATCHDOG_RATELIMIT   CTL_UNNUMBERED
 #define PSDEV_LNET_FORCE_LBUG           CTL_UNNUMBERED
+#define PSDEV_LNET_DEBUG_DEFERRED       CTL_UNNUMBERED
+#define PSDEV_LNET_DEBUG_DEFERRED_RECORDS CTL_UNNUMBERED
+#define PSDEV_LNET_WORKITEM_STATS       CTL_UNNUMBERED
 #endif
 
 
@@ -246,6 +252,51 @@ static int __proc_debug_mb(void *data, int write,
 
 DECLARE_PROC_HANDLER(proc_debug_mb)
 
+static int __proc_debug_deferred_records(void *data, int write,
+                                         loff_t pos, void *buffer, int nob)
+{
+        char tmpstr[32];
+        int  len;
+
+        if (write)
+                return -EPERM;
+
+        len = snprintf(tmpstr, sizeof(tmpstr), "%lu",
+                       cfs_trace_get_deferred());
+        if (pos >= len)
+                return 0;
+
+        return cfs_trace_copyout_string(buffer, nob, tmpstr + pos, "\n");
+}
+
+DECLARE_PROC_HANDLER(proc_debug_deferred_records)
+
+static int __proc_workitem_stats(void *data, int write,
+                                 loff_t pos, void *buffer, int nob)
+{
+        const int  tmpstrlen = 2 * CFS_PAGE_SIZE;
+        char      *tmpstr;
+        int        rc;
+
+        if (write)
+                return -EPERM;
+
+        rc = cfs_trace_allocate_string_buffer(&tmpstr, tmpstrlen);
+        if (rc < 0)
+                return rc;
+
+        rc = cfs_wi_stats_print(tmpstr, tmpstrlen - 1);
+        if (pos >= rc)
+                rc = 0;
+        else
+                rc = cfs_trace_copyout_string(buffer, nob, tmpstr + pos, NULL);
+
+        cfs_trace_free_string_buffer(tmpstr, tmpstrlen);
+        return rc;
+}
+
+DECLARE_PROC_HANDLER(proc_workitem_stats)
+
 int LL_PROC_PROTO(proc_console_max_delay_cs)
 {
         int rc, max_delay_cs;
@@ -490,6 +541,26 @@ static cfs_sysctl_table_t lnet_table[] = {
                 .mode     = 0200,
                 .proc_handler = &libcfs_force_lbug
         },
+        {
+                .ctl_name = PSDEV_LNET_DEBUG_DEFERRED,
+                .procname = "debug_deferred",
+                .data     = &libcfs_debug_deferred,
+                .maxlen   = sizeof(int),
+                .mode     = 0644,
+                .proc_handler = &proc_dointvec
+        },
+        {
+                .ctl_name = PSDEV_LNET_DEBUG_DEFERRED_RECORDS,
+                .procname = "debug_deferred_records",
+                .mode     = 0444,
+                .proc_handler = &proc_debug_deferred_records,
+        },
+        {
+                .ctl_name = PSDEV_LNET_WORKITEM_STATS,
+                .procname = "workitem_stats",
+                .mode     = 0444,
+                .proc_handler = &proc_workitem_stats,
+        },
         {0}
 };
 
@@ -400,10 +400,16 @@ static int init_libcfs_module(void)
                 goto cleanup_debug;
         }
 #endif
+        rc = cfs_cpu_init();
+        if (rc != 0) {
+                CERROR("cfs_cpu_init: error %d\n", rc);
+                goto cleanup_lwt;
+        }
+
         rc = cfs_psdev_register(&libcfs_dev);
         if (rc) {
                 CERROR("misc_register: error %d\n", rc);
-                goto cleanup_lwt;
+                goto cleanup_cpu;
         }
 
         rc = cfs_wi_startup();
@@ -425,6 +431,8 @@ static int init_libcfs_module(void)
         cfs_wi_shutdown();
  cleanup_deregister:
         cfs_psdev_deregister(&libcfs_dev);
+ cleanup_cpu:
+        cfs_cpu_fini();
  cleanup_lwt:
 #if LWT_SUPPORT
         lwt_fini();
@@ -448,6 +456,8 @@ static void exit_libcfs_module(void)
         if (rc)
                 CERROR("misc_deregister error %d\n", rc);
 
+        cfs_cpu_fini();
+
 #if LWT_SUPPORT
         lwt_fini();
 #endif
@@ -165,6 +165,7 @@ cfs_trace_get_tage_try(struct cfs_trace_cpu_data *tcd, unsigned long len)
                 }
 
                 tage->used = 0;
+                tage->deferred = 0;
                 tage->cpu = cfs_smp_processor_id();
                 tage->type = tcd->tcd_type;
                 cfs_list_add_tail(&tage->linkage, &tcd->tcd_pages);
@@ -238,11 +239,431 @@ static struct cfs_trace_page *cfs_trace_get_tage(struct cfs_trace_cpu_data *tcd,
         if (tcd->tcd_cur_pages > 0) {
                 tage = cfs_tage_from_list(tcd->tcd_pages.next);
                 tage->used = 0;
+                tage->deferred = 0;
                 cfs_tage_to_tail(tage, &tcd->tcd_pages);
         }
         return tage;
 }
 
+/*
+ * Deferred records.
+ *
+ * With libcfs_debug_deferred set, a message is not run through vsnprintf()
+ * when it is logged: its format and arguments are copied into the page
+ * instead, and the text is only made when the log is written out by
+ * tracefiled, "lctl debug_kernel" or on panic.  Such a record is
+ *
+ *     ptldebug_header | dots | file\0 | fn\0 | format\0 | arguments
+ *
+ * with PH_FLAG_DEFERRED in ph_flags.  Each integer or pointer argument (and
+ * each '*' width or precision) takes 8 bytes, "%s" strings are copied with
+ * their terminating NUL; nothing is aligned.  Everything is copied, so a
+ * record stays valid after the module which logged it is gone.
+ */
+
+/* longest string a "%s" argument is cut to */
+#define CFS_TRACE_DEFER_STR_MAX 256
+
+enum cfs_trace_arg {
+        CFS_TA_NONE,            /* "%%" */
+        CFS_TA_INT,             /* int and shorter, 'c' */
+        CFS_TA_LONG,            /* 'l' and 't' */
+        CFS_TA_LLONG,           /* "ll", 'L' and 'q' */
+        CFS_TA_SIZE,            /* 'z' and 'Z' */
+        CFS_TA_PTR,             /* plain "%p" */
+        CFS_TA_STR,             /* "%s" */
+};
+
+struct cfs_trace_spec {
+        const char         *ts_start;   /* '%' of the conversion */
+        int                 ts_len;     /* up to and including its letter */
+        int                 ts_star;    /* '*' width and precision count */
+        int                 ts_prec;    /* precision, -1 if none or '*' */
+        int                 ts_prec_star; /* precision is the last '*' */
+        enum cfs_trace_arg  ts_arg;
+};
+
+static inline int cfs_trace_isdigit(char c)
+{
+        return c >= '0' && c <= '9';
+}
+
+/*
+ * Find the next conversion of *\a fmtp, move *\a fmtp past it.  Returns 1
+ * if there was one, 0 at the end of the format and -1 if the conversion
+ * can't be deferred: "%n", floating point and the kernel's "%p" extensions.
+ */
+static int cfs_trace_fmt_next(const char **fmtp, struct cfs_trace_spec *ts)
+{
+        const char *f = *fmtp;
+        int         qual = 0;
+
+        while (*f != '\0' && *f != '%')
+                f++;
+        if (*f == '\0') {
+                *fmtp = f;
+                return 0;
+        }
+
+        ts->ts_start = f++;
+        ts->ts_star = 0;
+        ts->ts_prec = -1;
+        ts->ts_prec_star = 0;
+
+        while (*f == '-' || *f == '+' || *f == ' ' || *f == '#' || *f == '0')
+                f++;
+
+        if (*f == '*') {
+                ts->ts_star++;
+                f++;
+        } else {
+                while (cfs_trace_isdigit(*f))
+                        f++;
+        }
+
+        if (*f == '.') {
+                f++;
+                if (*f == '*') {
+                        ts->ts_star++;
+                        ts->ts_prec_star = 1;
+                        f++;
+                } else {
+                        ts->ts_prec = 0;
+                        while (cfs_trace_isdigit(*f))
+                                ts->ts_prec = ts->ts_prec * 10 + *f++ - '0';
+                }
+        }
+
+        switch (*f) {
+        case 'h':
+                if (*++f == 'h')
+                        f++;
+                break;
+        case 'l':
+                qual = 'l';
+                if (*++f == 'l') {
+                        qual = 'L';
+                        f++;
+                }
+                break;
+        case 'L':
+        case 'q':
+                qual = 'L';
+                f++;
+                break;
+        case 'z':
+        case 'Z':
+                qual = 'z';
+                f++;
+                break;
+        case 't':
+                qual = 'l';
+                f++;
+                break;
+        }
+
+        switch (*f) {
+        case '%':
+                ts->ts_arg = CFS_TA_NONE;
+                break;
+        case 'c':
+                ts->ts_arg = CFS_TA_INT;
+                break;
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+                ts->ts_arg = qual == 'l' ? CFS_TA_LONG :
+                             qual == 'L' ? CFS_TA_LLONG :
+                             qual == 'z' ? CFS_TA_SIZE : CFS_TA_INT;
+                break;
+        case 's':
+                ts->ts_arg = CFS_TA_STR;
+                break;
+        case 'p':
+                if (cfs_trace_isdigit(f[1]) ||
+                    (f[1] >= 'a' && f[1] <= 'z') ||
+                    (f[1] >= 'A' && f[1] <= 'Z'))
+                        return -1;
+                ts->ts_arg = CFS_TA_PTR;
+                break;
+        default:
+                return -1;
+        }
+
+        f++;
+        ts->ts_len = f - ts->ts_start;
+        *fmtp = f;
+        return 1;
+}
+
+/*
+ * Copy the arguments of \a format into \a buf of \a size bytes.  Returns
+ * the number of bytes used, -1 if they don't fit or can't be deferred.
+ */
+static int cfs_trace_pack_args(char *buf, int size, const char *format,
+                               va_list args)
+{
+        struct cfs_trace_spec ts;
+        const char           *f = format;
+        const char           *s;
+        __u64                 val;
+        int                   nob = 0;
+        int                   prec;
+        int                   len;
+        int                   rc;
+        int                   i;
+
+        while ((rc = cfs_trace_fmt_next(&f, &ts)) > 0) {
+                if (nob + (ts.ts_star + 1) * sizeof(val) > size)
+                        return -1;
+
+                prec = ts.ts_prec;
+                for (i = 0; i < ts.ts_star; i++) {
+                        val = (__s64)va_arg(args, int);
+                        memcpy(buf + nob, &val, sizeof(val));
+                        nob += sizeof(val);
+                }
+                /* "%.*s" need not be NUL-terminated within the precision,
+                 * which is the last '*' argument; negative means none */
+                if (ts.ts_prec_star)
+                        prec = (int)(__s64)val;
+
+                switch (ts.ts_arg) {
+                case CFS_TA_NONE:
+                        continue;
+                case CFS_TA_INT:
+                        val = (__s64)va_arg(args, int);
+                        break;
+                case CFS_TA_LONG:
+                        val = (__s64)va_arg(args, long);
+                        break;
+                case CFS_TA_LLONG:
+                        val = va_arg(args, long long);
+                        break;
+                case CFS_TA_SIZE:
+                        val = va_arg(args, size_t);
+                        break;
+                case CFS_TA_PTR:
+                        val = (unsigned long)va_arg(args, void *);
+                        break;
+                case CFS_TA_STR:
+                        s = va_arg(args, const char *);
+                        if (s == NULL)
+                                s = "(null)";
+                        len = strnlen(s, prec >= 0 &&
+                                         prec < CFS_TRACE_DEFER_STR_MAX ?
+                                         prec : CFS_TRACE_DEFER_STR_MAX);
+                        if (nob + len + 1 > size)
+                                return -1;
+                        memcpy(buf + nob, s, len);
+                        buf[nob + len] = '\0';
+                        nob += len + 1;
+                        continue;
+                }
+                memcpy(buf + nob, &val, sizeof(val));
+                nob += sizeof(val);
+        }
+        return rc < 0 ? -1 : nob;
+}
+
+/*
+ * Log a deferred record of \a format and its \a args.  Returns 0 on
+ * success, -1 if the message has to be logged as text.
+ */
+static int cfs_trace_defer_msg(struct cfs_trace_cpu_data *tcd,
+                               struct ptldebug_header *header,
+                               const char *file, const char *fn, int depth,
+                               const char *format, va_list args)
+{
+        struct cfs_trace_page *tage;
+        char                  *args_buf;
+        char                  *debug_buf;
+        int                    args_nob;
+        int                    file_nob;
+        int                    fn_nob;
+        int                    fmt_nob;
+        int                    rc = -1;
+
+        /* the console buffer of this CPU and context is free: console
+         * messages are never deferred */
+        args_buf = cfs_trace_get_console_buffer();
+        args_nob = cfs_trace_pack_args(args_buf, CFS_TRACE_CONSOLE_BUFFER_SIZE,
+                                       format, args);
+        if (args_nob < 0)
+                goto out;
+
+        if (fn == NULL)
+                fn = "";
+        file_nob = strlen(file) + 1;
+        fn_nob = strlen(fn) + 1;
+        fmt_nob = strlen(format) + 1;
+
+        header->ph_len = sizeof(*header) + depth + file_nob + fn_nob +
+                         fmt_nob + args_nob;
+        tage = cfs_trace_get_tage(tcd, header->ph_len);
+        if (tage == NULL)
+                goto out;
+
+        debug_buf = (char *)cfs_page_address(tage->page) + tage->used;
+        header->ph_flags |= PH_FLAG_DEFERRED;
+        memcpy(debug_buf, header, sizeof(*header));
+        header->ph_flags &= ~PH_FLAG_DEFERRED;
+        debug_buf += sizeof(*header);
+        memset(debug_buf, '.', depth);
+        debug_buf += depth;
+        memcpy(debug_buf, file, file_nob);
+        debug_buf += file_nob;
+        memcpy(debug_buf, fn, fn_nob);
+        debug_buf += fn_nob;
+        memcpy(debug_buf, format, fmt_nob);
+        debug_buf += fmt_nob;
+        memcpy(debug_buf, args_buf, args_nob);
+
+        tage->used += header->ph_len;
+        tage->deferred++;
+        tcd->tcd_deferred++;
+        __LASSERT(tage->used <= CFS_PAGE_SIZE);
+        rc = 0;
+ out:
+        cfs_trace_put_console_buffer(args_buf);
+        return rc;
+}
+
+/*
+ * Format deferred record \a hdr into a text record in \a buf of \a size
+ * bytes, cutting its message if needed (*\a cut is set then).  Returns the
+ * length of the text record, 0 if not even its prefix fits.
+ */
+static int cfs_trace_render(struct ptldebug_header *hdr, char *buf, int size,
+                            int *cut)
+{
+        struct cfs_trace_spec ts;
+        char                 *end = (char *)hdr + hdr->ph_len;
+        char                 *p = (char *)(hdr + 1);
+        const char           *fmt;
+        const char           *f;
+        const char           *lit;
+        const char           *str = NULL;
+        char                  spec[64];
+        char                 *text;
+        __u64                 val;
+        __s64                 star[2];
+        int                   prefix;
+        int                   avail;
+        int                   nob = 0;
+        int                   len;
+        int                   i;
+        int                   j;
+
+        *cut = 0;
+
+        /* dots and file, then function */
+        for (i = 0; i < 2; i++)
+                p += strnlen(p, end - p) + 1;
+        fmt = p;
+        p += strnlen(p, end - p) + 1;
+        if (p > end)
+                return 0;
+
+        prefix = fmt - (char *)hdr;
+        if (prefix + 2 > size)
+                return 0;
+        memcpy(buf, hdr, prefix);
+        text = buf + prefix;
+        avail = size - prefix;
+
+        for (f = fmt; ; ) {
+                lit = f;
+                if (cfs_trace_fmt_next(&f, &ts) <= 0)
+                        ts.ts_start = f = lit + strlen(lit);
+
+                len = min_t(int, ts.ts_start - lit, avail - 1 - nob);
+                memcpy(text + nob, lit, len);
+                nob += len;
+                if (*ts.ts_start == '\0' || nob >= avail - 1)
+                        break;
+
+                for (i = 0; i < ts.ts_star && p + sizeof(val) <= end; i++) {
+                        memcpy(&val, p, sizeof(val));
+                        star[i] = val;
+                        p += sizeof(val);
+                }
+                if (i < ts.ts_star || ts.ts_len + ts.ts_star * 20 >= sizeof(spec))
+                        break;
+
+                /* rebuild the conversion with the '*'s filled in */
+                for (i = j = len = 0; i < ts.ts_len; i++) {
+                        if (ts.ts_start[i] == '*')
+                                len += snprintf(spec + len, sizeof(spec) - len,
+                                                "%lld", (long long)star[j++]);
+                        else
+                                spec[len++] = ts.ts_start[i];
+                }
+                spec[len] = '\0';
+
+                if (ts.ts_arg == CFS_TA_STR) {
+                        str = p;
+                        p += strnlen(p, end - p) + 1;
+                        if (p > end)
+                                break;
+                } else if (ts.ts_arg != CFS_TA_NONE) {
+                        if (p + sizeof(val) > end)
+                                break;
+                        memcpy(&val, p, sizeof(val));
+                        p += sizeof(val);
+                }
+
+                switch (ts.ts_arg) {
+                case CFS_TA_NONE:
+                        len = snprintf(text + nob, avail - nob, "%%");
+                        break;
+                case CFS_TA_INT:
+                        len = snprintf(text + nob, avail - nob, spec, (int)val);
+                        break;
+                case CFS_TA_LONG:
+                        len = snprintf(text + nob, avail - nob, spec,
+                                       (long)val);
+                        break;
+                case CFS_TA_LLONG:
+                        len = snprintf(text + nob, avail - nob, spec,
+                                       (long long)val);
+                        break;
+                case CFS_TA_SIZE:
+                        len = snprintf(text + nob, avail - nob, spec,
+                                       (size_t)val);
+                        break;
+                case CFS_TA_PTR:
+                        len = snprintf(text + nob, avail - nob, spec,
+                                       (void *)(unsigned long)val);
+                        break;
+                case CFS_TA_STR:
+                        len = snprintf(text + nob, avail - nob, spec, str);
+                        break;
+                default:
+                        len = 0;
+                        break;
+                }
+                nob += min_t(int, len, avail - 1 - nob);
+                if (nob >= avail - 1)
+                        break;
+        }
+
+        if (nob >= avail - 1) {
+                *cut = 1;
+                nob = avail - 1;
+        }
+        if (nob == 0 || text[nob - 1] != '\n')
+                text[nob++] = '\n';
+
+        hdr = (struct ptldebug_header *)buf;
+        hdr->ph_flags &= ~PH_FLAG_DEFERRED;
+        hdr->ph_len = prefix + nob;
+        return prefix + nob;
+}
+
 int libcfs_debug_vmsg2(cfs_debug_limit_state_t *cdls, int subsys, int mask,
                        const char *file, const char *fn, const int line,
                        const char *format1, va_list args,
@@ -260,6 +681,7 @@ int libcfs_debug_vmsg2(cfs_debug_limit_state_t *cdls, int subsys, int mask,
         va_list                    ap;
         int                        depth;
         int                        i;
+        int                        rc;
         int                        remain;
 
         if (strchr(file, '/'))
@@ -285,6 +707,27 @@ int libcfs_debug_vmsg2(cfs_debug_limit_state_t *cdls, int subsys, int mask,
         }
 
         depth = __current_nesting_level();
+
+        if (libcfs_debug_deferred && libcfs_debug_binary &&
+            (mask & libcfs_printk) == 0 &&
+            (format1 == NULL) != (format2 == NULL)) {
+                if (format1 != NULL) {
+                        va_copy(ap, args);
+                        rc = cfs_trace_defer_msg(tcd, &header, file, fn,
+                                                 depth, format1, ap);
+                        va_end(ap);
+                } else {
+                        va_start(ap, format2);
+                        rc = cfs_trace_defer_msg(tcd, &header, file, fn,
+                                                 depth, format2, ap);
+                        va_end(ap);
+                }
+                if (rc == 0) {
+                        cfs_trace_put_tcd(tcd);
+                        return 1;
+                }
+        }
+
         known_size = strlen(file) + 1 + depth;
         if (fn)
                 known_size += strlen(fn) + 1;
@@ -632,6 +1075,22 @@ static void put_pages_on_daemon_list(struct page_collection *pc)
         }
 }
 
+static void cfs_trace_print_record(struct ptldebug_header *hdr)
+{
+        char *p = (char *)(hdr + 1);
+        char *file;
+        char *fn;
+        int   len;
+
+        file = p;
+        p += strlen(file) + 1;
+        fn = p;
+        p += strlen(fn) + 1;
+        len = hdr->ph_len - (int)(p - (char *)hdr);
+
+        cfs_print_to_console(hdr, D_EMERG, p, len, file, fn);
+}
+
 void cfs_trace_debug_print(void)
 {
         struct page_collection pc;
@@ -644,27 +1103,29 @@ void cfs_trace_debug_print(void)
         collect_pages(&pc);
         cfs_list_for_each_entry_safe_typed(tage, tmp, &pc.pc_pages,
                                            struct cfs_trace_page, linkage) {
-                char *p, *file, *fn;
+                struct ptldebug_header *hdr;
                 cfs_page_t *page;
+                char *p;
+                char *buf;
+                int cut;
 
                 __LASSERT_TAGE_INVARIANT(tage);
 
                 page = tage->page;
                 p = cfs_page_address(page);
                 while (p < ((char *)cfs_page_address(page) + tage->used)) {
-                        struct ptldebug_header *hdr;
-                        int len;
                         hdr = (void *)p;
-                        p += sizeof(*hdr);
-                        file = p;
-                        p += strlen(file) + 1;
-                        fn = p;
-                        p += strlen(fn) + 1;
-                        len = hdr->ph_len - (int)(p - (char *)hdr);
-
-                        cfs_print_to_console(hdr, D_EMERG, p, len, file, fn);
-
-                        p += len;
+                        if (hdr->ph_flags & PH_FLAG_DEFERRED) {
+                                buf = cfs_trace_get_console_buffer();
+                                if (cfs_trace_render(hdr, buf,
+                                                CFS_TRACE_CONSOLE_BUFFER_SIZE,
+                                                &cut) > 0)
+                                        cfs_trace_print_record((void *)buf);
+                                cfs_trace_put_console_buffer(buf);
+                        } else {
+                                cfs_trace_print_record(hdr);
+                        }
+                        p += hdr->ph_len;
                 }
 
                 cfs_list_del(&tage->linkage);
@@ -672,16 +1133,85 @@ void cfs_trace_debug_print(void)
         }
 }
 
+/*
+ * Write the records of \a tage to \a filp at *\a pos.  Deferred records
+ * are formatted into \a scratch, a page, first; they are left out if
+ * \a scratch is NULL.  Returns 0 or the failed write's result.
+ */
+static int cfs_trace_write_tage(cfs_file_t *filp, struct cfs_trace_page *tage,
+                                loff_t *pos, char *scratch)
+{
+        struct ptldebug_header *hdr;
+        char *p = cfs_page_address(tage->page);
+        char *end = p + tage->used;
+        int nob = 0;
+        int len;
+        int cut;
+        int rc;
+
+        if (tage->deferred == 0) {
+                rc = cfs_filp_write(filp, p, tage->used, pos);
+                return rc == (int)tage->used ? 0 : (rc < 0 ? rc : -EIO);
+        }
+
+        while (p < end) {
+                hdr = (void *)p;
+                p += hdr->ph_len;
+
+                if (scratch == NULL) {
+                        if (hdr->ph_flags & PH_FLAG_DEFERRED)
+                                continue;
+                        rc = cfs_filp_write(filp, hdr, hdr->ph_len, pos);
+                        if (rc != (int)hdr->ph_len)
+                                return rc < 0 ? rc : -EIO;
+                        continue;
+                }
+
+                if (!(hdr->ph_flags & PH_FLAG_DEFERRED)) {
+                        len = hdr->ph_len;
+                        cut = nob + len > CFS_PAGE_SIZE;
+                        if (!cut)
+                                memcpy(scratch + nob, hdr, len);
+                } else {
+                        len = cfs_trace_render(hdr, scratch + nob,
+                                               CFS_PAGE_SIZE - nob, &cut);
+                        cut |= len == 0;
+                }
+
+                if (cut && nob > 0) {
+                        /* flush, then retry the record on an empty page */
+                        rc = cfs_filp_write(filp, scratch, nob, pos);
+                        if (rc != nob)
+                                return rc < 0 ? rc : -EIO;
+                        nob = 0;
+                        p = (char *)hdr;
+                        continue;
+                }
+                nob += len;
+        }
+
+        if (nob > 0) {
+                rc = cfs_filp_write(filp, scratch, nob, pos);
+                if (rc != nob)
+                        return rc < 0 ? rc : -EIO;
+        }
+        return 0;
+}
+
 int cfs_tracefile_dump_all_pages(char *filename)
 {
         struct page_collection pc;
         cfs_file_t *filp;
         struct cfs_trace_page *tage;
         struct cfs_trace_page *tmp;
+        char *scratch;
         int rc;
 
         CFS_DECL_MMSPACE;
 
+        /* to format deferred records in */
+        scratch = cfs_alloc(CFS_PAGE_SIZE, CFS_ALLOC_USER);
+
         cfs_tracefile_write_lock();
 
         filp = cfs_filp_open(filename,
@@ -710,11 +1240,11 @@ int cfs_tracefile_dump_all_pages(char *filename)
 
                 __LASSERT_TAGE_INVARIANT(tage);
 
-                rc = cfs_filp_write(filp, cfs_page_address(tage->page),
-                                    tage->used, cfs_filp_poff(filp));
-                if (rc != (int)tage->used) {
-                        printk(CFS_KERN_WARNING "wanted to write %u but wrote "
-                               "%d\n", tage->used, rc);
+                rc = cfs_trace_write_tage(filp, tage, cfs_filp_poff(filp),
+                                          scratch);
+                if (rc != 0) {
+                        printk(CFS_KERN_WARNING "couldn't write trace page: "
+                               "%d\n", rc);
                         put_pages_back(&pc);
                         __LASSERT(cfs_list_empty(&pc.pc_pages));
                         break;
@@ -730,6 +1260,8 @@ int cfs_tracefile_dump_all_pages(char *filename)
         cfs_filp_close(filp);
  out:
         cfs_tracefile_write_unlock();
+        if (scratch != NULL)
+                cfs_free(scratch);
         return rc;
 }
 
@@ -968,6 +1500,23 @@ int cfs_trace_get_debug_mb(void)
         return (total_pages >> (20 - CFS_PAGE_SHIFT)) + 1;
 }
 
+unsigned long cfs_trace_get_deferred(void)
+{
+        int i;
+        int j;
+        struct cfs_trace_cpu_data *tcd;
+        unsigned long deferred = 0;
+
+        cfs_tracefile_read_lock();
+
+        cfs_tcd_for_each(tcd, i, j)
+                deferred += tcd->tcd_deferred;
+
+        cfs_tracefile_read_unlock();
+
+        return deferred;
+}
+
 static int tracefiled(void *arg)
 {
         struct page_collection pc;
@@ -975,6 +1524,7 @@ static int tracefiled(void *arg)
         struct cfs_trace_page *tage;
         struct cfs_trace_page *tmp;
         cfs_file_t *filp;
+        char *scratch;
         int last_loop = 0;
         int rc;
 
@@ -984,6 +1534,9 @@ static int tracefiled(void *arg)
         /* this is so broken in uml?  what on earth is going on? */
         cfs_daemonize("ktracefiled");
 
+        /* to format deferred records in */
+        scratch = cfs_alloc(CFS_PAGE_SIZE, CFS_ALLOC_USER);
+
         cfs_spin_lock_init(&pc.pc_lock);
         cfs_complete(&tctl->tctl_start);
 
@@ -1026,11 +1579,10 @@ static int tracefiled(void *arg)
                         else if (f_pos > (off_t)cfs_filp_size(filp))
                                 f_pos = cfs_filp_size(filp);
 
-                        rc = cfs_filp_write(filp, cfs_page_address(tage->page),
-                                            tage->used, &f_pos);
-                        if (rc != (int)tage->used) {
-                                printk(CFS_KERN_WARNING "wanted to write %u "
-                                       "but wrote %d\n", tage->used, rc);
+                        rc = cfs_trace_write_tage(filp, tage, &f_pos, scratch);
+                        if (rc != 0) {
+                                printk(CFS_KERN_WARNING "couldn't write trace "
+                                       "page: %d\n", rc);
                                 put_pages_back(&pc);
                                 __LASSERT(cfs_list_empty(&pc.pc_pages));
                         }
@@ -1078,6 +1630,8 @@ end_loop:
                                     cfs_time_seconds(1));
                 cfs_waitq_del(&tctl->tctl_waitq, &__wait);
         }
+        if (scratch != NULL)
+                cfs_free(scratch);
         cfs_complete(&tctl->tctl_stop);
         return 0;
 }
@@ -85,6 +85,7 @@ int cfs_trace_daemon_command_usrstr(void *usr_str, int usr_str_nob);
 int cfs_trace_set_debug_mb(int mb);
 int cfs_trace_set_debug_mb_usrstr(void *usr_str, int usr_str_nob);
 int cfs_trace_get_debug_mb(void);
+unsigned long cfs_trace_get_deferred(void);
 
 extern void libcfs_debug_dumplog_internal(void *arg);
 extern void libcfs_register_panic_notifier(void);
@@ -128,6 +129,8 @@ union cfs_trace_data_union {
 		cfs_list_t              tcd_pages;
 		/* number of pages on ->tcd_pages */
 		unsigned long           tcd_cur_pages;
+		/* number of PH_FLAG_DEFERRED records ever written */
+		unsigned long           tcd_deferred;
 
 		/*
 		 * pages with trace records already processed by
@@ -249,6 +252,10 @@ struct cfs_trace_page {
 	 * number of bytes used within this page
 	 */
 	unsigned int         used;
+	/*
+	 * number of PH_FLAG_DEFERRED records within this page
+	 */
+	unsigned int         deferred;
 	/*
 	 * cpu that owns this page
 	 */
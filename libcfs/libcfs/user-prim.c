@@ -194,6 +194,10 @@ void cfs_timer_arm(cfs_timer_t *l, cfs_time_t deadline)
 void cfs_timer_disarm(cfs_timer_t *l)
 {
 }
+
+void cfs_timer_disarm_sync(cfs_timer_t *l)
+{
+}
 cfs_time_t cfs_timer_deadline(cfs_timer_t *l)
 {
         return l->expires;
@@ -480,6 +480,26 @@ void cfs_timer_disarm(cfs_timer_t *timer)
     KeReleaseSpinLock(&(timer->Lock), Irql);
 }
 
+/*
+ * cfs_timer_disarm_sync
+ *   To discard the timer and wait for its callback to finish
+ *
+ * Arguments:
+ *   timer:  the cfs_timer to be discarded
+ *
+ * Return Value:
+ *   N/A
+ *
+ * Notes:
+ *   N/A
+ */
+
+void cfs_timer_disarm_sync(cfs_timer_t *timer)
+{
+    cfs_timer_disarm(timer);
+    KeFlushQueuedDpcs();
+}
+
 
 /*
  * cfs_timer_is_armed
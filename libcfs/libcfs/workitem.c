@@ -50,31 +50,31 @@ typedef struct cfs_wi_sched {
         /** where schedulers sleep */
         cfs_waitq_t     ws_waitq;
 #endif
-        /** concurrent workitems */
-        cfs_list_t      ws_runq;
+        /** concurrent workitems, one queue per priority */
+        cfs_list_t      ws_runq[CFS_WI_PRIO_NR];
         /** rescheduled running-workitems */
         cfs_list_t      ws_rerunq;
+        /** CPU partition, or CFS_CPT_ANY for the serial scheduler */
+        int             ws_cpt;
+        /** # threads */
+        int             ws_nthreads;
         /** shutting down */
         int             ws_shuttingdown;
+        /** # workitems run */
+        __u64           ws_nrun;
+        /** total and longest time workitems waited on ws_runq */
+        __u64           ws_wait_total;
+        cfs_duration_t  ws_wait_max;
+        /** total and longest time workitems ran */
+        __u64           ws_run_total;
+        cfs_duration_t  ws_run_max;
 } cfs_wi_sched_t;
 
-#ifdef __KERNEL__
-/**
- * we have 2 cfs_wi_sched_t so far:
- * one for CFS_WI_SCHED_ANY, another for CFS_WI_SCHED_SERIAL
- * per-cpu implementation will be added for SMP scalability
- */
-
-#define CFS_WI_NSCHED   2
-#else
-/** always 2 for userspace */
-#define CFS_WI_NSCHED   2
-#endif /* __KERNEL__ */
-
 struct cfs_workitem_data {
         /** serialize */
         cfs_spinlock_t  wi_glock;
-        /** number of cfs_wi_sched_t */
+        /** number of cfs_wi_sched_t: one per CPU partition, then the
+         * serial one */
         int             wi_nsched;
         /** number of threads (all schedulers) */
         int             wi_nthreads;
@@ -85,30 +85,43 @@ struct cfs_workitem_data {
 static inline cfs_wi_sched_t *
 cfs_wi_to_sched(cfs_workitem_t *wi)
 {
-        LASSERT(wi->wi_sched_id == CFS_WI_SCHED_ANY ||
-                wi->wi_sched_id == CFS_WI_SCHED_SERIAL ||
-                (wi->wi_sched_id >= 0 &&
-                 wi->wi_sched_id < cfs_wi_data.wi_nsched));
+        int cpt;
 
-        if (wi->wi_sched_id == CFS_WI_SCHED_ANY)
-                return &cfs_wi_data.wi_scheds[0];
         if (wi->wi_sched_id == CFS_WI_SCHED_SERIAL)
                 return &cfs_wi_data.wi_scheds[cfs_wi_data.wi_nsched - 1];
 
-        return &cfs_wi_data.wi_scheds[wi->wi_sched_id];
+        cpt = wi->wi_sched_id == CFS_WI_SCHED_ANY ? wi->wi_cpt :
+                                                    wi->wi_sched_id;
+        LASSERT(cpt >= 0 && cpt < cfs_wi_data.wi_nsched - 1);
+        return &cfs_wi_data.wi_scheds[cpt];
+}
+
+/* the first workitem to run, NULL if there is none */
+static inline cfs_workitem_t *
+cfs_wi_sched_next(cfs_wi_sched_t *sched)
+{
+        int i;
+
+        for (i = 0; i < CFS_WI_PRIO_NR; i++) {
+                if (!cfs_list_empty(&sched->ws_runq[i]))
+                        return cfs_list_entry(sched->ws_runq[i].next,
+                                              cfs_workitem_t, wi_list);
+        }
+        return NULL;
 }
 
 #ifdef __KERNEL__
+/* softirq safe: workitems can be scheduled from timers */
 static inline void
 cfs_wi_sched_lock(cfs_wi_sched_t *sched)
 {
-        cfs_spin_lock(&sched->ws_lock);
+        cfs_spin_lock_bh(&sched->ws_lock);
 }
 
 static inline void
 cfs_wi_sched_unlock(cfs_wi_sched_t *sched)
 {
-        cfs_spin_unlock(&sched->ws_lock);
+        cfs_spin_unlock_bh(&sched->ws_lock);
 }
 
 static inline int
@@ -120,7 +133,7 @@ cfs_wi_sched_cansleep(cfs_wi_sched_t *sched)
                 return 0;
         }
 
-        if (!cfs_list_empty(&sched->ws_runq)) {
+        if (cfs_wi_sched_next(sched) != NULL) {
                 cfs_wi_sched_unlock(sched);
                 return 0;
         }
@@ -128,6 +141,70 @@ cfs_wi_sched_cansleep(cfs_wi_sched_t *sched)
         return 1;
 }
 
+/*
+ * Take a slot of the class of \a wi for it to run, or park it on the
+ * class's blocked list if they are all taken.  Called with the scheduler
+ * lock held, which nests outside wi_glock.
+ */
+static int
+cfs_wi_class_get(cfs_workitem_t *wi)
+{
+        cfs_wi_class_t *wc = wi->wi_class;
+        int             rc = 1;
+
+        cfs_spin_lock(&cfs_wi_data.wi_glock);
+        if (wc->wc_running < wc->wc_max) {
+                wc->wc_running++;
+        } else {
+                cfs_list_add_tail(&wi->wi_list, &wc->wc_blocked);
+                wi->wi_blocked = 1;
+                rc = 0;
+        }
+        cfs_spin_unlock(&cfs_wi_data.wi_glock);
+        return rc;
+}
+
+/*
+ * Release a slot of \a wc, and requeue the first of its blocked workitems
+ * so it can have the slot.  Called without any scheduler lock held.
+ */
+static void
+cfs_wi_class_put(cfs_wi_class_t *wc)
+{
+        cfs_wi_sched_t *sched;
+        cfs_workitem_t *wi;
+
+        cfs_spin_lock(&cfs_wi_data.wi_glock);
+        wc->wc_running--;
+        while (!cfs_list_empty(&wc->wc_blocked) &&
+               wc->wc_running < wc->wc_max) {
+                wi = cfs_list_entry(wc->wc_blocked.next, cfs_workitem_t,
+                                    wi_list);
+                sched = cfs_wi_to_sched(wi);
+                cfs_spin_unlock(&cfs_wi_data.wi_glock);
+
+                /* lock order is sched->ws_lock, then wi_glock */
+                cfs_wi_sched_lock(sched);
+                cfs_spin_lock(&cfs_wi_data.wi_glock);
+                if (wc->wc_blocked.next == &wi->wi_list &&
+                    wc->wc_running < wc->wc_max) {
+                        wi->wi_blocked = 0;
+                        wi->wi_queued = cfs_time_current();
+                        cfs_list_move_tail(&wi->wi_list,
+                                           &sched->ws_runq[wi->wi_prio]);
+                        cfs_waitq_signal(&sched->ws_waitq);
+                        cfs_spin_unlock(&cfs_wi_data.wi_glock);
+                        cfs_wi_sched_unlock(sched);
+                        return;
+                }
+                /* raced with cancel or another release, look again */
+                cfs_spin_unlock(&cfs_wi_data.wi_glock);
+                cfs_wi_sched_unlock(sched);
+                cfs_spin_lock(&cfs_wi_data.wi_glock);
+        }
+        cfs_spin_unlock(&cfs_wi_data.wi_glock);
+}
+
 #else
 
 static inline void
@@ -144,6 +221,55 @@ cfs_wi_sched_unlock(cfs_wi_sched_t *sched)
 
 #endif
 
+/*
+ * Lock the scheduler of \a wi and return it.  An idle CFS_WI_SCHED_ANY
+ * workitem may move to another partition until its scheduler is locked,
+ * so look again once it is.
+ */
+static cfs_wi_sched_t *
+cfs_wi_lock(cfs_workitem_t *wi)
+{
+        cfs_wi_sched_t *sched;
+
+        for (;;) {
+                sched = cfs_wi_to_sched(wi);
+                cfs_wi_sched_lock(sched);
+                if (sched == cfs_wi_to_sched(wi))
+                        return sched;
+                cfs_wi_sched_unlock(sched);
+        }
+}
+
+/* take a scheduled workitem off its queue, called with the scheduler lock */
+static void
+cfs_wi_dequeue(cfs_workitem_t *wi)
+{
+        LASSERT (!cfs_list_empty(&wi->wi_list));
+
+#ifdef __KERNEL__
+        if (wi->wi_blocked) {
+                cfs_spin_lock(&cfs_wi_data.wi_glock);
+                cfs_list_del_init(&wi->wi_list);
+                wi->wi_blocked = 0;
+                cfs_spin_unlock(&cfs_wi_data.wi_glock);
+                return;
+        }
+#endif
+        cfs_list_del_init(&wi->wi_list);
+}
+
+void
+cfs_wi_class_init(cfs_wi_class_t *wc, const char *name, int max)
+{
+        LASSERT (max > 0);
+
+        wc->wc_name    = name;
+        wc->wc_max     = max;
+        wc->wc_running = 0;
+        CFS_INIT_LIST_HEAD(&wc->wc_blocked);
+}
+CFS_EXPORT_SYMBOL(cfs_wi_class_init);
+
 /* XXX:
  * 0. it only works when called from wi->wi_action.
  * 1. when it returns no one shall try to schedule the workitem.
@@ -161,10 +287,8 @@ cfs_wi_exit(cfs_workitem_t *wi)
 #ifdef __KERNEL__
         LASSERT (wi->wi_running);
 #endif
-        if (wi->wi_scheduled) { /* cancel pending schedules */
-                LASSERT (!cfs_list_empty(&wi->wi_list));
-                cfs_list_del_init(&wi->wi_list);
-        }
+        if (wi->wi_scheduled) /* cancel pending schedules */
+                cfs_wi_dequeue(wi);
 
         LASSERT (cfs_list_empty(&wi->wi_list));
         wi->wi_scheduled = 1; /* LBUG future schedule attempts */
@@ -180,13 +304,13 @@ CFS_EXPORT_SYMBOL(cfs_wi_exit);
 int
 cfs_wi_cancel (cfs_workitem_t *wi)
 {
-        cfs_wi_sched_t *sched = cfs_wi_to_sched(wi);
+        cfs_wi_sched_t *sched;
         int             rc;
 
         LASSERT (!cfs_in_interrupt()); /* because we use plain spinlock */
-        LASSERT (!sched->ws_shuttingdown);
 
-        cfs_wi_sched_lock(sched);
+        sched = cfs_wi_lock(wi);
+        LASSERT (!sched->ws_shuttingdown);
         /*
          * return 0 if it's running already, otherwise return 1, which
          * means the workitem will not be scheduled and will not have
@@ -195,8 +319,7 @@ cfs_wi_cancel (cfs_workitem_t *wi)
         rc = !(wi->wi_running);
 
         if (wi->wi_scheduled) { /* cancel pending schedules */
-                LASSERT (!cfs_list_empty(&wi->wi_list));
-                cfs_list_del_init(&wi->wi_list);
+                cfs_wi_dequeue(wi);
                 wi->wi_scheduled = 0;
         }
 
@@ -208,6 +331,19 @@ cfs_wi_cancel (cfs_workitem_t *wi)
 
 CFS_EXPORT_SYMBOL(cfs_wi_cancel);
 
+/**
+ * Cancel a workitem and wait for it to complete if it is running.  Nothing
+ * may schedule it any more when this is called.
+ */
+void
+cfs_wi_cancel_sync(cfs_workitem_t *wi)
+{
+        while (!cfs_wi_cancel(wi))
+                cfs_pause(cfs_time_seconds(1) / 100 + 1);
+}
+
+CFS_EXPORT_SYMBOL(cfs_wi_cancel_sync);
+
 /*
  * Workitem scheduled with (serial == 1) is strictly serialised not only with
  * itself, but also with others scheduled this way.
@@ -218,19 +354,32 @@ CFS_EXPORT_SYMBOL(cfs_wi_cancel);
 void
 cfs_wi_schedule(cfs_workitem_t *wi)
 {
-        cfs_wi_sched_t *sched = cfs_wi_to_sched(wi);
+        cfs_wi_sched_t *sched = cfs_wi_lock(wi);
+        int             cpt;
 
-        LASSERT (!cfs_in_interrupt()); /* because we use plain spinlock */
         LASSERT (!sched->ws_shuttingdown);
 
-        cfs_wi_sched_lock(sched);
+        if (wi->wi_sched_id == CFS_WI_SCHED_ANY &&
+            !wi->wi_scheduled && !wi->wi_running) {
+                /* idle and unbound: run it on this partition.  Once it
+                 * moves, whoever locks the new scheduler first queues it */
+                cpt = cfs_cpt_current();
+                if (cpt != wi->wi_cpt) {
+                        wi->wi_cpt = cpt;
+                        cfs_wi_sched_unlock(sched);
+                        sched = cfs_wi_lock(wi);
+                        LASSERT (!sched->ws_shuttingdown);
+                }
+        }
 
         if (!wi->wi_scheduled) {
                 LASSERT (cfs_list_empty(&wi->wi_list));
 
                 wi->wi_scheduled = 1;
                 if (!wi->wi_running) {
-                        cfs_list_add_tail(&wi->wi_list, &sched->ws_runq);
+                        wi->wi_queued = cfs_time_current();
+                        cfs_list_add_tail(&wi->wi_list,
+                                          &sched->ws_runq[wi->wi_prio]);
 #ifdef __KERNEL__
                         cfs_waitq_signal(&sched->ws_waitq);
 #endif
@@ -251,19 +400,23 @@ CFS_EXPORT_SYMBOL(cfs_wi_schedule);
 static int
 cfs_wi_scheduler (void *arg)
 {
-        int             id     = (int)(long_ptr_t) arg;
-        int             serial = (id == -1);
+        cfs_wi_sched_t *sched = (cfs_wi_sched_t *)arg;
+        cfs_time_t      start;
+        cfs_duration_t  d;
         char            name[24];
-        cfs_wi_sched_t *sched;
+        int             id;
 
-        if (serial) {
-                sched = &cfs_wi_data.wi_scheds[cfs_wi_data.wi_nsched - 1];
+        cfs_wi_sched_lock(sched);
+        id = sched->ws_nthreads++;
+        cfs_wi_sched_unlock(sched);
+
+        if (sched->ws_cpt == CFS_CPT_ANY) {
                 cfs_daemonize("wi_serial_sd");
         } else {
-                /* will be sched = &cfs_wi_data.wi_scheds[id] in the future */
-                sched = &cfs_wi_data.wi_scheds[0];
-                snprintf(name, sizeof(name), "cfs_wi_sd%03d", id);
+                snprintf(name, sizeof(name), "cfs_wi_sd%02d_%02d",
+                         sched->ws_cpt, id);
                 cfs_daemonize(name);
+                cfs_cpt_bind(sched->ws_cpt);
         }
 
         cfs_block_allsigs();
@@ -274,23 +427,43 @@ cfs_wi_scheduler (void *arg)
                 int             nloops = 0;
                 int             rc;
                 cfs_workitem_t *wi;
+                cfs_wi_class_t *wc;
 
-                while (!cfs_list_empty(&sched->ws_runq) &&
+                while ((wi = cfs_wi_sched_next(sched)) != NULL &&
                        nloops < CFS_WI_RESCHED) {
-                        wi = cfs_list_entry(sched->ws_runq.next,
-                                            cfs_workitem_t, wi_list);
                         LASSERT (wi->wi_scheduled && !wi->wi_running);
 
                         cfs_list_del_init(&wi->wi_list);
 
+                        wc = wi->wi_class;
+                        if (wc != NULL && !cfs_wi_class_get(wi))
+                                continue;
+
                         wi->wi_running   = 1;
                         wi->wi_scheduled = 0;
+
+                        start = cfs_time_current();
+                        d = cfs_time_sub(start, wi->wi_queued);
+                        sched->ws_wait_total += d;
+                        if (d > sched->ws_wait_max)
+                                sched->ws_wait_max = d;
+                        sched->ws_nrun++;
+
                         cfs_wi_sched_unlock(sched);
                         nloops++;
 
                         rc = (*wi->wi_action) (wi);
 
+                        /* wi may be gone if rc != 0, don't look at it */
+                        if (wc != NULL)
+                                cfs_wi_class_put(wc);
+
                         cfs_wi_sched_lock(sched);
+                        d = cfs_time_sub(cfs_time_current(), start);
+                        sched->ws_run_total += d;
+                        if (d > sched->ws_run_max)
+                                sched->ws_run_max = d;
+
                         if (rc != 0) /* WI should be dead, even be freed! */
                                 continue;
 
@@ -301,10 +474,12 @@ cfs_wi_scheduler (void *arg)
                         LASSERT (wi->wi_scheduled);
                         /* wi is rescheduled, should be on rerunq now, we
                          * move it to runq so it can run action now */
-                        cfs_list_move_tail(&wi->wi_list, &sched->ws_runq);
+                        wi->wi_queued = cfs_time_current();
+                        cfs_list_move_tail(&wi->wi_list,
+                                           &sched->ws_runq[wi->wi_prio]);
                 }
 
-                if (!cfs_list_empty(&sched->ws_runq)) {
+                if (cfs_wi_sched_next(sched) != NULL) {
                         cfs_wi_sched_unlock(sched);
                         /* don't sleep because some workitems still
                          * expect me to come back soon */
@@ -319,6 +494,7 @@ cfs_wi_scheduler (void *arg)
                 cfs_wi_sched_lock(sched);
         }
 
+        sched->ws_nthreads--;
         cfs_wi_sched_unlock(sched);
 
         cfs_spin_lock(&cfs_wi_data.wi_glock);
@@ -332,16 +508,96 @@ cfs_wi_start_thread (int (*func) (void*), void *arg)
 {
         long pid;
 
+        cfs_spin_lock(&cfs_wi_data.wi_glock);
+        cfs_wi_data.wi_nthreads++;
+        cfs_spin_unlock(&cfs_wi_data.wi_glock);
+
         pid = cfs_kernel_thread(func, arg, 0);
-        if (pid < 0)
-                return (int)pid;
+        if (pid >= 0)
+                return 0;
 
         cfs_spin_lock(&cfs_wi_data.wi_glock);
-        cfs_wi_data.wi_nthreads++;
+        cfs_wi_data.wi_nthreads--;
         cfs_spin_unlock(&cfs_wi_data.wi_glock);
-        return 0;
+        return (int)pid;
+}
+
+static unsigned int
+cfs_wi_duration_ms(__u64 d)
+{
+        d *= 1000;
+        do_div(d, CFS_HZ);
+        return (unsigned int)d;
+}
+
+/**
+ * Print a line per scheduler: its threads, queued workitems and how
+ * long workitems waited and ran, in milliseconds.  Returns the length.
+ */
+int
+cfs_wi_stats_print(char *buf, int size)
+{
+        cfs_wi_sched_t *sched;
+        cfs_list_t     *pos;
+        char            name[16];
+        int             queued[CFS_WI_PRIO_NR];
+        __u64           nrun;
+        __u64           wait_total;
+        __u64           run_total;
+        cfs_duration_t  wait_max;
+        cfs_duration_t  run_max;
+        int             nob;
+        int             i;
+        int             j;
+
+        nob = snprintf(buf, size, "%-8s %7s %7s %7s %7s %12s %9s %9s "
+                       "%9s %9s\n", "sched", "threads", "high", "normal",
+                       "low", "run", "wait_avg", "wait_max", "run_avg",
+                       "run_max");
+
+        for (i = 0; i < cfs_wi_data.wi_nsched && nob < size; i++) {
+                sched = &cfs_wi_data.wi_scheds[i];
+
+                cfs_wi_sched_lock(sched);
+                for (j = 0; j < CFS_WI_PRIO_NR; j++) {
+                        queued[j] = 0;
+                        cfs_list_for_each(pos, &sched->ws_runq[j])
+                                queued[j]++;
+                }
+                nrun       = sched->ws_nrun;
+                wait_total = sched->ws_wait_total;
+                wait_max   = sched->ws_wait_max;
+                run_total  = sched->ws_run_total;
+                run_max    = sched->ws_run_max;
+                cfs_wi_sched_unlock(sched);
+
+                if (sched->ws_cpt == CFS_CPT_ANY)
+                        snprintf(name, sizeof(name), "serial");
+                else
+                        snprintf(name, sizeof(name), "cpt%d", sched->ws_cpt);
+
+                if (nrun != 0) {
+                        do_div(wait_total, nrun);
+                        do_div(run_total, nrun);
+                }
+
+                nob += snprintf(buf + nob, size - nob,
+                                "%-8s %7d %7d %7d %7d %12llu %9u %9u "
+                                "%9u %9u\n", name, sched->ws_nthreads,
+                                queued[CFS_WI_PRIO_HIGH],
+                                queued[CFS_WI_PRIO_NORMAL],
+                                queued[CFS_WI_PRIO_LOW],
+                                (unsigned long long)nrun,
+                                cfs_wi_duration_ms(wait_total),
+                                cfs_wi_duration_ms(wait_max),
+                                cfs_wi_duration_ms(run_total),
+                                cfs_wi_duration_ms(run_max));
+        }
+        return min(nob, size);
 }
 
+CFS_EXPORT_SYMBOL(cfs_wi_stats_print);
+
 #else /* __KERNEL__ */
 
 int
@@ -349,20 +605,22 @@ cfs_wi_check_events (void)
 {
         int               n = 0;
         cfs_workitem_t   *wi;
-        cfs_list_t       *q;
+        int               i;
 
         cfs_spin_lock(&cfs_wi_data.wi_glock);
 
         for (;;) {
-                /** rerunq is always empty for userspace */
-                if (!cfs_list_empty(&cfs_wi_data.wi_scheds[1].ws_runq))
-                        q = &cfs_wi_data.wi_scheds[1].ws_runq;
-                else if (!cfs_list_empty(&cfs_wi_data.wi_scheds[0].ws_runq))
-                        q = &cfs_wi_data.wi_scheds[0].ws_runq;
-                else
+                /** rerunq is always empty for userspace, the serial
+                 * scheduler goes first */
+                wi = NULL;
+                for (i = cfs_wi_data.wi_nsched - 1; i >= 0; i--) {
+                        wi = cfs_wi_sched_next(&cfs_wi_data.wi_scheds[i]);
+                        if (wi != NULL)
+                                break;
+                }
+                if (wi == NULL)
                         break;
 
-                wi = cfs_list_entry(q->next, cfs_workitem_t, wi_list);
                 cfs_list_del_init(&wi->wi_list);
 
                 LASSERT (wi->wi_scheduled);
@@ -382,14 +640,18 @@ cfs_wi_check_events (void)
 #endif
 
 static void
-cfs_wi_sched_init(cfs_wi_sched_t *sched)
+cfs_wi_sched_init(cfs_wi_sched_t *sched, int cpt)
 {
-        sched->ws_shuttingdown = 0;
+        int i;
+
+        memset(sched, 0, sizeof(*sched));
+        sched->ws_cpt = cpt;
 #ifdef __KERNEL__
         cfs_spin_lock_init(&sched->ws_lock);
         cfs_waitq_init(&sched->ws_waitq);
 #endif
-        CFS_INIT_LIST_HEAD(&sched->ws_runq);
+        for (i = 0; i < CFS_WI_PRIO_NR; i++)
+                CFS_INIT_LIST_HEAD(&sched->ws_runq[i]);
         CFS_INIT_LIST_HEAD(&sched->ws_rerunq);
 }
 
@@ -398,7 +660,7 @@ cfs_wi_sched_shutdown(cfs_wi_sched_t *sched)
 {
         cfs_wi_sched_lock(sched);
 
-        LASSERT(cfs_list_empty(&sched->ws_runq));
+        LASSERT(cfs_wi_sched_next(sched) == NULL);
         LASSERT(cfs_list_empty(&sched->ws_rerunq));
 
         sched->ws_shuttingdown = 1;
@@ -413,34 +675,44 @@ cfs_wi_sched_shutdown(cfs_wi_sched_t *sched)
 int
 cfs_wi_startup (void)
 {
-        int i;
+#ifdef __KERNEL__
+        cfs_wi_sched_t *sched;
         int n;
         int rc;
+#endif
+        int i;
 
         cfs_wi_data.wi_nthreads = 0;
-        cfs_wi_data.wi_nsched   = CFS_WI_NSCHED;
+        cfs_wi_data.wi_nsched   = cfs_cpt_number() + 1;
         LIBCFS_ALLOC(cfs_wi_data.wi_scheds,
                      cfs_wi_data.wi_nsched * sizeof(cfs_wi_sched_t));
         if (cfs_wi_data.wi_scheds == NULL)
                 return -ENOMEM;
 
         cfs_spin_lock_init(&cfs_wi_data.wi_glock);
-        for (i = 0; i < cfs_wi_data.wi_nsched; i++)
-                cfs_wi_sched_init(&cfs_wi_data.wi_scheds[i]);
+        for (i = 0; i < cfs_wi_data.wi_nsched - 1; i++)
+                cfs_wi_sched_init(&cfs_wi_data.wi_scheds[i], i);
+        cfs_wi_sched_init(&cfs_wi_data.wi_scheds[i], CFS_CPT_ANY);
 
 #ifdef __KERNEL__
-        n = cfs_num_online_cpus();
-        for (i = 0; i <= n; i++) {
-                rc = cfs_wi_start_thread(cfs_wi_scheduler,
-                                         (void *)(long_ptr_t)(i == n ? -1 : i));
-                if (rc != 0) {
-                        CERROR ("Can't spawn workitem scheduler: %d\n", rc);
-                        cfs_wi_shutdown();
-                        return rc;
+        for (i = 0; i < cfs_wi_data.wi_nsched; i++) {
+                sched = &cfs_wi_data.wi_scheds[i];
+                /* a thread per CPU of the partition, one serial thread */
+                if (sched->ws_cpt == CFS_CPT_ANY)
+                        n = 1;
+                else
+                        n = max(cfs_cpt_weight(sched->ws_cpt), 1);
+
+                while (n-- > 0) {
+                        rc = cfs_wi_start_thread(cfs_wi_scheduler, sched);
+                        if (rc != 0) {
+                                CERROR ("Can't spawn workitem scheduler: "
+                                        "%d\n", rc);
+                                cfs_wi_shutdown();
+                                return rc;
+                        }
                 }
         }
-#else
-        n = rc = 0;
 #endif
 
         return 0;
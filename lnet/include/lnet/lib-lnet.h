@@ -95,9 +95,98 @@ lnet_match_to_hash(lnet_process_id_t id, __u64 mbits)
         return cfs_hash_long((unsigned long)mbits, LNET_PORTAL_HASH_BITS);
 }
 
+/*
+ * LNet state is protected by two sets of per-CPU-partition locks, which are
+ * never nested in each other:
+ *
+ *  - lnet_net_lock(cpt) protects the peers hashing to \a cpt (see
+ *    lnet_cpt_of_nid()), their credits, the NI send credits of \a cpt and
+ *    the messages committed to \a cpt together with their counters.
+ *  - lnet_res_lock(cpt) protects the MDs and MEs of \a cpt and the portals
+ *    whose index maps to \a cpt (see lnet_ptl_cpt()).
+ *
+ * Passing LNET_LOCK_EX takes every lock of the set, which is needed to change
+ * the state all partitions only read: NIs, routes, router buffers, the test
+ * peers and the EQs.  LNET_LOCK() is the exclusive net lock, for slow paths.
+ *
+ * lnet_eq_wait_lock() nests inside the res locks and serialises EQ events
+ * with the threads polling for them.
+ *
+ * Userspace only has one partition and one lock of each kind.
+ */
+#define LNET_LOCK_EX       CFS_CPT_ANY
+
 #ifdef __KERNEL__
-#define LNET_LOCK()        cfs_spin_lock(&the_lnet.ln_lock)
-#define LNET_UNLOCK()      cfs_spin_unlock(&the_lnet.ln_lock)
+/*
+ * The locks of a set share one lock class, so LNET_LOCK_EX tells them apart
+ * to lockdep by subclass.  There are only MAX_LOCKDEP_SUBCLASSES of those;
+ * the locks past that are taken with lockdep off, which also keeps the held
+ * lock count below MAX_LOCK_DEPTH on machines with many partitions.
+ */
+static inline void
+lnet_cpt_lock_ex_one(cfs_spinlock_t *lock, int i)
+{
+#ifdef MAX_LOCKDEP_SUBCLASSES
+        if (i >= MAX_LOCKDEP_SUBCLASSES) {
+                cfs_lockdep_off();
+                cfs_spin_lock(lock);
+                cfs_lockdep_on();
+                return;
+        }
+#endif
+        cfs_spin_lock_nested(lock, i);
+}
+
+static inline void
+lnet_cpt_unlock_ex_one(cfs_spinlock_t *lock, int i)
+{
+#ifdef MAX_LOCKDEP_SUBCLASSES
+        if (i >= MAX_LOCKDEP_SUBCLASSES) {
+                cfs_lockdep_off();
+                cfs_spin_unlock(lock);
+                cfs_lockdep_on();
+                return;
+        }
+#endif
+        cfs_spin_unlock(lock);
+}
+
+static inline void
+lnet_cpt_lock(lnet_cpt_lock_t *locks, int cpt)
+{
+        int i;
+
+        if (cpt != LNET_LOCK_EX) {
+                LASSERT (cpt >= 0 && cpt < the_lnet.ln_cpt_number);
+                cfs_spin_lock(&locks[cpt].cl_lock);
+                return;
+        }
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                lnet_cpt_lock_ex_one(&locks[i].cl_lock, i);
+}
+
+static inline void
+lnet_cpt_unlock(lnet_cpt_lock_t *locks, int cpt)
+{
+        int i;
+
+        if (cpt != LNET_LOCK_EX) {
+                cfs_spin_unlock(&locks[cpt].cl_lock);
+                return;
+        }
+
+        for (i = the_lnet.ln_cpt_number - 1; i >= 0; i--)
+                lnet_cpt_unlock_ex_one(&locks[i].cl_lock, i);
+}
+
+#define lnet_net_lock(cpt)      lnet_cpt_lock(the_lnet.ln_net_locks, cpt)
+#define lnet_net_unlock(cpt)    lnet_cpt_unlock(the_lnet.ln_net_locks, cpt)
+#define lnet_res_lock(cpt)      lnet_cpt_lock(the_lnet.ln_res_locks, cpt)
+#define lnet_res_unlock(cpt)    lnet_cpt_unlock(the_lnet.ln_res_locks, cpt)
+#define lnet_eq_wait_lock()     cfs_spin_lock(&the_lnet.ln_eq_wait_lock)
+#define lnet_eq_wait_unlock()   cfs_spin_unlock(&the_lnet.ln_eq_wait_lock)
+
 #define LNET_MUTEX_DOWN(m) cfs_mutex_down(m)
 #define LNET_MUTEX_UP(m)   cfs_mutex_up(m)
 #else
@@ -114,18 +203,119 @@ do {                                            \
         (l) = 0;                                \
 } while (0)
 
-#define LNET_LOCK()        LNET_SINGLE_THREADED_LOCK(the_lnet.ln_lock)
-#define LNET_UNLOCK()      LNET_SINGLE_THREADED_UNLOCK(the_lnet.ln_lock)
+/* there's a single partition in userspace: \a cpt is only evaluated */
+#define lnet_net_lock(cpt)                                              \
+do {                                                                    \
+        (void)(cpt);                                                    \
+        LNET_SINGLE_THREADED_LOCK(the_lnet.ln_net_lock);                \
+} while (0)
+
+#define lnet_net_unlock(cpt)                                            \
+do {                                                                    \
+        (void)(cpt);                                                    \
+        LNET_SINGLE_THREADED_UNLOCK(the_lnet.ln_net_lock);              \
+} while (0)
+
+#define lnet_res_lock(cpt)                                              \
+do {                                                                    \
+        (void)(cpt);                                                    \
+        LNET_SINGLE_THREADED_LOCK(the_lnet.ln_res_lock);                \
+} while (0)
+
+#define lnet_res_unlock(cpt)                                            \
+do {                                                                    \
+        (void)(cpt);                                                    \
+        LNET_SINGLE_THREADED_UNLOCK(the_lnet.ln_res_lock);              \
+} while (0)
+
+#define lnet_eq_wait_lock()     LNET_SINGLE_THREADED_LOCK(the_lnet.ln_eq_wait_lock)
+#define lnet_eq_wait_unlock()   LNET_SINGLE_THREADED_UNLOCK(the_lnet.ln_eq_wait_lock)
 #define LNET_MUTEX_DOWN(m) LNET_SINGLE_THREADED_LOCK(*(m))
 #define LNET_MUTEX_UP(m)   LNET_SINGLE_THREADED_UNLOCK(*(m))
 # else
-#define LNET_LOCK()        pthread_mutex_lock(&the_lnet.ln_lock)
-#define LNET_UNLOCK()      pthread_mutex_unlock(&the_lnet.ln_lock)
+/* there's a single partition in userspace: \a cpt is only evaluated */
+#define lnet_net_lock(cpt)      ((void)(cpt),                           \
+                                 pthread_mutex_lock(&the_lnet.ln_net_lock))
+#define lnet_net_unlock(cpt)    ((void)(cpt),                           \
+                                 pthread_mutex_unlock(&the_lnet.ln_net_lock))
+#define lnet_res_lock(cpt)      ((void)(cpt),                           \
+                                 pthread_mutex_lock(&the_lnet.ln_res_lock))
+#define lnet_res_unlock(cpt)    ((void)(cpt),                           \
+                                 pthread_mutex_unlock(&the_lnet.ln_res_lock))
+#define lnet_eq_wait_lock()     pthread_mutex_lock(&the_lnet.ln_eq_wait_lock)
+#define lnet_eq_wait_unlock()   pthread_mutex_unlock(&the_lnet.ln_eq_wait_lock)
 #define LNET_MUTEX_DOWN(m) pthread_mutex_lock(m)
 #define LNET_MUTEX_UP(m)   pthread_mutex_unlock(m)
 # endif
 #endif
 
+#define LNET_LOCK()        lnet_net_lock(LNET_LOCK_EX)
+#define LNET_UNLOCK()      lnet_net_unlock(LNET_LOCK_EX)
+
+/* drop the net lock of partition \a cpt and take the one of \a cpt2, which
+ * is returned */
+static inline int
+lnet_net_relock(int cpt, int cpt2)
+{
+        if (cpt != cpt2) {
+                lnet_net_unlock(cpt);
+                lnet_net_lock(cpt2);
+        }
+        return cpt2;
+}
+
+static inline int
+lnet_cpt_current(void)
+{
+        if (the_lnet.ln_cpt_number == 1)
+                return 0;
+
+        return cfs_cpt_current();
+}
+
+/* take the net lock of the current CPU's partition, which is returned */
+static inline int
+lnet_net_lock_current(void)
+{
+        int cpt = lnet_cpt_current();
+
+        lnet_net_lock(cpt);
+        return cpt;
+}
+
+/* the partition of the peer table, credits and counters of \a nid */
+static inline int
+lnet_cpt_of_nid(lnet_nid_t nid)
+{
+        unsigned long key = (unsigned long)LNET_NIDADDR(nid);
+
+        if (the_lnet.ln_cpt_number == 1)
+                return 0;
+
+        key = cfs_hash_long(key, the_lnet.ln_cpt_bits);
+        /* the number of partitions needn't be a power of 2 */
+        return (unsigned int)key % the_lnet.ln_cpt_number;
+}
+
+/* the partition of the resource (MD, ME or EQ) \a cookie refers to */
+static inline int
+lnet_cpt_of_cookie(__u64 cookie)
+{
+        unsigned int cpt = (unsigned int)(cookie >> LNET_COOKIE_TYPE_BITS) &
+                           ((1U << the_lnet.ln_cpt_bits) - 1);
+
+        /* a bogus cookie from the wire can carry any bits */
+        return cpt < the_lnet.ln_cpt_number ?
+               cpt : cpt % the_lnet.ln_cpt_number;
+}
+
+/* the res lock partition protecting portal \a index */
+static inline int
+lnet_ptl_cpt(unsigned int index)
+{
+        return index % the_lnet.ln_cpt_number;
+}
+
 #define MAX_PORTALS     64
 
 #ifdef LNET_USE_LIB_FREELIST
@@ -162,12 +352,12 @@ lnet_freelist_free (lnet_freelist_t *fl, void *obj)
 static inline lnet_eq_t *
 lnet_eq_alloc (void)
 {
-        /* NEVER called with liblock held */
+        /* NEVER called with the res lock held */
         lnet_eq_t     *eq;
 
-        LNET_LOCK();
+        lnet_res_lock(0);
         eq = (lnet_eq_t *)lnet_freelist_alloc(&the_lnet.ln_free_eqs);
-        LNET_UNLOCK();
+        lnet_res_unlock(0);
 
         return (eq);
 }
@@ -175,19 +365,19 @@ lnet_eq_alloc (void)
 static inline void
 lnet_eq_free (lnet_eq_t *eq)
 {
-        /* ALWAYS called with liblock held */
+        /* ALWAYS called with the res lock held */
         lnet_freelist_free(&the_lnet.ln_free_eqs, eq);
 }
 
 static inline lnet_libmd_t *
 lnet_md_alloc (lnet_md_t *umd)
 {
-        /* NEVER called with liblock held */
+        /* NEVER called with the res lock held */
         lnet_libmd_t  *md;
 
-        LNET_LOCK();
+        lnet_res_lock(0);
         md = (lnet_libmd_t *)lnet_freelist_alloc(&the_lnet.ln_free_mds);
-        LNET_UNLOCK();
+        lnet_res_unlock(0);
 
         if (md != NULL)
                 CFS_INIT_LIST_HEAD(&md->md_list);
@@ -198,19 +388,19 @@ lnet_md_alloc (lnet_md_t *umd)
 static inline void
 lnet_md_free (lnet_libmd_t *md)
 {
-        /* ALWAYS called with liblock held */
+        /* ALWAYS called with the res lock held */
         lnet_freelist_free (&the_lnet.ln_free_mds, md);
 }
 
 static inline lnet_me_t *
 lnet_me_alloc (void)
 {
-        /* NEVER called with liblock held */
+        /* NEVER called with the res lock held */
         lnet_me_t     *me;
 
-        LNET_LOCK();
+        lnet_res_lock(0);
         me = (lnet_me_t *)lnet_freelist_alloc(&the_lnet.ln_free_mes);
-        LNET_UNLOCK();
+        lnet_res_unlock(0);
 
         return (me);
 }
@@ -218,19 +408,19 @@ lnet_me_alloc (void)
 static inline void
 lnet_me_free (lnet_me_t *me)
 {
-        /* ALWAYS called with liblock held */
+        /* ALWAYS called with the res lock held */
         lnet_freelist_free (&the_lnet.ln_free_mes, me);
 }
 
 static inline lnet_msg_t *
 lnet_msg_alloc (void)
 {
-        /* NEVER called with liblock held */
+        /* NEVER called with the net lock held */
         lnet_msg_t    *msg;
 
-        LNET_LOCK();
+        lnet_net_lock(0);
         msg = (lnet_msg_t *)lnet_freelist_alloc(&the_lnet.ln_free_msgs);
-        LNET_UNLOCK();
+        lnet_net_unlock(0);
 
         if (msg != NULL) {
                 /* NULL pointers, clear flags etc */
@@ -243,13 +433,22 @@ lnet_msg_alloc (void)
 }
 
 static inline void
-lnet_msg_free (lnet_msg_t *msg)
+lnet_msg_free_locked (lnet_msg_t *msg)
 {
-        /* ALWAYS called with liblock held */
+        /* ALWAYS called with net lock held */
         LASSERT (!msg->msg_onactivelist);
         lnet_freelist_free(&the_lnet.ln_free_msgs, msg);
 }
 
+static inline void
+lnet_msg_free (lnet_msg_t *msg)
+{
+        /* NEVER called with net lock held */
+        lnet_net_lock(0);
+        lnet_msg_free_locked(msg);
+        lnet_net_unlock(0);
+}
+
 #else
 
 static inline lnet_eq_t *
@@ -350,14 +549,17 @@ lnet_msg_alloc(void)
 static inline void
 lnet_msg_free(lnet_msg_t *msg)
 {
-        /* ALWAYS called with liblock held */
         LASSERT (!msg->msg_onactivelist);
         LIBCFS_FREE(msg, sizeof(*msg));
 }
+
+#define lnet_msg_free_locked(msg)       lnet_msg_free(msg)
 #endif
 
-extern lnet_libhandle_t *lnet_lookup_cookie (__u64 cookie, int type);
-extern void lnet_initialise_handle (lnet_libhandle_t *lh, int type);
+extern lnet_libhandle_t *lnet_res_lh_lookup(lnet_res_container_t *rec,
+                                            __u64 cookie);
+extern void lnet_res_lh_initialize(lnet_res_container_t *rec,
+                                   lnet_libhandle_t *lh);
 extern void lnet_invalidate_handle (lnet_libhandle_t *lh);
 
 static inline void
@@ -374,9 +576,9 @@ lnet_eq2handle (lnet_handle_eq_t *handle, lnet_eq_t *eq)
 static inline lnet_eq_t *
 lnet_handle2eq (lnet_handle_eq_t *handle)
 {
-        /* ALWAYS called with liblock held */
-        lnet_libhandle_t *lh = lnet_lookup_cookie(handle->cookie,
-                                                  LNET_COOKIE_TYPE_EQ);
+        /* ALWAYS called with a res lock or the eq wait lock held */
+        lnet_libhandle_t *lh = lnet_res_lh_lookup(&the_lnet.ln_eq_container,
+                                                  handle->cookie);
         if (lh == NULL)
                 return (NULL);
 
@@ -392,9 +594,13 @@ lnet_md2handle (lnet_handle_md_t *handle, lnet_libmd_t *md)
 static inline lnet_libmd_t *
 lnet_handle2md (lnet_handle_md_t *handle)
 {
-        /* ALWAYS called with liblock held */
-        lnet_libhandle_t *lh = lnet_lookup_cookie(handle->cookie,
-                                                  LNET_COOKIE_TYPE_MD);
+        /* ALWAYS called with res lock lnet_cpt_of_cookie(handle->cookie)
+         * held */
+        int               cpt = lnet_cpt_of_cookie(handle->cookie);
+        lnet_libhandle_t *lh;
+
+        lh = lnet_res_lh_lookup(the_lnet.ln_md_containers[cpt],
+                                handle->cookie);
         if (lh == NULL)
                 return (NULL);
 
@@ -404,14 +610,17 @@ lnet_handle2md (lnet_handle_md_t *handle)
 static inline lnet_libmd_t *
 lnet_wire_handle2md (lnet_handle_wire_t *wh)
 {
-        /* ALWAYS called with liblock held */
+        /* ALWAYS called with res lock lnet_cpt_of_cookie(wh_object_cookie)
+         * held */
         lnet_libhandle_t *lh;
+        int               cpt;
 
         if (wh->wh_interface_cookie != the_lnet.ln_interface_cookie)
                 return (NULL);
 
-        lh = lnet_lookup_cookie(wh->wh_object_cookie,
-                                LNET_COOKIE_TYPE_MD);
+        cpt = lnet_cpt_of_cookie(wh->wh_object_cookie);
+        lh = lnet_res_lh_lookup(the_lnet.ln_md_containers[cpt],
+                                wh->wh_object_cookie);
         if (lh == NULL)
                 return (NULL);
 
@@ -427,9 +636,13 @@ lnet_me2handle (lnet_handle_me_t *handle, lnet_me_t *me)
 static inline lnet_me_t *
 lnet_handle2me (lnet_handle_me_t *handle)
 {
-        /* ALWAYS called with liblock held */
-        lnet_libhandle_t *lh = lnet_lookup_cookie(handle->cookie,
-                                                  LNET_COOKIE_TYPE_ME);
+        /* ALWAYS called with res lock lnet_cpt_of_cookie(handle->cookie)
+         * held */
+        int               cpt = lnet_cpt_of_cookie(handle->cookie);
+        lnet_libhandle_t *lh;
+
+        lh = lnet_res_lh_lookup(the_lnet.ln_me_containers[cpt],
+                                handle->cookie);
         if (lh == NULL)
                 return (NULL);
 
@@ -475,18 +688,24 @@ lnet_match_is_unique(lnet_process_id_t match_id,
                match_id.pid != LNET_PID_ANY;
 }
 
+/* a unique portal hashes the MEs which match a single peer and exact match
+ * bits, any other ME lives on ptl_mlist */
+static inline int
+lnet_portal_me_is_hashed(lnet_portal_t *ptl, lnet_me_t *me)
+{
+        return lnet_portal_is_unique(ptl) &&
+               lnet_match_is_unique(me->me_match_id,
+                                    me->me_match_bits, me->me_ignore_bits);
+}
+
 static inline cfs_list_t *
-lnet_portal_me_head(int index, lnet_process_id_t id, __u64 mbits)
+lnet_portal_mhash_head(lnet_portal_t *ptl, lnet_process_id_t id, __u64 mbits)
 {
-        lnet_portal_t *ptl = &the_lnet.ln_portals[index];
+        if (!lnet_portal_is_unique(ptl))
+                return NULL;
 
-        if (lnet_portal_is_wildcard(ptl)) {
-                return &ptl->ptl_mlist;
-        } else if (lnet_portal_is_unique(ptl)) {
-                LASSERT (ptl->ptl_mhash != NULL);
-                return &ptl->ptl_mhash[lnet_match_to_hash(id, mbits)];
-        }
-        return NULL;
+        LASSERT (ptl->ptl_mhash != NULL);
+        return &ptl->ptl_mhash[lnet_match_to_hash(id, mbits)];
 }
 
 cfs_list_t *lnet_portal_mhash_alloc(void);
@@ -516,36 +735,44 @@ lnet_isrouter(lnet_peer_t *lp)
         return lp->lp_rtr_refcount != 0;
 }
 
+/* NI references are counted per partition, under the net lock of \a cpt
+ * (any partition will do when holding LNET_LOCK_EX).  Only the sum of the
+ * counters means anything: a reference taken on one partition may be
+ * dropped on another.  lnet_shutdown_lndnis() waits for it to drop to 0. */
 static inline void
-lnet_ni_addref_locked(lnet_ni_t *ni)
+lnet_ni_addref_locked(lnet_ni_t *ni, int cpt)
 {
-        LASSERT (ni->ni_refcount > 0);
-        ni->ni_refcount++;
+        if (cpt == LNET_LOCK_EX)
+                cpt = 0;
+        ni->ni_refs[cpt]++;
 }
 
 static inline void
 lnet_ni_addref(lnet_ni_t *ni)
 {
-        LNET_LOCK();
-        lnet_ni_addref_locked(ni);
-        LNET_UNLOCK();
+        int cpt = lnet_cpt_current();
+
+        lnet_net_lock(cpt);
+        lnet_ni_addref_locked(ni, cpt);
+        lnet_net_unlock(cpt);
 }
 
 static inline void
-lnet_ni_decref_locked(lnet_ni_t *ni)
+lnet_ni_decref_locked(lnet_ni_t *ni, int cpt)
 {
-        LASSERT (ni->ni_refcount > 0);
-        ni->ni_refcount--;
-        if (ni->ni_refcount == 0)
-                cfs_list_add_tail(&ni->ni_list, &the_lnet.ln_zombie_nis);
+        if (cpt == LNET_LOCK_EX)
+                cpt = 0;
+        ni->ni_refs[cpt]--;
 }
 
 static inline void
 lnet_ni_decref(lnet_ni_t *ni)
 {
-        LNET_LOCK();
-        lnet_ni_decref_locked(ni);
-        LNET_UNLOCK();
+        int cpt = lnet_cpt_current();
+
+        lnet_net_lock(cpt);
+        lnet_ni_decref_locked(ni, cpt);
+        lnet_net_unlock(cpt);
 }
 
 static inline cfs_list_t *
@@ -553,7 +780,7 @@ lnet_nid2peerhash (lnet_nid_t nid)
 {
         unsigned int idx = LNET_NIDADDR(nid) % LNET_PEER_HASHSIZE;
 
-        return &the_lnet.ln_peer_hash[idx];
+        return &the_lnet.ln_peer_tables[lnet_cpt_of_nid(nid)]->pt_hash[idx];
 }
 
 extern lnd_t the_lolnd;
@@ -586,16 +813,17 @@ lnet_set_msg_uid(lnet_ni_t *ni, lnet_msg_t *msg, lnet_uid_t uid)
 }
 #endif
 
-extern lnet_ni_t *lnet_nid2ni_locked (lnet_nid_t nid);
-extern lnet_ni_t *lnet_net2ni_locked (__u32 net);
+extern lnet_ni_t *lnet_nid2ni_locked (lnet_nid_t nid, int cpt);
+extern lnet_ni_t *lnet_net2ni_locked (__u32 net, int cpt);
 static inline lnet_ni_t *
 lnet_net2ni (__u32 net)
 {
         lnet_ni_t *ni;
+        int        cpt = lnet_cpt_current();
 
-        LNET_LOCK();
-        ni = lnet_net2ni_locked(net);
-        LNET_UNLOCK();
+        lnet_net_lock(cpt);
+        ni = lnet_net2ni_locked(net, cpt);
+        lnet_net_unlock(cpt);
 
         return ni;
 }
@@ -610,9 +838,9 @@ int lnet_get_route(int idx, __u32 *net, __u32 *hops,
                    lnet_nid_t *gateway, __u32 *alive);
 void lnet_proc_init(void);
 void lnet_proc_fini(void);
-void lnet_init_rtrpools(void);
 int  lnet_alloc_rtrpools(int im_a_router);
 void lnet_free_rtrpools(void);
+int  lnet_rtrpools_resize(int tiny, int small, int large);
 lnet_remotenet_t *lnet_find_net_locked (__u32 net);
 
 int lnet_islocalnid(lnet_nid_t nid);
@@ -623,8 +851,10 @@ void lnet_enq_event_locked(lnet_eq_t *eq, lnet_event_t *ev);
 void lnet_prep_send(lnet_msg_t *msg, int type, lnet_process_id_t target,
                     unsigned int offset, unsigned int len);
 int lnet_send(lnet_nid_t nid, lnet_msg_t *msg);
-void lnet_return_credits_locked (lnet_msg_t *msg);
-void lnet_match_blocked_msg(lnet_libmd_t *md);
+void lnet_return_tx_credits_locked(lnet_msg_t *msg);
+void lnet_return_rx_credits_locked(lnet_msg_t *msg);
+int lnet_post_routed_recv_locked(lnet_msg_t *msg, int do_recv);
+void lnet_match_blocked_msg(lnet_libmd_t *md, int cpt);
 int lnet_parse (lnet_ni_t *ni, lnet_hdr_t *hdr,
                 lnet_nid_t fromnid, void *private, int rdma_req);
 void lnet_recv(lnet_ni_t *ni, void *private, lnet_msg_t *msg, int delayed,
@@ -633,6 +863,13 @@ lnet_msg_t *lnet_create_reply_msg (lnet_ni_t *ni, lnet_msg_t *get_msg);
 void lnet_set_reply_msg_len(lnet_ni_t *ni, lnet_msg_t *msg, unsigned int len);
 void lnet_finalize(lnet_ni_t *ni, lnet_msg_t *msg, int rc);
 
+void lnet_msg_attach_md(lnet_msg_t *msg, lnet_libmd_t *md);
+void lnet_msg_commit(lnet_msg_t *msg, int cpt);
+int lnet_msg_containers_create(void);
+void lnet_msg_containers_destroy(void);
+void lnet_counters_get(lnet_counters_t *counters);
+void lnet_counters_reset(void);
+
 char *lnet_msgtyp2str (int type);
 void lnet_print_hdr (lnet_hdr_t * hdr);
 int lnet_fail_nid(lnet_nid_t nid, unsigned int threshold);
@@ -741,6 +978,8 @@ int lnet_router_checker_start(void);
 void lnet_router_checker_stop(void);
 void lnet_swap_pinginfo(lnet_ping_info_t *info);
 int lnet_router_down_ni(lnet_peer_t *rtr, __u32 net);
+int lnet_route_health(lnet_route_t *route);
+void lnet_route_health_update_locked(lnet_peer_t *gw, __u32 net, int ok);
 
 int lnet_ping_target_init(void);
 void lnet_ping_target_fini(void);
@@ -749,14 +988,22 @@ int lnet_ping(lnet_process_id_t id, int timeout_ms,
 
 int lnet_parse_ip2nets (char **networksp, char *ip2nets);
 int lnet_parse_routes (char *route_str, int *im_a_router);
+int lnet_parse_peer_rails(char *rails);
 int lnet_parse_networks (cfs_list_t *nilist, char *networks);
+void lnet_ni_free(lnet_ni_t *ni);
 
-int lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid);
+int lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt);
 lnet_peer_t *lnet_find_peer_locked (lnet_nid_t nid);
 void lnet_clear_peer_table(void);
 void lnet_destroy_peer_table(void);
 int lnet_create_peer_table(void);
 void lnet_debug_peer(lnet_nid_t nid);
+int lnet_add_peer_rails(lnet_nid_t *nids, int nnids);
+int lnet_hash_peer_rails(void);
+void lnet_destroy_peer_rails(void);
+lnet_nid_t lnet_rail_primary_nid(lnet_nid_t nid);
+int lnet_select_rail(lnet_nid_t *nidp);
+int lnet_peer_alive_locked(lnet_peer_t *lp);
 
 #ifndef __KERNEL__
 static inline int
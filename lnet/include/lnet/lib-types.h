@@ -203,6 +203,9 @@ typedef struct lnet_msg {
         unsigned int          msg_peerrtrcredit:1; /* taken a peer router credit */
         unsigned int          msg_onactivelist:1; /* on the activelist */
 
+        int                   msg_cpt;            /* partition of msg_activelist */
+        int                   msg_tx_cpt;         /* partition of msg_txpeer */
+        int                   msg_rx_cpt;         /* partition of msg_rxpeer */
         struct lnet_peer     *msg_txpeer;         /* peer I'm sending to */
         struct lnet_peer     *msg_rxpeer;         /* peer I received from */
 
@@ -236,7 +239,7 @@ typedef struct lnet_eq {
         lnet_seq_t            eq_deq_seq;
         unsigned int          eq_size;
         lnet_event_t         *eq_events;
-        int                   eq_refcount;
+        int                  *eq_refs;            /* # MDs, per partition */
         lnet_eq_handler_t     eq_callback;
 } lnet_eq_t;
 
@@ -304,7 +307,18 @@ typedef struct {
 #define LNET_COOKIE_TYPE_BITS  2
 #define LNET_COOKIE_TYPES      (1 << LNET_COOKIE_TYPE_BITS)
 /* LNET_COOKIE_TYPES must be a power of 2, so the cookie type can be
- * extracted by masking with (LNET_COOKIE_TYPES - 1) */
+ * extracted by masking with (LNET_COOKIE_TYPES - 1).  The partition of the
+ * object is stored in the ln_cpt_bits above the type, see
+ * lnet_cpt_of_cookie() */
+
+/* handles and active list of one kind of resource (MD, ME or EQ) */
+typedef struct {
+        int                    rec_type;            /* LNET_COOKIE_TYPE_* */
+        __u64                  rec_lh_cookie;       /* cookie generator */
+        cfs_list_t             rec_active;          /* active resources */
+        int                    rec_lh_hash_size;    /* size of handle hash */
+        cfs_list_t            *rec_lh_hash;         /* handle hash */
+} lnet_res_container_t;
 
 struct lnet_ni;                                  /* forward ref */
 
@@ -389,19 +403,25 @@ typedef struct {
 
 #define LNET_MAX_INTERFACES   16
 
+/* NI send credits of one partition */
+typedef struct {
+        int               tq_credits;           /* # tx credits free */
+        int               tq_credits_max;       /* # tx credits */
+        int               tq_credits_min;       /* lowest it's been */
+        cfs_list_t        tq_delayed;           /* messages waiting for tx credits */
+} lnet_tx_queue_t;
+
 typedef struct lnet_ni {
         cfs_list_t        ni_list;              /* chain on ln_nis */
-        cfs_list_t        ni_txq;               /* messages waiting for tx credits */
+        lnet_tx_queue_t  *ni_tx_queues;         /* tx credits, per partition */
         int               ni_maxtxcredits;      /* # tx credits  */
-        int               ni_txcredits;         /* # tx credits free */
-        int               ni_mintxcredits;      /* lowest it's been */
         int               ni_peertxcredits;     /* # per-peer send credits */
         int               ni_peerrtrcredits;    /* # per-peer router buffer credits */
         int               ni_peertimeout;       /* seconds to consider peer dead */
         lnet_nid_t        ni_nid;               /* interface's NID */
         void             *ni_data;              /* instance-specific data */
         lnd_t            *ni_lnd;               /* procedural interface */
-        int               ni_refcount;          /* reference count */
+        int              *ni_refs;              /* reference count, per partition */
         cfs_time_t        ni_last_alive;        /* when I was last alive */
         lnet_ni_status_t *ni_status;            /* my health status */
         char             *ni_interfaces[LNET_MAX_INTERFACES]; /* equivalent interfaces to use */
@@ -452,17 +472,55 @@ typedef struct lnet_peer {
         lnet_nid_t        lp_nid;               /* peer's NID */
         int               lp_refcount;          /* # refs */
         int               lp_rtr_refcount;      /* # refs from lnet_route_t::lr_gateway */
+        int               lp_cpt;               /* partition of my peer table */
         lnet_rc_data_t   *lp_rcd;               /* router checker state */
 } lnet_peer_t;
 
+/* peers hashing to one partition, see lnet_cpt_of_nid() */
+typedef struct {
+        int               pt_version;           /* /proc validity stamp */
+        int               pt_number;            /* # peers extant */
+        cfs_list_t       *pt_hash;              /* NID->peer hash */
+} lnet_peer_table_t;
+
 #define lnet_peer_aliveness_enabled(lp) ((lp)->lp_ni->ni_peertimeout > 0)
 
 typedef struct {
         cfs_list_t        lr_list;              /* chain on net */
         lnet_peer_t      *lr_gateway;           /* router node */
         unsigned int      lr_hops;              /* how far I am */
+        unsigned int      lr_seq;               /* round-robin sequence */
+        int               lr_health;            /* 0..LNET_ROUTE_HEALTH_MAX */
+        cfs_time_t        lr_health_stamp;      /* when lr_health last changed */
 } lnet_route_t;
 
+/* Route health is an average of the outcomes of the sends through the route
+ * and of the pings of its gateway, which creeps back up while nothing
+ * happens so that an idle route gets retried; routes below
+ * LNET_ROUTE_HEALTH_SICK are only used when nothing better is left. */
+#define LNET_ROUTE_HEALTH_MAX           1000
+#define LNET_ROUTE_HEALTH_SICK          (LNET_ROUTE_HEALTH_MAX / 2)
+#define LNET_ROUTE_HEALTH_RECOVERY      60      /* seconds from 0 to MAX */
+
+#define LNET_MAX_RAILS        8                 /* max # NIDs of a multi-rail peer */
+
+struct lnet_peer_rails;
+
+typedef struct {
+        cfs_list_t               rl_hashlist;   /* chain on ln_rail_hash */
+        lnet_nid_t               rl_nid;        /* NID of this rail */
+        struct lnet_peer_rails  *rl_peer;       /* the peer owning it */
+        cfs_atomic_t             rl_nsent;      /* # messages sent on it */
+} lnet_rail_t;
+
+/* a multi-rail peer: a node I reach by several NIDs on different networks */
+typedef struct lnet_peer_rails {
+        cfs_list_t        pr_list;              /* chain on ln_peer_rails */
+        unsigned int      pr_rotor;             /* rail to try first */
+        int               pr_nrails;            /* # rails */
+        lnet_rail_t       pr_rails[0];          /* primary NID first */
+} lnet_peer_rails_t;
+
 typedef struct {
         cfs_list_t              lrn_list;       /* chain on ln_remote_nets */
         cfs_list_t              lrn_routes;     /* routes to me */
@@ -476,6 +534,12 @@ typedef struct {
         int        rbp_nbuffers;         /* # buffers */
         int        rbp_credits;          /* # free buffers / blocked messages */
         int        rbp_mincredits;       /* low water mark */
+        int        rbp_cpt;              /* owning partition */
+        int        rbp_base;             /* # buffers configured */
+        int        rbp_req_nbuffers;     /* # buffers asked for, 0 if none */
+        int        rbp_lowcredits;       /* low water since last resize check */
+        int        rbp_nblocked;         /* # msgs blocked since last check */
+        int        rbp_nidle;            /* # checks the pool stayed idle */
 } lnet_rtrbufpool_t;
 
 typedef struct {
@@ -500,26 +564,51 @@ typedef struct {
 } WIRE_ATTR lnet_counters_t;
 #include <libcfs/libcfs_unpack.h>
 
+/* active messages and their counters, one per partition */
+typedef struct {
+        cfs_list_t             msc_active;          /* active messages */
+        lnet_counters_t        msc_counters;        /* stats of this partition */
+        cfs_list_t             msc_finalizing;      /* msgs waiting to complete finalizing */
+#ifdef __KERNEL__
+        void                 **msc_finalizers;      /* threads doing finalization */
+        int                    msc_nfinalizers;     /* max # threads finalizing */
+#else
+        int                    msc_finalizing_now;  /* somebody is finalizing */
+#endif
+} lnet_msg_container_t;
+
+#ifdef __KERNEL__
+/* one partition's lock, padded so each gets a cacheline to itself */
+typedef union {
+        cfs_spinlock_t         cl_lock;
+        char                   cl_pad[128];
+} lnet_cpt_lock_t;
+#endif
+
 #define LNET_PEER_HASHSIZE   503                /* prime! */
 
 #define LNET_NRBPOOLS         3                 /* # different router buffer pools */
 
 /* Options for lnet_portal_t::ptl_options */
 #define LNET_PTL_LAZY               (1 << 0)
-#define LNET_PTL_MATCH_UNIQUE       (1 << 1)    /* unique match, for RDMA */
+#define LNET_PTL_MATCH_UNIQUE       (1 << 1)    /* hash unique match, for RDMA */
 #define LNET_PTL_MATCH_WILDCARD     (1 << 2)    /* wildcard match, request portal */
 
-/* ME hash of RDMA portal */
-#define LNET_PORTAL_HASH_BITS        8
+/* ME hash of RDMA portal: there is one ME per in-flight RPC on it, so
+ * keep the chains short even with tens of thousands of them */
+#define LNET_PORTAL_HASH_BITS        12
 #define LNET_PORTAL_HASH_SIZE       (1 << LNET_PORTAL_HASH_BITS)
 
 typedef struct {
-        cfs_list_t       *ptl_mhash;            /* match hash */
-        cfs_list_t        ptl_mlist;            /* match list */
+        cfs_list_t       *ptl_mhash;            /* hash of unique MEs */
+        cfs_list_t        ptl_mlist;            /* match list, wildcard MEs */
         cfs_list_t        ptl_msgq;             /* messages blocking for MD */
         __u64             ptl_ml_version;       /* validity stamp, only changed for new attached MD */
         __u64             ptl_msgq_version;     /* validity stamp */
         unsigned int      ptl_options;
+        unsigned int      ptl_nme;              /* # MEs attached */
+        __u64             ptl_nmatch;           /* # messages matched */
+        __u64             ptl_nscan;            /* # MEs scanned to match them */
 } lnet_portal_t;
 
 /* Router Checker states */
@@ -538,19 +627,28 @@ typedef struct
 
         cfs_list_t             ln_lnds;             /* registered LNDs */
 
+        int                    ln_cpt_number;       /* # CPU partitions */
+        int                    ln_cpt_bits;         /* bits to hold a partition */
+
 #ifdef __KERNEL__
-        cfs_spinlock_t         ln_lock;
-        cfs_waitq_t            ln_waitq;
+        lnet_cpt_lock_t       *ln_net_locks;        /* peers, credits, messages */
+        lnet_cpt_lock_t       *ln_res_locks;        /* MDs, MEs, portals */
+        cfs_spinlock_t         ln_eq_wait_lock;     /* EQ events and waiters */
+        cfs_waitq_t            ln_eq_waitq;
         cfs_semaphore_t   ln_api_mutex;
         cfs_semaphore_t   ln_lnd_mutex;
 #else
 # ifndef HAVE_LIBPTHREAD
-        int                    ln_lock;
+        int                    ln_net_lock;
+        int                    ln_res_lock;
+        int                    ln_eq_wait_lock;
         int                    ln_api_mutex;
         int                    ln_lnd_mutex;
 # else
-        pthread_cond_t         ln_cond;
-        pthread_mutex_t        ln_lock;
+        pthread_cond_t         ln_eq_cond;
+        pthread_mutex_t        ln_net_lock;
+        pthread_mutex_t        ln_res_lock;
+        pthread_mutex_t        ln_eq_wait_lock;
         pthread_mutex_t        ln_api_mutex;
         pthread_mutex_t        ln_lnd_mutex;
 # endif
@@ -576,16 +674,20 @@ typedef struct
         cfs_list_t             ln_routers;       /* list of all known routers */
         __u64                  ln_routers_version;  /* validity stamp */
 
-        cfs_list_t            *ln_peer_hash;        /* NID->peer hash */
-        int                    ln_npeers;           /* # peers extant */
-        int                    ln_peertable_version; /* /proc validity stamp */
+        lnet_peer_table_t    **ln_peer_tables;      /* peer tables, per partition */
+
+        /* multi-rail peers, only changed at LNetNIInit()/LNetNIFini() */
+        cfs_list_t             ln_peer_rails;
+        cfs_list_t            *ln_rail_hash;        /* rails by NID */
 
         int                    ln_routing;          /* am I a router? */
-        lnet_rtrbufpool_t      ln_rtrpools[LNET_NRBPOOLS]; /* router buffer pools */
+        /* router buffer pools, LNET_NRBPOOLS per partition, each under the
+         * net lock of its partition */
+        lnet_rtrbufpool_t    **ln_rtrpools;
 
-        int                    ln_lh_hash_size;     /* size of lib handle hash table */
-        cfs_list_t            *ln_lh_hash_table;    /* all extant lib handles, this interface */
-        __u64                  ln_next_object_cookie; /* cookie generator */
+        lnet_res_container_t   ln_eq_container;     /* EQs, under all res locks */
+        lnet_res_container_t **ln_md_containers;    /* MDs, per partition */
+        lnet_res_container_t **ln_me_containers;    /* MEs, per partition */
         __u64                  ln_interface_cookie; /* uniquely identifies this ni in this epoch */
 
         char                  *ln_network_tokens;   /* space for network names */
@@ -593,13 +695,7 @@ typedef struct
 
         int                    ln_testprotocompat;  /* test protocol compatibility flags */
 
-        cfs_list_t             ln_finalizeq;        /* msgs waiting to complete finalizing */
-#ifdef __KERNEL__
-        void                 **ln_finalizers;       /* threads doing finalization */
-        int                    ln_nfinalizers;      /* max # threads finalizing */
-#else
-        int                    ln_finalizing;
-#endif
+        lnet_msg_container_t **ln_msg_containers;   /* messages, per partition */
         cfs_list_t             ln_test_peers;       /* failure simulation */
 
         lnet_handle_md_t       ln_ping_target_md;
@@ -615,16 +711,13 @@ typedef struct
         cfs_list_t         ln_zombie_rcd;
 
 #ifdef LNET_USE_LIB_FREELIST
+        /* only built with a single partition, so these are protected by
+         * net lock 0 (msgs) and res lock 0 (MEs, MDs, EQs) */
         lnet_freelist_t        ln_free_mes;
         lnet_freelist_t        ln_free_msgs;
         lnet_freelist_t        ln_free_mds;
         lnet_freelist_t        ln_free_eqs;
 #endif
-        cfs_list_t             ln_active_msgs;
-        cfs_list_t             ln_active_mds;
-        cfs_list_t             ln_active_eqs;
-
-        lnet_counters_t        ln_counters;
 
 #ifndef __KERNEL__
         /* Temporary workaround to allow uOSS and test programs force
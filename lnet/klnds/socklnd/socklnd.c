@@ -662,7 +662,7 @@ ksocknal_get_conn_by_idx (lnet_ni_t *ni, int index)
 }
 
 ksock_sched_t *
-ksocknal_choose_scheduler_locked (unsigned int irq)
+ksocknal_choose_scheduler_locked (unsigned int irq, int cpt)
 {
         ksock_sched_t    *sched;
         ksock_irqinfo_t  *info;
@@ -677,12 +677,19 @@ ksocknal_choose_scheduler_locked (unsigned int irq)
         }
 
         /* software NIC (irq == 0) || not associated with a scheduler yet.
-         * Choose the CPU with the fewest connections... */
-        sched = &ksocknal_data.ksnd_schedulers[0];
-        for (i = 1; i < ksocknal_data.ksnd_nschedulers; i++)
-                if (sched->kss_nconns >
+         * Choose the scheduler of partition cpt's pool with the fewest
+         * connections... */
+        sched = NULL;
+        for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
+                if (ksocknal_data.ksnd_schedulers[i].kss_cpt != cpt)
+                        continue;
+
+                if (sched == NULL ||
+                    sched->kss_nconns >
                     ksocknal_data.ksnd_schedulers[i].kss_nconns)
                         sched = &ksocknal_data.ksnd_schedulers[i];
+        }
+        LASSERT (sched != NULL);
 
         if (irq != 0) {                         /* Hardware NIC */
                 info->ksni_valid = 1;
@@ -695,6 +702,158 @@ ksocknal_choose_scheduler_locked (unsigned int irq)
         return (sched);
 }
 
+/* Move idle \a conn to scheduler \a sched, return 0 if it's busy.  The
+ * global lock held in write mode keeps the socket callbacks off
+ * conn->ksnc_scheduler; anyone else only uses it while conn is queued on
+ * or being progressed by its scheduler, or once it's closing. */
+static int
+ksocknal_move_conn_locked (ksock_conn_t *conn, ksock_sched_t *sched)
+{
+        ksock_sched_t *old = conn->ksnc_scheduler;
+        int            moved = 0;
+
+        cfs_spin_lock(&old->kss_lock);
+
+        if (!conn->ksnc_closing &&
+            !conn->ksnc_rx_scheduled &&
+            !conn->ksnc_tx_scheduled) {
+                old->kss_nconns--;
+                old->kss_nmoved++;
+                sched->kss_nconns++;
+                conn->ksnc_scheduler = sched;
+                moved = 1;
+        }
+
+        cfs_spin_unlock(&old->kss_lock);
+        return moved;
+}
+
+/* Return the busiest connection of \a sched with no more than \a maxload
+ * passes, with a ref on it */
+static ksock_conn_t *
+ksocknal_busiest_conn_locked (ksock_sched_t *sched, unsigned int maxload)
+{
+        ksock_conn_t     *busiest = NULL;
+        ksock_conn_t     *conn;
+        ksock_peer_t     *peer;
+        cfs_list_t       *ptmp;
+        cfs_list_t       *ctmp;
+        int               i;
+
+        for (i = 0; i < ksocknal_data.ksnd_peer_hash_size; i++) {
+                cfs_list_for_each (ptmp, &ksocknal_data.ksnd_peers[i]) {
+                        peer = cfs_list_entry(ptmp, ksock_peer_t, ksnp_list);
+
+                        cfs_list_for_each (ctmp, &peer->ksnp_conns) {
+                                conn = cfs_list_entry(ctmp, ksock_conn_t,
+                                                      ksnc_list);
+
+                                if (conn->ksnc_scheduler != sched ||
+                                    conn->ksnc_load > maxload)
+                                        continue;
+
+                                if (busiest == NULL ||
+                                    busiest->ksnc_load < conn->ksnc_load)
+                                        busiest = conn;
+                        }
+                }
+        }
+
+        if (busiest != NULL)
+                ksocknal_conn_addref(busiest);
+        return busiest;
+}
+
+static void
+ksocknal_reset_conn_load_locked (void)
+{
+        ksock_peer_t     *peer;
+        cfs_list_t       *ptmp;
+        cfs_list_t       *ctmp;
+        int               i;
+
+        for (i = 0; i < ksocknal_data.ksnd_peer_hash_size; i++) {
+                cfs_list_for_each (ptmp, &ksocknal_data.ksnd_peers[i]) {
+                        peer = cfs_list_entry(ptmp, ksock_peer_t, ksnp_list);
+
+                        cfs_list_for_each (ctmp, &peer->ksnp_conns)
+                                cfs_list_entry(ctmp, ksock_conn_t,
+                                               ksnc_list)->ksnc_load = 0;
+                }
+        }
+}
+
+/* Called by the reaper every sched_balance seconds: in each partition's
+ * pool, if the busiest scheduler did at least twice the work of the
+ * idlest one since last time, move it a connection which carries no more
+ * than half of the difference. */
+void
+ksocknal_balance_schedulers (void)
+{
+        ksock_sched_t    *sched;
+        ksock_sched_t    *busiest;
+        ksock_sched_t    *idlest;
+        ksock_conn_t     *conn;
+        int               cpt;
+        int               i;
+
+        for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
+                sched = &ksocknal_data.ksnd_schedulers[i];
+
+                sched->kss_load = (unsigned int)(sched->kss_passes -
+                                                 sched->kss_passes_last);
+                sched->kss_passes_last += sched->kss_load;
+        }
+
+        cfs_cpt_for_each(cpt) {
+                busiest = idlest = NULL;
+
+                for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
+                        sched = &ksocknal_data.ksnd_schedulers[i];
+                        if (sched->kss_cpt != cpt)
+                                continue;
+
+                        if (busiest == NULL ||
+                            busiest->kss_load < sched->kss_load)
+                                busiest = sched;
+                        if (idlest == NULL ||
+                            idlest->kss_load > sched->kss_load)
+                                idlest = sched;
+                }
+
+                if (busiest == idlest ||
+                    busiest->kss_nconns < 2 ||
+                    busiest->kss_load < SOCKNAL_BALANCE_MIN ||
+                    busiest->kss_load < 2 * idlest->kss_load)
+                        continue;
+
+                cfs_read_lock (&ksocknal_data.ksnd_global_lock);
+                conn = ksocknal_busiest_conn_locked(busiest,
+                                (busiest->kss_load - idlest->kss_load) / 2);
+                cfs_read_unlock (&ksocknal_data.ksnd_global_lock);
+
+                if (conn == NULL)
+                        continue;
+
+                cfs_write_lock_bh (&ksocknal_data.ksnd_global_lock);
+                if (conn->ksnc_scheduler == busiest &&
+                    ksocknal_move_conn_locked(conn, idlest))
+                        CDEBUG(D_NET, "conn %p to %s moved from sched[%d] "
+                               "to sched[%d]: %u/%u passes\n", conn,
+                               libcfs_id2str(conn->ksnc_peer->ksnp_id),
+                               (int)(busiest - ksocknal_data.ksnd_schedulers),
+                               (int)(idlest - ksocknal_data.ksnd_schedulers),
+                               conn->ksnc_load, busiest->kss_load);
+                cfs_write_unlock_bh (&ksocknal_data.ksnd_global_lock);
+
+                ksocknal_conn_decref(conn);
+        }
+
+        cfs_read_lock (&ksocknal_data.ksnd_global_lock);
+        ksocknal_reset_conn_load_locked();
+        cfs_read_unlock (&ksocknal_data.ksnd_global_lock);
+}
+
 int
 ksocknal_local_ipvec (lnet_ni_t *ni, __u32 *ipaddrs)
 {
@@ -1078,6 +1237,7 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         conn->ksnc_tx_ready = 0;
         conn->ksnc_tx_scheduled = 0;
         conn->ksnc_tx_carrier = NULL;
+        CFS_INIT_LIST_HEAD (&conn->ksnc_tx_batch);
         cfs_atomic_set (&conn->ksnc_tx_nob, 0);
 
         LIBCFS_ALLOC(hello, offsetof(ksock_hello_msg_t,
@@ -1273,7 +1433,9 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         peer->ksnp_send_keepalive = 0;
         peer->ksnp_error = 0;
 
-        sched = ksocknal_choose_scheduler_locked (irq);
+        /* run it in the partition LNet handles this peer in */
+        sched = ksocknal_choose_scheduler_locked (irq,
+                        lnet_cpt_of_nid(peerid.nid) % cfs_cpt_number());
         sched->kss_nconns++;
         conn->ksnc_scheduler = sched;
 
@@ -1657,6 +1819,7 @@ ksocknal_destroy_conn (ksock_conn_t *conn)
         LASSERT (!conn->ksnc_tx_scheduled);
         LASSERT (!conn->ksnc_rx_scheduled);
         LASSERT (cfs_list_empty(&conn->ksnc_tx_queue));
+        LASSERT (cfs_list_empty(&conn->ksnc_tx_batch));
 
         /* complete current receive if any */
         switch (conn->ksnc_rx_state) {
@@ -2353,11 +2516,26 @@ ksocknal_new_incarnation (void)
         return (((__u64)tv.tv_sec) * 1000000) + tv.tv_usec;
 }
 
+/* # schedulers in the pool of CPU partition \a cpt */
+static int
+ksocknal_nsched_cpt (int cpt)
+{
+        int nsched = *ksocknal_tunables.ksnd_nscheds;
+
+        if (nsched <= 0)        /* partition's share of ksocknal_nsched() */
+                nsched = cfs_cpt_weight(cpt) * ksocknal_nsched() /
+                         cfs_num_online_cpus();
+
+        return MAX(nsched, 1);
+}
+
 int
 ksocknal_base_startup (void)
 {
         int               rc;
+        int               cpt;
         int               i;
+        int               j;
 
         LASSERT (ksocknal_data.ksnd_init == SOCKNAL_INIT_NOTHING);
         LASSERT (ksocknal_data.ksnd_nnets == 0);
@@ -2397,21 +2575,30 @@ ksocknal_base_startup (void)
         ksocknal_data.ksnd_init = SOCKNAL_INIT_DATA;
         PORTAL_MODULE_USE;
 
-        ksocknal_data.ksnd_nschedulers = ksocknal_nsched();
+        /* a pool of schedulers per CPU partition, in partition order */
+        ksocknal_data.ksnd_nschedulers = 0;
+        cfs_cpt_for_each(cpt)
+                ksocknal_data.ksnd_nschedulers += ksocknal_nsched_cpt(cpt);
+
         LIBCFS_ALLOC(ksocknal_data.ksnd_schedulers,
                      sizeof(ksock_sched_t) * ksocknal_data.ksnd_nschedulers);
         if (ksocknal_data.ksnd_schedulers == NULL)
                 goto failed;
 
-        for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
-                ksock_sched_t *kss = &ksocknal_data.ksnd_schedulers[i];
-
-                cfs_spin_lock_init (&kss->kss_lock);
-                CFS_INIT_LIST_HEAD (&kss->kss_rx_conns);
-                CFS_INIT_LIST_HEAD (&kss->kss_tx_conns);
-                CFS_INIT_LIST_HEAD (&kss->kss_zombie_noop_txs);
-                cfs_waitq_init (&kss->kss_waitq);
+        i = 0;
+        cfs_cpt_for_each(cpt) {
+                for (j = 0; j < ksocknal_nsched_cpt(cpt); j++, i++) {
+                        ksock_sched_t *kss = &ksocknal_data.ksnd_schedulers[i];
+
+                        kss->kss_cpt = cpt;
+                        cfs_spin_lock_init (&kss->kss_lock);
+                        CFS_INIT_LIST_HEAD (&kss->kss_rx_conns);
+                        CFS_INIT_LIST_HEAD (&kss->kss_tx_conns);
+                        CFS_INIT_LIST_HEAD (&kss->kss_zombie_noop_txs);
+                        cfs_waitq_init (&kss->kss_waitq);
+                }
         }
+        LASSERT (i == ksocknal_data.ksnd_nschedulers);
 
         for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
                 rc = ksocknal_thread_start (ksocknal_scheduler,
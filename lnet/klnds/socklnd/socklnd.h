@@ -52,12 +52,17 @@
 #define SOCKNAL_RESCHED         100             /* # scheduler loops before reschedule */
 #define SOCKNAL_INSANITY_RECONN 5000            /* connd is trying on reconn infinitely */
 #define SOCKNAL_ENOMEM_RETRY    CFS_TICK        /* jiffies between retries */
+#define SOCKNAL_BALANCE_MIN     100             /* # passes not worth balancing */
 
 #define SOCKNAL_SINGLE_FRAG_TX      0           /* disable multi-fragment sends */
 #define SOCKNAL_SINGLE_FRAG_RX      0           /* disable multi-fragment receives */
 
 #define SOCKNAL_VERSION_DEBUG       0           /* enable protocol version debugging */
 
+#ifndef SOCKNAL_TX_BATCH
+# define SOCKNAL_TX_BATCH           0           /* gather small txs in one send */
+#endif
+
 /* risk kmap deadlock on multi-frag I/O (backs off to single-frag if disabled).
  * no risk if we're not running on a CONFIG_HIGHMEM platform. */
 #ifdef CONFIG_HIGHMEM
@@ -74,6 +79,16 @@ typedef struct                                  /* per scheduler state */
         cfs_list_t        kss_zombie_noop_txs;  /* zombie noop tx list */
         cfs_waitq_t       kss_waitq;            /* where scheduler sleeps */
         int               kss_nconns;           /* # connections assigned to this scheduler */
+        int               kss_cpt;              /* CPU partition of my pool */
+        __u64             kss_passes;           /* # rx/tx passes on connections */
+        __u64             kss_passes_last;      /* kss_passes at the last balancing */
+        unsigned int      kss_load;             /* # passes since the one before */
+        unsigned int      kss_nmoved;           /* # connections moved off me */
+        /* counters, only updated by the scheduler thread */
+        __u64             kss_rx_direct_nob;    /* payload read from skbs into pages */
+        __u64             kss_rx_copy_nob;      /* bytes read with recvmsg() */
+        __u64             kss_tx_batch_sends;   /* sends gathering several txs */
+        __u64             kss_tx_batched;       /* txs completed by those sends */
 #if !SOCKNAL_SINGLE_FRAG_RX
         struct page      *kss_rx_scratch_pgs[LNET_MAX_IOV];
 #endif
@@ -125,6 +140,10 @@ typedef struct
         unsigned int     *ksnd_zc_min_payload;  /* minimum zero copy payload size */
         int              *ksnd_zc_recv;         /* enable ZC receive (for Chelsio TOE) */
         int              *ksnd_zc_recv_min_nfrags; /* minimum # of fragments to enable ZC receive */
+        int              *ksnd_rx_direct;       /* read payload pages straight from skbs */
+        int              *ksnd_tx_batch;        /* max # small txs gathered in one send */
+        int              *ksnd_nscheds;         /* # schedulers per CPU partition */
+        int              *ksnd_sched_balance;   /* secs between scheduler balancing */
 #ifdef CPU_AFFINITY
         int              *ksnd_irq_affinity;    /* enable IRQ affinity? */
 #endif
@@ -303,11 +322,13 @@ typedef struct ksock_conn
         cfs_list_t            ksnc_tx_list;     /* where I enq waiting for output space */
         cfs_list_t            ksnc_tx_queue;    /* packets waiting to be sent */
         ksock_tx_t           *ksnc_tx_carrier;  /* next TX that can carry a LNet message or ZC-ACK */
+        cfs_list_t            ksnc_tx_batch;    /* small TXs sent along with the current one */
         cfs_time_t            ksnc_tx_deadline; /* when (in jiffies) tx times out */
         int                   ksnc_tx_bufnob;     /* send buffer marker */
         cfs_atomic_t          ksnc_tx_nob;        /* # bytes queued */
         int                   ksnc_tx_ready;      /* write space */
         int                   ksnc_tx_scheduled;  /* being progressed */
+        unsigned int          ksnc_load;          /* # rx/tx passes since the last balancing */
         cfs_time_t            ksnc_tx_last_post;  /* time stamp of the last posted TX */
 } ksock_conn_t;
 
@@ -534,6 +555,7 @@ extern void ksocknal_peer_failed (ksock_peer_t *peer);
 extern int ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
                                  cfs_socket_t *sock, int type);
 extern void ksocknal_close_conn_locked (ksock_conn_t *conn, int why);
+extern void ksocknal_balance_schedulers (void);
 extern void ksocknal_terminate_conn (ksock_conn_t *conn);
 extern void ksocknal_destroy_conn (ksock_conn_t *conn);
 extern int  ksocknal_close_peer_conns_locked (ksock_peer_t *peer,
@@ -596,4 +618,3 @@ extern void ksocknal_lib_tunables_fini(void);
 extern void ksocknal_lib_csum_tx(ksock_tx_t *tx);
 
 extern int ksocknal_lib_memory_pressure(ksock_conn_t *conn);
-extern int ksocknal_lib_bind_thread_to_cpu(int id);
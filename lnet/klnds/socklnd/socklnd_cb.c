@@ -106,10 +106,36 @@ ksocknal_free_tx (ksock_tx_t *tx)
         }
 }
 
+/* "consume" \a nob sent bytes of \a tx's iov, return the bytes beyond it */
+static int
+ksocknal_consume_iov (ksock_tx_t *tx, int nob)
+{
+        struct iovec  *iov = tx->tx_iov;
+        int            sent = MIN(nob, tx->tx_resid);
+
+        tx->tx_resid -= sent;
+        nob -= sent;
+
+        while (sent != 0) {
+                LASSERT (tx->tx_niov > 0);
+
+                if (sent < (int) iov->iov_len) {
+                        iov->iov_base = (void *)((char *)iov->iov_base + sent);
+                        iov->iov_len -= sent;
+                        break;
+                }
+
+                sent -= iov->iov_len;
+                tx->tx_iov = ++iov;
+                tx->tx_niov--;
+        }
+
+        return nob;
+}
+
 int
 ksocknal_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
 {
-        struct iovec  *iov = tx->tx_iov;
         int    nob;
         int    rc;
 
@@ -121,24 +147,30 @@ ksocknal_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
         if (rc <= 0)                            /* sent nothing? */
                 return (rc);
 
-        nob = rc;
-        LASSERT (nob <= tx->tx_resid);
-        tx->tx_resid -= nob;
+        nob = ksocknal_consume_iov(tx, rc);
 
-        /* "consume" iov */
-        do {
-                LASSERT (tx->tx_niov > 0);
+#if SOCKNAL_TX_BATCH
+        if (!cfs_list_empty(&conn->ksnc_tx_batch))
+                conn->ksnc_scheduler->kss_tx_batch_sends++;
 
-                if (nob < (int) iov->iov_len) {
-                        iov->iov_base = (void *)((char *)iov->iov_base + nob);
-                        iov->iov_len -= nob;
-                        return (rc);
-                }
+        /* the rest went to the txs gathered behind tx */
+        while (nob != 0) {
+                ksock_tx_t *btx;
 
-                nob -= iov->iov_len;
-                tx->tx_iov = ++iov;
-                tx->tx_niov--;
-        } while (nob != 0);
+                LASSERT (!cfs_list_empty(&conn->ksnc_tx_batch));
+                btx = cfs_list_entry(conn->ksnc_tx_batch.next,
+                                     ksock_tx_t, tx_list);
+
+                nob = ksocknal_consume_iov(btx, nob);
+                if (btx->tx_resid != 0)
+                        break;
+
+                cfs_list_del(&btx->tx_list);
+                conn->ksnc_scheduler->kss_tx_batched++;
+                ksocknal_tx_decref(btx);
+        }
+#endif
+        LASSERT (nob == 0);
 
         return (rc);
 }
@@ -500,6 +532,65 @@ ksocknal_uncheck_zc_req(ksock_tx_t *tx)
         ksocknal_tx_decref(tx);
 }
 
+#if SOCKNAL_TX_BATCH
+/* Can \a tx be sent in the same sendmsg() as other small messages? */
+static inline int
+ksocknal_tx_batchable (ksock_tx_t *tx)
+{
+        return tx->tx_nkiov == 0 && !tx->tx_zc_capable &&
+               tx->tx_resid < *ksocknal_tunables.ksnd_min_bulk;
+}
+
+/* Called holding kss_lock, with \a tx just dequeued: move the small txs
+ * queued behind a small \a tx to ksnc_tx_batch, so they all go in one
+ * sendmsg() */
+static void
+ksocknal_batch_txs_locked (ksock_conn_t *conn, ksock_tx_t *tx)
+{
+        int    niov = tx->tx_niov;
+        int    ntx = 1;
+
+        LASSERT (cfs_list_empty(&conn->ksnc_tx_batch));
+
+        if (!ksocknal_tx_batchable(tx))
+                return;
+
+        while (!cfs_list_empty(&conn->ksnc_tx_queue) &&
+               ntx < *ksocknal_tunables.ksnd_tx_batch) {
+                tx = cfs_list_entry(conn->ksnc_tx_queue.next,
+                                    ksock_tx_t, tx_list);
+
+                if (!ksocknal_tx_batchable(tx) ||
+                    niov + tx->tx_niov > LNET_MAX_IOV)
+                        break;
+
+                if (conn->ksnc_tx_carrier == tx)
+                        ksocknal_next_tx_carrier(conn);
+
+                cfs_list_del(&tx->tx_list);
+                cfs_list_add_tail(&tx->tx_list, &conn->ksnc_tx_batch);
+                niov += tx->tx_niov;
+                ntx++;
+        }
+}
+
+static void
+ksocknal_unbatch_txs (ksock_conn_t *conn)
+{
+        ksock_sched_t *sched = conn->ksnc_scheduler;
+
+        if (cfs_list_empty(&conn->ksnc_tx_batch))
+                return;
+
+        cfs_spin_lock_bh (&sched->kss_lock);
+        cfs_list_splice_init(&conn->ksnc_tx_batch, &conn->ksnc_tx_queue);
+        cfs_spin_unlock_bh (&sched->kss_lock);
+}
+#else
+# define ksocknal_batch_txs_locked(conn, tx)    do {} while (0)
+# define ksocknal_unbatch_txs(conn)             do {} while (0)
+#endif
+
 int
 ksocknal_process_transmit (ksock_conn_t *conn, ksock_tx_t *tx)
 {
@@ -510,6 +601,10 @@ ksocknal_process_transmit (ksock_conn_t *conn, ksock_tx_t *tx)
 
         rc = ksocknal_transmit (conn, tx);
 
+        /* whatever is left of the txs sent along with tx goes back to the
+         * head of the queue, where conn closure finds it */
+        ksocknal_unbatch_txs(conn);
+
         CDEBUG (D_NET, "send(%d) %d\n", tx->tx_resid, rc);
 
         if (tx->tx_resid == 0) {
@@ -1401,8 +1496,10 @@ int ksocknal_scheduler (void *arg)
         cfs_daemonize (name);
         cfs_block_allsigs ();
 
-        if (ksocknal_lib_bind_thread_to_cpu(id))
-                CERROR ("Can't set CPU affinity for %s to %d\n", name, id);
+        rc = cfs_cpt_bind(sched->kss_cpt);
+        if (rc != 0)
+                CERROR ("Can't set CPU partition affinity for %s to %d: %d\n",
+                        name, sched->kss_cpt, rc);
 
         cfs_spin_lock_bh (&sched->kss_lock);
 
@@ -1427,6 +1524,8 @@ int ksocknal_scheduler (void *arg)
                         cfs_spin_unlock_bh (&sched->kss_lock);
 
                         rc = ksocknal_process_receive(conn);
+                        conn->ksnc_load++;
+                        sched->kss_passes++;
 
                         cfs_spin_lock_bh (&sched->kss_lock);
 
@@ -1481,6 +1580,9 @@ int ksocknal_scheduler (void *arg)
                         /* dequeue now so empty list => more to send */
                         cfs_list_del(&tx->tx_list);
 
+                        /* small txs queued behind go in the same send */
+                        ksocknal_batch_txs_locked(conn, tx);
+
                         /* Clear tx_ready in case send isn't complete.  Do
                          * it BEFORE we call process_transmit, since
                          * write_space can set it any time after we release
@@ -1495,6 +1597,8 @@ int ksocknal_scheduler (void *arg)
                         }
 
                         rc = ksocknal_process_transmit(conn, tx);
+                        conn->ksnc_load++;
+                        sched->kss_passes++;
 
                         if (rc == -ENOMEM || rc == -EAGAIN) {
                                 /* Incomplete send: replace tx on HEAD of tx_queue */
@@ -2425,6 +2529,7 @@ ksocknal_reaper (void *arg)
         int                i;
         int                peer_index = 0;
         cfs_time_t         deadline = cfs_time_current();
+        cfs_time_t         balance_deadline = cfs_time_current();
 
         cfs_daemonize ("socknal_reaper");
         cfs_block_allsigs ();
@@ -2522,6 +2627,13 @@ ksocknal_reaper (void *arg)
                         deadline = cfs_time_add(deadline, cfs_time_seconds(p));
                 }
 
+                if (*ksocknal_tunables.ksnd_sched_balance > 0 &&
+                    cfs_time_aftereq(cfs_time_current(), balance_deadline)) {
+                        ksocknal_balance_schedulers();
+                        balance_deadline = cfs_time_shift(
+                                *ksocknal_tunables.ksnd_sched_balance);
+                }
+
                 if (nenomem_conns != 0) {
                         /* Reduce my timeout if I rescheduled ENOMEM conns.
                          * This also prevents me getting woken immediately
@@ -66,7 +66,12 @@ enum {
         SOCKLND_BACKOFF_MAX,
         SOCKLND_PROTOCOL,
         SOCKLND_ZERO_COPY_RECV,
-        SOCKLND_ZERO_COPY_RECV_MIN_NFRAGS
+        SOCKLND_ZERO_COPY_RECV_MIN_NFRAGS,
+        SOCKLND_RX_DIRECT,
+        SOCKLND_TX_BATCH,
+        SOCKLND_STATS,
+        SOCKLND_SCHED_BALANCE,
+        SOCKLND_SCHEDULERS
 };
 #else
 
@@ -96,8 +101,106 @@ enum {
 #define SOCKLND_PROTOCOL        CTL_UNNUMBERED
 #define SOCKLND_ZERO_COPY_RECV  CTL_UNNUMBERED
 #define SOCKLND_ZERO_COPY_RECV_MIN_NFRAGS CTL_UNNUMBERED
+#define SOCKLND_RX_DIRECT       CTL_UNNUMBERED
+#define SOCKLND_TX_BATCH        CTL_UNNUMBERED
+#define SOCKLND_STATS           CTL_UNNUMBERED
+#define SOCKLND_SCHED_BALANCE   CTL_UNNUMBERED
+#define SOCKLND_SCHEDULERS      CTL_UNNUMBERED
 #endif
 
+/* data path counters summed over the schedulers */
+static int __proc_ksocknal_stats(void *data, int write,
+                                 loff_t pos, void *buffer, int nob)
+{
+        ksock_sched_t *sched;
+        char           tmpstr[256];
+        __u64          rx_direct = 0;
+        __u64          rx_copy = 0;
+        __u64          tx_batch_sends = 0;
+        __u64          tx_batched = 0;
+        int            len;
+        int            i;
+
+        if (write)
+                return -EINVAL;
+
+        for (i = 0; ksocknal_data.ksnd_init == SOCKNAL_INIT_ALL &&
+                    i < ksocknal_data.ksnd_nschedulers; i++) {
+                sched = &ksocknal_data.ksnd_schedulers[i];
+
+                rx_direct      += sched->kss_rx_direct_nob;
+                rx_copy        += sched->kss_rx_copy_nob;
+                tx_batch_sends += sched->kss_tx_batch_sends;
+                tx_batched     += sched->kss_tx_batched;
+        }
+
+        len = snprintf(tmpstr, sizeof(tmpstr),
+                       "rx_direct_bytes "LPU64"\n"
+                       "rx_copy_bytes "LPU64"\n"
+                       "tx_batch_sends "LPU64"\n"
+                       "tx_batched "LPU64"\n",
+                       rx_direct, rx_copy, tx_batch_sends, tx_batched);
+        if (pos >= len)
+                return 0;
+
+        return cfs_trace_copyout_string(buffer, nob, tmpstr + pos, NULL);
+}
+
+DECLARE_PROC_HANDLER(proc_ksocknal_stats);
+
+/* one line per scheduler: its partition, # connections, rx/tx passes in
+ * the last balancing period and since startup, # connections moved off */
+static int __proc_ksocknal_schedulers(void *data, int write,
+                                      loff_t pos, void *buffer, int nob)
+{
+        ksock_sched_t *sched;
+        char          *tmpstr;
+        char          *s;
+        const int      linesiz = 80; /* 4 %d, 1 %u and 1 LPU64 */
+        int            tmpsiz;
+        int            len;
+        int            rc;
+        int            i;
+
+        if (write)
+                return -EINVAL;
+
+        if (ksocknal_data.ksnd_init != SOCKNAL_INIT_ALL)
+                return 0;
+
+        tmpsiz = (ksocknal_data.ksnd_nschedulers + 1) * linesiz;
+        LIBCFS_ALLOC(tmpstr, tmpsiz);
+        if (tmpstr == NULL)
+                return -ENOMEM;
+
+        s = tmpstr;
+        s += snprintf(s, tmpstr + tmpsiz - s, "%-5s %-4s %6s %10s %14s %6s\n",
+                      "sched", "cpt", "conns", "load", "passes", "moved");
+
+        for (i = 0; i < ksocknal_data.ksnd_nschedulers; i++) {
+                sched = &ksocknal_data.ksnd_schedulers[i];
+
+                s += snprintf(s, tmpstr + tmpsiz - s,
+                              "%-5d %-4d %6d %10u %14"LPF64"u %6u\n",
+                              i, sched->kss_cpt, sched->kss_nconns,
+                              sched->kss_load, sched->kss_passes,
+                              sched->kss_nmoved);
+                LASSERT (tmpstr + tmpsiz - s > 0);
+        }
+
+        len = s - tmpstr;
+        if (pos >= len)
+                rc = 0;
+        else
+                rc = cfs_trace_copyout_string(buffer, nob,
+                                              tmpstr + pos, NULL);
+
+        LIBCFS_FREE(tmpstr, tmpsiz);
+        return rc;
+}
+
+DECLARE_PROC_HANDLER(proc_ksocknal_schedulers);
+
 static cfs_sysctl_table_t ksocknal_ctl_table[] = {
         {
                 .ctl_name = SOCKLND_TIMEOUT,
@@ -208,6 +311,45 @@ static cfs_sysctl_table_t ksocknal_ctl_table[] = {
                 .proc_handler = &proc_dointvec,
                 .strategy = &sysctl_intvec,
         },
+        {
+                .ctl_name = SOCKLND_RX_DIRECT,
+                .procname = "rx_direct",
+                .data     = &ksocknal_tunables.ksnd_rx_direct,
+                .maxlen   = sizeof (int),
+                .mode     = 0644,
+                .proc_handler = &proc_dointvec,
+                .strategy = &sysctl_intvec,
+        },
+        {
+                .ctl_name = SOCKLND_TX_BATCH,
+                .procname = "tx_batch",
+                .data     = &ksocknal_tunables.ksnd_tx_batch,
+                .maxlen   = sizeof (int),
+                .mode     = 0644,
+                .proc_handler = &proc_dointvec,
+                .strategy = &sysctl_intvec,
+        },
+        {
+                .ctl_name = SOCKLND_STATS,
+                .procname = "stats",
+                .mode     = 0444,
+                .proc_handler = &proc_ksocknal_stats,
+        },
+        {
+                .ctl_name = SOCKLND_SCHED_BALANCE,
+                .procname = "sched_balance",
+                .data     = &ksocknal_tunables.ksnd_sched_balance,
+                .maxlen   = sizeof (int),
+                .mode     = 0644,
+                .proc_handler = &proc_dointvec,
+                .strategy = &sysctl_intvec,
+        },
+        {
+                .ctl_name = SOCKLND_SCHEDULERS,
+                .procname = "schedulers",
+                .mode     = 0444,
+                .proc_handler = &proc_ksocknal_schedulers,
+        },
         {
                 .ctl_name = SOCKLND_TYPED,
                 .procname = "typed",
@@ -412,6 +554,7 @@ ksocknal_lib_bind_irq (unsigned int irq)
         int              cpu;
         char             cmdline[64];
         ksock_irqinfo_t *info;
+        ksock_sched_t   *sched;
         char            *argv[] = {"/bin/sh",
                                    "-c",
                                    cmdline,
@@ -437,7 +580,12 @@ ksocknal_lib_bind_irq (unsigned int irq)
         if (!bind)                              /* bound already */
                 return;
 
-        cpu = ksocknal_irqsched2cpu(info->ksni_sched);
+        /* the first CPU of the scheduler's partition */
+        sched = &ksocknal_data.ksnd_schedulers[info->ksni_sched];
+        for_each_online_cpu(cpu) {
+                if (cfs_cpt_of_cpu(cpu) == sched->kss_cpt)
+                        break;
+        }
         snprintf (cmdline, sizeof (cmdline),
                   "echo %d > /proc/irq/%u/smp_affinity", 1 << cpu, irq);
 
@@ -516,6 +664,15 @@ ksocknal_lib_zc_capable(ksock_conn_t *conn)
                 (caps & (NETIF_F_IP_CSUM | NETIF_F_NO_CSUM | NETIF_F_HW_CSUM)) != 0);
 }
 
+static inline int
+ksocknal_lib_tx_needs_csum(ksock_conn_t *conn, ksock_tx_t *tx)
+{
+        return *ksocknal_tunables.ksnd_enable_csum        && /* checksum enabled */
+               conn->ksnc_proto == &ksocknal_protocol_v2x && /* V2.x connection  */
+               tx->tx_nob == tx->tx_resid                 && /* frist sending    */
+               tx->tx_msg.ksm_csum == 0;                     /* not checksummed  */
+}
+
 int
 ksocknal_lib_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
 {
@@ -523,10 +680,7 @@ ksocknal_lib_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
         int            nob;
         int            rc;
 
-        if (*ksocknal_tunables.ksnd_enable_csum        && /* checksum enabled */
-            conn->ksnc_proto == &ksocknal_protocol_v2x && /* V2.x connection  */
-            tx->tx_nob == tx->tx_resid                 && /* frist sending    */
-            tx->tx_msg.ksm_csum == 0)                     /* not checksummed  */
+        if (ksocknal_lib_tx_needs_csum(conn, tx))
                 ksocknal_lib_csum_tx(tx);
 
         /* NB we can't trust socket ops to either consume our iovs
@@ -540,6 +694,7 @@ ksocknal_lib_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
 #else
                 struct iovec   *scratchiov = conn->ksnc_scheduler->kss_scratch_iov;
                 unsigned int    niov = tx->tx_niov;
+                ksock_tx_t     *btx;
 #endif
                 struct msghdr msg = {
                         .msg_name       = NULL,
@@ -551,6 +706,7 @@ ksocknal_lib_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
                         .msg_flags      = MSG_DONTWAIT
                 };
                 mm_segment_t oldmm = get_fs();
+                int  resid = tx->tx_resid;
                 int  i;
 
                 for (nob = i = 0; i < niov; i++) {
@@ -558,8 +714,25 @@ ksocknal_lib_send_iov (ksock_conn_t *conn, ksock_tx_t *tx)
                         nob += scratchiov[i].iov_len;
                 }
 
+#if !SOCKNAL_SINGLE_FRAG_TX
+                /* append the small txs gathered behind tx */
+                cfs_list_for_each_entry_typed(btx, &conn->ksnc_tx_batch,
+                                              ksock_tx_t, tx_list) {
+                        if (ksocknal_lib_tx_needs_csum(conn, btx))
+                                ksocknal_lib_csum_tx(btx);
+
+                        LASSERT (niov + btx->tx_niov <= LNET_MAX_IOV);
+                        for (i = 0; i < btx->tx_niov; i++, niov++) {
+                                scratchiov[niov] = btx->tx_iov[i];
+                                nob += scratchiov[niov].iov_len;
+                        }
+                        resid += btx->tx_resid;
+                }
+                msg.msg_iovlen = niov;
+#endif
+
                 if (!cfs_list_empty(&conn->ksnc_tx_queue) ||
-                    nob < tx->tx_resid)
+                    nob < resid)
                         msg.msg_flags |= MSG_MORE;
 
                 set_fs (KERNEL_DS);
@@ -709,6 +882,9 @@ ksocknal_lib_recv_iov (ksock_conn_t *conn)
         /* NB this is just a boolean..........................^ */
         set_fs (oldmm);
 
+        if (rc > 0)
+                conn->ksnc_scheduler->kss_rx_copy_nob += rc;
+
         saved_csum = 0;
         if (conn->ksnc_proto == &ksocknal_protocol_v2x) {
                 saved_csum = conn->ksnc_msg.ksm_csum;
@@ -778,6 +954,109 @@ ksocknal_lib_kiov_vmap(lnet_kiov_t *kiov, int niov,
         return addr;
 }
 
+typedef struct
+{
+        ksock_conn_t     *krd_conn;
+        lnet_kiov_t      *krd_kiov;             /* page being filled */
+        unsigned int      krd_offset;           /* # bytes in it so far */
+} ksock_rx_direct_t;
+
+/* tcp_read_sock() actor: copy \a len bytes of \a skb from \a offset into
+ * the pages of the receive, checksumming them while they're hot in cache.
+ * Pages are mapped one at a time with kmap_atomic(), so there is no kmap
+ * deadlock to fear however many of them are filled in a single call. */
+static int
+ksocknal_lib_rx_direct_actor(read_descriptor_t *desc, struct sk_buff *skb,
+                             unsigned int offset, size_t len)
+{
+        ksock_rx_direct_t *rxd = desc->arg.data;
+        ksock_conn_t      *conn = rxd->krd_conn;
+        lnet_kiov_t       *kiov;
+        char              *addr;
+        size_t             copied = 0;
+        int                fragnob;
+        int                rc;
+
+        while (copied < len && desc->count > 0) {
+                kiov = rxd->krd_kiov;
+                fragnob = MIN(kiov->kiov_len - rxd->krd_offset,
+                              MIN(len - copied, desc->count));
+
+                addr = kmap_atomic(kiov->kiov_page, KM_USER0);
+                rc = skb_copy_bits(skb, offset + copied, addr +
+                                   kiov->kiov_offset + rxd->krd_offset,
+                                   fragnob);
+                if (rc == 0 && conn->ksnc_msg.ksm_csum != 0)
+                        conn->ksnc_rx_csum =
+                                ksocknal_csum(conn->ksnc_rx_csum, addr +
+                                              kiov->kiov_offset +
+                                              rxd->krd_offset, fragnob);
+                kunmap_atomic(addr, KM_USER0);
+
+                if (rc != 0) {
+                        desc->error = rc;
+                        desc->count = 0;
+                        break;
+                }
+
+                copied += fragnob;
+                desc->count -= fragnob;
+                rxd->krd_offset += fragnob;
+                if (rxd->krd_offset == kiov->kiov_len) {
+                        rxd->krd_kiov++;
+                        rxd->krd_offset = 0;
+                }
+        }
+
+        return copied;
+}
+
+/* Read as much of the payload as is queued on the socket directly from its
+ * skbs into the pages, instead of recvmsg() one kmap()ed page at a time.
+ * Same return convention as sock_recvmsg(). */
+static int
+ksocknal_lib_recv_kiov_direct (ksock_conn_t *conn)
+{
+        struct sock       *sk = conn->ksnc_sock->sk;
+        ksock_rx_direct_t  rxd = {
+                .krd_conn       = conn,
+                .krd_kiov       = conn->ksnc_rx_kiov,
+                .krd_offset     = 0,
+        };
+        read_descriptor_t  desc;
+        int                nob;
+        int                i;
+        int                rc;
+
+        for (nob = i = 0; i < conn->ksnc_rx_nkiov; i++)
+                nob += conn->ksnc_rx_kiov[i].kiov_len;
+
+        LASSERT (nob <= conn->ksnc_rx_nob_wanted);
+
+        memset(&desc, 0, sizeof(desc));
+        desc.arg.data = &rxd;
+        desc.count    = nob;
+
+        lock_sock(sk);
+        rc = tcp_read_sock(sk, &desc, ksocknal_lib_rx_direct_actor);
+        if (rc == 0) {
+                if (desc.error != 0)
+                        rc = desc.error;
+                else if (sk->sk_err != 0)
+                        rc = sock_error(sk);
+                else if ((sk->sk_shutdown & RCV_SHUTDOWN) != 0)
+                        rc = 0;                 /* EOF */
+                else
+                        rc = -EAGAIN;
+        }
+        release_sock(sk);
+
+        if (rc > 0)
+                conn->ksnc_scheduler->kss_rx_direct_nob += rc;
+
+        return rc;
+}
+
 int
 ksocknal_lib_recv_kiov (ksock_conn_t *conn)
 {
@@ -812,6 +1091,12 @@ ksocknal_lib_recv_kiov (ksock_conn_t *conn)
         int          sum;
         int          fragnob;
 
+        /* TOE sockets (zc_recv) must go through their own recvmsg() */
+        if (*ksocknal_tunables.ksnd_rx_direct &&
+            !*ksocknal_tunables.ksnd_zc_recv &&
+            conn->ksnc_sock->sk->sk_prot == &tcp_prot)
+                return ksocknal_lib_recv_kiov_direct(conn);
+
         /* NB we can't trust socket ops to either consume our iovs
          * or leave them alone. */
         if ((addr = ksocknal_lib_kiov_vmap(kiov, niov, scratchiov, pages)) != NULL) {
@@ -834,6 +1119,9 @@ ksocknal_lib_recv_kiov (ksock_conn_t *conn)
         /* NB this is just a boolean.......................^ */
         set_fs (oldmm);
 
+        if (rc > 0)
+                conn->ksnc_scheduler->kss_rx_copy_nob += rc;
+
         if (conn->ksnc_msg.ksm_csum != 0) {
                 for (i = 0, sum = rc; sum > 0; i++, sum -= fragnob) {
                         LASSERT (i < niov);
@@ -1269,22 +1557,3 @@ ksocknal_lib_memory_pressure(ksock_conn_t *conn)
 
         return rc;
 }
-
-int
-ksocknal_lib_bind_thread_to_cpu(int id)
-{
-#if defined(CONFIG_SMP) && defined(CPU_AFFINITY)
-        id = ksocknal_sched2cpu(id);
-        if (cpu_online(id)) {
-                cpumask_t m = CPU_MASK_NONE;
-                cpu_set(id, m);
-                set_cpus_allowed(current, m);
-                return 0;
-        }
-
-        return -1;
-
-#else
-        return 0;
-#endif
-}
@@ -88,6 +88,8 @@ static inline __u32 ksocknal_csum(__u32 crc, unsigned char const *p, size_t len)
 #endif
 }
 
+#define SOCKNAL_TX_BATCH         (!SOCKNAL_SINGLE_FRAG_TX)
+
 #define SOCKNAL_WSPACE(sk)       sk_stream_wspace(sk)
 #define SOCKNAL_MIN_WSPACE(sk)   sk_stream_min_wspace(sk)
 
@@ -105,18 +107,6 @@ ksocknal_nsched(void)
 {
         return num_online_cpus();
 }
-
-static inline int
-ksocknal_sched2cpu(int i)
-{
-        return i;
-}
-
-static inline int
-ksocknal_irqsched2cpu(int i)
-{
-        return i;
-}
 # else
 static inline int
 ksocknal_nsched(void)
@@ -128,21 +118,6 @@ ksocknal_nsched(void)
         LASSERT (smp_num_siblings == 2);
         return (num_online_cpus()/2);
 }
-
-static inline int
-ksocknal_sched2cpu(int i)
-{
-        if (smp_num_siblings == 1)
-                return i;
-
-        return (i * 2);
-}
-
-static inline int
-ksocknal_irqsched2cpu(int i)
-{
-        return (ksocknal_sched2cpu(i) + 1);
-}
 # endif
 #endif
 
@@ -672,9 +672,3 @@ ksocknal_lib_memory_pressure(ksock_conn_t *conn)
 {
         return 0;
 }
-
-int
-ksocknal_lib_bind_thread_to_cpu(int id)
-{
-        return 0;
-}
@@ -145,6 +145,22 @@ static unsigned int zc_recv_min_nfrags = 16;
 CFS_MODULE_PARM(zc_recv_min_nfrags, "i", int, 0644,
                 "minimum # of fragments to enable ZC recv");
 
+static int rx_direct = 1;
+CFS_MODULE_PARM(rx_direct, "i", int, 0644,
+                "read payload pages straight from the socket buffers");
+
+static int tx_batch = 16;
+CFS_MODULE_PARM(tx_batch, "i", int, 0644,
+                "max # small messages gathered in one send");
+
+static int nscheds = 0;
+CFS_MODULE_PARM(nscheds, "i", int, 0444,
+                "# schedulers per CPU partition (0 = by # CPUs)");
+
+static int sched_balance = 5;
+CFS_MODULE_PARM(sched_balance, "i", int, 0644,
+                "seconds between moves of busy connections to idler schedulers (0 = never)");
+
 #ifdef SOCKNAL_BACKOFF
 static int backoff_init = 3;
 CFS_MODULE_PARM(backoff_init, "i", int, 0644,
@@ -192,6 +208,10 @@ int ksocknal_tunables_init(void)
         ksocknal_tunables.ksnd_zc_min_payload     = &zc_min_payload;
         ksocknal_tunables.ksnd_zc_recv            = &zc_recv;
         ksocknal_tunables.ksnd_zc_recv_min_nfrags = &zc_recv_min_nfrags;
+        ksocknal_tunables.ksnd_rx_direct          = &rx_direct;
+        ksocknal_tunables.ksnd_tx_batch           = &tx_batch;
+        ksocknal_tunables.ksnd_nscheds            = &nscheds;
+        ksocknal_tunables.ksnd_sched_balance      = &sched_balance;
 
 #ifdef CPU_AFFINITY
         ksocknal_tunables.ksnd_irq_affinity       = &enable_irq_affinity;
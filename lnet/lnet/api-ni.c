@@ -59,12 +59,22 @@ static char *routes = "";
 CFS_MODULE_PARM(routes, "s", charp, 0444,
                 "routes to non-local networks");
 
+static char *peer_rails = "";
+CFS_MODULE_PARM(peer_rails, "s", charp, 0444,
+                "NIDs of multi-rail peers");
+
 char *
 lnet_get_routes(void)
 {
         return routes;
 }
 
+char *
+lnet_get_peer_rails(void)
+{
+        return peer_rails;
+}
+
 char *
 lnet_get_networks(void)
 {
@@ -88,18 +98,54 @@ lnet_get_networks(void)
         return "tcp";
 }
 
-void
-lnet_init_locks(void)
+static lnet_cpt_lock_t *
+lnet_cpt_locks_alloc(void)
 {
-        cfs_spin_lock_init (&the_lnet.ln_lock);
-        cfs_waitq_init (&the_lnet.ln_waitq);
-        cfs_init_mutex(&the_lnet.ln_lnd_mutex);
-        cfs_init_mutex(&the_lnet.ln_api_mutex);
+        lnet_cpt_lock_t *locks;
+        int              i;
+
+        LIBCFS_ALLOC(locks, the_lnet.ln_cpt_number * sizeof(*locks));
+        if (locks == NULL)
+                return NULL;
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                cfs_spin_lock_init(&locks[i].cl_lock);
+
+        return locks;
 }
 
 void
 lnet_fini_locks(void)
 {
+        if (the_lnet.ln_net_locks != NULL) {
+                LIBCFS_FREE(the_lnet.ln_net_locks,
+                            the_lnet.ln_cpt_number * sizeof(lnet_cpt_lock_t));
+                the_lnet.ln_net_locks = NULL;
+        }
+
+        if (the_lnet.ln_res_locks != NULL) {
+                LIBCFS_FREE(the_lnet.ln_res_locks,
+                            the_lnet.ln_cpt_number * sizeof(lnet_cpt_lock_t));
+                the_lnet.ln_res_locks = NULL;
+        }
+}
+
+int
+lnet_init_locks(void)
+{
+        the_lnet.ln_net_locks = lnet_cpt_locks_alloc();
+        the_lnet.ln_res_locks = lnet_cpt_locks_alloc();
+        if (the_lnet.ln_net_locks == NULL || the_lnet.ln_res_locks == NULL) {
+                CERROR("Can't allocate LNet locks\n");
+                lnet_fini_locks();
+                return -ENOMEM;
+        }
+
+        cfs_spin_lock_init(&the_lnet.ln_eq_wait_lock);
+        cfs_waitq_init(&the_lnet.ln_eq_waitq);
+        cfs_init_mutex(&the_lnet.ln_lnd_mutex);
+        cfs_init_mutex(&the_lnet.ln_api_mutex);
+        return 0;
 }
 
 #else
@@ -112,6 +158,14 @@ lnet_get_routes(void)
         return (str == NULL) ? "" : str;
 }
 
+char *
+lnet_get_peer_rails(void)
+{
+        char *str = getenv("LNET_PEER_RAILS");
+
+        return (str == NULL) ? "" : str;
+}
+
 char *
 lnet_get_networks (void)
 {
@@ -171,36 +225,46 @@ lnet_get_networks (void)
 
 # ifndef HAVE_LIBPTHREAD
 
-void lnet_init_locks(void)
+int lnet_init_locks(void)
 {
-        the_lnet.ln_lock = 0;
+        the_lnet.ln_net_lock = 0;
+        the_lnet.ln_res_lock = 0;
+        the_lnet.ln_eq_wait_lock = 0;
         the_lnet.ln_lnd_mutex = 0;
         the_lnet.ln_api_mutex = 0;
+        return 0;
 }
 
 void lnet_fini_locks(void)
 {
         LASSERT (the_lnet.ln_api_mutex == 0);
         LASSERT (the_lnet.ln_lnd_mutex == 0);
-        LASSERT (the_lnet.ln_lock == 0);
+        LASSERT (the_lnet.ln_eq_wait_lock == 0);
+        LASSERT (the_lnet.ln_res_lock == 0);
+        LASSERT (the_lnet.ln_net_lock == 0);
 }
 
 # else
 
-void lnet_init_locks(void)
+int lnet_init_locks(void)
 {
-        pthread_cond_init(&the_lnet.ln_cond, NULL);
-        pthread_mutex_init(&the_lnet.ln_lock, NULL);
+        pthread_cond_init(&the_lnet.ln_eq_cond, NULL);
+        pthread_mutex_init(&the_lnet.ln_net_lock, NULL);
+        pthread_mutex_init(&the_lnet.ln_res_lock, NULL);
+        pthread_mutex_init(&the_lnet.ln_eq_wait_lock, NULL);
         pthread_mutex_init(&the_lnet.ln_lnd_mutex, NULL);
         pthread_mutex_init(&the_lnet.ln_api_mutex, NULL);
+        return 0;
 }
 
 void lnet_fini_locks(void)
 {
         pthread_mutex_destroy(&the_lnet.ln_api_mutex);
         pthread_mutex_destroy(&the_lnet.ln_lnd_mutex);
-        pthread_mutex_destroy(&the_lnet.ln_lock);
-        pthread_cond_destroy(&the_lnet.ln_cond);
+        pthread_mutex_destroy(&the_lnet.ln_eq_wait_lock);
+        pthread_mutex_destroy(&the_lnet.ln_res_lock);
+        pthread_mutex_destroy(&the_lnet.ln_net_lock);
+        pthread_cond_destroy(&the_lnet.ln_eq_cond);
 }
 
 # endif
@@ -474,54 +538,139 @@ lnet_create_interface_cookie (void)
         return cookie;
 }
 
-int
-lnet_setup_handle_hash (void)
+static int
+lnet_res_container_setup(lnet_res_container_t *rec, int cpt, int type)
 {
-        int       i;
+        int i;
+
+        LASSERT (rec->rec_type == 0);
+
+        rec->rec_type = type;
+        CFS_INIT_LIST_HEAD(&rec->rec_active);
+        /* the partition goes between the sequence and the type */
+        rec->rec_lh_cookie = (cpt << LNET_COOKIE_TYPE_BITS) | type;
 
         /* Arbitrary choice of hash table size */
 #ifdef __KERNEL__
-        the_lnet.ln_lh_hash_size =
-                (2 * CFS_PAGE_SIZE) / sizeof (cfs_list_t);
+        rec->rec_lh_hash_size = (2 * CFS_PAGE_SIZE) / sizeof(cfs_list_t);
 #else
-        the_lnet.ln_lh_hash_size = (MAX_MES + MAX_MDS + MAX_EQS)/4;
+        rec->rec_lh_hash_size = (MAX_MES + MAX_MDS + MAX_EQS) / 4;
 #endif
-        LIBCFS_ALLOC(the_lnet.ln_lh_hash_table,
-                     the_lnet.ln_lh_hash_size * sizeof (cfs_list_t));
-        if (the_lnet.ln_lh_hash_table == NULL)
-                return (-ENOMEM);
+        LIBCFS_ALLOC(rec->rec_lh_hash,
+                     rec->rec_lh_hash_size * sizeof(cfs_list_t));
+        if (rec->rec_lh_hash == NULL) {
+                CERROR("Can't allocate handle hash for type %d\n", type);
+                return -ENOMEM;
+        }
 
-        for (i = 0; i < the_lnet.ln_lh_hash_size; i++)
-                CFS_INIT_LIST_HEAD (&the_lnet.ln_lh_hash_table[i]);
+        for (i = 0; i < rec->rec_lh_hash_size; i++)
+                CFS_INIT_LIST_HEAD(&rec->rec_lh_hash[i]);
+
+        return 0;
+}
 
-        the_lnet.ln_next_object_cookie = LNET_COOKIE_TYPES;
+static void
+lnet_res_container_cleanup(lnet_res_container_t *rec)
+{
+        int count = 0;
 
-        return (0);
+        if (rec->rec_type == 0) /* never set up */
+                return;
+
+        /* NB no lock needed, this is the last reference */
+        while (!cfs_list_empty(&rec->rec_active)) {
+                cfs_list_t *e = rec->rec_active.next;
+
+                cfs_list_del_init(e);
+                if (rec->rec_type == LNET_COOKIE_TYPE_EQ) {
+                        lnet_eq_t *eq = cfs_list_entry(e, lnet_eq_t, eq_list);
+
+                        if (eq->eq_refs != NULL)
+                                LIBCFS_FREE(eq->eq_refs,
+                                            the_lnet.ln_cpt_number *
+                                            sizeof(eq->eq_refs[0]));
+                        lnet_eq_free(eq);
+                } else {
+                        LASSERT (rec->rec_type == LNET_COOKIE_TYPE_MD);
+                        lnet_md_free(cfs_list_entry(e, lnet_libmd_t, md_list));
+                }
+                count++;
+        }
+
+        if (count > 0)
+                CERROR("%d active resources of type %d on exit\n",
+                       count, rec->rec_type);
+
+        if (rec->rec_lh_hash != NULL) {
+                LIBCFS_FREE(rec->rec_lh_hash,
+                            rec->rec_lh_hash_size * sizeof(cfs_list_t));
+                rec->rec_lh_hash = NULL;
+        }
+
+        rec->rec_type = 0;
 }
 
-void
-lnet_cleanup_handle_hash (void)
+static void
+lnet_res_containers_destroy(lnet_res_container_t **recs)
 {
-        if (the_lnet.ln_lh_hash_table == NULL)
+        int i;
+
+        if (recs == NULL)
                 return;
 
-        LIBCFS_FREE(the_lnet.ln_lh_hash_table,
-                    the_lnet.ln_lh_hash_size * sizeof (cfs_list_t));
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                if (recs[i] == NULL)
+                        continue;
+
+                lnet_res_container_cleanup(recs[i]);
+                LIBCFS_FREE(recs[i], sizeof(*recs[i]));
+        }
+
+        LIBCFS_FREE(recs, the_lnet.ln_cpt_number * sizeof(recs[0]));
+}
+
+static lnet_res_container_t **
+lnet_res_containers_create(int type)
+{
+        lnet_res_container_t **recs;
+        int                    rc;
+        int                    i;
+
+        LIBCFS_ALLOC(recs, the_lnet.ln_cpt_number * sizeof(recs[0]));
+        if (recs == NULL)
+                return NULL;
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                LIBCFS_ALLOC(recs[i], sizeof(*recs[i]));
+                if (recs[i] == NULL)
+                        goto failed;
+
+                rc = lnet_res_container_setup(recs[i], i, type);
+                if (rc != 0)
+                        goto failed;
+        }
+
+        return recs;
+
+ failed:
+        lnet_res_containers_destroy(recs);
+        return NULL;
 }
 
 lnet_libhandle_t *
-lnet_lookup_cookie (__u64 cookie, int type)
+lnet_res_lh_lookup(lnet_res_container_t *rec, __u64 cookie)
 {
-        /* ALWAYS called with LNET_LOCK held */
+        /* ALWAYS called with the res lock of \a rec held */
         cfs_list_t          *list;
         cfs_list_t          *el;
         unsigned int         hash;
 
-        if ((cookie & (LNET_COOKIE_TYPES - 1)) != type)
+        if ((cookie & (LNET_COOKIE_TYPES - 1)) != rec->rec_type)
                 return (NULL);
 
-        hash = ((unsigned int)(cookie >> LNET_COOKIE_TYPE_BITS)) % the_lnet.ln_lh_hash_size;
-        list = &the_lnet.ln_lh_hash_table[hash];
+        hash = (unsigned int)(cookie >> (LNET_COOKIE_TYPE_BITS +
+                                         the_lnet.ln_cpt_bits));
+        list = &rec->rec_lh_hash[hash % rec->rec_lh_hash_size];
 
         cfs_list_for_each (el, list) {
                 lnet_libhandle_t *lh = cfs_list_entry (el, lnet_libhandle_t,
@@ -535,23 +684,24 @@ lnet_lookup_cookie (__u64 cookie, int type)
 }
 
 void
-lnet_initialise_handle (lnet_libhandle_t *lh, int type)
+lnet_res_lh_initialize(lnet_res_container_t *rec, lnet_libhandle_t *lh)
 {
-        /* ALWAYS called with LNET_LOCK held */
+        /* ALWAYS called with the res lock of \a rec held */
+        unsigned int    ibits = LNET_COOKIE_TYPE_BITS + the_lnet.ln_cpt_bits;
         unsigned int    hash;
 
-        LASSERT (type >= 0 && type < LNET_COOKIE_TYPES);
-        lh->lh_cookie = the_lnet.ln_next_object_cookie | type;
-        the_lnet.ln_next_object_cookie += LNET_COOKIE_TYPES;
+        lh->lh_cookie = rec->rec_lh_cookie;
+        rec->rec_lh_cookie += 1ULL << ibits;
 
-        hash = ((unsigned int)(lh->lh_cookie >> LNET_COOKIE_TYPE_BITS)) % the_lnet.ln_lh_hash_size;
-        cfs_list_add (&lh->lh_hash_chain, &the_lnet.ln_lh_hash_table[hash]);
+        hash = (unsigned int)(lh->lh_cookie >> ibits);
+        cfs_list_add(&lh->lh_hash_chain,
+                     &rec->rec_lh_hash[hash % rec->rec_lh_hash_size]);
 }
 
 void
 lnet_invalidate_handle (lnet_libhandle_t *lh)
 {
-        /* ALWAYS called with LNET_LOCK held */
+        /* ALWAYS called with the res lock of the container held */
         cfs_list_del (&lh->lh_hash_chain);
 }
 
@@ -588,50 +738,6 @@ lnet_portal_mhash_free(cfs_list_t *mhash)
         LIBCFS_FREE(mhash, sizeof(cfs_list_t) * LNET_PORTAL_HASH_SIZE);
 }
 
-int
-lnet_init_finalizers(void)
-{
-#ifdef __KERNEL__
-        int    i;
-
-        the_lnet.ln_nfinalizers = (int) cfs_num_online_cpus();
-
-        LIBCFS_ALLOC(the_lnet.ln_finalizers,
-                     the_lnet.ln_nfinalizers *
-                     sizeof(*the_lnet.ln_finalizers));
-        if (the_lnet.ln_finalizers == NULL) {
-                CERROR("Can't allocate ln_finalizers\n");
-                return -ENOMEM;
-        }
-
-        for (i = 0; i < the_lnet.ln_nfinalizers; i++)
-                the_lnet.ln_finalizers[i] = NULL;
-#else
-        the_lnet.ln_finalizing = 0;
-#endif
-
-        CFS_INIT_LIST_HEAD(&the_lnet.ln_finalizeq);
-        return 0;
-}
-
-void
-lnet_fini_finalizers(void)
-{
-#ifdef __KERNEL__
-        int    i;
-
-        for (i = 0; i < the_lnet.ln_nfinalizers; i++)
-                LASSERT (the_lnet.ln_finalizers[i] == NULL);
-
-        LIBCFS_FREE(the_lnet.ln_finalizers,
-                    the_lnet.ln_nfinalizers *
-                    sizeof(*the_lnet.ln_finalizers));
-#else
-        LASSERT (!the_lnet.ln_finalizing);
-#endif
-        LASSERT (cfs_list_empty(&the_lnet.ln_finalizeq));
-}
-
 #ifndef __KERNEL__
 /**
  * Reserved API - do not use.
@@ -678,31 +784,35 @@ lnet_prepare(lnet_pid_t requested_pid)
         if (rc != 0)
                 goto failed0;
 
-        memset(&the_lnet.ln_counters, 0,
-               sizeof(the_lnet.ln_counters));
-
-        CFS_INIT_LIST_HEAD (&the_lnet.ln_active_msgs);
-        CFS_INIT_LIST_HEAD (&the_lnet.ln_active_mds);
-        CFS_INIT_LIST_HEAD (&the_lnet.ln_active_eqs);
         CFS_INIT_LIST_HEAD (&the_lnet.ln_test_peers);
         CFS_INIT_LIST_HEAD (&the_lnet.ln_nis);
         CFS_INIT_LIST_HEAD (&the_lnet.ln_zombie_nis);
         CFS_INIT_LIST_HEAD (&the_lnet.ln_remote_nets);
+        CFS_INIT_LIST_HEAD (&the_lnet.ln_peer_rails);
         CFS_INIT_LIST_HEAD (&the_lnet.ln_routers);
 
         the_lnet.ln_interface_cookie = lnet_create_interface_cookie();
 
-        lnet_init_rtrpools();
-
-        rc = lnet_setup_handle_hash ();
+        rc = lnet_res_container_setup(&the_lnet.ln_eq_container, 0,
+                                      LNET_COOKIE_TYPE_EQ);
         if (rc != 0)
-                goto failed0;
+                goto failed1;
+
+        the_lnet.ln_md_containers =
+                lnet_res_containers_create(LNET_COOKIE_TYPE_MD);
+        the_lnet.ln_me_containers =
+                lnet_res_containers_create(LNET_COOKIE_TYPE_ME);
+        if (the_lnet.ln_md_containers == NULL ||
+            the_lnet.ln_me_containers == NULL) {
+                rc = -ENOMEM;
+                goto failed1;
+        }
 
         rc = lnet_create_peer_table();
         if (rc != 0)
                 goto failed1;
 
-        rc = lnet_init_finalizers();
+        rc = lnet_msg_containers_create();
         if (rc != 0)
                 goto failed2;
 
@@ -724,11 +834,15 @@ lnet_prepare(lnet_pid_t requested_pid)
         return 0;
 
  failed3:
-        lnet_fini_finalizers();
+        lnet_msg_containers_destroy();
  failed2:
         lnet_destroy_peer_table();
  failed1:
-        lnet_cleanup_handle_hash();
+        lnet_res_containers_destroy(the_lnet.ln_me_containers);
+        the_lnet.ln_me_containers = NULL;
+        lnet_res_containers_destroy(the_lnet.ln_md_containers);
+        the_lnet.ln_md_containers = NULL;
+        lnet_res_container_cleanup(&the_lnet.ln_eq_container);
  failed0:
         lnet_descriptor_cleanup();
         return rc;
@@ -771,58 +885,36 @@ lnet_unprepare (void)
                 }
         }
 
-        while (!cfs_list_empty (&the_lnet.ln_active_mds)) {
-                lnet_libmd_t *md = cfs_list_entry (the_lnet.ln_active_mds.next,
-                                                   lnet_libmd_t, md_list);
-
-                CERROR ("Active MD %p on exit\n", md);
-                cfs_list_del_init (&md->md_list);
-                lnet_md_free (md);
-        }
-
-        while (!cfs_list_empty (&the_lnet.ln_active_eqs)) {
-                lnet_eq_t *eq = cfs_list_entry (the_lnet.ln_active_eqs.next,
-                                                lnet_eq_t, eq_list);
-
-                CERROR ("Active EQ %p on exit\n", eq);
-                cfs_list_del (&eq->eq_list);
-                lnet_eq_free (eq);
-        }
-
-        while (!cfs_list_empty (&the_lnet.ln_active_msgs)) {
-                lnet_msg_t *msg = cfs_list_entry (the_lnet.ln_active_msgs.next,
-                                                  lnet_msg_t, msg_activelist);
-
-                CERROR ("Active msg %p on exit\n", msg);
-                LASSERT (msg->msg_onactivelist);
-                msg->msg_onactivelist = 0;
-                cfs_list_del (&msg->msg_activelist);
-                lnet_msg_free (msg);
-        }
-
         LIBCFS_FREE(the_lnet.ln_portals,  
                     the_lnet.ln_nportals * sizeof(*the_lnet.ln_portals));
 
         lnet_free_rtrpools();
-        lnet_fini_finalizers();
+        lnet_msg_containers_destroy();
         lnet_destroy_peer_table();
-        lnet_cleanup_handle_hash();
+
+        lnet_res_containers_destroy(the_lnet.ln_me_containers);
+        the_lnet.ln_me_containers = NULL;
+        lnet_res_containers_destroy(the_lnet.ln_md_containers);
+        the_lnet.ln_md_containers = NULL;
+        lnet_res_container_cleanup(&the_lnet.ln_eq_container);
+
         lnet_descriptor_cleanup();
 
         return (0);
 }
 
 lnet_ni_t  *
-lnet_net2ni_locked (__u32 net)
+lnet_net2ni_locked (__u32 net, int cpt)
 {
         cfs_list_t       *tmp;
         lnet_ni_t        *ni;
 
+        /* ln_nis only changes under LNET_LOCK_EX, any net lock will do */
         cfs_list_for_each (tmp, &the_lnet.ln_nis) {
                 ni = cfs_list_entry(tmp, lnet_ni_t, ni_list);
 
                 if (LNET_NIDNET(ni->ni_nid) == net) {
-                        lnet_ni_addref_locked(ni);
+                        lnet_ni_addref_locked(ni, cpt);
                         return ni;
                 }
         }
@@ -834,18 +926,19 @@ int
 lnet_islocalnet (__u32 net)
 {
         lnet_ni_t        *ni;
+        int               cpt = lnet_cpt_current();
 
-        LNET_LOCK();
-        ni = lnet_net2ni_locked(net);
+        lnet_net_lock(cpt);
+        ni = lnet_net2ni_locked(net, cpt);
         if (ni != NULL)
-                lnet_ni_decref_locked(ni);
-        LNET_UNLOCK();
+                lnet_ni_decref_locked(ni, cpt);
+        lnet_net_unlock(cpt);
 
         return ni != NULL;
 }
 
 lnet_ni_t  *
-lnet_nid2ni_locked (lnet_nid_t nid)
+lnet_nid2ni_locked (lnet_nid_t nid, int cpt)
 {
         cfs_list_t       *tmp;
         lnet_ni_t        *ni;
@@ -854,7 +947,7 @@ lnet_nid2ni_locked (lnet_nid_t nid)
                 ni = cfs_list_entry(tmp, lnet_ni_t, ni_list);
 
                 if (ni->ni_nid == nid) {
-                        lnet_ni_addref_locked(ni);
+                        lnet_ni_addref_locked(ni, cpt);
                         return ni;
                 }
         }
@@ -866,12 +959,13 @@ int
 lnet_islocalnid (lnet_nid_t nid)
 {
         lnet_ni_t     *ni;
+        int            cpt = lnet_cpt_current();
 
-        LNET_LOCK();
-        ni = lnet_nid2ni_locked(nid);
+        lnet_net_lock(cpt);
+        ni = lnet_nid2ni_locked(nid, cpt);
         if (ni != NULL)
-                lnet_ni_decref_locked(ni);
-        LNET_UNLOCK();
+                lnet_ni_decref_locked(ni, cpt);
+        lnet_net_unlock(cpt);
 
         return ni != NULL;
 }
@@ -899,6 +993,20 @@ lnet_count_acceptor_nis (void)
         return count;
 }
 
+static int
+lnet_ni_refs_locked(lnet_ni_t *ni)
+{
+        int refs = 0;
+        int i;
+
+        /* called holding LNET_LOCK_EX */
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                refs += ni->ni_refs[i];
+
+        LASSERT (refs >= 0);
+        return refs;
+}
+
 void
 lnet_shutdown_lndnis (void)
 {
@@ -924,19 +1032,22 @@ lnet_shutdown_lndnis (void)
                                     lnet_ni_t, ni_list);
                 cfs_list_del (&ni->ni_list);
 
+                /* NI refs are counted per partition, so nobody can tell
+                 * when the last one goes: wait for them on ln_zombie_nis */
+                cfs_list_add_tail(&ni->ni_list, &the_lnet.ln_zombie_nis);
                 the_lnet.ln_nzombie_nis++;
-                lnet_ni_decref_locked(ni); /* drop ln_nis' ref */
+                lnet_ni_decref_locked(ni, 0); /* drop ln_nis' ref */
         }
 
         /* Drop the cached eqwait NI. */
         if (the_lnet.ln_eqwaitni != NULL) {
-                lnet_ni_decref_locked(the_lnet.ln_eqwaitni);
+                lnet_ni_decref_locked(the_lnet.ln_eqwaitni, 0);
                 the_lnet.ln_eqwaitni = NULL;
         }
 
         /* Drop the cached loopback NI. */
         if (the_lnet.ln_loni != NULL) {
-                lnet_ni_decref_locked(the_lnet.ln_loni);
+                lnet_ni_decref_locked(the_lnet.ln_loni, 0);
                 the_lnet.ln_loni = NULL;
         }
 
@@ -952,12 +1063,21 @@ lnet_shutdown_lndnis (void)
         lnet_clear_peer_table();
 
         LNET_LOCK();
-        /* Now wait for the NI's I just nuked to show up on ln_zombie_nis
-         * and shut them down in guaranteed thread context */
+        /* Now wait for the references on the NI's I just nuked to go and
+         * shut them down in guaranteed thread context */
         i = 2;
         while (the_lnet.ln_nzombie_nis != 0) {
+                cfs_list_t *tmp;
+
+                ni = NULL;
+                cfs_list_for_each(tmp, &the_lnet.ln_zombie_nis) {
+                        ni = cfs_list_entry(tmp, lnet_ni_t, ni_list);
+                        if (lnet_ni_refs_locked(ni) == 0)
+                                break;
+                        ni = NULL;
+                }
 
-                while (cfs_list_empty(&the_lnet.ln_zombie_nis)) {
+                if (ni == NULL) {
                         LNET_UNLOCK();
                         ++i;
                         if ((i & (-i)) == i)
@@ -965,10 +1085,9 @@ lnet_shutdown_lndnis (void)
                                        the_lnet.ln_nzombie_nis);
                         cfs_pause(cfs_time_seconds(1));
                         LNET_LOCK();
+                        continue;
                 }
 
-                ni = cfs_list_entry(the_lnet.ln_zombie_nis.next,
-                                    lnet_ni_t, ni_list);
                 cfs_list_del(&ni->ni_list);
                 ni->ni_lnd->lnd_refcount--;
 
@@ -986,7 +1105,7 @@ lnet_shutdown_lndnis (void)
                         CDEBUG(D_LNI, "Removed LNI %s\n",
                                libcfs_nid2str(ni->ni_nid));
 
-                LIBCFS_FREE(ni, sizeof(*ni));
+                lnet_ni_free(ni);
 
                 LNET_LOCK();
                 the_lnet.ln_nzombie_nis--;
@@ -1002,6 +1121,27 @@ lnet_shutdown_lndnis (void)
         }
 }
 
+/* spread the send credits of \a ni over the partitions */
+static void
+lnet_ni_tq_credits_init(lnet_ni_t *ni)
+{
+        int credits;
+        int i;
+
+        /* give each partition enough credits to keep a few peers busy,
+         * even if that adds up to more than ni_maxtxcredits */
+        credits = ni->ni_maxtxcredits / the_lnet.ln_cpt_number;
+        credits = max(credits, 8 * ni->ni_peertxcredits);
+        credits = min(credits, ni->ni_maxtxcredits);
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                lnet_tx_queue_t *tq = &ni->ni_tx_queues[i];
+
+                tq->tq_credits = tq->tq_credits_min =
+                tq->tq_credits_max = credits;
+        }
+}
+
 int
 lnet_startup_lndnis (void)
 {
@@ -1070,7 +1210,8 @@ lnet_startup_lndnis (void)
                 }
 #endif
 
-                ni->ni_refcount = 1;
+                /* ln_nis' ref */
+                ni->ni_refs[0] = 1;
 
                 LNET_LOCK();
                 lnd->lnd_refcount++;
@@ -1131,11 +1272,11 @@ lnet_startup_lndnis (void)
                         goto failed;
                 }
 
-                ni->ni_txcredits = ni->ni_mintxcredits = ni->ni_maxtxcredits;
+                lnet_ni_tq_credits_init(ni);
 
                 CDEBUG(D_LNI, "Added LNI %s [%d/%d/%d/%d]\n",
                        libcfs_nid2str(ni->ni_nid),
-                       ni->ni_peertxcredits, ni->ni_txcredits,
+                       ni->ni_peertxcredits, ni->ni_maxtxcredits,
                        ni->ni_peerrtrcredits, ni->ni_peertimeout);
 
                 nicount++;
@@ -1157,7 +1298,7 @@ lnet_startup_lndnis (void)
         while (!cfs_list_empty(&nilist)) {
                 ni = cfs_list_entry(nilist.next, lnet_ni_t, ni_list);
                 cfs_list_del(&ni->ni_list);
-                LIBCFS_FREE(ni, sizeof(*ni));
+                lnet_ni_free(ni);
         }
 
         return -ENETDOWN;
@@ -1176,12 +1317,21 @@ lnet_startup_lndnis (void)
 int
 LNetInit(void)
 {
+        int rc;
+
         lnet_assert_wire_constants ();
         LASSERT (!the_lnet.ln_init);
 
         memset(&the_lnet, 0, sizeof(the_lnet));
 
-        lnet_init_locks();
+        the_lnet.ln_cpt_number = cfs_cpt_number();
+        while ((1 << the_lnet.ln_cpt_bits) < the_lnet.ln_cpt_number)
+                the_lnet.ln_cpt_bits++;
+
+        rc = lnet_init_locks();
+        if (rc != 0)
+                return rc;
+
         the_lnet.ln_refcount = 0;
         the_lnet.ln_init = 1;
         LNetInvalidateHandle(&the_lnet.ln_rc_eqh);
@@ -1285,6 +1435,10 @@ LNetNIInit(lnet_pid_t requested_pid)
         if (rc != 0)
                 goto failed2;
 
+        rc = lnet_parse_peer_rails(lnet_get_peer_rails());
+        if (rc != 0)
+                goto failed2;
+
         rc = lnet_alloc_rtrpools(im_a_router);
         if (rc != 0)
                 goto failed2;
@@ -1317,6 +1471,7 @@ LNetNIInit(lnet_pid_t requested_pid)
  failed2:
         lnet_destroy_routes();
         lnet_shutdown_lndnis();
+        lnet_destroy_peer_rails();
  failed1:
         lnet_unprepare();
  failed0:
@@ -1358,6 +1513,7 @@ LNetNIFini()
                 lnet_acceptor_stop();
                 lnet_destroy_routes();
                 lnet_shutdown_lndnis();
+                lnet_destroy_peer_rails();
                 lnet_unprepare();
         }
 
@@ -1576,11 +1732,11 @@ lnet_create_ping_info(void)
 
                 LNET_LOCK();
 
-                ni = lnet_nid2ni_locked(id.nid);
+                ni = lnet_nid2ni_locked(id.nid, LNET_LOCK_EX);
                 LASSERT (ni != NULL);
                 LASSERT (ni->ni_status == NULL);
                 ni->ni_status = ns;
-                lnet_ni_decref_locked(ni);
+                lnet_ni_decref_locked(ni, LNET_LOCK_EX);
 
                 LNET_UNLOCK();
         }
@@ -121,10 +121,26 @@ lnet_net_unique(__u32 net, cfs_list_t *nilist)
         return 1;
 }
 
+void
+lnet_ni_free(lnet_ni_t *ni)
+{
+        if (ni->ni_refs != NULL)
+                LIBCFS_FREE(ni->ni_refs, the_lnet.ln_cpt_number *
+                                         sizeof(ni->ni_refs[0]));
+
+        if (ni->ni_tx_queues != NULL)
+                LIBCFS_FREE(ni->ni_tx_queues, the_lnet.ln_cpt_number *
+                                              sizeof(ni->ni_tx_queues[0]));
+
+        LIBCFS_FREE(ni, sizeof(*ni));
+}
+
 lnet_ni_t *
 lnet_new_ni(__u32 net, cfs_list_t *nilist)
 {
         lnet_ni_t *ni;
+        int        ncpt = the_lnet.ln_cpt_number;
+        int        i;
 
         if (!lnet_net_unique(net, nilist)) {
                 LCONSOLE_ERROR_MSG(0x111, "Duplicate network specified: %s\n",
@@ -144,9 +160,20 @@ lnet_new_ni(__u32 net, cfs_list_t *nilist)
 
         /* LND will fill in the address part of the NID */
         ni->ni_nid = LNET_MKNID(net, 0);
-        CFS_INIT_LIST_HEAD(&ni->ni_txq);
         ni->ni_last_alive = cfs_time_current();
 
+        LIBCFS_ALLOC(ni->ni_refs, ncpt * sizeof(ni->ni_refs[0]));
+        LIBCFS_ALLOC(ni->ni_tx_queues, ncpt * sizeof(ni->ni_tx_queues[0]));
+        if (ni->ni_refs == NULL || ni->ni_tx_queues == NULL) {
+                CERROR("Out of memory creating network %s\n",
+                       libcfs_net2str(net));
+                lnet_ni_free(ni);
+                return NULL;
+        }
+
+        for (i = 0; i < ncpt; i++)
+                CFS_INIT_LIST_HEAD(&ni->ni_tx_queues[i].tq_delayed);
+
         cfs_list_add_tail(&ni->ni_list, nilist);
         return ni;
 }
@@ -295,7 +322,7 @@ lnet_parse_networks(cfs_list_t *nilist, char *networks)
                 ni = cfs_list_entry(nilist->next, lnet_ni_t, ni_list);
                 
                 cfs_list_del(&ni->ni_list);
-                LIBCFS_FREE(ni, sizeof(*ni));
+                lnet_ni_free(ni);
         }
 	LIBCFS_FREE(tokens, tokensize);
         the_lnet.ln_network_tokens = NULL;
@@ -721,6 +748,88 @@ lnet_parse_routes (char *routes, int *im_a_router)
 	return rc;
 }
 
+static int
+lnet_parse_peer_rail(char *str)
+{
+        /* static scratch buffer OK (single threaded) */
+        static char       cmd[LNET_SINGLE_TEXTBUF_NOB];
+
+        lnet_nid_t        nids[LNET_MAX_RAILS];
+        int               nnids = 0;
+        char             *sep = str;
+        char             *token = str;
+
+        /* save a copy of the string for error messages */
+        strncpy(cmd, str, sizeof(cmd) - 1);
+        cmd[sizeof(cmd) - 1] = 0;
+
+        for (;;) {
+                /* scan for token start */
+                while (cfs_iswhite(*sep) || *sep == ',')
+                        sep++;
+                if (*sep == 0)
+                        break;
+
+                token = sep++;
+
+                /* scan for token end */
+                while (*sep != 0 && !cfs_iswhite(*sep) && *sep != ',')
+                        sep++;
+                if (*sep != 0)
+                        *sep++ = 0;
+
+                if (nnids == LNET_MAX_RAILS)
+                        goto token_error;
+
+                nids[nnids] = libcfs_str2nid(token);
+                if (nids[nnids] == LNET_NID_ANY ||
+                    LNET_NETTYP(LNET_NIDNET(nids[nnids])) == LOLND)
+                        goto token_error;
+                nnids++;
+        }
+
+        if (nnids < 2) {
+                lnet_syntax("peer_rails", cmd, 0, strlen(cmd));
+                return -EINVAL;
+        }
+
+        return lnet_add_peer_rails(nids, nnids);
+
+ token_error:
+        lnet_syntax("peer_rails", cmd, (int)(token - str), strlen(token));
+        return -EINVAL;
+}
+
+/* \a rails lists the multi-rail peers, separated by ';' or newlines: each
+ * is the list of its NIDs on different networks, primary NID first */
+int
+lnet_parse_peer_rails(char *rails)
+{
+        cfs_list_t        tbs;
+        lnet_text_buf_t  *ltb;
+        int               rc = 0;
+
+        CFS_INIT_LIST_HEAD(&tbs);
+
+        if (lnet_str2tbs_sep(&tbs, rails) < 0) {
+                CERROR("Error parsing peer rails\n");
+                return -EINVAL;
+        }
+
+        while (!cfs_list_empty(&tbs)) {
+                ltb = cfs_list_entry(tbs.next, lnet_text_buf_t, ltb_list);
+
+                if (rc == 0)
+                        rc = lnet_parse_peer_rail(ltb->ltb_text);
+
+                cfs_list_del(&ltb->ltb_list);
+                lnet_free_text_buf(ltb);
+        }
+
+        LASSERT (lnet_tbnob == 0);
+        return (rc != 0) ? rc : lnet_hash_peer_rails();
+}
+
 void
 lnet_print_range_exprs(cfs_list_t *exprs)
 {
@@ -95,13 +95,15 @@ LNetEQAlloc(unsigned int count, lnet_eq_handler_t callback,
                 return (-ENOMEM);
 
         LIBCFS_ALLOC(eq->eq_events, count * sizeof(lnet_event_t));
-        if (eq->eq_events == NULL) {
-                LNET_LOCK();
-                lnet_eq_free (eq);
-                LNET_UNLOCK();
+        if (eq->eq_events == NULL)
+                goto failed;
 
-                return -ENOMEM;
-        }
+        /* MDs are attached to an EQ under their own partition's res lock,
+         * so each partition counts its references separately */
+        LIBCFS_ALLOC(eq->eq_refs, the_lnet.ln_cpt_number *
+                                  sizeof(eq->eq_refs[0]));
+        if (eq->eq_refs == NULL)
+                goto failed;
 
         /* NB this resets all event sequence numbers to 0, to be earlier
          * than eq_deq_seq */
@@ -110,18 +112,31 @@ LNetEQAlloc(unsigned int count, lnet_eq_handler_t callback,
         eq->eq_deq_seq = 1;
         eq->eq_enq_seq = 1;
         eq->eq_size = count;
-        eq->eq_refcount = 0;
         eq->eq_callback = callback;
 
-        LNET_LOCK();
+        /* the EQ container is shared: it's changed holding all the res
+         * locks and the eq wait lock, so any of them can look EQs up */
+        lnet_res_lock(LNET_LOCK_EX);
+        lnet_eq_wait_lock();
 
-        lnet_initialise_handle (&eq->eq_lh, LNET_COOKIE_TYPE_EQ);
-        cfs_list_add (&eq->eq_list, &the_lnet.ln_active_eqs);
+        lnet_res_lh_initialize(&the_lnet.ln_eq_container, &eq->eq_lh);
+        cfs_list_add(&eq->eq_list, &the_lnet.ln_eq_container.rec_active);
 
-        LNET_UNLOCK();
+        lnet_eq_wait_unlock();
+        lnet_res_unlock(LNET_LOCK_EX);
 
         lnet_eq2handle(handle, eq);
         return (0);
+
+ failed:
+        if (eq->eq_events != NULL)
+                LIBCFS_FREE(eq->eq_events, count * sizeof(lnet_event_t));
+
+        lnet_res_lock(0);
+        lnet_eq_free(eq);
+        lnet_res_unlock(0);
+
+        return -ENOMEM;
 }
 
 /**
@@ -140,38 +155,56 @@ LNetEQFree(lnet_handle_eq_t eqh)
         lnet_eq_t     *eq;
         int            size;
         lnet_event_t  *events;
+        int           *refs;
+        int            refcount = 0;
+        int            rc = 0;
+        int            i;
 
         LASSERT (the_lnet.ln_init);
         LASSERT (the_lnet.ln_refcount > 0);
 
-        LNET_LOCK();
+        /* all the res locks keep MDs from attaching to the EQ while I
+         * count them */
+        lnet_res_lock(LNET_LOCK_EX);
+        lnet_eq_wait_lock();
 
         eq = lnet_handle2eq(&eqh);
         if (eq == NULL) {
-                LNET_UNLOCK();
-                return (-ENOENT);
+                rc = -ENOENT;
+                goto out;
         }
 
-        if (eq->eq_refcount != 0) {
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                refcount += eq->eq_refs[i];
+
+        if (refcount != 0) {
                 CDEBUG(D_NET, "Event queue (%d) busy on destroy.\n",
-                       eq->eq_refcount);
-                LNET_UNLOCK();
-                return (-EBUSY);
+                       refcount);
+                rc = -EBUSY;
+                goto out;
         }
 
         /* stash for free after lock dropped */
         events  = eq->eq_events;
         size    = eq->eq_size;
+        refs    = eq->eq_refs;
 
         lnet_invalidate_handle (&eq->eq_lh);
         cfs_list_del (&eq->eq_list);
         lnet_eq_free (eq);
 
-        LNET_UNLOCK();
+        lnet_eq_wait_unlock();
+        lnet_res_unlock(LNET_LOCK_EX);
 
         LIBCFS_FREE(events, size * sizeof (lnet_event_t));
+        LIBCFS_FREE(refs, the_lnet.ln_cpt_number * sizeof(refs[0]));
 
         return 0;
+
+ out:
+        lnet_eq_wait_unlock();
+        lnet_res_unlock(LNET_LOCK_EX);
+        return rc;
 }
 
 int
@@ -308,30 +341,30 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
         if (neq < 1)
                 RETURN(-ENOENT);
 
-        LNET_LOCK();
+        lnet_eq_wait_lock();
 
         for (;;) {
 #ifndef __KERNEL__
-                LNET_UNLOCK();
+                lnet_eq_wait_unlock();
 
                 /* Recursion breaker */
                 if (the_lnet.ln_rc_state == LNET_RC_STATE_RUNNING &&
                     !LNetHandleIsEqual(eventqs[0], the_lnet.ln_rc_eqh))
                         lnet_router_checker();
 
-                LNET_LOCK();
+                lnet_eq_wait_lock();
 #endif
                 for (i = 0; i < neq; i++) {
                         lnet_eq_t *eq = lnet_handle2eq(&eventqs[i]);
 
                         if (eq == NULL) {
-                                LNET_UNLOCK();
+                                lnet_eq_wait_unlock();
                                 RETURN(-ENOENT);
                         }
 
                         rc = lib_get_event (eq, event);
                         if (rc != 0) {
-                                LNET_UNLOCK();
+                                lnet_eq_wait_unlock();
                                 *which = i;
                                 RETURN(rc);
                         }
@@ -339,15 +372,15 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
 
 #ifdef __KERNEL__
                 if (timeout_ms == 0) {
-                        LNET_UNLOCK();
+                        lnet_eq_wait_unlock();
                         RETURN (0);
                 }
 
                 cfs_waitlink_init(&wl);
                 cfs_set_current_state(CFS_TASK_INTERRUPTIBLE);
-                cfs_waitq_add(&the_lnet.ln_waitq, &wl);
+                cfs_waitq_add(&the_lnet.ln_eq_waitq, &wl);
 
-                LNET_UNLOCK();
+                lnet_eq_wait_unlock();
 
                 if (timeout_ms < 0) {
                         cfs_waitq_wait (&wl, CFS_TASK_INTERRUPTIBLE);
@@ -364,14 +397,14 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
                                 timeout_ms = 0;
                 }
 
-                LNET_LOCK();
-                cfs_waitq_del(&the_lnet.ln_waitq, &wl);
+                lnet_eq_wait_lock();
+                cfs_waitq_del(&the_lnet.ln_eq_waitq, &wl);
 #else
                 if (eqwaitni != NULL) {
                         /* I have a single NI that I have to call into, to get
                          * events queued, or to block. */
-                        lnet_ni_addref_locked(eqwaitni);
-                        LNET_UNLOCK();
+                        lnet_eq_wait_unlock();
+                        lnet_ni_addref(eqwaitni);
 
                         if (timeout_ms <= 0) {
                                 (eqwaitni->ni_lnd->lnd_wait)(eqwaitni, timeout_ms);
@@ -387,8 +420,8 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
                                         timeout_ms = 0;
                         }
 
-                        LNET_LOCK();
-                        lnet_ni_decref_locked(eqwaitni);
+                        lnet_ni_decref(eqwaitni);
+                        lnet_eq_wait_lock();
 
                         /* don't call into eqwaitni again if timeout has
                          * expired */
@@ -399,7 +432,7 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
                 }
 
                 if (timeout_ms == 0) {
-                        LNET_UNLOCK();
+                        lnet_eq_wait_unlock();
                         RETURN (0);
                 }
 
@@ -409,8 +442,8 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
                 LBUG();
 # else
                 if (timeout_ms < 0) {
-                        pthread_cond_wait(&the_lnet.ln_cond,
-                                          &the_lnet.ln_lock);
+                        pthread_cond_wait(&the_lnet.ln_eq_cond,
+                                          &the_lnet.ln_eq_wait_lock);
                 } else {
                         gettimeofday(&then, NULL);
 
@@ -422,8 +455,8 @@ LNetEQPoll (lnet_handle_eq_t *eventqs, int neq, int timeout_ms,
                                 ts.tv_nsec -= 1000000000;
                         }
 
-                        pthread_cond_timedwait(&the_lnet.ln_cond,
-                                               &the_lnet.ln_lock, &ts);
+                        pthread_cond_timedwait(&the_lnet.ln_eq_cond,
+                                               &the_lnet.ln_eq_wait_lock, &ts);
 
                         gettimeofday(&now, NULL);
                         timeout_ms -= (now.tv_sec - then.tv_sec) * 1000 +
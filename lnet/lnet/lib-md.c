@@ -42,7 +42,7 @@
 
 #include <lnet/lib-lnet.h>
 
-/* must be called with LNET_LOCK held */
+/* must be called with the res lock of \a md held */
 void
 lnet_md_unlink(lnet_libmd_t *md)
 {
@@ -73,8 +73,10 @@ lnet_md_unlink(lnet_libmd_t *md)
         CDEBUG(D_NET, "Unlinking md %p\n", md);
 
         if (md->md_eq != NULL) {
-                md->md_eq->eq_refcount--;
-                LASSERT (md->md_eq->eq_refcount >= 0);
+                int cpt = lnet_cpt_of_cookie(md->md_lh.lh_cookie);
+
+                md->md_eq->eq_refs[cpt]--;
+                LASSERT (md->md_eq->eq_refs[cpt] >= 0);
         }
 
         LASSERT (!cfs_list_empty(&md->md_list));
@@ -82,9 +84,9 @@ lnet_md_unlink(lnet_libmd_t *md)
         lnet_md_free(md);
 }
 
-/* must be called with LNET_LOCK held */
+/* must be called with the res lock \a cpt held */
 static int
-lib_md_build(lnet_libmd_t *lmd, lnet_md_t *umd, int unlink)
+lib_md_build(lnet_libmd_t *lmd, lnet_md_t *umd, int unlink, int cpt)
 {
         lnet_eq_t   *eq = NULL;
         int          i;
@@ -183,17 +185,18 @@ lib_md_build(lnet_libmd_t *lmd, lnet_md_t *umd, int unlink)
         }
 
         if (eq != NULL)
-                eq->eq_refcount++;
+                eq->eq_refs[cpt]++;
 
         /* It's good; let handle2md succeed and add to active mds */
-        lnet_initialise_handle (&lmd->md_lh, LNET_COOKIE_TYPE_MD);
+        lnet_res_lh_initialize(the_lnet.ln_md_containers[cpt], &lmd->md_lh);
         LASSERT (cfs_list_empty(&lmd->md_list));
-        cfs_list_add (&lmd->md_list, &the_lnet.ln_active_mds);
+        cfs_list_add(&lmd->md_list,
+                     &the_lnet.ln_md_containers[cpt]->rec_active);
 
         return 0;
 }
 
-/* must be called with LNET_LOCK held */
+/* must be called with the res lock of \a lmd held */
 void
 lnet_md_deconstruct(lnet_libmd_t *lmd, lnet_md_t *umd)
 {
@@ -261,6 +264,7 @@ LNetMDAttach(lnet_handle_me_t meh, lnet_md_t umd,
 {
         lnet_me_t     *me;
         lnet_libmd_t  *md;
+        int            cpt;
         int            rc;
 
         LASSERT (the_lnet.ln_init);
@@ -278,7 +282,9 @@ LNetMDAttach(lnet_handle_me_t meh, lnet_md_t umd,
         if (md == NULL)
                 return -ENOMEM;
 
-        LNET_LOCK();
+        /* the MD lives in the same partition as its ME and portal */
+        cpt = lnet_cpt_of_cookie(meh.cookie);
+        lnet_res_lock(cpt);
 
         me = lnet_handle2me(&meh);
         if (me == NULL) {
@@ -286,7 +292,7 @@ LNetMDAttach(lnet_handle_me_t meh, lnet_md_t umd,
         } else if (me->me_md != NULL) {
                 rc = -EBUSY;
         } else {
-                rc = lib_md_build(md, &umd, unlink);
+                rc = lib_md_build(md, &umd, unlink, cpt);
                 if (rc == 0) {
                         the_lnet.ln_portals[me->me_portal].ptl_ml_version++;
 
@@ -296,16 +302,16 @@ LNetMDAttach(lnet_handle_me_t meh, lnet_md_t umd,
                         lnet_md2handle(handle, md);
 
                         /* check if this MD matches any blocked msgs */
-                        lnet_match_blocked_msg(md);   /* expects LNET_LOCK held */
+                        lnet_match_blocked_msg(md, cpt); /* expects res lock */
 
-                        LNET_UNLOCK();
+                        lnet_res_unlock(cpt);
                         return (0);
                 }
         }
 
         lnet_md_free (md);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
         return (rc);
 }
 
@@ -329,6 +335,7 @@ int
 LNetMDBind(lnet_md_t umd, lnet_unlink_t unlink, lnet_handle_md_t *handle)
 {
         lnet_libmd_t  *md;
+        int            cpt;
         int            rc;
 
         LASSERT (the_lnet.ln_init);
@@ -346,20 +353,21 @@ LNetMDBind(lnet_md_t umd, lnet_unlink_t unlink, lnet_handle_md_t *handle)
         if (md == NULL)
                 return -ENOMEM;
 
-        LNET_LOCK();
+        cpt = lnet_cpt_current();
+        lnet_res_lock(cpt);
 
-        rc = lib_md_build(md, &umd, unlink);
+        rc = lib_md_build(md, &umd, unlink, cpt);
 
         if (rc == 0) {
                 lnet_md2handle(handle, md);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return (0);
         }
 
         lnet_md_free (md);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
         return (rc);
 }
 
@@ -397,15 +405,17 @@ LNetMDUnlink (lnet_handle_md_t mdh)
 {
         lnet_event_t     ev;
         lnet_libmd_t    *md;
+        int              cpt;
 
         LASSERT (the_lnet.ln_init);
         LASSERT (the_lnet.ln_refcount > 0);
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(mdh.cookie);
+        lnet_res_lock(cpt);
 
         md = lnet_handle2md(&mdh);
         if (md == NULL) {
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return -ENOENT;
         }
 
@@ -421,6 +431,6 @@ LNetMDUnlink (lnet_handle_md_t mdh)
 
         lnet_md_unlink(md);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
         return 0;
 }
@@ -42,11 +42,16 @@
 
 #include <lnet/lib-lnet.h>
 
+/* The first ME attached to a portal decides its type: a unique portal
+ * hashes its unique MEs and keeps any wildcard one on ptl_mlist, a wildcard
+ * portal keeps all of them on ptl_mlist. */
 static int
-lnet_me_match_portal(lnet_portal_t *ptl, lnet_process_id_t id,
+lnet_me_match_portal(unsigned int index, lnet_process_id_t id,
                      __u64 match_bits, __u64 ignore_bits)
 {
+        lnet_portal_t    *ptl = &the_lnet.ln_portals[index];
         cfs_list_t       *mhash = NULL;
+        int               cpt = lnet_ptl_cpt(index);
         int               unique;
 
         LASSERT (!(lnet_portal_is_unique(ptl) &&
@@ -56,7 +61,7 @@ lnet_me_match_portal(lnet_portal_t *ptl, lnet_process_id_t id,
         unique = lnet_match_is_unique(id, match_bits, ignore_bits);
         if (likely(lnet_portal_is_unique(ptl) ||
                    lnet_portal_is_wildcard(ptl)))
-                goto match;
+                return 0;
 
         /* unset, new portal */
         if (unique) {
@@ -65,14 +70,14 @@ lnet_me_match_portal(lnet_portal_t *ptl, lnet_process_id_t id,
                         return -ENOMEM;
         }
 
-        LNET_LOCK();
+        lnet_res_lock(cpt);
         if (lnet_portal_is_unique(ptl) ||
             lnet_portal_is_wildcard(ptl)) {
                 /* someone set it before me */
                 if (mhash != NULL)
                         lnet_portal_mhash_free(mhash);
-                LNET_UNLOCK();
-                goto match;
+                lnet_res_unlock(cpt);
+                return 0;
         }
 
         /* still not set */
@@ -83,16 +88,7 @@ lnet_me_match_portal(lnet_portal_t *ptl, lnet_process_id_t id,
         } else {
                 lnet_portal_setopt(ptl, LNET_PTL_MATCH_WILDCARD);
         }
-        LNET_UNLOCK();
-        return 0;
-
- match:
-        if (lnet_portal_is_unique(ptl) && !unique)
-                return -EPERM;
-
-        if (lnet_portal_is_wildcard(ptl) && unique)
-                return -EPERM;
-
+        lnet_res_unlock(cpt);
         return 0;
 }
 
@@ -136,6 +132,7 @@ LNetMEAttach(unsigned int portal,
         lnet_me_t        *me;
         lnet_portal_t    *ptl;
         cfs_list_t       *head;
+        int               cpt;
         int               rc;
 
         LASSERT (the_lnet.ln_init);
@@ -144,8 +141,11 @@ LNetMEAttach(unsigned int portal,
         if ((int)portal >= the_lnet.ln_nportals)
                 return -EINVAL;
 
-        ptl = &the_lnet.ln_portals[portal];
-        rc = lnet_me_match_portal(ptl, match_id, match_bits, ignore_bits);
+        /* messages from a multi-rail peer carry its primary NID */
+        if (match_id.nid != LNET_NID_ANY)
+                match_id.nid = lnet_rail_primary_nid(match_id.nid);
+
+        rc = lnet_me_match_portal(portal, match_id, match_bits, ignore_bits);
         if (rc != 0)
                 return rc;
 
@@ -153,7 +153,8 @@ LNetMEAttach(unsigned int portal,
         if (me == NULL)
                 return -ENOMEM;
 
-        LNET_LOCK();
+        cpt = lnet_ptl_cpt(portal);
+        lnet_res_lock(cpt);
 
         me->me_portal = portal;
         me->me_match_id = match_id;
@@ -162,9 +163,13 @@ LNetMEAttach(unsigned int portal,
         me->me_unlink = unlink;
         me->me_md = NULL;
 
-        lnet_initialise_handle (&me->me_lh, LNET_COOKIE_TYPE_ME);
-        head = lnet_portal_me_head(portal, match_id, match_bits);
-        LASSERT (head != NULL);
+        lnet_res_lh_initialize(the_lnet.ln_me_containers[cpt], &me->me_lh);
+        ptl = &the_lnet.ln_portals[portal];
+        if (lnet_portal_me_is_hashed(ptl, me))
+                head = lnet_portal_mhash_head(ptl, match_id, match_bits);
+        else
+                head = &ptl->ptl_mlist;
+        ptl->ptl_nme++;
 
         if (pos == LNET_INS_AFTER)
                 cfs_list_add_tail(&me->me_list, head);
@@ -173,7 +178,7 @@ LNetMEAttach(unsigned int portal,
 
         lnet_me2handle(handle, me);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
 
         return 0;
 }
@@ -194,6 +199,8 @@ LNetMEAttach(unsigned int portal,
  * \retval 0       On success.
  * \retval -ENOMEM If new ME object cannot be allocated.
  * \retval -ENOENT If \a current_meh does not point to a valid match entry.
+ * \retval -EPERM  If \a current_meh or the new ME is hashed on a unique
+ * portal, where MEs have no order.
  */
 int
 LNetMEInsert(lnet_handle_me_t current_meh,
@@ -205,34 +212,31 @@ LNetMEInsert(lnet_handle_me_t current_meh,
         lnet_me_t     *current_me;
         lnet_me_t     *new_me;
         lnet_portal_t *ptl;
+        int            cpt;
 
         LASSERT (the_lnet.ln_init);
         LASSERT (the_lnet.ln_refcount > 0);
 
+        if (match_id.nid != LNET_NID_ANY)
+                match_id.nid = lnet_rail_primary_nid(match_id.nid);
+
         new_me = lnet_me_alloc();
         if (new_me == NULL)
                 return -ENOMEM;
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(current_meh.cookie);
+        lnet_res_lock(cpt);
 
         current_me = lnet_handle2me(&current_meh);
         if (current_me == NULL) {
                 lnet_me_free (new_me);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return -ENOENT;
         }
 
         LASSERT (current_me->me_portal < the_lnet.ln_nportals);
 
-        ptl = &the_lnet.ln_portals[current_me->me_portal];
-        if (lnet_portal_is_unique(ptl)) {
-                /* nosense to insertion on unique portal */
-                lnet_me_free (new_me);
-                LNET_UNLOCK();
-                return -EPERM;
-        }
-
         new_me->me_portal = current_me->me_portal;
         new_me->me_match_id = match_id;
         new_me->me_match_bits = match_bits;
@@ -240,7 +244,17 @@ LNetMEInsert(lnet_handle_me_t current_meh,
         new_me->me_unlink = unlink;
         new_me->me_md = NULL;
 
-        lnet_initialise_handle (&new_me->me_lh, LNET_COOKIE_TYPE_ME);
+        ptl = &the_lnet.ln_portals[current_me->me_portal];
+        if (lnet_portal_me_is_hashed(ptl, current_me) ||
+            lnet_portal_me_is_hashed(ptl, new_me)) {
+                /* nosense to insertion into a hash chain */
+                lnet_me_free (new_me);
+                lnet_res_unlock(cpt);
+                return -EPERM;
+        }
+        ptl->ptl_nme++;
+
+        lnet_res_lh_initialize(the_lnet.ln_me_containers[cpt], &new_me->me_lh);
 
         if (pos == LNET_INS_AFTER)
                 cfs_list_add(&new_me->me_list, &current_me->me_list);
@@ -249,7 +263,7 @@ LNetMEInsert(lnet_handle_me_t current_meh,
 
         lnet_me2handle(handle, new_me);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
 
         return 0;
 }
@@ -274,15 +288,17 @@ LNetMEUnlink(lnet_handle_me_t meh)
         lnet_me_t    *me;
         lnet_libmd_t *md;
         lnet_event_t  ev;
+        int           cpt;
 
         LASSERT (the_lnet.ln_init);
         LASSERT (the_lnet.ln_refcount > 0);
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(meh.cookie);
+        lnet_res_lock(cpt);
 
         me = lnet_handle2me(&meh);
         if (me == NULL) {
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return -ENOENT;
         }
 
@@ -296,15 +312,16 @@ LNetMEUnlink(lnet_handle_me_t meh)
 
         lnet_me_unlink(me);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
         return 0;
 }
 
-/* call with LNET_LOCK please */
+/* call with the res lock of \a me's portal please */
 void
 lnet_me_unlink(lnet_me_t *me)
 {
         cfs_list_del (&me->me_list);
+        the_lnet.ln_portals[me->me_portal].ptl_nme--;
 
         if (me->me_md != NULL) {
                 me->me_md->md_me = NULL;
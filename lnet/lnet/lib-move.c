@@ -46,9 +46,6 @@ static int local_nid_dist_zero = 1;
 CFS_MODULE_PARM(local_nid_dist_zero, "i", int, 0444,
                 "Reserved");
 
-/* forward ref */
-static void lnet_commit_md (lnet_libmd_t *md, lnet_msg_t *msg);
-
 #define LNET_MATCHMD_NONE     0   /* Didn't match */
 #define LNET_MATCHMD_OK       1   /* Matched OK */
 #define LNET_MATCHMD_DROP     2   /* Must be discarded */
@@ -59,8 +56,8 @@ lnet_try_match_md (int index, int op_mask, lnet_process_id_t src,
                    __u64 match_bits, lnet_libmd_t *md, lnet_msg_t *msg,
                    unsigned int *mlength_out, unsigned int *offset_out)
 {
-        /* ALWAYS called holding the LNET_LOCK, and can't LNET_UNLOCK;
-         * lnet_match_blocked_msg() relies on this to avoid races */
+        /* ALWAYS called holding the res lock of the portal, and can't drop
+         * it; lnet_match_blocked_msg() relies on this to avoid races */
         unsigned int  offset;
         unsigned int  mlength;
         lnet_me_t    *me = md->md_me;
@@ -119,7 +116,7 @@ lnet_try_match_md (int index, int op_mask, lnet_process_id_t src,
                index, libcfs_id2str(src), mlength, rlength,
                md->md_lh.lh_cookie, md->md_niov, offset);
 
-        lnet_commit_md(md, msg);
+        lnet_msg_attach_md(msg, md);
         md->md_offset = offset + mlength;
 
         /* NB Caller will set ev.type and ev.hdr_data */
@@ -148,35 +145,23 @@ lnet_try_match_md (int index, int op_mask, lnet_process_id_t src,
 }
 
 static int
-lnet_match_md(int index, int op_mask, lnet_process_id_t src,
-              unsigned int rlength, unsigned int roffset,
-              __u64 match_bits, lnet_msg_t *msg,
-              unsigned int *mlength_out, unsigned int *offset_out,
-              lnet_libmd_t **md_out)
+lnet_match_me_list(cfs_list_t *head, int index, int op_mask,
+                   lnet_process_id_t src,
+                   unsigned int rlength, unsigned int roffset,
+                   __u64 match_bits, lnet_msg_t *msg,
+                   unsigned int *mlength_out, unsigned int *offset_out,
+                   lnet_libmd_t **md_out)
 {
         lnet_portal_t    *ptl = &the_lnet.ln_portals[index];
-        cfs_list_t       *head;
         lnet_me_t        *me;
         lnet_me_t        *tmp;
         lnet_libmd_t     *md;
         int               rc;
 
-        CDEBUG (D_NET, "Request from %s of length %d into portal %d "
-                "MB="LPX64"\n", libcfs_id2str(src), rlength, index, match_bits);
-
-        if (index < 0 || index >= the_lnet.ln_nportals) {
-                CERROR("Invalid portal %d not in [0-%d]\n",
-                       index, the_lnet.ln_nportals);
-                return LNET_MATCHMD_DROP;
-        }
-
-        head = lnet_portal_me_head(index, src, match_bits);
-        if (head == NULL) /* nobody posted anything on this portal */
-                goto out;
-
         cfs_list_for_each_entry_safe_typed (me, tmp, head,
                                             lnet_me_t, me_list) {
                 md = me->me_md;
+                ptl->ptl_nscan++;
 
                 /* ME attached but MD not attached yet */
                 if (md == NULL)
@@ -195,6 +180,7 @@ lnet_match_md(int index, int op_mask, lnet_process_id_t src,
                         continue;
 
                 case LNET_MATCHMD_OK:
+                        ptl->ptl_nmatch++;
                         *md_out = md;
                         return LNET_MATCHMD_OK;
 
@@ -204,7 +190,46 @@ lnet_match_md(int index, int op_mask, lnet_process_id_t src,
                 /* not reached */
         }
 
- out:
+        return LNET_MATCHMD_NONE;
+}
+
+static int
+lnet_match_md(int index, int op_mask, lnet_process_id_t src,
+              unsigned int rlength, unsigned int roffset,
+              __u64 match_bits, lnet_msg_t *msg,
+              unsigned int *mlength_out, unsigned int *offset_out,
+              lnet_libmd_t **md_out)
+{
+        lnet_portal_t    *ptl = &the_lnet.ln_portals[index];
+        cfs_list_t       *head;
+        int               rc;
+
+        CDEBUG (D_NET, "Request from %s of length %d into portal %d "
+                "MB="LPX64"\n", libcfs_id2str(src), rlength, index, match_bits);
+
+        if (index < 0 || index >= the_lnet.ln_nportals) {
+                CERROR("Invalid portal %d not in [0-%d]\n",
+                       index, the_lnet.ln_nportals);
+                return LNET_MATCHMD_DROP;
+        }
+
+        /* the unique MEs for exactly this peer and match bits are hashed and
+         * win over the wildcard ones */
+        head = lnet_portal_mhash_head(ptl, src, match_bits);
+        if (head != NULL) {
+                rc = lnet_match_me_list(head, index, op_mask, src, rlength,
+                                        roffset, match_bits, msg,
+                                        mlength_out, offset_out, md_out);
+                if (rc != LNET_MATCHMD_NONE)
+                        return rc;
+        }
+
+        rc = lnet_match_me_list(&ptl->ptl_mlist, index, op_mask, src,
+                                rlength, roffset, match_bits, msg,
+                                mlength_out, offset_out, md_out);
+        if (rc != LNET_MATCHMD_NONE)
+                return rc;
+
         if (op_mask == LNET_MD_OP_GET ||
             !lnet_portal_is_lazy(ptl))
                 return LNET_MATCHMD_DROP;
@@ -801,6 +826,15 @@ lnet_compare_routes(lnet_route_t *r1, lnet_route_t *r2)
 {
         lnet_peer_t *p1 = r1->lr_gateway;
         lnet_peer_t *p2 = r2->lr_gateway;
+        int          h1 = lnet_route_health(r1);
+        int          h2 = lnet_route_health(r2);
+
+        /* a route failing sends loses to a healthy one, however short */
+        if (h1 >= LNET_ROUTE_HEALTH_SICK && h2 < LNET_ROUTE_HEALTH_SICK)
+                return 1;
+
+        if (h1 < LNET_ROUTE_HEALTH_SICK && h2 >= LNET_ROUTE_HEALTH_SICK)
+                return -1;
 
         if (r1->lr_hops < r2->lr_hops)
                 return 1;
@@ -808,6 +842,14 @@ lnet_compare_routes(lnet_route_t *r1, lnet_route_t *r2)
         if (r1->lr_hops > r2->lr_hops)
                 return -1;
 
+        /* then the one whose health holds up best, in coarse steps so
+         * that equally good routes still share the load */
+        if (h1 / (LNET_ROUTE_HEALTH_MAX / 4) > h2 / (LNET_ROUTE_HEALTH_MAX / 4))
+                return 1;
+
+        if (h1 / (LNET_ROUTE_HEALTH_MAX / 4) < h2 / (LNET_ROUTE_HEALTH_MAX / 4))
+                return -1;
+
         if (p1->lp_txqnob < p2->lp_txqnob)
                 return 1;
 
@@ -874,47 +916,54 @@ lnet_ni_send(lnet_ni_t *ni, lnet_msg_t *msg)
         LASSERT (LNET_NETTYP(LNET_NIDNET(ni->ni_nid)) == LOLND ||
                  (msg->msg_txcredit && msg->msg_peertxcredit));
 
+        if (msg->msg_target_is_router &&
+            !cfs_list_empty (&the_lnet.ln_test_peers) && /* normally we don't */
+            fail_peer (msg->msg_txpeer->lp_nid, 1))     /* shall we now? */
+        {
+                /* fail it as the gateway would, so route health sees it */
+                CERROR("Dropping message for %s via %s: simulated failure\n",
+                       libcfs_nid2str(le64_to_cpu(msg->msg_hdr.dest_nid)),
+                       libcfs_nid2str(msg->msg_txpeer->lp_nid));
+                lnet_finalize(ni, msg, -EIO);
+                return;
+        }
+
         rc = (ni->ni_lnd->lnd_send)(ni, priv, msg);
         if (rc < 0)
                 lnet_finalize(ni, msg, rc);
 }
 
-int
-lnet_eager_recv_locked(lnet_msg_t *msg)
+/* NB: called without any lock held; the caller must check the state it
+ * cares about again afterwards */
+static int
+lnet_ni_eager_recv(lnet_ni_t *ni, lnet_msg_t *msg)
 {
-        lnet_peer_t *peer;
-        lnet_ni_t   *ni;
-        int          rc = 0;
+        int rc = 0;
 
         LASSERT (!msg->msg_delayed);
         msg->msg_delayed = 1;
 
         LASSERT (msg->msg_receiving);
         LASSERT (!msg->msg_sending);
-
-        peer = msg->msg_rxpeer;
-        ni   = peer->lp_ni;
+        LASSERT (ni == msg->msg_rxpeer->lp_ni);
 
         if (ni->ni_lnd->lnd_eager_recv != NULL) {
-                LNET_UNLOCK();
-
                 rc = (ni->ni_lnd->lnd_eager_recv)(ni, msg->msg_private, msg,
                                                   &msg->msg_private);
                 if (rc != 0) {
                         CERROR("recv from %s / send to %s aborted: "
                                "eager_recv failed %d\n",
-                               libcfs_nid2str(peer->lp_nid),
+                               libcfs_nid2str(msg->msg_rxpeer->lp_nid),
                                libcfs_id2str(msg->msg_target), rc);
                         LASSERT (rc < 0); /* required by my callers */
                 }
-
-                LNET_LOCK();
         }
 
         return rc;
 }
 
-/* NB: caller shall hold a ref on 'lp' as I'd drop LNET_LOCK */
+/* NB: caller shall hold a ref on 'lp' as I'd drop the net lock of
+ * lp->lp_cpt */
 void
 lnet_ni_peer_alive(lnet_peer_t *lp)
 {
@@ -924,9 +973,9 @@ lnet_ni_peer_alive(lnet_peer_t *lp)
         LASSERT (lnet_peer_aliveness_enabled(lp));
         LASSERT (ni->ni_lnd->lnd_query != NULL);
 
-        LNET_UNLOCK();
+        lnet_net_unlock(lp->lp_cpt);
         (ni->ni_lnd->lnd_query)(ni, lp->lp_nid, &last_alive);
-        LNET_LOCK();
+        lnet_net_lock(lp->lp_cpt);
 
         lp->lp_last_query = cfs_time_current();
 
@@ -935,7 +984,7 @@ lnet_ni_peer_alive(lnet_peer_t *lp)
         return;
 }
 
-/* NB: always called with LNET_LOCK held */
+/* NB: always called with the net lock of lp->lp_cpt held */
 static inline int
 lnet_peer_is_alive (lnet_peer_t *lp, cfs_time_t now)
 {
@@ -968,7 +1017,7 @@ lnet_peer_is_alive (lnet_peer_t *lp, cfs_time_t now)
 
 
 /* NB: returns 1 when alive, 0 when dead, negative when error;
- *     may drop the LNET_LOCK */
+ *     may drop the net lock of lp->lp_cpt */
 int
 lnet_peer_alive_locked (lnet_peer_t *lp)
 {
@@ -1014,30 +1063,36 @@ lnet_peer_alive_locked (lnet_peer_t *lp)
 int
 lnet_post_send_locked (lnet_msg_t *msg, int do_send)
 {
-        /* lnet_send is going to LNET_UNLOCK immediately after this, so it sets
+        /* lnet_send is going to unlock immediately after this, so it sets
          * do_send FALSE and I don't do the unlock/send/lock bit.  I return
          * EAGAIN if msg blocked, EHOSTUNREACH if msg_txpeer appears dead, and
-         * 0 if sent or OK to send */
-        lnet_peer_t *lp = msg->msg_txpeer;
-        lnet_ni_t   *ni = lp->lp_ni;
+         * 0 if sent or OK to send.  ALWAYS called holding the net lock of
+         * msg->msg_tx_cpt */
+        lnet_peer_t     *lp = msg->msg_txpeer;
+        lnet_ni_t       *ni = lp->lp_ni;
+        int              cpt = msg->msg_tx_cpt;
+        lnet_tx_queue_t *tq = &ni->ni_tx_queues[cpt];
+        lnet_counters_t *counters;
 
         /* non-lnet_send() callers have checked before */
         LASSERT (!do_send || msg->msg_delayed);
         LASSERT (!msg->msg_receiving);
+        LASSERT (lp->lp_cpt == cpt);
 
         /* NB 'lp' is always the next hop */
         if ((msg->msg_target.pid & LNET_PID_USERFLAG) == 0 &&
             lnet_peer_alive_locked(lp) == 0) {
-                the_lnet.ln_counters.drop_count++;
-                the_lnet.ln_counters.drop_length += msg->msg_len;
-                LNET_UNLOCK();
+                counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+                counters->drop_count++;
+                counters->drop_length += msg->msg_len;
+                lnet_net_unlock(cpt);
 
                 CNETERR("Dropping message for %s: peer not alive\n",
                         libcfs_id2str(msg->msg_target));
                 if (do_send)
                         lnet_finalize(ni, msg, -EHOSTUNREACH);
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
                 return EHOSTUNREACH;
         }
 
@@ -1060,26 +1115,26 @@ lnet_post_send_locked (lnet_msg_t *msg, int do_send)
         }
 
         if (!msg->msg_txcredit) {
-                LASSERT ((ni->ni_txcredits < 0) ==
-                         !cfs_list_empty(&ni->ni_txq));
+                LASSERT ((tq->tq_credits < 0) ==
+                         !cfs_list_empty(&tq->tq_delayed));
 
                 msg->msg_txcredit = 1;
-                ni->ni_txcredits--;
+                tq->tq_credits--;
 
-                if (ni->ni_txcredits < ni->ni_mintxcredits)
-                        ni->ni_mintxcredits = ni->ni_txcredits;
+                if (tq->tq_credits < tq->tq_credits_min)
+                        tq->tq_credits_min = tq->tq_credits;
 
-                if (ni->ni_txcredits < 0) {
+                if (tq->tq_credits < 0) {
                         msg->msg_delayed = 1;
-                        cfs_list_add_tail(&msg->msg_list, &ni->ni_txq);
+                        cfs_list_add_tail(&msg->msg_list, &tq->tq_delayed);
                         return EAGAIN;
                 }
         }
 
         if (do_send) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 lnet_ni_send(ni, msg);
-                LNET_LOCK();
+                lnet_net_lock(cpt);
         }
         return 0;
 }
@@ -1088,32 +1143,34 @@ lnet_post_send_locked (lnet_msg_t *msg, int do_send)
 static void
 lnet_commit_routedmsg (lnet_msg_t *msg)
 {
-        /* ALWAYS called holding the LNET_LOCK */
-        LASSERT (msg->msg_routing);
+        /* ALWAYS called holding the net lock of msg->msg_rx_cpt */
+        lnet_counters_t *counters;
 
-        the_lnet.ln_counters.msgs_alloc++;
-        if (the_lnet.ln_counters.msgs_alloc >
-            the_lnet.ln_counters.msgs_max)
-                the_lnet.ln_counters.msgs_max =
-                        the_lnet.ln_counters.msgs_alloc;
+        LASSERT (msg->msg_routing);
 
-        the_lnet.ln_counters.route_count++;
-        the_lnet.ln_counters.route_length += msg->msg_len;
+        lnet_msg_commit(msg, msg->msg_rx_cpt);
 
-        LASSERT (!msg->msg_onactivelist);
-        msg->msg_onactivelist = 1;
-        cfs_list_add (&msg->msg_activelist, &the_lnet.ln_active_msgs);
+        counters = &the_lnet.ln_msg_containers[msg->msg_rx_cpt]->msc_counters;
+        counters->route_count++;
+        counters->route_length += msg->msg_len;
 }
 
 lnet_rtrbufpool_t *
 lnet_msg2bufpool(lnet_msg_t *msg)
 {
-        lnet_rtrbufpool_t *rbp = &the_lnet.ln_rtrpools[0];
+        lnet_rtrbufpool_t *pools;
+        lnet_rtrbufpool_t *rbp;
+
+        /* routed messages use the buffers of the partition they arrived on */
+        LASSERT (msg->msg_rx_cpt >= 0 &&
+                 msg->msg_rx_cpt < the_lnet.ln_cpt_number);
+        pools = the_lnet.ln_rtrpools[msg->msg_rx_cpt];
+        rbp = &pools[0];
 
         LASSERT (msg->msg_len <= LNET_MTU);
         while (msg->msg_len > (unsigned int)rbp->rbp_npages * CFS_PAGE_SIZE) {
                 rbp++;
-                LASSERT (rbp < &the_lnet.ln_rtrpools[LNET_NRBPOOLS]);
+                LASSERT (rbp < &pools[LNET_NRBPOOLS]);
         }
 
         return rbp;
@@ -1122,9 +1179,11 @@ lnet_msg2bufpool(lnet_msg_t *msg)
 int
 lnet_post_routed_recv_locked (lnet_msg_t *msg, int do_recv)
 {
-        /* lnet_parse is going to LNET_UNLOCK immediately after this, so it
+        /* lnet_parse is going to unlock immediately after this, so it
          * sets do_recv FALSE and I don't do the unlock/send/lock bit.  I
-         * return EAGAIN if msg blocked and 0 if received or OK to receive */
+         * return EAGAIN if msg blocked and 0 if received or OK to receive.
+         * ALWAYS called holding the net lock of msg->msg_rx_cpt, which
+         * covers both the peer's router credits and the router buffers */
         lnet_peer_t         *lp = msg->msg_rxpeer;
         lnet_rtrbufpool_t   *rbp;
         lnet_rtrbuf_t       *rb;
@@ -1166,10 +1225,13 @@ lnet_post_routed_recv_locked (lnet_msg_t *msg, int do_recv)
                 rbp->rbp_credits--;
                 if (rbp->rbp_credits < rbp->rbp_mincredits)
                         rbp->rbp_mincredits = rbp->rbp_credits;
+                if (rbp->rbp_credits < rbp->rbp_lowcredits)
+                        rbp->rbp_lowcredits = rbp->rbp_credits;
 
                 if (rbp->rbp_credits < 0) {
                         /* must have checked eager_recv before here */
                         LASSERT (msg->msg_delayed);
+                        rbp->rbp_nblocked++;
                         cfs_list_add_tail(&msg->msg_list, &rbp->rbp_msgs);
                         return EAGAIN;
                 }
@@ -1183,34 +1245,40 @@ lnet_post_routed_recv_locked (lnet_msg_t *msg, int do_recv)
         msg->msg_kiov = &rb->rb_kiov[0];
 
         if (do_recv) {
-                LNET_UNLOCK();
+                int cpt = msg->msg_rx_cpt;
+
+                lnet_net_unlock(cpt);
                 lnet_ni_recv(lp->lp_ni, msg->msg_private, msg, 1,
                              0, msg->msg_len, msg->msg_len);
-                LNET_LOCK();
+                lnet_net_lock(cpt);
         }
         return 0;
 }
 #endif
 
 void
-lnet_return_credits_locked (lnet_msg_t *msg)
+lnet_return_tx_credits_locked(lnet_msg_t *msg)
 {
+        /* ALWAYS called holding the net lock of msg->msg_tx_cpt */
         lnet_peer_t       *txpeer = msg->msg_txpeer;
-        lnet_peer_t       *rxpeer = msg->msg_rxpeer;
         lnet_msg_t        *msg2;
         lnet_ni_t         *ni;
 
         if (msg->msg_txcredit) {
+                lnet_tx_queue_t *tq;
+
                 /* give back NI txcredits */
                 msg->msg_txcredit = 0;
                 ni = txpeer->lp_ni;
+                tq = &ni->ni_tx_queues[msg->msg_tx_cpt];
 
-                LASSERT((ni->ni_txcredits < 0) == !cfs_list_empty(&ni->ni_txq));
+                LASSERT((tq->tq_credits < 0) ==
+                        !cfs_list_empty(&tq->tq_delayed));
 
-                ni->ni_txcredits++;
-                if (ni->ni_txcredits <= 0) {
-                        msg2 = cfs_list_entry(ni->ni_txq.next, lnet_msg_t,
-                                              msg_list);
+                tq->tq_credits++;
+                if (tq->tq_credits <= 0) {
+                        msg2 = cfs_list_entry(tq->tq_delayed.next,
+                                              lnet_msg_t, msg_list);
                         cfs_list_del(&msg2->msg_list);
 
                         LASSERT(msg2->msg_txpeer->lp_ni == ni);
@@ -1244,13 +1312,31 @@ lnet_return_credits_locked (lnet_msg_t *msg)
         }
 
         if (txpeer != NULL) {
+                if (msg->msg_target_is_router) {
+                        /* the gateway's partition is locked: tell its
+                         * route how the send went */
+                        lnet_nid_t dst = le64_to_cpu(msg->msg_hdr.dest_nid);
+
+                        lnet_route_health_update_locked(txpeer,
+                                                        LNET_NIDNET(dst),
+                                                        msg->msg_ev.status == 0);
+                }
+
                 msg->msg_txpeer = NULL;
                 lnet_peer_decref_locked(txpeer);
         }
+}
 
+void
+lnet_return_rx_credits_locked(lnet_msg_t *msg)
+{
+        /* ALWAYS called holding the net lock of msg->msg_rx_cpt */
+        lnet_peer_t       *rxpeer = msg->msg_rxpeer;
 #ifdef __KERNEL__
+        lnet_msg_t        *msg2;
+
         if (msg->msg_rtrcredit) {
-                /* give back global router credits */
+                /* give back router credits of my partition */
                 lnet_rtrbuf_t     *rb;
                 lnet_rtrbufpool_t *rbp;
 
@@ -1317,9 +1403,11 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
         lnet_remotenet_t *rnet;
         lnet_route_t     *route;
         lnet_route_t     *best_route;
+        lnet_route_t     *last_route;
         cfs_list_t       *tmp;
         lnet_peer_t      *lp;
         lnet_peer_t      *lp2;
+        int               cpt;
         int               rc;
 
         LASSERT (msg->msg_txpeer == NULL);
@@ -1331,19 +1419,29 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
 
         /* NB! ni != NULL == interface pre-determined (ACK/REPLY) */
 
-        LNET_LOCK();
+        if (!msg->msg_routing && lnet_select_rail(&dst_nid)) {
+                /* a multi-rail peer: send on its best rail right now,
+                 * whichever interface the caller wanted */
+                msg->msg_target.nid = dst_nid;
+                msg->msg_hdr.dest_nid = cpu_to_le64(dst_nid);
+                src_nid = LNET_NID_ANY;
+        }
+
+        cpt = lnet_cpt_of_nid(dst_nid);
+ again:
+        lnet_net_lock(cpt);
 
         if (the_lnet.ln_shutdown) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 return -ESHUTDOWN;
         }
 
         if (src_nid == LNET_NID_ANY) {
                 src_ni = NULL;
         } else {
-                src_ni = lnet_nid2ni_locked(src_nid);
+                src_ni = lnet_nid2ni_locked(src_nid, cpt);
                 if (src_ni == NULL) {
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
                         LCONSOLE_WARN("Can't send to %s: src %s is not a "
                                       "local nid\n", libcfs_nid2str(dst_nid),
                                       libcfs_nid2str(src_nid));
@@ -1353,18 +1451,18 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
         }
 
         /* Is this for someone on a local network? */
-        local_ni = lnet_net2ni_locked(LNET_NIDNET(dst_nid));
+        local_ni = lnet_net2ni_locked(LNET_NIDNET(dst_nid), cpt);
 
         if (local_ni != NULL) {
                 if (src_ni == NULL) {
                         src_ni = local_ni;
                         src_nid = src_ni->ni_nid;
                 } else if (src_ni == local_ni) {
-                        lnet_ni_decref_locked(local_ni);
+                        lnet_ni_decref_locked(local_ni, cpt);
                 } else {
-                        lnet_ni_decref_locked(local_ni);
-                        lnet_ni_decref_locked(src_ni);
-                        LNET_UNLOCK();
+                        lnet_ni_decref_locked(local_ni, cpt);
+                        lnet_ni_decref_locked(src_ni, cpt);
+                        lnet_net_unlock(cpt);
                         LCONSOLE_WARN("No route to %s via from %s\n",
                                       libcfs_nid2str(dst_nid),
                                       libcfs_nid2str(src_nid));
@@ -1378,16 +1476,17 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
 
                 if (src_ni == the_lnet.ln_loni) {
                         /* No send credit hassles with LOLND */
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
                         lnet_ni_send(src_ni, msg);
                         lnet_ni_decref(src_ni);
                         return 0;
                 }
 
-                rc = lnet_nid2peer_locked(&lp, dst_nid);
-                lnet_ni_decref_locked(src_ni);  /* lp has ref on src_ni; lose mine */
+                rc = lnet_nid2peer_locked(&lp, dst_nid, cpt);
+                /* lp has ref on src_ni; lose mine */
+                lnet_ni_decref_locked(src_ni, cpt);
                 if (rc != 0) {
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
                         LCONSOLE_WARN("Error %d finding peer %s\n", rc,
                                       libcfs_nid2str(dst_nid));
                         /* ENOMEM or shutting down */
@@ -1396,7 +1495,7 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
                 LASSERT (lp->lp_ni == src_ni);
         } else {
 #ifndef __KERNEL__
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
 
                 /* NB
                  * - once application finishes computation, check here to update
@@ -1406,40 +1505,59 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
                 if (the_lnet.ln_rc_state == LNET_RC_STATE_RUNNING)
                         lnet_router_checker();
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 #endif
                 /* sending to a remote network */
                 rnet = lnet_find_net_locked(LNET_NIDNET(dst_nid));
                 if (rnet == NULL) {
                         if (src_ni != NULL)
-                                lnet_ni_decref_locked(src_ni);
-                        LNET_UNLOCK();
+                                lnet_ni_decref_locked(src_ni, cpt);
+                        lnet_net_unlock(cpt);
                         LCONSOLE_WARN("No route to %s\n",
                                       libcfs_id2str(msg->msg_target));
                         return -EHOSTUNREACH;
                 }
 
-                /* Find the best gateway I can use */
+                /* Find the best gateway I can use.  The routes only change
+                 * under LNET_LOCK_EX, but the gateways' credits are read
+                 * without their own lock: good enough to choose one. */
                 lp = NULL;
                 best_route = NULL;
+                last_route = NULL;
                 cfs_list_for_each(tmp, &rnet->lrn_routes) {
                         route = cfs_list_entry(tmp, lnet_route_t, lr_list);
                         lp2 = route->lr_gateway;
 
-                        if (lp2->lp_alive &&
-                            lnet_router_down_ni(lp2, rnet->lrn_net) <= 0 &&
-                            (src_ni == NULL || lp2->lp_ni == src_ni) &&
-                            (lp == NULL ||
-                             lnet_compare_routes(route, best_route) > 0)) {
-                                best_route = route;
-                                lp = lp2;
+                        if (last_route == NULL ||
+                            (int)(route->lr_seq - last_route->lr_seq) > 0)
+                                last_route = route;
+
+                        if (!lp2->lp_alive ||
+                            lnet_router_down_ni(lp2, rnet->lrn_net) > 0 ||
+                            (src_ni != NULL && lp2->lp_ni != src_ni))
+                                continue;
+
+                        if (lp != NULL) {
+                                rc = lnet_compare_routes(route, best_route);
+                                if (rc < 0)
+                                        continue;
+
+                                /* everything else being equal, take the
+                                 * route used least recently, for fairness */
+                                if (rc == 0 &&
+                                    (int)(route->lr_seq -
+                                          best_route->lr_seq) >= 0)
+                                        continue;
                         }
+
+                        best_route = route;
+                        lp = lp2;
                 }
 
                 if (lp == NULL) {
                         if (src_ni != NULL)
-                                lnet_ni_decref_locked(src_ni);
-                        LNET_UNLOCK();
+                                lnet_ni_decref_locked(src_ni, cpt);
+                        lnet_net_unlock(cpt);
 
                         LCONSOLE_WARN("No route to %s via %s "
                                       "(all routers down)\n",
@@ -1448,17 +1566,25 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
                         return -EHOSTUNREACH;
                 }
 
-                /* Place selected route at the end of the route list to ensure
-                 * fairness; everything else being equal... */
-                cfs_list_del(&best_route->lr_list);
-                cfs_list_add_tail(&best_route->lr_list, &rnet->lrn_routes);
+                if (lp->lp_cpt != cpt) {
+                        /* the gateway's credits live on another partition:
+                         * lock that one and choose again */
+                        if (src_ni != NULL)
+                                lnet_ni_decref_locked(src_ni, cpt);
+                        lnet_net_unlock(cpt);
+
+                        cpt = lp->lp_cpt;
+                        goto again;
+                }
+
+                best_route->lr_seq = last_route->lr_seq + 1;
 
                 if (src_ni == NULL) {
                         src_ni = lp->lp_ni;
                         src_nid = src_ni->ni_nid;
                 } else {
                         LASSERT (src_ni == lp->lp_ni);
-                        lnet_ni_decref_locked(src_ni);
+                        lnet_ni_decref_locked(src_ni, cpt);
                 }
 
                 lnet_peer_addref_locked(lp);
@@ -1482,9 +1608,10 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
         LASSERT (msg->msg_txpeer == NULL);
 
         msg->msg_txpeer = lp;                   /* msg takes my ref on lp */
+        msg->msg_tx_cpt = cpt;
 
         rc = lnet_post_send_locked(msg, 0);
-        LNET_UNLOCK();
+        lnet_net_unlock(cpt);
 
         if (rc == EHOSTUNREACH)
                 return -EHOSTUNREACH;
@@ -1496,40 +1623,15 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg)
 }
 
 static void
-lnet_commit_md (lnet_libmd_t *md, lnet_msg_t *msg)
+lnet_drop_message(lnet_ni_t *ni, int cpt, void *private, unsigned int nob)
 {
-        /* ALWAYS called holding the LNET_LOCK */
-        /* Here, we commit the MD to a network OP by marking it busy and
-         * decrementing its threshold.  Come what may, the network "owns"
-         * the MD until a call to lnet_finalize() signals completion. */
-        LASSERT (!msg->msg_routing);
-
-        msg->msg_md = md;
-
-        md->md_refcount++;
-        if (md->md_threshold != LNET_MD_THRESH_INF) {
-                LASSERT (md->md_threshold > 0);
-                md->md_threshold--;
-        }
-
-        the_lnet.ln_counters.msgs_alloc++;
-        if (the_lnet.ln_counters.msgs_alloc > 
-            the_lnet.ln_counters.msgs_max)
-                the_lnet.ln_counters.msgs_max = 
-                        the_lnet.ln_counters.msgs_alloc;
-
-        LASSERT (!msg->msg_onactivelist);
-        msg->msg_onactivelist = 1;
-        cfs_list_add (&msg->msg_activelist, &the_lnet.ln_active_msgs);
-}
+        lnet_counters_t *counters;
 
-static void
-lnet_drop_message (lnet_ni_t *ni, void *private, unsigned int nob)
-{
-        LNET_LOCK();
-        the_lnet.ln_counters.drop_count++;
-        the_lnet.ln_counters.drop_length += nob;
-        LNET_UNLOCK();
+        lnet_net_lock(cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->drop_count++;
+        counters->drop_length += nob;
+        lnet_net_unlock(cpt);
 
         lnet_ni_recv(ni, private, NULL, 0, 0, 0, nob);
 }
@@ -1560,17 +1662,15 @@ lnet_drop_delayed_put(lnet_msg_t *msg, char *reason)
          * called lnet_drop_message(), so I just hang onto msg as well
          * until that's done */
 
-        lnet_drop_message(msg->msg_rxpeer->lp_ni,
+        lnet_drop_message(msg->msg_rxpeer->lp_ni, msg->msg_rx_cpt,
                           msg->msg_private, msg->msg_len);
 
-        LNET_LOCK();
-
+        lnet_net_lock(msg->msg_rx_cpt);
         lnet_peer_decref_locked(msg->msg_rxpeer);
         msg->msg_rxpeer = NULL;
+        lnet_net_unlock(msg->msg_rx_cpt);
 
         lnet_msg_free(msg);
-
-        LNET_UNLOCK();
 }
 
 /**
@@ -1611,9 +1711,9 @@ LNetSetLazyPortal(int portal)
 
         CDEBUG(D_NET, "Setting portal %d lazy\n", portal);
 
-        LNET_LOCK();
+        lnet_res_lock(lnet_ptl_cpt(portal));
         lnet_portal_setopt(ptl, LNET_PTL_LAZY);
-        LNET_UNLOCK();
+        lnet_res_unlock(lnet_ptl_cpt(portal));
 
         return 0;
 }
@@ -1633,14 +1733,16 @@ LNetClearLazyPortal(int portal)
         cfs_list_t        zombies;
         lnet_portal_t    *ptl = &the_lnet.ln_portals[portal];
         lnet_msg_t       *msg;
+        int               cpt;
 
         if (portal < 0 || portal >= the_lnet.ln_nportals)
                 return -EINVAL;
 
-        LNET_LOCK();
+        cpt = lnet_ptl_cpt(portal);
+        lnet_res_lock(cpt);
 
         if (!lnet_portal_is_lazy(ptl)) {
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return 0;
         }
 
@@ -1656,7 +1758,7 @@ LNetClearLazyPortal(int portal)
         ptl->ptl_msgq_version++;
         lnet_portal_unsetopt(ptl, LNET_PTL_LAZY);
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
 
         while (!cfs_list_empty(&zombies)) {
                 msg = cfs_list_entry(zombies.next, lnet_msg_t, msg_list);
@@ -1673,13 +1775,17 @@ lnet_recv_put(lnet_libmd_t *md, lnet_msg_t *msg, int delayed,
               unsigned int offset, unsigned int mlength)
 {
         lnet_hdr_t       *hdr = &msg->msg_hdr;
+        lnet_counters_t  *counters;
+        int               cpt = msg->msg_rx_cpt;
 
-        LNET_LOCK();
+        lnet_net_lock(cpt);
 
-        the_lnet.ln_counters.recv_count++;
-        the_lnet.ln_counters.recv_length += mlength;
+        lnet_msg_commit(msg, cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->recv_count++;
+        counters->recv_length += mlength;
 
-        LNET_UNLOCK();
+        lnet_net_unlock(cpt);
 
         if (mlength != 0)
                 lnet_setpayloadbuffer(msg);
@@ -1700,9 +1806,9 @@ lnet_recv_put(lnet_libmd_t *md, lnet_msg_t *msg, int delayed,
                      hdr->payload_length);
 }
 
-/* called with LNET_LOCK held */
+/* called holding the res lock \a cpt of the portal \a md is attached to */
 void
-lnet_match_blocked_msg(lnet_libmd_t *md)
+lnet_match_blocked_msg(lnet_libmd_t *md, int cpt)
 {
         CFS_LIST_HEAD    (drops);
         CFS_LIST_HEAD    (matches);
@@ -1737,7 +1843,7 @@ lnet_match_blocked_msg(lnet_libmd_t *md)
                 hdr   = &msg->msg_hdr;
                 index = hdr->msg.put.ptl_index;
 
-                src.nid = hdr->src_nid;
+                src.nid = lnet_rail_primary_nid(hdr->src_nid);
                 src.pid = hdr->src_pid;
 
                 rc = lnet_try_match_md(index, LNET_MD_OP_PUT, src,
@@ -1773,7 +1879,7 @@ lnet_match_blocked_msg(lnet_libmd_t *md)
                         break;
         }
 
-        LNET_UNLOCK();
+        lnet_res_unlock(cpt);
 
         cfs_list_for_each_safe (entry, tmp, &drops) {
                 msg = cfs_list_entry(entry, lnet_msg_t, msg_list);
@@ -1795,7 +1901,7 @@ lnet_match_blocked_msg(lnet_libmd_t *md)
                               msg->msg_ev.mlength);
         }
 
-        LNET_LOCK();
+        lnet_res_lock(cpt);
 }
 
 static int
@@ -1811,8 +1917,11 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
         lnet_process_id_t src= {0};
         lnet_libmd_t     *md;
         lnet_portal_t    *ptl;
+        int               cpt;
 
-        src.nid = hdr->src_nid;
+        /* a multi-rail peer is matched by its primary NID, whichever
+         * rail this came on */
+        src.nid = lnet_rail_primary_nid(hdr->src_nid);
         src.pid = hdr->src_pid;
 
         /* Convert put fields to host byte order */
@@ -1821,8 +1930,9 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
         hdr->msg.put.offset = le32_to_cpu(hdr->msg.put.offset);
 
         index = hdr->msg.put.ptl_index;
+        cpt = lnet_ptl_cpt(index);
 
-        LNET_LOCK();
+        lnet_res_lock(cpt);
 
  again:
         rc = lnet_match_md(index, LNET_MD_OP_PUT, src,
@@ -1834,7 +1944,7 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
                 LBUG();
 
         case LNET_MATCHMD_OK:
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 lnet_recv_put(md, msg, msg->msg_delayed, offset, mlength);
                 return 0;
 
@@ -1843,8 +1953,13 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
                 version = ptl->ptl_ml_version;
 
                 rc = 0;
-                if (!msg->msg_delayed)
-                        rc = lnet_eager_recv_locked(msg);
+                if (!msg->msg_delayed) {
+                        /* the LND may block getting the message off the
+                         * wire, so don't hold the res lock */
+                        lnet_res_unlock(cpt);
+                        rc = lnet_ni_eager_recv(ni, msg);
+                        lnet_res_lock(cpt);
+                }
 
                 if (rc == 0 &&
                     !the_lnet.ln_shutdown &&
@@ -1854,7 +1969,7 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
 
                         cfs_list_add_tail(&msg->msg_list, &ptl->ptl_msgq);
                         ptl->ptl_msgq_version++;
-                        LNET_UNLOCK();
+                        lnet_res_unlock(cpt);
 
                         CDEBUG(D_NET, "Delaying PUT from %s portal %d match "
                                LPU64" offset %d length %d: no match \n",
@@ -1871,7 +1986,7 @@ lnet_parse_put(lnet_ni_t *ni, lnet_msg_t *msg)
                         libcfs_id2str(src), index,
                         hdr->msg.put.match_bits,
                         hdr->msg.put.offset, rlength, rc);
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
 
                 return ENOENT;          /* +ve: OK but no match */
         }
@@ -1886,9 +2001,11 @@ lnet_parse_get(lnet_ni_t *ni, lnet_msg_t *msg, int rdma_get)
         lnet_process_id_t  src = {0};
         lnet_handle_wire_t reply_wmd;
         lnet_libmd_t      *md;
+        lnet_counters_t   *counters;
+        int                cpt;
         int                rc;
 
-        src.nid = hdr->src_nid;
+        src.nid = lnet_rail_primary_nid(hdr->src_nid);
         src.pid = hdr->src_pid;
 
         /* Convert get fields to host byte order */
@@ -1897,7 +2014,8 @@ lnet_parse_get(lnet_ni_t *ni, lnet_msg_t *msg, int rdma_get)
         hdr->msg.get.sink_length = le32_to_cpu(hdr->msg.get.sink_length);
         hdr->msg.get.src_offset = le32_to_cpu(hdr->msg.get.src_offset);
 
-        LNET_LOCK();
+        cpt = lnet_ptl_cpt(hdr->msg.get.ptl_index);
+        lnet_res_lock(cpt);
 
         rc = lnet_match_md(hdr->msg.get.ptl_index, LNET_MD_OP_GET, src,
                            hdr->msg.get.sink_length, hdr->msg.get.src_offset,
@@ -1911,16 +2029,23 @@ lnet_parse_get(lnet_ni_t *ni, lnet_msg_t *msg, int rdma_get)
                         hdr->msg.get.match_bits,
                         hdr->msg.get.src_offset,
                         hdr->msg.get.sink_length);
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return ENOENT;                  /* +ve: OK but no match */
         }
 
         LASSERT (rc == LNET_MATCHMD_OK);
 
-        the_lnet.ln_counters.send_count++;
-        the_lnet.ln_counters.send_length += mlength;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = msg->msg_rx_cpt;
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->send_count++;
+        counters->send_length += mlength;
+
+        lnet_net_unlock(cpt);
 
         msg->msg_ev.type = LNET_EVENT_GET;
         msg->msg_ev.target.pid = hdr->dest_pid;
@@ -1962,12 +2087,15 @@ lnet_parse_reply(lnet_ni_t *ni, lnet_msg_t *msg)
         lnet_hdr_t       *hdr = &msg->msg_hdr;
         lnet_process_id_t src = {0};
         lnet_libmd_t     *md;
+        lnet_counters_t  *counters;
         int               rlength;
         int               mlength;
+        int               cpt;
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(hdr->msg.reply.dst_wmd.wh_object_cookie);
+        lnet_res_lock(cpt);
 
-        src.nid = hdr->src_nid;
+        src.nid = lnet_rail_primary_nid(hdr->src_nid);
         src.pid = hdr->src_pid;
 
         /* NB handles only looked up by creator (no flips) */
@@ -1983,7 +2111,7 @@ lnet_parse_reply(lnet_ni_t *ni, lnet_msg_t *msg)
                         CERROR("REPLY MD also attached to portal %d\n",
                                md->md_me->me_portal);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return ENOENT;                  /* +ve: OK but no match */
         }
 
@@ -1999,7 +2127,7 @@ lnet_parse_reply(lnet_ni_t *ni, lnet_msg_t *msg)
                         libcfs_nid2str(ni->ni_nid), libcfs_id2str(src),
                         rlength, hdr->msg.reply.dst_wmd.wh_object_cookie,
                         mlength);
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return ENOENT;          /* +ve: OK but no match */
         }
 
@@ -2007,7 +2135,7 @@ lnet_parse_reply(lnet_ni_t *ni, lnet_msg_t *msg)
                libcfs_nid2str(ni->ni_nid), libcfs_id2str(src), 
                mlength, rlength, hdr->msg.reply.dst_wmd.wh_object_cookie);
 
-        lnet_commit_md(md, msg);
+        lnet_msg_attach_md(msg, md);
 
         if (mlength != 0)
                 lnet_setpayloadbuffer(msg);
@@ -2023,10 +2151,17 @@ lnet_parse_reply(lnet_ni_t *ni, lnet_msg_t *msg)
         lnet_md_deconstruct(md, &msg->msg_ev.md);
         lnet_md2handle(&msg->msg_ev.md_handle, md);
 
-        the_lnet.ln_counters.recv_count++;
-        the_lnet.ln_counters.recv_length += mlength;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = msg->msg_rx_cpt;
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->recv_count++;
+        counters->recv_length += mlength;
+
+        lnet_net_unlock(cpt);
 
         lnet_ni_recv(ni, private, msg, 0, 0, mlength, rlength);
         return 0;
@@ -2038,15 +2173,17 @@ lnet_parse_ack(lnet_ni_t *ni, lnet_msg_t *msg)
         lnet_hdr_t       *hdr = &msg->msg_hdr;
         lnet_process_id_t src = {0};
         lnet_libmd_t     *md;
+        int               cpt;
 
-        src.nid = hdr->src_nid;
+        src.nid = lnet_rail_primary_nid(hdr->src_nid);
         src.pid = hdr->src_pid;
 
         /* Convert ack fields to host byte order */
         hdr->msg.ack.match_bits = le64_to_cpu(hdr->msg.ack.match_bits);
         hdr->msg.ack.mlength = le32_to_cpu(hdr->msg.ack.mlength);
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(hdr->msg.ack.dst_wmd.wh_object_cookie);
+        lnet_res_lock(cpt);
 
         /* NB handles only looked up by creator (no flips) */
         md = lnet_wire_handle2md(&hdr->msg.ack.dst_wmd);
@@ -2062,7 +2199,7 @@ lnet_parse_ack(lnet_ni_t *ni, lnet_msg_t *msg)
                         CERROR("Source MD also attached to portal %d\n",
                                md->md_me->me_portal);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
                 return ENOENT;                  /* +ve! */
         }
 
@@ -2070,7 +2207,7 @@ lnet_parse_ack(lnet_ni_t *ni, lnet_msg_t *msg)
                libcfs_nid2str(ni->ni_nid), libcfs_id2str(src), 
                hdr->msg.ack.dst_wmd.wh_object_cookie);
 
-        lnet_commit_md(md, msg);
+        lnet_msg_attach_md(msg, md);
 
         msg->msg_ev.type = LNET_EVENT_ACK;
         msg->msg_ev.target.pid = hdr->dest_pid;
@@ -2082,9 +2219,15 @@ lnet_parse_ack(lnet_ni_t *ni, lnet_msg_t *msg)
         lnet_md_deconstruct(md, &msg->msg_ev.md);
         lnet_md2handle(&msg->msg_ev.md_handle, md);
 
-        the_lnet.ln_counters.recv_count++;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = msg->msg_rx_cpt;
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        the_lnet.ln_msg_containers[cpt]->msc_counters.recv_count++;
+
+        lnet_net_unlock(cpt);
 
         lnet_ni_recv(ni, msg->msg_private, msg, 0, 0, 0, msg->msg_len);
         return 0;
@@ -2183,6 +2326,7 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
         lnet_nid_t     src_nid;
         __u32          payload_length;
         __u32          type;
+        int            cpt;
 
         LASSERT (!cfs_in_interrupt ());
 
@@ -2193,6 +2337,7 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
         payload_length = le32_to_cpu(hdr->payload_length);
 
         for_me = (ni->ni_nid == dest_nid);
+        cpt = lnet_cpt_of_nid(from_nid);
 
         switch (type) {
         case LNET_MSG_ACK:
@@ -2230,14 +2375,14 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
         if (the_lnet.ln_routing) {
                 cfs_time_t now = cfs_time_current();
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 
                 ni->ni_last_alive = now;
                 if (ni->ni_status != NULL &&
                     ni->ni_status->ns_status == LNET_NI_STATUS_DOWN)
                         ni->ni_status->ns_status = LNET_NI_STATUS_UP;
 
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
         }
 
         /* Regard a bad destination NID as a protocol error.  Senders should
@@ -2313,18 +2458,19 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
         msg->msg_len = msg->msg_wanted = payload_length;
         msg->msg_offset = 0;
         msg->msg_hdr = *hdr;
+        msg->msg_rx_cpt = cpt;
 
-        LNET_LOCK();
-        rc = lnet_nid2peer_locked(&msg->msg_rxpeer, from_nid);
+        lnet_net_lock(cpt);
+        rc = lnet_nid2peer_locked(&msg->msg_rxpeer, from_nid, cpt);
         if (rc != 0) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 CERROR("%s, src %s: Dropping %s "
                        "(error %d looking up sender)\n",
                        libcfs_nid2str(from_nid), libcfs_nid2str(src_nid),
                        lnet_msgtyp2str(type), rc);
                 goto free_drop;
         }
-        LNET_UNLOCK();
+        lnet_net_unlock(cpt);
 
 #ifndef __KERNEL__
         LASSERT (for_me);
@@ -2335,18 +2481,20 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
                 msg->msg_routing = 1;
                 msg->msg_offset = 0;
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
                 if (msg->msg_rxpeer->lp_rtrcredits <= 0 ||
                     lnet_msg2bufpool(msg)->rbp_credits <= 0) {
-                        rc = lnet_eager_recv_locked(msg);
-                        if (rc != 0) {
-                                LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
+
+                        rc = lnet_ni_eager_recv(ni, msg);
+                        if (rc != 0)
                                 goto free_drop;
-                        }
+
+                        lnet_net_lock(cpt);
                 }
                 lnet_commit_routedmsg(msg);
                 rc = lnet_post_routed_recv_locked(msg, 0);
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
 
                 if (rc == 0)
                         lnet_ni_recv(ni, msg->msg_private, msg, 0,
@@ -2389,16 +2537,16 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
 
  free_drop:
         LASSERT (msg->msg_md == NULL);
-        LNET_LOCK();
         if (msg->msg_rxpeer != NULL) {
+                lnet_net_lock(cpt);
                 lnet_peer_decref_locked(msg->msg_rxpeer);
                 msg->msg_rxpeer = NULL;
+                lnet_net_unlock(cpt);
         }
-        lnet_msg_free(msg);                     /* expects LNET_LOCK held */
-        LNET_UNLOCK();
+        lnet_msg_free(msg);
 
  drop:
-        lnet_drop_message(ni, private, payload_length);
+        lnet_drop_message(ni, cpt, private, payload_length);
         return 0;
 }
 
@@ -2454,6 +2602,8 @@ LNetPut(lnet_nid_t self, lnet_handle_md_t mdh, lnet_ack_req_t ack,
 {
         lnet_msg_t       *msg;
         lnet_libmd_t     *md;
+        lnet_counters_t  *counters;
+        int               cpt;
         int               rc;
 
         LASSERT (the_lnet.ln_init);
@@ -2475,12 +2625,11 @@ LNetPut(lnet_nid_t self, lnet_handle_md_t mdh, lnet_ack_req_t ack,
         }
         msg->msg_vmflush = !!cfs_memory_pressure_get();
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(mdh.cookie);
+        lnet_res_lock(cpt);
 
         md = lnet_handle2md(&mdh);
         if (md == NULL || md->md_threshold == 0 || md->md_me != NULL) {
-                lnet_msg_free(msg);
-
                 CERROR("Dropping PUT ("LPU64":%d:%s): MD (%d) invalid\n",
                        match_bits, portal, libcfs_id2str(target),
                        md == NULL ? -1 : md->md_threshold);
@@ -2488,13 +2637,14 @@ LNetPut(lnet_nid_t self, lnet_handle_md_t mdh, lnet_ack_req_t ack,
                         CERROR("Source MD also attached to portal %d\n",
                                md->md_me->me_portal);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
+                lnet_msg_free(msg);
                 return -ENOENT;
         }
 
         CDEBUG(D_NET, "LNetPut -> %s\n", libcfs_id2str(target));
 
-        lnet_commit_md(md, msg);
+        lnet_msg_attach_md(msg, md);
 
         lnet_prep_send(msg, LNET_MSG_PUT, target, 0, md->md_length);
 
@@ -2531,10 +2681,17 @@ LNetPut(lnet_nid_t self, lnet_handle_md_t mdh, lnet_ack_req_t ack,
         lnet_md_deconstruct(md, &msg->msg_ev.md);
         lnet_md2handle(&msg->msg_ev.md_handle, md);
 
-        the_lnet.ln_counters.send_count++;
-        the_lnet.ln_counters.send_length += md->md_length;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = lnet_cpt_of_nid(target.nid);
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->send_count++;
+        counters->send_length += msg->msg_ev.mlength;
+
+        lnet_net_unlock(cpt);
 
         rc = lnet_send(self, msg);
         if (rc != 0) {
@@ -2560,11 +2717,14 @@ lnet_create_reply_msg (lnet_ni_t *ni, lnet_msg_t *getmsg)
         lnet_msg_t        *msg = lnet_msg_alloc();
         lnet_libmd_t      *getmd = getmsg->msg_md;
         lnet_process_id_t  peer_id = getmsg->msg_target;
+        lnet_counters_t   *counters;
+        int                cpt;
 
         LASSERT (!getmsg->msg_target_is_router);
         LASSERT (!getmsg->msg_routing);
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(getmd->md_lh.lh_cookie);
+        lnet_res_lock(cpt);
 
         LASSERT (getmd->md_refcount > 0);
 
@@ -2578,7 +2738,7 @@ lnet_create_reply_msg (lnet_ni_t *ni, lnet_msg_t *getmsg)
                 CERROR ("%s: Dropping REPLY from %s for inactive MD %p\n",
                         libcfs_nid2str(ni->ni_nid), libcfs_id2str(peer_id), 
                         getmd);
-                goto drop_msg;
+                goto drop;
         }
 
         LASSERT (getmd->md_offset == 0);
@@ -2586,7 +2746,7 @@ lnet_create_reply_msg (lnet_ni_t *ni, lnet_msg_t *getmsg)
         CDEBUG(D_NET, "%s: Reply from %s md %p\n", 
                libcfs_nid2str(ni->ni_nid), libcfs_id2str(peer_id), getmd);
 
-        lnet_commit_md (getmd, msg);
+        lnet_msg_attach_md(msg, getmd);
 
         msg->msg_type = LNET_MSG_GET; /* flag this msg as an "optimized" GET */
 
@@ -2599,20 +2759,32 @@ lnet_create_reply_msg (lnet_ni_t *ni, lnet_msg_t *getmsg)
         lnet_md_deconstruct(getmd, &msg->msg_ev.md);
         lnet_md2handle(&msg->msg_ev.md_handle, getmd);
 
-        the_lnet.ln_counters.recv_count++;
-        the_lnet.ln_counters.recv_length += getmd->md_length;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = lnet_cpt_of_nid(peer_id.nid);
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->recv_count++;
+        counters->recv_length += msg->msg_ev.mlength;
+
+        lnet_net_unlock(cpt);
 
         return msg;
 
- drop_msg:
-        lnet_msg_free(msg);
  drop:
-        the_lnet.ln_counters.drop_count++;
-        the_lnet.ln_counters.drop_length += getmd->md_length;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK ();
+        if (msg != NULL)
+                lnet_msg_free(msg);
+
+        cpt = lnet_cpt_of_nid(peer_id.nid);
+        lnet_net_lock(cpt);
+        counters = &the_lnet.ln_msg_containers[cpt]->msc_counters;
+        counters->drop_count++;
+        counters->drop_length += getmd->md_length;
+        lnet_net_unlock(cpt);
 
         return NULL;
 }
@@ -2660,6 +2832,7 @@ LNetGet(lnet_nid_t self, lnet_handle_md_t mdh,
 {
         lnet_msg_t       *msg;
         lnet_libmd_t     *md;
+        int               cpt;
         int               rc;
 
         LASSERT (the_lnet.ln_init);
@@ -2680,12 +2853,11 @@ LNetGet(lnet_nid_t self, lnet_handle_md_t mdh,
                 return -ENOMEM;
         }
 
-        LNET_LOCK();
+        cpt = lnet_cpt_of_cookie(mdh.cookie);
+        lnet_res_lock(cpt);
 
         md = lnet_handle2md(&mdh);
         if (md == NULL || md->md_threshold == 0 || md->md_me != NULL) {
-                lnet_msg_free(msg);
-
                 CERROR("Dropping GET ("LPU64":%d:%s): MD (%d) invalid\n",
                        match_bits, portal, libcfs_id2str(target),
                        md == NULL ? -1 : md->md_threshold);
@@ -2693,13 +2865,14 @@ LNetGet(lnet_nid_t self, lnet_handle_md_t mdh,
                         CERROR("REPLY MD also attached to portal %d\n",
                                md->md_me->me_portal);
 
-                LNET_UNLOCK();
+                lnet_res_unlock(cpt);
+                lnet_msg_free(msg);
                 return -ENOENT;
         }
 
         CDEBUG(D_NET, "LNetGet -> %s\n", libcfs_id2str(target));
 
-        lnet_commit_md(md, msg);
+        lnet_msg_attach_md(msg, md);
 
         lnet_prep_send(msg, LNET_MSG_GET, target, 0, 0);
 
@@ -2729,9 +2902,15 @@ LNetGet(lnet_nid_t self, lnet_handle_md_t mdh,
         lnet_md_deconstruct(md, &msg->msg_ev.md);
         lnet_md2handle(&msg->msg_ev.md_handle, md);
 
-        the_lnet.ln_counters.send_count++;
+        lnet_res_unlock(cpt);
 
-        LNET_UNLOCK();
+        cpt = lnet_cpt_of_nid(target.nid);
+        lnet_net_lock(cpt);
+
+        lnet_msg_commit(msg, cpt);
+        the_lnet.ln_msg_containers[cpt]->msc_counters.send_count++;
+
+        lnet_net_unlock(cpt);
 
         rc = lnet_send(self, msg);
         if (rc < 0) {
@@ -2767,6 +2946,7 @@ LNetDist (lnet_nid_t dstnid, lnet_nid_t *srcnidp, __u32 *orderp)
         __u32             dstnet = LNET_NIDNET(dstnid);
         int               hops;
         __u32             order = 2;
+        int               cpt;
 
         /* if !local_nid_dist_zero, I don't return a distance of 0 ever
          * (when lustre sees a distance of 0, it substitutes 0@lo), so I
@@ -2776,7 +2956,9 @@ LNetDist (lnet_nid_t dstnid, lnet_nid_t *srcnidp, __u32 *orderp)
         LASSERT (the_lnet.ln_init);
         LASSERT (the_lnet.ln_refcount > 0);
 
-        LNET_LOCK();
+        /* NIs and routes only change under LNET_LOCK_EX, so any one
+         * partition's lock will do to read them */
+        cpt = lnet_net_lock_current();
 
         cfs_list_for_each (e, &the_lnet.ln_nis) {
                 ni = cfs_list_entry(e, lnet_ni_t, ni_list);
@@ -2790,7 +2972,7 @@ LNetDist (lnet_nid_t dstnid, lnet_nid_t *srcnidp, __u32 *orderp)
                                 else
                                         *orderp = 1;
                         }
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
 
                         return local_nid_dist_zero ? 0 : 1;
                 }
@@ -2800,7 +2982,7 @@ LNetDist (lnet_nid_t dstnid, lnet_nid_t *srcnidp, __u32 *orderp)
                                 *srcnidp = ni->ni_nid;
                         if (orderp != NULL)
                                 *orderp = order;
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
                         return 1;
                 }
 
@@ -2829,13 +3011,13 @@ LNetDist (lnet_nid_t dstnid, lnet_nid_t *srcnidp, __u32 *orderp)
                                 *srcnidp = shortest->lr_gateway->lp_ni->ni_nid;
                         if (orderp != NULL)
                                 *orderp = order;
-                        LNET_UNLOCK();
+                        lnet_net_unlock(cpt);
                         return hops + 1;
                 }
                 order++;
         }
 
-        LNET_UNLOCK();
+        lnet_net_unlock(cpt);
         return -EHOSTUNREACH;
 }
 
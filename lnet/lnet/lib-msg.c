@@ -60,8 +60,11 @@ lnet_build_unlink_event (lnet_libmd_t *md, lnet_event_t *ev)
 void
 lnet_enq_event_locked (lnet_eq_t *eq, lnet_event_t *ev)
 {
+        /* called with the res lock of the MD held */
         lnet_event_t  *eq_slot;
 
+        lnet_eq_wait_lock();
+
         /* Allocate the next queue slot */
         ev->sequence = eq->eq_enq_seq++;
 
@@ -71,7 +74,7 @@ lnet_enq_event_locked (lnet_eq_t *eq, lnet_event_t *ev)
         eq_slot = eq->eq_events + (ev->sequence & (eq->eq_size - 1));
 
         /* There is no race since both event consumers and event producers
-         * take the LNET_LOCK, so we don't screw around with memory
+         * take the eq wait lock, so we don't screw around with memory
          * barriers, setting the sequence number last or weird structure
          * layout assertions. */
         *eq_slot = *ev;
@@ -82,20 +85,115 @@ lnet_enq_event_locked (lnet_eq_t *eq, lnet_event_t *ev)
 
 #ifdef __KERNEL__
         /* Wake anyone waiting in LNetEQPoll() */
-        if (cfs_waitq_active(&the_lnet.ln_waitq))
-                cfs_waitq_broadcast(&the_lnet.ln_waitq);
+        if (cfs_waitq_active(&the_lnet.ln_eq_waitq))
+                cfs_waitq_broadcast(&the_lnet.ln_eq_waitq);
 #else
 # ifndef HAVE_LIBPTHREAD
         /* LNetEQPoll() calls into _the_ LND to wait for action */
 # else
         /* Wake anyone waiting in LNetEQPoll() */
-        pthread_cond_broadcast(&the_lnet.ln_cond);
+        pthread_cond_broadcast(&the_lnet.ln_eq_cond);
 # endif
 #endif
+        lnet_eq_wait_unlock();
 }
 
 void
-lnet_complete_msg_locked(lnet_msg_t *msg)
+lnet_msg_commit(lnet_msg_t *msg, int cpt)
+{
+        /* ALWAYS called holding the net lock of \a cpt */
+        lnet_msg_container_t *container = the_lnet.ln_msg_containers[cpt];
+        lnet_counters_t      *counters  = &container->msc_counters;
+
+        LASSERT (!msg->msg_onactivelist);
+        msg->msg_onactivelist = 1;
+        msg->msg_cpt = cpt;
+        cfs_list_add(&msg->msg_activelist, &container->msc_active);
+
+        counters->msgs_alloc++;
+        if (counters->msgs_alloc > counters->msgs_max)
+                counters->msgs_max = counters->msgs_alloc;
+}
+
+static void
+lnet_msg_decommit(lnet_msg_t *msg, int cpt)
+{
+        /* ALWAYS called holding the net lock of \a cpt */
+        lnet_msg_container_t *container = the_lnet.ln_msg_containers[cpt];
+
+        LASSERT (msg->msg_onactivelist);
+        LASSERT (msg->msg_cpt == cpt);
+
+        msg->msg_onactivelist = 0;
+        cfs_list_del(&msg->msg_activelist);
+        container->msc_counters.msgs_alloc--;
+}
+
+void
+lnet_msg_attach_md(lnet_msg_t *msg, lnet_libmd_t *md)
+{
+        /* ALWAYS called holding the res lock of \a md */
+        /* Here, we attach the MD to a network OP by marking it busy and
+         * decrementing its threshold.  Come what may, the network "owns"
+         * the MD until a call to lnet_finalize() signals completion. */
+        LASSERT (!msg->msg_routing);
+
+        msg->msg_md = md;
+
+        md->md_refcount++;
+        if (md->md_threshold != LNET_MD_THRESH_INF) {
+                LASSERT (md->md_threshold > 0);
+                md->md_threshold--;
+        }
+}
+
+static void
+lnet_msg_detach_md(lnet_msg_t *msg)
+{
+        /* ALWAYS called holding the res lock of msg->msg_md */
+        lnet_libmd_t *md = msg->msg_md;
+        int           unlink;
+
+        /* Now it's safe to drop my caller's ref */
+        md->md_refcount--;
+        LASSERT (md->md_refcount >= 0);
+
+        unlink = lnet_md_unlinkable(md);
+
+        msg->msg_ev.unlinked = unlink;
+
+        if (md->md_eq != NULL)
+                lnet_enq_event_locked(md->md_eq, &msg->msg_ev);
+
+        if (unlink)
+                lnet_md_unlink(md);
+
+        msg->msg_md = NULL;
+}
+
+/* Give back the credits \a msg holds; called holding the net lock of
+ * \a cpt, which is dropped to take the locks the credits belong to and
+ * retaken before returning. */
+static void
+lnet_msg_return_credits(lnet_msg_t *msg, int cpt)
+{
+        int mycpt = cpt;
+
+        if (msg->msg_txpeer != NULL) {
+                mycpt = lnet_net_relock(mycpt, msg->msg_tx_cpt);
+                lnet_return_tx_credits_locked(msg);
+        }
+
+        if (msg->msg_rxpeer != NULL) {
+                mycpt = lnet_net_relock(mycpt, msg->msg_rx_cpt);
+                lnet_return_rx_credits_locked(msg);
+        }
+
+        lnet_net_relock(mycpt, cpt);
+}
+
+static void
+lnet_complete_msg_locked(lnet_msg_t *msg, int cpt)
 {
         lnet_handle_wire_t ack_wmd;
         int                rc;
@@ -106,10 +204,10 @@ lnet_complete_msg_locked(lnet_msg_t *msg)
         if (status == 0 && msg->msg_ack) {
                 /* Only send an ACK if the PUT completed successfully */
 
-                lnet_return_credits_locked(msg);
+                lnet_msg_return_credits(msg, cpt);
 
                 msg->msg_ack = 0;
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
 
                 LASSERT(msg->msg_ev.type == LNET_EVENT_PUT);
                 LASSERT(!msg->msg_routing);
@@ -124,7 +222,7 @@ lnet_complete_msg_locked(lnet_msg_t *msg)
 
                 rc = lnet_send(msg->msg_ev.target.nid, msg);
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 
                 if (rc == 0)
                         return;
@@ -133,34 +231,31 @@ lnet_complete_msg_locked(lnet_msg_t *msg)
                 
                 LASSERT (!msg->msg_receiving);  /* called back recv already */
         
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 
                 rc = lnet_send(LNET_NID_ANY, msg);
 
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 
                 if (rc == 0)
                         return;
         }
 
-        lnet_return_credits_locked(msg);
-
-        LASSERT (msg->msg_onactivelist);
-        msg->msg_onactivelist = 0;
-        cfs_list_del (&msg->msg_activelist);
-        the_lnet.ln_counters.msgs_alloc--;
-        lnet_msg_free(msg);
+        lnet_msg_return_credits(msg, cpt);
+        lnet_msg_decommit(msg, cpt);
+        lnet_msg_free_locked(msg);
 }
 
 
 void
 lnet_finalize (lnet_ni_t *ni, lnet_msg_t *msg, int status)
 {
+        lnet_msg_container_t *container;
 #ifdef __KERNEL__
-        int                i;
-        int                my_slot;
+        int                   i;
+        int                   my_slot;
 #endif
-        lnet_libmd_t      *md;
+        int                   cpt;
 
         LASSERT (!cfs_in_interrupt ());
 
@@ -183,74 +278,224 @@ lnet_finalize (lnet_ni_t *ni, lnet_msg_t *msg, int status)
                msg->msg_txpeer == NULL ? "<none>" : libcfs_nid2str(msg->msg_txpeer->lp_nid),
                msg->msg_rxpeer == NULL ? "<none>" : libcfs_nid2str(msg->msg_rxpeer->lp_nid));
 #endif
-        LNET_LOCK();
-
         LASSERT (msg->msg_onactivelist);
 
         msg->msg_ev.status = status;
 
-        md = msg->msg_md;
-        if (md != NULL) {
-                int      unlink;
-
-                /* Now it's safe to drop my caller's ref */
-                md->md_refcount--;
-                LASSERT (md->md_refcount >= 0);
-
-                unlink = lnet_md_unlinkable(md);
+        if (msg->msg_md != NULL) {
+                cpt = lnet_cpt_of_cookie(msg->msg_md->md_lh.lh_cookie);
 
-                msg->msg_ev.unlinked = unlink;
-
-                if (md->md_eq != NULL)
-                        lnet_enq_event_locked(md->md_eq, &msg->msg_ev);
+                lnet_res_lock(cpt);
+                lnet_msg_detach_md(msg);
+                lnet_res_unlock(cpt);
+        }
 
-                if (unlink)
-                        lnet_md_unlink(md);
+        cpt = msg->msg_cpt;
+        container = the_lnet.ln_msg_containers[cpt];
 
-                msg->msg_md = NULL;
-        }
+        lnet_net_lock(cpt);
 
-        cfs_list_add_tail (&msg->msg_list, &the_lnet.ln_finalizeq);
+        cfs_list_add_tail (&msg->msg_list, &container->msc_finalizing);
 
         /* Recursion breaker.  Don't complete the message here if I am (or
          * enough other threads are) already completing messages */
 
 #ifdef __KERNEL__
         my_slot = -1;
-        for (i = 0; i < the_lnet.ln_nfinalizers; i++) {
-                if (the_lnet.ln_finalizers[i] == cfs_current())
+        for (i = 0; i < container->msc_nfinalizers; i++) {
+                if (container->msc_finalizers[i] == cfs_current())
                         goto out;
-                if (my_slot < 0 && the_lnet.ln_finalizers[i] == NULL)
+                if (my_slot < 0 && container->msc_finalizers[i] == NULL)
                         my_slot = i;
         }
         if (my_slot < 0)
                 goto out;
 
-        the_lnet.ln_finalizers[my_slot] = cfs_current();
+        container->msc_finalizers[my_slot] = cfs_current();
 #else
-        if (the_lnet.ln_finalizing)
+        if (container->msc_finalizing_now)
                 goto out;
 
-        the_lnet.ln_finalizing = 1;
+        container->msc_finalizing_now = 1;
 #endif
 
-        while (!cfs_list_empty(&the_lnet.ln_finalizeq)) {
-                msg = cfs_list_entry(the_lnet.ln_finalizeq.next,
+        while (!cfs_list_empty(&container->msc_finalizing)) {
+                msg = cfs_list_entry(container->msc_finalizing.next,
                                      lnet_msg_t, msg_list);
 
                 cfs_list_del(&msg->msg_list);
 
                 /* NB drops and regains the lnet lock if it actually does
                  * anything, so my finalizing friends can chomp along too */
-                lnet_complete_msg_locked(msg);
+                lnet_complete_msg_locked(msg, cpt);
         }
 
 #ifdef __KERNEL__
-        the_lnet.ln_finalizers[my_slot] = NULL;
+        container->msc_finalizers[my_slot] = NULL;
 #else
-        the_lnet.ln_finalizing = 0;
+        container->msc_finalizing_now = 0;
 #endif
 
  out:
+        lnet_net_unlock(cpt);
+}
+
+static void
+lnet_msg_container_cleanup(lnet_msg_container_t *container)
+{
+        int count = 0;
+
+        /* NB no lock needed, this is the last reference */
+        while (!cfs_list_empty(&container->msc_active)) {
+                lnet_msg_t *msg = cfs_list_entry(container->msc_active.next,
+                                                 lnet_msg_t, msg_activelist);
+
+                LASSERT (msg->msg_onactivelist);
+                msg->msg_onactivelist = 0;
+                cfs_list_del(&msg->msg_activelist);
+                lnet_msg_free_locked(msg);
+                count++;
+        }
+
+        if (count > 0)
+                CERROR("%d active msg on exit\n", count);
+
+        LASSERT (cfs_list_empty(&container->msc_finalizing));
+#ifdef __KERNEL__
+        if (container->msc_finalizers != NULL) {
+                int i;
+
+                for (i = 0; i < container->msc_nfinalizers; i++)
+                        LASSERT (container->msc_finalizers[i] == NULL);
+
+                LIBCFS_FREE(container->msc_finalizers,
+                            container->msc_nfinalizers *
+                            sizeof(*container->msc_finalizers));
+                container->msc_finalizers = NULL;
+        }
+#else
+        LASSERT (!container->msc_finalizing_now);
+#endif
+}
+
+static int
+lnet_msg_container_setup(lnet_msg_container_t *container, int cpt)
+{
+        CFS_INIT_LIST_HEAD(&container->msc_active);
+        CFS_INIT_LIST_HEAD(&container->msc_finalizing);
+        memset(&container->msc_counters, 0, sizeof(container->msc_counters));
+
+#ifdef __KERNEL__
+        /* one finalizer per CPU of the partition at most */
+        container->msc_nfinalizers = max(cfs_cpt_weight(cpt), 1);
+
+        LIBCFS_ALLOC(container->msc_finalizers,
+                     container->msc_nfinalizers *
+                     sizeof(*container->msc_finalizers));
+        if (container->msc_finalizers == NULL) {
+                CERROR("Can't allocate finalizers for partition %d\n", cpt);
+                return -ENOMEM;
+        }
+#else
+        container->msc_finalizing_now = 0;
+#endif
+        return 0;
+}
+
+void
+lnet_msg_containers_destroy(void)
+{
+        int i;
+
+        if (the_lnet.ln_msg_containers == NULL)
+                return;
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                lnet_msg_container_t *container = the_lnet.ln_msg_containers[i];
+
+                if (container == NULL)
+                        continue;
+
+                lnet_msg_container_cleanup(container);
+                LIBCFS_FREE(container, sizeof(*container));
+        }
+
+        LIBCFS_FREE(the_lnet.ln_msg_containers,
+                    the_lnet.ln_cpt_number *
+                    sizeof(the_lnet.ln_msg_containers[0]));
+        the_lnet.ln_msg_containers = NULL;
+}
+
+int
+lnet_msg_containers_create(void)
+{
+        int rc;
+        int i;
+
+        LIBCFS_ALLOC(the_lnet.ln_msg_containers,
+                     the_lnet.ln_cpt_number *
+                     sizeof(the_lnet.ln_msg_containers[0]));
+        if (the_lnet.ln_msg_containers == NULL) {
+                CERROR("Can't allocate message containers\n");
+                return -ENOMEM;
+        }
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                LIBCFS_ALLOC(the_lnet.ln_msg_containers[i],
+                             sizeof(lnet_msg_container_t));
+                if (the_lnet.ln_msg_containers[i] == NULL) {
+                        lnet_msg_containers_destroy();
+                        return -ENOMEM;
+                }
+
+                rc = lnet_msg_container_setup(the_lnet.ln_msg_containers[i], i);
+                if (rc != 0) {
+                        lnet_msg_containers_destroy();
+                        return rc;
+                }
+        }
+
+        return 0;
+}
+
+/* sum the counters of all partitions into \a counters */
+void
+lnet_counters_get(lnet_counters_t *counters)
+{
+        lnet_counters_t *ctr;
+        int              i;
+
+        memset(counters, 0, sizeof(*counters));
+
+        LNET_LOCK();
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                ctr = &the_lnet.ln_msg_containers[i]->msc_counters;
+
+                counters->msgs_max     += ctr->msgs_max;
+                counters->msgs_alloc   += ctr->msgs_alloc;
+                counters->errors       += ctr->errors;
+                counters->send_count   += ctr->send_count;
+                counters->recv_count   += ctr->recv_count;
+                counters->route_count  += ctr->route_count;
+                counters->drop_count   += ctr->drop_count;
+                counters->send_length  += ctr->send_length;
+                counters->recv_length  += ctr->recv_length;
+                counters->route_length += ctr->route_length;
+                counters->drop_length  += ctr->drop_length;
+        }
+        LNET_UNLOCK();
+}
+
+void
+lnet_counters_reset(void)
+{
+        lnet_counters_t *counters;
+        int              i;
+
+        LNET_LOCK();
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                counters = &the_lnet.ln_msg_containers[i]->msc_counters;
+                memset(counters, 0, sizeof(*counters));
+        }
         LNET_UNLOCK();
 }
@@ -43,69 +43,120 @@
 int
 lnet_create_peer_table(void)
 {
-	cfs_list_t  *hash;
-	int          i;
+        lnet_peer_table_t *ptable;
+        int                ncpt = the_lnet.ln_cpt_number;
+        int                i;
+        int                j;
+
+        LASSERT (the_lnet.ln_peer_tables == NULL);
+        LIBCFS_ALLOC(the_lnet.ln_peer_tables,
+                     ncpt * sizeof(the_lnet.ln_peer_tables[0]));
+        if (the_lnet.ln_peer_tables == NULL) {
+                CERROR("Can't allocate peer tables\n");
+                return -ENOMEM;
+        }
 
-	LASSERT (the_lnet.ln_peer_hash == NULL);
-	LIBCFS_ALLOC(hash, LNET_PEER_HASHSIZE * sizeof(cfs_list_t));
-	
-	if (hash == NULL) {
-		CERROR("Can't allocate peer hash table\n");
-		return -ENOMEM;
-	}
+        for (i = 0; i < ncpt; i++) {
+                LIBCFS_ALLOC(ptable, sizeof(*ptable));
+                if (ptable == NULL)
+                        goto failed;
+                the_lnet.ln_peer_tables[i] = ptable;
 
-	for (i = 0; i < LNET_PEER_HASHSIZE; i++)
-		CFS_INIT_LIST_HEAD(&hash[i]);
+                LIBCFS_ALLOC(ptable->pt_hash,
+                             LNET_PEER_HASHSIZE * sizeof(cfs_list_t));
+                if (ptable->pt_hash == NULL)
+                        goto failed;
+
+                for (j = 0; j < LNET_PEER_HASHSIZE; j++)
+                        CFS_INIT_LIST_HEAD(&ptable->pt_hash[j]);
+        }
+        return 0;
 
-	the_lnet.ln_peer_hash = hash;
-	return 0;
+ failed:
+        CERROR("Can't allocate peer hash table\n");
+        lnet_destroy_peer_table();
+        return -ENOMEM;
 }
 
 void
 lnet_destroy_peer_table(void)
 {
-	int         i;
+        lnet_peer_table_t *ptable;
+        int                ncpt = the_lnet.ln_cpt_number;
+        int                i;
+        int                j;
 
-        if (the_lnet.ln_peer_hash == NULL)
+        if (the_lnet.ln_peer_tables == NULL)
                 return;
 
-	for (i = 0; i < LNET_PEER_HASHSIZE; i++)
-		LASSERT (cfs_list_empty(&the_lnet.ln_peer_hash[i]));
+        for (i = 0; i < ncpt; i++) {
+                ptable = the_lnet.ln_peer_tables[i];
+                if (ptable == NULL)
+                        continue;
+
+                if (ptable->pt_hash != NULL) {
+                        for (j = 0; j < LNET_PEER_HASHSIZE; j++)
+                                LASSERT (cfs_list_empty(&ptable->pt_hash[j]));
+
+                        LIBCFS_FREE(ptable->pt_hash,
+                                    LNET_PEER_HASHSIZE * sizeof(cfs_list_t));
+                }
+                LIBCFS_FREE(ptable, sizeof(*ptable));
+        }
+
+        LIBCFS_FREE(the_lnet.ln_peer_tables,
+                    ncpt * sizeof(the_lnet.ln_peer_tables[0]));
+        the_lnet.ln_peer_tables = NULL;
+}
+
+static int
+lnet_peer_count_locked(void)
+{
+        int count = 0;
+        int i;
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                count += the_lnet.ln_peer_tables[i]->pt_number;
 
-	LIBCFS_FREE(the_lnet.ln_peer_hash,
-		    LNET_PEER_HASHSIZE * sizeof (cfs_list_t));
-        the_lnet.ln_peer_hash = NULL;
+        return count;
 }
 
 void
 lnet_clear_peer_table(void)
 {
-	int         i;
+        lnet_peer_table_t *ptable;
+        int                npeers;
+        int                i;
+        int                j;
 
         LASSERT (the_lnet.ln_shutdown);         /* i.e. no new peers */
 
-	for (i = 0; i < LNET_PEER_HASHSIZE; i++) {
-		cfs_list_t *peers = &the_lnet.ln_peer_hash[i];
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                ptable = the_lnet.ln_peer_tables[i];
 
-		LNET_LOCK();
-		while (!cfs_list_empty(peers)) {
-			lnet_peer_t *lp = cfs_list_entry(peers->next,
-                                                         lnet_peer_t,
-                                                         lp_hashlist);
+                lnet_net_lock(i);
+                for (j = 0; j < LNET_PEER_HASHSIZE; j++) {
+                        cfs_list_t *peers = &ptable->pt_hash[j];
 
-			cfs_list_del(&lp->lp_hashlist);
-                        lnet_peer_decref_locked(lp);   /* lose hash table's ref */
-		}
-		LNET_UNLOCK();
-	}
+                        while (!cfs_list_empty(peers)) {
+                                lnet_peer_t *lp = cfs_list_entry(peers->next,
+                                                                 lnet_peer_t,
+                                                                 lp_hashlist);
+
+                                cfs_list_del(&lp->lp_hashlist);
+                                /* lose hash table's ref */
+                                lnet_peer_decref_locked(lp);
+                        }
+                }
+                lnet_net_unlock(i);
+        }
 
         LNET_LOCK();
-        for (i = 3; the_lnet.ln_npeers != 0;i++) {
+        for (i = 3; (npeers = lnet_peer_count_locked()) != 0; i++) {
                 LNET_UNLOCK();
 
                 if ((i & (i-1)) == 0)
-                        CDEBUG(D_WARNING,"Waiting for %d peers\n", 
-                               the_lnet.ln_npeers);
+                        CDEBUG(D_WARNING,"Waiting for %d peers\n", npeers);
                 cfs_pause(cfs_time_seconds(1));
 
                 LNET_LOCK();
@@ -114,30 +165,29 @@ lnet_clear_peer_table(void)
 }
 
 void
-lnet_destroy_peer_locked (lnet_peer_t *lp) 
+lnet_destroy_peer_locked (lnet_peer_t *lp)
 {
-        lnet_ni_decref_locked(lp->lp_ni);
-        LNET_UNLOCK();
+        lnet_peer_table_t *ptable = the_lnet.ln_peer_tables[lp->lp_cpt];
 
         LASSERT (lp->lp_refcount == 0);
         LASSERT (lp->lp_rtr_refcount == 0);
-	LASSERT (cfs_list_empty(&lp->lp_txq));
+        LASSERT (cfs_list_empty(&lp->lp_txq));
         LASSERT (lp->lp_txqnob == 0);
         LASSERT (lp->lp_rcd == NULL);
 
-	LIBCFS_FREE(lp, sizeof(*lp));
+        lnet_ni_decref_locked(lp->lp_ni, lp->lp_cpt);
 
-        LNET_LOCK();
+        LASSERT (ptable->pt_number > 0);
+        ptable->pt_number--;
 
-        LASSERT(the_lnet.ln_npeers > 0);
-        the_lnet.ln_npeers--;
+        LIBCFS_FREE(lp, sizeof(*lp));
 }
 
 lnet_peer_t *
 lnet_find_peer_locked (lnet_nid_t nid)
 {
-	unsigned int      idx = LNET_NIDADDR(nid) % LNET_PEER_HASHSIZE;
-	cfs_list_t       *peers = &the_lnet.ln_peer_hash[idx];
+        /* called holding the net lock of lnet_cpt_of_nid(nid) */
+	cfs_list_t       *peers = lnet_nid2peerhash(nid);
 	cfs_list_t       *tmp;
         lnet_peer_t      *lp;
 
@@ -157,23 +207,26 @@ lnet_find_peer_locked (lnet_nid_t nid)
 }
 
 int
-lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid)
+lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 {
-	lnet_peer_t    *lp;
-	lnet_peer_t    *lp2;
+        /* \a cpt is the net lock I'm holding: lnet_cpt_of_nid(nid) or
+         * LNET_LOCK_EX */
+        lnet_peer_table_t *ptable;
+	lnet_peer_t       *lp;
+	lnet_peer_t       *lp2;
 
         lp = lnet_find_peer_locked(nid);
         if (lp != NULL) {
                 *lpp = lp;
                 return 0;
         }
-        
-        LNET_UNLOCK();
-	
+
+        lnet_net_unlock(cpt);
+
 	LIBCFS_ALLOC(lp, sizeof(*lp));
 	if (lp == NULL) {
                 *lpp = NULL;
-                LNET_LOCK();
+                lnet_net_lock(cpt);
                 return -ENOMEM;
         }
 
@@ -194,14 +247,15 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid)
         lp->lp_nid = nid;
         lp->lp_refcount = 2;                    /* 1 for caller; 1 for hash */
         lp->lp_rtr_refcount = 0;
+        lp->lp_cpt = lnet_cpt_of_nid(nid);
 
-        LNET_LOCK();
+        lnet_net_lock(cpt);
 
         lp2 = lnet_find_peer_locked(nid);
         if (lp2 != NULL) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 LIBCFS_FREE(lp, sizeof(*lp));
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 
                 if (the_lnet.ln_shutdown) {
                         lnet_peer_decref_locked(lp2);
@@ -213,11 +267,11 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid)
                 return 0;
         }
                 
-        lp->lp_ni = lnet_net2ni_locked(LNET_NIDNET(nid));
+        lp->lp_ni = lnet_net2ni_locked(LNET_NIDNET(nid), lp->lp_cpt);
         if (lp->lp_ni == NULL) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 LIBCFS_FREE(lp, sizeof(*lp));
-                LNET_LOCK();
+                lnet_net_lock(cpt);
 
                 *lpp = NULL;
                 return the_lnet.ln_shutdown ? -ESHUTDOWN : -EHOSTUNREACH;
@@ -231,9 +285,10 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid)
         /* can't add peers after shutdown starts */
         LASSERT (!the_lnet.ln_shutdown);
 
+        ptable = the_lnet.ln_peer_tables[lp->lp_cpt];
         cfs_list_add_tail(&lp->lp_hashlist, lnet_nid2peerhash(nid));
-        the_lnet.ln_npeers++;
-        the_lnet.ln_peertable_version++;
+        ptable->pt_number++;
+        ptable->pt_version++;
         *lpp = lp;
         return 0;
 }
@@ -244,12 +299,13 @@ lnet_debug_peer(lnet_nid_t nid)
         char        *aliveness = "NA";
         int          rc;
         lnet_peer_t *lp;
+        int          cpt = lnet_cpt_of_nid(nid);
 
-        LNET_LOCK();
+        lnet_net_lock(cpt);
 
-        rc = lnet_nid2peer_locked(&lp, nid);
+        rc = lnet_nid2peer_locked(&lp, nid, cpt);
         if (rc != 0) {
-                LNET_UNLOCK();
+                lnet_net_unlock(cpt);
                 CDEBUG(D_WARNING, "No peer %s\n", libcfs_nid2str(nid));
                 return;
         }
@@ -265,5 +321,257 @@ lnet_debug_peer(lnet_nid_t nid)
 
         lnet_peer_decref_locked(lp);
 
-        LNET_UNLOCK();
+        lnet_net_unlock(cpt);
+}
+
+static unsigned int
+lnet_rail_hash_idx(lnet_nid_t nid)
+{
+        return (LNET_NIDADDR(nid) + LNET_NIDNET(nid)) % LNET_PEER_HASHSIZE;
+}
+
+static lnet_rail_t *
+lnet_find_rail(lnet_nid_t nid)
+{
+        cfs_list_t  *hash = the_lnet.ln_rail_hash;
+        cfs_list_t  *tmp;
+        lnet_rail_t *rl;
+
+        /* no lock: the rails don't change while LNet is up */
+        if (hash == NULL)
+                return NULL;
+
+        cfs_list_for_each (tmp, &hash[lnet_rail_hash_idx(nid)]) {
+                rl = cfs_list_entry(tmp, lnet_rail_t, rl_hashlist);
+
+                if (rl->rl_nid == nid)
+                        return rl;
+        }
+
+        return NULL;
+}
+
+/* the NID of a multi-rail peer its messages are matched with, whichever of
+ * its rails they arrived on */
+lnet_nid_t
+lnet_rail_primary_nid(lnet_nid_t nid)
+{
+        lnet_rail_t *rl = lnet_find_rail(nid);
+
+        return (rl == NULL) ? nid : rl->rl_peer->pr_rails[0].rl_nid;
+}
+
+/* If \a *nidp is a rail of a multi-rail peer, change it to the rail to
+ * send on now and return 1: the one with the most peer then NI credits and
+ * the shortest queue out of those which have a local NI and look alive.
+ * Rails doing equally well are used in turn. */
+int
+lnet_select_rail(lnet_nid_t *nidp)
+{
+        lnet_rail_t       *rl = lnet_find_rail(*nidp);
+        lnet_peer_rails_t *pr;
+        lnet_peer_t       *lp;
+        lnet_ni_t         *ni;
+        lnet_nid_t         nid;
+        int                best = -1;
+        int                best_credits = 0;
+        int                best_nicredits = 0;
+        long               best_qnob = 0;
+        int                credits;
+        int                nicredits;
+        long               qnob;
+        int                alive;
+        int                cpt;
+        int                rc;
+        int                i;
+        int                j;
+
+        if (rl == NULL)
+                return 0;
+
+        pr = rl->rl_peer;
+        for (i = 0; i < pr->pr_nrails; i++) {
+                j = (pr->pr_rotor + i) % pr->pr_nrails;
+                nid = pr->pr_rails[j].rl_nid;
+                cpt = lnet_cpt_of_nid(nid);
+
+                lnet_net_lock(cpt);
+
+                ni = lnet_net2ni_locked(LNET_NIDNET(nid), cpt);
+                if (ni == NULL) {
+                        lnet_net_unlock(cpt);
+                        continue;
+                }
+
+                lp = lnet_find_peer_locked(nid);
+                if (lp == NULL) {
+                        /* never sent anything on this rail yet */
+                        alive = 1;
+                        credits = ni->ni_peertxcredits;
+                        qnob = 0;
+                } else {
+                        rc = lnet_peer_alive_locked(lp);
+                        alive = (rc < 0) ? lp->lp_alive : rc;
+                        credits = lp->lp_txcredits;
+                        qnob = lp->lp_txqnob;
+                        lnet_peer_decref_locked(lp);
+                }
+                nicredits = ni->ni_tx_queues[cpt].tq_credits;
+
+                lnet_ni_decref_locked(ni, cpt);
+                lnet_net_unlock(cpt);
+
+                if (!alive)
+                        continue;
+
+                if (best >= 0) {
+                        if (credits < best_credits)
+                                continue;
+                        if (credits == best_credits) {
+                                if (nicredits < best_nicredits)
+                                        continue;
+                                if (nicredits == best_nicredits &&
+                                    qnob >= best_qnob)
+                                        continue;
+                        }
+                }
+
+                best = j;
+                best_credits = credits;
+                best_nicredits = nicredits;
+                best_qnob = qnob;
+        }
+
+        if (best < 0) {
+                /* all rails down: leave it to lnet_send() to fail it */
+                CDEBUG(D_NET, "No rail to %s is up\n",
+                       libcfs_nid2str(*nidp));
+                return 1;
+        }
+
+        /* racy, but only spreads the load less evenly */
+        pr->pr_rotor = best + 1;
+        cfs_atomic_inc(&pr->pr_rails[best].rl_nsent);
+        *nidp = pr->pr_rails[best].rl_nid;
+        return 1;
+}
+
+int
+lnet_add_peer_rails(lnet_nid_t *nids, int nnids)
+{
+        lnet_peer_rails_t *pr;
+        cfs_list_t        *tmp;
+        int                i;
+        int                j;
+
+        LASSERT (nnids > 0 && nnids <= LNET_MAX_RAILS);
+        LASSERT (the_lnet.ln_rail_hash == NULL);
+
+        for (i = 0; i < nnids; i++) {
+                if (lnet_islocalnid(nids[i]))   /* my own rails */
+                        return 0;
+
+                for (j = 0; j < i; j++) {
+                        if (LNET_NIDNET(nids[j]) == LNET_NIDNET(nids[i])) {
+                                CERROR("Rails %s and %s are on the same "
+                                       "network\n", libcfs_nid2str(nids[j]),
+                                       libcfs_nid2str(nids[i]));
+                                return -EINVAL;
+                        }
+                }
+
+                cfs_list_for_each (tmp, &the_lnet.ln_peer_rails) {
+                        pr = cfs_list_entry(tmp, lnet_peer_rails_t, pr_list);
+
+                        for (j = 0; j < pr->pr_nrails; j++) {
+                                if (pr->pr_rails[j].rl_nid != nids[i])
+                                        continue;
+
+                                CERROR("%s is a rail of two peers\n",
+                                       libcfs_nid2str(nids[i]));
+                                return -EEXIST;
+                        }
+                }
+        }
+
+        LIBCFS_ALLOC(pr, offsetof(lnet_peer_rails_t, pr_rails[nnids]));
+        if (pr == NULL)
+                return -ENOMEM;
+
+        memset(pr, 0, offsetof(lnet_peer_rails_t, pr_rails[nnids]));
+
+        for (i = 0; i < nnids; i++) {
+                pr->pr_rails[i].rl_nid = nids[i];
+                pr->pr_rails[i].rl_peer = pr;
+                cfs_atomic_set(&pr->pr_rails[i].rl_nsent, 0);
+        }
+        pr->pr_nrails = nnids;
+
+        cfs_list_add_tail(&pr->pr_list, &the_lnet.ln_peer_rails);
+        return 0;
+}
+
+/* Start using the peers added by lnet_add_peer_rails(): the LNDs are up
+ * already, so the hash is only published once complete */
+int
+lnet_hash_peer_rails(void)
+{
+        lnet_peer_rails_t *pr;
+        cfs_list_t        *hash;
+        cfs_list_t        *tmp;
+        unsigned int       idx;
+        int                i;
+
+        if (cfs_list_empty(&the_lnet.ln_peer_rails))
+                return 0;
+
+        LIBCFS_ALLOC(hash, LNET_PEER_HASHSIZE * sizeof(cfs_list_t));
+        if (hash == NULL)
+                return -ENOMEM;
+
+        for (i = 0; i < LNET_PEER_HASHSIZE; i++)
+                CFS_INIT_LIST_HEAD(&hash[i]);
+
+        cfs_list_for_each (tmp, &the_lnet.ln_peer_rails) {
+                pr = cfs_list_entry(tmp, lnet_peer_rails_t, pr_list);
+
+                for (i = 0; i < pr->pr_nrails; i++) {
+                        idx = lnet_rail_hash_idx(pr->pr_rails[i].rl_nid);
+                        cfs_list_add_tail(&pr->pr_rails[i].rl_hashlist,
+                                          &hash[idx]);
+                }
+        }
+
+#ifdef __KERNEL__
+        cfs_mb();               /* the LNDs may be receiving already */
+#endif
+        the_lnet.ln_rail_hash = hash;
+        return 0;
+}
+
+void
+lnet_destroy_peer_rails(void)
+{
+        lnet_peer_rails_t *pr;
+        int                i;
+
+        while (!cfs_list_empty(&the_lnet.ln_peer_rails)) {
+                pr = cfs_list_entry(the_lnet.ln_peer_rails.next,
+                                    lnet_peer_rails_t, pr_list);
+                cfs_list_del(&pr->pr_list);
+
+                if (the_lnet.ln_rail_hash != NULL) {
+                        for (i = 0; i < pr->pr_nrails; i++)
+                                cfs_list_del(&pr->pr_rails[i].rl_hashlist);
+                }
+
+                LIBCFS_FREE(pr, offsetof(lnet_peer_rails_t,
+                                         pr_rails[pr->pr_nrails]));
+        }
+
+        if (the_lnet.ln_rail_hash != NULL) {
+                LIBCFS_FREE(the_lnet.ln_rail_hash,
+                            LNET_PEER_HASHSIZE * sizeof(cfs_list_t));
+                the_lnet.ln_rail_hash = NULL;
+        }
 }
@@ -63,6 +63,7 @@ lnet_peer_buffer_credits(lnet_ni_t *ni)
 
 /* forward ref's */
 static int lnet_router_checker(void *);
+static void lnet_rtrpools_adjust(void);
 #else
 
 int
@@ -235,6 +236,65 @@ lnet_find_net_locked (__u32 net)
         return NULL;
 }
 
+/* Health of \a route, counting what it got back since its last change */
+int
+lnet_route_health(lnet_route_t *route)
+{
+        long idle = cfs_duration_sec(cfs_time_sub(cfs_time_current(),
+                                                  route->lr_health_stamp));
+
+        if (idle >= LNET_ROUTE_HEALTH_RECOVERY)
+                return LNET_ROUTE_HEALTH_MAX;
+
+        return MIN(route->lr_health + idle * LNET_ROUTE_HEALTH_MAX /
+                   LNET_ROUTE_HEALTH_RECOVERY, LNET_ROUTE_HEALTH_MAX);
+}
+
+static void
+lnet_route_health_update(lnet_route_t *route, __u32 net, int ok)
+{
+        int health = lnet_route_health(route);
+        int old = health;
+
+        if (ok)
+                health += (LNET_ROUTE_HEALTH_MAX - health + 7) / 8;
+        else
+                health -= (health + 1) / 2;
+
+        route->lr_health = health;
+        route->lr_health_stamp = cfs_time_current();
+
+        if ((old < LNET_ROUTE_HEALTH_SICK) != (health < LNET_ROUTE_HEALTH_SICK))
+                CDEBUG(D_NET, "Route to %s via %s %s: health %d\n",
+                       libcfs_net2str(net),
+                       libcfs_nid2str(route->lr_gateway->lp_nid),
+                       ok ? "recovered" : "failing", health);
+}
+
+/* Account a send to \a net through gateway \a gw, or a ping of \a gw if
+ * \a net is LNET_NIDNET(LNET_NID_ANY).  Called holding the net lock of the
+ * gateway's partition, or LNET_LOCK_EX. */
+void
+lnet_route_health_update_locked(lnet_peer_t *gw, __u32 net, int ok)
+{
+        lnet_remotenet_t *rnet;
+        lnet_route_t     *route;
+
+        cfs_list_for_each_entry(rnet, &the_lnet.ln_remote_nets, lrn_list) {
+                if (net != LNET_NIDNET(LNET_NID_ANY) && net != rnet->lrn_net)
+                        continue;
+
+                cfs_list_for_each_entry(route, &rnet->lrn_routes, lr_list) {
+                        if (route->lr_gateway == gw)
+                                lnet_route_health_update(route,
+                                                         rnet->lrn_net, ok);
+                }
+
+                if (net != LNET_NIDNET(LNET_NID_ANY))
+                        break;
+        }
+}
+
 /* NB expects LNET_LOCK held */
 void
 lnet_add_route_to_rnet (lnet_remotenet_t *rnet, lnet_route_t *route)
@@ -304,10 +364,12 @@ lnet_add_route (__u32 net, unsigned int hops, lnet_nid_t gateway)
         CFS_INIT_LIST_HEAD(&rnet->lrn_routes);
         rnet->lrn_net = net;
         route->lr_hops = hops;
+        route->lr_health = LNET_ROUTE_HEALTH_MAX;
+        route->lr_health_stamp = cfs_time_current();
 
         LNET_LOCK();
 
-        rc = lnet_nid2peer_locked(&route->lr_gateway, gateway);
+        rc = lnet_nid2peer_locked(&route->lr_gateway, gateway, LNET_LOCK_EX);
         if (rc != 0) {
                 LNET_UNLOCK();
 
@@ -347,7 +409,7 @@ lnet_add_route (__u32 net, unsigned int hops, lnet_nid_t gateway)
 
         if (add_route) {
                 ni = route->lr_gateway->lp_ni;
-                lnet_ni_addref_locked(ni);
+                lnet_ni_addref_locked(ni, LNET_LOCK_EX);
 
                 lnet_add_route_to_rnet(rnet2, route);
                 LNET_UNLOCK();
@@ -636,17 +698,21 @@ lnet_wait_known_routerstate(void)
 static void
 lnet_router_checker_event (lnet_event_t *event)
 {
-        /* CAVEAT EMPTOR: I'm called with LNET_LOCKed and I'm not allowed to
-         * drop it (that's how come I see _every_ event, even ones that would
-         * overflow my EQ) */
+        /* CAVEAT EMPTOR: I'm called with the res lock of the MD and the eq
+         * wait lock held, and I'm not allowed to drop them (that's how come
+         * I see _every_ event, even ones that would overflow my EQ).  The
+         * router state I change is protected by LNET_LOCK, which nests
+         * inside them. */
         lnet_rc_data_t *rcd = event->md.user_ptr;
         lnet_peer_t    *lp;
         lnet_nid_t      nid;
 
+        LNET_LOCK();
+
         if (event->unlinked) {
                 if (rcd != NULL) {
                         LNetInvalidateHandle(&rcd->rcd_mdh);
-                        return;
+                        goto out;
                 }
 
                 /* The router checker thread has unlinked the default rc_md
@@ -656,7 +722,7 @@ lnet_router_checker_event (lnet_event_t *event)
 #ifdef __KERNEL__
                 cfs_mutex_up(&the_lnet.ln_rc_signal);
 #endif
-                return;
+                goto out;
         }
 
         LASSERT (event->type == LNET_EVENT_SEND ||
@@ -669,7 +735,7 @@ lnet_router_checker_event (lnet_event_t *event)
         if (lp == NULL) {
                 /* router may have been removed */
                 CDEBUG(D_NET, "Router %s not found\n", libcfs_nid2str(nid));
-                return;
+                goto out;
         }
 
         if (event->type == LNET_EVENT_SEND)     /* re-enable another ping */
@@ -686,6 +752,8 @@ lnet_router_checker_event (lnet_event_t *event)
 
                 lnet_notify_locked(lp, 1, (event->status == 0),
                                    cfs_time_current());
+                lnet_route_health_update_locked(lp, LNET_NIDNET(LNET_NID_ANY),
+                                                event->status == 0);
 
                 /* The router checker will wake up very shortly and do the
                  * actual notification.  
@@ -699,6 +767,8 @@ lnet_router_checker_event (lnet_event_t *event)
         LASSERT(lp->lp_refcount > 1);
 
         lnet_peer_decref_locked(lp);
+ out:
+        LNET_UNLOCK();
 }
 
 void
@@ -1156,8 +1226,10 @@ rescan:
 
                 LNET_UNLOCK();
 
-                if (the_lnet.ln_routing)
+                if (the_lnet.ln_routing) {
                         lnet_update_ni_status();
+                        lnet_rtrpools_adjust();
+                }
 
                 lnet_prune_zombie_rcd(0); /* don't wait for UNLINK */
 
@@ -1239,6 +1311,27 @@ lnet_new_rtrbuf(lnet_rtrbufpool_t *rbp)
         return rb;
 }
 
+/* A router buffer pool sizes itself between 1/LNET_RTRPOOL_SHRINK_DIV and
+ * LNET_RTRPOOL_GROW_MAX times its configured number of buffers: it grows when
+ * messages had to wait for a buffer since the last check, and gives back a
+ * quarter of its buffers once more than half of them stayed free for
+ * LNET_RTRPOOL_IDLE_CHECKS checks in a row. */
+#define LNET_RTRPOOL_GROW_MAX           4
+#define LNET_RTRPOOL_SHRINK_DIV         4
+#define LNET_RTRPOOL_IDLE_CHECKS        10
+
+static void
+lnet_rtrpool_free_list(cfs_list_t *bufs, int npages)
+{
+        lnet_rtrbuf_t *rb;
+
+        while (!cfs_list_empty(bufs)) {
+                rb = cfs_list_entry(bufs->next, lnet_rtrbuf_t, rb_list);
+                cfs_list_del(&rb->rb_list);
+                lnet_destroy_rtrbuf(rb, npages);
+        }
+}
+
 void
 lnet_rtrpool_free_bufs(lnet_rtrbufpool_t *rbp)
 {
@@ -1265,47 +1358,202 @@ lnet_rtrpool_free_bufs(lnet_rtrbufpool_t *rbp)
         rbp->rbp_nbuffers = rbp->rbp_credits = 0;
 }
 
-int
-lnet_rtrpool_alloc_bufs(lnet_rtrbufpool_t *rbp, int nbufs)
+/* Add \a nbufs new buffers to \a rbp, handing them straight to messages
+ * blocked waiting for one.  The buffers are allocated before taking the net
+ * lock of the pool's partition. */
+static int
+lnet_rtrpool_grow(lnet_rtrbufpool_t *rbp, int nbufs)
 {
+        CFS_LIST_HEAD (bufs);
         lnet_rtrbuf_t *rb;
+        lnet_msg_t    *msg;
         int            i;
 
-        if (rbp->rbp_nbuffers != 0) {
-                LASSERT (rbp->rbp_nbuffers == nbufs);
-                return 0;
-        }
-
         for (i = 0; i < nbufs; i++) {
                 rb = lnet_new_rtrbuf(rbp);
-
                 if (rb == NULL) {
                         CERROR("Failed to allocate %d router bufs of %d pages\n",
                                nbufs, rbp->rbp_npages);
-                        return -ENOMEM;
+                        break;
                 }
+                cfs_list_add(&rb->rb_list, &bufs);
+        }
+
+        lnet_net_lock(rbp->rbp_cpt);
+
+        while (!cfs_list_empty(&bufs)) {
+                rb = cfs_list_entry(bufs.next, lnet_rtrbuf_t, rb_list);
+                cfs_list_del(&rb->rb_list);
+
+                LASSERT((rbp->rbp_credits < 0) ==
+                        !cfs_list_empty(&rbp->rbp_msgs));
 
+                cfs_list_add(&rb->rb_list, &rbp->rbp_bufs);
                 rbp->rbp_nbuffers++;
                 rbp->rbp_credits++;
-                rbp->rbp_mincredits++;
-                cfs_list_add(&rb->rb_list, &rbp->rbp_bufs);
+                if (rbp->rbp_credits <= 0) {
+                        msg = cfs_list_entry(rbp->rbp_msgs.next,
+                                             lnet_msg_t, msg_list);
+                        cfs_list_del(&msg->msg_list);
 
-                /* No allocation "under fire" */
-                /* Otherwise we'd need code to schedule blocked msgs etc */
-                LASSERT (!the_lnet.ln_routing);
+                        /* NB drops and retakes the lock */
+                        (void) lnet_post_routed_recv_locked(msg, 1);
+                }
+        }
+
+        lnet_net_unlock(rbp->rbp_cpt);
+
+        return (i == nbufs) ? 0 : -ENOMEM;
+}
+
+/* Free up to \a nbufs of the buffers \a rbp has spare; the ones in use stay
+ * in the pool */
+static void
+lnet_rtrpool_shrink(lnet_rtrbufpool_t *rbp, int nbufs)
+{
+        CFS_LIST_HEAD (bufs);
+        lnet_rtrbuf_t *rb;
+
+        lnet_net_lock(rbp->rbp_cpt);
+
+        while (nbufs-- > 0 && rbp->rbp_credits > 0) {
+                LASSERT (!cfs_list_empty(&rbp->rbp_bufs));
+
+                rb = cfs_list_entry(rbp->rbp_bufs.next,
+                                    lnet_rtrbuf_t, rb_list);
+                cfs_list_move(&rb->rb_list, &bufs);
+                rbp->rbp_nbuffers--;
+                rbp->rbp_credits--;
+        }
+
+        if (rbp->rbp_mincredits > rbp->rbp_credits)
+                rbp->rbp_mincredits = rbp->rbp_credits;
+        if (rbp->rbp_lowcredits > rbp->rbp_credits)
+                rbp->rbp_lowcredits = rbp->rbp_credits;
+
+        lnet_net_unlock(rbp->rbp_cpt);
+
+        lnet_rtrpool_free_list(&bufs, rbp->rbp_npages);
+}
+
+/* Resize \a rbp for the traffic it saw since the last call, or to the size
+ * requested through /proc/sys/lnet/buffers */
+static void
+lnet_rtrpool_adjust(lnet_rtrbufpool_t *rbp)
+{
+        int nbuffers;
+        int nblocked;
+        int lowcredits;
+        int target;
+        int step;
+
+        lnet_net_lock(rbp->rbp_cpt);
+
+        nbuffers   = rbp->rbp_nbuffers;
+        nblocked   = rbp->rbp_nblocked;
+        lowcredits = rbp->rbp_lowcredits;
+        target     = rbp->rbp_req_nbuffers;
+
+        rbp->rbp_nblocked     = 0;
+        rbp->rbp_lowcredits   = rbp->rbp_credits;
+        rbp->rbp_req_nbuffers = 0;
+
+        if (target != 0) {
+                rbp->rbp_nidle = 0;
+        } else if (nblocked > 0) {
+                rbp->rbp_nidle = 0;
+                step = max(nblocked, nbuffers / 4);
+                target = min(nbuffers + step,
+                             rbp->rbp_base * LNET_RTRPOOL_GROW_MAX);
+                target = max(target, nbuffers);
+        } else if (lowcredits <= nbuffers / 2) {
+                rbp->rbp_nidle = 0;
+        } else if (++rbp->rbp_nidle >= LNET_RTRPOOL_IDLE_CHECKS) {
+                rbp->rbp_nidle = 0;
+                step = max(nbuffers / 4, 1);
+                target = max(nbuffers - step,
+                             max(rbp->rbp_base / LNET_RTRPOOL_SHRINK_DIV, 1));
+                target = min(target, nbuffers);
+        }
+
+        lnet_net_unlock(rbp->rbp_cpt);
+
+        if (target == 0 || target == nbuffers)
+                return;
+
+        CDEBUG(D_NET, "cpt %d: resizing pool of %d page buffers %d -> %d "
+               "(%d blocked)\n", rbp->rbp_cpt, rbp->rbp_npages,
+               nbuffers, target, nblocked);
+
+        if (target > nbuffers)
+                lnet_rtrpool_grow(rbp, target - nbuffers);
+        else
+                lnet_rtrpool_shrink(rbp, nbuffers - target);
+}
+
+/* Called by the router checker once a second; it's the only thread resizing
+ * the pools once routing has started */
+static void
+lnet_rtrpools_adjust(void)
+{
+        int cpt;
+        int i;
+
+        if (the_lnet.ln_rtrpools == NULL)
+                return;
+
+        for (cpt = 0; cpt < the_lnet.ln_cpt_number; cpt++) {
+                for (i = 0; i < LNET_NRBPOOLS; i++)
+                        lnet_rtrpool_adjust(&the_lnet.ln_rtrpools[cpt][i]);
+        }
+}
+
+/* share \a nbufs buffers between the partitions */
+static int
+lnet_rtrpool_cpt_nbufs(int nbufs)
+{
+        return max(nbufs / the_lnet.ln_cpt_number, 1);
+}
+
+/* Set the total number of tiny, small and large router buffers; the router
+ * checker resizes the pools on its next pass */
+int
+lnet_rtrpools_resize(int tiny, int small, int large)
+{
+        int nbufs[LNET_NRBPOOLS] = { tiny, small, large };
+        int cpt;
+        int i;
+
+        if (the_lnet.ln_rtrpools == NULL)
+                return -EINVAL;
+
+        for (i = 0; i < LNET_NRBPOOLS; i++) {
+                if (nbufs[i] <= 0)
+                        return -EINVAL;
+        }
+
+        for (cpt = 0; cpt < the_lnet.ln_cpt_number; cpt++) {
+                lnet_net_lock(cpt);
+                for (i = 0; i < LNET_NRBPOOLS; i++) {
+                        lnet_rtrbufpool_t *rbp = &the_lnet.ln_rtrpools[cpt][i];
+
+                        rbp->rbp_base = lnet_rtrpool_cpt_nbufs(nbufs[i]);
+                        rbp->rbp_req_nbuffers = rbp->rbp_base;
+                }
+                lnet_net_unlock(cpt);
         }
 
-        LASSERT (rbp->rbp_credits == nbufs);
         return 0;
 }
 
 void
-lnet_rtrpool_init(lnet_rtrbufpool_t *rbp, int npages)
+lnet_rtrpool_init(lnet_rtrbufpool_t *rbp, int npages, int cpt)
 {
         CFS_INIT_LIST_HEAD(&rbp->rbp_msgs);
         CFS_INIT_LIST_HEAD(&rbp->rbp_bufs);
 
         rbp->rbp_npages = npages;
+        rbp->rbp_cpt = cpt;
         rbp->rbp_credits = 0;
         rbp->rbp_mincredits = 0;
 }
@@ -1313,27 +1561,63 @@ lnet_rtrpool_init(lnet_rtrbufpool_t *rbp, int npages)
 void
 lnet_free_rtrpools(void)
 {
-        lnet_rtrpool_free_bufs(&the_lnet.ln_rtrpools[0]);
-        lnet_rtrpool_free_bufs(&the_lnet.ln_rtrpools[1]);
-        lnet_rtrpool_free_bufs(&the_lnet.ln_rtrpools[2]);
+        int cpt;
+        int i;
+
+        if (the_lnet.ln_rtrpools == NULL)
+                return;
+
+        for (cpt = 0; cpt < the_lnet.ln_cpt_number; cpt++) {
+                if (the_lnet.ln_rtrpools[cpt] == NULL)
+                        continue;
+
+                for (i = 0; i < LNET_NRBPOOLS; i++)
+                        lnet_rtrpool_free_bufs(&the_lnet.ln_rtrpools[cpt][i]);
+
+                LIBCFS_FREE(the_lnet.ln_rtrpools[cpt],
+                            LNET_NRBPOOLS * sizeof(lnet_rtrbufpool_t));
+        }
+
+        LIBCFS_FREE(the_lnet.ln_rtrpools,
+                    the_lnet.ln_cpt_number * sizeof(the_lnet.ln_rtrpools[0]));
+        the_lnet.ln_rtrpools = NULL;
 }
 
-void
+static int
 lnet_init_rtrpools(void)
 {
         int small_pages = 1;
         int large_pages = (LNET_MTU + CFS_PAGE_SIZE - 1) >> CFS_PAGE_SHIFT;
+        int cpt;
 
-        lnet_rtrpool_init(&the_lnet.ln_rtrpools[0], 0);
-        lnet_rtrpool_init(&the_lnet.ln_rtrpools[1], small_pages);
-        lnet_rtrpool_init(&the_lnet.ln_rtrpools[2], large_pages);
-}
+        LIBCFS_ALLOC(the_lnet.ln_rtrpools,
+                     the_lnet.ln_cpt_number * sizeof(the_lnet.ln_rtrpools[0]));
+        if (the_lnet.ln_rtrpools == NULL)
+                return -ENOMEM;
+
+        for (cpt = 0; cpt < the_lnet.ln_cpt_number; cpt++) {
+                lnet_rtrbufpool_t *rbp;
+
+                LIBCFS_ALLOC(rbp, LNET_NRBPOOLS * sizeof(*rbp));
+                if (rbp == NULL)
+                        return -ENOMEM;
 
+                lnet_rtrpool_init(&rbp[0], 0, cpt);
+                lnet_rtrpool_init(&rbp[1], small_pages, cpt);
+                lnet_rtrpool_init(&rbp[2], large_pages, cpt);
+                the_lnet.ln_rtrpools[cpt] = rbp;
+        }
+
+        return 0;
+}
 
 int
 lnet_alloc_rtrpools(int im_a_router)
 {
-        int       rc;
+        int nbufs[LNET_NRBPOOLS];
+        int rc;
+        int cpt;
+        int i;
 
         if (!strcmp(forwarding, "")) {
                 /* not set either way */
@@ -1353,39 +1637,43 @@ lnet_alloc_rtrpools(int im_a_router)
         if (tiny_router_buffers <= 0) {
                 LCONSOLE_ERROR_MSG(0x10c, "tiny_router_buffers=%d invalid when "
                                    "routing enabled\n", tiny_router_buffers);
-                rc = -EINVAL;
-                goto failed;
+                return -EINVAL;
         }
 
-        rc = lnet_rtrpool_alloc_bufs(&the_lnet.ln_rtrpools[0],
-                                     tiny_router_buffers);
-        if (rc != 0)
-                goto failed;
-
         if (small_router_buffers <= 0) {
                 LCONSOLE_ERROR_MSG(0x10d, "small_router_buffers=%d invalid when"
                                    " routing enabled\n", small_router_buffers);
-                rc = -EINVAL;
-                goto failed;
+                return -EINVAL;
         }
 
-        rc = lnet_rtrpool_alloc_bufs(&the_lnet.ln_rtrpools[1],
-                                     small_router_buffers);
-        if (rc != 0)
-                goto failed;
-
         if (large_router_buffers <= 0) {
                 LCONSOLE_ERROR_MSG(0x10e, "large_router_buffers=%d invalid when"
                                    " routing enabled\n", large_router_buffers);
-                rc = -EINVAL;
-                goto failed;
+                return -EINVAL;
         }
 
-        rc = lnet_rtrpool_alloc_bufs(&the_lnet.ln_rtrpools[2],
-                                     large_router_buffers);
+        nbufs[0] = lnet_rtrpool_cpt_nbufs(tiny_router_buffers);
+        nbufs[1] = lnet_rtrpool_cpt_nbufs(small_router_buffers);
+        nbufs[2] = lnet_rtrpool_cpt_nbufs(large_router_buffers);
+
+        rc = lnet_init_rtrpools();
         if (rc != 0)
                 goto failed;
 
+        for (cpt = 0; cpt < the_lnet.ln_cpt_number; cpt++) {
+                for (i = 0; i < LNET_NRBPOOLS; i++) {
+                        lnet_rtrbufpool_t *rbp = &the_lnet.ln_rtrpools[cpt][i];
+
+                        rc = lnet_rtrpool_grow(rbp, nbufs[i]);
+                        if (rc != 0)
+                                goto failed;
+
+                        rbp->rbp_base = nbufs[i];
+                        rbp->rbp_mincredits = rbp->rbp_credits;
+                        rbp->rbp_lowcredits = rbp->rbp_credits;
+                }
+        }
+
         LNET_LOCK();
         the_lnet.ln_routing = 1;
         LNET_UNLOCK();
@@ -1590,11 +1878,6 @@ lnet_free_rtrpools (void)
 {
 }
 
-void
-lnet_init_rtrpools (void)
-{
-}
-
 int
 lnet_alloc_rtrpools (int im_a_arouter)
 {
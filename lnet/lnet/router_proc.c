@@ -41,6 +41,9 @@ enum {
         PSDEV_LNET_PEERS,
         PSDEV_LNET_BUFFERS,
         PSDEV_LNET_NIS,
+        PSDEV_LNET_CPT_STATS,
+        PSDEV_LNET_PORTALS,
+        PSDEV_LNET_RAILS,
 };
 #else
 #define CTL_LNET           CTL_UNNUMBERED
@@ -50,16 +53,20 @@ enum {
 #define PSDEV_LNET_PEERS   CTL_UNNUMBERED
 #define PSDEV_LNET_BUFFERS CTL_UNNUMBERED
 #define PSDEV_LNET_NIS     CTL_UNNUMBERED
+#define PSDEV_LNET_CPT_STATS CTL_UNNUMBERED
+#define PSDEV_LNET_PORTALS CTL_UNNUMBERED
+#define PSDEV_LNET_RAILS   CTL_UNNUMBERED
 #endif
 
 /*
  * NB: we don't use the highest bit of *ppos because it's signed;
- *     next 9 bits is used to stash idx (assuming that
- *     LNET_PEER_HASHSIZE < 512)
+ *     next 16 bits is used to stash idx, which walks the hash buckets of
+ *     every partition's peer table in turn (assuming that
+ *     LNET_PEER_HASHSIZE * number of partitions < 65536)
  */
 #define LNET_LOFFT_BITS        (sizeof(loff_t) * 8)
 #define LNET_VERSION_BITS      MAX(((MIN(LNET_LOFFT_BITS, 64)) / 4), 8)
-#define LNET_PHASH_IDX_BITS    9
+#define LNET_PHASH_IDX_BITS    16
 #define LNET_PHASH_NUM_BITS    (LNET_LOFFT_BITS - 1 -\
                                 LNET_VERSION_BITS - LNET_PHASH_IDX_BITS)
 #define LNET_PHASH_BITS        (LNET_PHASH_IDX_BITS + LNET_PHASH_NUM_BITS)
@@ -97,9 +104,7 @@ static int __proc_lnet_stats(void *data, int write,
         const int        tmpsiz = 256; /* 7 %u and 4 LPU64 */
 
         if (write) {
-                LNET_LOCK();
-                memset(&the_lnet.ln_counters, 0, sizeof(the_lnet.ln_counters));
-                LNET_UNLOCK();
+                lnet_counters_reset();
                 return 0;
         }
 
@@ -115,9 +120,7 @@ static int __proc_lnet_stats(void *data, int write,
                 return -ENOMEM;
         }
 
-        LNET_LOCK();
-        *ctrs = the_lnet.ln_counters;
-        LNET_UNLOCK();
+        lnet_counters_get(ctrs);
 
         len = snprintf(tmpstr, tmpsiz,
                        "%u %u %u %u %u %u %u "LPU64" "LPU64" "
@@ -142,6 +145,186 @@ static int __proc_lnet_stats(void *data, int write,
 
 DECLARE_PROC_HANDLER(proc_lnet_stats);
 
+static int __proc_lnet_cpt_stats(void *data, int write,
+                                 loff_t pos, void *buffer, int nob)
+{
+        lnet_counters_t  ctrs;
+        char            *tmpstr;
+        char            *s;
+        const int        linesiz = 80; /* 1 %d and 6 %u */
+        int              tmpsiz = (the_lnet.ln_cpt_number + 1) * linesiz;
+        int              len;
+        int              rc;
+        int              i;
+
+        if (write)
+                return -EINVAL;
+
+        LIBCFS_ALLOC(tmpstr, tmpsiz);
+        if (tmpstr == NULL)
+                return -ENOMEM;
+
+        s = tmpstr;
+        s += snprintf(s, tmpstr + tmpsiz - s,
+                      "%-4s %8s %8s %10s %10s %10s %10s\n",
+                      "cpt", "msgs", "max", "send", "recv", "route", "drop");
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                lnet_net_lock(i);
+                ctrs = the_lnet.ln_msg_containers[i]->msc_counters;
+                lnet_net_unlock(i);
+
+                s += snprintf(s, tmpstr + tmpsiz - s,
+                              "%-4d %8u %8u %10u %10u %10u %10u\n", i,
+                              ctrs.msgs_alloc, ctrs.msgs_max,
+                              ctrs.send_count, ctrs.recv_count,
+                              ctrs.route_count, ctrs.drop_count);
+                LASSERT (tmpstr + tmpsiz - s > 0);
+        }
+
+        len = s - tmpstr;
+        if (pos >= len)
+                rc = 0;
+        else
+                rc = cfs_trace_copyout_string(buffer, nob,
+                                              tmpstr + pos, NULL);
+
+        LIBCFS_FREE(tmpstr, tmpsiz);
+        return rc;
+}
+
+DECLARE_PROC_HANDLER(proc_lnet_cpt_stats);
+
+/* match statistics of the portals in use: the average number of MEs scanned
+ * per match should stay flat however many MEs are attached */
+static int __proc_lnet_portals(void *data, int write,
+                               loff_t pos, void *buffer, int nob)
+{
+        lnet_portal_t    ptl;
+        char            *tmpstr;
+        char            *s;
+        const int        linesiz = 80; /* 2 %d, 1 %s, 1 %u and 2 LPU64 */
+        int              tmpsiz = (the_lnet.ln_nportals + 1) * linesiz;
+        int              len;
+        int              rc;
+        int              i;
+
+        if (write)
+                return -EINVAL;
+
+        LIBCFS_ALLOC(tmpstr, tmpsiz);
+        if (tmpstr == NULL)
+                return -ENOMEM;
+
+        s = tmpstr;
+        s += snprintf(s, tmpstr + tmpsiz - s,
+                      "%-6s %-8s %-4s %8s %12s %12s\n",
+                      "portal", "type", "lazy", "mes", "matched", "scanned");
+
+        for (i = 0; i < the_lnet.ln_nportals; i++) {
+                lnet_res_lock(lnet_ptl_cpt(i));
+                ptl = the_lnet.ln_portals[i];
+                lnet_res_unlock(lnet_ptl_cpt(i));
+
+                if (ptl.ptl_options == 0)
+                        continue;
+
+                s += snprintf(s, tmpstr + tmpsiz - s,
+                              "%-6d %-8s %-4d %8u %12"LPF64"u %12"LPF64"u\n",
+                              i, lnet_portal_is_unique(&ptl) ? "unique" :
+                              lnet_portal_is_wildcard(&ptl) ? "wildcard" :
+                              "unset", lnet_portal_is_lazy(&ptl),
+                              ptl.ptl_nme, ptl.ptl_nmatch, ptl.ptl_nscan);
+                LASSERT (tmpstr + tmpsiz - s > 0);
+        }
+
+        len = s - tmpstr;
+        if (pos >= len)
+                rc = 0;
+        else
+                rc = cfs_trace_copyout_string(buffer, nob,
+                                              tmpstr + pos, NULL);
+
+        LIBCFS_FREE(tmpstr, tmpsiz);
+        return rc;
+}
+
+DECLARE_PROC_HANDLER(proc_lnet_portals);
+
+/* one line per rail of the multi-rail peers, which don't change while LNet
+ * is up */
+static int __proc_lnet_rails(void *data, int write,
+                             loff_t pos, void *buffer, int nob)
+{
+        lnet_peer_rails_t *pr;
+        lnet_rail_t       *rl;
+        lnet_peer_t       *lp;
+        cfs_list_t        *tmp;
+        char              *tmpstr;
+        char              *s;
+        char              *state;
+        const int          linesiz = 80; /* 2 nids, 1 %s and 1 %d */
+        int                tmpsiz = linesiz;
+        int                len;
+        int                cpt;
+        int                rc;
+        int                i;
+
+        if (write)
+                return -EINVAL;
+
+        cfs_list_for_each (tmp, &the_lnet.ln_peer_rails) {
+                pr = cfs_list_entry(tmp, lnet_peer_rails_t, pr_list);
+                tmpsiz += pr->pr_nrails * linesiz;
+        }
+
+        LIBCFS_ALLOC(tmpstr, tmpsiz);
+        if (tmpstr == NULL)
+                return -ENOMEM;
+
+        s = tmpstr;
+        s += snprintf(s, tmpstr + tmpsiz - s, "%-24s %-24s %-5s %10s\n",
+                      "primary", "rail", "state", "sent");
+
+        cfs_list_for_each (tmp, &the_lnet.ln_peer_rails) {
+                pr = cfs_list_entry(tmp, lnet_peer_rails_t, pr_list);
+
+                for (i = 0; i < pr->pr_nrails; i++) {
+                        rl = &pr->pr_rails[i];
+                        cpt = lnet_cpt_of_nid(rl->rl_nid);
+
+                        lnet_net_lock(cpt);
+                        lp = lnet_find_peer_locked(rl->rl_nid);
+                        if (lp == NULL) {
+                                state = "NA";
+                        } else {
+                                state = lp->lp_alive ? "up" : "down";
+                                lnet_peer_decref_locked(lp);
+                        }
+                        lnet_net_unlock(cpt);
+
+                        s += snprintf(s, tmpstr + tmpsiz - s,
+                                      "%-24s %-24s %-5s %10d\n",
+                                      libcfs_nid2str(pr->pr_rails[0].rl_nid),
+                                      libcfs_nid2str(rl->rl_nid), state,
+                                      cfs_atomic_read(&rl->rl_nsent));
+                        LASSERT (tmpstr + tmpsiz - s > 0);
+                }
+        }
+
+        len = s - tmpstr;
+        if (pos >= len)
+                rc = 0;
+        else
+                rc = cfs_trace_copyout_string(buffer, nob,
+                                              tmpstr + pos, NULL);
+
+        LIBCFS_FREE(tmpstr, tmpsiz);
+        return rc;
+}
+
+DECLARE_PROC_HANDLER(proc_lnet_rails);
+
 int LL_PROC_PROTO(proc_lnet_routes)
 {
         int        rc     = 0;
@@ -173,8 +356,8 @@ int LL_PROC_PROTO(proc_lnet_routes)
                               the_lnet.ln_routing ? "enabled" : "disabled");
                 LASSERT (tmpstr + tmpsiz - s > 0);
 
-                s += snprintf(s, tmpstr + tmpsiz - s, "%-8s %4s %7s %s\n",
-                              "net", "hops", "state", "router");
+                s += snprintf(s, tmpstr + tmpsiz - s, "%-8s %4s %7s %6s %s\n",
+                              "net", "hops", "state", "health", "router");
                 LASSERT (tmpstr + tmpsiz - s > 0);
 
                 LNET_LOCK();
@@ -224,10 +407,13 @@ int LL_PROC_PROTO(proc_lnet_routes)
                         unsigned int hops  = route->lr_hops;
                         lnet_nid_t   nid   = route->lr_gateway->lp_nid;
                         int          alive = route->lr_gateway->lp_alive;
+                        int          health = lnet_route_health(route);
 
-                        s += snprintf(s, tmpstr + tmpsiz - s, "%-8s %4u %7s %s\n",
+                        s += snprintf(s, tmpstr + tmpsiz - s,
+                                      "%-8s %4u %7s %6d %s\n",
                                       libcfs_net2str(net), hops,
-                                      alive ? "up" : "down", libcfs_nid2str(nid));
+                                      alive ? "up" : "down", health,
+                                      libcfs_nid2str(nid));
                         LASSERT (tmpstr + tmpsiz - s > 0);
                 }
 
@@ -376,6 +562,20 @@ int LL_PROC_PROTO(proc_lnet_routers)
         return rc;
 }
 
+/* sum of the peer table versions, changes whenever any of them does;
+ * called holding LNET_LOCK */
+static unsigned int
+lnet_peer_tables_version_locked(void)
+{
+        unsigned int version = 0;
+        int          i;
+
+        for (i = 0; i < the_lnet.ln_cpt_number; i++)
+                version += the_lnet.ln_peer_tables[i]->pt_version;
+
+        return version;
+}
+
 int LL_PROC_PROTO(proc_lnet_peers)
 {
         int        rc = 0;
@@ -414,7 +614,7 @@ int LL_PROC_PROTO(proc_lnet_peers)
                 LASSERT (tmpstr + tmpsiz - s > 0);
 
                 LNET_LOCK();
-                ver = (unsigned int)the_lnet.ln_peertable_version;
+                ver = lnet_peer_tables_version_locked();
                 LNET_UNLOCK();
                 *ppos = LNET_PHASH_POS_MAKE(ver, idx, num);
 
@@ -426,17 +626,23 @@ int LL_PROC_PROTO(proc_lnet_peers)
 
                 LNET_LOCK();
 
-                if (ver != LNET_VERSION_VALID_MASK(the_lnet.ln_peertable_version)) {
+                if (ver != LNET_VERSION_VALID_MASK(
+                                lnet_peer_tables_version_locked())) {
                         LNET_UNLOCK();
                         LIBCFS_FREE(tmpstr, tmpsiz);
                         return -ESTALE;
                 }
 
-                while (idx < LNET_PEER_HASHSIZE) {
+                while (idx < LNET_PEER_HASHSIZE * the_lnet.ln_cpt_number) {
+                        cfs_list_t *hash;
+
+                        hash = &the_lnet.ln_peer_tables[idx /
+                                LNET_PEER_HASHSIZE]->pt_hash[idx %
+                                LNET_PEER_HASHSIZE];
                         if (p == NULL)
-                                p = the_lnet.ln_peer_hash[idx].next;
+                                p = hash->next;
 
-                        while (p != &the_lnet.ln_peer_hash[idx]) {
+                        while (p != hash) {
                                 lnet_peer_t *lp = cfs_list_entry(p, lnet_peer_t,
                                                                  lp_hashlist);
                                 if (skip == 0) {
@@ -445,8 +651,7 @@ int LL_PROC_PROTO(proc_lnet_peers)
                                         /* minor optimization: start from idx+1
                                          * on next iteration if we've just
                                          * drained lp_hashlist */
-                                        if (lp->lp_hashlist.next ==
-                                            &the_lnet.ln_peer_hash[idx]) {
+                                        if (lp->lp_hashlist.next == hash) {
                                                 num = 1;
                                                 idx++;
                                         } else {
@@ -529,6 +734,8 @@ int LL_PROC_PROTO(proc_lnet_peers)
         return rc;
 }
 
+/* one line per router buffer pool of each partition; writing
+ * "<tiny> <small> <large>" resizes the pools to that many buffers in all */
 static int __proc_lnet_buffers(void *data, int write,
                                loff_t pos, void *buffer, int nob)
 {
@@ -537,11 +744,35 @@ static int __proc_lnet_buffers(void *data, int write,
         int              len;
         char            *s;
         char            *tmpstr;
-        const int        tmpsiz = 64 * (LNET_NRBPOOLS + 1); /* (4 %d) * 4 */
+        const int        linesiz = 64; /* 5 %d */
+        int              tmpsiz;
+        int              cpt;
         int              idx;
 
-        LASSERT (!write);
+        if (write) {
+                int tiny;
+                int small;
+                int large;
+
+                tmpsiz = linesiz;
+                LIBCFS_ALLOC(tmpstr, tmpsiz);
+                if (tmpstr == NULL)
+                        return -ENOMEM;
+
+                rc = cfs_trace_copyin_string(tmpstr, tmpsiz, buffer, nob);
+                if (rc == 0) {
+                        if (sscanf(tmpstr, "%d %d %d",
+                                   &tiny, &small, &large) != 3)
+                                rc = -EINVAL;
+                        else
+                                rc = lnet_rtrpools_resize(tiny, small, large);
+                }
+
+                LIBCFS_FREE(tmpstr, tmpsiz);
+                return rc;
+        }
 
+        tmpsiz = linesiz * (the_lnet.ln_cpt_number * LNET_NRBPOOLS + 1);
         LIBCFS_ALLOC(tmpstr, tmpsiz);
         if (tmpstr == NULL)
                 return -ENOMEM;
@@ -549,27 +780,31 @@ static int __proc_lnet_buffers(void *data, int write,
         s = tmpstr; /* points to current position in tmpstr[] */
 
         s += snprintf(s, tmpstr + tmpsiz - s,
-                      "%5s %5s %7s %7s\n",
-                      "pages", "count", "credits", "min");
+                      "%4s %5s %5s %7s %7s\n",
+                      "cpt", "pages", "count", "credits", "min");
         LASSERT (tmpstr + tmpsiz - s > 0);
 
-        LNET_LOCK();
+        for (cpt = 0; the_lnet.ln_rtrpools != NULL &&
+                      cpt < the_lnet.ln_cpt_number; cpt++) {
+                lnet_net_lock(cpt);
 
-        for (idx = 0; idx < LNET_NRBPOOLS; idx++) {
-                lnet_rtrbufpool_t *rbp = &the_lnet.ln_rtrpools[idx];
+                for (idx = 0; idx < LNET_NRBPOOLS; idx++) {
+                        lnet_rtrbufpool_t *rbp =
+                                &the_lnet.ln_rtrpools[cpt][idx];
 
-                int npages = rbp->rbp_npages;
-                int nbuf   = rbp->rbp_nbuffers;
-                int cr     = rbp->rbp_credits;
-                int mincr  = rbp->rbp_mincredits;
+                        int npages = rbp->rbp_npages;
+                        int nbuf   = rbp->rbp_nbuffers;
+                        int cr     = rbp->rbp_credits;
+                        int mincr  = rbp->rbp_mincredits;
 
-                s += snprintf(s, tmpstr + tmpsiz - s,
-                              "%5d %5d %7d %7d\n",
-                              npages, nbuf, cr, mincr);
-                LASSERT (tmpstr + tmpsiz - s > 0);
-        }
+                        s += snprintf(s, tmpstr + tmpsiz - s,
+                                      "%4d %5d %5d %7d %7d\n",
+                                      cpt, npages, nbuf, cr, mincr);
+                        LASSERT (tmpstr + tmpsiz - s > 0);
+                }
 
-        LNET_UNLOCK();
+                lnet_net_unlock(cpt);
+        }
 
         len = s - tmpstr;
 
@@ -637,13 +872,21 @@ int LL_PROC_PROTO(proc_lnet_nis)
                         cfs_time_t now = cfs_time_current();
                         int        last_alive = -1;
                         int        maxtxcr = ni->ni_maxtxcredits;
-                        int        txcr = ni->ni_txcredits;
-                        int        mintxcr = ni->ni_mintxcredits;
+                        int        txcr = 0;
+                        int        mintxcr = 0;
                         int        npeertxcr = ni->ni_peertxcredits;
                         int        npeerrtrcr = ni->ni_peerrtrcredits;
                         lnet_nid_t nid = ni->ni_nid;
-                        int        nref = ni->ni_refcount;
+                        int        nref = 0;
                         char      *stat;
+                        int        i;
+
+                        /* credits and refs are split between partitions */
+                        for (i = 0; i < the_lnet.ln_cpt_number; i++) {
+                                txcr    += ni->ni_tx_queues[i].tq_credits;
+                                mintxcr += ni->ni_tx_queues[i].tq_credits_min;
+                                nref    += ni->ni_refs[i];
+                        }
 
                         if (the_lnet.ln_routing)
                                 last_alive = cfs_duration_sec(cfs_time_sub(now,
@@ -717,9 +960,27 @@ static cfs_sysctl_table_t lnet_table[] = {
         {
                 .ctl_name = PSDEV_LNET_PEERS,
                 .procname = "buffers",
-                .mode     = 0444,
+                .mode     = 0644,
                 .proc_handler = &proc_lnet_buffers,
         },
+        {
+                .ctl_name = PSDEV_LNET_CPT_STATS,
+                .procname = "cpt_stats",
+                .mode     = 0444,
+                .proc_handler = &proc_lnet_cpt_stats,
+        },
+        {
+                .ctl_name = PSDEV_LNET_PORTALS,
+                .procname = "portals",
+                .mode     = 0444,
+                .proc_handler = &proc_lnet_portals,
+        },
+        {
+                .ctl_name = PSDEV_LNET_RAILS,
+                .procname = "rails",
+                .mode     = 0444,
+                .proc_handler = &proc_lnet_rails,
+        },
         {
                 .ctl_name = PSDEV_LNET_NIS,
                 .procname = "nis",
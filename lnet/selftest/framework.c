@@ -416,9 +416,7 @@ sfw_get_stats (srpc_stat_reqst_t *request, srpc_stat_reply_t *reply)
                 return 0;
         }
 
-        LNET_LOCK();
-        reply->str_lnet = the_lnet.ln_counters;
-        LNET_UNLOCK();
+        lnet_counters_get(&reply->str_lnet);
 
         srpc_get_counters(&reply->str_rpc);
 
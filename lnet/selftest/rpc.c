@@ -1245,7 +1245,8 @@ srpc_send_reply (srpc_server_rpc_t *rpc)
         return rc;
 }
 
-/* when in kernel always called with LNET_LOCK() held, and in thread context */
+/* when in kernel always called with the LNet res lock and eq wait lock held,
+ * and in thread context */
 void
 srpc_lnet_ev_handler (lnet_event_t *ev)
 {
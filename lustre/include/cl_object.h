@@ -303,6 +303,19 @@ struct cl_object_operations {
                                          struct cl_object *obj,
                                          struct cl_page *page,
                                          cfs_page_t *vmpage);
+        /**
+         * Batched version of cl_object_operations::coo_page_init(), called by
+         * cl_page_gang_find() for \a nr new pages with consecutive indices.
+         * \a result[i] receives what ->coo_page_init() would have returned
+         * for \a pages[i]. Layers not implementing it get ->coo_page_init()
+         * called for every page. Optional.
+         */
+        void            (*coo_page_gang_init)(const struct lu_env *env,
+                                              struct cl_object *obj,
+                                              struct cl_page **pages,
+                                              cfs_page_t **vmpages,
+                                              struct cl_page **result,
+                                              int nr);
         /**
          * Initialize lock slice for this layer. Called top-to-bottom through
          * every object layer when a new cl_lock is instantiated. Layer
@@ -674,6 +687,11 @@ enum cl_page_type {
         CPT_TRANSIENT,
 };
 
+/**
+ * Maximal number of pages cl_page_gang_find() creates in one call.
+ */
+#define CL_PAGE_GANG_MAX (16)
+
 /**
  * Flags maintained for every cl_page.
  */
@@ -2671,6 +2689,15 @@ struct cl_page *cl_page_find_sub    (const struct lu_env *env,
                                      struct cl_object *obj,
                                      pgoff_t idx, struct page *vmpage,
                                      struct cl_page *parent);
+void            cl_page_gang_find   (const struct lu_env *env,
+                                     struct cl_object *obj,
+                                     pgoff_t idx, struct page **vmpages,
+                                     int nr, struct cl_page **pages);
+void            cl_page_gang_find_sub(const struct lu_env *env,
+                                      struct cl_object *obj,
+                                      pgoff_t idx, struct page **vmpages,
+                                      int nr, struct cl_page **parents,
+                                      struct cl_page **pages);
 void            cl_page_get         (struct cl_page *page);
 void            cl_page_put         (const struct lu_env *env,
                                      struct cl_page *page);
@@ -71,11 +71,22 @@ struct lprocfs_static_vars {
         struct lprocfs_vars *obd_vars;
 };
 
-/* if we find more consumers this could be generalized */
 #define OBD_HIST_MAX 32
+/*
+ * A histogram of OBD_HIST_MAX buckets, usually log2 of the tallied value.
+ *
+ * By default the buckets are shared and updated under oh_lock.  Histograms
+ * updated on every RPC or I/O should be set up with lprocfs_oh_init_percpu()
+ * instead: each CPU then counts into its own cache-line aligned buckets,
+ * allocated the first time that CPU tallies, and the buckets are only summed
+ * up when the histogram is read.  Read a bucket with lprocfs_oh_counter()
+ * rather than from oh_buckets in that case.
+ */
 struct obd_histogram {
-        cfs_spinlock_t oh_lock;
-        unsigned long  oh_buckets[OBD_HIST_MAX];
+        cfs_spinlock_t   oh_lock;
+        unsigned long    oh_buckets[OBD_HIST_MAX];
+        /** per-CPU buckets, indexed by CPU id, NULL if shared */
+        unsigned long  **oh_percpu;
 };
 
 enum {
@@ -104,8 +115,7 @@ struct brw_stats {
 /* An lprocfs counter can be configured using the enum bit masks below.
  *
  * LPROCFS_CNTR_EXTERNALLOCK indicates that an external lock already
- * protects this counter from concurrent updates. If not specified,
- * lprocfs an internal per-counter lock variable. External locks are
+ * protects this counter from concurrent updates. External locks are
  * not used to protect counter increments, but are used to protect
  * counter readout and resets.
  *
@@ -134,24 +144,25 @@ enum {
         LPROCFS_TYPE_CYCLE        = 0x0800,
 };
 
-struct lprocfs_atomic {
-        cfs_atomic_t               la_entry;
-        cfs_atomic_t               la_exit;
-};
-
 #define LC_MIN_INIT ((~(__u64)0) >> 1)
 
-struct lprocfs_counter {
-        struct lprocfs_atomic  lc_cntl;  /* may need to move to per set */
+/* Read-mostly description of a counter, shared by all CPUs */
+struct lprocfs_counter_header {
         unsigned int           lc_config;
+        const char            *lc_name;   /* must be static */
+        const char            *lc_units;  /* must be static */
+};
+
+/* Per-CPU part of a counter.  It is only ever written by its own CPU, with
+ * plain stores, and summed up by lprocfs_stats_collect() when read, so a
+ * reader may see a sample half-applied; that is fine for statistics. */
+struct lprocfs_counter {
         __s64                  lc_count;
         __s64                  lc_sum;
         __s64                  lc_sum_irq;
         __s64                  lc_min;
         __s64                  lc_max;
         __s64                  lc_sumsquare;
-        const char            *lc_name;   /* must be static */
-        const char            *lc_units;  /* must be static */
 };
 
 struct lprocfs_percpu {
@@ -182,6 +193,8 @@ struct lprocfs_stats {
         int                    ls_flags; /* See LPROCFS_STATS_FLAG_* */
         cfs_spinlock_t         ls_lock;  /* Lock used only when there are
                                           * no percpu stats areas */
+        /* ls_num counter descriptions */
+        struct lprocfs_counter_header *ls_cnt_header;
         struct lprocfs_percpu *ls_percpu[0];
 };
 
@@ -387,8 +400,9 @@ static inline void lprocfs_stats_unlock(struct lprocfs_stats *stats, int opc)
 /* Two optimized LPROCFS counter increment functions are provided:
  *     lprocfs_counter_incr(cntr, value) - optimized for by-one counters
  *     lprocfs_counter_add(cntr) - use for multi-valued counters
- * Counter data layout allows config flag, counter lock and the
- * count itself to reside within a single cache line.
+ * Unless the stats are LPROCFS_STATS_FLAG_NOPERCPU, an update takes no lock
+ * and does no atomic operation: it only writes the per-CPU area of the
+ * current CPU, which does not share a cache line with any other CPU.
  */
 
 extern void lprocfs_counter_add(struct lprocfs_stats *stats, int idx,
@@ -402,18 +416,22 @@ extern void lprocfs_counter_sub(struct lprocfs_stats *stats, int idx,
         lprocfs_counter_sub(stats, idx, 1)
 
 extern __s64 lprocfs_read_helper(struct lprocfs_counter *lc,
+                                 struct lprocfs_counter_header *header,
                                  enum lprocfs_fields_flags field);
 static inline __u64 lprocfs_stats_collector(struct lprocfs_stats *stats,
                                             int idx,
                                             enum lprocfs_fields_flags field)
 {
         __u64 ret = 0;
+        int num_cpu;
         int i;
 
         LASSERT(stats != NULL);
-        for (i = 0; i < cfs_num_possible_cpus(); i++)
+        num_cpu = stats->ls_flags & LPROCFS_STATS_FLAG_NOPERCPU ?
+                  1 : cfs_num_possible_cpus();
+        for (i = 0; i < num_cpu; i++)
                 ret += lprocfs_read_helper(&(stats->ls_percpu[i]->lp_cntr[idx]),
-                                           field);
+                                           &stats->ls_cnt_header[idx], field);
         return ret;
 }
 
@@ -458,6 +476,14 @@ lprocfs_nid_stats_clear_write(struct file *file, const char *buffer,
 extern int lprocfs_nid_stats_clear_read(char *page, char **start, off_t off,
                                         int count, int *eof,  void *data);
 
+/* lprocfs_jobstats.c */
+typedef void (*cntr_init_callback)(struct lprocfs_stats *stats);
+extern int lprocfs_job_stats_init(struct obd_device *obd, int cntr_num,
+                                  cntr_init_callback init_fn);
+extern void lprocfs_job_stats_fini(struct obd_device *obd);
+extern void lprocfs_job_stats_log(struct obd_device *obd, char *jobid,
+                                  int event, long amount);
+
 extern int lprocfs_register_stats(cfs_proc_dir_entry_t *root, const char *name,
                                   struct lprocfs_stats *stats);
 
@@ -561,9 +587,12 @@ extern int lprocfs_write_u64_helper(const char *buffer, unsigned long count,
 extern int lprocfs_write_frac_u64_helper(const char *buffer,
                                          unsigned long count,
                                          __u64 *val, int mult);
+int lprocfs_oh_init_percpu(struct obd_histogram *oh);
+void lprocfs_oh_fini(struct obd_histogram *oh);
 void lprocfs_oh_tally(struct obd_histogram *oh, unsigned int value);
 void lprocfs_oh_tally_log2(struct obd_histogram *oh, unsigned int value);
 void lprocfs_oh_clear(struct obd_histogram *oh);
+unsigned long lprocfs_oh_counter(struct obd_histogram *oh, unsigned int idx);
 unsigned long lprocfs_oh_sum(struct obd_histogram *oh);
 
 void lprocfs_stats_collect(struct lprocfs_stats *stats, int idx,
@@ -624,6 +653,7 @@ struct file_operations name##_fops = {                                     \
 /* lproc_ptlrpc.c */
 struct ptlrpc_request;
 extern void target_print_req(void *seq_file, struct ptlrpc_request *req);
+extern void ptlrpc_lprocfs_job_cntr_init(struct lprocfs_stats *stats);
 
 /* lproc_status.c */
 int lprocfs_obd_rd_recovery_time_soft(char *page, char **start, off_t off,
@@ -785,6 +815,19 @@ int lprocfs_nid_stats_clear_read(char *page, char **start, off_t off,
                                  int count, int *eof,  void *data)
 {return count;}
 
+typedef void (*cntr_init_callback)(struct lprocfs_stats *stats);
+static inline
+int lprocfs_job_stats_init(struct obd_device *obd, int cntr_num,
+                           cntr_init_callback init_fn)
+{ return 0; }
+static inline
+void lprocfs_job_stats_fini(struct obd_device *obd)
+{ return; }
+static inline
+void lprocfs_job_stats_log(struct obd_device *obd, char *jobid,
+                           int event, long amount)
+{ return; }
+
 static inline cfs_proc_dir_entry_t *
 lprocfs_register(const char *name, cfs_proc_dir_entry_t *parent,
                  struct lprocfs_vars *list, void *data)
@@ -886,6 +929,12 @@ int lprocfs_rd_filegroups(char *page, char **start, off_t off,
                           int count, int *eof, void *data)
 { return 0; }
 static inline
+int lprocfs_oh_init_percpu(struct obd_histogram *oh)
+{ return 0; }
+static inline
+void lprocfs_oh_fini(struct obd_histogram *oh)
+{ return; }
+static inline
 void lprocfs_oh_tally(struct obd_histogram *oh, unsigned int value)
 { return; }
 static inline
@@ -895,6 +944,9 @@ static inline
 void lprocfs_oh_clear(struct obd_histogram *oh)
 { return; }
 static inline
+unsigned long lprocfs_oh_counter(struct obd_histogram *oh, unsigned int idx)
+{ return 0; }
+static inline
 unsigned long lprocfs_oh_sum(struct obd_histogram *oh)
 { return 0; }
 static inline
@@ -911,6 +963,7 @@ __u64 lprocfs_stats_collector(struct lprocfs_stats *stats, int idx,
 
 /* lproc_ptlrpc.c */
 #define target_print_req NULL
+#define ptlrpc_lprocfs_job_cntr_init NULL
 
 #endif /* LPROCFS */
 
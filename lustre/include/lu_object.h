@@ -47,6 +47,7 @@
 #include <lustre/lustre_idl.h>
 
 #include <lu_ref.h>
+#include <lustre_handles.h> /* for cfs_rcu_head_t */
 
 struct seq_file;
 struct proc_dir_entry;
@@ -487,7 +488,14 @@ enum lu_object_header_flags {
          * as last reference to it is released. This flag cannot be cleared
          * once set.
          */
-        LU_OBJECT_HEARD_BANSHEE = 0
+        LU_OBJECT_HEARD_BANSHEE = 0,
+        /**
+         * Object was found in the cache since lu_site_purge() last looked at
+         * it. Instead of moving the object to the hot end of the LRU on each
+         * access, lu_site_purge() clears the flag and gives the object
+         * another pass through the LRU.
+         */
+        LU_OBJECT_REFERENCED    = 1
 };
 
 enum lu_object_header_attr {
@@ -547,6 +555,12 @@ struct lu_object_header {
          * A list of references to this object, for debugging.
          */
         struct lu_ref          loh_reference;
+        /**
+         * Site hash lookups are lockless, the top-level
+         * lu_object_operations::loo_object_free() releases the memory of
+         * the header with my_call_rcu() on this.
+         */
+        cfs_rcu_head_t         loh_rcu;
 };
 
 struct fld;
@@ -557,12 +571,13 @@ struct lu_site_bkt_data {
          */
         long                      lsb_busy;
         /**
-         * LRU list, updated on each access to object. Protected by
-         * bucket lock of lu_site::ls_obj_hash.
+         * LRU list of objects in this bucket. Protected by bucket lock of
+         * lu_site::ls_obj_hash.
          *
-         * "Cold" end of LRU is lu_site::ls_lru.next. Accessed object are
-         * moved to the lu_site::ls_lru.prev (this is due to the non-existence
-         * of list_for_each_entry_safe_reverse()).
+         * "Cold" end of LRU is lsb_lru.next. New objects are added to
+         * lsb_lru.prev, accessed objects are only marked with
+         * LU_OBJECT_REFERENCED, and moved to lsb_lru.prev by lu_site_purge()
+         * when it finds the flag set.
          */
         cfs_list_t                lsb_lru;
         /**
@@ -605,6 +620,11 @@ struct lu_site {
          * index of bucket on hash table while purging
          */
         int                       ls_purge_start;
+        /**
+         * Purges objects from buckets holding more than their share of
+         * lu_cache_nr, scheduled by lu_object_find().
+         */
+        cfs_workitem_t            ls_purge_wi;
         /**
          * Top-level device for this stack.
          */
@@ -960,6 +980,11 @@ struct lu_context {
          * Debugging cookie.
          */
         unsigned               lc_cookie;
+        /**
+         * Bitmap of lc_value[] slots used since lu_context_enter(), only
+         * maintained for LCT_LAZY contexts.
+         */
+        __u32                  lc_valid;
 };
 
 /**
@@ -989,6 +1014,14 @@ enum lu_context_tag {
          */
         LCT_SESSION   = 1 << 4,
 
+        /**
+         * Key values are created by the first lu_context_key_get() rather
+         * than by lu_context_init(). They are kept over lu_context_exit(),
+         * and reset on their first use after the next lu_context_enter(), so
+         * that a context can be reused, e.g. for the sessions of all
+         * requests handled by a service thread.
+         */
+        LCT_LAZY      = 1 << 27,
         /**
          * Set when at least one of keys, having values in this context has
          * non-NULL lu_context_key::lct_exit() method. This is used to
@@ -1075,6 +1108,13 @@ struct lu_context_key {
          */
         void   (*lct_exit)(const struct lu_context *ctx,
                            struct lu_context_key *key, void *data);
+        /**
+         * Size of a value, optional. If set, a value created by
+         * lu_context_key::lct_init() is all zeroes, and values of LCT_LAZY
+         * contexts are reset by zeroing them. Otherwise they are destroyed
+         * and created again.
+         */
+        size_t   lct_size;
         /**
          * Internal implementation detail: index within lu_context::lc_value[]
          * reserved for this key.
@@ -790,6 +790,8 @@ struct ldlm_resource {
         struct lu_ref          lr_reference;
 
         struct inode          *lr_lvb_inode;
+        /* freed after a grace period, ns_rs_hash lookups are lockless */
+        cfs_rcu_head_t         lr_rcu;
 };
 
 static inline char *
@@ -89,6 +89,8 @@
 #define PTLRPC_MAX_BRW_BITS     LNET_MTU_BITS
 #define PTLRPC_MAX_BRW_SIZE     (1<<LNET_MTU_BITS)
 #define PTLRPC_MAX_BRW_PAGES    (PTLRPC_MAX_BRW_SIZE >> CFS_PAGE_SHIFT)
+/* most objects one OBD_CONNECT_MULTIOBJ write may carry */
+#define PTLRPC_MAX_BRW_OBJS     16
 
 /* When PAGE_SIZE is a constant, we can check our arithmetic here with cpp! */
 #ifdef __KERNEL__
@@ -191,6 +193,8 @@
 /** Absolute OSS limits */
 #define OSS_THREADS_MIN 3       /* difficult replies, HPQ, others */
 #define OSS_THREADS_MAX 512
+/** OST write commit threads, their t_id follow those of the OSS threads */
+#define OSS_COMMIT_THREADS_MAX 64
 #define OST_NBUFS       (64 * cfs_num_online_cpus())
 #define OST_BUFSIZE     (8 * 1024)
 
@@ -451,6 +455,152 @@ struct ptlrpc_hpreq_ops {
         int  (*hpreq_check)(struct ptlrpc_request *);
 };
 
+/**
+ * \defgroup nrs Network Request Scheduler
+ * The normal priority queue of every ptlrpc service part is managed by one
+ * of a few pluggable policies, selected per service through the
+ * "nrs_policy" proc file.  High priority requests bypass the policies.
+ * @{
+ */
+
+/** NRS policies, ptlrpc_nrs_pol_desc::pd_id */
+enum ptlrpc_nrs_pol_id {
+        /** first come, first served */
+        PTLRPC_NRS_FIFO = 0,
+        /** round-robin over the clients (NIDs) */
+        PTLRPC_NRS_CRR,
+        /** round-robin over the objects of bulk I/O, offset ordered */
+        PTLRPC_NRS_ORR,
+        PTLRPC_NRS_POL_MAX
+};
+
+struct ptlrpc_nrs;
+
+/**
+ * NRS policy operations.  All but pop_init() and pop_fini() are called
+ * holding ptlrpc_service_part::scp_rq_lock.
+ */
+struct ptlrpc_nrs_pol_ops {
+        /** allocate policy state for a part bound to CPU partition \a cpt */
+        void *(*pop_init)(int cpt);
+        /** free policy state, no requests are queued any more */
+        void  (*pop_fini)(void *priv);
+        /**
+         * queue \a req, linked by ptlrpc_request::rq_list. Must not sleep,
+         * a failure makes the request fall back to a FIFO queue.
+         */
+        int   (*pop_enqueue)(void *priv, struct ptlrpc_request *req);
+        /** next request the policy wants served, it stays queued */
+        struct ptlrpc_request *(*pop_peek)(void *priv);
+        /** unlink \a req, which may be any queued request */
+        void  (*pop_dequeue)(void *priv, struct ptlrpc_request *req);
+};
+
+/** NRS policy description */
+struct ptlrpc_nrs_pol_desc {
+        /** policy name, as shown and set through proc */
+        char                       *pd_name;
+        enum ptlrpc_nrs_pol_id      pd_id;
+        struct ptlrpc_nrs_pol_ops  *pd_ops;
+};
+
+/** per-part, per-policy statistics */
+struct ptlrpc_nrs_pol_stats {
+        /** # of requests queued now */
+        int                         ps_queued;
+        /** the deepest the queue has been */
+        int                         ps_queued_max;
+        /** # of requests handed to service threads */
+        __u64                       ps_handled;
+        /** total time handed out requests waited since arrival, usec */
+        __u64                       ps_wait_sum;
+        /** longest time a request waited, usec */
+        long                        ps_wait_max;
+};
+
+/**
+ * Normal priority request queue of a service part, serialized by
+ * ptlrpc_service_part::scp_rq_lock.
+ */
+struct ptlrpc_nrs {
+        /** active policy */
+        struct ptlrpc_nrs_pol_desc *nrs_policy;
+        /** state of the active policy */
+        void                       *nrs_private;
+        /** requests the policy failed to queue, served after its own */
+        cfs_list_t                  nrs_fallback;
+        /** # of requests queued, including nrs_fallback */
+        int                         nrs_nreqs;
+        struct ptlrpc_nrs_pol_stats nrs_stats[PTLRPC_NRS_POL_MAX];
+};
+
+/** NRS state of a request */
+struct ptlrpc_nrs_request {
+        /** policy private, e.g. the round-robin bucket */
+        void                       *nr_private;
+        /** object the bulk I/O is to and its first offset, for ORR */
+        __u64                       nr_objid;
+        __u64                       nr_objgr;
+        __u64                       nr_offset;
+        /** policy the request is queued to */
+        unsigned int                nr_policy:8,
+                                    /** queued in a struct ptlrpc_nrs */
+                                    nr_enqueued:1,
+                                    /** on ptlrpc_nrs::nrs_fallback */
+                                    nr_fallback:1,
+                                    /** nr_objid etc. are valid */
+                                    nr_has_obj:1;
+};
+
+/** @} nrs */
+
+/**
+ * \defgroup tbf Token Bucket Filter
+ * Rate limits requests of a service before they reach the NRS queue.  Each
+ * rule matches requests by client NID, opcode and job identifier and lets
+ * through at most tr_rate requests per second, with bursts of up to
+ * tr_depth.  Requests over the limit are deferred, not rejected: they stay
+ * on the AT timed list so the clients keep getting early replies.
+ * Rules are managed through the "tbf_rules" proc file of the service.
+ * @{
+ */
+
+#define PTLRPC_TBF_NAME_LEN     16
+/** default burst size of a rule, in requests */
+#define PTLRPC_TBF_DEPTH_DEFAULT 3
+
+struct ptlrpc_tbf_rule {
+        /** link in ptlrpc_service::srv_tbf_rules */
+        cfs_list_t              tr_list;
+        /** the list holds one reference, every deferred request another */
+        cfs_atomic_t            tr_ref;
+        char                    tr_name[PTLRPC_TBF_NAME_LEN];
+        /** NIDs matched, empty to match all */
+        cfs_list_t              tr_nids;
+        /** tr_nids as given by the user */
+        char                   *tr_nids_str;
+        /** opcode matched, -1 to match all */
+        int                     tr_opc;
+        /** job identifier matched, empty to match all */
+        char                    tr_jobid[LUSTRE_JOBID_SIZE];
+        /** requests per second */
+        __u32                   tr_rate;
+        /** burst size */
+        __u32                   tr_depth;
+        /** usec between two requests at tr_rate */
+        __u64                   tr_interval;
+        /** usec, theoretical arrival time of the next conforming request */
+        __u64                   tr_tat;
+        /** # of requests matched */
+        __u64                   tr_hits;
+        /** # of requests deferred */
+        __u64                   tr_deferred;
+        /** # of requests deferred now */
+        int                     tr_queued;
+};
+
+/** @} tbf */
+
 /**
  * Represents remote procedure call.
  *
@@ -479,6 +629,12 @@ struct ptlrpc_request {
         cfs_list_t rq_exp_list;
         /** server-side hp handlers */
         struct ptlrpc_hpreq_ops *rq_ops;
+        /** server-side request scheduler state */
+        struct ptlrpc_nrs_request rq_nrs;
+        /** TBF rule deferring the request, see ptlrpc_tbf_defer() */
+        struct ptlrpc_tbf_rule *rq_tbf_rule;
+        /** usec, when the TBF rule lets the request through */
+        __u64 rq_tbf_release;
         /** history sequence # */
         __u64 rq_history_seq;
         /** the index of service's srv_at_array into which request is linked */
@@ -959,7 +1115,7 @@ enum {
  */
 struct ptlrpc_thread {
         /**
-         * List of active threads in svc->srv_threads
+         * List of active threads in svcpt->scp_threads
          */
         cfs_list_t t_link;
         /**
@@ -983,6 +1139,10 @@ struct ptlrpc_thread {
          * the svc this thread belonged to b=18582
          */
         struct ptlrpc_service *t_svc;
+        /**
+         * the part of t_svc this thread serves
+         */
+        struct ptlrpc_service_part *t_svcpt;
         cfs_waitq_t t_ctl_waitq;
         struct lu_env *t_env;
 };
@@ -1001,6 +1161,8 @@ struct ptlrpc_request_buffer_desc {
         cfs_list_t             rqbd_reqs;
         /** Back pointer to service for which this buffer is registered */
         struct ptlrpc_service *rqbd_service;
+        /** Back pointer to the service part owning this buffer */
+        struct ptlrpc_service_part *rqbd_svcpt;
         /** LNet descriptor */
         lnet_handle_md_t       rqbd_md_h;
         int                    rqbd_refcount;
@@ -1031,17 +1193,141 @@ typedef void (*svc_req_printfn_t)(void *, struct ptlrpc_request *);
  */
 #define PTLRPC_SVC_HP_RATIO 10
 
+/**
+ * CPU partition modes of a ptlrpc service, see ptlrpc_service_conf
+ */
+enum {
+        /** one set of request buffers, queues and threads (default) */
+        PTLRPC_SVC_CPT_NONE     = 0,
+        /**
+         * one set of request buffers, queues and threads per libcfs CPU
+         * partition; threads are bound to the CPUs of their partition
+         */
+        PTLRPC_SVC_CPT_PART     = 1,
+};
+
+/**
+ * Minimum number of service threads per partition: with a high priority
+ * handler, ptlrpc_server_allow_normal() keeps threads in reserve for high
+ * priority requests, and normal requests starve with fewer than three.
+ */
+#define PTLRPC_NTHRS_PART_MIN   3
+
+struct ptlrpc_service;
+
+/**
+ * Per CPU partition part of a PortalRPC service.
+ *
+ * Everything touched on the per-request path lives here: request buffers,
+ * the incoming and processing queues and the threads serving them.  Each
+ * part is allocated on the NUMA node of its CPU partition and its threads
+ * only ever take the locks of their own part.  A service which is not
+ * partitioned has exactly one part.
+ *
+ * A part has two locks:
+ * \a scp_lock
+ *    serialize operations on rqbd, request history, incoming requests
+ *    waiting for preprocess and the thread list
+ * \a scp_rq_lock
+ *    serialize operations on requests queued for and being handled by
+ *    service threads
+ */
+struct ptlrpc_service_part {
+        /** back reference to the owning service */
+        struct ptlrpc_service          *scp_service;
+        /** CPU partition, CFS_CPT_ANY if the service isn't partitioned */
+        int                             scp_cpt;
+        /** index in ptlrpc_service::srv_parts */
+        int                             scp_index;
+        /** per-partition counters, see PTLRPC_PART_* */
+        struct lprocfs_stats           *scp_stats;
+
+        cfs_spinlock_t                  scp_lock  __cfs_cacheline_aligned;
+        /** service thread list */
+        cfs_list_t                      scp_threads;
+        /** # of starting threads */
+        int                             scp_threads_starting;
+        /** # running threads */
+        int                             scp_threads_running;
+        /** incoming reqs */
+        cfs_list_t                      scp_req_in_queue;
+        /** total # req buffer descs allocated */
+        int                             scp_nbufs;
+        /** # posted request buffers */
+        int                             scp_nrqbd_receiving;
+        /** timeout before re-posting reqs, in tick */
+        cfs_duration_t                  scp_rqbd_timeout;
+        /** request buffers to be reposted */
+        cfs_list_t                      scp_idle_rqbds;
+        /** req buffers receiving */
+        cfs_list_t                      scp_active_rqbds;
+        /** request buffer history */
+        cfs_list_t                      scp_history_rqbds;
+        /** # request buffers in history */
+        int                             scp_n_history_rqbds;
+        /** request history */
+        cfs_list_t                      scp_request_history;
+        /**
+         * next request sequence #; the low ptlrpc_service::srv_cpt_bits
+         * bits of every sequence # are the part index
+         */
+        __u64                           scp_request_seq;
+        /** highest seq culled from history */
+        __u64                           scp_request_max_cull_seq;
+        /** # of times scp_lock was found contended */
+        unsigned long                   scp_lock_contended;
+        /**
+         * threads of this part sleep on this. This wait-queue is signalled
+         * when new incoming request arrives and when difficult reply has to
+         * be handled.
+         */
+        cfs_waitq_t                     scp_waitq;
+
+        cfs_spinlock_t                  scp_rq_lock __cfs_cacheline_aligned;
+        /** reqs waiting for service, scheduled by a NRS policy */
+        struct ptlrpc_nrs               scp_nrs;
+        /** high priority queue */
+        cfs_list_t                      scp_request_hpq;
+        /** # incoming reqs */
+        int                             scp_n_queued_reqs;
+        /** # reqs being served */
+        int                             scp_n_active_reqs;
+        /** # HPreqs being served */
+        int                             scp_n_active_hpreq;
+        /** # hp requests handled */
+        int                             scp_hpreq_count;
+        /** reqs deferred by TBF rules, in release order */
+        cfs_list_t                      scp_tbf_deferred;
+        /** set by scp_tbf_timer when the head of scp_tbf_deferred is due */
+        int                             scp_tbf_check;
+        cfs_timer_t                     scp_tbf_timer;
+        /** # of times scp_rq_lock was found contended */
+        unsigned long                   scp_rq_lock_contended;
+};
+
+/**
+ * per-partition counters, ptlrpc_service_part::scp_stats
+ */
+enum {
+        PTLRPC_PART_REQ_IN_CNTR = 0,
+        PTLRPC_PART_REQ_HANDLED_CNTR,
+        PTLRPC_PART_REQWAIT_CNTR,
+        PTLRPC_PART_REQQDEPTH_CNTR,
+        PTLRPC_PART_LAST_CNTR
+};
+
 /**
  * Definition of PortalRPC service.
  * The service is listening on a particular portal (like tcp port)
  * and perform actions for a specific server like IO service for OST
  * or general metadata service for MDS.
  *
- * ptlrpc service has four locks:
+ * Request buffers, request queues and service threads are kept in one or
+ * more ptlrpc_service_part, see there for the locks protecting them.
+ *
+ * ptlrpc service itself has three locks:
  * \a srv_lock
- *    serialize operations on rqbd and requests waiting for preprocess
- * \a srv_rq_lock
- *    serialize operations active requests sent to this portal
+ *    serialize changes of service-wide tunables and thread ids
  * \a srv_at_lock
  *    serialize adaptive timeout stuff
  * \a srv_rs_lock
@@ -1058,18 +1344,12 @@ struct ptlrpc_service {
         char                           *srv_name;
         /** only statically allocated strings here; we don't clean them */
         char                           *srv_thread_name;
-        /** service thread list */
-        cfs_list_t                      srv_threads;
         /** threads to start at beginning of service */
         int                             srv_threads_min;
         /** thread upper limit */
         int                             srv_threads_max;
         /** always increasing number */
         unsigned                        srv_threads_next_id;
-        /** # of starting threads */
-        int                             srv_threads_starting;
-        /** # running threads */
-        int                             srv_threads_running;
 
         /** service operations, move to ptlrpc_svc_ops_t in the future */
         /** @{ */
@@ -1120,60 +1400,19 @@ struct ptlrpc_service {
         unsigned                        srv_cpu_affinity:1;
         /** under unregister_service */
         unsigned                        srv_is_stopping:1;
-
-        /**
-         * serialize the following fields, used for protecting
-         * rqbd list and incoming requests waiting for preprocess
-         */
-        cfs_spinlock_t                  srv_lock  __cfs_cacheline_aligned;
-        /** incoming reqs */
-        cfs_list_t                      srv_req_in_queue;
-        /** total # req buffer descs allocated */
-        int                             srv_nbufs;
-        /** # posted request buffers */
-        int                             srv_nrqbd_receiving;
-        /** timeout before re-posting reqs, in tick */
-        cfs_duration_t                  srv_rqbd_timeout;
-        /** request buffers to be reposted */
-        cfs_list_t                      srv_idle_rqbds;
-        /** req buffers receiving */
-        cfs_list_t                      srv_active_rqbds;
-        /** request buffer history */
-        cfs_list_t                      srv_history_rqbds;
-        /** # request buffers in history */
-        int                             srv_n_history_rqbds;
-        /** max # request buffers in history */
+        /** PTLRPC_SVC_CPT_* */
+        int                             srv_cpt_mode;
+        /** # of parts in srv_parts */
+        int                             srv_nparts;
+        /** # of low bits of a request sequence # holding the part index */
+        int                             srv_cpt_bits;
+        /** per CPU partition parts, srv_nparts of them */
+        struct ptlrpc_service_part    **srv_parts;
+
+        /** serialize the following fields */
+        cfs_spinlock_t                  srv_lock;
+        /** max # request buffers in history, shared between all parts */
         int                             srv_max_history_rqbds;
-        /** request history */
-        cfs_list_t                      srv_request_history;
-        /** next request sequence # */
-        __u64                           srv_request_seq;
-        /** highest seq culled from history */
-        __u64                           srv_request_max_cull_seq;
-        /**
-         * all threads sleep on this. This wait-queue is signalled when new
-         * incoming request arrives and when difficult reply has to be handled.
-         */
-        cfs_waitq_t                     srv_waitq;
-
-        /**
-         * serialize the following fields, used for processing requests
-         * sent to this portal
-         */
-        cfs_spinlock_t                  srv_rq_lock __cfs_cacheline_aligned;
-        /** # reqs in either of the queues below */
-        /** reqs waiting for service */
-        cfs_list_t                      srv_request_queue;
-        /** high priority queue */
-        cfs_list_t                      srv_request_hpq;
-        /** # incoming reqs */
-        int                             srv_n_queued_reqs;
-        /** # reqs being served */
-        int                             srv_n_active_reqs;
-        /** # HPreqs being served */
-        int                             srv_n_active_hpreq;
-        /** # hp requests handled */
-        int                             srv_hpreq_count;
 
         /** AT stuff */
         /** @{ */
@@ -1194,6 +1433,11 @@ struct ptlrpc_service {
         cfs_time_t                      srv_at_checktime;
         /** @} */
 
+        /** serialize TBF rules and their token buckets */
+        cfs_spinlock_t                  srv_tbf_lock __cfs_cacheline_aligned;
+        /** TBF rules, the first one matching a request applies */
+        cfs_list_t                      srv_tbf_rules;
+
         /**
          * serialize the following fields, used for processing
          * replies for this portal
@@ -1214,6 +1458,12 @@ struct ptlrpc_service {
         //struct ptlrpc_srv_ni srv_interfaces[0];
 };
 
+/** iterate over all parts of service \a svc */
+#define ptlrpc_service_for_each_part(part, i, svc)                      \
+        for (i = 0;                                                     \
+             i < (svc)->srv_nparts && ((part) = (svc)->srv_parts[i]);   \
+             i++)
+
 /**
  * Declaration of ptlrpcd control structure
  */
@@ -1246,6 +1496,27 @@ struct ptlrpcd_ctl {
          * Environment for request interpreters to run in.
          */
         struct lu_env               pc_env;
+        /**
+         * CPU partition the thread is bound to, if LIOD_BIND is set.
+         */
+        int                         pc_cpt;
+        /**
+         * Threads of the same pool and partition this thread may steal new
+         * requests from (itself included), NULL for a standalone thread.
+         */
+        struct ptlrpcd_ctl         *pc_partners;
+        int                         pc_npartners;
+        /**
+         * Partner to try first on the next steal.
+         */
+        int                         pc_cursor;
+        /**
+         * Requests queued to this thread, stolen by it from its partners,
+         * and completed by it.  Only for /proc/fs/lustre/ptlrpcd.
+         */
+        unsigned long               pc_nr_queued;
+        unsigned long               pc_nr_stolen;
+        unsigned long               pc_nr_completed;
 #ifndef __KERNEL__
         /**
          * Async rpcs flag to make sure that ptlrpcd_check() is called only
@@ -1286,7 +1557,11 @@ enum ptlrpcd_ctl_flags {
         /**
          * This is a recovery ptlrpc thread.
          */
-        LIOD_RECOVERY    = 1 << 3
+        LIOD_RECOVERY    = 1 << 3,
+        /**
+         * Bind the thread to CPU partition pc_cpt.
+         */
+        LIOD_BIND        = 1 << 4
 };
 
 /* ptlrpc/events.c */
@@ -1466,6 +1741,8 @@ struct ptlrpc_service_conf {
         int psc_min_threads;
         int psc_max_threads;
         __u32 psc_ctx_tags;
+        /** PTLRPC_SVC_CPT_* */
+        int psc_cpt_mode;
 };
 
 /* ptlrpc/service.c */
@@ -1495,11 +1772,11 @@ struct ptlrpc_service *ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size,
                                        svc_req_printfn_t,
                                        int min_threads, int max_threads,
                                        char *threadname, __u32 ctx_tags,
-                                       svc_hpreq_handler_t);
+                                       svc_hpreq_handler_t, int cpt_mode);
 void ptlrpc_stop_all_threads(struct ptlrpc_service *svc);
 
 int ptlrpc_start_threads(struct ptlrpc_service *svc);
-int ptlrpc_start_thread(struct ptlrpc_service *svc);
+int ptlrpc_start_thread(struct ptlrpc_service_part *svcpt);
 int ptlrpc_unregister_service(struct ptlrpc_service *service);
 int liblustre_check_services (void *arg);
 void ptlrpc_daemonize(char *name);
@@ -1520,6 +1797,7 @@ void ptlrpc_hr_fini(void);
 struct ptlrpc_svc_data {
         char *name;
         struct ptlrpc_service *svc;
+        struct ptlrpc_service_part *svcpt;
         struct ptlrpc_thread *thread;
 };
 /** @} */
@@ -1605,6 +1883,7 @@ int lustre_msg_is_v1(struct lustre_msg *msg);
 __u32 lustre_msg_get_magic(struct lustre_msg *msg);
 __u32 lustre_msg_get_timeout(struct lustre_msg *msg);
 __u32 lustre_msg_get_service_time(struct lustre_msg *msg);
+char *lustre_msg_get_jobid(struct lustre_msg *msg);
 __u32 lustre_msg_get_cksum(struct lustre_msg *msg);
 #if LUSTRE_VERSION_CODE < OBD_OCD_VERSION(2, 9, 0, 0)
 __u32 lustre_msg_calc_cksum(struct lustre_msg *msg, int compat18);
@@ -1615,6 +1894,7 @@ __u32 lustre_msg_calc_cksum(struct lustre_msg *msg);
 void lustre_msg_set_handle(struct lustre_msg *msg,struct lustre_handle *handle);
 void lustre_msg_set_type(struct lustre_msg *msg, __u32 type);
 void lustre_msg_set_opc(struct lustre_msg *msg, __u32 opc);
+void lustre_msg_set_jobid(struct lustre_msg *msg, char *jobid);
 void lustre_msg_set_last_xid(struct lustre_msg *msg, __u64 last_xid);
 void lustre_msg_set_last_committed(struct lustre_msg *msg,__u64 last_committed);
 void lustre_msg_set_versions(struct lustre_msg *msg, __u64 *versions);
@@ -1842,6 +2122,9 @@ int ptlrpc_check_and_wait_suspend(struct ptlrpc_request *req);
  * these threads are used to asynchronously send requests queued with
  * ptlrpcd_add_req(req, PCSOPE_FOO), and to handle completion call-backs for
  * such requests. Multiple scopes are needed to avoid dead-locks.
+ *
+ * PSCOPE_BRW has a pool of ptlrpcd-brw_NN threads in place of the single
+ * normal thread, spread over the CPU partitions, see ptlrpcd.c.
  */
 enum ptlrpcd_scope {
         /** Scope of bulk read-write rpcs. */
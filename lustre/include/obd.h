@@ -75,6 +75,8 @@ struct loi_oap_pages {
         cfs_list_t              lop_pending;
         cfs_list_t              lop_urgent;
         cfs_list_t              lop_pending_group;
+        /* dirty extents of the object, write queue only (struct osc_extent) */
+        cfs_list_t              lop_extents;
         int                     lop_num_pending;
 };
 
@@ -101,6 +103,9 @@ struct lov_oinfo {                 /* per-stripe data structure */
         __u64 loi_kms;             /* known minimum size */
         struct ost_lvb loi_lvb;
         struct osc_async_rc     loi_ar;
+        /* pages queued in the current unit of extent mode, see
+         * client_obd::cl_extent_pages */
+        int                     loi_extent_queued;
 };
 #define loi_id  loi_oi.oi_id
 #define loi_seq loi_oi.oi_seq
@@ -116,9 +121,11 @@ static inline void loi_init(struct lov_oinfo *loi)
         CFS_INIT_LIST_HEAD(&loi->loi_read_lop.lop_pending);
         CFS_INIT_LIST_HEAD(&loi->loi_read_lop.lop_urgent);
         CFS_INIT_LIST_HEAD(&loi->loi_read_lop.lop_pending_group);
+        CFS_INIT_LIST_HEAD(&loi->loi_read_lop.lop_extents);
         CFS_INIT_LIST_HEAD(&loi->loi_write_lop.lop_pending);
         CFS_INIT_LIST_HEAD(&loi->loi_write_lop.lop_urgent);
         CFS_INIT_LIST_HEAD(&loi->loi_write_lop.lop_pending_group);
+        CFS_INIT_LIST_HEAD(&loi->loi_write_lop.lop_extents);
         CFS_INIT_LIST_HEAD(&loi->loi_ready_item);
         CFS_INIT_LIST_HEAD(&loi->loi_hp_ready_item);
         CFS_INIT_LIST_HEAD(&loi->loi_write_item);
@@ -225,6 +232,23 @@ struct brw_page {
 
 struct ost_server_data;
 
+/* per-job RPC statistics of a target, see lprocfs_jobstats.c */
+struct obd_job_stats {
+        /** jobid -> struct job_stat */
+        cfs_hash_t             *ojs_hash;
+        /** all job_stat, walked by the job_stats proc file */
+        cfs_list_t              ojs_list;
+        /** protects ojs_list */
+        cfs_rwlock_t            ojs_lock;
+        /** # of counters in each job_stat */
+        int                     ojs_cntr_num;
+        /** names the counters of a new job_stat */
+        void                  (*ojs_cntr_init_fn)(struct lprocfs_stats *stats);
+        /** seconds a job may stay idle before its stats are dropped */
+        unsigned int            ojs_cleanup_interval;
+        time_t                  ojs_last_cleanup;
+};
+
 #define OBT_MAGIC       0xBDDECEAE
 /* hold common fields for "target" device */
 struct obd_device_target {
@@ -447,12 +471,21 @@ struct client_obd {
         int                      cl_pending_r_pages;
         int                      cl_max_pages_per_rpc;
         int                      cl_max_rpcs_in_flight;
+        /* extent mode: pages streamed into an object are queued for write in
+         * units of this many pages, 0 queues every page on its own.  Set per
+         * mount through llite.*.extent_kb, see KEY_EXTENT_KB */
+        int                      cl_extent_pages;
+        /* time spent queueing write pages, for rpc_stats */
+        __u64                    cl_w_queue_nsec;
+        __u64                    cl_w_queue_pages;
         struct obd_histogram     cl_read_rpc_hist;
         struct obd_histogram     cl_write_rpc_hist;
         struct obd_histogram     cl_read_page_hist;
         struct obd_histogram     cl_write_page_hist;
         struct obd_histogram     cl_read_offset_hist;
         struct obd_histogram     cl_write_offset_hist;
+        /* objects per write RPC, see OBD_CONNECT_MULTIOBJ */
+        struct obd_histogram     cl_write_obj_hist;
 
         /* number of in flight destroy rpcs is limited to max_rpcs_in_flight */
         cfs_atomic_t             cl_destroy_in_flight;
@@ -1020,6 +1053,8 @@ struct obd_device {
         /* nid stats body */
         cfs_hash_t             *obd_nid_stats_hash;
         cfs_list_t              obd_nid_stats;
+        /* job stats body */
+        struct obd_job_stats    obd_jobstats;
         cfs_atomic_t            obd_refcount;
         cfs_waitq_t             obd_refcount_waitq;
         cfs_list_t              obd_exports;
@@ -1137,6 +1172,7 @@ enum obd_cleanup_stage {
 #define KEY_CLEAR_FS            "clear_fs"
 #define KEY_CONN_DATA           "conn_data"
 #define KEY_EVICT_BY_NID        "evict_by_nid"
+#define KEY_EXTENT_KB           "extent_kb"
 #define KEY_FIEMAP              "fiemap"
 #define KEY_FLUSH_CTX           "flush_ctx"
 #define KEY_GRANT_SHRINK        "grant_shrink"
@@ -53,38 +53,22 @@
  * Checksums
  */
 
+/* obdclass/obd_cksum.c */
+__u32 obd_crc32_le(__u32 crc, unsigned char const *p, size_t len);
+__u32 obd_crc32c(__u32 crc, unsigned char const *p, size_t len);
+cksum_type_t obd_cksum_type_select(__u32 cksum_types);
+int obd_cksum_init(void);
+
 #ifndef HAVE_ARCH_CRC32
-/* crc32_le lifted from the Linux kernel, which had the following to say:
- *
- * This code is in the public domain; copyright abandoned.
- * Liability for non-performance of this code is limited to the amount
- * you paid for it.  Since it is distributed for free, your refund will
- * be very very small.  If it breaks, you get to keep both pieces.
- */
-#define CRCPOLY_LE 0xedb88320
-/**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * \param crc  seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *             other uses, or the previous crc32 value if computing incrementally.
- * \param p  - pointer to buffer over which CRC is run
- * \param len- length of buffer \a p
- */
-static inline __u32 crc32_le(__u32 crc, unsigned char const *p, size_t len)
-{
-        int i;
-        while (len--) {
-                crc ^= *p++;
-                for (i = 0; i < 8; i++)
-                        crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-        }
-        return crc;
-}
+/* table driven replacement for the kernel's crc32_le() */
+#define crc32_le(crc, p, len) obd_crc32_le(crc, p, len)
 #endif
 
 static inline __u32 init_checksum(cksum_type_t cksum_type)
 {
         switch(cksum_type) {
         case OBD_CKSUM_CRC32:
+        case OBD_CKSUM_CRC32C:
                 return ~0U;
 #ifdef HAVE_ADLER
         case OBD_CKSUM_ADLER:
@@ -103,6 +87,8 @@ static inline __u32 compute_checksum(__u32 cksum, unsigned char const *p,
         switch(cksum_type) {
         case OBD_CKSUM_CRC32:
                 return crc32_le(cksum, p, len);
+        case OBD_CKSUM_CRC32C:
+                return obd_crc32c(cksum, p, len);
 #ifdef HAVE_ADLER
         case OBD_CKSUM_ADLER:
                 return adler32(cksum, p, len);
@@ -119,6 +105,8 @@ static inline obd_flag cksum_type_pack(cksum_type_t cksum_type)
         switch(cksum_type) {
         case OBD_CKSUM_CRC32:
                 return OBD_FL_CKSUM_CRC32;
+        case OBD_CKSUM_CRC32C:
+                return OBD_FL_CKSUM_CRC32C;
 #ifdef HAVE_ADLER
         case OBD_CKSUM_ADLER:
                 return OBD_FL_CKSUM_ADLER;
@@ -134,6 +122,8 @@ static inline cksum_type_t cksum_type_unpack(obd_flag o_flags)
         o_flags &= OBD_FL_CKSUM_ALL;
         if ((o_flags - 1) & o_flags)
                 CWARN("several checksum types are set: %x\n", o_flags);
+        if (o_flags & OBD_FL_CKSUM_CRC32C)
+                return OBD_CKSUM_CRC32C;
         if (o_flags & OBD_FL_CKSUM_ADLER)
 #ifdef HAVE_ADLER
                 return OBD_CKSUM_ADLER;
@@ -145,19 +135,18 @@ static inline cksum_type_t cksum_type_unpack(obd_flag o_flags)
 }
 
 #ifdef HAVE_ADLER
-/* Default preferred checksum algorithm to use (if supported by the server) */
-#define OSC_DEFAULT_CKSUM OBD_CKSUM_ADLER
 /* Adler-32 is supported */
 #define CHECKSUM_ADLER OBD_CKSUM_ADLER
 #else
-#define OSC_DEFAULT_CKSUM OBD_CKSUM_CRC32
 #define CHECKSUM_ADLER 0
 #endif
 
-#define OBD_CKSUM_ALL (OBD_CKSUM_CRC32 | CHECKSUM_ADLER)
+/* the algorithm actually used is the fastest one both peers support, see
+ * obd_cksum_type_select() */
+#define OBD_CKSUM_ALL (OBD_CKSUM_CRC32 | CHECKSUM_ADLER | OBD_CKSUM_CRC32C)
 
 /* Checksum algorithm names. Must be defined in the same order as the
  * OBD_CKSUM_* flags. */
-#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler"}
+#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler", "crc32c"}
 
 #endif /* __OBD_H */
@@ -66,6 +66,8 @@ extern cfs_spinlock_t obd_dev_lock;
 extern struct obd_device *class_conn2obd(struct lustre_handle *);
 extern struct obd_device *class_exp2obd(struct obd_export *);
 extern int class_handle_ioctl(unsigned int cmd, unsigned long arg);
+int lustre_get_jobid(char *jobid);
+void obd_jobid_cache_flush(void);
 
 struct lu_device_type;
 
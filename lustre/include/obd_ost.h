@@ -45,6 +45,13 @@
 
 #include <obd_class.h>
 
+/* one of the objects of a multi-object write RPC */
+struct osc_brw_obj {
+        struct obdo       *bo_oa;
+        obd_count          bo_page_count;
+        struct lov_oinfo  *bo_loi;
+};
+
 struct osc_brw_async_args {
         struct obdo       *aa_oa;
         int                aa_requested_nob;
@@ -56,6 +63,9 @@ struct osc_brw_async_args {
         cfs_list_t         aa_oaps;
         struct obd_capa   *aa_ocapa;
         struct cl_req     *aa_clerq;
+        /* objects of a multi-object write, NULL for a single object */
+        struct osc_brw_obj *aa_objs;
+        int                aa_objcount;
 };
 
 #define osc_grant_args osc_brw_async_args
@@ -87,6 +87,12 @@ extern cfs_waitq_t obd_race_waitq;
 extern int obd_race_state;
 extern unsigned int obd_alloc_fail_rate;
 
+/* Name of the environment variable the client takes RPC job ids from */
+#define JOBSTATS_JOBID_VAR_MAX_LEN      20
+#define JOBSTATS_DISABLE                "disable"
+#define JOBSTATS_PROCNAME_UID           "procname_uid"
+extern char obd_jobid_var[];
+
 int __obd_fail_check_set(__u32 id, __u32 value, int set);
 int __obd_fail_timeout_set(__u32 id, __u32 value, int ms, int set);
 
@@ -107,6 +113,9 @@ int obd_alloc_fail(const void *ptr, const char *name, const char *type,
 #define HASH_NID_STATS_BKT_BITS 5
 #define HASH_NID_STATS_CUR_BITS 7
 #define HASH_NID_STATS_MAX_BITS 12
+#define HASH_JOB_STATS_BKT_BITS 5
+#define HASH_JOB_STATS_CUR_BITS 7
+#define HASH_JOB_STATS_MAX_BITS 12
 #define HASH_LQS_BKT_BITS 5
 #define HASH_LQS_CUR_BITS 7
 #define HASH_LQS_MAX_BITS 12
@@ -677,8 +686,28 @@ do {                                                                          \
 #define OBD_ALLOC_PTR(ptr) OBD_ALLOC(ptr, sizeof *(ptr))
 #define OBD_ALLOC_PTR_WAIT(ptr) OBD_ALLOC_WAIT(ptr, sizeof *(ptr))
 
+/* allocate memory on the NUMA node of CPU partition \a cpt, see
+ * libcfs_cpu.h; it is freed by OBD_FREE() as usual */
+#define OBD_CPT_ALLOC_GFP(ptr, cpt, size, gfp_mask)                           \
+do {                                                                          \
+        (ptr) = cfs_cpt_malloc(cpt, size, (gfp_mask));                        \
+        if (likely((ptr) != NULL &&                                           \
+                   (!HAS_FAIL_ALLOC_FLAG || obd_alloc_fail_rate == 0 ||       \
+                    !obd_alloc_fail(ptr, #ptr, "km", size,                    \
+                                    __FILE__, __LINE__) ||                    \
+                    OBD_FREE_RTN0(ptr)))){                                    \
+                memset(ptr, 0, size);                                         \
+                OBD_ALLOC_POST(ptr, size, "kmalloced");                       \
+        }                                                                     \
+} while (0)
+
+#define OBD_CPT_ALLOC(ptr, cpt, size)                                         \
+        OBD_CPT_ALLOC_GFP(ptr, cpt, size, OBD_ALLOC_MASK)
+#define OBD_CPT_ALLOC_PTR(ptr, cpt) OBD_CPT_ALLOC(ptr, cpt, sizeof *(ptr))
+
 #ifdef __arch_um__
 # define OBD_VMALLOC(ptr, size) OBD_ALLOC(ptr, size)
+# define OBD_CPT_VMALLOC(ptr, cpt, size) OBD_CPT_ALLOC(ptr, cpt, size)
 #else
 # define OBD_VMALLOC(ptr, size)                                               \
 do {                                                                          \
@@ -693,6 +722,17 @@ do {                                                                          \
                 OBD_ALLOC_POST(ptr, size, "vmalloced");                       \
         }                                                                     \
 } while(0)
+# define OBD_CPT_VMALLOC(ptr, cpt, size)                                      \
+do {                                                                          \
+        (ptr) = cfs_cpt_vmalloc(cpt, size);                                   \
+        if (unlikely((ptr) == NULL)) {                                        \
+                CERROR("vmalloc of '" #ptr "' (%d bytes) failed\n",           \
+                       (int)(size));                                          \
+        } else {                                                              \
+                memset(ptr, 0, size);                                         \
+                OBD_ALLOC_POST(ptr, size, "vmalloced");                       \
+        }                                                                     \
+} while(0)
 #endif
 
 #ifdef CONFIG_DEBUG_SLAB
@@ -725,8 +765,11 @@ do {                                                                          \
 # else
 #  define my_call_rcu(rcu, cb)            call_rcu(rcu, cb)
 # endif
+/* wait for pending my_call_rcu() callbacks, e.g. before a slab goes away */
+# define my_rcu_barrier()                 rcu_barrier()
 #else
 # define my_call_rcu(rcu, cb)             (cb)(rcu)
+# define my_rcu_barrier()                 do {} while (0)
 #endif
 
 #define OBD_FREE_RCU_CB(ptr, size, handle, free_cb)                           \
@@ -745,6 +788,8 @@ do {                                                                          \
 #define OBD_FREE(ptr, size) ((void)(size), free((ptr)))
 #define OBD_FREE_RCU(ptr, size, handle) (OBD_FREE(ptr, size))
 #define OBD_FREE_RCU_CB(ptr, size, handle, cb)     ((*(cb))(ptr, size))
+#define my_call_rcu(rcu, cb)             (cb)(rcu)
+#define my_rcu_barrier()                 do {} while (0)
 #endif /* ifdef __KERNEL__ */
 
 #ifdef __arch_um__
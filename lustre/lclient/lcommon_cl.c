@@ -384,13 +384,19 @@ int ccc_object_init(const struct lu_env *env, struct lu_object *obj,
         return result;
 }
 
-void ccc_object_free(const struct lu_env *env, struct lu_object *obj)
+static void ccc_object_free_cb(cfs_rcu_head_t *head)
 {
-        struct ccc_object *vob = lu2ccc(obj);
+        struct ccc_object *vob;
 
+        vob = container_of(head, struct ccc_object, cob_header.coh_lu.loh_rcu);
+        OBD_SLAB_FREE_PTR(vob, ccc_object_kmem);
+}
+
+void ccc_object_free(const struct lu_env *env, struct lu_object *obj)
+{
         lu_object_fini(obj);
         lu_object_header_fini(obj->lo_header);
-        OBD_SLAB_FREE_PTR(vob, ccc_object_kmem);
+        my_call_rcu(&obj->lo_header->loh_rcu, ccc_object_free_cb);
 }
 
 int ccc_lock_init(const struct lu_env *env,
@@ -200,6 +200,17 @@ void client_destroy_import(struct obd_import *imp)
         class_import_put(imp);
 }
 
+static void client_obd_hist_fini(struct client_obd *cli)
+{
+        lprocfs_oh_fini(&cli->cl_read_rpc_hist);
+        lprocfs_oh_fini(&cli->cl_write_rpc_hist);
+        lprocfs_oh_fini(&cli->cl_read_page_hist);
+        lprocfs_oh_fini(&cli->cl_write_page_hist);
+        lprocfs_oh_fini(&cli->cl_read_offset_hist);
+        lprocfs_oh_fini(&cli->cl_write_offset_hist);
+        lprocfs_oh_fini(&cli->cl_write_obj_hist);
+}
+
 /* configure an RPC client OBD device
  *
  * lcfg parameters:
@@ -299,6 +310,17 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
         cfs_spin_lock_init(&cli->cl_write_page_hist.oh_lock);
         cfs_spin_lock_init(&cli->cl_read_offset_hist.oh_lock);
         cfs_spin_lock_init(&cli->cl_write_offset_hist.oh_lock);
+        cfs_spin_lock_init(&cli->cl_write_obj_hist.oh_lock);
+        if (!strcmp(name, LUSTRE_OSC_NAME)) {
+                /* tallied for every brw RPC; failure leaves them shared */
+                lprocfs_oh_init_percpu(&cli->cl_read_rpc_hist);
+                lprocfs_oh_init_percpu(&cli->cl_write_rpc_hist);
+                lprocfs_oh_init_percpu(&cli->cl_read_page_hist);
+                lprocfs_oh_init_percpu(&cli->cl_write_page_hist);
+                lprocfs_oh_init_percpu(&cli->cl_read_offset_hist);
+                lprocfs_oh_init_percpu(&cli->cl_write_offset_hist);
+                lprocfs_oh_init_percpu(&cli->cl_write_obj_hist);
+        }
         cfs_waitq_init(&cli->cl_destroy_waitq);
         cfs_atomic_set(&cli->cl_destroy_in_flight, 0);
 #ifdef ENABLE_CHECKSUM
@@ -390,6 +412,7 @@ err_import:
 err_ldlm:
         ldlm_put_ref();
 err:
+        client_obd_hist_fini(cli);
         RETURN(rc);
 
 }
@@ -400,6 +423,7 @@ int client_obd_cleanup(struct obd_device *obddev)
 
         ldlm_namespace_free_post(obddev->obd_namespace);
         obddev->obd_namespace = NULL;
+        client_obd_hist_fini(&obddev->u.cli);
 
         ldlm_put_ref();
         RETURN(0);
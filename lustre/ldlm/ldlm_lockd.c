@@ -85,23 +85,19 @@ static inline unsigned int ldlm_get_rq_timeout(void)
 }
 
 #ifdef __KERNEL__
-/* w_l_spinlock protects both waiting_locks_list and expired_lock_thread */
+/* w_l_spinlock protects both waiting_locks_list and expired_lock_work */
 static cfs_spinlock_t waiting_locks_spinlock;   /* BH lock (timer) */
 static cfs_list_t waiting_locks_list;
 static cfs_timer_t waiting_locks_timer;
 
-static struct expired_lock_thread {
-        cfs_waitq_t               elt_waitq;
-        int                       elt_state;
+/* expired locks are handled by a high priority workitem */
+static struct expired_lock_work {
+        cfs_workitem_t            elt_wi;
         int                       elt_dump;
         cfs_list_t                elt_expired_locks;
-} expired_lock_thread;
+} expired_lock_work;
 #endif
 
-#define ELT_STOPPED   0
-#define ELT_READY     1
-#define ELT_TERMINATE 2
-
 struct ldlm_bl_pool {
         cfs_spinlock_t          blp_lock;
 
@@ -140,103 +136,74 @@ struct ldlm_bl_work_item {
 
 #ifdef __KERNEL__
 
-static inline int have_expired_locks(void)
-{
-        int need_to_run;
-
-        ENTRY;
-        cfs_spin_lock_bh(&waiting_locks_spinlock);
-        need_to_run = !cfs_list_empty(&expired_lock_thread.elt_expired_locks);
-        cfs_spin_unlock_bh(&waiting_locks_spinlock);
-
-        RETURN(need_to_run);
-}
-
-static int expired_lock_main(void *arg)
+static int expired_lock_main(cfs_workitem_t *wi)
 {
-        cfs_list_t *expired = &expired_lock_thread.elt_expired_locks;
-        struct l_wait_info lwi = { 0 };
+        cfs_list_t *expired = &expired_lock_work.elt_expired_locks;
         int do_dump;
 
         ENTRY;
-        cfs_daemonize("ldlm_elt");
 
-        expired_lock_thread.elt_state = ELT_READY;
-        cfs_waitq_signal(&expired_lock_thread.elt_waitq);
+        cfs_spin_lock_bh(&waiting_locks_spinlock);
+        if (expired_lock_work.elt_dump) {
+                cfs_spin_unlock_bh(&waiting_locks_spinlock);
 
-        while (1) {
-                l_wait_event(expired_lock_thread.elt_waitq,
-                             have_expired_locks() ||
-                             expired_lock_thread.elt_state == ELT_TERMINATE,
-                             &lwi);
+                /* from waiting_locks_callback, but not in timer */
+                libcfs_debug_dumplog();
+                libcfs_run_lbug_upcall(__FILE__,
+                                        "waiting_locks_callback",
+                                        expired_lock_work.elt_dump);
 
                 cfs_spin_lock_bh(&waiting_locks_spinlock);
-                if (expired_lock_thread.elt_dump) {
-                        cfs_spin_unlock_bh(&waiting_locks_spinlock);
-
-                        /* from waiting_locks_callback, but not in timer */
-                        libcfs_debug_dumplog();
-                        libcfs_run_lbug_upcall(__FILE__,
-                                                "waiting_locks_callback",
-                                                expired_lock_thread.elt_dump);
-
-                        cfs_spin_lock_bh(&waiting_locks_spinlock);
-                        expired_lock_thread.elt_dump = 0;
-                }
+                expired_lock_work.elt_dump = 0;
+        }
 
-                do_dump = 0;
+        do_dump = 0;
 
-                while (!cfs_list_empty(expired)) {
-                        struct obd_export *export;
-                        struct ldlm_lock *lock;
+        while (!cfs_list_empty(expired)) {
+                struct obd_export *export;
+                struct ldlm_lock *lock;
 
-                        lock = cfs_list_entry(expired->next, struct ldlm_lock,
-                                          l_pending_chain);
-                        if ((void *)lock < LP_POISON + CFS_PAGE_SIZE &&
-                            (void *)lock >= LP_POISON) {
-                                cfs_spin_unlock_bh(&waiting_locks_spinlock);
-                                CERROR("free lock on elt list %p\n", lock);
-                                LBUG();
-                        }
-                        cfs_list_del_init(&lock->l_pending_chain);
-                        if ((void *)lock->l_export < LP_POISON + CFS_PAGE_SIZE &&
-                            (void *)lock->l_export >= LP_POISON) {
-                                CERROR("lock with free export on elt list %p\n",
-                                       lock->l_export);
-                                lock->l_export = NULL;
-                                LDLM_ERROR(lock, "free export");
-                                /* release extra ref grabbed by
-                                 * ldlm_add_waiting_lock() or
-                                 * ldlm_failed_ast() */
-                                LDLM_LOCK_RELEASE(lock);
-                                continue;
-                        }
-                        export = class_export_lock_get(lock->l_export, lock);
+                lock = cfs_list_entry(expired->next, struct ldlm_lock,
+                                  l_pending_chain);
+                if ((void *)lock < LP_POISON + CFS_PAGE_SIZE &&
+                    (void *)lock >= LP_POISON) {
                         cfs_spin_unlock_bh(&waiting_locks_spinlock);
-
-                        do_dump++;
-                        class_fail_export(export);
-                        class_export_lock_put(export, lock);
-
-                        /* release extra ref grabbed by ldlm_add_waiting_lock()
-                         * or ldlm_failed_ast() */
+                        CERROR("free lock on elt list %p\n", lock);
+                        LBUG();
+                }
+                cfs_list_del_init(&lock->l_pending_chain);
+                if ((void *)lock->l_export < LP_POISON + CFS_PAGE_SIZE &&
+                    (void *)lock->l_export >= LP_POISON) {
+                        CERROR("lock with free export on elt list %p\n",
+                               lock->l_export);
+                        lock->l_export = NULL;
+                        LDLM_ERROR(lock, "free export");
+                        /* release extra ref grabbed by
+                         * ldlm_add_waiting_lock() or
+                         * ldlm_failed_ast() */
                         LDLM_LOCK_RELEASE(lock);
-
-                        cfs_spin_lock_bh(&waiting_locks_spinlock);
+                        continue;
                 }
+                export = class_export_lock_get(lock->l_export, lock);
                 cfs_spin_unlock_bh(&waiting_locks_spinlock);
 
-                if (do_dump && obd_dump_on_eviction) {
-                        CERROR("dump the log upon eviction\n");
-                        libcfs_debug_dumplog();
-                }
+                do_dump++;
+                class_fail_export(export);
+                class_export_lock_put(export, lock);
 
-                if (expired_lock_thread.elt_state == ELT_TERMINATE)
-                        break;
+                /* release extra ref grabbed by ldlm_add_waiting_lock()
+                 * or ldlm_failed_ast() */
+                LDLM_LOCK_RELEASE(lock);
+
+                cfs_spin_lock_bh(&waiting_locks_spinlock);
+        }
+        cfs_spin_unlock_bh(&waiting_locks_spinlock);
+
+        if (do_dump && obd_dump_on_eviction) {
+                CERROR("dump the log upon eviction\n");
+                libcfs_debug_dumplog();
         }
 
-        expired_lock_thread.elt_state = ELT_STOPPED;
-        cfs_waitq_signal(&expired_lock_thread.elt_waitq);
         RETURN(0);
 }
 
@@ -354,14 +321,14 @@ repeat:
                  * already grabbed a ref */
                 cfs_list_del(&lock->l_pending_chain);
                 cfs_list_add(&lock->l_pending_chain,
-                             &expired_lock_thread.elt_expired_locks);
+                             &expired_lock_work.elt_expired_locks);
         }
 
-        if (!cfs_list_empty(&expired_lock_thread.elt_expired_locks)) {
+        if (!cfs_list_empty(&expired_lock_work.elt_expired_locks)) {
                 if (obd_dump_on_timeout)
-                        expired_lock_thread.elt_dump = __LINE__;
+                        expired_lock_work.elt_dump = __LINE__;
 
-                cfs_waitq_signal(&expired_lock_thread.elt_waitq);
+                cfs_wi_schedule(&expired_lock_work.elt_wi);
         }
 
         /*
@@ -573,8 +540,8 @@ static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
                  * the lock to the expired list */
                 LDLM_LOCK_GET(lock);
         cfs_list_add(&lock->l_pending_chain,
-                     &expired_lock_thread.elt_expired_locks);
-        cfs_waitq_signal(&expired_lock_thread.elt_waitq);
+                     &expired_lock_work.elt_expired_locks);
+        cfs_wi_schedule(&expired_lock_work.elt_wi);
         cfs_spin_unlock_bh(&waiting_locks_spinlock);
 #else
         class_fail_export(lock->l_export);
@@ -2434,7 +2401,8 @@ static int ldlm_setup(void)
                                 ldlm_svc_proc_dir, NULL,
                                 ldlm_min_threads, ldlm_max_threads,
                                 "ldlm_cb",
-                                LCT_MD_THREAD|LCT_DT_THREAD, NULL);
+                                LCT_MD_THREAD|LCT_DT_THREAD, NULL,
+                                PTLRPC_SVC_CPT_NONE);
 
         if (!ldlm_state->ldlm_cb_service) {
                 CERROR("failed to start service\n");
@@ -2450,7 +2418,7 @@ static int ldlm_setup(void)
                                 ldlm_min_threads, ldlm_max_threads,
                                 "ldlm_cn",
                                 LCT_MD_THREAD|LCT_DT_THREAD|LCT_CL_THREAD,
-                                NULL);
+                                NULL, PTLRPC_SVC_CPT_PART);
 
         if (!ldlm_state->ldlm_cancel_service) {
                 CERROR("failed to start service\n");
@@ -2486,22 +2454,16 @@ static int ldlm_setup(void)
         if (rc)
                 GOTO(out_thread, rc);
 
-        CFS_INIT_LIST_HEAD(&expired_lock_thread.elt_expired_locks);
-        expired_lock_thread.elt_state = ELT_STOPPED;
-        cfs_waitq_init(&expired_lock_thread.elt_waitq);
+        CFS_INIT_LIST_HEAD(&expired_lock_work.elt_expired_locks);
+        expired_lock_work.elt_dump = 0;
+        cfs_wi_init(&expired_lock_work.elt_wi, NULL, expired_lock_main,
+                    CFS_WI_SCHED_ANY);
+        /* clients holding expired locks hold up everybody else */
+        cfs_wi_set_prio(&expired_lock_work.elt_wi, CFS_WI_PRIO_HIGH);
 
         CFS_INIT_LIST_HEAD(&waiting_locks_list);
         cfs_spin_lock_init(&waiting_locks_spinlock);
         cfs_timer_init(&waiting_locks_timer, waiting_locks_callback, 0);
-
-        rc = cfs_kernel_thread(expired_lock_main, NULL, CLONE_VM | CLONE_FILES);
-        if (rc < 0) {
-                CERROR("Cannot start ldlm expired-lock thread: %d\n", rc);
-                GOTO(out_thread, rc);
-        }
-
-        cfs_wait_event(expired_lock_thread.elt_waitq,
-                       expired_lock_thread.elt_state == ELT_READY);
 #endif
 
 #ifdef __KERNEL__
@@ -2565,10 +2527,27 @@ static int ldlm_cleanup(void)
         ptlrpc_unregister_service(ldlm_state->ldlm_cancel_service);
         ldlm_proc_cleanup();
 
-        expired_lock_thread.elt_state = ELT_TERMINATE;
-        cfs_waitq_signal(&expired_lock_thread.elt_waitq);
-        cfs_wait_event(expired_lock_thread.elt_waitq,
-                       expired_lock_thread.elt_state == ELT_STOPPED);
+        cfs_timer_disarm_sync(&waiting_locks_timer);
+        cfs_wi_cancel_sync(&expired_lock_work.elt_wi);
+
+        /* nothing schedules the workitem any more: drop the locks it did
+         * not get to */
+        cfs_spin_lock_bh(&waiting_locks_spinlock);
+        while (!cfs_list_empty(&expired_lock_work.elt_expired_locks)) {
+                struct ldlm_lock *lock;
+
+                lock = cfs_list_entry(expired_lock_work.elt_expired_locks.next,
+                                      struct ldlm_lock, l_pending_chain);
+                cfs_list_del_init(&lock->l_pending_chain);
+                cfs_spin_unlock_bh(&waiting_locks_spinlock);
+
+                /* release extra ref grabbed by ldlm_add_waiting_lock()
+                 * or ldlm_failed_ast() */
+                LDLM_LOCK_RELEASE(lock);
+
+                cfs_spin_lock_bh(&waiting_locks_spinlock);
+        }
+        cfs_spin_unlock_bh(&waiting_locks_spinlock);
 #else
         ptlrpc_unregister_service(ldlm_state->ldlm_cb_service);
         ptlrpc_unregister_service(ldlm_state->ldlm_cancel_service);
@@ -2618,6 +2597,8 @@ void __exit ldlm_exit(void)
         int rc;
         if (ldlm_refcount)
                 CERROR("ldlm_refcount is %d in ldlm_exit!\n", ldlm_refcount);
+        /* ldlm_resource_putref() frees resources with RCU too */
+        my_rcu_barrier();
         rc = cfs_mem_cache_destroy(ldlm_resource_slab);
         LASSERTF(rc == 0, "couldn't free ldlm resource slab\n");
 #ifdef __KERNEL__
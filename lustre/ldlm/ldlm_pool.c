@@ -1063,10 +1063,17 @@ static int ldlm_pool_granted(struct ldlm_pool *pl)
         return cfs_atomic_read(&pl->pl_granted);
 }
 
-static struct ptlrpc_thread *ldlm_pools_thread;
+/*
+ * Pools are recalculated by a low priority workitem every
+ * LDLM_POOLS_THREAD_PERIOD seconds, kicked by ldlm_pools_timer.
+ */
+static cfs_workitem_t ldlm_pools_wi;
+static cfs_timer_t ldlm_pools_timer;
+/* guards ldlm_pools_stopping against the timer and the workitem */
+static cfs_spinlock_t ldlm_pools_lock = CFS_SPIN_LOCK_UNLOCKED;
+static int ldlm_pools_stopping = 1;
 static struct cfs_shrinker *ldlm_pools_srv_shrinker;
 static struct cfs_shrinker *ldlm_pools_cli_shrinker;
-static cfs_completion_t ldlm_pools_comp;
 
 /*
  * Cancel \a nr locks from all namespaces (if possible). Returns number of
@@ -1286,109 +1293,64 @@ void ldlm_pools_recalc(ldlm_side_t client)
 }
 EXPORT_SYMBOL(ldlm_pools_recalc);
 
-static int ldlm_pools_thread_main(void *arg)
+static int ldlm_pools_recalc_wi(cfs_workitem_t *wi)
 {
-        struct ptlrpc_thread *thread = (struct ptlrpc_thread *)arg;
-        char *t_name = "ldlm_poold";
-        ENTRY;
-
-        cfs_daemonize(t_name);
-        thread->t_flags = SVC_RUNNING;
-        cfs_waitq_signal(&thread->t_ctl_waitq);
-
-        CDEBUG(D_DLMTRACE, "%s: pool thread starting, process %d\n",
-               t_name, cfs_curproc_pid());
-
-        while (1) {
-                struct l_wait_info lwi;
-
-                /*
-                 * Recal all pools on this tick.
-                 */
-                ldlm_pools_recalc(LDLM_NAMESPACE_SERVER);
-                ldlm_pools_recalc(LDLM_NAMESPACE_CLIENT);
-
-                /*
-                 * Wait until the next check time, or until we're
-                 * stopped.
-                 */
-                lwi = LWI_TIMEOUT(cfs_time_seconds(LDLM_POOLS_THREAD_PERIOD),
-                                  NULL, NULL);
-                l_wait_event(thread->t_ctl_waitq, (thread->t_flags &
-                                                   (SVC_STOPPING|SVC_EVENT)),
-                             &lwi);
-
-                if (thread->t_flags & SVC_STOPPING) {
-                        thread->t_flags &= ~SVC_STOPPING;
-                        break;
-                } else if (thread->t_flags & SVC_EVENT) {
-                        thread->t_flags &= ~SVC_EVENT;
-                }
-        }
-
-        thread->t_flags = SVC_STOPPED;
-        cfs_waitq_signal(&thread->t_ctl_waitq);
-
-        CDEBUG(D_DLMTRACE, "%s: pool thread exiting, process %d\n",
-               t_name, cfs_curproc_pid());
+        ldlm_pools_recalc(LDLM_NAMESPACE_SERVER);
+        ldlm_pools_recalc(LDLM_NAMESPACE_CLIENT);
+
+        cfs_spin_lock_bh(&ldlm_pools_lock);
+        if (!ldlm_pools_stopping)
+                cfs_timer_arm(&ldlm_pools_timer,
+                              cfs_time_shift(LDLM_POOLS_THREAD_PERIOD));
+        cfs_spin_unlock_bh(&ldlm_pools_lock);
+        return 0;
+}
 
-        cfs_complete_and_exit(&ldlm_pools_comp, 0);
+static void ldlm_pools_timer_cb(unsigned long unused)
+{
+        cfs_spin_lock(&ldlm_pools_lock);
+        if (!ldlm_pools_stopping)
+                cfs_wi_schedule(&ldlm_pools_wi);
+        cfs_spin_unlock(&ldlm_pools_lock);
 }
 
-static int ldlm_pools_thread_start(void)
+static int ldlm_pools_recalc_start(void)
 {
-        struct l_wait_info lwi = { 0 };
-        int rc;
         ENTRY;
 
-        if (ldlm_pools_thread != NULL)
+        if (!ldlm_pools_stopping)
                 RETURN(-EALREADY);
 
-        OBD_ALLOC_PTR(ldlm_pools_thread);
-        if (ldlm_pools_thread == NULL)
-                RETURN(-ENOMEM);
-
-        cfs_init_completion(&ldlm_pools_comp);
-        cfs_waitq_init(&ldlm_pools_thread->t_ctl_waitq);
+        cfs_wi_init(&ldlm_pools_wi, NULL, ldlm_pools_recalc_wi,
+                    CFS_WI_SCHED_ANY);
+        cfs_wi_set_prio(&ldlm_pools_wi, CFS_WI_PRIO_LOW);
+        cfs_timer_init(&ldlm_pools_timer, ldlm_pools_timer_cb, NULL);
+        cfs_spin_lock_bh(&ldlm_pools_lock);
+        ldlm_pools_stopping = 0;
+        cfs_spin_unlock_bh(&ldlm_pools_lock);
 
-        /*
-         * CLONE_VM and CLONE_FILES just avoid a needless copy, because we
-         * just drop the VM and FILES in cfs_daemonize() right away.
-         */
-        rc = cfs_kernel_thread(ldlm_pools_thread_main, ldlm_pools_thread,
-                               CLONE_VM | CLONE_FILES);
-        if (rc < 0) {
-                CERROR("Can't start pool thread, error %d\n",
-                       rc);
-                OBD_FREE(ldlm_pools_thread, sizeof(*ldlm_pools_thread));
-                ldlm_pools_thread = NULL;
-                RETURN(rc);
-        }
-        l_wait_event(ldlm_pools_thread->t_ctl_waitq,
-                     (ldlm_pools_thread->t_flags & SVC_RUNNING), &lwi);
+        cfs_wi_schedule(&ldlm_pools_wi);
         RETURN(0);
 }
 
-static void ldlm_pools_thread_stop(void)
+static void ldlm_pools_recalc_stop(void)
 {
         ENTRY;
 
-        if (ldlm_pools_thread == NULL) {
+        cfs_spin_lock_bh(&ldlm_pools_lock);
+        if (ldlm_pools_stopping) {
+                cfs_spin_unlock_bh(&ldlm_pools_lock);
                 EXIT;
                 return;
         }
-
-        ldlm_pools_thread->t_flags = SVC_STOPPING;
-        cfs_waitq_signal(&ldlm_pools_thread->t_ctl_waitq);
-
-        /*
-         * Make sure that pools thread is finished before freeing @thread.
-         * This fixes possible race and oops due to accessing freed memory
-         * in pools thread.
-         */
-        cfs_wait_for_completion(&ldlm_pools_comp);
-        OBD_FREE_PTR(ldlm_pools_thread);
-        ldlm_pools_thread = NULL;
+        ldlm_pools_stopping = 1;
+        cfs_spin_unlock_bh(&ldlm_pools_lock);
+
+        /* from now on neither the workitem re-arms the timer nor the timer
+         * schedules the workitem: wait for a timer callback in flight, then
+         * for the run it may have scheduled */
+        cfs_timer_disarm_sync(&ldlm_pools_timer);
+        cfs_wi_cancel_sync(&ldlm_pools_wi);
         EXIT;
 }
 
@@ -1397,7 +1359,7 @@ int ldlm_pools_init(void)
         int rc;
         ENTRY;
 
-        rc = ldlm_pools_thread_start();
+        rc = ldlm_pools_recalc_start();
         if (rc == 0) {
                 ldlm_pools_srv_shrinker =
                         cfs_set_shrinker(CFS_DEFAULT_SEEKS,
@@ -1420,7 +1382,7 @@ void ldlm_pools_fini(void)
                 cfs_remove_shrinker(ldlm_pools_cli_shrinker);
                 ldlm_pools_cli_shrinker = NULL;
         }
-        ldlm_pools_thread_stop();
+        ldlm_pools_recalc_stop();
 }
 EXPORT_SYMBOL(ldlm_pools_fini);
 #endif /* __KERNEL__ */
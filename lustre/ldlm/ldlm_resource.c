@@ -447,6 +447,19 @@ static void ldlm_res_hop_get_locked(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
         LDLM_RESOURCE_ADDREF(res);
 }
 
+static int ldlm_res_hop_get_rcu(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
+{
+        struct ldlm_resource *res;
+
+        res = cfs_hlist_entry(hnode, struct ldlm_resource, lr_hash);
+        /* zero refcount: ldlm_resource_putref() is unhashing it */
+        if (!cfs_atomic_inc_not_zero(&res->lr_refcount))
+                return 0;
+
+        LDLM_RESOURCE_ADDREF(res);
+        return 1;
+}
+
 static void ldlm_res_hop_put_locked(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
 {
         struct ldlm_resource *res;
@@ -473,6 +486,7 @@ cfs_hash_ops_t ldlm_ns_hash_ops = {
         .hs_keycpy      = NULL,
         .hs_object      = ldlm_res_hop_object,
         .hs_get         = ldlm_res_hop_get_locked,
+        .hs_get_rcu     = ldlm_res_hop_get_rcu,
         .hs_put_locked  = ldlm_res_hop_put_locked,
         .hs_put         = ldlm_res_hop_put
 };
@@ -484,6 +498,7 @@ cfs_hash_ops_t ldlm_ns_fid_hash_ops = {
         .hs_keycpy      = NULL,
         .hs_object      = ldlm_res_hop_object,
         .hs_get         = ldlm_res_hop_get_locked,
+        .hs_get_rcu     = ldlm_res_hop_get_rcu,
         .hs_put_locked  = ldlm_res_hop_put_locked,
         .hs_put         = ldlm_res_hop_put
 };
@@ -586,7 +601,8 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
                                          CFS_HASH_DEPTH |
                                          CFS_HASH_BIGNAME |
                                          CFS_HASH_SPIN_BKTLOCK |
-                                         CFS_HASH_NO_ITEMREF);
+                                         CFS_HASH_NO_ITEMREF |
+                                         CFS_HASH_RCU);
         if (ns->ns_rs_hash == NULL)
                 GOTO(out_ns, NULL);
 
@@ -1017,10 +1033,16 @@ ldlm_resource_get(struct ldlm_namespace *ns, struct ldlm_resource *parent,
         LASSERT(ns->ns_rs_hash != NULL);
         LASSERT(name->name[0] != 0);
 
-        cfs_hash_bd_get_and_lock(ns->ns_rs_hash, (void *)name, &bd, 0);
-        hnode = cfs_hash_bd_lookup_locked(ns->ns_rs_hash, &bd, (void *)name);
-        if (hnode != NULL) {
+        cfs_hash_bd_get(ns->ns_rs_hash, (void *)name, &bd);
+        hnode = cfs_hash_bd_lookup_rcu(ns->ns_rs_hash, &bd, (void *)name);
+        if (hnode == NULL) {
+                cfs_hash_bd_lock(ns->ns_rs_hash, &bd, 0);
+                hnode = cfs_hash_bd_lookup_locked(ns->ns_rs_hash, &bd,
+                                                  (void *)name);
+                version = cfs_hash_bd_version_get(&bd);
                 cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 0);
+        }
+        if (hnode != NULL) {
                 res = cfs_hlist_entry(hnode, struct ldlm_resource, lr_hash);
                 /* synchronize WRT resource creation */
                 if (ns->ns_lvbo && ns->ns_lvbo->lvbo_init) {
@@ -1030,9 +1052,6 @@ ldlm_resource_get(struct ldlm_namespace *ns, struct ldlm_resource *parent,
                 return res;
         }
 
-        version = cfs_hash_bd_version_get(&bd);
-        cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 0);
-
         if (create == 0)
                 return NULL;
 
@@ -1124,6 +1143,14 @@ static void __ldlm_resource_putref_final(cfs_hash_bd_t *bd,
                 ldlm_namespace_put(nsb->nsb_namespace);
 }
 
+static void ldlm_resource_free_cb(cfs_rcu_head_t *head)
+{
+        struct ldlm_resource *res;
+
+        res = container_of(head, struct ldlm_resource, lr_rcu);
+        OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
+}
+
 /* Returns 1 if the resource was freed, 0 if it remains. */
 int ldlm_resource_putref(struct ldlm_resource *res)
 {
@@ -1140,7 +1167,8 @@ int ldlm_resource_putref(struct ldlm_resource *res)
                 cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 1);
                 if (ns->ns_lvbo && ns->ns_lvbo->lvbo_free)
                         ns->ns_lvbo->lvbo_free(res);
-                OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
+                /* lockless lookups may still be looking at it */
+                my_call_rcu(&res->lr_rcu, ldlm_resource_free_cb);
                 return 1;
         }
         return 0;
@@ -1169,7 +1197,8 @@ int ldlm_resource_putref_locked(struct ldlm_resource *res)
                  */
                 if (ns->ns_lvbo && ns->ns_lvbo->lvbo_free)
                         ns->ns_lvbo->lvbo_free(res);
-                OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
+                /* lockless lookups may still be looking at it */
+                my_call_rcu(&res->lr_rcu, ldlm_resource_free_cb);
 
                 cfs_hash_bd_lock(ns->ns_rs_hash, &bd, 1);
                 return 1;
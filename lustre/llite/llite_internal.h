@@ -232,6 +232,7 @@ enum ra_stat {
         RA_STAT_EOF,
         RA_STAT_MAX_IN_FLIGHT,
         RA_STAT_WRONG_GRAB_PAGE,
+        RA_STAT_GANG_PAGES,
         _NR_RA_STAT,
 };
 
@@ -379,6 +380,10 @@ struct ll_sb_info {
          * >0 - max. chunk to be read/written w/o lock re-acquiring */
         unsigned long             ll_max_rw_chunk;
 
+        /* extent mode unit of the OSCs of this mount, in KB, 0 is off;
+         * see client_obd::cl_extent_pages */
+        int                       ll_extent_kb;
+
         struct lu_site           *ll_site;
         struct cl_device         *ll_cl;
         /* Statistics */
@@ -891,6 +896,10 @@ struct vvp_thread_info {
         struct ra_io_arg     vti_ria;
         struct kiocb         vti_kiocb;
         struct ll_cl_context vti_io_ctx;
+        /** a run of read-ahead pages, see ll_read_ahead_gang() */
+        struct page         *vti_ra_vmpages[CL_PAGE_GANG_MAX];
+        struct cl_page      *vti_ra_pages[CL_PAGE_GANG_MAX];
+        int                  vti_ra_rc[CL_PAGE_GANG_MAX];
 };
 
 static inline struct vvp_thread_info *vvp_env_info(const struct lu_env *env)
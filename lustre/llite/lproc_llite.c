@@ -442,6 +442,40 @@ static int ll_wr_checksum(struct file *file, const char *buffer,
         return count;
 }
 
+static int ll_rd_extent_kb(char *page, char **start, off_t off,
+                           int count, int *eof, void *data)
+{
+        struct super_block *sb = data;
+
+        return snprintf(page, count, "%d\n", ll_s2sbi(sb)->ll_extent_kb);
+}
+
+static int ll_wr_extent_kb(struct file *file, const char *buffer,
+                           unsigned long count, void *data)
+{
+        struct super_block *sb = data;
+        struct ll_sb_info *sbi = ll_s2sbi(sb);
+        int val, rc;
+
+        if (!sbi->ll_dt_exp)
+                /* Not set up yet */
+                return -EAGAIN;
+
+        rc = lprocfs_write_helper(buffer, count, &val);
+        if (rc)
+                return rc;
+        if (val < 0 || val > (PTLRPC_MAX_BRW_PAGES << (CFS_PAGE_SHIFT - 10)))
+                return -ERANGE;
+
+        rc = obd_set_info_async(sbi->ll_dt_exp, sizeof(KEY_EXTENT_KB),
+                                KEY_EXTENT_KB, sizeof(val), &val, NULL);
+        if (rc)
+                return rc;
+        sbi->ll_extent_kb = val;
+
+        return count;
+}
+
 static int ll_rd_max_rw_chunk(char *page, char **start, off_t off,
                           int count, int *eof, void *data)
 {
@@ -625,6 +659,7 @@ static struct lprocfs_vars lprocfs_llite_obd_vars[] = {
                                      ll_wr_max_read_ahead_whole_mb, 0 },
         { "max_cached_mb",    ll_rd_max_cached_mb, ll_wr_max_cached_mb, 0 },
         { "checksum_pages",   ll_rd_checksum, ll_wr_checksum, 0 },
+        { "extent_kb",        ll_rd_extent_kb, ll_wr_extent_kb, 0 },
         { "max_rw_chunk",     ll_rd_max_rw_chunk, ll_wr_max_rw_chunk, 0 },
         { "stats_track_pid",  ll_rd_track_pid, ll_wr_track_pid, 0 },
         { "stats_track_ppid", ll_rd_track_ppid, ll_wr_track_ppid, 0 },
@@ -724,6 +759,7 @@ static const char *ra_stat_string[] = {
         [RA_STAT_EOF] = "read-ahead to EOF",
         [RA_STAT_MAX_IN_FLIGHT] = "hit max r-a issue",
         [RA_STAT_WRONG_GRAB_PAGE] = "wrong page from grab_cache_page",
+        [RA_STAT_GANG_PAGES] = "pages created in batches",
 };
 
 
@@ -554,6 +554,83 @@ static int ll_read_ahead_page(const struct lu_env *env, struct cl_io *io,
         RETURN(rc);
 }
 
+/**
+ * Initiates read-ahead of up to \a nr pages starting at \a index, creating
+ * their cl_pages with a single cl_page_gang_find() call.
+ *
+ * Pages are grabbed until the first one that cannot be, and processed in
+ * order as ll_read_ahead_page() would, stopping after the first -ENOLCK.
+ * \a rcs[i] receives ll_read_ahead_page() return value for the i-th page.
+ *
+ * \retval number of pages processed, at least 1.
+ */
+static int ll_read_ahead_gang(const struct lu_env *env, struct cl_io *io,
+                              struct cl_page_list *queue, pgoff_t index,
+                              int nr, struct address_space *mapping, int *rcs)
+{
+        struct vvp_thread_info *vti     = vvp_env_info(env);
+        struct page           **vmpages = vti->vti_ra_vmpages;
+        struct cl_page        **pages   = vti->vti_ra_pages;
+        struct cl_object       *clob    = ll_i2info(mapping->host)->lli_clob;
+        struct page            *vmpage;
+        unsigned int            gfp_mask;
+        int                     done;
+        int                     n;
+        int                     i;
+
+        ENTRY;
+
+        LASSERT(nr <= CL_PAGE_GANG_MAX);
+        gfp_mask = GFP_HIGHUSER & ~__GFP_WAIT;
+#ifdef __GFP_NOWARN
+        gfp_mask |= __GFP_NOWARN;
+#endif
+        for (n = 0; n < nr; n++) {
+                vmpage = grab_cache_page_nowait_gfp(mapping, index + n,
+                                                    gfp_mask);
+                if (vmpage == NULL)
+                        break;
+                if (vmpage->mapping != mapping) {
+                        unlock_page(vmpage);
+                        page_cache_release(vmpage);
+                        break;
+                }
+                vmpages[n] = vmpage;
+        }
+        if (n == 0) {
+                /* let ll_read_ahead_page() account for the failure */
+                rcs[0] = ll_read_ahead_page(env, io, queue, index, mapping);
+                RETURN(1);
+        }
+
+        cl_page_gang_find(env, clob, index, vmpages, n, pages);
+        if (n > 1)
+                lprocfs_counter_add(ll_i2sbi(mapping->host)->ll_ra_stats,
+                                    RA_STAT_GANG_PAGES, n);
+        for (i = 0, done = n; i < n; i++) {
+                rcs[i] = 0;
+                if (IS_ERR(pages[i])) {
+                        ll_ra_stats_inc(mapping, RA_STAT_FAILED_GRAB_PAGE);
+                        CDEBUG(D_READA, "cl_page_find failed\n");
+                } else if (i < done) {
+                        rcs[i] = cl_read_ahead_page(env, io, queue,
+                                                    pages[i], vmpages[i]);
+                        if (rcs[i] == -ENOLCK) {
+                                ll_ra_stats_inc(mapping,
+                                                RA_STAT_FAILED_MATCH);
+                                CDEBUG(D_READA, "lock match failed\n");
+                                done = i + 1;
+                        }
+                } else
+                        /* past the lock, leave the page for ->readpage() */
+                        cl_page_put(env, pages[i]);
+                if (rcs[i] != 1)
+                        unlock_page(vmpages[i]);
+                page_cache_release(vmpages[i]);
+        }
+        RETURN(done);
+}
+
 #define RIA_DEBUG(ria)                                                       \
         CDEBUG(D_READA, "rs %lu re %lu ro %lu rl %lu rp %lu\n",       \
         ria->ria_start, ria->ria_end, ria->ria_stoff, ria->ria_length,\
@@ -649,7 +726,8 @@ static int ll_read_ahead_pages(const struct lu_env *env,
                                struct address_space *mapping,
                                unsigned long *ra_end)
 {
-        int rc, count = 0, stride_ria;
+        int *rcs = vvp_env_info(env)->vti_ra_rc;
+        int count = 0, stride_ria, nr, i;
         unsigned long page_idx;
 
         LASSERT(ria != NULL);
@@ -659,13 +737,25 @@ static int ll_read_ahead_pages(const struct lu_env *env,
         for (page_idx = ria->ria_start; page_idx <= ria->ria_end &&
                         *reserved_pages > 0; page_idx++) {
                 if (ras_inside_ra_window(page_idx, ria)) {
-                        /* If the page is inside the read-ahead window*/
-                        rc = ll_read_ahead_page(env, io, queue,
-                                                page_idx, mapping);
-                        if (rc == 1) {
-                                (*reserved_pages)--;
-                                count ++;
-                        } else if (rc == -ENOLCK)
+                        /* If the page is inside the read-ahead window,
+                         * take it together with the pages following it
+                         * in the window. */
+                        for (nr = 1; nr < CL_PAGE_GANG_MAX &&
+                                     nr < *reserved_pages &&
+                                     page_idx + nr <= ria->ria_end &&
+                                     ras_inside_ra_window(page_idx + nr, ria);
+                             nr++)
+                                ;
+                        nr = ll_read_ahead_gang(env, io, queue, page_idx,
+                                                nr, mapping, rcs);
+                        for (i = 0; i < nr; i++) {
+                                if (rcs[i] == 1) {
+                                        (*reserved_pages)--;
+                                        count ++;
+                                }
+                        }
+                        page_idx += nr - 1;
+                        if (rcs[nr - 1] == -ENOLCK)
                                 break;
                 } else if (stride_ria) {
                         /* If it is not in the read-ahead window, and it is
@@ -417,6 +417,9 @@ struct lov_thread_info {
         union  lov_layout_state lti_state;
         struct cl_lock_closure  lti_closure;
         cfs_waitlink_t          lti_waiter;
+        /** sub-pages and slices of lov_page_gang_init_raid0() */
+        struct cl_page         *lti_gang_sub[CL_PAGE_GANG_MAX];
+        struct lov_page        *lti_gang_lpg[CL_PAGE_GANG_MAX];
 };
 
 /**
@@ -582,6 +585,11 @@ int   lov_sublock_modify  (const struct lu_env *env, struct lov_lock *lov,
 
 struct cl_page *lov_page_init   (const struct lu_env *env, struct cl_object *ob,
                                  struct cl_page *page, cfs_page_t *vmpage);
+void            lov_page_gang_init(const struct lu_env *env,
+                                   struct cl_object *obj,
+                                   struct cl_page **pages,
+                                   cfs_page_t **vmpages,
+                                   struct cl_page **result, int nr);
 struct cl_page *lovsub_page_init(const struct lu_env *env, struct cl_object *ob,
                                  struct cl_page *page, cfs_page_t *vmpage);
 
@@ -591,6 +599,16 @@ struct cl_page   *lov_page_init_empty(const struct lu_env *env,
 struct cl_page   *lov_page_init_raid0(const struct lu_env *env,
                                       struct cl_object *obj,
                                       struct cl_page *page, cfs_page_t *vmpage);
+void              lov_page_gang_init_empty(const struct lu_env *env,
+                                           struct cl_object *obj,
+                                           struct cl_page **pages,
+                                           cfs_page_t **vmpages,
+                                           struct cl_page **result, int nr);
+void              lov_page_gang_init_raid0(const struct lu_env *env,
+                                           struct cl_object *obj,
+                                           struct cl_page **pages,
+                                           cfs_page_t **vmpages,
+                                           struct cl_page **result, int nr);
 struct lu_object *lov_object_alloc   (const struct lu_env *env,
                                       const struct lu_object_header *hdr,
                                       struct lu_device *dev);
@@ -2648,7 +2648,7 @@ static int lov_set_info_async(struct obd_export *exp, obd_count keylen,
                 incr = sizeof(struct obd_id_info);
                 do_inactive = 1;
                 next_id = 1;
-        } else if (KEY_IS(KEY_CHECKSUM)) {
+        } else if (KEY_IS(KEY_CHECKSUM) || KEY_IS(KEY_EXTENT_KB)) {
                 do_inactive = 1;
         } else if (KEY_IS(KEY_EVICT_BY_NID)) {
                 /* use defaults:  do_inactive = incr = 0; */
@@ -69,6 +69,11 @@ struct lov_layout_operations {
                                          struct cl_object *obj,
                                          struct cl_page *page,
                                          cfs_page_t *vmpage);
+        void (*llo_page_gang_init)(const struct lu_env *env,
+                                   struct cl_object *obj,
+                                   struct cl_page **pages,
+                                   cfs_page_t **vmpages,
+                                   struct cl_page **result, int nr);
         int  (*llo_lock_init)(const struct lu_env *env,
                               struct cl_object *obj, struct cl_lock *lock,
                               const struct cl_io *io);
@@ -400,6 +405,7 @@ const static struct lov_layout_operations lov_dispatch[] = {
                 .llo_install   = lov_install_empty,
                 .llo_print     = lov_print_empty,
                 .llo_page_init = lov_page_init_empty,
+                .llo_page_gang_init = lov_page_gang_init_empty,
                 .llo_lock_init = NULL,
                 .llo_io_init   = lov_io_init_empty,
                 .llo_getattr   = lov_attr_get_empty
@@ -411,6 +417,7 @@ const static struct lov_layout_operations lov_dispatch[] = {
                 .llo_install   = lov_install_raid0,
                 .llo_print     = lov_print_raid0,
                 .llo_page_init = lov_page_init_raid0,
+                .llo_page_gang_init = lov_page_gang_init_raid0,
                 .llo_lock_init = lov_lock_init_raid0,
                 .llo_io_init   = lov_io_init_raid0,
                 .llo_getattr   = lov_attr_get_raid0
@@ -597,6 +604,14 @@ struct cl_page *lov_page_init(const struct lu_env *env, struct cl_object *obj,
                              llo_page_init, env, obj, page, vmpage);
 }
 
+void lov_page_gang_init(const struct lu_env *env, struct cl_object *obj,
+                        struct cl_page **pages, cfs_page_t **vmpages,
+                        struct cl_page **result, int nr)
+{
+        LOV_2DISPATCH_VOID(cl2lov(obj), llo_page_gang_init,
+                           env, obj, pages, vmpages, result, nr);
+}
+
 /**
  * Implements cl_object_operations::clo_io_init() method for lov
  * layer. Dispatches to the appropriate layout io initialization method.
@@ -651,6 +666,7 @@ int lov_lock_init(const struct lu_env *env, struct cl_object *obj,
 
 static const struct cl_object_operations lov_ops = {
         .coo_page_init = lov_page_init,
+        .coo_page_gang_init = lov_page_gang_init,
         .coo_lock_init = lov_lock_init,
         .coo_io_init   = lov_io_init,
         .coo_attr_get  = lov_attr_get,
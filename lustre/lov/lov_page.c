@@ -136,6 +136,42 @@ static void lov_empty_page_fini(const struct lu_env *env,
         EXIT;
 }
 
+/**
+ * Links \a page to its sub-page \a subpage just found in the stripe object.
+ * Returns what lov_page_init_raid0() returns.
+ */
+static struct cl_page *lov_page_sub_attach(const struct lu_env *env,
+                                           struct cl_page *page,
+                                           struct lov_page *lpg,
+                                           struct cl_page *subpage)
+{
+        struct cl_page *result;
+
+        if (IS_ERR(subpage))
+                return subpage;
+
+        if (likely(subpage->cp_parent == page)) {
+                lu_ref_add(&subpage->cp_reference, "lov", page);
+                lpg->lps_invalid = 0;
+                result = NULL;
+        } else {
+                /*
+                 * This is only possible when TRANSIENT page
+                 * is being created, and CACHEABLE sub-page
+                 * (attached to already existing top-page) has
+                 * been found. Tell cl_page_find() to use
+                 * existing page.
+                 */
+                LASSERT(subpage->cp_type == CPT_CACHEABLE);
+                LASSERT(page->cp_type == CPT_TRANSIENT);
+                /* TODO: this is problematic, what if the page is being freed? */
+                result = cl_page_top(subpage);
+                cl_page_get(result);
+                cl_page_put(env, subpage);
+        }
+        return result;
+}
+
 struct cl_page *lov_page_init_raid0(const struct lu_env *env,
                                     struct cl_object *obj, struct cl_page *page,
                                     cfs_page_t *vmpage)
@@ -176,34 +212,91 @@ struct cl_page *lov_page_init_raid0(const struct lu_env *env,
         subpage = cl_page_find_sub(sub->sub_env, subobj,
                                    cl_index(subobj, suboff), vmpage, page);
         lov_sub_put(sub);
-        if (IS_ERR(subpage))
-                GOTO(out, result = subpage);
-
-        if (likely(subpage->cp_parent == page)) {
-                lu_ref_add(&subpage->cp_reference, "lov", page);
-                lpg->lps_invalid = 0;
-                result = NULL;
-        } else {
-                /*
-                 * This is only possible when TRANSIENT page
-                 * is being created, and CACHEABLE sub-page
-                 * (attached to already existing top-page) has
-                 * been found. Tell cl_page_find() to use
-                 * existing page.
-                 */
-                LASSERT(subpage->cp_type == CPT_CACHEABLE);
-                LASSERT(page->cp_type == CPT_TRANSIENT);
-                /* TODO: this is problematic, what if the page is being freed? */
-                result = cl_page_top(subpage);
-                cl_page_get(result);
-                cl_page_put(env, subpage);
-        }
-
+        result = lov_page_sub_attach(env, page, lpg, subpage);
         EXIT;
 out:
         return(result);
 }
 
+/**
+ * Batched lov_page_init_raid0(): pages mapping to consecutive indices of the
+ * same stripe share a single lov_sub_get() and a cl_page_gang_find_sub()
+ * call.
+ */
+void lov_page_gang_init_raid0(const struct lu_env *env, struct cl_object *obj,
+                              struct cl_page **pages, cfs_page_t **vmpages,
+                              struct cl_page **result, int nr)
+{
+        struct lov_object       *loo = cl2lov(obj);
+        struct lov_layout_raid0 *r0  = lov_r0(loo);
+        struct lov_io           *lio = lov_env_io(env);
+        struct lov_thread_info  *lti = lov_env_info(env);
+        struct cl_page         **subpages = lti->lti_gang_sub;
+        struct lov_page        **lpgs = lti->lti_gang_lpg;
+        struct cl_object        *subobj = NULL;
+        struct lov_io_sub       *sub;
+        pgoff_t                  subidx = 0;
+        loff_t                   offset;
+        obd_off                  suboff;
+        int                      stripe = 0;
+        int                      failed;
+        int                      run;
+        int                      i;
+        int                      j;
+        int                      rc;
+        ENTRY;
+
+        LASSERT(nr <= CL_PAGE_GANG_MAX);
+        for (i = 0; i < nr; i += run + failed) {
+                failed = 0;
+                for (run = 0; i + run < nr; run++) {
+                        j = i + run;
+                        offset = cl_offset(obj, pages[j]->cp_index);
+                        rc = lov_stripe_number(r0->lo_lsm, offset);
+                        LASSERT(rc < r0->lo_nr);
+                        if (run > 0 && rc != stripe)
+                                break;
+                        stripe = rc;
+                        rc = lov_stripe_offset(r0->lo_lsm, offset, stripe,
+                                               &suboff);
+                        LASSERT(rc == 0);
+                        subobj = lovsub2cl(r0->lo_sub[stripe]);
+                        if (run == 0)
+                                subidx = cl_index(subobj, suboff);
+                        else if (cl_index(subobj, suboff) != subidx + run)
+                                break;
+
+                        OBD_SLAB_ALLOC_PTR_GFP(lpgs[j], lov_page_kmem,
+                                               CFS_ALLOC_IO);
+                        if (lpgs[j] == NULL) {
+                                result[j] = ERR_PTR(-ENOMEM);
+                                failed = 1;
+                                break;
+                        }
+                        lpgs[j]->lps_invalid = 1;
+                        cl_page_slice_add(pages[j], &lpgs[j]->lps_cl, obj,
+                                          &lov_page_ops);
+                }
+                if (run == 0)
+                        continue;
+
+                sub = lov_sub_get(env, lio, stripe);
+                if (IS_ERR(sub)) {
+                        for (j = i; j < i + run; j++)
+                                result[j] = (struct cl_page *)sub;
+                        continue;
+                }
+                cl_page_gang_find_sub(sub->sub_env, subobj, subidx,
+                                      vmpages + i, run, pages + i, subpages);
+                lov_sub_put(sub);
+                for (j = 0; j < run; j++)
+                        result[i + j] = lov_page_sub_attach(env, pages[i + j],
+                                                            lpgs[i + j],
+                                                            subpages[j]);
+        }
+        EXIT;
+}
+
 
 static const struct cl_page_operations lov_empty_page_ops = {
         .cpo_fini   = lov_empty_page_fini,
@@ -232,6 +325,17 @@ struct cl_page *lov_page_init_empty(const struct lu_env *env,
         RETURN(ERR_PTR(result));
 }
 
+void lov_page_gang_init_empty(const struct lu_env *env, struct cl_object *obj,
+                              struct cl_page **pages, cfs_page_t **vmpages,
+                              struct cl_page **result, int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; i++)
+                result[i] = lov_page_init_empty(env, obj, pages[i],
+                                                vmpages[i]);
+}
+
 
 /** @} lov */
 
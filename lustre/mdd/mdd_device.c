@@ -1254,7 +1254,8 @@ LU_KEY_INIT_FINI(mdd_ucred, struct md_ucred);
 static struct lu_context_key mdd_ucred_key = {
         .lct_tags = LCT_SESSION,
         .lct_init = mdd_ucred_key_init,
-        .lct_fini = mdd_ucred_key_fini
+        .lct_fini = mdd_ucred_key_fini,
+        .lct_size = sizeof(struct md_ucred)
 };
 
 struct md_ucred *md_ucred(const struct lu_env *env)
@@ -1273,7 +1274,8 @@ LU_KEY_INIT_FINI(mdd_capainfo, struct md_capainfo);
 struct lu_context_key mdd_capainfo_key = {
         .lct_tags = LCT_SESSION,
         .lct_init = mdd_capainfo_key_init,
-        .lct_fini = mdd_capainfo_key_fini
+        .lct_fini = mdd_capainfo_key_fini,
+        .lct_size = sizeof(struct md_capainfo)
 };
 
 struct md_capainfo *md_capainfo(const struct lu_env *env)
@@ -1294,7 +1296,8 @@ LU_KEY_INIT_FINI(mdd_quota, struct md_quota);
 struct lu_context_key mdd_quota_key = {
         .lct_tags = LCT_SESSION,
         .lct_init = mdd_quota_key_init,
-        .lct_fini = mdd_quota_key_fini
+        .lct_fini = mdd_quota_key_fini,
+        .lct_size = sizeof(struct md_quota)
 };
 
 struct md_quota *md_quota(const struct lu_env *env)
@@ -3881,7 +3881,8 @@ static int mdt_start_ptlrpc_service(struct mdt_device *m)
                  */
                 .psc_min_threads     = mdt_min_threads,
                 .psc_max_threads     = mdt_max_threads,
-                .psc_ctx_tags        = LCT_MD_THREAD
+                .psc_ctx_tags        = LCT_MD_THREAD,
+                .psc_cpt_mode        = PTLRPC_SVC_CPT_PART
         };
 
         m->mdt_ldlm_client = &m->mdt_md_dev.md_lu_dev.ld_obd->obd_ldlm_client;
@@ -3913,7 +3914,8 @@ static int mdt_start_ptlrpc_service(struct mdt_device *m)
                 .psc_watchdog_factor = MDT_SERVICE_WATCHDOG_FACTOR,
                 .psc_min_threads     = mdt_min_threads,
                 .psc_max_threads     = mdt_max_threads,
-                .psc_ctx_tags        = LCT_MD_THREAD
+                .psc_ctx_tags        = LCT_MD_THREAD,
+                .psc_cpt_mode        = PTLRPC_SVC_CPT_PART
         };
         m->mdt_readpage_service =
                 ptlrpc_init_svc_conf(&conf, mdt_readpage_handle,
@@ -4830,6 +4832,14 @@ static int mdt_object_init(const struct lu_env *env, struct lu_object *o,
         RETURN(rc);
 }
 
+static void mdt_object_free_cb(cfs_rcu_head_t *head)
+{
+        struct mdt_object *mo;
+
+        mo = container_of(head, struct mdt_object, mot_header.loh_rcu);
+        OBD_FREE_PTR(mo);
+}
+
 static void mdt_object_free(const struct lu_env *env, struct lu_object *o)
 {
         struct mdt_object *mo = mdt_obj(o);
@@ -4842,7 +4852,7 @@ static void mdt_object_free(const struct lu_env *env, struct lu_object *o)
 
         lu_object_fini(o);
         lu_object_header_fini(h);
-        OBD_FREE_PTR(mo);
+        my_call_rcu(&h->loh_rcu, mdt_object_free_cb);
         EXIT;
 }
 
@@ -5792,6 +5802,8 @@ static void __exit mdt_mod_exit(void)
 {
         llo_local_obj_unregister(&mdt_last_recv);
         class_unregister_type(LUSTRE_MDT_NAME);
+        /* wait for mdt_object_free_cb() */
+        my_rcu_barrier();
 }
 
 
@@ -112,8 +112,12 @@ int mdt_procfs_init(struct mdt_device *mdt, const char *name)
                                    "clear", lprocfs_nid_stats_clear_read,
                                    lprocfs_nid_stats_clear_write, obd, NULL);
         rc = lprocfs_alloc_md_stats(obd, LPROC_MDT_LAST);
-        if (rc == 0)
-                mdt_stats_counter_init(obd->md_stats);
+        if (rc)
+                RETURN(rc);
+        mdt_stats_counter_init(obd->md_stats);
+
+        rc = lprocfs_job_stats_init(obd, EXTRA_MAX_OPCODES + LUSTRE_MAX_OPCODES,
+                                    ptlrpc_lprocfs_job_cntr_init);
 
         RETURN(rc);
 }
@@ -123,6 +127,7 @@ int mdt_procfs_fini(struct mdt_device *mdt)
         struct lu_device *ld = &mdt->mdt_md_dev.md_lu_dev;
         struct obd_device *obd = ld->ld_obd;
 
+        lprocfs_job_stats_fini(obd);
         if (mdt->mdt_proc_entry) {
                 lu_time_fini(&ld->ld_site->ls_time_stats);
                 lu_time_fini(&mdt->mdt_stats);
@@ -97,6 +97,15 @@ struct cl_thread_info {
          * Fields used by cl_page.c
          */
         struct cl_page      *clt_pvec[CLT_PVEC_SIZE];
+        /**
+         * Scratch space of cl_page_gang_find(): pages being created, their
+         * VM pages, what ->coo_page_gang_init() returned for them, and their
+         * slots in the caller's array.
+         */
+        struct cl_page      *clt_gang_page[CL_PAGE_GANG_MAX];
+        cfs_page_t          *clt_gang_vmpage[CL_PAGE_GANG_MAX];
+        struct cl_page      *clt_gang_result[CL_PAGE_GANG_MAX];
+        int                  clt_gang_slot[CL_PAGE_GANG_MAX];
 
         /*
          * Fields used by cl_io.c
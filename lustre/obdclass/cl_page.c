@@ -323,18 +323,15 @@ static inline void cl_page_state_set_trust(struct cl_page *page,
         *(enum cl_page_state *)&page->cp_state = state;
 }
 
-static int cl_page_alloc(const struct lu_env *env, struct cl_object *o,
-                         pgoff_t ind, struct page *vmpage,
-                         enum cl_page_type type, struct cl_page **out)
+/**
+ * Allocates a cl_page with index \a ind at the object \a o, without calling
+ * any of the layers' page initializers.
+ */
+static struct cl_page *cl_page_new(struct cl_object *o, pgoff_t ind,
+                                   enum cl_page_type type)
 {
-        struct cl_page          *page;
-        struct cl_page          *err  = NULL;
-        struct lu_object_header *head;
-        struct cl_site          *site = cl_object_site(o);
-        int                      result;
+        struct cl_page *page;
 
-        ENTRY;
-        result = +1;
         OBD_SLAB_ALLOC_PTR_GFP(page, cl_page_kmem, CFS_ALLOC_IO);
         if (page != NULL) {
                 cfs_atomic_set(&page->cp_ref, 1);
@@ -350,6 +347,38 @@ static int cl_page_alloc(const struct lu_env *env, struct cl_object *o,
                 CFS_INIT_LIST_HEAD(&page->cp_flight);
                 cfs_mutex_init(&page->cp_mutex);
                 lu_ref_init(&page->cp_reference);
+        }
+        return page;
+}
+
+/**
+ * Accounts \a nr pages completely initialized by all layers.
+ */
+static void cl_page_created(struct cl_site *site, int nr)
+{
+        cfs_atomic_add(nr, &site->cs_pages.cs_busy);
+        cfs_atomic_add(nr, &site->cs_pages.cs_total);
+
+#ifdef LUSTRE_PAGESTATE_TRACKING
+        cfs_atomic_add(nr, &site->cs_pages_state[CPS_CACHED]);
+#endif
+        cfs_atomic_add(nr, &site->cs_pages.cs_created);
+}
+
+static int cl_page_alloc(const struct lu_env *env, struct cl_object *o,
+                         pgoff_t ind, struct page *vmpage,
+                         enum cl_page_type type, struct cl_page **out)
+{
+        struct cl_page          *page;
+        struct cl_page          *err  = NULL;
+        struct lu_object_header *head;
+        struct cl_site          *site = cl_object_site(o);
+        int                      result;
+
+        ENTRY;
+        result = +1;
+        page = cl_page_new(o, ind, type);
+        if (page != NULL) {
                 head = o->co_lu.lo_header;
                 cfs_list_for_each_entry(o, &head->loh_layers,
                                         co_lu.lo_linkage) {
@@ -366,13 +395,7 @@ static int cl_page_alloc(const struct lu_env *env, struct cl_object *o,
                         }
                 }
                 if (err == NULL) {
-                        cfs_atomic_inc(&site->cs_pages.cs_busy);
-                        cfs_atomic_inc(&site->cs_pages.cs_total);
-
-#ifdef LUSTRE_PAGESTATE_TRACKING
-                        cfs_atomic_inc(&site->cs_pages_state[CPS_CACHED]);
-#endif
-                        cfs_atomic_inc(&site->cs_pages.cs_created);
+                        cl_page_created(site, 1);
                         result = 0;
                 }
         } else
@@ -523,6 +546,165 @@ struct cl_page *cl_page_find_sub(const struct lu_env *env, struct cl_object *o,
 }
 EXPORT_SYMBOL(cl_page_find_sub);
 
+/**
+ * Batched version of cl_page_find0() for \a nr CPT_CACHEABLE pages with
+ * consecutive indices starting at \a idx.
+ *
+ * Pages missing from the cache are allocated together, initialized by every
+ * layer through cl_object_operations::coo_page_gang_init() where a layer has
+ * it, and inserted into the radix tree under a single hold of
+ * cl_object_header::coh_page_guard.
+ */
+static void cl_page_gang_find0(const struct lu_env *env, struct cl_object *o,
+                               pgoff_t idx, struct page **vmpages, int nr,
+                               struct cl_page **parents,
+                               struct cl_page **pages)
+{
+        struct cl_thread_info   *info   = cl_env_info(env);
+        struct cl_page         **fresh  = info->clt_gang_page;
+        cfs_page_t             **vmpage = info->clt_gang_vmpage;
+        struct cl_page         **result = info->clt_gang_result;
+        int                     *slot   = info->clt_gang_slot;
+        struct cl_object_header *hdr    = cl_object_header(o);
+        struct cl_site          *site   = cl_object_site(o);
+        struct lu_object_header *head   = o->co_lu.lo_header;
+        struct cl_object        *obj;
+        struct cl_page          *page;
+        int                      ghosts = 0;
+        int                      hit    = 0;
+        int                      n      = 0;
+        int                      err;
+        int                      i;
+        int                      j;
+
+        LASSERT(0 < nr && nr <= CL_PAGE_GANG_MAX);
+        cfs_might_sleep();
+
+        ENTRY;
+
+        cfs_atomic_add(nr, &site->cs_pages.cs_lookup);
+        CDEBUG(D_PAGE, "%lu@"DFID" %d\n", idx, PFID(&hdr->coh_lu.loh_fid), nr);
+        for (i = 0; i < nr; i++) {
+                /* fast path, see cl_page_find0(). */
+                page = cl_vmpage_page(vmpages[i], o);
+                if (page != NULL) {
+                        hit++;
+                } else {
+                        page = cl_page_new(o, idx + i, CPT_CACHEABLE);
+                        if (page != NULL) {
+                                fresh[n]  = page;
+                                vmpage[n] = vmpages[i];
+                                slot[n]   = i;
+                                n++;
+                        } else
+                                page = ERR_PTR(-ENOMEM);
+                }
+                pages[i] = page;
+        }
+        cfs_atomic_add(hit, &site->cs_pages.cs_hit);
+
+        cfs_list_for_each_entry(obj, &head->loh_layers, co_lu.lo_linkage) {
+                if (n == 0)
+                        break;
+                if (obj->co_ops->coo_page_gang_init != NULL) {
+                        obj->co_ops->coo_page_gang_init(env, obj, fresh,
+                                                        vmpage, result, n);
+                } else if (obj->co_ops->coo_page_init != NULL) {
+                        for (i = 0; i < n; i++)
+                                result[i] = obj->co_ops->coo_page_init(env,
+                                                        obj, fresh[i],
+                                                        vmpage[i]);
+                } else
+                        continue;
+                /*
+                 * Free pages the layer failed to initialize or replaced by
+                 * existing ones, and squeeze them out of the batch.
+                 */
+                for (i = j = 0; i < n; i++) {
+                        if (result[i] != NULL) {
+                                cl_page_state_set_trust(fresh[i], CPS_FREEING);
+                                cl_page_free(env, fresh[i]);
+                                pages[slot[i]] = result[i];
+                        } else {
+                                fresh[j]  = fresh[i];
+                                vmpage[j] = vmpage[i];
+                                slot[j]   = slot[i];
+                                j++;
+                        }
+                }
+                n = j;
+        }
+        cl_page_created(site, n);
+
+        cfs_spin_lock(&hdr->coh_page_guard);
+        for (i = 0; i < n; i++) {
+                page = fresh[i];
+                err = radix_tree_insert(&hdr->coh_tree, page->cp_index, page);
+                if (err == 0) {
+                        if (parents != NULL) {
+                                LASSERT(page->cp_parent == NULL);
+                                page->cp_parent = parents[slot[i]];
+                                parents[slot[i]]->cp_child = page;
+                        }
+                        hdr->coh_pages++;
+                        fresh[i] = NULL;
+                        continue;
+                }
+                /* lost a race, see cl_page_find0(). */
+                if (err == -EEXIST) {
+                        page = cl_page_lookup(hdr, page->cp_index);
+                        PASSERT(env, page, page != NULL);
+                } else
+                        page = ERR_PTR(err);
+                pages[slot[i]] = page;
+                ghosts++;
+        }
+        cfs_spin_unlock(&hdr->coh_page_guard);
+
+        for (i = 0; ghosts > 0 && i < n; i++) {
+                if (fresh[i] == NULL)
+                        continue;
+                ghosts--;
+                cfs_atomic_dec(&site->cs_pages.cs_busy);
+                cl_page_delete0(env, fresh[i], 0);
+                cl_page_free(env, fresh[i]);
+                page = pages[slot[i]];
+                if (!IS_ERR(page) && page->cp_type == CPT_TRANSIENT) {
+                        cl_page_put(env, page);
+                        pages[slot[i]] = ERR_PTR(-EBUSY);
+                }
+        }
+        EXIT;
+}
+
+/**
+ * Looks up or creates cl_pages for \a nr locked VM pages \a vmpages, having
+ * consecutive indices starting at \a idx, at the object \a o.
+ *
+ * This is equivalent to calling cl_page_find(..., CPT_CACHEABLE) for every
+ * page, but creates missing pages in a batch. On return \a pages[i] is a
+ * referenced page for \a vmpages[i], or an ERR_PTR() if that page could not
+ * be created. At most CL_PAGE_GANG_MAX pages can be requested at a time.
+ *
+ * \see cl_page_find()
+ */
+void cl_page_gang_find(const struct lu_env *env, struct cl_object *o,
+                       pgoff_t idx, struct page **vmpages, int nr,
+                       struct cl_page **pages)
+{
+        cl_page_gang_find0(env, o, idx, vmpages, nr, NULL, pages);
+}
+EXPORT_SYMBOL(cl_page_gang_find);
+
+void cl_page_gang_find_sub(const struct lu_env *env, struct cl_object *o,
+                           pgoff_t idx, struct page **vmpages, int nr,
+                           struct cl_page **parents, struct cl_page **pages)
+{
+        LASSERT(parents[0]->cp_type == CPT_CACHEABLE);
+        cl_page_gang_find0(env, o, idx, vmpages, nr, parents, pages);
+}
+EXPORT_SYMBOL(cl_page_gang_find_sub);
+
 static inline int cl_page_invariant(const struct cl_page *pg)
 {
         struct cl_object_header *header;
@@ -49,6 +49,7 @@
 #include <lnet/lnetctl.h>
 #include <lustre_debug.h>
 #include <lprocfs_status.h>
+#include <obd_cksum.h>
 #include <lustre/lustre_build_version.h>
 #include <libcfs/list.h>
 #include "llog_internal.h"
@@ -82,6 +83,7 @@ unsigned int at_max = 600;
 unsigned int at_history = 600;
 int at_early_margin = 5;
 int at_extra = 30;
+char obd_jobid_var[JOBSTATS_JOBID_VAR_MAX_LEN + 1] = JOBSTATS_DISABLE;
 
 cfs_atomic_t obd_dirty_pages;
 cfs_atomic_t obd_dirty_transit_pages;
@@ -97,6 +99,119 @@ unsigned long obd_print_fail_loc(void)
 }
 #endif
 
+#ifdef __KERNEL__
+/*
+ * lustre_get_jobid() runs for every RPC, while the environment of a process
+ * practically never changes, so the jobid read from it is cached per pid.
+ * The cache is direct-mapped on the pid; an entry expires after
+ * OBD_JOBID_CACHE_AGE seconds, which also bounds how long a reused pid can
+ * see the jobid of its previous owner.
+ */
+#define OBD_JOBID_CACHE_SIZE    64
+#define OBD_JOBID_CACHE_AGE     30
+
+struct obd_jobid_cache_entry {
+        pid_t           jce_pid;
+        cfs_time_t      jce_expire;
+        char            jce_jobid[LUSTRE_JOBID_SIZE];
+};
+
+static struct obd_jobid_cache_entry obd_jobid_cache[OBD_JOBID_CACHE_SIZE];
+static cfs_spinlock_t obd_jobid_cache_lock = CFS_SPIN_LOCK_UNLOCKED;
+
+static inline struct obd_jobid_cache_entry *obd_jobid_cache_slot(pid_t pid)
+{
+        return &obd_jobid_cache[pid & (OBD_JOBID_CACHE_SIZE - 1)];
+}
+
+static int obd_jobid_cache_get(pid_t pid, char *jobid)
+{
+        struct obd_jobid_cache_entry *jce = obd_jobid_cache_slot(pid);
+        int                           found = 0;
+
+        cfs_spin_lock(&obd_jobid_cache_lock);
+        if (jce->jce_pid == pid && jce->jce_expire != 0 &&
+            cfs_time_before(cfs_time_current(), jce->jce_expire)) {
+                memcpy(jobid, jce->jce_jobid, LUSTRE_JOBID_SIZE);
+                found = 1;
+        }
+        cfs_spin_unlock(&obd_jobid_cache_lock);
+        return found;
+}
+
+static void obd_jobid_cache_set(pid_t pid, const char *jobid)
+{
+        struct obd_jobid_cache_entry *jce = obd_jobid_cache_slot(pid);
+
+        cfs_spin_lock(&obd_jobid_cache_lock);
+        jce->jce_pid = pid;
+        jce->jce_expire = cfs_time_shift(OBD_JOBID_CACHE_AGE);
+        memcpy(jce->jce_jobid, jobid, LUSTRE_JOBID_SIZE);
+        cfs_spin_unlock(&obd_jobid_cache_lock);
+}
+#endif
+
+/**
+ * Forget all cached jobids, e.g. because obd_jobid_var has changed.
+ */
+void obd_jobid_cache_flush(void)
+{
+#ifdef __KERNEL__
+        cfs_spin_lock(&obd_jobid_cache_lock);
+        memset(obd_jobid_cache, 0, sizeof(obd_jobid_cache));
+        cfs_spin_unlock(&obd_jobid_cache_lock);
+#endif
+}
+EXPORT_SYMBOL(obd_jobid_cache_flush);
+
+/**
+ * Fill \a jobid (LUSTRE_JOBID_SIZE bytes) with the job identifier of the
+ * calling process, as named by obd_jobid_var.  It is left empty when job
+ * stats are disabled or the process has no such variable set.
+ */
+int lustre_get_jobid(char *jobid)
+{
+        int rc = 0;
+        ENTRY;
+
+        memset(jobid, 0, LUSTRE_JOBID_SIZE);
+        if (strcmp(obd_jobid_var, JOBSTATS_DISABLE) == 0)
+                RETURN(0);
+
+        if (strcmp(obd_jobid_var, JOBSTATS_PROCNAME_UID) == 0) {
+                snprintf(jobid, LUSTRE_JOBID_SIZE, "%s.%u",
+                         cfs_curproc_comm(), cfs_curproc_uid());
+                RETURN(0);
+        }
+
+#ifdef __KERNEL__
+        if (obd_jobid_cache_get(cfs_curproc_pid(), jobid))
+                RETURN(0);
+
+        rc = cfs_get_environ(obd_jobid_var, jobid, LUSTRE_JOBID_SIZE);
+        if (rc != 0) {
+                CDEBUG(D_INFO, "no %s in the environment: rc = %d\n",
+                       obd_jobid_var, rc);
+                jobid[0] = '\0';
+        }
+        /* mmap_sem was busy: try again on the next RPC rather than caching
+         * an empty jobid for the whole cache lifetime */
+        if (rc != -EDEADLK)
+                obd_jobid_cache_set(cfs_curproc_pid(), jobid);
+        /* a missing variable is not an error for the caller */
+        rc = 0;
+#else
+        {
+                char *env = getenv(obd_jobid_var);
+
+                if (env != NULL)
+                        strncpy(jobid, env, LUSTRE_JOBID_SIZE - 1);
+        }
+#endif
+        RETURN(rc);
+}
+EXPORT_SYMBOL(lustre_get_jobid);
+
 static inline void obd_data2conn(struct lustre_handle *conn,
                                  struct obd_ioctl_data *data)
 {
@@ -378,6 +493,7 @@ EXPORT_SYMBOL(at_max);
 EXPORT_SYMBOL(at_extra);
 EXPORT_SYMBOL(at_early_margin);
 EXPORT_SYMBOL(at_history);
+EXPORT_SYMBOL(obd_jobid_var);
 EXPORT_SYMBOL(ptlrpc_put_connection_superhack);
 
 EXPORT_SYMBOL(proc_lustre_root);
@@ -576,6 +692,10 @@ int init_obdclass(void)
         err = obd_init_caches();
         if (err)
                 return err;
+
+        err = obd_cksum_init();
+        if (err)
+                return err;
 #ifdef __KERNEL__
         err = class_procfs_init();
         if (err)
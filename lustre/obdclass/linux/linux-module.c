@@ -317,6 +317,30 @@ static int obd_proc_read_health(char *page, char **start, off_t off,
         return rc;
 }
 
+static int obd_proc_read_jobid_var(char *page, char **start, off_t off,
+                                   int count, int *eof, void *data)
+{
+        *eof = 1;
+        return snprintf(page, count, "%s\n", obd_jobid_var);
+}
+
+static int obd_proc_write_jobid_var(struct file *file, const char *buffer,
+                                    unsigned long count, void *data)
+{
+        if (count == 0 || count > JOBSTATS_JOBID_VAR_MAX_LEN)
+                return -EINVAL;
+
+        memset(obd_jobid_var, 0, JOBSTATS_JOBID_VAR_MAX_LEN + 1);
+        if (cfs_copy_from_user(obd_jobid_var, buffer, count))
+                return -EFAULT;
+        /* strip the trailing newline echo(1) adds */
+        if (obd_jobid_var[count - 1] == '\n')
+                obd_jobid_var[count - 1] = '\0';
+        obd_jobid_cache_flush();
+
+        return count;
+}
+
 /* Root for /proc/fs/lustre */
 struct proc_dir_entry *proc_lustre_root = NULL;
 
@@ -324,6 +348,8 @@ struct lprocfs_vars lprocfs_base[] = {
         { "version", obd_proc_read_version, NULL, NULL },
         { "pinger", obd_proc_read_pinger, NULL, NULL },
         { "health_check", obd_proc_read_health, NULL, NULL },
+        { "jobid_var", obd_proc_read_jobid_var,
+                       obd_proc_write_jobid_var, NULL },
         { 0 }
 };
 #else
@@ -0,0 +1,518 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * lustre/obdclass/lprocfs_jobstats.c
+ *
+ * Per-job RPC statistics of a target.
+ *
+ * Clients tag each RPC with the job id of the process that issued it (see
+ * lustre_get_jobid()).  A target keeps one struct job_stat per job id it has
+ * seen, hashed by job id, holding a copy of the service counters plus a log2
+ * histogram of RPC service times.  Entries nobody logged to for
+ * ojs_cleanup_interval seconds are dropped, so the hash only tracks jobs
+ * that are actually running.
+ */
+
+#ifndef EXPORT_SYMTAB
+# define EXPORT_SYMTAB
+#endif
+#define DEBUG_SUBSYSTEM S_CLASS
+
+#ifndef __KERNEL__
+# include <liblustre.h>
+#endif
+
+#include <obd_class.h>
+#include <lprocfs_status.h>
+#include <lustre/lustre_idl.h>
+
+#if defined(LPROCFS)
+
+/* default idle time before a job's stats are dropped, seconds */
+#define JOB_CLEANUP_INTERVAL_DEFAULT    600
+
+struct job_stat {
+        cfs_hlist_node_t        js_hash;
+        cfs_list_t              js_list;
+        cfs_atomic_t            js_refcount;
+        char                    js_jobid[LUSTRE_JOBID_SIZE];
+        /** last time anything was logged, seconds */
+        time_t                  js_timestamp;
+        struct lprocfs_stats   *js_stats;
+        /** RPC service times, log2 usec */
+        struct obd_histogram    js_svc_hist;
+        struct obd_job_stats   *js_jobstats;
+};
+
+static void job_free(struct job_stat *job)
+{
+        LASSERT(cfs_atomic_read(&job->js_refcount) == 0);
+        LASSERT(job->js_jobstats != NULL);
+
+        cfs_write_lock(&job->js_jobstats->ojs_lock);
+        cfs_list_del_init(&job->js_list);
+        cfs_write_unlock(&job->js_jobstats->ojs_lock);
+
+        lprocfs_free_stats(&job->js_stats);
+        OBD_FREE_PTR(job);
+}
+
+static void job_putref(struct job_stat *job)
+{
+        LASSERT(cfs_atomic_read(&job->js_refcount) > 0);
+        if (cfs_atomic_dec_and_test(&job->js_refcount))
+                job_free(job);
+}
+
+/*
+ * jobid<->job_stat hash operations
+ */
+
+static unsigned
+job_stat_hash(cfs_hash_t *hs, void *key, unsigned mask)
+{
+        return cfs_hash_djb2_hash(key, strlen(key), mask);
+}
+
+static void *
+job_stat_key(cfs_hlist_node_t *hnode)
+{
+        struct job_stat *job;
+
+        job = cfs_hlist_entry(hnode, struct job_stat, js_hash);
+        return job->js_jobid;
+}
+
+static int
+job_stat_keycmp(void *key, cfs_hlist_node_t *hnode)
+{
+        struct job_stat *job;
+
+        job = cfs_hlist_entry(hnode, struct job_stat, js_hash);
+        return strncmp(job->js_jobid, key, LUSTRE_JOBID_SIZE) == 0;
+}
+
+static void *
+job_stat_object(cfs_hlist_node_t *hnode)
+{
+        return cfs_hlist_entry(hnode, struct job_stat, js_hash);
+}
+
+static void
+job_stat_get(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
+{
+        struct job_stat *job;
+
+        job = cfs_hlist_entry(hnode, struct job_stat, js_hash);
+        cfs_atomic_inc(&job->js_refcount);
+}
+
+static void
+job_stat_put_locked(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
+{
+        struct job_stat *job;
+
+        job = cfs_hlist_entry(hnode, struct job_stat, js_hash);
+        job_putref(job);
+}
+
+static cfs_hash_ops_t job_stats_hash_ops = {
+        .hs_hash        = job_stat_hash,
+        .hs_key         = job_stat_key,
+        .hs_keycmp      = job_stat_keycmp,
+        .hs_object      = job_stat_object,
+        .hs_get         = job_stat_get,
+        .hs_put_locked  = job_stat_put_locked,
+};
+
+/* cfs_hash_cond_del() callback: drop jobs idle since \a data */
+static int job_cleanup_iter_cb(void *obj, void *data)
+{
+        struct job_stat *job = obj;
+        time_t           oldest = *(time_t *)data;
+
+        return job->js_timestamp < oldest;
+}
+
+static void lprocfs_job_cleanup(struct obd_job_stats *stats, int force)
+{
+        time_t now = cfs_time_current_sec();
+        time_t oldest;
+
+        if (!force && now < stats->ojs_last_cleanup +
+                            stats->ojs_cleanup_interval)
+                return;
+
+        /* racy, but keeps concurrent loggers from all scanning the hash */
+        stats->ojs_last_cleanup = now;
+        oldest = force ? now + 1 : now - stats->ojs_cleanup_interval;
+        cfs_hash_cond_del(stats->ojs_hash, job_cleanup_iter_cb, &oldest);
+}
+
+static struct job_stat *job_alloc(char *jobid, struct obd_job_stats *jobs)
+{
+        struct job_stat *job;
+
+        OBD_ALLOC_PTR(job);
+        if (job == NULL)
+                return NULL;
+
+        job->js_stats = lprocfs_alloc_stats(jobs->ojs_cntr_num,
+                                            LPROCFS_STATS_FLAG_NOPERCPU);
+        if (job->js_stats == NULL) {
+                OBD_FREE_PTR(job);
+                return NULL;
+        }
+        jobs->ojs_cntr_init_fn(job->js_stats);
+
+        cfs_spin_lock_init(&job->js_svc_hist.oh_lock);
+        strncpy(job->js_jobid, jobid, LUSTRE_JOBID_SIZE - 1);
+        job->js_timestamp = cfs_time_current_sec();
+        job->js_jobstats = jobs;
+        CFS_INIT_HLIST_NODE(&job->js_hash);
+        CFS_INIT_LIST_HEAD(&job->js_list);
+        cfs_atomic_set(&job->js_refcount, 1);
+
+        return job;
+}
+
+/**
+ * Account \a amount to counter \a event of job \a jobid on \a obd.
+ *
+ * The counter layout is that of obd_svc_stats: events from
+ * EXTRA_MAX_OPCODES on are RPC service times in usec and are also tallied
+ * into the job's service time histogram.
+ */
+void lprocfs_job_stats_log(struct obd_device *obd, char *jobid,
+                           int event, long amount)
+{
+        struct obd_job_stats *stats = &obd->obd_jobstats;
+        struct job_stat      *job, *job2;
+        ENTRY;
+
+        if (stats->ojs_hash == NULL || jobid == NULL ||
+            strlen(jobid) >= LUSTRE_JOBID_SIZE)
+                RETURN_EXIT;
+
+        LASSERT(event >= 0 && event < stats->ojs_cntr_num);
+
+        lprocfs_job_cleanup(stats, 0);
+
+        job = cfs_hash_lookup(stats->ojs_hash, jobid);
+        if (job != NULL)
+                goto found;
+
+        job = job_alloc(jobid, stats);
+        if (job == NULL)
+                RETURN_EXIT;
+
+        job2 = cfs_hash_findadd_unique(stats->ojs_hash, job->js_jobid,
+                                       &job->js_hash);
+        if (job2 != job) {
+                /* somebody else added it meanwhile */
+                job_putref(job);
+                job = job2;
+        } else {
+                /* the hash holds the initial reference now */
+                cfs_write_lock(&stats->ojs_lock);
+                cfs_list_add_tail(&job->js_list, &stats->ojs_list);
+                cfs_write_unlock(&stats->ojs_lock);
+        }
+
+found:
+        LASSERT(stats == job->js_jobstats);
+        job->js_timestamp = cfs_time_current_sec();
+        lprocfs_counter_add(job->js_stats, event, amount);
+        if (event >= EXTRA_MAX_OPCODES)
+                lprocfs_oh_tally_log2(&job->js_svc_hist, amount);
+
+        job_putref(job);
+        EXIT;
+}
+EXPORT_SYMBOL(lprocfs_job_stats_log);
+
+void lprocfs_job_stats_fini(struct obd_device *obd)
+{
+        struct obd_job_stats *stats = &obd->obd_jobstats;
+
+        if (stats->ojs_hash == NULL)
+                return;
+
+        lprocfs_remove_proc_entry("job_cleanup_interval",
+                                  obd->obd_proc_entry);
+        lprocfs_remove_proc_entry("job_stats", obd->obd_proc_entry);
+
+        lprocfs_job_cleanup(stats, 1);
+        cfs_hash_putref(stats->ojs_hash);
+        stats->ojs_hash = NULL;
+        LASSERT(cfs_list_empty(&stats->ojs_list));
+}
+EXPORT_SYMBOL(lprocfs_job_stats_fini);
+
+static void *lprocfs_jobstats_seq_start(struct seq_file *p, loff_t *pos)
+{
+        struct obd_job_stats *stats = p->private;
+        loff_t                off = *pos;
+        struct job_stat      *job;
+
+        cfs_read_lock(&stats->ojs_lock);
+        if (off == 0)
+                return SEQ_START_TOKEN;
+        off--;
+        cfs_list_for_each_entry(job, &stats->ojs_list, js_list) {
+                if (!off--)
+                        return job;
+        }
+        return NULL;
+}
+
+static void lprocfs_jobstats_seq_stop(struct seq_file *p, void *v)
+{
+        struct obd_job_stats *stats = p->private;
+
+        cfs_read_unlock(&stats->ojs_lock);
+}
+
+static void *lprocfs_jobstats_seq_next(struct seq_file *p, void *v, loff_t *pos)
+{
+        struct obd_job_stats *stats = p->private;
+        struct job_stat      *job;
+        cfs_list_t           *next;
+
+        ++*pos;
+        if (v == SEQ_START_TOKEN) {
+                next = stats->ojs_list.next;
+        } else {
+                job = (struct job_stat *)v;
+                next = job->js_list.next;
+        }
+
+        return next == &stats->ojs_list ? NULL :
+                cfs_list_entry(next, struct job_stat, js_list);
+}
+
+/*
+ * Example of output on a target:
+ *
+ * job_stats:
+ * - job_id:        dd.0
+ *   snapshot_time: 1322494486
+ *   ost_write:     { samples: 10, unit: usec, min: 120, max: 950, sum: 3200 }
+ *   write_bytes:   { samples: 10, unit: bytes, min: 1048576, max: 1048576, sum: 10485760 }
+ *   svc_time_usec: { 128: 4, 256: 5, 512: 1 }
+ */
+static int lprocfs_jobstats_seq_show(struct seq_file *p, void *v)
+{
+        struct job_stat        *job = v;
+        struct lprocfs_stats   *s;
+        struct lprocfs_counter  ret;
+        struct lprocfs_counter_header *cntr;
+        struct obd_histogram   *hist;
+        int                     i, first, width;
+
+        if (v == SEQ_START_TOKEN) {
+                seq_printf(p, "job_stats:\n");
+                return 0;
+        }
+
+        seq_printf(p, "- %-16s %s\n", "job_id:", job->js_jobid);
+        seq_printf(p, "  %-16s %ld\n", "snapshot_time:", job->js_timestamp);
+
+        s = job->js_stats;
+        for (i = 0; i < s->ls_num; i++) {
+                cntr = &s->ls_cnt_header[i];
+                if (cntr->lc_name == NULL)
+                        continue;
+                lprocfs_stats_collect(s, i, &ret);
+                if (ret.lc_count == 0)
+                        continue;
+
+                width = strlen(cntr->lc_name) < 16 ?
+                        16 - strlen(cntr->lc_name) : 1;
+                seq_printf(p, "  %s:%*s{ samples: %11"LPF64"u, unit: %5s, "
+                           "min: %8"LPF64"u, max: %10"LPF64"u, "
+                           "sum: %16"LPF64"u }\n", cntr->lc_name,
+                           width, "", ret.lc_count, cntr->lc_units,
+                           ret.lc_min, ret.lc_max, ret.lc_sum);
+        }
+
+        hist = &job->js_svc_hist;
+        seq_printf(p, "  %-16s {", "svc_time_usec:");
+        for (i = 0, first = 1; i < OBD_HIST_MAX; i++) {
+                unsigned long n = lprocfs_oh_counter(hist, i);
+
+                if (n == 0)
+                        continue;
+                seq_printf(p, "%s %lu: %lu", first ? "" : ",",
+                           1UL << i, n);
+                first = 0;
+        }
+        seq_printf(p, " }\n");
+
+        return 0;
+}
+
+static struct seq_operations lprocfs_jobstats_seq_sops = {
+        start: lprocfs_jobstats_seq_start,
+        stop:  lprocfs_jobstats_seq_stop,
+        next:  lprocfs_jobstats_seq_next,
+        show:  lprocfs_jobstats_seq_show,
+};
+
+static int lprocfs_jobstats_seq_open(struct inode *inode, struct file *file)
+{
+        struct proc_dir_entry *dp = PDE(inode);
+        struct seq_file *seq;
+        int rc;
+
+        if (LPROCFS_ENTRY_AND_CHECK(dp))
+                return -ENOENT;
+
+        rc = seq_open(file, &lprocfs_jobstats_seq_sops);
+        if (rc) {
+                LPROCFS_EXIT();
+                return rc;
+        }
+        seq = file->private_data;
+        seq->private = dp->data;
+        return 0;
+}
+
+/* "clear" drops all jobs, anything else the job with that id if known */
+static ssize_t lprocfs_jobstats_seq_write(struct file *file, const char *buf,
+                                          size_t len, loff_t *off)
+{
+        struct seq_file      *seq = file->private_data;
+        struct obd_job_stats *stats = seq->private;
+        char                  jobid[LUSTRE_JOBID_SIZE];
+        struct job_stat      *job;
+
+        if (len == 0 || len >= LUSTRE_JOBID_SIZE)
+                return -EINVAL;
+
+        memset(jobid, 0, sizeof(jobid));
+        if (cfs_copy_from_user(jobid, buf, len))
+                return -EFAULT;
+        if (jobid[len - 1] == '\n')
+                jobid[len - 1] = '\0';
+
+        if (strcmp(jobid, "clear") == 0) {
+                lprocfs_job_cleanup(stats, 1);
+                return len;
+        }
+
+        if (strlen(jobid) == 0)
+                return -EINVAL;
+
+        job = cfs_hash_lookup(stats->ojs_hash, jobid);
+        if (job == NULL)
+                return len;
+
+        cfs_hash_del_key(stats->ojs_hash, jobid);
+        job_putref(job);
+        return len;
+}
+
+static struct file_operations lprocfs_jobstats_seq_fops = {
+        .owner   = THIS_MODULE,
+        .open    = lprocfs_jobstats_seq_open,
+        .read    = seq_read,
+        .write   = lprocfs_jobstats_seq_write,
+        .llseek  = seq_lseek,
+        .release = lprocfs_seq_release,
+};
+
+/**
+ * Start collecting per-job stats on \a obd, with \a cntr_num counters per
+ * job named by \a init_fn, and export them as the "job_stats" proc file.
+ */
+int lprocfs_job_stats_init(struct obd_device *obd, int cntr_num,
+                           cntr_init_callback init_fn)
+{
+        struct obd_job_stats *stats = &obd->obd_jobstats;
+        cfs_proc_dir_entry_t *entry;
+        int                   rc;
+        ENTRY;
+
+        LASSERT(obd->obd_proc_entry != NULL);
+
+        if (cntr_num <= 0 || init_fn == NULL)
+                RETURN(-EINVAL);
+
+        stats->ojs_hash = cfs_hash_create("JOB_STATS",
+                                          HASH_JOB_STATS_CUR_BITS,
+                                          HASH_JOB_STATS_MAX_BITS,
+                                          HASH_JOB_STATS_BKT_BITS, 0,
+                                          CFS_HASH_MIN_THETA,
+                                          CFS_HASH_MAX_THETA,
+                                          &job_stats_hash_ops,
+                                          CFS_HASH_DEFAULT);
+        if (stats->ojs_hash == NULL)
+                RETURN(-ENOMEM);
+
+        CFS_INIT_LIST_HEAD(&stats->ojs_list);
+        cfs_rwlock_init(&stats->ojs_lock);
+        stats->ojs_cntr_num = cntr_num;
+        stats->ojs_cntr_init_fn = init_fn;
+        stats->ojs_cleanup_interval = JOB_CLEANUP_INTERVAL_DEFAULT;
+        stats->ojs_last_cleanup = cfs_time_current_sec();
+
+        LPROCFS_WRITE_ENTRY();
+        entry = create_proc_entry("job_stats", 0644, obd->obd_proc_entry);
+        if (entry) {
+                entry->proc_fops = &lprocfs_jobstats_seq_fops;
+                entry->data = stats;
+        }
+        LPROCFS_WRITE_EXIT();
+        if (entry == NULL)
+                GOTO(out_hash, rc = -ENOMEM);
+
+        entry = lprocfs_add_simple(obd->obd_proc_entry, "job_cleanup_interval",
+                                   lprocfs_rd_uint, lprocfs_wr_uint,
+                                   &stats->ojs_cleanup_interval, NULL);
+        if (IS_ERR(entry)) {
+                lprocfs_remove_proc_entry("job_stats", obd->obd_proc_entry);
+                GOTO(out_hash, rc = PTR_ERR(entry));
+        }
+
+        RETURN(0);
+out_hash:
+        cfs_hash_putref(stats->ojs_hash);
+        stats->ojs_hash = NULL;
+        RETURN(rc);
+}
+EXPORT_SYMBOL(lprocfs_job_stats_init);
+
+#endif /* LPROCFS*/
@@ -696,14 +696,19 @@ int lprocfs_rd_conn_uuid(char *page, char **start, off_t off, int count,
         return rc;
 }
 
+/** units of counter \a idx, kept in the shared header, not per CPU */
+static const char *lprocfs_stats_units(struct lprocfs_stats *stats, int idx)
+{
+        return stats != NULL ? stats->ls_cnt_header[idx].lc_units : "";
+}
+
 /** add up per-cpu counters */
 void lprocfs_stats_collect(struct lprocfs_stats *stats, int idx,
                            struct lprocfs_counter *cnt)
 {
         unsigned int num_cpu;
-        struct lprocfs_counter t;
         struct lprocfs_counter *percpu_cntr;
-        int centry, i;
+        int i;
 
         memset(cnt, 0, sizeof(*cnt));
 
@@ -720,28 +725,17 @@ void lprocfs_stats_collect(struct lprocfs_stats *stats, int idx,
         for (i = 0; i < num_cpu; i++) {
                 percpu_cntr = &(stats->ls_percpu[i])->lp_cntr[idx];
 
-                do {
-                        centry = cfs_atomic_read(&percpu_cntr-> \
-                                                 lc_cntl.la_entry);
-                        t.lc_count = percpu_cntr->lc_count;
-                        t.lc_sum = percpu_cntr->lc_sum;
-                        t.lc_min = percpu_cntr->lc_min;
-                        t.lc_max = percpu_cntr->lc_max;
-                        t.lc_sumsquare = percpu_cntr->lc_sumsquare;
-                } while (centry != cfs_atomic_read(&percpu_cntr->lc_cntl. \
-                                                   la_entry) &&
-                         centry != cfs_atomic_read(&percpu_cntr->lc_cntl. \
-                                                   la_exit));
-                cnt->lc_count += t.lc_count;
-                cnt->lc_sum += t.lc_sum;
-                if (t.lc_min < cnt->lc_min)
-                        cnt->lc_min = t.lc_min;
-                if (t.lc_max > cnt->lc_max)
-                        cnt->lc_max = t.lc_max;
-                cnt->lc_sumsquare += t.lc_sumsquare;
+                /* no lock against the owning CPU: a sample being added
+                 * right now may be partially counted */
+                cnt->lc_count += percpu_cntr->lc_count;
+                cnt->lc_sum += percpu_cntr->lc_sum + percpu_cntr->lc_sum_irq;
+                if (percpu_cntr->lc_min < cnt->lc_min)
+                        cnt->lc_min = percpu_cntr->lc_min;
+                if (percpu_cntr->lc_max > cnt->lc_max)
+                        cnt->lc_max = percpu_cntr->lc_max;
+                cnt->lc_sumsquare += percpu_cntr->lc_sumsquare;
         }
 
-        cnt->lc_units = stats->ls_percpu[0]->lp_cntr[idx].lc_units;
         lprocfs_stats_unlock(stats, LPROCFS_GET_NUM_CPU);
 }
 
@@ -805,6 +799,7 @@ static const char *obd_connect_names[] = {
         "large_ea",
         "full20",
         "layout_lock",
+        "multi_obj_brw",
         NULL
 };
 
@@ -896,7 +891,9 @@ int lprocfs_rd_import(char *page, char **start, off_t off, int count,
                       cfs_atomic_read(&imp->imp_inflight),
                       cfs_atomic_read(&imp->imp_unregistering),
                       cfs_atomic_read(&imp->imp_timeouts),
-                      ret.lc_sum, ret.lc_units);
+                      ret.lc_sum,
+                      lprocfs_stats_units(obd->obd_svc_stats,
+                                          PTLRPC_REQWAIT_CNTR));
 
         k = 0;
         for(j = 0; j < IMP_AT_MAX_PORTALS; j++) {
@@ -947,7 +944,9 @@ int lprocfs_rd_import(char *page, char **start, off_t off, int count,
                         ret.lc_sum = sum;
                         i += snprintf(page + i, count - i,
                                       "       %s_per_rpc: "LPU64"\n",
-                                      ret.lc_units, ret.lc_sum);
+                                      lprocfs_stats_units(obd->obd_svc_stats,
+                                                          j),
+                                      ret.lc_sum);
                         j = (int)ret.lc_sum;
                         if (j > 0)
                                 i += snprintf(page + i, count - i,
@@ -1193,6 +1192,13 @@ struct lprocfs_stats *lprocfs_alloc_stats(unsigned int num,
         if (stats == NULL)
                 return NULL;
 
+        OBD_ALLOC(stats->ls_cnt_header,
+                  num * sizeof(struct lprocfs_counter_header));
+        if (stats->ls_cnt_header == NULL) {
+                OBD_FREE(stats, offsetof(typeof(*stats), ls_percpu[num_cpu]));
+                return NULL;
+        }
+
         if (flags & LPROCFS_STATS_FLAG_NOPERCPU) {
                 stats->ls_flags = flags;
                 cfs_spin_lock_init(&stats->ls_lock);
@@ -1216,6 +1222,8 @@ struct lprocfs_stats *lprocfs_alloc_stats(unsigned int num,
                 }
         }
         if (stats->ls_percpu[0] == NULL) {
+                OBD_FREE(stats->ls_cnt_header,
+                         num * sizeof(struct lprocfs_counter_header));
                 OBD_FREE(stats, offsetof(typeof(*stats),
                                          ls_percpu[num_cpu]));
                 return NULL;
@@ -1246,6 +1254,8 @@ void lprocfs_free_stats(struct lprocfs_stats **statsh)
                 percpusize = CFS_L1_CACHE_ALIGN(percpusize);
         for (i = 0; i < num_cpu; i++)
                 OBD_FREE(stats->ls_percpu[i], percpusize);
+        OBD_FREE(stats->ls_cnt_header,
+                 stats->ls_num * sizeof(struct lprocfs_counter_header));
         OBD_FREE(stats, offsetof(typeof(*stats), ls_percpu[num_cpu]));
 }
 
@@ -1260,13 +1270,12 @@ void lprocfs_clear_stats(struct lprocfs_stats *stats)
         for (i = 0; i < num_cpu; i++) {
                 for (j = 0; j < stats->ls_num; j++) {
                         percpu_cntr = &(stats->ls_percpu[i])->lp_cntr[j];
-                        cfs_atomic_inc(&percpu_cntr->lc_cntl.la_entry);
                         percpu_cntr->lc_count = 0;
                         percpu_cntr->lc_sum = 0;
+                        percpu_cntr->lc_sum_irq = 0;
                         percpu_cntr->lc_min = LC_MIN_INIT;
                         percpu_cntr->lc_max = 0;
                         percpu_cntr->lc_sumsquare = 0;
-                        cfs_atomic_inc(&percpu_cntr->lc_cntl.la_exit);
                 }
         }
 
@@ -1309,6 +1318,7 @@ static int lprocfs_stats_seq_show(struct seq_file *p, void *v)
 {
        struct lprocfs_stats *stats = p->private;
        struct lprocfs_counter *cntr = v;
+       struct lprocfs_counter_header *header;
        struct lprocfs_counter ret;
        int idx, rc = 0;
 
@@ -1321,24 +1331,26 @@ static int lprocfs_stats_seq_show(struct seq_file *p, void *v)
                        return rc;
        }
        idx = cntr - &(stats->ls_percpu[0])->lp_cntr[0];
+       header = &stats->ls_cnt_header[idx];
 
        lprocfs_stats_collect(stats, idx, &ret);
 
        if (ret.lc_count == 0)
                goto out;
 
-       rc = seq_printf(p, "%-25s "LPD64" samples [%s]", cntr->lc_name,
-                       ret.lc_count, cntr->lc_units);
+       rc = seq_printf(p, "%-25s "LPD64" samples [%s]", header->lc_name,
+                       ret.lc_count, header->lc_units);
 
        if (rc < 0)
                goto out;
 
-       if ((cntr->lc_config & LPROCFS_CNTR_AVGMINMAX) && (ret.lc_count > 0)) {
+       if ((header->lc_config & LPROCFS_CNTR_AVGMINMAX) &&
+           (ret.lc_count > 0)) {
                rc = seq_printf(p, " "LPD64" "LPD64" "LPD64,
                                ret.lc_min, ret.lc_max, ret.lc_sum);
                if (rc < 0)
                        goto out;
-               if (cntr->lc_config & LPROCFS_CNTR_STDDEV)
+               if (header->lc_config & LPROCFS_CNTR_STDDEV)
                        rc = seq_printf(p, " "LPD64, ret.lc_sumsquare);
                if (rc < 0)
                        goto out;
@@ -1407,23 +1419,28 @@ int lprocfs_register_stats(struct proc_dir_entry *root, const char *name,
 void lprocfs_counter_init(struct lprocfs_stats *stats, int index,
                           unsigned conf, const char *name, const char *units)
 {
+        struct lprocfs_counter_header *header;
         struct lprocfs_counter *c;
         int i;
         unsigned int num_cpu;
 
         LASSERT(stats != NULL);
 
+        header = &stats->ls_cnt_header[index];
+        header->lc_config = conf;
+        header->lc_name = name;
+        header->lc_units = units;
+
         num_cpu = lprocfs_stats_lock(stats, LPROCFS_GET_NUM_CPU);
 
         for (i = 0; i < num_cpu; i++) {
                 c = &(stats->ls_percpu[i]->lp_cntr[index]);
-                c->lc_config = conf;
                 c->lc_count = 0;
                 c->lc_sum = 0;
+                c->lc_sum_irq = 0;
                 c->lc_min = LC_MIN_INIT;
                 c->lc_max = 0;
-                c->lc_name = name;
-                c->lc_units = units;
+                c->lc_sumsquare = 0;
         }
 
         lprocfs_stats_unlock(stats, LPROCFS_GET_NUM_CPU);
@@ -1534,7 +1551,7 @@ int lprocfs_alloc_obd_stats(struct obd_device *obd, unsigned num_private_stats)
                  * <obd.h>, and that the corresponding line item
                  * LPROCFS_OBD_OP_INIT(.., .., opname)
                  * is missing from the list above. */
-                LASSERTF(stats->ls_percpu[0]->lp_cntr[i].lc_name != NULL,
+                LASSERTF(stats->ls_cnt_header[i].lc_name != NULL,
                          "Missing obd_stat initializer obd_op "
                          "operation at offset %d.\n", i - num_private_stats);
         }
@@ -1617,7 +1634,7 @@ int lprocfs_alloc_md_stats(struct obd_device *obd,
         lprocfs_init_mps_stats(num_private_stats, stats);
 
         for (i = num_private_stats; i < num_stats; i++) {
-                if (stats->ls_percpu[0]->lp_cntr[i].lc_name == NULL) {
+                if (stats->ls_cnt_header[i].lc_name == NULL) {
                         CERROR("Missing md_stat initializer md_op "
                                "operation at offset %d. Aborting.\n",
                                i - num_private_stats);
@@ -2133,11 +2150,76 @@ __inline__ int lprocfs_obd_seq_create(struct obd_device *dev, char *name,
 }
 EXPORT_SYMBOL(lprocfs_obd_seq_create);
 
+#define OH_PERCPU_SIZE CFS_L1_CACHE_ALIGN(OBD_HIST_MAX * sizeof(unsigned long))
+
+/**
+ * Switch \a oh to per-CPU buckets.  Must be called before the histogram is
+ * first tallied, and paired with lprocfs_oh_fini().  If the pointer array
+ * can not be allocated the histogram simply stays shared.
+ */
+int lprocfs_oh_init_percpu(struct obd_histogram *oh)
+{
+        cfs_spin_lock_init(&oh->oh_lock);
+        OBD_ALLOC(oh->oh_percpu,
+                  cfs_num_possible_cpus() * sizeof(*oh->oh_percpu));
+        if (oh->oh_percpu == NULL)
+                return -ENOMEM;
+        return 0;
+}
+EXPORT_SYMBOL(lprocfs_oh_init_percpu);
+
+void lprocfs_oh_fini(struct obd_histogram *oh)
+{
+        int i;
+
+        if (oh->oh_percpu == NULL)
+                return;
+
+        for (i = 0; i < cfs_num_possible_cpus(); i++) {
+                if (oh->oh_percpu[i] != NULL)
+                        OBD_FREE(oh->oh_percpu[i], OH_PERCPU_SIZE);
+        }
+        OBD_FREE(oh->oh_percpu,
+                 cfs_num_possible_cpus() * sizeof(*oh->oh_percpu));
+        oh->oh_percpu = NULL;
+}
+EXPORT_SYMBOL(lprocfs_oh_fini);
+
 void lprocfs_oh_tally(struct obd_histogram *oh, unsigned int value)
 {
+        unsigned long *buckets;
+        int cpu;
+
         if (value >= OBD_HIST_MAX)
                 value = OBD_HIST_MAX - 1;
 
+        if (oh->oh_percpu != NULL) {
+                cpu = cfs_get_cpu();
+                buckets = oh->oh_percpu[cpu];
+                if (unlikely(buckets == NULL)) {
+                        OBD_ALLOC_GFP(buckets, OH_PERCPU_SIZE,
+                                      CFS_ALLOC_ATOMIC);
+                        /* an interrupt on this CPU may have raced us */
+                        cfs_spin_lock(&oh->oh_lock);
+                        if (oh->oh_percpu[cpu] == NULL) {
+                                oh->oh_percpu[cpu] = buckets;
+                        } else if (buckets != NULL) {
+                                OBD_FREE(buckets, OH_PERCPU_SIZE);
+                                buckets = oh->oh_percpu[cpu];
+                        } else {
+                                buckets = oh->oh_percpu[cpu];
+                        }
+                        cfs_spin_unlock(&oh->oh_lock);
+                }
+                if (likely(buckets != NULL)) {
+                        buckets[value]++;
+                        cfs_put_cpu();
+                        return;
+                }
+                cfs_put_cpu();
+                /* out of memory, fall back to the shared buckets */
+        }
+
         cfs_spin_lock(&oh->oh_lock);
         oh->oh_buckets[value]++;
         cfs_spin_unlock(&oh->oh_lock);
@@ -2155,21 +2237,47 @@ void lprocfs_oh_tally_log2(struct obd_histogram *oh, unsigned int value)
 }
 EXPORT_SYMBOL(lprocfs_oh_tally_log2);
 
+/** Return bucket \a idx of \a oh, summed over all CPUs. */
+unsigned long lprocfs_oh_counter(struct obd_histogram *oh, unsigned int idx)
+{
+        unsigned long ret = oh->oh_buckets[idx];
+        int i;
+
+        if (oh->oh_percpu == NULL)
+                return ret;
+
+        for (i = 0; i < cfs_num_possible_cpus(); i++) {
+                if (oh->oh_percpu[i] != NULL)
+                        ret += oh->oh_percpu[i][idx];
+        }
+        return ret;
+}
+EXPORT_SYMBOL(lprocfs_oh_counter);
+
 unsigned long lprocfs_oh_sum(struct obd_histogram *oh)
 {
         unsigned long ret = 0;
         int i;
 
         for (i = 0; i < OBD_HIST_MAX; i++)
-                ret +=  oh->oh_buckets[i];
+                ret += lprocfs_oh_counter(oh, i);
         return ret;
 }
 EXPORT_SYMBOL(lprocfs_oh_sum);
 
 void lprocfs_oh_clear(struct obd_histogram *oh)
 {
+        int i;
+
         cfs_spin_lock(&oh->oh_lock);
         memset(oh->oh_buckets, 0, sizeof(oh->oh_buckets));
+        if (oh->oh_percpu != NULL) {
+                for (i = 0; i < cfs_num_possible_cpus(); i++) {
+                        if (oh->oh_percpu[i] != NULL)
+                                memset(oh->oh_percpu[i], 0,
+                                       OBD_HIST_MAX * sizeof(unsigned long));
+                }
+        }
         cfs_spin_unlock(&oh->oh_lock);
 }
 EXPORT_SYMBOL(lprocfs_oh_clear);
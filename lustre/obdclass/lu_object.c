@@ -65,6 +65,7 @@
 #include <lu_time.h>
 
 static void lu_object_free(const struct lu_env *env, struct lu_object *o);
+static void lu_site_purge_check(struct lu_site *s, cfs_hash_bd_t *bd);
 
 /**
  * Decrease reference counter on object. If last reference is freed, return
@@ -110,6 +111,7 @@ void lu_object_put(const struct lu_env *env, struct lu_object *o)
         }
 
         if (!lu_object_is_dying(top)) {
+                lu_site_purge_check(site, &bd);
                 cfs_hash_bd_unlock(site->ls_obj_hash, &bd, 1);
                 return;
         }
@@ -249,15 +251,91 @@ static void lu_object_free(const struct lu_env *env, struct lu_object *o)
 }
 
 /**
- * Free \a nr objects from the cold end of the site LRU list.
+ * Move up to \a nr unreferenced objects from the cold end of the LRU of
+ * bucket \a bd to \a dispose, removing them from the hash table. Objects
+ * marked LU_OBJECT_REFERENCED are moved to the hot end instead, unless all
+ * objects are purged (\a nr is ~0). Called with the bucket locked.
+ *
+ * \retval number of objects moved to \a dispose
  */
-int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
+static int lu_site_bkt_purge(struct lu_site *s, cfs_hash_bd_t *bd, int nr,
+                             cfs_list_t *dispose)
 {
         struct lu_object_header *h;
         struct lu_object_header *temp;
         struct lu_site_bkt_data *bkt;
-        cfs_hash_bd_t            bd;
         cfs_hash_bd_t            bd2;
+        int                      scan;
+        int                      count = 0;
+
+        bkt = cfs_hash_bd_extra_get(s->ls_obj_hash, bd);
+        /* each object is looked at once, even if it is moved to the tail */
+        scan = cfs_hash_bd_count_get(bd);
+
+        cfs_list_for_each_entry_safe(h, temp, &bkt->lsb_lru, loh_lru) {
+                if (scan-- == 0)
+                        break;
+                /*
+                 * Objects are sorted in lru order, and "busy"
+                 * objects (ones with h->loh_ref > 0) naturally tend to
+                 * live near hot end that we scan last. Unfortunately,
+                 * sites usually have small (less then ten) number of
+                 * busy yet rarely accessed objects (some global
+                 * objects, accessed directly through pointers,
+                 * bypassing hash table).
+                 * Currently algorithm scans them over and over again.
+                 * Probably we should move busy objects out of LRU,
+                 * or we can live with that.
+                 */
+                if (cfs_atomic_read(&h->loh_ref) > 0)
+                        continue;
+
+                if (nr != ~0 &&
+                    cfs_test_and_clear_bit(LU_OBJECT_REFERENCED,
+                                           &h->loh_flags)) {
+                        cfs_list_move_tail(&h->loh_lru, &bkt->lsb_lru);
+                        continue;
+                }
+
+                cfs_hash_bd_get(s->ls_obj_hash, &h->loh_fid, &bd2);
+                LASSERT(bd->bd_bucket == bd2.bd_bucket);
+
+                cfs_hash_bd_del_locked(s->ls_obj_hash, &bd2, &h->loh_hash);
+                cfs_list_move(&h->loh_lru, dispose);
+                count++;
+
+                if (nr != ~0 && --nr == 0)
+                        break;
+        }
+        return count;
+}
+
+/**
+ * Free everything on the \a dispose list filled by lu_site_bkt_purge(). This
+ * is safe against races due to the reasons described in lu_object_put().
+ */
+static void lu_site_dispose(const struct lu_env *env, struct lu_site *s,
+                            cfs_list_t *dispose)
+{
+        struct lu_object_header *h;
+
+        while (!cfs_list_empty(dispose)) {
+                h = container_of0(dispose->next,
+                                  struct lu_object_header, loh_lru);
+                cfs_list_del_init(&h->loh_lru);
+                lu_object_free(env, lu_object_top(h));
+                lprocfs_counter_incr(s->ls_stats, LU_SS_LRU_PURGED);
+        }
+}
+
+static void lu_site_purge_cancel(struct lu_site *s);
+
+/**
+ * Free \a nr objects from the cold end of the site LRU list.
+ */
+int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
+{
+        cfs_hash_bd_t            bd;
         cfs_list_t               dispose;
         int                      did_sth;
         int                      start;
@@ -265,66 +343,34 @@ int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
         int                      bnr;
         int                      i;
 
+        /* the whole cache goes, wait for the background purge to finish */
+        if (nr == ~0)
+                lu_site_purge_cancel(s);
+
         CFS_INIT_LIST_HEAD(&dispose);
         /*
          * Under LRU list lock, scan LRU list and move unreferenced objects to
          * the dispose list, removing them from LRU and hash table.
          */
         start = s->ls_purge_start;
-        bnr = (nr == ~0) ? -1 : nr / CFS_HASH_NBKT(s->ls_obj_hash) + 1;
+        bnr = (nr == ~0) ? ~0 : nr / CFS_HASH_NBKT(s->ls_obj_hash) + 1;
  again:
         did_sth = 0;
         cfs_hash_for_each_bucket(s->ls_obj_hash, &bd, i) {
                 if (i < start)
                         continue;
-                count = bnr;
                 cfs_hash_bd_lock(s->ls_obj_hash, &bd, 1);
-                bkt = cfs_hash_bd_extra_get(s->ls_obj_hash, &bd);
-
-                cfs_list_for_each_entry_safe(h, temp, &bkt->lsb_lru, loh_lru) {
-                        /*
-                         * Objects are sorted in lru order, and "busy"
-                         * objects (ones with h->loh_ref > 0) naturally tend to
-                         * live near hot end that we scan last. Unfortunately,
-                         * sites usually have small (less then ten) number of
-                         * busy yet rarely accessed objects (some global
-                         * objects, accessed directly through pointers,
-                         * bypassing hash table).
-                         * Currently algorithm scans them over and over again.
-                         * Probably we should move busy objects out of LRU,
-                         * or we can live with that.
-                         */
-                        if (cfs_atomic_read(&h->loh_ref) > 0)
-                                continue;
-
-                        cfs_hash_bd_get(s->ls_obj_hash, &h->loh_fid, &bd2);
-                        LASSERT(bd.bd_bucket == bd2.bd_bucket);
-
-                        cfs_hash_bd_del_locked(s->ls_obj_hash,
-                                               &bd2, &h->loh_hash);
-                        cfs_list_move(&h->loh_lru, &dispose);
-                        if (did_sth == 0)
-                                did_sth = 1;
-
-                        if (nr != ~0 && --nr == 0)
-                                break;
-
-                        if (count > 0 && --count == 0)
-                                break;
-
-                }
+                count = lu_site_bkt_purge(s, &bd,
+                                          nr == ~0 ? ~0 : min(nr, bnr),
+                                          &dispose);
                 cfs_hash_bd_unlock(s->ls_obj_hash, &bd, 1);
                 cfs_cond_resched();
-                /*
-                 * Free everything on the dispose list. This is safe against
-                 * races due to the reasons described in lu_object_put().
-                 */
-                while (!cfs_list_empty(&dispose)) {
-                        h = container_of0(dispose.next,
-                                          struct lu_object_header, loh_lru);
-                        cfs_list_del_init(&h->loh_lru);
-                        lu_object_free(env, lu_object_top(h));
-                        lprocfs_counter_incr(s->ls_stats, LU_SS_LRU_PURGED);
+
+                lu_site_dispose(env, s, &dispose);
+                if (count > 0) {
+                        did_sth = 1;
+                        if (nr != ~0)
+                                nr -= count;
                 }
 
                 if (nr == 0)
@@ -342,6 +388,121 @@ int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
 }
 EXPORT_SYMBOL(lu_site_purge);
 
+#ifdef __KERNEL__
+/** the background purge frees 1/LU_CACHE_PURGE_SLACK more than needed */
+#define LU_CACHE_PURGE_SLACK 8
+
+static int lu_cache_nr = -1;
+CFS_MODULE_PARM(lu_cache_nr, "i", int, 0644,
+                "objects cached per lu_site before the least recently used "
+                "ones are purged, -1 sizes it from memory, 0 for no limit");
+
+/**
+ * Share of lu_cache_nr of each hash bucket of \a s, 0 if unlimited.
+ */
+static int lu_site_bkt_max(struct lu_site *s)
+{
+        int nr = lu_cache_nr;
+
+        if (nr <= 0)
+                return 0;
+        return max_t(int, nr / CFS_HASH_NBKT(s->ls_obj_hash), 1);
+}
+
+/**
+ * Number of objects of bucket \a bd of \a s nobody holds a reference to,
+ * the only ones a purge can free. Called with the bucket locked.
+ */
+static int lu_site_bkt_idle(struct lu_site *s, cfs_hash_bd_t *bd)
+{
+        struct lu_site_bkt_data *bkt;
+
+        bkt = cfs_hash_bd_extra_get(s->ls_obj_hash, bd);
+        return cfs_hash_bd_count_get(bd) - bkt->lsb_busy;
+}
+
+/**
+ * Background purge of \a s, one bucket at a time: a bucket above its share
+ * of lu_cache_nr is brought back LU_CACHE_PURGE_SLACK below it, so that the
+ * workitem is not scheduled again on the next insertion.
+ */
+static int lu_site_purge_wi(cfs_workitem_t *wi)
+{
+        struct lu_site *s = wi->wi_data;
+        cfs_hash_t     *hs = s->ls_obj_hash;
+        struct lu_env   env;
+        cfs_hash_bd_t   bd;
+        cfs_list_t      dispose;
+        int             max;
+        int             nr;
+        int             i;
+        int             rc;
+
+        rc = lu_env_init(&env, LCT_SHRINKER);
+        if (rc != 0) {
+                CERROR("cannot initialize purge environment: rc = %d\n", rc);
+                return 0;
+        }
+
+        CFS_INIT_LIST_HEAD(&dispose);
+        cfs_hash_for_each_bucket(hs, &bd, i) {
+                max = lu_site_bkt_max(s);
+                if (max == 0)
+                        break;
+
+                cfs_hash_bd_lock(hs, &bd, 1);
+                nr = lu_site_bkt_idle(s, &bd) - max;
+                if (nr > 0)
+                        lu_site_bkt_purge(s, &bd,
+                                          nr + max / LU_CACHE_PURGE_SLACK,
+                                          &dispose);
+                cfs_hash_bd_unlock(hs, &bd, 1);
+
+                lu_site_dispose(&env, s, &dispose);
+                cfs_cond_resched();
+        }
+
+        lu_env_fini(&env);
+        return 0;
+}
+
+static void lu_site_purge_init(struct lu_site *s)
+{
+        cfs_wi_init(&s->ls_purge_wi, s, lu_site_purge_wi, CFS_WI_SCHED_ANY);
+        cfs_wi_set_prio(&s->ls_purge_wi, CFS_WI_PRIO_LOW);
+}
+
+/**
+ * Schedule the background purge if bucket \a bd of \a s caches more idle
+ * objects than its share of lu_cache_nr. Called with the bucket locked.
+ */
+static void lu_site_purge_check(struct lu_site *s, cfs_hash_bd_t *bd)
+{
+        int max = lu_site_bkt_max(s);
+
+        if (unlikely(max > 0 && lu_site_bkt_idle(s, bd) > max))
+                cfs_wi_schedule(&s->ls_purge_wi);
+}
+
+static void lu_site_purge_cancel(struct lu_site *s)
+{
+        cfs_wi_cancel_sync(&s->ls_purge_wi);
+}
+#else /* !__KERNEL__ */
+/* liblustre runs no workitem schedulers, its caches are not limited */
+static void lu_site_purge_init(struct lu_site *s)
+{
+}
+
+static void lu_site_purge_check(struct lu_site *s, cfs_hash_bd_t *bd)
+{
+}
+
+static void lu_site_purge_cancel(struct lu_site *s)
+{
+}
+#endif /* __KERNEL__ */
+
 /*
  * Object printing.
  *
@@ -486,6 +647,16 @@ int lu_object_invariant(const struct lu_object *o)
 }
 EXPORT_SYMBOL(lu_object_invariant);
 
+/**
+ * Mark \a h as used since the last LRU scan. The flag is tested first, so
+ * that the header cache line is not dirtied on each lookup of a hot object.
+ */
+static inline void lu_object_referenced(struct lu_object_header *h)
+{
+        if (!cfs_test_bit(LU_OBJECT_REFERENCED, &h->loh_flags))
+                cfs_set_bit(LU_OBJECT_REFERENCED, &h->loh_flags);
+}
+
 static struct lu_object *htable_lookup(struct lu_site *s,
                                        cfs_hash_bd_t *bd,
                                        const struct lu_fid *f,
@@ -512,6 +683,7 @@ static struct lu_object *htable_lookup(struct lu_site *s,
 
         h = container_of0(hnode, struct lu_object_header, loh_hash);
         if (likely(!lu_object_is_dying(h))) {
+                lu_object_referenced(h);
                 lprocfs_counter_incr(s->ls_stats, LU_SS_CACHE_HIT);
                 return lu_object_top(h);
         }
@@ -557,6 +729,7 @@ static struct lu_object *lu_object_find_try(const struct lu_env *env,
         struct lu_site        *s;
         cfs_hash_t            *hs;
         cfs_hash_bd_t          bd;
+        cfs_hlist_node_t      *hnode;
         __u64                  version = 0;
 
         /*
@@ -577,7 +750,19 @@ static struct lu_object *lu_object_find_try(const struct lu_env *env,
          */
         s  = dev->ld_site;
         hs = s->ls_obj_hash;
-        cfs_hash_bd_get_and_lock(hs, (void *)f, &bd, 1);
+        cfs_hash_bd_get(hs, (void *)f, &bd);
+        /* busy objects are found without the bucket lock */
+        hnode = cfs_hash_bd_lookup_rcu(hs, &bd, (void *)f);
+        if (hnode != NULL) {
+                struct lu_object_header *h;
+
+                h = container_of0(hnode, struct lu_object_header, loh_hash);
+                lu_object_referenced(h);
+                lprocfs_counter_incr(s->ls_stats, LU_SS_CACHE_HIT);
+                return lu_object_top(h);
+        }
+
+        cfs_hash_bd_lock(hs, &bd, 1);
         o = htable_lookup(s, &bd, f, waiter, &version);
         cfs_hash_bd_unlock(hs, &bd, 1);
         if (o != NULL)
@@ -603,6 +788,7 @@ static struct lu_object *lu_object_find_try(const struct lu_env *env,
                 cfs_hash_bd_add_locked(hs, &bd, &o->lo_header->loh_hash);
                 cfs_list_add_tail(&o->lo_header->loh_lru, &bkt->lsb_lru);
                 bkt->lsb_busy++;
+                lu_site_purge_check(s, &bd);
                 cfs_hash_bd_unlock(hs, &bd, 1);
                 return o;
         }
@@ -758,12 +944,11 @@ enum {
 };
 
 /**
- * Return desired hash table order.
+ * Number of objects fitting in LU_CACHE_PERCENT of memory.
  */
-static int lu_htable_order(void)
+static unsigned long lu_cache_size(void)
 {
         unsigned long cache_size;
-        int bits;
 
         /*
          * Calculate hash table size, assuming that we want reasonable
@@ -780,8 +965,16 @@ static int lu_htable_order(void)
                 cache_size = 1 << (30 - CFS_PAGE_SHIFT) * 3 / 4;
 #endif
 
-        cache_size = cache_size / 100 * LU_CACHE_PERCENT *
-                (CFS_PAGE_SIZE / 1024);
+        return cache_size / 100 * LU_CACHE_PERCENT * (CFS_PAGE_SIZE / 1024);
+}
+
+/**
+ * Return desired hash table order.
+ */
+static int lu_htable_order(void)
+{
+        unsigned long cache_size = lu_cache_size();
+        int bits;
 
         for (bits = 1; (1 << bits) < cache_size; ++bits) {
                 ;
@@ -835,6 +1028,21 @@ static void lu_obj_hop_get(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
         }
 }
 
+static int lu_obj_hop_get_rcu(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
+{
+        struct lu_object_header *h;
+
+        h = cfs_hlist_entry(hnode, struct lu_object_header, loh_hash);
+        /*
+         * Only busy objects: the first reference accounts lsb_busy and
+         * races with lu_site_purge(), and lookups of dying objects have to
+         * wait in htable_lookup(), both under the bucket lock.
+         */
+        if (lu_object_is_dying(h))
+                return 0;
+        return cfs_atomic_inc_not_zero(&h->loh_ref);
+}
+
 static void lu_obj_hop_put_locked(cfs_hash_t *hs, cfs_hlist_node_t *hnode)
 {
         LBUG(); /* we should never called it */
@@ -847,6 +1055,7 @@ cfs_hash_ops_t lu_site_hash_ops = {
         .hs_object      = lu_obj_hop_object,
         .hs_get         = lu_obj_hop_get,
         .hs_put_locked  = lu_obj_hop_put_locked,
+        .hs_get_rcu     = lu_obj_hop_get_rcu,
 };
 
 /**
@@ -880,7 +1089,8 @@ int lu_site_init(struct lu_site *s, struct lu_device *top)
                                                  CFS_HASH_SPIN_BKTLOCK |
                                                  CFS_HASH_NO_ITEMREF |
                                                  CFS_HASH_DEPTH |
-                                                 CFS_HASH_ASSERT_EMPTY);
+                                                 CFS_HASH_ASSERT_EMPTY |
+                                                 CFS_HASH_RCU);
                 if (s->ls_obj_hash != NULL)
                         break;
         }
@@ -895,6 +1105,7 @@ int lu_site_init(struct lu_site *s, struct lu_device *top)
                 CFS_INIT_LIST_HEAD(&bkt->lsb_lru);
                 cfs_waitq_init(&bkt->lsb_marche_funebre);
         }
+        lu_site_purge_init(s);
 
         s->ls_stats = lprocfs_alloc_stats(LU_SS_LAST_STAT, 0);
         if (s->ls_stats == NULL) {
@@ -936,6 +1147,7 @@ void lu_site_fini(struct lu_site *s)
         cfs_up(&lu_sites_guard);
 
         if (s->ls_obj_hash != NULL) {
+                lu_site_purge_cancel(s);
                 cfs_hash_putref(s->ls_obj_hash);
                 s->ls_obj_hash = NULL;
         }
@@ -1185,6 +1397,27 @@ static struct lu_context_key *lu_keys[LU_CONTEXT_KEY_NR] = { NULL, };
 
 static cfs_spinlock_t lu_keys_guard = CFS_SPIN_LOCK_UNLOCKED;
 
+enum {
+        LU_CS_VALUE_INIT = 0,
+        LU_CS_VALUE_FINI,
+        LU_CS_VALUE_RESET,
+        LU_CS_LAST_STAT
+};
+
+/**
+ * Key values created, destroyed and reset (bytes zeroed), over all contexts.
+ */
+static struct lprocfs_stats *lu_context_stats;
+
+static void lu_context_stats_fini(void)
+{
+        if (lu_context_stats != NULL) {
+                lprocfs_remove_proc_entry("lu_context_stats",
+                                          proc_lustre_root);
+                lprocfs_free_stats(&lu_context_stats);
+        }
+}
+
 /**
  * Global counter incremented whenever key is registered, unregistered,
  * revived or quiesced. This is used to void unnecessary calls to
@@ -1235,6 +1468,7 @@ static void key_fini(struct lu_context *ctx, int index)
                 LASSERT(cfs_atomic_read(&key->lct_used) > 1);
 
                 key->lct_fini(ctx, key, ctx->lc_value[index]);
+                lprocfs_counter_incr(lu_context_stats, LU_CS_VALUE_FINI);
                 lu_ref_del(&key->lct_reference, "ctx", ctx);
                 cfs_atomic_dec(&key->lct_used);
                 LASSERT(key->lct_owner != NULL);
@@ -1352,6 +1586,45 @@ void lu_context_key_quiesce_many(struct lu_context_key *k, ...)
 }
 EXPORT_SYMBOL(lu_context_key_quiesce_many);
 
+static int key_init(struct lu_context *ctx, struct lu_context_key *key);
+
+/**
+ * First use of the value of \a key in LCT_LAZY context \a ctx since it was
+ * entered: create the value, or reset the one left by a previous use.
+ */
+static void *key_get_lazy(struct lu_context *ctx, struct lu_context_key *key)
+{
+        int   i = key->lct_index;
+        void *value = ctx->lc_value[i];
+        int   rc;
+
+        if (!(key->lct_tags & ctx->lc_tags))
+                return NULL;
+
+        if (value != NULL && key->lct_size != 0) {
+                memset(value, 0, key->lct_size);
+                lprocfs_counter_add(lu_context_stats, LU_CS_VALUE_RESET,
+                                    key->lct_size);
+        } else {
+                if (value != NULL) {
+                        cfs_spin_lock(&lu_keys_guard);
+                        key_fini(ctx, i);
+                        cfs_spin_unlock(&lu_keys_guard);
+                }
+                if (!(key->lct_tags & LCT_QUIESCENT)) {
+                        rc = key_init(ctx, key);
+                        if (rc != 0) {
+                                CERROR("cannot create value of key %d: "
+                                       "rc = %d\n", i, rc);
+                                return NULL;
+                        }
+                }
+                value = ctx->lc_value[i];
+        }
+        ctx->lc_valid |= 1U << i;
+        return value;
+}
+
 /**
  * Return value associated with key \a key in context \a ctx.
  */
@@ -1361,6 +1634,10 @@ void *lu_context_key_get(const struct lu_context *ctx,
         LINVRNT(ctx->lc_state == LCS_ENTERED);
         LINVRNT(0 <= key->lct_index && key->lct_index < ARRAY_SIZE(lu_keys));
         LASSERT(lu_keys[key->lct_index] == key);
+        if (ctx->lc_tags & LCT_LAZY &&
+            !(ctx->lc_valid & (1U << key->lct_index)))
+                return key_get_lazy((struct lu_context *)ctx,
+                                    (struct lu_context_key *)key);
         return ctx->lc_value[key->lct_index];
 }
 EXPORT_SYMBOL(lu_context_key_get);
@@ -1421,10 +1698,47 @@ static void keys_fini(struct lu_context *ctx)
         cfs_spin_unlock(&lu_keys_guard);
 }
 
+/**
+ * Create the value of \a key in \a ctx.
+ */
+static int key_init(struct lu_context *ctx, struct lu_context_key *key)
+{
+        void *value;
+
+        LINVRNT(key->lct_init != NULL);
+        LINVRNT(ctx->lc_value[key->lct_index] == NULL);
+
+        value = key->lct_init(ctx, key);
+        if (unlikely(IS_ERR(value)))
+                return PTR_ERR(value);
+
+        LASSERT(key->lct_owner != NULL);
+        if (!(ctx->lc_tags & LCT_NOREF))
+                cfs_try_module_get(key->lct_owner);
+        lu_ref_add_atomic(&key->lct_reference, "ctx", ctx);
+        cfs_atomic_inc(&key->lct_used);
+        lprocfs_counter_incr(lu_context_stats, LU_CS_VALUE_INIT);
+        /*
+         * This is the only place in the code, where an element of
+         * ctx->lc_value[] array is set to non-NULL value.
+         */
+        ctx->lc_value[key->lct_index] = value;
+        if (key->lct_exit != NULL)
+                ctx->lc_tags |= LCT_HAS_EXIT;
+        return 0;
+}
+
 static int keys_fill(struct lu_context *ctx)
 {
+        int result;
         int i;
 
+        /* values of LCT_LAZY contexts are created by key_get_lazy() */
+        if (ctx->lc_tags & LCT_LAZY) {
+                ctx->lc_version = key_set_version;
+                return 0;
+        }
+
         for (i = 0; i < ARRAY_SIZE(lu_keys); ++i) {
                 struct lu_context_key *key;
 
@@ -1436,31 +1750,14 @@ static int keys_fill(struct lu_context *ctx)
                      * will pin module owning a key.
                      */
                     !(key->lct_tags & LCT_QUIESCENT)) {
-                        void *value;
-
-                        LINVRNT(key->lct_init != NULL);
                         LINVRNT(key->lct_index == i);
 
-                        value = key->lct_init(ctx, key);
-                        if (unlikely(IS_ERR(value)))
-                                return PTR_ERR(value);
-
-                        LASSERT(key->lct_owner != NULL);
-                        if (!(ctx->lc_tags & LCT_NOREF))
-                                cfs_try_module_get(key->lct_owner);
-                        lu_ref_add_atomic(&key->lct_reference, "ctx", ctx);
-                        cfs_atomic_inc(&key->lct_used);
-                        /*
-                         * This is the only place in the code, where an
-                         * element of ctx->lc_value[] array is set to non-NULL
-                         * value.
-                         */
-                        ctx->lc_value[i] = value;
-                        if (key->lct_exit != NULL)
-                                ctx->lc_tags |= LCT_HAS_EXIT;
+                        result = key_init(ctx, key);
+                        if (result != 0)
+                                return result;
                 }
-                ctx->lc_version = key_set_version;
         }
+        ctx->lc_version = key_set_version;
         return 0;
 }
 
@@ -1518,6 +1815,7 @@ void lu_context_enter(struct lu_context *ctx)
 {
         LINVRNT(ctx->lc_state == LCS_INITIALIZED || ctx->lc_state == LCS_LEFT);
         ctx->lc_state = LCS_ENTERED;
+        ctx->lc_valid = 0;
 }
 EXPORT_SYMBOL(lu_context_enter);
 
@@ -1532,6 +1830,10 @@ void lu_context_exit(struct lu_context *ctx)
         ctx->lc_state = LCS_LEFT;
         if (ctx->lc_tags & LCT_HAS_EXIT && ctx->lc_value != NULL) {
                 for (i = 0; i < ARRAY_SIZE(lu_keys); ++i) {
+                        /* values not used since lu_context_enter() */
+                        if (ctx->lc_tags & LCT_LAZY &&
+                            !(ctx->lc_valid & (1U << i)))
+                                continue;
                         if (ctx->lc_value[i] != NULL) {
                                 struct lu_context_key *key;
 
@@ -1746,10 +2048,31 @@ int lu_global_init(void)
         if (result != 0)
                 return result;
 
+        /* lu_context::lc_valid has a bit for each key */
+        CLASSERT(LU_CONTEXT_KEY_NR <= 32);
+#ifdef LPROCFS
+        lu_context_stats = lprocfs_alloc_stats(LU_CS_LAST_STAT, 0);
+        if (lu_context_stats == NULL)
+                return -ENOMEM;
+
+        lprocfs_counter_init(lu_context_stats, LU_CS_VALUE_INIT,
+                             0, "value_init", "values");
+        lprocfs_counter_init(lu_context_stats, LU_CS_VALUE_FINI,
+                             0, "value_fini", "values");
+        lprocfs_counter_init(lu_context_stats, LU_CS_VALUE_RESET,
+                             LPROCFS_CNTR_AVGMINMAX, "value_reset", "bytes");
+        result = lprocfs_register_stats(proc_lustre_root, "lu_context_stats",
+                                        lu_context_stats);
+        if (result != 0) {
+                lprocfs_free_stats(&lu_context_stats);
+                return result;
+        }
+#endif
+
         LU_CONTEXT_KEY_INIT(&lu_global_key);
         result = lu_context_key_register(&lu_global_key);
         if (result != 0)
-                return result;
+                GOTO(out, result);
         /*
          * At this level, we don't know what tags are needed, so allocate them
          * conservatively. This should not be too bad, because this
@@ -1759,7 +2082,7 @@ int lu_global_init(void)
         result = lu_env_init(&lu_shrink_env, LCT_SHRINKER);
         cfs_up(&lu_sites_guard);
         if (result != 0)
-                return result;
+                GOTO(out, result);
 
         /*
          * seeks estimation: 3 seeks to read a record from oi, one to read
@@ -1768,7 +2091,12 @@ int lu_global_init(void)
          */
         lu_site_shrinker = cfs_set_shrinker(CFS_DEFAULT_SEEKS, lu_cache_shrink);
         if (lu_site_shrinker == NULL)
-                return -ENOMEM;
+                GOTO(out, result = -ENOMEM);
+
+#ifdef __KERNEL__
+        if (lu_cache_nr < 0)
+                lu_cache_nr = min_t(unsigned long, lu_cache_size(), INT_MAX);
+#endif
 
         result = lu_time_global_init();
         if (result)
@@ -1785,6 +2113,8 @@ int lu_global_init(void)
 #endif
         result = cl_global_init();
 out:
+        if (result != 0)
+                lu_context_stats_fini();
 
         return result;
 }
@@ -1815,6 +2145,7 @@ void lu_global_fini(void)
         lu_env_fini(&lu_shrink_env);
         cfs_up(&lu_sites_guard);
 
+        lu_context_stats_fini();
         lu_ref_global_fini();
 }
 
@@ -1897,6 +2228,8 @@ void lu_kmem_fini(struct lu_kmem_descr *caches)
 {
         int rc;
 
+        /* top-level objects are freed with my_call_rcu() */
+        my_rcu_barrier();
         for (; caches->ckd_cache != NULL; ++caches) {
                 if (*caches->ckd_cache != NULL) {
                         rc = cfs_mem_cache_destroy(*caches->ckd_cache);
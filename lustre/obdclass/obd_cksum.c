@@ -0,0 +1,250 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * lustre/obdclass/obd_cksum.c
+ *
+ * Bulk checksum engine.
+ *
+ * CRC32 and CRC32C are computed eight bytes at a time with the
+ * "slicing-by-8" tables, or with the SSE4.2 crc32 instruction for CRC32C
+ * on x86_64 CPUs which have it.  When obdclass is loaded every supported
+ * algorithm is timed, and obd_cksum_type_select() then picks the fastest
+ * one out of those both peers announced at connect time.
+ */
+
+#define DEBUG_SUBSYSTEM S_CLASS
+
+#ifdef __KERNEL__
+# include <libcfs/libcfs.h>
+# if defined(__x86_64__)
+#  include <asm/cpufeature.h>
+# endif
+#else
+# include <liblustre.h>
+#endif
+
+#include <obd_support.h>
+#include <obd_cksum.h>
+
+#if defined(__KERNEL__) && defined(__x86_64__) && defined(X86_FEATURE_XMM4_2)
+# define HAVE_CRC32C_SSE42
+#endif
+
+#define CRC32_POLY_LE  0xedb88320
+#define CRC32C_POLY_LE 0x82f63b78
+
+static __u32 obd_crc32_table[8][256];
+static __u32 obd_crc32c_table[8][256];
+
+#ifdef HAVE_CRC32C_SSE42
+static int obd_crc32c_sse42;
+#endif
+
+/**
+ * Relative speed of each algorithm, indexed by the bit number of its
+ * OBD_CKSUM_* flag: MB/s measured at startup in the kernel, a fixed
+ * ranking in liblustre.
+ */
+static unsigned int obd_cksum_speed[32];
+
+static void crc_table_init(__u32 table[8][256], __u32 poly)
+{
+        __u32 crc;
+        int   i;
+        int   j;
+
+        for (i = 0; i < 256; i++) {
+                crc = i;
+                for (j = 0; j < 8; j++)
+                        crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+                table[0][i] = crc;
+        }
+        for (i = 0; i < 256; i++) {
+                for (j = 1; j < 8; j++)
+                        table[j][i] = (table[j - 1][i] >> 8) ^
+                                      table[0][table[j - 1][i] & 0xff];
+        }
+}
+
+/* little-endian, reflected CRC of \a len bytes at \a p, 8 bytes per step */
+static __u32 crc_slice8(__u32 table[8][256], __u32 crc,
+                        unsigned char const *p, size_t len)
+{
+        __u32 hi;
+
+        for (; len > 0 && ((unsigned long)p & 3) != 0; len--, p++)
+                crc = table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+
+        for (; len >= 8; len -= 8, p += 8) {
+                crc ^= le32_to_cpu(*(__u32 *)p);
+                hi = le32_to_cpu(*(__u32 *)(p + 4));
+                crc = table[7][crc & 0xff] ^
+                      table[6][(crc >> 8) & 0xff] ^
+                      table[5][(crc >> 16) & 0xff] ^
+                      table[4][crc >> 24] ^
+                      table[3][hi & 0xff] ^
+                      table[2][(hi >> 8) & 0xff] ^
+                      table[1][(hi >> 16) & 0xff] ^
+                      table[0][hi >> 24];
+        }
+
+        for (; len > 0; len--, p++)
+                crc = table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+
+        return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+/* the crc32 instruction only uses general purpose registers, so there is
+ * no FPU state to save around it */
+static __u32 crc32c_sse42(__u32 crc, unsigned char const *p, size_t len)
+{
+        unsigned long c = crc;
+
+        for (; len > 0 && ((unsigned long)p & 7) != 0; len--, p++)
+                asm("crc32b %1, %k0" : "+r" (c) : "rm" (*p));
+        for (; len >= 8; len -= 8, p += 8)
+                asm("crc32q %1, %0" : "+r" (c) : "rm" (*(__u64 *)p));
+        for (; len > 0; len--, p++)
+                asm("crc32b %1, %k0" : "+r" (c) : "rm" (*p));
+
+        return c;
+}
+#endif
+
+__u32 obd_crc32_le(__u32 crc, unsigned char const *p, size_t len)
+{
+        return crc_slice8(obd_crc32_table, crc, p, len);
+}
+EXPORT_SYMBOL(obd_crc32_le);
+
+__u32 obd_crc32c(__u32 crc, unsigned char const *p, size_t len)
+{
+#ifdef HAVE_CRC32C_SSE42
+        if (obd_crc32c_sse42)
+                return crc32c_sse42(crc, p, len);
+#endif
+        return crc_slice8(obd_crc32c_table, crc, p, len);
+}
+EXPORT_SYMBOL(obd_crc32c);
+
+/**
+ * Return the fastest of the \a cksum_types (a mask of OBD_CKSUM_* flags)
+ * this node supports, OBD_CKSUM_CRC32 if there is none.
+ */
+cksum_type_t obd_cksum_type_select(__u32 cksum_types)
+{
+        cksum_type_t type = OBD_CKSUM_CRC32;
+        unsigned int speed = 0;
+        int          i;
+
+        cksum_types &= OBD_CKSUM_ALL;
+        for (i = 0; i < ARRAY_SIZE(obd_cksum_speed); i++) {
+                if ((cksum_types & (1 << i)) == 0)
+                        continue;
+                if (obd_cksum_speed[i] > speed) {
+                        speed = obd_cksum_speed[i];
+                        type = 1 << i;
+                }
+        }
+        return type;
+}
+EXPORT_SYMBOL(obd_cksum_type_select);
+
+#ifdef __KERNEL__
+/* checksum \a buf over and over for about 50ms, return MB/s */
+static unsigned int obd_cksum_bench(cksum_type_t type, unsigned char *buf)
+{
+        cfs_duration_t window = max_t(cfs_duration_t, 1,
+                                      cfs_time_seconds(1) / 20);
+        cfs_time_t     start;
+        cfs_duration_t elapsed;
+        __u64          bytes = 0;
+        __u32          cksum;
+
+        cksum = init_checksum(type);
+        start = cfs_time_current();
+        do {
+                cksum = compute_checksum(cksum, buf, CFS_PAGE_SIZE, type);
+                bytes += CFS_PAGE_SIZE;
+                elapsed = cfs_time_sub(cfs_time_current(), start);
+        } while (elapsed < window);
+
+        CDEBUG(D_INFO, "checksum type %x: "LPU64" bytes in %lu ticks (%x)\n",
+               type, bytes, (unsigned long)elapsed, cksum);
+        bytes = (bytes >> 20) * cfs_time_seconds(1);
+        do_div(bytes, (__u32)elapsed);
+        return max_t(unsigned int, bytes, 1);
+}
+#endif
+
+int obd_cksum_init(void)
+{
+#ifdef __KERNEL__
+        DECLARE_CKSUM_NAME;
+        unsigned char *buf;
+        int            i;
+#endif
+        ENTRY;
+
+        crc_table_init(obd_crc32_table, CRC32_POLY_LE);
+        crc_table_init(obd_crc32c_table, CRC32C_POLY_LE);
+#ifdef HAVE_CRC32C_SSE42
+        obd_crc32c_sse42 = boot_cpu_has(X86_FEATURE_XMM4_2);
+#endif
+
+#ifdef __KERNEL__
+        OBD_ALLOC(buf, CFS_PAGE_SIZE);
+        if (buf == NULL)
+                RETURN(-ENOMEM);
+        for (i = 0; i < CFS_PAGE_SIZE; i++)
+                buf[i] = i * 31;
+
+        for (i = 0; i < ARRAY_SIZE(cksum_name); i++) {
+                if (((1 << i) & OBD_CKSUM_ALL) == 0)
+                        continue;
+                obd_cksum_speed[i] = obd_cksum_bench(1 << i, buf);
+                CDEBUG(D_CONFIG, "checksum %s: %u MB/s\n", cksum_name[i],
+                       obd_cksum_speed[i]);
+        }
+        OBD_FREE(buf, CFS_PAGE_SIZE);
+#else
+        /* no fine grained clock here, rank the table driven algorithms */
+        obd_cksum_speed[0] = 1;         /* OBD_CKSUM_CRC32 */
+        obd_cksum_speed[1] = 2;         /* OBD_CKSUM_ADLER */
+        obd_cksum_speed[2] = 3;         /* OBD_CKSUM_CRC32C */
+#endif
+        RETURN(0);
+}
@@ -473,6 +473,14 @@ static int echo_object_init(const struct lu_env *env, struct lu_object *obj,
         RETURN(0);
 }
 
+static void echo_object_free_cb(cfs_rcu_head_t *head)
+{
+        struct echo_object *eco;
+
+        eco = container_of(head, struct echo_object, eo_hdr.coh_lu.loh_rcu);
+        OBD_SLAB_FREE_PTR(eco, echo_object_kmem);
+}
+
 static void echo_object_free(const struct lu_env *env, struct lu_object *obj)
 {
         struct echo_object *eco    = cl2echo_obj(lu2cl(obj));
@@ -491,7 +499,7 @@ static void echo_object_free(const struct lu_env *env, struct lu_object *obj)
 
         if (lsm)
                 obd_free_memmd(ec->ec_exp, &lsm);
-        OBD_SLAB_FREE_PTR(eco, echo_object_kmem);
+        my_call_rcu(&eco->eo_hdr.coh_lu.loh_rcu, echo_object_free_cb);
         EXIT;
 }
 
@@ -210,11 +210,24 @@ void f_dput(struct dentry *dentry)
         dput(dentry);
 }
 
-static void init_brw_stats(struct brw_stats *brw_stats)
+/* the per-export copies stay shared to keep their footprint small, only
+ * the OST-wide brw_stats counted on every I/O get per-CPU buckets */
+static void init_brw_stats(struct brw_stats *brw_stats, int percpu)
+{
+        int i;
+        for (i = 0; i < BRW_LAST; i++) {
+                if (percpu)
+                        lprocfs_oh_init_percpu(&brw_stats->hist[i]);
+                else
+                        cfs_spin_lock_init(&brw_stats->hist[i].oh_lock);
+        }
+}
+
+static void fini_brw_stats(struct brw_stats *brw_stats)
 {
         int i;
         for (i = 0; i < BRW_LAST; i++)
-                cfs_spin_lock_init(&brw_stats->hist[i].oh_lock);
+                lprocfs_oh_fini(&brw_stats->hist[i]);
 }
 
 static int lprocfs_init_rw_stats(struct obd_device *obd,
@@ -268,7 +281,7 @@ static int filter_export_stats_init(struct obd_device *obd,
                 if (tmp->nid_brw_stats == NULL)
                         GOTO(clean, rc = -ENOMEM);
 
-                init_brw_stats(tmp->nid_brw_stats);
+                init_brw_stats(tmp->nid_brw_stats, 0);
                 rc = lprocfs_seq_create(exp->exp_nid_stats->nid_proc, "brw_stats",
                                         0644, &filter_per_nid_stats_fops,
                                         exp->exp_nid_stats);
@@ -1825,8 +1838,9 @@ static int filter_intent_policy(struct ldlm_namespace *ns,
  * unknown at the time of OST thread creation.
  *
  * Instead array of iobuf's is attached to struct filter_obd (->fo_iobuf_pool
- * field). This array has size OST_MAX_THREADS, so that each OST thread uses
- * it's very own iobuf.
+ * field). This array has size OSS_THREADS_MAX + OSS_COMMIT_THREADS_MAX, so
+ * that each OST thread, and each OST write commit thread, uses it's very own
+ * iobuf.
  *
  * Functions below
  *
@@ -1896,12 +1910,13 @@ static int filter_iobuf_pool_init(struct filter_obd *filter)
         ENTRY;
 
 
-        OBD_ALLOC_GFP(filter->fo_iobuf_pool, OSS_THREADS_MAX * sizeof(*pool),
-                      GFP_KERNEL);
+        OBD_ALLOC_GFP(filter->fo_iobuf_pool,
+                      (OSS_THREADS_MAX + OSS_COMMIT_THREADS_MAX) *
+                      sizeof(*pool), GFP_KERNEL);
         if (filter->fo_iobuf_pool == NULL)
                 RETURN(-ENOMEM);
 
-        filter->fo_iobuf_count = OSS_THREADS_MAX;
+        filter->fo_iobuf_count = OSS_THREADS_MAX + OSS_COMMIT_THREADS_MAX;
 
         RETURN(0);
 }
@@ -2034,7 +2049,7 @@ int filter_common_setup(struct obd_device *obd, struct lustre_cfg* lcfg,
         cfs_spin_lock_init(&filter->fo_objidlock);
         CFS_INIT_LIST_HEAD(&filter->fo_export_list);
         cfs_sema_init(&filter->fo_alloc_lock, 1);
-        init_brw_stats(&filter->fo_filter_stats);
+        init_brw_stats(&filter->fo_filter_stats, 1);
         cfs_spin_lock_init(&filter->fo_flags_lock);
         filter->fo_read_cache = 1; /* enable read-only cache by default */
         filter->fo_writethrough_cache = 1; /* enable writethrough cache */
@@ -2128,6 +2143,7 @@ err_post:
 err_ops:
         fsfilt_put_ops(obd->obd_fsops);
         filter_iobuf_pool_done(filter);
+        fini_brw_stats(&filter->fo_filter_stats);
 err_mntput:
         server_put_mount(obd->obd_name, mnt);
         obd->u.obt.obt_sb = 0;
@@ -2183,6 +2199,12 @@ static int filter_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
                                      "cache_miss", "pages");
 
                 lproc_filter_attach_seqstat(obd);
+                rc = lprocfs_job_stats_init(obd, EXTRA_MAX_OPCODES +
+                                            LUSTRE_MAX_OPCODES,
+                                            ptlrpc_lprocfs_job_cntr_init);
+                if (rc)
+                        CERROR("%s: job stats init failed: rc = %d\n",
+                               obd->obd_name, rc);
                 obd->obd_proc_exports_entry = lprocfs_register("exports",
                                                         obd->obd_proc_entry,
                                                         NULL, NULL);
@@ -2204,6 +2226,7 @@ static int filter_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
         OBD_PAGE_FREE(page);
 
         if (rc) {
+                lprocfs_job_stats_fini(obd);
                 lprocfs_remove_proc_entry("clear", obd->obd_proc_exports_entry);
                 lprocfs_free_per_client_stats(obd);
                 lprocfs_free_obd_stats(obd);
@@ -2586,6 +2609,7 @@ static int filter_cleanup(struct obd_device *obd)
         obd_exports_barrier(obd);
         obd_zombie_barrier();
 
+        lprocfs_job_stats_fini(obd);
         lprocfs_remove_proc_entry("clear", obd->obd_proc_exports_entry);
         lprocfs_free_per_client_stats(obd);
         lprocfs_free_obd_stats(obd);
@@ -2611,6 +2635,7 @@ static int filter_cleanup(struct obd_device *obd)
         fsfilt_put_ops(obd->obd_fsops);
 
         filter_iobuf_pool_done(filter);
+        fini_brw_stats(&filter->fo_filter_stats);
 
         LCONSOLE_INFO("OST %s has stopped.\n", obd->obd_name);
 
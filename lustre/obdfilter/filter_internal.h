@@ -173,6 +173,7 @@ int filter_brw(int cmd, struct obd_export *, struct obd_info *oinfo,
                obd_count oa_bufs, struct brw_page *pga, struct obd_trans_info *);
 void filter_release_cache(struct obd_device *, struct obd_ioobj *,
                           struct niobuf_remote *, struct inode *);
+int filter_ioobj_npages(struct obd_ioobj *obj, struct niobuf_remote *nb);
 
 /* filter_io_*.c */
 struct filter_iobuf;
@@ -189,6 +190,7 @@ void filter_grant_incoming(struct obd_export *exp, struct obdo *oa);
 struct filter_iobuf *filter_alloc_iobuf(struct filter_obd *, int rw,
                                         int num_pages);
 void filter_free_iobuf(struct filter_iobuf *iobuf);
+void filter_clear_iobuf(struct filter_iobuf *iobuf);
 int filter_iobuf_add_page(struct obd_device *obd, struct filter_iobuf *iobuf,
                           struct inode *inode, struct page *page);
 void *filter_iobuf_get(struct filter_obd *filter, struct obd_trans_info *oti);
@@ -290,7 +290,8 @@ static struct page *filter_get_page(struct obd_device *obd,
 }
 
 /*
- * the routine initializes array of local_niobuf from remote_niobuf
+ * the routine initializes array of local_niobuf from remote_niobuf, the
+ * pages of each object follow those of the previous one
  */
 static int filter_map_remote_to_local(int objcount, struct obd_ioobj *obj,
                                       struct niobuf_remote *nb,
@@ -298,16 +299,15 @@ static int filter_map_remote_to_local(int objcount, struct obd_ioobj *obj,
 {
         struct niobuf_remote *rnb;
         struct niobuf_local *lnb;
-        int i, max;
+        int i, max, niocount;
         ENTRY;
 
-        /* we don't support multiobject RPC yet
-         * ost_brw_read() and ost_brw_write() check this */
-        LASSERT(objcount == 1);
+        for (niocount = i = 0; i < objcount; i++)
+                niocount += obj[i].ioo_bufcnt;
 
         max = *nrpages;
         *nrpages = 0;
-        for (i = 0, rnb = nb, lnb = res; i < obj->ioo_bufcnt; i++, rnb++) {
+        for (i = 0, rnb = nb, lnb = res; i < niocount; i++, rnb++) {
                 obd_off offset = rnb->offset;
                 unsigned int len = rnb->len;
 
@@ -339,6 +339,20 @@ static int filter_map_remote_to_local(int objcount, struct obd_ioobj *obj,
         RETURN(0);
 }
 
+/* number of local pages filter_map_remote_to_local() maps \a obj to */
+int filter_ioobj_npages(struct obd_ioobj *obj, struct niobuf_remote *nb)
+{
+        int i, npages = 0;
+
+        for (i = 0; i < obj->ioo_bufcnt; i++, nb++) {
+                if (nb->len == 0)
+                        continue;
+                npages += ((nb->offset + nb->len - 1) >> CFS_PAGE_SHIFT) -
+                          (nb->offset >> CFS_PAGE_SHIFT) + 1;
+        }
+        return npages;
+}
+
 /*
  * the invalidate above doesn't work during read because lnet pins pages.
  * The truncate is used here instead to drop pages from cache
@@ -628,16 +642,119 @@ static int filter_grant_check(struct obd_export *exp, struct obdo *oa,
         return rc;
 }
 
-/* If we ever start to support multi-object BRW RPCs, we will need to get locks
- * on mulitple inodes.  That isn't all, because there still exists the
- * possibility of a truncate starting a new transaction while holding the ext3
- * rwsem = write while some writes (which have started their transactions here)
- * blocking on the ext3 rwsem = read => lock inversion.
+/* Look up the dentry of object \a obj of a write, recreating the object if
+ * it is missing during recovery. */
+static struct dentry *filter_preprw_write_dentry(struct obd_export *exp,
+                                                 struct obdo *oa,
+                                                 struct obd_ioobj *obj,
+                                                 struct obd_trans_info *oti)
+{
+        struct dentry *dentry;
+
+        dentry = filter_fid2dentry(exp->exp_obd, NULL, obj->ioo_seq,
+                                   obj->ioo_id);
+        if (IS_ERR(dentry) || dentry->d_inode != NULL)
+                return dentry;
+
+        if (exp->exp_obd->obd_recovering &&
+            filter_create(exp, oa, NULL, oti) == 0) {
+                f_dput(dentry);
+                dentry = filter_fid2dentry(exp->exp_obd, NULL, obj->ioo_seq,
+                                           obj->ioo_id);
+        }
+        if (IS_ERR(dentry) || dentry->d_inode == NULL) {
+                CERROR("%s: BRW to missing obj "LPU64"/"LPU64":rc %d\n",
+                       exp->exp_obd->obd_name, obj->ioo_id, obj->ioo_seq,
+                       IS_ERR(dentry) ? (int)PTR_ERR(dentry) : -ENOENT);
+                if (!IS_ERR(dentry))
+                        f_dput(dentry);
+                dentry = ERR_PTR(-ENOENT);
+        }
+        return dentry;
+}
+
+/* Get and lock the \a npages pages of \a dentry described by \a lnb, queueing
+ * the partial pages which need reading from disk on \a iobuf. */
+static int filter_preprw_write_pages(struct obd_device *obd,
+                                     struct dentry *dentry,
+                                     struct niobuf_local *lnb, int npages,
+                                     struct filter_iobuf *iobuf, int localreq,
+                                     int *tot_bytes)
+{
+        int i;
+
+        for (i = 0; i < npages; i++, lnb++) {
+                /* We still set up for ungranted pages so that granted pages
+                 * can be written to disk as they were promised, and portals
+                 * needs to keep the pages all aligned properly. */
+                lnb->dentry = dentry;
+
+                lnb->page = filter_get_page(obd, dentry->d_inode, lnb->offset,
+                                            localreq);
+                if (lnb->page == NULL)
+                        return -ENOMEM;
+
+                /* DLM locking protects us from write and truncate competing
+                 * for same region, but truncate can leave dirty page in the
+                 * cache. it's possible the writeout on a such a page is in
+                 * progress when we access it. it's also possible that during
+                 * this writeout we put new (partial) data, but then won't
+                 * be able to proceed in filter_commitrw_write(). thus let's
+                 * just wait for writeout completion, should be rare enough.
+                 * -bzzz */
+                wait_on_page_writeback(lnb->page);
+                BUG_ON(PageWriteback(lnb->page));
+
+                /* If the filter writes a partial page, then has the file
+                 * extended, the client will read in the whole page.  the
+                 * filter has to be careful to zero the rest of the partial
+                 * page on disk.  we do it by hand for partial extending
+                 * writes, send_bio() is responsible for zeroing pages when
+                 * asked to read unmapped blocks -- brw_kiovec() does this. */
+                if (lnb->len != CFS_PAGE_SIZE) {
+                        __s64 maxidx;
+
+                        maxidx = ((i_size_read(dentry->d_inode) +
+                                   CFS_PAGE_SIZE - 1) >> CFS_PAGE_SHIFT) - 1;
+                        if (maxidx >= lnb->page->index) {
+                                LL_CDEBUG_PAGE(D_PAGE, lnb->page, "write %u @ "
+                                               LPU64" flg %x before EOF %llu\n",
+                                               lnb->len, lnb->offset,lnb->flags,
+                                               i_size_read(dentry->d_inode));
+                                filter_iobuf_add_page(obd, iobuf,
+                                                      dentry->d_inode,
+                                                      lnb->page);
+                        } else {
+                                long off;
+                                char *p = kmap(lnb->page);
+
+                                off = lnb->offset & ~CFS_PAGE_MASK;
+                                if (off)
+                                        memset(p, 0, off);
+                                off = (lnb->offset + lnb->len) & ~CFS_PAGE_MASK;
+                                if (off)
+                                        memset(p + off, 0, CFS_PAGE_SIZE - off);
+                                kunmap(lnb->page);
+                        }
+                }
+                if (lnb->rc == 0)
+                        *tot_bytes += lnb->len;
+        }
+        return 0;
+}
+
+/* A multi-object BRW write needs i_alloc_sem and the pages of several
+ * inodes.  Objects come sorted by id (ost_brw_write() checks this), so all
+ * writers take i_alloc_sem and then the page locks in object order, and a
+ * truncate only ever holds the i_alloc_sem of its own object.
  *
- * The handling gets very ugly when dealing with locked pages.  It may be easier
- * to just get rid of the locked page code (which has problems of its own) and
- * either discover we do not need it anymore (i.e. it was a symptom of another
- * bug) or ensure we get the page locks in an appropriate order. */
+ * There still exists the possibility of a truncate starting a new
+ * transaction while holding the ext3 rwsem = write while some writes (which
+ * have started their transactions here) blocking on the ext3 rwsem = read =>
+ * lock inversion.  It may be easier to just get rid of the locked page code
+ * (which has problems of its own) and either discover we do not need it
+ * anymore (i.e. it was a symptom of another bug) or ensure we get the page
+ * locks in an appropriate order. */
 static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
                                int objcount, struct obd_ioobj *obj,
                                struct niobuf_remote *nb, int *npages,
@@ -649,16 +766,19 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
         struct timeval start, end;
         struct lvfs_run_ctxt saved;
         struct niobuf_local *lnb = res;
-        struct fsfilt_objinfo fso;
+        struct fsfilt_objinfo fso[PTLRPC_MAX_BRW_OBJS];
         struct filter_mod_data *fmd;
         struct dentry *dentry = NULL;
+        struct niobuf_remote *rnb;
         void *iobuf;
         obd_size left;
         unsigned long now = jiffies, timediff;
-        int rc = 0, i, tot_bytes = 0, cleanup_phase = 0, localreq = 0;
+        int rc = 0, i, j, tot_bytes = 0, cleanup_phase = 0, localreq = 0;
+        int nr_dentries = 0;
         ENTRY;
-        LASSERT(objcount == 1);
+        LASSERT(objcount > 0 && objcount <= PTLRPC_MAX_BRW_OBJS);
         LASSERT(obj->ioo_bufcnt > 0);
+        LASSERT(oa != NULL);
 
         rc = filter_auth_capa(exp, NULL, oa->o_seq, capa,
                               CAPA_OPC_OSS_WRITE);
@@ -675,50 +795,21 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
                 GOTO(cleanup, rc = PTR_ERR(iobuf));
         cleanup_phase = 1;
 
-        dentry = filter_fid2dentry(obd, NULL, obj->ioo_seq,
-                                   obj->ioo_id);
-        if (IS_ERR(dentry))
-                GOTO(cleanup, rc = PTR_ERR(dentry));
-        cleanup_phase = 2;
-
-        if (dentry->d_inode == NULL) {
-                if (exp->exp_obd->obd_recovering) {
-                        struct obdo *noa = oa;
-
-                        if (oa == NULL) {
-                                OBDO_ALLOC(noa);
-                                if (noa == NULL)
-                                        GOTO(recreate_out, rc = -ENOMEM);
-                                noa->o_id = obj->ioo_id;
-                                noa->o_valid = OBD_MD_FLID;
-                        }
-
-                        if (filter_create(exp, noa, NULL, oti) == 0) {
-                                f_dput(dentry);
-                                dentry = filter_fid2dentry(exp->exp_obd, NULL,
-                                                           obj->ioo_seq,
-                                                           obj->ioo_id);
-                        }
-                        if (oa == NULL)
-                                OBDO_FREE(noa);
+        for (j = 0, rnb = nb; j < objcount; rnb += obj[j].ioo_bufcnt, j++) {
+                dentry = filter_preprw_write_dentry(exp, &oa[j], &obj[j], oti);
+                if (IS_ERR(dentry))
+                        GOTO(cleanup, rc = PTR_ERR(dentry));
+                fso[j].fso_dentry = dentry;
+                fso[j].fso_bufcnt = filter_ioobj_npages(&obj[j], rnb);
+                nr_dentries++;
+                cleanup_phase = 2;
+
+                if (oa[j].o_valid & (OBD_MD_FLUID | OBD_MD_FLGID) &&
+                    dentry->d_inode->i_mode & (S_ISUID | S_ISGID)) {
+                        rc = filter_capa_fixoa(exp, &oa[j], oa[j].o_seq, capa);
+                        if (rc)
+                                GOTO(cleanup, rc);
                 }
-    recreate_out:
-                if (IS_ERR(dentry) || dentry->d_inode == NULL) {
-                        CERROR("%s: BRW to missing obj "LPU64"/"LPU64":rc %d\n",
-                               exp->exp_obd->obd_name,
-                               obj->ioo_id, obj->ioo_seq,
-                               IS_ERR(dentry) ? (int)PTR_ERR(dentry) : -ENOENT);
-                        if (IS_ERR(dentry))
-                                cleanup_phase = 1;
-                        GOTO(cleanup, rc = -ENOENT);
-                }
-        }
-
-        if (oa->o_valid & (OBD_MD_FLUID | OBD_MD_FLGID) &&
-            dentry->d_inode->i_mode & (S_ISUID | S_ISGID)) {
-                rc = filter_capa_fixoa(exp, oa, oa->o_seq, capa);
-                if (rc)
-                        GOTO(cleanup, rc);
         }
 
         rc = filter_map_remote_to_local(objcount, obj, nb, npages, res);
@@ -733,7 +824,8 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
          * punch/write requests from one client, filter writes and
          * filter truncates are serialized by i_alloc_sem, allowing
          * multiple writes or single truncate. */
-        down_read(&dentry->d_inode->i_alloc_sem);
+        for (j = 0; j < objcount; j++)
+                down_read(&fso[j].fso_dentry->d_inode->i_alloc_sem);
         fsfilt_check_slow(obd, now, "i_alloc_sem");
 
         /* Don't update inode timestamps if this write is older than a
@@ -741,26 +833,28 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
         /* XXX when we start having persistent reservations this needs to
          * be changed to filter_fmd_get() to create the fmd if it doesn't
          * already exist so we can store the reservation handle there. */
-        fmd = filter_fmd_find(exp, obj->ioo_id, obj->ioo_seq);
+        for (j = 0; j < objcount; j++) {
+                fmd = filter_fmd_find(exp, obj[j].ioo_id, obj[j].ioo_seq);
+                if (fmd && fmd->fmd_mactime_xid > oti->oti_xid)
+                        oa[j].o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLCTIME |
+                                           OBD_MD_FLATIME);
+                else
+                        obdo_to_inode(fso[j].fso_dentry->d_inode, &oa[j],
+                                      OBD_MD_FLATIME | OBD_MD_FLMTIME |
+                                      OBD_MD_FLCTIME);
+                filter_fmd_put(exp, fmd);
+        }
 
-        LASSERT(oa != NULL);
+        /* grant is accounted per export, the first object's obdo carries
+         * it for the whole RPC */
         cfs_spin_lock(&obd->obd_osfs_lock);
         filter_grant_incoming(exp, oa);
-        if (fmd && fmd->fmd_mactime_xid > oti->oti_xid)
-                oa->o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLCTIME |
-                                 OBD_MD_FLATIME);
-        else
-                obdo_to_inode(dentry->d_inode, oa, OBD_MD_FLATIME |
-                              OBD_MD_FLMTIME | OBD_MD_FLCTIME);
         cleanup_phase = 3;
 
         left = filter_grant_space_left(exp);
 
-        fso.fso_dentry = dentry;
-        fso.fso_bufcnt = *npages;
-
-        rc = filter_grant_check(exp, oa, objcount, &fso, *npages, res,
-                                &left, dentry->d_inode);
+        rc = filter_grant_check(exp, oa, objcount, fso, *npages, res,
+                                &left, fso[0].fso_dentry->d_inode);
 
         /* do not zero out oa->o_valid as it is used in filter_commitrw_write()
          * for setting UID/GID and fid EA in first write time. */
@@ -775,7 +869,6 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
                                            left, 1);
 
         cfs_spin_unlock(&obd->obd_osfs_lock);
-        filter_fmd_put(exp, fmd);
 
         OBD_FAIL_TIMEOUT(OBD_FAIL_OST_BRW_PAUSE_BULK2, (obd_timeout + 1) / 4);
 
@@ -783,76 +876,32 @@ static int filter_preprw_write(int cmd, struct obd_export *exp, struct obdo *oa,
                 GOTO(cleanup, rc);
         cleanup_phase = 4;
 
-        cfs_gettimeofday(&start);
-        for (i = 0, lnb = res; i < *npages; i++, lnb++) {
+        for (j = 0, timediff = 0; j < objcount; j++) {
+                dentry = fso[j].fso_dentry;
 
-                /* We still set up for ungranted pages so that granted pages
-                 * can be written to disk as they were promised, and portals
-                 * needs to keep the pages all aligned properly. */
-                lnb->dentry = dentry;
+                cfs_gettimeofday(&start);
+                rc = filter_preprw_write_pages(obd, dentry, lnb,
+                                               fso[j].fso_bufcnt, iobuf,
+                                               localreq, &tot_bytes);
+                cfs_gettimeofday(&end);
+                timediff += cfs_timeval_sub(&end, &start, NULL);
+                if (rc)
+                        GOTO(cleanup, rc);
+                lnb += fso[j].fso_bufcnt;
 
-                lnb->page = filter_get_page(obd, dentry->d_inode, lnb->offset,
-                                            localreq);
-                if (lnb->page == NULL)
+                if (OBD_FAIL_CHECK(OBD_FAIL_OST_NOMEM))
                         GOTO(cleanup, rc = -ENOMEM);
 
-                /* DLM locking protects us from write and truncate competing
-                 * for same region, but truncate can leave dirty page in the
-                 * cache. it's possible the writeout on a such a page is in
-                 * progress when we access it. it's also possible that during
-                 * this writeout we put new (partial) data, but then won't
-                 * be able to proceed in filter_commitrw_write(). thus let's
-                 * just wait for writeout completion, should be rare enough.
-                 * -bzzz */
-                wait_on_page_writeback(lnb->page);
-                BUG_ON(PageWriteback(lnb->page));
-
-                /* If the filter writes a partial page, then has the file
-                 * extended, the client will read in the whole page.  the
-                 * filter has to be careful to zero the rest of the partial
-                 * page on disk.  we do it by hand for partial extending
-                 * writes, send_bio() is responsible for zeroing pages when
-                 * asked to read unmapped blocks -- brw_kiovec() does this. */
-                if (lnb->len != CFS_PAGE_SIZE) {
-                        __s64 maxidx;
-
-                        maxidx = ((i_size_read(dentry->d_inode) +
-                                   CFS_PAGE_SIZE - 1) >> CFS_PAGE_SHIFT) - 1;
-                        if (maxidx >= lnb->page->index) {
-                                LL_CDEBUG_PAGE(D_PAGE, lnb->page, "write %u @ "
-                                               LPU64" flg %x before EOF %llu\n",
-                                               lnb->len, lnb->offset,lnb->flags,
-                                               i_size_read(dentry->d_inode));
-                                filter_iobuf_add_page(obd, iobuf,
-                                                      dentry->d_inode,
-                                                      lnb->page);
-                        } else {
-                                long off;
-                                char *p = kmap(lnb->page);
-
-                                off = lnb->offset & ~CFS_PAGE_MASK;
-                                if (off)
-                                        memset(p, 0, off);
-                                off = (lnb->offset + lnb->len) & ~CFS_PAGE_MASK;
-                                if (off)
-                                        memset(p + off, 0, CFS_PAGE_SIZE - off);
-                                kunmap(lnb->page);
-                        }
-                }
-                if (lnb->rc == 0)
-                        tot_bytes += lnb->len;
+                /* don't unlock pages to prevent any access */
+                rc = filter_direct_io(OBD_BRW_READ, dentry, iobuf, exp,
+                                      NULL, NULL, NULL);
+                if (rc)
+                        GOTO(cleanup, rc);
+                /* the iobuf is reused for the next inode */
+                filter_clear_iobuf(iobuf);
         }
-        cfs_gettimeofday(&end);
-        timediff = cfs_timeval_sub(&end, &start, NULL);
         lprocfs_counter_add(obd->obd_stats, LPROC_FILTER_GET_PAGE, timediff);
 
-        if (OBD_FAIL_CHECK(OBD_FAIL_OST_NOMEM))
-                GOTO(cleanup, rc = -ENOMEM);
-
-        /* don't unlock pages to prevent any access */
-        rc = filter_direct_io(OBD_BRW_READ, dentry, iobuf, exp,
-                              NULL, NULL, NULL);
-
         fsfilt_check_slow(obd, now, "start_page_write");
 
         lprocfs_counter_add(obd->obd_stats, LPROC_FILTER_WRITE_BYTES,
@@ -876,13 +925,15 @@ cleanup:
                 }
         case 3:
                 if (rc)
-                        up_read(&dentry->d_inode->i_alloc_sem);
-
-                filter_iobuf_put(&obd->u.filter, iobuf, oti);
+                        for (j = 0; j < objcount; j++)
+                                up_read(&fso[j].fso_dentry->d_inode->
+                                        i_alloc_sem);
         case 2:
+                filter_iobuf_put(&obd->u.filter, iobuf, oti);
                 pop_ctxt(&saved, &obd->obd_lvfs_ctxt, NULL);
                 if (rc)
-                        f_dput(dentry);
+                        for (j = 0; j < nr_dentries; j++)
+                                f_dput(fso[j].fso_dentry);
                 break;
         case 1:
                 filter_iobuf_put(&obd->u.filter, iobuf, oti);
@@ -251,7 +251,7 @@ struct filter_iobuf *filter_alloc_iobuf(struct filter_obd *filter,
         RETURN(ERR_PTR(-ENOMEM));
 }
 
-static void filter_clear_iobuf(struct filter_iobuf *iobuf)
+void filter_clear_iobuf(struct filter_iobuf *iobuf)
 {
         iobuf->dr_npages = 0;
         iobuf->dr_error = 0;
@@ -576,11 +576,11 @@ static int filter_range_is_mapped(struct inode *inode, obd_size offset, int len)
  * - else?
  *
  */
-int filter_commitrw_write(struct obd_export *exp, struct obdo *oa,
-                          int objcount, struct obd_ioobj *obj,
-                          struct niobuf_remote *nb, int niocount,
-                          struct niobuf_local *res, struct obd_trans_info *oti,
-                          int rc)
+static int filter_commitrw_write_obj(struct obd_export *exp, struct obdo *oa,
+                                     struct obd_ioobj *obj,
+                                     struct niobuf_remote *nb, int niocount,
+                                     struct niobuf_local *res,
+                                     struct obd_trans_info *oti, int rc)
 {
         struct niobuf_local *lnb;
         struct filter_iobuf *iobuf = NULL;
@@ -600,7 +600,6 @@ int filter_commitrw_write(struct obd_export *exp, struct obdo *oa,
         ENTRY;
 
         LASSERT(oti != NULL);
-        LASSERT(objcount == 1);
         LASSERT(current->journal_info == NULL);
 
         if (rc != 0)
@@ -686,8 +685,7 @@ int filter_commitrw_write(struct obd_export *exp, struct obdo *oa,
 
         LOCK_INODE_MUTEX(inode);
         fsfilt_check_slow(obd, now, "i_mutex");
-        oti->oti_handle = fsfilt_brw_start(obd, objcount, &fso, niocount, res,
-                                           oti);
+        oti->oti_handle = fsfilt_brw_start(obd, 1, &fso, niocount, res, oti);
         if (IS_ERR(oti->oti_handle)) {
                 UNLOCK_INODE_MUTEX(inode);
                 rc = PTR_ERR(oti->oti_handle);
@@ -832,3 +830,30 @@ cleanup:
 
         RETURN(rc);
 }
+
+/* Each object of a multi-object write is committed in a transaction of its
+ * own, all of them under the transno of the request. */
+int filter_commitrw_write(struct obd_export *exp, struct obdo *oa,
+                          int objcount, struct obd_ioobj *obj,
+                          struct niobuf_remote *nb, int niocount,
+                          struct niobuf_local *res, struct obd_trans_info *oti,
+                          int rc)
+{
+        int i, npages, rc2, rc_first = 0;
+        ENTRY;
+
+        for (i = 0; i < objcount; nb += obj[i].ioo_bufcnt, i++) {
+                npages = filter_ioobj_npages(&obj[i], nb);
+                LASSERTF(npages <= niocount, "%d > %d\n", npages, niocount);
+
+                rc2 = filter_commitrw_write_obj(exp, &oa[i], &obj[i], nb,
+                                                npages, res, oti, rc);
+                if (rc_first == 0)
+                        rc_first = rc2;
+                res += npages;
+                niocount -= npages;
+        }
+        LASSERT(niocount == 0);
+
+        RETURN(rc_first);
+}
@@ -546,8 +546,8 @@ static void display_brw_stats(struct seq_file *seq, char *name, char *units,
         read_tot = lprocfs_oh_sum(read);
         write_tot = lprocfs_oh_sum(write);
         for (i = 0; i < OBD_HIST_MAX; i++) {
-                r = read->oh_buckets[i];
-                w = write->oh_buckets[i];
+                r = lprocfs_oh_counter(read, i);
+                w = lprocfs_oh_counter(write, i);
                 read_cum += r;
                 write_cum += w;
                 if (read_cum == 0 && write_cum == 0)
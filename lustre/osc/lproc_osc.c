@@ -117,6 +117,38 @@ static int osc_wr_max_pages_per_rpc(struct file *file, const char *buffer,
         return count;
 }
 
+static int osc_rd_extent_kb(char *page, char **start, off_t off,
+                            int count, int *eof, void *data)
+{
+        struct obd_device *dev = data;
+        struct client_obd *cli = &dev->u.cli;
+
+        return snprintf(page, count, "%d\n",
+                        cli->cl_extent_pages << (CFS_PAGE_SHIFT - 10));
+}
+
+static int osc_wr_extent_kb(struct file *file, const char *buffer,
+                            unsigned long count, void *data)
+{
+        struct obd_device *dev = data;
+        struct client_obd *cli = &dev->u.cli;
+        int val, rc;
+
+        rc = lprocfs_write_helper(buffer, count, &val);
+        if (rc)
+                return rc;
+
+        /* 0 disables extent mode */
+        val >>= CFS_PAGE_SHIFT - 10;
+        if (val < 0 || val > PTLRPC_MAX_BRW_PAGES)
+                return -ERANGE;
+
+        client_obd_list_lock(&cli->cl_loi_list_lock);
+        cli->cl_extent_pages = val;
+        client_obd_list_unlock(&cli->cl_loi_list_lock);
+        return count;
+}
+
 static int osc_rd_max_rpcs_in_flight(char *page, char **start, off_t off,
                                      int count, int *eof, void *data)
 {
@@ -609,6 +641,7 @@ static struct lprocfs_vars lprocfs_osc_obd_vars[] = {
                                osc_wr_max_pages_per_rpc, 0 },
         { "max_rpcs_in_flight", osc_rd_max_rpcs_in_flight,
                                 osc_wr_max_rpcs_in_flight, 0 },
+        { "extent_kb",       osc_rd_extent_kb, osc_wr_extent_kb, 0 },
         { "destroys_in_flight", osc_rd_destroys_in_flight, 0, 0 },
         { "max_dirty_mb",    osc_rd_max_dirty_mb, osc_wr_max_dirty_mb, 0 },
         { "cur_dirty_bytes", osc_rd_cur_dirty_bytes, 0, 0 },
@@ -647,6 +680,7 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
         struct obd_device *dev = seq->private;
         struct client_obd *cli = &dev->u.cli;
         unsigned long read_tot = 0, write_tot = 0, read_cum, write_cum;
+        __u64 usec;
         int i;
 
         cfs_gettimeofday(&now);
@@ -663,6 +697,14 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
                    cli->cl_pending_w_pages);
         seq_printf(seq, "pending read pages:   %d\n",
                    cli->cl_pending_r_pages);
+        seq_printf(seq, "write queue pages:    "LPU64"\n",
+                   cli->cl_w_queue_pages);
+        /* first argument to do_div MUST be __u64 */
+        usec = cli->cl_w_queue_nsec << (20 - CFS_PAGE_SHIFT);
+        if (cli->cl_w_queue_pages != 0)
+                do_div(usec, (__u32)cli->cl_w_queue_pages);
+        do_div(usec, 1000);
+        seq_printf(seq, "write queue usec/MB:  "LPU64"\n", usec);
 
         seq_printf(seq, "\n\t\t\tread\t\t\twrite\n");
         seq_printf(seq, "pages per rpc         rpcs   %% cum %% |");
@@ -674,8 +716,11 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
         read_cum = 0;
         write_cum = 0;
         for (i = 0; i < OBD_HIST_MAX; i++) {
-                unsigned long r = cli->cl_read_page_hist.oh_buckets[i];
-                unsigned long w = cli->cl_write_page_hist.oh_buckets[i];
+                unsigned long r;
+                unsigned long w;
+
+                r = lprocfs_oh_counter(&cli->cl_read_page_hist, i);
+                w = lprocfs_oh_counter(&cli->cl_write_page_hist, i);
                 read_cum += r;
                 write_cum += w;
                 seq_printf(seq, "%d:\t\t%10lu %3lu %3lu   | %10lu %3lu %3lu\n",
@@ -697,8 +742,11 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
         read_cum = 0;
         write_cum = 0;
         for (i = 0; i < OBD_HIST_MAX; i++) {
-                unsigned long r = cli->cl_read_rpc_hist.oh_buckets[i];
-                unsigned long w = cli->cl_write_rpc_hist.oh_buckets[i];
+                unsigned long r;
+                unsigned long w;
+
+                r = lprocfs_oh_counter(&cli->cl_read_rpc_hist, i);
+                w = lprocfs_oh_counter(&cli->cl_write_rpc_hist, i);
                 read_cum += r;
                 write_cum += w;
                 seq_printf(seq, "%d:\t\t%10lu %3lu %3lu   | %10lu %3lu %3lu\n",
@@ -720,8 +768,11 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
         read_cum = 0;
         write_cum = 0;
         for (i = 0; i < OBD_HIST_MAX; i++) {
-                unsigned long r = cli->cl_read_offset_hist.oh_buckets[i];
-                unsigned long w = cli->cl_write_offset_hist.oh_buckets[i];
+                unsigned long r;
+                unsigned long w;
+
+                r = lprocfs_oh_counter(&cli->cl_read_offset_hist, i);
+                w = lprocfs_oh_counter(&cli->cl_write_offset_hist, i);
                 read_cum += r;
                 write_cum += w;
                 seq_printf(seq, "%d:\t\t%10lu %3lu %3lu   | %10lu %3lu %3lu\n",
@@ -732,6 +783,22 @@ static int osc_rpc_stats_seq_show(struct seq_file *seq, void *v)
                         break;
         }
 
+        seq_printf(seq, "\n\t\t\twrite\n");
+        seq_printf(seq, "objects per rpc       rpcs   %% cum %%\n");
+
+        write_tot = lprocfs_oh_sum(&cli->cl_write_obj_hist);
+        write_cum = 0;
+        for (i = 1; i < OBD_HIST_MAX; i++) {
+                unsigned long w;
+
+                w = lprocfs_oh_counter(&cli->cl_write_obj_hist, i);
+                write_cum += w;
+                seq_printf(seq, "%d:\t\t%10lu %3lu %3lu\n",
+                           i, w, pct(w, write_tot), pct(write_cum, write_tot));
+                if (write_cum == write_tot)
+                        break;
+        }
+
         client_obd_list_unlock(&cli->cl_loi_list_lock);
 
         return 0;
@@ -751,6 +818,11 @@ static ssize_t osc_rpc_stats_seq_write(struct file *file, const char *buf,
         lprocfs_oh_clear(&cli->cl_write_page_hist);
         lprocfs_oh_clear(&cli->cl_read_offset_hist);
         lprocfs_oh_clear(&cli->cl_write_offset_hist);
+        lprocfs_oh_clear(&cli->cl_write_obj_hist);
+        client_obd_list_lock(&cli->cl_loi_list_lock);
+        cli->cl_w_queue_nsec = 0;
+        cli->cl_w_queue_pages = 0;
+        client_obd_list_unlock(&cli->cl_loi_list_lock);
 
         return len;
 }
@@ -66,6 +66,9 @@ struct osc_async_page {
         cfs_list_t              oap_pending_item;
         cfs_list_t              oap_urgent_item;
         cfs_list_t              oap_rpc_item;
+        /* linkage into osc_extent::oe_pages, in offset order */
+        cfs_list_t              oap_extent_item;
+        struct osc_extent      *oap_extent;
 
         obd_off                 oap_obj_off;
         unsigned                oap_page_off;
@@ -120,6 +123,30 @@ int osc_shrink_grant_to_target(struct client_obd *cli, long target);
  */
 #include <cl_object.h>
 
+/**
+ * A run of dirty pages of one object, queued for write, with ascending page
+ * indices.  Pages join the extent they are adjacent to when they are queued,
+ * so write RPCs are cut straight out of an extent without sorting pages or
+ * checking them for fragmentation.  Pages leaving the middle of an extent
+ * (truncate, interrupted sync io) leave a hole in it; RPCs stop at holes.
+ *
+ * An extent only tracks a range of pages: the pages stay on the per-object
+ * pending lists, and grant is still taken and released per page.
+ *
+ * Protected by client_obd::cl_loi_list_lock.
+ */
+struct osc_extent {
+        /* linkage into loi_oap_pages::lop_extents, ordered by oe_start */
+        cfs_list_t              oe_link;
+        /* osc_async_page::oap_extent_item, ordered by offset */
+        cfs_list_t              oe_pages;
+        pgoff_t                 oe_start;
+        pgoff_t                 oe_end;
+        int                     oe_nr_pages;
+};
+
+extern cfs_mem_cache_t *osc_extent_kmem;
+
 extern struct ptlrpc_request_set *PTLRPCD_SET;
 
 int osc_enqueue_base(struct obd_export *exp, struct ldlm_res_id *res_id,
@@ -664,9 +664,13 @@ static void osc_req_attr_set(const struct lu_env *env,
         if (flags & OBD_MD_FLHANDLE) {
                 clerq = slice->crs_req;
                 LASSERT(!cfs_list_empty(&clerq->crq_pages));
-                apage = container_of(clerq->crq_pages.next,
-                                     struct cl_page, cp_flight);
-                opg = osc_cl_page_osc(apage);
+                /* a page of @obj, the request may have several objects */
+                cfs_list_for_each_entry(apage, &clerq->crq_pages, cp_flight) {
+                        opg = osc_cl_page_osc(apage);
+                        if (opg->ops_cl.cpl_obj == obj)
+                                break;
+                }
+                LASSERT(&apage->cp_flight != &clerq->crq_pages);
                 apage = opg->ops_cl.cpl_page; /* now apage is a sub-page */
                 lock = cl_lock_at_page(env, apage->cp_obj, apage, NULL, 1, 1);
                 if (lock == NULL) {
@@ -1244,18 +1244,30 @@ static obd_count osc_checksum_bulk(int nob, obd_count pg_count,
         return cksum;
 }
 
+/**
+ * Build a BRW request of the \a page_count pages of \a pga.
+ *
+ * The pages belong to the object of \a oa, unless \a objs describes the
+ * \a objcount objects of a multi-object write: objs[0].bo_oa is \a oa then
+ * and the pages of each object follow those of the previous one in \a pga.
+ */
 static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
                                 struct lov_stripe_md *lsm, obd_count page_count,
                                 struct brw_page **pga,
                                 struct ptlrpc_request **reqp,
-                                struct obd_capa *ocapa, int reserve)
+                                struct obd_capa *ocapa, int reserve,
+                                struct osc_brw_obj *objs, int objcount)
 {
         struct ptlrpc_request   *req;
         struct ptlrpc_bulk_desc *desc;
         struct ost_body         *body;
         struct obd_ioobj        *ioobj;
         struct niobuf_remote    *niobuf;
-        int niocount, i, requested_nob, opc, rc;
+        struct obdo             *obdos = NULL;
+        struct osc_brw_obj       one = { .bo_oa = oa,
+                                         .bo_page_count = page_count };
+        int niocount, i, j, k, requested_nob, opc, rc;
+        int obj_first, obj_end;
         struct osc_brw_async_args *aa;
         struct req_capsule      *pill;
         struct brw_page *pg_prev;
@@ -1278,17 +1290,31 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
         if (req == NULL)
                 RETURN(-ENOMEM);
 
-        for (niocount = i = 1; i < page_count; i++) {
-                if (!can_merge_pages(pga[i - 1], pga[i]))
-                        niocount++;
+        if (objs == NULL) {
+                objs = &one;
+                objcount = 1;
+        }
+        LASSERT(objs[0].bo_oa == oa);
+        LASSERT(objcount == 1 || opc == OST_WRITE);
+
+        /* pages of different objects never share a niobuf */
+        for (niocount = i = j = 0; j < objcount; j++) {
+                for (k = 0; k < objs[j].bo_page_count; k++, i++) {
+                        if (k == 0 || !can_merge_pages(pga[i - 1], pga[i]))
+                                niocount++;
+                }
         }
+        LASSERT(i == page_count);
 
         pill = &req->rq_pill;
         req_capsule_set_size(pill, &RMF_OBD_IOOBJ, RCL_CLIENT,
-                             sizeof(*ioobj));
+                             objcount * sizeof(*ioobj));
         req_capsule_set_size(pill, &RMF_NIOBUF_REMOTE, RCL_CLIENT,
                              niocount * sizeof(*niobuf));
         osc_set_capa_size(req, &RMF_CAPA1, ocapa);
+        if (opc == OST_WRITE)
+                req_capsule_set_size(pill, &RMF_BRW_OBDOS, RCL_CLIENT,
+                                     (objcount - 1) * sizeof(*obdos));
 
         rc = ptlrpc_request_pack(req, LUSTRE_OST_VERSION, opc);
         if (rc) {
@@ -1316,20 +1342,35 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
 
         lustre_set_wire_obdo(&body->oa, oa);
 
-        obdo_to_ioobj(oa, ioobj);
-        ioobj->ioo_bufcnt = niocount;
+        if (objcount > 1) {
+                obdos = req_capsule_client_get(pill, &RMF_BRW_OBDOS);
+                LASSERT(obdos != NULL);
+        }
+        for (j = 0; j < objcount; j++) {
+                obdo_to_ioobj(objs[j].bo_oa, &ioobj[j]);
+                ioobj[j].ioo_bufcnt = 0;
+                if (j > 0)
+                        lustre_set_wire_obdo(&obdos[j - 1], objs[j].bo_oa);
+        }
         osc_pack_capa(req, body, ocapa);
         LASSERT (page_count > 0);
         pg_prev = pga[0];
+        obj_first = j = 0;
+        obj_end = objs[0].bo_page_count;
         for (requested_nob = i = 0; i < page_count; i++, niobuf++) {
                 struct brw_page *pg = pga[i];
 
+                if (i == obj_end) {
+                        obj_first = i;
+                        obj_end += objs[++j].bo_page_count;
+                }
+
                 LASSERT(pg->count > 0);
                 LASSERTF((pg->off & ~CFS_PAGE_MASK) + pg->count <= CFS_PAGE_SIZE,
                          "i: %d pg: %p off: "LPU64", count: %u\n", i, pg,
                          pg->off, pg->count);
 #ifdef __linux__
-                LASSERTF(i == 0 || pg->off > pg_prev->off,
+                LASSERTF(i == obj_first || pg->off > pg_prev->off,
                          "i %d p_c %u pg %p [pri %lu ind %lu] off "LPU64
                          " prev_pg %p [pri %lu ind %lu] off "LPU64"\n",
                          i, page_count,
@@ -1337,7 +1378,7 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
                          pg_prev->pg, page_private(pg_prev->pg),
                          pg_prev->pg->index, pg_prev->off);
 #else
-                LASSERTF(i == 0 || pg->off > pg_prev->off,
+                LASSERTF(i == obj_first || pg->off > pg_prev->off,
                          "i %d p_c %u\n", i, page_count);
 #endif
                 LASSERT((pga[0]->flag & OBD_BRW_SRVLOCK) ==
@@ -1347,16 +1388,18 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
                                       pg->count);
                 requested_nob += pg->count;
 
-                if (i > 0 && can_merge_pages(pg_prev, pg)) {
+                if (i > obj_first && can_merge_pages(pg_prev, pg)) {
                         niobuf--;
                         niobuf->len += pg->count;
                 } else {
                         niobuf->offset = pg->off;
                         niobuf->len    = pg->count;
                         niobuf->flags  = pg->flag;
+                        ioobj[j].ioo_bufcnt++;
                 }
                 pg_prev = pg;
         }
+        LASSERT(j == objcount - 1);
 
         LASSERTF((void *)(niobuf - niocount) ==
                 req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE),
@@ -1399,6 +1442,8 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
                 /* 1 RC per niobuf */
                 req_capsule_set_size(pill, &RMF_RCS, RCL_SERVER,
                                      sizeof(__u32) * niocount);
+                req_capsule_set_size(pill, &RMF_BRW_OBDOS, RCL_SERVER,
+                                     (objcount - 1) * sizeof(*obdos));
         } else {
                 if (unlikely(cli->cl_checksum) &&
                     !sptlrpc_flavor_has_bulk(&req->rq_flvr)) {
@@ -1419,6 +1464,8 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
         aa->aa_resends = 0;
         aa->aa_ppga = pga;
         aa->aa_cli = cli;
+        aa->aa_objs = objcount > 1 ? objs : NULL;
+        aa->aa_objcount = objcount;
         CFS_INIT_LIST_HEAD(&aa->aa_oaps);
         if (ocapa && reserve)
                 aa->aa_ocapa = capa_get(ocapa);
@@ -1486,6 +1533,21 @@ static int check_write_checksum(struct obdo *oa, const lnet_process_id_t *peer,
 }
 
 /* Note rc enters this function as number of bytes transferred */
+#ifdef HAVE_QUOTA_SUPPORT
+/* set/clear over quota flag for a uid/gid */
+static void osc_brw_setdq(struct client_obd *cli, struct obdo *oa)
+{
+        unsigned int qid[MAXQUOTAS] = { oa->o_uid, oa->o_gid };
+
+        if (!(oa->o_valid & (OBD_MD_FLUSRQUOTA | OBD_MD_FLGRPQUOTA)))
+                return;
+
+        CDEBUG(D_QUOTA, "setdq for [%u %u] with valid "LPX64", flags %x\n",
+               oa->o_uid, oa->o_gid, oa->o_valid, oa->o_flags);
+        lquota_setdq(quota_interface, cli, qid, oa->o_valid, oa->o_flags);
+}
+#endif
+
 static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
 {
         struct osc_brw_async_args *aa = (void *)&req->rq_async_args;
@@ -1493,7 +1555,9 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                         &req->rq_import->imp_connection->c_peer;
         struct client_obd *cli = aa->aa_cli;
         struct ost_body *body;
+        struct obdo *rep_oa = NULL;
         __u32 client_cksum = 0;
+        int i;
         ENTRY;
 
         if (rc < 0 && rc != -EDQUOT) {
@@ -1508,17 +1572,23 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                 RETURN(-EPROTO);
         }
 
-#ifdef HAVE_QUOTA_SUPPORT
-        /* set/clear over quota flag for a uid/gid */
-        if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE &&
-            body->oa.o_valid & (OBD_MD_FLUSRQUOTA | OBD_MD_FLGRPQUOTA)) {
-                unsigned int qid[MAXQUOTAS] = { body->oa.o_uid, body->oa.o_gid };
+        /* the obdos of the other objects of a multi-object write */
+        if (aa->aa_objcount > 1) {
+                rep_oa = req_capsule_server_sized_get(&req->rq_pill,
+                                                      &RMF_BRW_OBDOS,
+                                                      (aa->aa_objcount - 1) *
+                                                      sizeof(*rep_oa));
+                if (rep_oa == NULL) {
+                        DEBUG_REQ(D_INFO, req, "Can't unpack obdos\n");
+                        RETURN(-EPROTO);
+                }
+        }
 
-                CDEBUG(D_QUOTA, "setdq for [%u %u] with valid "LPX64", flags %x\n",
-                       body->oa.o_uid, body->oa.o_gid, body->oa.o_valid,
-                       body->oa.o_flags);
-                lquota_setdq(quota_interface, cli, qid, body->oa.o_valid,
-                             body->oa.o_flags);
+#ifdef HAVE_QUOTA_SUPPORT
+        if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE) {
+                osc_brw_setdq(cli, &body->oa);
+                for (i = 1; i < aa->aa_objcount; i++)
+                        osc_brw_setdq(cli, &rep_oa[i - 1]);
         }
 #endif
 
@@ -1643,8 +1713,12 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                 rc = 0;
         }
 out:
-        if (rc >= 0)
+        if (rc >= 0) {
                 lustre_get_wire_obdo(aa->aa_oa, &body->oa);
+                for (i = 1; i < aa->aa_objcount; i++)
+                        lustre_get_wire_obdo(aa->aa_objs[i].bo_oa,
+                                             &rep_oa[i - 1]);
+        }
 
         RETURN(rc);
 }
@@ -1666,7 +1740,7 @@ static int osc_brw_internal(int cmd, struct obd_export *exp, struct obdo *oa,
 
 restart_bulk:
         rc = osc_brw_prep_request(cmd, &exp->exp_obd->u.cli, oa, lsm,
-                                  page_count, pga, &req, ocapa, 0);
+                                  page_count, pga, &req, ocapa, 0, NULL, 1);
         if (rc != 0)
                 return (rc);
 
@@ -1719,7 +1793,8 @@ int osc_brw_redo_request(struct ptlrpc_request *request,
                                   aa->aa_cli, aa->aa_oa,
                                   NULL /* lsm unused by osc currently */,
                                   aa->aa_page_count, aa->aa_ppga,
-                                  &new_req, aa->aa_ocapa, 0);
+                                  &new_req, aa->aa_ocapa, 0,
+                                  aa->aa_objs, aa->aa_objcount);
         if (rc)
                 RETURN(rc);
 
@@ -2043,6 +2118,175 @@ static void lop_update_pending(struct client_obd *cli,
                 cli->cl_pending_r_pages += delta;
 }
 
+static inline pgoff_t osc_oap_index(struct osc_async_page *oap)
+{
+        return oap->oap_obj_off >> CFS_PAGE_SHIFT;
+}
+
+/* link @oap into the page list of @oe, keeping it in offset order */
+static void osc_extent_insert(struct osc_extent *oe,
+                              struct osc_async_page *oap)
+{
+        struct osc_async_page *tmp;
+        pgoff_t index = osc_oap_index(oap);
+
+        /* pages are mostly appended, search backwards */
+        cfs_list_for_each_entry_reverse(tmp, &oe->oe_pages, oap_extent_item) {
+                LASSERT(osc_oap_index(tmp) != index);
+                if (osc_oap_index(tmp) < index)
+                        break;
+        }
+        /* @tmp is the last page before @oap, or the list head */
+        cfs_list_add(&oap->oap_extent_item, &tmp->oap_extent_item);
+
+        oap->oap_extent = oe;
+        oe->oe_nr_pages++;
+        if (index < oe->oe_start)
+                oe->oe_start = index;
+        if (index > oe->oe_end)
+                oe->oe_end = index;
+}
+
+/* how many extents osc_extent_add() looks at under the loi list lock */
+#define OSC_EXTENT_SCAN_MAX     16
+
+/**
+ * Add a page queued for write to the extent it is adjacent to, or start a
+ * new extent for it.  A page closing the gap between two extents merges
+ * them.  This is called under the loi list lock, so the extent is allocated
+ * atomically and the search is cut short after OSC_EXTENT_SCAN_MAX extents;
+ * if either fails the page is simply left out of the extent cache and goes
+ * out through the per-page path of osc_send_oap_rpc().
+ */
+static void osc_extent_add(struct loi_oap_pages *lop,
+                           struct osc_async_page *oap)
+{
+        struct osc_extent     *oe;
+        struct osc_extent     *prev = NULL;
+        struct osc_extent     *next = NULL;
+        struct osc_async_page *tmp;
+        struct osc_async_page *tmp2;
+        pgoff_t                index = osc_oap_index(oap);
+        int                    scanned = 0;
+
+        LASSERT(oap->oap_extent == NULL);
+
+        /* streaming writers extend the last extent, search backwards */
+        cfs_list_for_each_entry_reverse(oe, &lop->lop_extents, oe_link) {
+                if (oe->oe_start <= index) {
+                        prev = oe;
+                        break;
+                }
+                if (++scanned >= OSC_EXTENT_SCAN_MAX)
+                        return;
+                next = oe;
+        }
+
+        if (prev != NULL && prev->oe_end + 1 >= index) {
+                oe = prev;
+        } else if (next != NULL && next->oe_start == index + 1) {
+                oe = next;
+        } else {
+                OBD_SLAB_ALLOC_PTR_GFP(oe, osc_extent_kmem, CFS_ALLOC_ATOMIC);
+                if (oe == NULL)
+                        return;
+                CFS_INIT_LIST_HEAD(&oe->oe_pages);
+                oe->oe_start = oe->oe_end = index;
+                if (prev != NULL)
+                        cfs_list_add(&oe->oe_link, &prev->oe_link);
+                else
+                        cfs_list_add(&oe->oe_link, &lop->lop_extents);
+        }
+        osc_extent_insert(oe, oap);
+
+        if (oe != prev || next == NULL || next->oe_start != oe->oe_end + 1)
+                return;
+
+        /* @oap filled the last gap between @prev and @next */
+        cfs_list_for_each_entry_safe(tmp, tmp2, &next->oe_pages,
+                                     oap_extent_item) {
+                tmp->oap_extent = oe;
+                cfs_list_move_tail(&tmp->oap_extent_item, &oe->oe_pages);
+        }
+        oe->oe_end = next->oe_end;
+        oe->oe_nr_pages += next->oe_nr_pages;
+        cfs_list_del(&next->oe_link);
+        OBD_SLAB_FREE_PTR(next, osc_extent_kmem);
+}
+
+/* take @oap out of its extent, if any; the extent is freed with its last
+ * page */
+static void osc_extent_del(struct osc_async_page *oap)
+{
+        struct osc_extent *oe = oap->oap_extent;
+
+        if (oe == NULL)
+                return;
+
+        oap->oap_extent = NULL;
+        cfs_list_del_init(&oap->oap_extent_item);
+
+        if (--oe->oe_nr_pages == 0) {
+                cfs_list_del(&oe->oe_link);
+                OBD_SLAB_FREE_PTR(oe, osc_extent_kmem);
+                return;
+        }
+
+        oe->oe_start = osc_oap_index(cfs_list_entry(oe->oe_pages.next,
+                                                    struct osc_async_page,
+                                                    oap_extent_item));
+        oe->oe_end = osc_oap_index(cfs_list_entry(oe->oe_pages.prev,
+                                                  struct osc_async_page,
+                                                  oap_extent_item));
+}
+
+/**
+ * Return the page of @oe a write RPC carrying @oap should start with: the
+ * first page of @oe in the cl_max_pages_per_rpc aligned window around @oap,
+ * so that RPCs cut out of a long extent are full sized and aligned.
+ */
+static struct osc_async_page *osc_extent_rpc_start(struct client_obd *cli,
+                                                   struct osc_extent *oe,
+                                                   struct osc_async_page *oap)
+{
+        struct osc_async_page *tmp;
+        pgoff_t start = osc_oap_index(oap);
+
+        start -= start % cli->cl_max_pages_per_rpc;
+        if (start <= oe->oe_start)
+                return cfs_list_entry(oe->oe_pages.next,
+                                      struct osc_async_page, oap_extent_item);
+
+        cfs_list_for_each_entry(tmp, &oe->oe_pages, oap_extent_item) {
+                if (osc_oap_index(tmp) >= start)
+                        break;
+        }
+        LASSERT(&tmp->oap_extent_item != &oe->oe_pages);
+        return tmp;
+}
+
+/* the page following @oap in its extent, or in the pending queue of @lop
+ * when the RPC is not built from an extent */
+static struct osc_async_page *osc_oap_next(struct loi_oap_pages *lop,
+                                           struct osc_async_page *oap,
+                                           int by_extent)
+{
+        struct osc_extent *oe = oap->oap_extent;
+
+        if (by_extent) {
+                LASSERT(oe != NULL);
+                if (oap->oap_extent_item.next == &oe->oe_pages)
+                        return NULL;
+                return cfs_list_entry(oap->oap_extent_item.next,
+                                      struct osc_async_page, oap_extent_item);
+        }
+
+        if (oap->oap_pending_item.next == &lop->lop_pending)
+                return NULL;
+        return cfs_list_entry(oap->oap_pending_item.next,
+                              struct osc_async_page, oap_pending_item);
+}
+
 /**
  * this is called when a sync waiter receives an interruption.  Its job is to
  * get the caller woken as soon as possible.  If its page hasn't been put in an
@@ -2075,6 +2319,7 @@ int osc_oap_interrupted(const struct lu_env *env, struct osc_async_page *oap)
         if (!cfs_list_empty(&oap->oap_pending_item)) {
                 cfs_list_del_init(&oap->oap_pending_item);
                 cfs_list_del_init(&oap->oap_urgent_item);
+                osc_extent_del(oap);
 
                 loi = oap->oap_loi;
                 lop = (oap->oap_cmd & OBD_BRW_WRITE) ?
@@ -2125,6 +2370,8 @@ void osc_oap_to_pending(struct osc_async_page *oap)
         else if (oap->oap_async_flags & ASYNC_URGENT)
                 cfs_list_add_tail(&oap->oap_urgent_item, &lop->lop_urgent);
         cfs_list_add_tail(&oap->oap_pending_item, &lop->lop_pending);
+        if (oap->oap_cmd & OBD_BRW_WRITE)
+                osc_extent_add(lop, oap);
         lop_update_pending(oap->oap_cli, lop, oap->oap_cmd, 1);
 }
 
@@ -2178,6 +2425,31 @@ static void osc_ap_completion(const struct lu_env *env,
         EXIT;
 }
 
+/* the obdo of the object \a oap belongs to */
+static struct obdo *osc_brw_oap_oa(struct osc_brw_async_args *aa,
+                                   struct osc_async_page *oap)
+{
+        int i;
+
+        for (i = 1; i < aa->aa_objcount; i++) {
+                if (aa->aa_objs[i].bo_loi == oap->oap_loi)
+                        return aa->aa_objs[i].bo_oa;
+        }
+        return aa->aa_oa;
+}
+
+/* free the objects of a multi-object write but the first obdo, aa_oa */
+static void osc_brw_objs_free(struct osc_brw_obj *objs, int objcount)
+{
+        int i;
+
+        if (objs == NULL)
+                return;
+        for (i = 1; i < objcount; i++)
+                OBDO_FREE(objs[i].bo_oa);
+        OBD_FREE(objs, objcount * sizeof(*objs));
+}
+
 static int brw_interpret(const struct lu_env *env,
                          struct ptlrpc_request *req, void *data, int rc)
 {
@@ -2230,9 +2502,11 @@ static int brw_interpret(const struct lu_env *env,
                 cfs_list_for_each_entry_safe(oap, tmp, &aa->aa_oaps,
                                              oap_rpc_item) {
                         cfs_list_del_init(&oap->oap_rpc_item);
-                        osc_ap_completion(env, cli, aa->aa_oa, oap, 1, rc);
+                        osc_ap_completion(env, cli, osc_brw_oap_oa(aa, oap),
+                                          oap, 1, rc);
                 }
                 OBDO_FREE(aa->aa_oa);
+                osc_brw_objs_free(aa->aa_objs, aa->aa_objcount);
         } else { /* from async_internal() */
                 obd_count i;
                 for (i = 0; i < aa->aa_page_count; i++)
@@ -2248,6 +2522,61 @@ static int brw_interpret(const struct lu_env *env,
         RETURN(rc);
 }
 
+/**
+ * Set up the \a objcount objects of a multi-object write, crattr[i] holding
+ * the attributes of the i-th object of \a rpc_list, whose pages come grouped
+ * by object.  The objects are sorted by id, the order the OST locks them
+ * in, and the pages of each are laid out in \a pga in offset order.
+ */
+static void osc_brw_objs_prep(cfs_list_t *rpc_list, struct cl_req_attr *crattr,
+                              struct osc_brw_obj *objs, int objcount,
+                              struct brw_page **pga)
+{
+        struct osc_async_page *oap;
+        struct lov_oinfo      *loi = NULL;
+        struct osc_brw_obj     obj;
+        int                    first;
+        int                    i;
+        int                    j;
+
+        i = 0;
+        cfs_list_for_each_entry(oap, rpc_list, oap_rpc_item) {
+                if (oap->oap_loi != loi) {
+                        LASSERT(i < objcount);
+                        loi = oap->oap_loi;
+                        objs[i].bo_oa = crattr[i].cra_oa;
+                        objs[i].bo_loi = loi;
+                        objs[i].bo_page_count = 0;
+                        i++;
+                }
+                objs[i - 1].bo_page_count++;
+        }
+        LASSERT(i == objcount);
+
+        for (i = 1; i < objcount; i++) {
+                obj = objs[i];
+                for (j = i; j > 0; j--) {
+                        struct obdo *prev = objs[j - 1].bo_oa;
+
+                        if (prev->o_seq < obj.bo_oa->o_seq ||
+                            (prev->o_seq == obj.bo_oa->o_seq &&
+                             prev->o_id < obj.bo_oa->o_id))
+                                break;
+                        objs[j] = objs[j - 1];
+                }
+                objs[j] = obj;
+        }
+
+        for (i = j = 0; j < objcount; j++) {
+                first = i;
+                cfs_list_for_each_entry(oap, rpc_list, oap_rpc_item) {
+                        if (oap->oap_loi == objs[j].bo_loi)
+                                pga[i++] = &oap->oap_brw_page;
+                }
+                sort_brw_pages(pga + first, i - first);
+        }
+}
+
 static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
                                             struct client_obd *cli,
                                             cfs_list_t *rpc_list,
@@ -2265,8 +2594,13 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
         struct cl_req *clerq = NULL;
         enum cl_req_type crt = (cmd & OBD_BRW_WRITE) ? CRT_WRITE : CRT_READ;
         struct ldlm_lock *lock = NULL;
-        struct cl_req_attr crattr;
+        struct cl_req_attr crattr_one;
+        struct cl_req_attr *crattr = &crattr_one;
+        struct osc_brw_obj *objs = NULL;
+        struct lov_oinfo *loi = NULL;
+        int objcount = 0;
         int i, rc, mpflag = 0;
+        int sorted = 1;
 
         ENTRY;
         LASSERT(!cfs_list_empty(rpc_list));
@@ -2274,14 +2608,33 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
         if (cmd & OBD_BRW_MEMALLOC)
                 mpflag = cfs_memory_pressure_get_and_set();
 
-        memset(&crattr, 0, sizeof crattr);
+        /* the pages of a multi-object write come grouped by object */
+        cfs_list_for_each_entry(oap, rpc_list, oap_rpc_item) {
+                if (oap->oap_loi != loi) {
+                        loi = oap->oap_loi;
+                        objcount++;
+                }
+        }
+
+        memset(&crattr_one, 0, sizeof crattr_one);
+        if (objcount > 1) {
+                OBD_ALLOC(crattr, objcount * sizeof(*crattr));
+                if (crattr == NULL)
+                        GOTO(out, req = ERR_PTR(-ENOMEM));
+                OBD_ALLOC(objs, objcount * sizeof(*objs));
+                if (objs == NULL)
+                        GOTO(out, req = ERR_PTR(-ENOMEM));
+        }
+
         OBD_ALLOC(pga, sizeof(*pga) * page_count);
         if (pga == NULL)
                 GOTO(out, req = ERR_PTR(-ENOMEM));
 
-        OBDO_ALLOC(oa);
-        if (oa == NULL)
-                GOTO(out, req = ERR_PTR(-ENOMEM));
+        for (i = 0; i < objcount; i++) {
+                OBDO_ALLOC(crattr[i].cra_oa);
+                if (crattr[i].cra_oa == NULL)
+                        GOTO(out, req = ERR_PTR(-ENOMEM));
+        }
 
         i = 0;
         cfs_list_for_each_entry(oap, rpc_list, oap_rpc_item) {
@@ -2290,15 +2643,15 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
                         ops = oap->oap_caller_ops;
                         caller_data = oap->oap_caller_data;
 
-                        clerq = cl_req_alloc(env, page, crt,
-                                             1 /* only 1-object rpcs for
-                                                * now */);
+                        clerq = cl_req_alloc(env, page, crt, objcount);
                         if (IS_ERR(clerq))
                                 GOTO(out, req = (void *)clerq);
                         lock = oap->oap_ldlm_lock;
                 }
                 pga[i] = &oap->oap_brw_page;
                 pga[i]->off = oap->oap_obj_off + oap->oap_page_off;
+                if (i > 0 && pga[i]->off < pga[i - 1]->off)
+                        sorted = 0;
                 CDEBUG(0, "put page %p index %lu oap %p flg %x to pga\n",
                        pga[i]->pg, cfs_page_index(oap->oap_page), oap, pga[i]->flag);
                 i++;
@@ -2307,9 +2660,9 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
 
         /* always get the data for the obdo for the rpc */
         LASSERT(ops != NULL);
-        crattr.cra_oa = oa;
-        crattr.cra_capa = NULL;
-        cl_req_attr_set(env, clerq, &crattr, ~0ULL);
+        cl_req_attr_set(env, clerq, crattr, ~0ULL);
+        /* the lock of the first page covers the first object of the list */
+        oa = crattr[0].cra_oa;
         if (lock) {
                 oa->o_handle = lock->l_remote_handle;
                 oa->o_valid |= OBD_MD_FLHANDLE;
@@ -2321,9 +2674,16 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
                 GOTO(out, req = ERR_PTR(rc));
         }
 
-        sort_brw_pages(pga, page_count);
+        if (objcount > 1) {
+                osc_brw_objs_prep(rpc_list, crattr, objs, objcount, pga);
+                oa = objs[0].bo_oa;
+        } else if (!sorted) {
+                /* RPCs built from an extent are in offset order already */
+                sort_brw_pages(pga, page_count);
+        }
         rc = osc_brw_prep_request(cmd, cli, oa, NULL, page_count,
-                                  pga, &req, crattr.cra_capa, 1);
+                                  pga, &req, crattr[0].cra_capa, 1,
+                                  objs, objcount);
         if (rc != 0) {
                 CERROR("prep_req failed: %d\n", rc);
                 GOTO(out, req = ERR_PTR(rc));
@@ -2338,7 +2698,7 @@ static struct ptlrpc_request *osc_build_req(const struct lu_env *env,
          * the OST will not use BRW timestamps.  Sadly, there is no obvious
          * way to do this in a single call.  bug 10150 */
         body = req_capsule_client_get(&req->rq_pill, &RMF_OST_BODY);
-        cl_req_attr_set(env, clerq, &crattr,
+        cl_req_attr_set(env, clerq, crattr,
                         OBD_MD_FLMTIME|OBD_MD_FLCTIME|OBD_MD_FLATIME);
 
         CLASSERT(sizeof(*aa) <= sizeof(req->rq_async_args));
@@ -2351,10 +2711,16 @@ out:
         if (cmd & OBD_BRW_MEMALLOC)
                 cfs_memory_pressure_restore(mpflag);
 
-        capa_put(crattr.cra_capa);
+        for (i = 0; crattr != NULL && i < objcount; i++) {
+                capa_put(crattr[i].cra_capa);
+                if (IS_ERR(req) && crattr[i].cra_oa != NULL)
+                        OBDO_FREE(crattr[i].cra_oa);
+        }
+        if (crattr != NULL && crattr != &crattr_one)
+                OBD_FREE(crattr, objcount * sizeof(*crattr));
         if (IS_ERR(req)) {
-                if (oa)
-                        OBDO_FREE(oa);
+                if (objs)
+                        OBD_FREE(objs, objcount * sizeof(*objs));
                 if (pga)
                         OBD_FREE(pga, sizeof(*pga) * page_count);
                 /* this should happen rarely and is pretty bad, it makes the
@@ -2379,31 +2745,40 @@ out:
         RETURN(req);
 }
 
+/* an RPC osc_send_oap_rpc() is filling with pages */
+struct osc_rpc_fill {
+        cfs_list_t        *rf_list;
+        obd_count          rf_page_count;
+        obd_count          rf_max_pages;
+        /* objects with pages in the RPC */
+        int                rf_objcount;
+        unsigned           rf_starting_offset;
+        int                rf_srvlock;
+        int                rf_mem_tight;
+        /* the last page of the RPC ends at the end of its page */
+        int                rf_page_end;
+        /* objects pinned while their pages are collected */
+        struct cl_object  *rf_clob[PTLRPC_MAX_BRW_OBJS];
+        int                rf_nr_clob;
+};
+
 /**
- * prepare pages for ASYNC io and put pages in send queue.
+ * Move the pending pages of \a lop which may go into the RPC described by
+ * \a fill to its list, starting with the most urgent ones.
  *
- * \param cmd OBD_BRW_* macroses
- * \param lop pending pages
- *
- * \return zero if no page added to send queue.
- * \return 1 if pages successfully added to send queue.
- * \return negative on errors.
+ * \return the number of pages added.
  */
-static int
-osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
-                 struct lov_oinfo *loi,
-                 int cmd, struct loi_oap_pages *lop)
+static int osc_rpc_fill_lop(const struct lu_env *env, struct client_obd *cli,
+                            int cmd, struct loi_oap_pages *lop,
+                            struct osc_rpc_fill *fill)
 {
-        struct ptlrpc_request *req;
-        obd_count page_count = 0;
         struct osc_async_page *oap = NULL, *tmp;
-        struct osc_brw_async_args *aa;
         const struct obd_async_page_ops *ops;
-        CFS_LIST_HEAD(rpc_list);
         CFS_LIST_HEAD(tmp_list);
         unsigned int ending_offset;
-        unsigned  starting_offset = 0;
-        int srvlock = 0, mem_tight = 0;
+        obd_count page_count = 0;
+        int by_extent = 0;
+        pgoff_t last_index = 0;
         struct cl_object *clob = NULL;
         ENTRY;
 
@@ -2422,9 +2797,22 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
         cfs_list_splice(&tmp_list, &lop->lop_pending);
         page_count = 0;
 
+        /* a write RPC is cut out of the extent holding the most urgent page,
+         * so it carries the pages around that one in offset order, however
+         * they were queued */
+        oap = NULL;
+        if (!cfs_list_empty(&lop->lop_pending)) {
+                oap = cfs_list_entry(lop->lop_pending.next,
+                                     struct osc_async_page, oap_pending_item);
+                if (oap->oap_extent != NULL) {
+                        oap = osc_extent_rpc_start(cli, oap->oap_extent, oap);
+                        by_extent = 1;
+                }
+        }
+
         /* first we find the pages we're allowed to work with */
-        cfs_list_for_each_entry_safe(oap, tmp, &lop->lop_pending,
-                                     oap_pending_item) {
+        for (; oap != NULL; oap = tmp) {
+                tmp = osc_oap_next(lop, oap, by_extent);
                 ops = oap->oap_caller_ops;
 
                 LASSERTF(oap->oap_magic == OAP_MAGIC, "Bad oap magic: oap %p, "
@@ -2435,20 +2823,29 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
                          * can be safely called under client_obd_list lock. */
                         clob = osc_oap2cl_page(oap)->cp_obj;
                         cl_object_get(clob);
+                        LASSERT(fill->rf_nr_clob < PTLRPC_MAX_BRW_OBJS);
+                        fill->rf_clob[fill->rf_nr_clob++] = clob;
                 }
 
-                if (page_count != 0 &&
-                    srvlock != !!(oap->oap_brw_flags & OBD_BRW_SRVLOCK)) {
+                if (fill->rf_page_count != 0 &&
+                    fill->rf_srvlock !=
+                    !!(oap->oap_brw_flags & OBD_BRW_SRVLOCK)) {
                         CDEBUG(D_PAGE, "SRVLOCK flag mismatch,"
                                " oap %p, page %p, srvlock %u\n",
-                               oap, oap->oap_brw_page.pg, (unsigned)!srvlock);
+                               oap, oap->oap_brw_page.pg,
+                               (unsigned)!fill->rf_srvlock);
                         break;
                 }
 
                 /* If there is a gap at the start of this page, it can't merge
                  * with any previous page, so we'll hand the network a
                  * "fragmented" page array that it can't transfer in 1 RDMA */
-                if (page_count != 0 && oap->oap_page_off != 0)
+                if (fill->rf_page_count != 0 && oap->oap_page_off != 0)
+                        break;
+
+                /* stop at a hole in the extent */
+                if (by_extent && page_count != 0 &&
+                    osc_oap_index(oap) != last_index + 1)
                         break;
 
                 /* in llite being 'ready' equates to the page being locked
@@ -2525,10 +2922,12 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
                 cfs_list_del_init(&oap->oap_pending_item);
                 lop_update_pending(cli, lop, cmd, -1);
                 cfs_list_del_init(&oap->oap_urgent_item);
+                osc_extent_del(oap);
 
-                if (page_count == 0)
-                        starting_offset = (oap->oap_obj_off+oap->oap_page_off) &
-                                          (PTLRPC_MAX_BRW_SIZE - 1);
+                if (fill->rf_page_count == 0)
+                        fill->rf_starting_offset =
+                                (oap->oap_obj_off + oap->oap_page_off) &
+                                (PTLRPC_MAX_BRW_SIZE - 1);
 
                 /* ask the caller for the size of the io as the rpc leaves. */
                 if (!(oap->oap_async_flags & ASYNC_COUNT_STABLE)) {
@@ -2546,12 +2945,17 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
                 }
 
                 /* now put the page back in our accounting */
-                cfs_list_add_tail(&oap->oap_rpc_item, &rpc_list);
+                cfs_list_add_tail(&oap->oap_rpc_item, fill->rf_list);
+                last_index = osc_oap_index(oap);
                 if (oap->oap_brw_flags & OBD_BRW_MEMALLOC)
-                        mem_tight = 1;
-                if (page_count == 0)
-                        srvlock = !!(oap->oap_brw_flags & OBD_BRW_SRVLOCK);
-                if (++page_count >= cli->cl_max_pages_per_rpc)
+                        fill->rf_mem_tight = 1;
+                if (fill->rf_page_count == 0)
+                        fill->rf_srvlock =
+                                !!(oap->oap_brw_flags & OBD_BRW_SRVLOCK);
+                fill->rf_page_end = oap->oap_page_off + oap->oap_count ==
+                                    CFS_PAGE_SIZE;
+                page_count++;
+                if (++fill->rf_page_count >= fill->rf_max_pages)
                         break;
 
                 /* End on a PTLRPC_MAX_BRW_SIZE boundary.  We want full-sized
@@ -2570,14 +2974,141 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
                         break;
         }
 
+        if (page_count != 0)
+                fill->rf_objcount++;
+        RETURN(page_count);
+}
+
+/*
+ * Most pages a write RPC of \a objcount objects may carry, so that its extra
+ * ioobjs and obdos take the room of niobufs in the request buffer of a
+ * single object RPC of PTLRPC_MAX_BRW_PAGES pages.
+ */
+static inline int osc_brw_objs_max_pages(int objcount)
+{
+        int extra = sizeof(struct obd_ioobj) + sizeof(struct obdo);
+
+        return PTLRPC_MAX_BRW_PAGES - (objcount - 1) *
+               ((extra + sizeof(struct niobuf_remote) - 1) /
+                sizeof(struct niobuf_remote));
+}
+
+/* whether pages of other objects may join the write RPC \a fill */
+static int osc_rpc_multiobj(struct client_obd *cli, int cmd,
+                            struct osc_rpc_fill *fill)
+{
+        struct obd_import *imp = cli->cl_import;
+        __u64              flags;
+
+        if (cmd != OBD_BRW_WRITE || fill->rf_srvlock ||
+            imp == NULL || imp->imp_invalid)
+                return 0;
+
+        /* a multi-object write carries a single capability and the ids
+         * of a single user */
+        flags = imp->imp_connect_data.ocd_connect_flags;
+        return (flags & OBD_CONNECT_MULTIOBJ) &&
+               !(flags & (OBD_CONNECT_OSS_CAPA | OBD_CONNECT_RMT_CLIENT));
+}
+
+/**
+ * Top up the write RPC \a fill, which has the pages of \a loi, with the
+ * pending pages of other objects.  Those are taken whole, unless an object
+ * has enough pages for an RPC of its own, so that the many small files
+ * which would each make a small RPC go out together.
+ */
+static void osc_rpc_fill_objs(const struct lu_env *env, struct client_obd *cli,
+                              struct lov_oinfo *loi, struct osc_rpc_fill *fill)
+{
+        struct lov_oinfo      *used[PTLRPC_MAX_BRW_OBJS];
+        struct lov_oinfo      *scan;
+        struct osc_async_page *oap;
+        struct cl_object      *top;
+        int                    nr_used = 1;
+        int                    max_pages;
+        int                    i;
+        ENTRY;
+
+        used[0] = loi;
+        cfs_list_for_each_entry(scan, &cli->cl_loi_write_list, loi_write_item) {
+                struct loi_oap_pages *lop = &scan->loi_write_lop;
+
+                if (nr_used == PTLRPC_MAX_BRW_OBJS || !fill->rf_page_end)
+                        break;
+                max_pages = min_t(int, cli->cl_max_pages_per_rpc,
+                                  osc_brw_objs_max_pages(fill->rf_objcount + 1));
+                if (fill->rf_page_count >= max_pages)
+                        break;
+
+                if (lop->lop_num_pending == 0 ||
+                    (lop->lop_num_pending > max_pages - fill->rf_page_count &&
+                     !lop_makes_rpc(cli, lop, OBD_BRW_WRITE)))
+                        continue;
+
+                /* each object of the RPC needs a slot of its own in the
+                 * cl_req, so skip other stripes of a file already in it */
+                oap = cfs_list_entry(lop->lop_pending.next,
+                                     struct osc_async_page, oap_pending_item);
+                top = cl_object_top(osc_oap2cl_page(oap)->cp_obj);
+                for (i = 0; i < fill->rf_nr_clob; i++) {
+                        if (cl_object_top(fill->rf_clob[i]) == top)
+                                break;
+                }
+                if (i < fill->rf_nr_clob)
+                        continue;
+
+                used[nr_used++] = scan;
+                fill->rf_max_pages = max_pages;
+                osc_rpc_fill_lop(env, cli, OBD_BRW_WRITE, lop, fill);
+        }
+
+        for (i = 1; i < nr_used; i++)
+                loi_list_maint(cli, used[i]);
+        EXIT;
+}
+
+/**
+ * prepare pages for ASYNC io and put pages in send queue.
+ *
+ * The pages of a write can be joined by those of other objects if the OST
+ * supports OBD_CONNECT_MULTIOBJ, see osc_rpc_fill_objs().
+ *
+ * \param cmd OBD_BRW_* macroses
+ * \param lop pending pages
+ *
+ * \return zero if no page added to send queue.
+ * \return 1 if pages successfully added to send queue.
+ * \return negative on errors.
+ */
+static int
+osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
+                 struct lov_oinfo *loi,
+                 int cmd, struct loi_oap_pages *lop)
+{
+        struct ptlrpc_request *req;
+        struct osc_async_page *oap, *tmp;
+        struct osc_brw_async_args *aa;
+        CFS_LIST_HEAD(rpc_list);
+        struct osc_rpc_fill fill = { 0 };
+        obd_count page_count;
+        int i;
+        ENTRY;
+
+        fill.rf_list = &rpc_list;
+        fill.rf_max_pages = cli->cl_max_pages_per_rpc;
+        osc_rpc_fill_lop(env, cli, cmd, lop, &fill);
+        if (osc_rpc_multiobj(cli, cmd, &fill))
+                osc_rpc_fill_objs(env, cli, loi, &fill);
+        page_count = fill.rf_page_count;
+
         osc_wake_cache_waiters(cli);
 
         loi_list_maint(cli, loi);
 
         client_obd_list_unlock(&cli->cl_loi_list_lock);
 
-        if (clob != NULL)
-                cl_object_put(env, clob);
+        for (i = 0; i < fill.rf_nr_clob; i++)
+                cl_object_put(env, fill.rf_clob[i]);
 
         if (page_count == 0) {
                 client_obd_list_lock(&cli->cl_loi_list_lock);
@@ -2585,7 +3116,7 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
         }
 
         req = osc_build_req(env, cli, &rpc_list, page_count,
-                            mem_tight ? (cmd | OBD_BRW_MEMALLOC) : cmd);
+                            fill.rf_mem_tight ? (cmd | OBD_BRW_MEMALLOC) : cmd);
         if (IS_ERR(req)) {
                 LASSERT(cfs_list_empty(&rpc_list));
                 loi_list_maint(cli, loi);
@@ -2598,13 +3129,16 @@ osc_send_oap_rpc(const struct lu_env *env, struct client_obd *cli,
                 lprocfs_oh_tally_log2(&cli->cl_read_page_hist, page_count);
                 lprocfs_oh_tally(&cli->cl_read_rpc_hist, cli->cl_r_in_flight);
                 lprocfs_oh_tally_log2(&cli->cl_read_offset_hist,
-                                      (starting_offset >> CFS_PAGE_SHIFT) + 1);
+                                      (fill.rf_starting_offset >>
+                                       CFS_PAGE_SHIFT) + 1);
         } else {
                 lprocfs_oh_tally_log2(&cli->cl_write_page_hist, page_count);
                 lprocfs_oh_tally(&cli->cl_write_rpc_hist,
                                  cli->cl_w_in_flight);
                 lprocfs_oh_tally_log2(&cli->cl_write_offset_hist,
-                                      (starting_offset >> CFS_PAGE_SHIFT) + 1);
+                                      (fill.rf_starting_offset >>
+                                       CFS_PAGE_SHIFT) + 1);
+                lprocfs_oh_tally(&cli->cl_write_obj_hist, fill.rf_objcount);
         }
         ptlrpc_lprocfs_brw(req, aa->aa_requested_nob);
 
@@ -2925,6 +3459,7 @@ int osc_prep_async_page(struct obd_export *exp, struct lov_stripe_md *lsm,
         CFS_INIT_LIST_HEAD(&oap->oap_pending_item);
         CFS_INIT_LIST_HEAD(&oap->oap_urgent_item);
         CFS_INIT_LIST_HEAD(&oap->oap_rpc_item);
+        CFS_INIT_LIST_HEAD(&oap->oap_extent_item);
         CFS_INIT_LIST_HEAD(&oap->oap_page_list);
 
         cfs_spin_lock_init(&oap->oap_lock);
@@ -2940,6 +3475,42 @@ struct osc_async_page *oap_from_cookie(void *cookie)
         return oap;
 };
 
+/**
+ * Extent mode: a page appended to the last dirty extent of an object joins
+ * the current unit of client_obd::cl_extent_pages pages of the object. The
+ * scan for RPCs to send is done once per unit rather than once per page;
+ * everything else, the quota check, grant, the cl_page and osc_async_page,
+ * stays per page. A unit is cut short when anything may want an RPC sent
+ * right away, including RPCs of other objects, so no RPC is delayed by it
+ * beyond the unit size.
+ *
+ * Returns true if \a oap joined a unit, and RPCs need not be checked.
+ */
+static int osc_extent_stream(struct client_obd *cli, struct lov_oinfo *loi,
+                             struct osc_async_page *oap)
+{
+        struct loi_oap_pages *lop = &loi->loi_write_lop;
+        struct osc_extent    *oe  = oap->oap_extent;
+
+        if (cli->cl_extent_pages == 0 || oe == NULL ||
+            oe->oe_link.next != &lop->lop_extents ||
+            oe->oe_end != osc_oap_index(oap) ||
+            ++loi->loi_extent_queued >= cli->cl_extent_pages ||
+            /* see lop_makes_rpc() */
+            lop->lop_num_pending >= cli->cl_max_pages_per_rpc + 16 ||
+            !cfs_list_empty(&lop->lop_urgent) ||
+            !cfs_list_empty(&cli->cl_cache_waiters) ||
+            /* other objects have RPCs to send, see osc_next_loi() */
+            !cfs_list_empty(&cli->cl_loi_hp_ready_list) ||
+            (!cfs_list_empty(&cli->cl_loi_ready_list) &&
+             (cli->cl_loi_ready_list.next != &loi->loi_ready_item ||
+              loi->loi_ready_item.next != &cli->cl_loi_ready_list))) {
+                loi->loi_extent_queued = 0;
+                return 0;
+        }
+        return 1;
+}
+
 int osc_queue_async_io(const struct lu_env *env,
                        struct obd_export *exp, struct lov_stripe_md *lsm,
                        struct lov_oinfo *loi, void *cookie,
@@ -2948,6 +3519,8 @@ int osc_queue_async_io(const struct lu_env *env,
 {
         struct client_obd *cli = &exp->exp_obd->u.cli;
         struct osc_async_page *oap;
+        __u64 start = 0;
+        int streaming = 0;
         int rc = 0;
         ENTRY;
 
@@ -2963,6 +3536,15 @@ int osc_queue_async_io(const struct lu_env *env,
             !cfs_list_empty(&oap->oap_rpc_item))
                 RETURN(-EBUSY);
 
+        if (loi == NULL)
+                loi = lsm->lsm_oinfo[0];
+
+        /* write pages are timed in both modes, so that extent mode can be
+         * compared with per-page queueing, with a clock fine enough for
+         * the sub-microsecond cost of queueing a page */
+        if (cmd & OBD_BRW_WRITE)
+                start = cfs_time_current_ns();
+
         /* check if the file's owner/group is over quota */
         if ((cmd & OBD_BRW_WRITE) && !(cmd & OBD_BRW_NOQUOTA)) {
                 struct cl_object *obj;
@@ -2984,9 +3566,6 @@ int osc_queue_async_io(const struct lu_env *env,
                         RETURN(rc);
         }
 
-        if (loi == NULL)
-                loi = lsm->lsm_oinfo[0];
-
         client_obd_list_lock(&cli->cl_loi_list_lock);
 
         LASSERT(off + count <= CFS_PAGE_SIZE);
@@ -3011,11 +3590,18 @@ int osc_queue_async_io(const struct lu_env *env,
 
         osc_oap_to_pending(oap);
         loi_list_maint(cli, loi);
+        if (cmd & OBD_BRW_WRITE)
+                streaming = osc_extent_stream(cli, loi, oap);
 
         LOI_DEBUG(loi, "oap %p page %p added for cmd %d\n", oap, oap->oap_page,
                   cmd);
 
-        osc_check_rpcs(env, cli);
+        if (!streaming)
+                osc_check_rpcs(env, cli);
+        if (cmd & OBD_BRW_WRITE) {
+                cli->cl_w_queue_nsec += cfs_time_current_ns() - start;
+                cli->cl_w_queue_pages++;
+        }
         client_obd_list_unlock(&cli->cl_loi_list_lock);
 
         RETURN(0);
@@ -3093,6 +3679,7 @@ int osc_teardown_async_page(struct obd_export *exp,
         if (!cfs_list_empty(&oap->oap_rpc_item))
                 GOTO(out, rc = -EBUSY);
 
+        osc_extent_del(oap);
         osc_exit_cache(cli, oap, 0);
         osc_wake_cache_waiters(cli);
 
@@ -4039,6 +4626,22 @@ static int osc_set_info_async(struct obd_export *exp, obd_count keylen,
                 RETURN(0);
         }
 
+        if (KEY_IS(KEY_EXTENT_KB)) {
+                struct client_obd *cli = &exp->exp_obd->u.cli;
+                int                pages;
+
+                if (vallen != sizeof(int))
+                        RETURN(-EINVAL);
+                /* 0 disables extent mode */
+                pages = *(int *)val >> (CFS_PAGE_SHIFT - 10);
+                if (pages < 0 || pages > PTLRPC_MAX_BRW_PAGES)
+                        RETURN(-ERANGE);
+                client_obd_list_lock(&cli->cl_loi_list_lock);
+                cli->cl_extent_pages = pages;
+                client_obd_list_unlock(&cli->cl_loi_list_lock);
+                RETURN(0);
+        }
+
         if (KEY_IS(KEY_SPTLRPC_CONF)) {
                 sptlrpc_conf_client_adapt(obd);
                 RETURN(0);
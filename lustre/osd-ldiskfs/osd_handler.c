@@ -401,7 +401,13 @@ static int osd_fid_lookup(const struct lu_env *env,
                                 obj->oo_compat_dotdot_created = 1;
                         }
                         result = 0;
-                } else
+                } else {
+                        /* do not trust a cached mapping to an inode that
+                         * is stale, unallocated or bad */
+                        if (PTR_ERR(inode) == -ESTALE ||
+                            PTR_ERR(inode) == -ENOENT ||
+                            PTR_ERR(inode) == -EACCES)
+                                osd_oi_cache_forget(oi, fid);
                         /*
                          * If fid wasn't found in oi, inode-less object is
                          * created, for which lu_object_exists() returns
@@ -410,6 +416,7 @@ static int osd_fid_lookup(const struct lu_env *env,
                          * place holders for objects yet to be created.
                          */
                         result = PTR_ERR(inode);
+                }
         } else if (result == -ENOENT)
                 result = 0;
         LINVRNT(osd_invariant(obj));
@@ -3870,6 +3877,8 @@ static int osd_shutdown(const struct lu_env *env, struct osd_device *o)
                 lu_object_put(env, &o->od_obj_area->do_lu);
                 o->od_obj_area = NULL;
         }
+        if (o->od_mount != NULL)
+                osd_oi_cache_save(&o->od_oi, o->od_mount->lmi_mnt);
         osd_oi_fini(info, &o->od_oi);
 
         RETURN(0);
@@ -4029,6 +4038,7 @@ static int osd_prepare(const struct lu_env *env,
                 RETURN(result);
 
         lmi = osd->od_mount;
+        osd_oi_cache_warm(&osd->od_oi, lmi->lmi_mnt);
         lsi = s2lsi(lmi->lmi_sb);
         ldd = lsi->lsi_ldd;
 
@@ -4106,18 +4116,27 @@ static struct lu_local_obj_desc llod_osd_rem_obj_dir = {
 static int __init osd_mod_init(void)
 {
         struct lprocfs_static_vars lvars;
+        int rc;
 
-        osd_oi_mod_init();
+        rc = osd_oi_mod_init();
+        if (rc != 0)
+                return rc;
         llo_local_obj_register(&llod_osd_rem_obj_dir);
         lprocfs_osd_init_vars(&lvars);
-        return class_register_type(&osd_obd_device_ops, NULL, lvars.module_vars,
-                                   LUSTRE_OSD_NAME, &osd_device_type);
+        rc = class_register_type(&osd_obd_device_ops, NULL, lvars.module_vars,
+                                 LUSTRE_OSD_NAME, &osd_device_type);
+        if (rc != 0) {
+                llo_local_obj_unregister(&llod_osd_rem_obj_dir);
+                osd_oi_mod_exit();
+        }
+        return rc;
 }
 
 static void __exit osd_mod_exit(void)
 {
         llo_local_obj_unregister(&llod_osd_rem_obj_dir);
         class_unregister_type(LUSTRE_OSD_NAME);
+        osd_oi_mod_exit();
 }
 
 MODULE_AUTHOR("Sun Microsystems, Inc. <http://www.lustre.org/>");
@@ -57,6 +57,32 @@ static const char *osd_counter_names[LPROC_OSD_NR] = {
 #endif
 };
 
+static int osd_oi_cache_stats_init(struct osd_device *osd)
+{
+        struct lprocfs_stats *stats;
+        int                   rc;
+
+        stats = lprocfs_alloc_stats(LPROC_OSD_OI_CACHE_NR, 0);
+        if (stats == NULL)
+                return -ENOMEM;
+
+        lprocfs_counter_init(stats, LPROC_OSD_OI_CACHE_HIT, 0,
+                             "hit", "reqs");
+        lprocfs_counter_init(stats, LPROC_OSD_OI_CACHE_NEG_HIT, 0,
+                             "negative_hit", "reqs");
+        lprocfs_counter_init(stats, LPROC_OSD_OI_CACHE_MISS, 0,
+                             "miss", "reqs");
+        lprocfs_counter_init(stats, LPROC_OSD_OI_CACHE_EVICT, 0,
+                             "evict", "entries");
+        rc = lprocfs_register_stats(osd->od_proc_entry, "oi_cache_stats",
+                                    stats);
+        if (rc == 0)
+                osd->od_oi.oi_cache.oc_stats = stats;
+        else
+                lprocfs_free_stats(&stats);
+        return rc;
+}
+
 int osd_procfs_init(struct osd_device *osd, const char *name)
 {
         struct lprocfs_static_vars lvars;
@@ -85,6 +111,10 @@ int osd_procfs_init(struct osd_device *osd, const char *name)
         rc = lu_time_init(&osd->od_stats,
                           osd->od_proc_entry,
                           osd_counter_names, ARRAY_SIZE(osd_counter_names));
+        if (rc)
+                GOTO(out, rc);
+
+        rc = osd_oi_cache_stats_init(osd);
         EXIT;
 out:
         if (rc)
@@ -97,6 +127,9 @@ int osd_procfs_fini(struct osd_device *osd)
         if (osd->od_stats)
                 lu_time_fini(&osd->od_stats);
 
+        if (osd->od_oi.oi_cache.oc_stats)
+                lprocfs_free_stats(&osd->od_oi.oi_cache.oc_stats);
+
         if (osd->od_proc_entry) {
                  lprocfs_remove(&osd->od_proc_entry);
                  osd->od_proc_entry = NULL;
@@ -230,6 +263,50 @@ static int lprocfs_osd_rd_mntdev(char *page, char **start, off_t off, int count,
                         osd->od_mount->lmi_mnt->mnt_devname);
 }
 
+static int lprocfs_osd_rd_oi_cache_max(char *page, char **start, off_t off,
+                                       int count, int *eof, void *data)
+{
+        struct osd_device *osd = data;
+
+        LASSERT(osd != NULL);
+        *eof = 1;
+        return snprintf(page, count, "%d\n", osd->od_oi.oi_cache.oc_max);
+}
+
+static int lprocfs_osd_wr_oi_cache_max(struct file *file, const char *buffer,
+                                       unsigned long count, void *data)
+{
+        struct osd_device *osd = data;
+        int val;
+        int rc;
+
+        LASSERT(osd != NULL);
+        rc = lprocfs_write_helper(buffer, count, &val);
+        if (rc)
+                return rc;
+        if (val < 0)
+                return -ERANGE;
+        if (osd->od_oi.oi_cache.oc_shards == NULL)
+                return -ENODEV;
+
+        osd_oi_cache_max_set(&osd->od_oi, val);
+        return count;
+}
+
+static int lprocfs_osd_rd_oi_cache_entries(char *page, char **start,
+                                           off_t off, int count, int *eof,
+                                           void *data)
+{
+        struct osd_device *osd = data;
+
+        LASSERT(osd != NULL);
+        *eof = 1;
+        if (osd->od_oi.oi_cache.oc_shards == NULL)
+                return snprintf(page, count, "0\n");
+        return snprintf(page, count, "%d\n",
+                        osd_oi_cache_entries(&osd->od_oi));
+}
+
 struct lprocfs_vars lprocfs_osd_obd_vars[] = {
         { "blocksize",       lprocfs_osd_rd_blksize,     0, 0 },
         { "kbytestotal",     lprocfs_osd_rd_kbytestotal, 0, 0 },
@@ -239,6 +316,9 @@ struct lprocfs_vars lprocfs_osd_obd_vars[] = {
         { "filesfree",       lprocfs_osd_rd_filesfree,   0, 0 },
         { "fstype",          lprocfs_osd_rd_fstype,      0, 0 },
         { "mntdev",          lprocfs_osd_rd_mntdev,      0, 0 },
+        { "oi_cache_max",    lprocfs_osd_rd_oi_cache_max,
+                             lprocfs_osd_wr_oi_cache_max, 0 },
+        { "oi_cache_entries", lprocfs_osd_rd_oi_cache_entries, 0, 0 },
         { 0 }
 };
 
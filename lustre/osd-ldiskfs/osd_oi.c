@@ -67,6 +67,8 @@
 
 /* fid_cpu_to_be() */
 #include <lustre_fid.h>
+/* push_ctxt(), lustre_fwrite() */
+#include <lvfs.h>
 
 #include "osd_oi.h"
 /* osd_lookup(), struct osd_thread_info */
@@ -83,6 +85,55 @@ struct oi_descr {
 /** to serialize concurrent OI index initialization */
 static cfs_mutex_t oi_init_lock;
 
+static int oi_cache_nr = 65536;
+CFS_MODULE_PARM(oi_cache_nr, "i", int, 0444,
+                "maximal number of entries in the OI cache of a device");
+
+static int oi_cache_warm = 4096;
+CFS_MODULE_PARM(oi_cache_warm, "i", int, 0644,
+                "number of OI cache entries preloaded at mount, 0 to disable");
+
+/*
+ * Entry of the in-memory OI cache.
+ */
+struct osd_oi_cache_entry {
+        cfs_hlist_node_t    oce_hash;
+        cfs_list_t          oce_lru;
+        struct lu_fid       oce_fid;
+        /* oii_ino is 0 for a negative entry */
+        struct osd_inode_id oce_id;
+};
+
+static cfs_mem_cache_t *osd_oi_cache_kmem;
+
+static struct lu_kmem_descr osd_oi_caches[] = {
+        {
+                .ckd_cache = &osd_oi_cache_kmem,
+                .ckd_name  = "osd_oi_cache_kmem",
+                .ckd_size  = sizeof(struct osd_oi_cache_entry)
+        },
+        {
+                .ckd_cache = NULL
+        }
+};
+
+/*
+ * Format of the file where fids of the most recently used entries are kept
+ * between mounts: a header followed by owh_count little-endian fids.
+ */
+struct osd_oi_warm_header {
+        __u32 owh_magic;
+        __u32 owh_count;
+};
+
+enum {
+        OSD_OI_WARM_MAGIC = 0x0ad1ca4e,
+        /* number of fids looked up by a single run of the warm-up workitem */
+        OSD_OI_WARM_BATCH = 64
+};
+
+static const char osd_oi_warm_file[] = "oi.warm";
+
 static struct dt_index_features oi_feat = {
         .dif_flags       = DT_IND_UPDATE,
         .dif_recsize_min = sizeof(struct osd_inode_id),
@@ -98,6 +149,473 @@ static const struct oi_descr oi_descr[OSD_OI_FID_NR] = {
         }
 };
 
+static struct osd_oi_cache_shard *
+osd_oi_cache_shard(struct osd_oi_cache *oc, const struct lu_fid *fid)
+{
+        /* objects of a sequence are allocated in runs, keep a run together */
+        return &oc->oc_shards[cfs_hash_u64_hash(fid_seq(fid) +
+                                                (fid_oid(fid) >> 10),
+                                                OSD_OI_CACHE_SHARDS - 1)];
+}
+
+static cfs_hlist_head_t *
+osd_oi_cache_bucket(struct osd_oi_cache_shard *ocs, const struct lu_fid *fid)
+{
+        return &ocs->ocs_hash[cfs_hash_u32_hash(fid_oid(fid) ^
+                                                (__u32)fid_seq(fid),
+                                                (1 << OSD_OI_CACHE_HASH_BITS)
+                                                - 1)];
+}
+
+static inline int osd_oi_cache_shard_max(const struct osd_oi_cache *oc)
+{
+        return (oc->oc_max + OSD_OI_CACHE_SHARDS - 1) / OSD_OI_CACHE_SHARDS;
+}
+
+static struct osd_oi_cache_entry *
+osd_oi_cache_find(struct osd_oi_cache_shard *ocs, const struct lu_fid *fid)
+{
+        struct osd_oi_cache_entry *oce;
+        cfs_hlist_node_t          *pos;
+
+        cfs_hlist_for_each_entry(oce, pos, osd_oi_cache_bucket(ocs, fid),
+                                 oce_hash) {
+                if (lu_fid_eq(&oce->oce_fid, fid))
+                        return oce;
+        }
+        return NULL;
+}
+
+static void osd_oi_cache_del(struct osd_oi_cache_shard *ocs,
+                             struct osd_oi_cache_entry *oce)
+{
+        cfs_hlist_del(&oce->oce_hash);
+        cfs_list_del(&oce->oce_lru);
+        ocs->ocs_nr--;
+        OBD_SLAB_FREE_PTR(oce, osd_oi_cache_kmem);
+}
+
+/*
+ * Drops least recently used entries of \a ocs until at most \a max are left.
+ * Returns the number of dropped entries.
+ */
+static int osd_oi_cache_shrink(struct osd_oi_cache_shard *ocs, int max)
+{
+        int nr = 0;
+
+        while (ocs->ocs_nr > max) {
+                osd_oi_cache_del(ocs, cfs_list_entry(ocs->ocs_lru.prev,
+                                                     struct osd_oi_cache_entry,
+                                                     oce_lru));
+                nr++;
+        }
+        return nr;
+}
+
+/*
+ * Looks \a fid up in the cache. Returns 0 and fills \a id on a hit, -ENOENT
+ * if the fid is known not to be in the index, and 1 on a miss, in which case
+ * the shard generation to be passed to osd_oi_cache_set() is stored in \a gen.
+ */
+static int osd_oi_cache_lookup(struct osd_oi_cache *oc,
+                               const struct lu_fid *fid,
+                               struct osd_inode_id *id, __u64 *gen)
+{
+        struct osd_oi_cache_shard *ocs;
+        struct osd_oi_cache_entry *oce;
+        int                        rc;
+
+        ocs = osd_oi_cache_shard(oc, fid);
+        cfs_spin_lock(&ocs->ocs_lock);
+        oce = osd_oi_cache_find(ocs, fid);
+        if (oce != NULL) {
+                cfs_list_move(&oce->oce_lru, &ocs->ocs_lru);
+                *id = oce->oce_id;
+                rc = id->oii_ino != 0 ? 0 : -ENOENT;
+        } else {
+                *gen = ocs->ocs_gen;
+                rc = 1;
+        }
+        cfs_spin_unlock(&ocs->ocs_lock);
+
+        lprocfs_counter_incr(oc->oc_stats, rc == 0 ? LPROC_OSD_OI_CACHE_HIT :
+                             rc < 0 ? LPROC_OSD_OI_CACHE_NEG_HIT :
+                             LPROC_OSD_OI_CACHE_MISS);
+        return rc;
+}
+
+/*
+ * Drops whatever \a oc caches for \a fid, and invalidates lookups of it in
+ * flight.
+ */
+static void osd_oi_cache_drop(struct osd_oi_cache *oc, const struct lu_fid *fid)
+{
+        struct osd_oi_cache_shard *ocs;
+        struct osd_oi_cache_entry *oce;
+
+        ocs = osd_oi_cache_shard(oc, fid);
+        cfs_spin_lock(&ocs->ocs_lock);
+        ocs->ocs_gen++;
+        oce = osd_oi_cache_find(ocs, fid);
+        if (oce != NULL)
+                osd_oi_cache_del(ocs, oce);
+        cfs_spin_unlock(&ocs->ocs_lock);
+}
+
+/*
+ * Caches the mapping of \a fid to \a id, or a negative entry if \a id is
+ * NULL.
+ *
+ * The result of an index lookup is passed together with the generation
+ * osd_oi_cache_lookup() returned, and is dropped if the index was updated
+ * meanwhile. An index update is passed with \a gen == NULL; it replaces
+ * whatever is cached and invalidates lookups in flight.
+ */
+static void osd_oi_cache_set(struct osd_oi_cache *oc, const struct lu_fid *fid,
+                             const struct osd_inode_id *id, const __u64 *gen)
+{
+        struct osd_oi_cache_shard *ocs;
+        struct osd_oi_cache_entry *oce;
+        struct osd_oi_cache_entry *old;
+        int                        nr = 0;
+
+        if (oc->oc_max == 0)
+                GOTO(out_drop, 0);
+
+        OBD_SLAB_ALLOC_PTR_GFP(oce, osd_oi_cache_kmem, CFS_ALLOC_IO);
+        if (oce == NULL)
+                GOTO(out_drop, 0);
+        oce->oce_fid = *fid;
+        if (id != NULL)
+                oce->oce_id = *id;
+
+        ocs = osd_oi_cache_shard(oc, fid);
+        cfs_spin_lock(&ocs->ocs_lock);
+        if (gen == NULL)
+                ocs->ocs_gen++;
+        else if (*gen != ocs->ocs_gen)
+                GOTO(out, nr);
+
+        old = osd_oi_cache_find(ocs, fid);
+        if (old != NULL)
+                osd_oi_cache_del(ocs, old);
+        cfs_hlist_add_head(&oce->oce_hash, osd_oi_cache_bucket(ocs, fid));
+        cfs_list_add(&oce->oce_lru, &ocs->ocs_lru);
+        ocs->ocs_nr++;
+        oce = NULL;
+        nr = osd_oi_cache_shrink(ocs, osd_oi_cache_shard_max(oc));
+out:
+        cfs_spin_unlock(&ocs->ocs_lock);
+
+        if (oce != NULL)
+                OBD_SLAB_FREE_PTR(oce, osd_oi_cache_kmem);
+        if (nr > 0)
+                lprocfs_counter_add(oc->oc_stats, LPROC_OSD_OI_CACHE_EVICT, nr);
+        return;
+
+out_drop:
+        /* an index update that cannot be cached must not leave the old
+         * mapping behind */
+        if (gen == NULL)
+                osd_oi_cache_drop(oc, fid);
+}
+
+/*
+ * Drops whatever is cached for \a fid.
+ */
+void osd_oi_cache_forget(struct osd_oi *oi, const struct lu_fid *fid)
+{
+        osd_oi_cache_drop(&oi->oi_cache, fid);
+}
+
+/*
+ * Changes the maximal number of cached entries, dropping the excess.
+ */
+void osd_oi_cache_max_set(struct osd_oi *oi, int max)
+{
+        struct osd_oi_cache *oc = &oi->oi_cache;
+        struct osd_oi_cache_shard *ocs;
+        int i;
+        int nr;
+
+        oc->oc_max = max;
+        for (i = 0; i < OSD_OI_CACHE_SHARDS; i++) {
+                ocs = &oc->oc_shards[i];
+                cfs_spin_lock(&ocs->ocs_lock);
+                nr = osd_oi_cache_shrink(ocs, osd_oi_cache_shard_max(oc));
+                cfs_spin_unlock(&ocs->ocs_lock);
+                if (nr > 0)
+                        lprocfs_counter_add(oc->oc_stats,
+                                            LPROC_OSD_OI_CACHE_EVICT, nr);
+        }
+}
+
+int osd_oi_cache_entries(struct osd_oi *oi)
+{
+        int nr = 0;
+        int i;
+
+        for (i = 0; i < OSD_OI_CACHE_SHARDS; i++)
+                nr += oi->oi_cache.oc_shards[i].ocs_nr;
+        return nr;
+}
+
+static int osd_oi_lookup0(const struct lu_env *env, struct osd_oi *oi,
+                          struct lu_fid *oi_fid, const struct lu_fid *fid,
+                          struct osd_inode_id *id);
+
+/*
+ * Warm-up workitem: looks up the next batch of fids saved at the last umount,
+ * rescheduling itself until all of them are cached.
+ */
+static int osd_oi_cache_warm_wi(cfs_workitem_t *wi)
+{
+        struct osd_oi       *oi = wi->wi_data;
+        struct osd_oi_cache *oc = &oi->oi_cache;
+        struct osd_inode_id  id;
+        struct lu_fid        oi_fid;
+        struct lu_env        env;
+        int                  end;
+        int                  rc;
+
+        rc = lu_env_init(&env, LCT_DT_THREAD);
+        if (rc == 0) {
+                end = min(oc->oc_warm_pos + OSD_OI_WARM_BATCH,
+                          oc->oc_warm_nr);
+                for (; oc->oc_warm_pos < end; oc->oc_warm_pos++)
+                        osd_oi_lookup0(&env, oi, &oi_fid,
+                                       &oc->oc_warm_fids[oc->oc_warm_pos],
+                                       &id);
+                lu_env_fini(&env);
+
+                if (oc->oc_warm_pos < oc->oc_warm_nr) {
+                        cfs_wi_schedule(wi);
+                        return 0;
+                }
+                CDEBUG(D_INFO, "preloaded %d OI cache entries\n",
+                       oc->oc_warm_nr);
+        } else {
+                CERROR("cannot initialize OI warm-up environment: rc = %d\n",
+                       rc);
+        }
+
+        OBD_VFREE(oc->oc_warm_fids, oc->oc_warm_nr * sizeof(struct lu_fid));
+        oc->oc_warm_fids = NULL;
+        oc->oc_warm_nr = 0;
+        return 0;
+}
+
+static int osd_oi_cache_init(struct osd_oi_cache *oc)
+{
+        struct osd_oi_cache_shard *ocs;
+        int i;
+        int j;
+
+        OBD_ALLOC(oc->oc_shards, OSD_OI_CACHE_SHARDS * sizeof(*ocs));
+        if (oc->oc_shards == NULL)
+                return -ENOMEM;
+
+        for (i = 0; i < OSD_OI_CACHE_SHARDS; i++) {
+                ocs = &oc->oc_shards[i];
+                cfs_spin_lock_init(&ocs->ocs_lock);
+                CFS_INIT_LIST_HEAD(&ocs->ocs_lru);
+                for (j = 0; j < ARRAY_SIZE(ocs->ocs_hash); j++)
+                        CFS_INIT_HLIST_HEAD(&ocs->ocs_hash[j]);
+        }
+        oc->oc_max = max(oi_cache_nr, 0);
+        return 0;
+}
+
+static void osd_oi_cache_fini(struct osd_oi_cache *oc)
+{
+        struct osd_oi_cache_shard *ocs;
+        int i;
+
+        if (oc->oc_shards == NULL)
+                return;
+
+        cfs_wi_cancel_sync(&oc->oc_warm_wi);
+        if (oc->oc_warm_fids != NULL) {
+                OBD_VFREE(oc->oc_warm_fids,
+                          oc->oc_warm_nr * sizeof(struct lu_fid));
+                oc->oc_warm_fids = NULL;
+                oc->oc_warm_nr = 0;
+        }
+
+        for (i = 0; i < OSD_OI_CACHE_SHARDS; i++) {
+                ocs = &oc->oc_shards[i];
+                cfs_spin_lock(&ocs->ocs_lock);
+                osd_oi_cache_shrink(ocs, 0);
+                cfs_spin_unlock(&ocs->ocs_lock);
+        }
+        OBD_FREE(oc->oc_shards, OSD_OI_CACHE_SHARDS * sizeof(*ocs));
+        oc->oc_shards = NULL;
+}
+
+/*
+ * Saves fids of the most recently used positive entries in the root of \a mnt,
+ * to be preloaded by osd_oi_cache_warm() at next mount. Every shard
+ * contributes in proportion to its size.
+ */
+void osd_oi_cache_save(struct osd_oi *oi, struct vfsmount *mnt)
+{
+        struct osd_oi_cache        *oc = &oi->oi_cache;
+        struct osd_oi_cache_shard  *ocs;
+        struct osd_oi_cache_entry  *oce;
+        struct osd_oi_warm_header  *hdr;
+        struct lvfs_run_ctxt        ctxt;
+        struct lvfs_run_ctxt        saved;
+        struct lu_fid              *fids;
+        struct file                *file;
+        loff_t                      off = 0;
+        __u64                       share;
+        int                         warm = oi_cache_warm;
+        int                         total;
+        int                         left;
+        int                         size;
+        int                         nr;
+        int                         i;
+        int                         rc;
+        ENTRY;
+
+        if (warm <= 0 || oc->oc_shards == NULL)
+                RETURN_EXIT;
+
+        total = osd_oi_cache_entries(oi);
+        if (total == 0)
+                RETURN_EXIT;
+        warm = min(warm, total);
+
+        OBD_VMALLOC(hdr, sizeof(*hdr) + warm * sizeof(struct lu_fid));
+        if (hdr == NULL)
+                RETURN_EXIT;
+        fids = (struct lu_fid *)(hdr + 1);
+
+        for (i = nr = 0; i < OSD_OI_CACHE_SHARDS && nr < warm; i++) {
+                ocs = &oc->oc_shards[i];
+                share = (__u64)warm * ocs->ocs_nr + total - 1;
+                do_div(share, total);
+                left = min_t(int, share, warm - nr);
+
+                cfs_spin_lock(&ocs->ocs_lock);
+                cfs_list_for_each_entry(oce, &ocs->ocs_lru, oce_lru) {
+                        if (left == 0)
+                                break;
+                        if (oce->oce_id.oii_ino == 0)
+                                continue;
+                        fid_cpu_to_le(&fids[nr++], &oce->oce_fid);
+                        left--;
+                }
+                cfs_spin_unlock(&ocs->ocs_lock);
+        }
+        hdr->owh_magic = cpu_to_le32(OSD_OI_WARM_MAGIC);
+        hdr->owh_count = cpu_to_le32(nr);
+        size = sizeof(*hdr) + nr * sizeof(struct lu_fid);
+
+        OBD_SET_CTXT_MAGIC(&ctxt);
+        ctxt.pwdmnt = mnt;
+        ctxt.pwd = mnt->mnt_root;
+        ctxt.fs = get_ds();
+
+        push_ctxt(&saved, &ctxt, NULL);
+        file = filp_open(osd_oi_warm_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (!IS_ERR(file)) {
+                rc = lustre_fwrite(file, hdr, size, &off);
+                if (rc == size)
+                        rc = 0;
+                else if (rc >= 0)
+                        rc = -EIO;
+                filp_close(file, 0);
+        } else {
+                rc = PTR_ERR(file);
+        }
+        pop_ctxt(&saved, &ctxt, NULL);
+
+        if (rc != 0)
+                CWARN("cannot save OI cache warm-up list: rc = %d\n", rc);
+        else
+                CDEBUG(D_INFO, "saved %d OI cache entries\n", nr);
+        OBD_VFREE(hdr, sizeof(*hdr) + warm * sizeof(struct lu_fid));
+        EXIT;
+}
+
+/*
+ * Reads fids saved by osd_oi_cache_save() at the last umount and starts
+ * looking them up in background.
+ */
+void osd_oi_cache_warm(struct osd_oi *oi, struct vfsmount *mnt)
+{
+        struct osd_oi_cache        *oc = &oi->oi_cache;
+        struct osd_oi_warm_header   hdr;
+        struct lvfs_run_ctxt        ctxt;
+        struct lvfs_run_ctxt        saved;
+        struct lu_fid              *fids = NULL;
+        struct file                *file;
+        loff_t                      off = 0;
+        int                         size = 0;
+        int                         nr = 0;
+        int                         i;
+        int                         rc;
+        ENTRY;
+
+        if (oi_cache_warm <= 0 || oc->oc_max == 0)
+                RETURN_EXIT;
+
+        LASSERT(oc->oc_warm_fids == NULL);
+
+        OBD_SET_CTXT_MAGIC(&ctxt);
+        ctxt.pwdmnt = mnt;
+        ctxt.pwd = mnt->mnt_root;
+        ctxt.fs = get_ds();
+
+        push_ctxt(&saved, &ctxt, NULL);
+        file = filp_open(osd_oi_warm_file, O_RDONLY, 0644);
+        if (IS_ERR(file)) {
+                rc = PTR_ERR(file);
+                GOTO(out, rc);
+        }
+
+        rc = lustre_fread(file, &hdr, sizeof(hdr), &off);
+        if (rc != sizeof(hdr) ||
+            le32_to_cpu(hdr.owh_magic) != OSD_OI_WARM_MAGIC)
+                GOTO(out_close, rc = -EINVAL);
+
+        nr = min_t(int, le32_to_cpu(hdr.owh_count),
+                   min(oi_cache_warm, oc->oc_max));
+        if (nr == 0)
+                GOTO(out_close, rc = 0);
+
+        size = nr * sizeof(struct lu_fid);
+        OBD_VMALLOC(fids, size);
+        if (fids == NULL)
+                GOTO(out_close, rc = -ENOMEM);
+
+        rc = lustre_fread(file, fids, size, &off);
+        if (rc != size)
+                GOTO(out_close, rc = rc < 0 ? rc : -EINVAL);
+        for (i = 0; i < nr; i++)
+                fid_le_to_cpu(&fids[i], &fids[i]);
+        rc = 0;
+        EXIT;
+out_close:
+        filp_close(file, 0);
+out:
+        pop_ctxt(&saved, &ctxt, NULL);
+
+        if (rc != 0 && rc != -ENOENT)
+                CWARN("cannot read OI cache warm-up list: rc = %d\n", rc);
+
+        if (rc == 0 && nr > 0) {
+                /* the array is freed by osd_oi_cache_warm_wi() at the end */
+                oc->oc_warm_fids = fids;
+                oc->oc_warm_nr = nr;
+                oc->oc_warm_pos = 0;
+                cfs_wi_schedule(&oc->oc_warm_wi);
+        } else if (fids != NULL) {
+                OBD_VFREE(fids, size);
+        }
+}
+
 static int osd_oi_index_create(struct osd_thread_info *info,
                                struct dt_device *dev,
                                struct md_device *mdev)
@@ -140,7 +658,14 @@ int osd_oi_init(struct osd_thread_info *info,
 
         env = info->oti_env;
         cfs_mutex_lock(&oi_init_lock);
-        memset(oi, 0, sizeof *oi);
+        /* oi_cache.oc_stats belongs to osd_procfs_init() */
+        oi->oi_dir = NULL;
+        cfs_wi_init(&oi->oi_cache.oc_warm_wi, oi, osd_oi_cache_warm_wi,
+                    CFS_WI_SCHED_ANY);
+        cfs_wi_set_prio(&oi->oi_cache.oc_warm_wi, CFS_WI_PRIO_LOW);
+        rc = osd_oi_cache_init(&oi->oi_cache);
+        if (rc != 0)
+                GOTO(out, rc);
 retry:
         for (i = rc = 0; i < OSD_OI_FID_NR && rc == 0; ++i) {
                 const char       *name;
@@ -170,6 +695,7 @@ retry:
                         CERROR("Cannot open \"%s\": %d\n", name, rc);
                 }
         }
+out:
         if (rc != 0)
                 osd_oi_fini(info, oi);
 
@@ -179,6 +705,7 @@ retry:
 
 void osd_oi_fini(struct osd_thread_info *info, struct osd_oi *oi)
 {
+        osd_oi_cache_fini(&oi->oi_cache);
         if (oi->oi_dir != NULL) {
                 lu_object_put(info->oti_env, &oi->oi_dir->do_lu);
                 oi->oi_dir = NULL;
@@ -194,34 +721,54 @@ static inline int fid_is_oi_fid(const struct lu_fid *fid)
                 fid_oid(fid) == OSD_OI_FID_16_OID));
 }
 
+/*
+ * Maps \a fid to \a id through the cache, going to the index on a miss.
+ * \a oi_fid is scratch space for the index key.
+ */
+static int osd_oi_lookup0(const struct lu_env *env, struct osd_oi *oi,
+                          struct lu_fid *oi_fid, const struct lu_fid *fid,
+                          struct osd_inode_id *id)
+{
+        struct dt_object    *idx;
+        const struct dt_key *key;
+        __u64                gen;
+        int                  rc;
+
+        rc = osd_oi_cache_lookup(&oi->oi_cache, fid, id, &gen);
+        if (rc <= 0)
+                return rc;
+
+        idx = oi->oi_dir;
+        fid_cpu_to_be(oi_fid, fid);
+        key = (struct dt_key *) oi_fid;
+        rc = idx->do_index_ops->dio_lookup(env, idx, (struct dt_rec *)id, key,
+                                           BYPASS_CAPA);
+        if (rc > 0) {
+                id->oii_ino = be32_to_cpu(id->oii_ino);
+                id->oii_gen = be32_to_cpu(id->oii_gen);
+                osd_oi_cache_set(&oi->oi_cache, fid, id, &gen);
+                rc = 0;
+        } else if (rc == 0) {
+                osd_oi_cache_set(&oi->oi_cache, fid, NULL, &gen);
+                rc = -ENOENT;
+        }
+        return rc;
+}
+
 int osd_oi_lookup(struct osd_thread_info *info, struct osd_oi *oi,
                   const struct lu_fid *fid, struct osd_inode_id *id)
 {
-        struct lu_fid *oi_fid = &info->oti_fid;
         int rc;
 
         if (osd_fid_is_igif(fid)) {
                 lu_igif_to_id(fid, id);
                 rc = 0;
         } else {
-                struct dt_object    *idx;
-                const struct dt_key *key;
-
                 if (fid_is_oi_fid(fid))
                         return -ENOENT;
 
-                idx = oi->oi_dir;
-                fid_cpu_to_be(oi_fid, fid);
-                key = (struct dt_key *) oi_fid;
-                rc = idx->do_index_ops->dio_lookup(info->oti_env, idx,
-                                                   (struct dt_rec *)id, key,
-                                                   BYPASS_CAPA);
-                if (rc > 0) {
-                        id->oii_ino = be32_to_cpu(id->oii_ino);
-                        id->oii_gen = be32_to_cpu(id->oii_gen);
-                        rc = 0;
-                } else if (rc == 0)
-                        rc = -ENOENT;
+                rc = osd_oi_lookup0(info->oti_env, oi, &info->oti_fid,
+                                    fid, id);
         }
         return rc;
 }
@@ -234,6 +781,7 @@ int osd_oi_insert(struct osd_thread_info *info, struct osd_oi *oi,
         struct dt_object    *idx;
         struct osd_inode_id *id;
         const struct dt_key *key;
+        int                  rc;
 
         if (osd_fid_is_igif(fid))
                 return 0;
@@ -248,10 +796,15 @@ int osd_oi_insert(struct osd_thread_info *info, struct osd_oi *oi,
         id  = &info->oti_id;
         id->oii_ino = cpu_to_be32(id0->oii_ino);
         id->oii_gen = cpu_to_be32(id0->oii_gen);
-        return idx->do_index_ops->dio_insert(info->oti_env, idx,
-                                             (struct dt_rec *)id,
-                                             key, th, BYPASS_CAPA,
-                                             ignore_quota);
+        rc = idx->do_index_ops->dio_insert(info->oti_env, idx,
+                                           (struct dt_rec *)id,
+                                           key, th, BYPASS_CAPA,
+                                           ignore_quota);
+        if (rc == 0)
+                osd_oi_cache_set(&oi->oi_cache, fid, id0, NULL);
+        else
+                osd_oi_cache_forget(oi, fid);
+        return rc;
 }
 
 int osd_oi_delete(struct osd_thread_info *info,
@@ -261,6 +814,7 @@ int osd_oi_delete(struct osd_thread_info *info,
         struct lu_fid *oi_fid = &info->oti_fid;
         struct dt_object    *idx;
         const struct dt_key *key;
+        int                  rc;
 
         if (osd_fid_is_igif(fid))
                 return 0;
@@ -268,12 +822,22 @@ int osd_oi_delete(struct osd_thread_info *info,
         idx = oi->oi_dir;
         fid_cpu_to_be(oi_fid, fid);
         key = (struct dt_key *) oi_fid;
-        return idx->do_index_ops->dio_delete(info->oti_env, idx,
-                                             key, th, BYPASS_CAPA);
+        rc = idx->do_index_ops->dio_delete(info->oti_env, idx,
+                                           key, th, BYPASS_CAPA);
+        if (rc == 0)
+                osd_oi_cache_set(&oi->oi_cache, fid, NULL, NULL);
+        else
+                osd_oi_cache_forget(oi, fid);
+        return rc;
 }
 
 int osd_oi_mod_init()
 {
         cfs_mutex_init(&oi_init_lock);
-        return 0;
+        return lu_kmem_init(osd_oi_caches);
+}
+
+void osd_oi_mod_exit()
+{
+        lu_kmem_fini(osd_oi_caches);
 }
@@ -68,16 +68,6 @@ enum {
         OSD_OI_FID_NR
 };
 
-/*
- * Object Index (oi) instance.
- */
-struct osd_oi {
-        /*
-         * underlying index object, where fid->id mapping in stored.
-         */
-        struct dt_object *oi_dir;
-};
-
 /*
  * Storage cookie. Datum uniquely identifying inode on the underlying file
  * system.
@@ -90,12 +80,76 @@ struct osd_inode_id {
         __u32 oii_gen; /* inode generation */
 };
 
+enum {
+        OSD_OI_CACHE_SHARD_BITS = 5,
+        OSD_OI_CACHE_SHARDS     = 1 << OSD_OI_CACHE_SHARD_BITS,
+        OSD_OI_CACHE_HASH_BITS  = 8
+};
+
+/*
+ * A shard of the in-memory cache of the fid->id mapping.
+ */
+struct osd_oi_cache_shard {
+        cfs_spinlock_t          ocs_lock;
+        /*
+         * bumped by every update of the index, so that the result of a
+         * lookup started before the update is not cached after it.
+         */
+        __u64                   ocs_gen;
+        /* entries, most recently used first */
+        cfs_list_t              ocs_lru;
+        int                     ocs_nr;
+        cfs_hlist_head_t        ocs_hash[1 << OSD_OI_CACHE_HASH_BITS];
+};
+
+enum {
+        LPROC_OSD_OI_CACHE_HIT,
+        LPROC_OSD_OI_CACHE_NEG_HIT,
+        LPROC_OSD_OI_CACHE_MISS,
+        LPROC_OSD_OI_CACHE_EVICT,
+        LPROC_OSD_OI_CACHE_NR
+};
+
+/*
+ * In-memory cache of the fid->id mapping, with negative entries for fids
+ * known not to be in the index. Sharded by fid sequence, holds at most
+ * oc_max entries.
+ */
+struct osd_oi_cache {
+        struct osd_oi_cache_shard *oc_shards;
+        /* maximal number of entries, 0 disables the cache */
+        int                        oc_max;
+        struct lprocfs_stats      *oc_stats;
+        /* warm-up: fids saved at the last umount, looked up in background */
+        cfs_workitem_t             oc_warm_wi;
+        struct lu_fid             *oc_warm_fids;
+        int                        oc_warm_nr;
+        int                        oc_warm_pos;
+};
+
+/*
+ * Object Index (oi) instance.
+ */
+struct osd_oi {
+        /*
+         * underlying index object, where fid->id mapping in stored.
+         */
+        struct dt_object    *oi_dir;
+        struct osd_oi_cache  oi_cache;
+};
+
 int osd_oi_mod_init(void);
+void osd_oi_mod_exit(void);
 int osd_oi_init(struct osd_thread_info *info,
                 struct osd_oi *oi,
                 struct dt_device *dev,
                 struct md_device *mdev);
 void osd_oi_fini(struct osd_thread_info *info, struct osd_oi *oi);
+void osd_oi_cache_warm(struct osd_oi *oi, struct vfsmount *mnt);
+void osd_oi_cache_save(struct osd_oi *oi, struct vfsmount *mnt);
+void osd_oi_cache_forget(struct osd_oi *oi, const struct lu_fid *fid);
+void osd_oi_cache_max_set(struct osd_oi *oi, int max);
+int  osd_oi_cache_entries(struct osd_oi *oi);
 
 int  osd_oi_lookup(struct osd_thread_info *info, struct osd_oi *oi,
                    const struct lu_fid *fid, struct osd_inode_id *id);
@@ -41,8 +41,18 @@
 #include "ost_internal.h"
 
 #ifdef LPROCFS
+static int lprocfs_ost_rd_commit_handoffs(char *page, char **start, off_t off,
+                                          int count, int *eof, void *data)
+{
+        struct obd_device *obd = data;
+
+        *eof = 1;
+        return snprintf(page, count, LPU64"\n", ost_commit_handoffs(obd));
+}
+
 static struct lprocfs_vars lprocfs_ost_obd_vars[] = {
         { "uuid",            lprocfs_rd_uuid,   0, 0 },
+        { "commit_handoffs", lprocfs_ost_rd_commit_handoffs, 0, 0 },
         { 0 }
 };
 
@@ -69,6 +69,11 @@ static int oss_num_create_threads;
 CFS_MODULE_PARM(oss_num_create_threads, "i", int, 0444,
                 "number of OSS create threads to start");
 
+static int oss_commit_threads = OST_COMMIT_THREADS_DEF;
+CFS_MODULE_PARM(oss_commit_threads, "i", int, 0444,
+                "number of OSS write commit threads per CPU partition "
+                "(0 commits writes in the I/O threads)");
+
 /**
  * Do not return server-side uid/gid to remote client
  */
@@ -653,7 +658,7 @@ static int ost_rw_prolong_locks(struct ptlrpc_request *req, struct obd_ioobj *ob
                res_id.name[0], res_id.name[1], opd.opd_policy.l_extent.start,
                opd.opd_policy.l_extent.end);
 
-        if (oa->o_valid & OBD_MD_FLHANDLE) {
+        if (oa != NULL && oa->o_valid & OBD_MD_FLHANDLE) {
                 struct ldlm_lock *lock;
 
                 lock = ldlm_handle2lock(&oa->o_handle);
@@ -990,6 +995,469 @@ out:
         RETURN(rc);
 }
 
+/**
+ * Set up the obdos of the \a objcount objects of a write in \a *oap.
+ *
+ * The obdo of the first object is the one of the ost_body, those of the
+ * following objects of an OBD_CONNECT_MULTIOBJ write come in RMF_BRW_OBDOS
+ * and are copied into an array allocated here, together with the first one.
+ * The objects have to be sorted, so that all writes lock them in the same
+ * order.
+ */
+static int ost_brw_write_oa(struct ptlrpc_request *req, struct ost_body *body,
+                            struct obd_ioobj *ioo, int objcount,
+                            struct niobuf_remote *nb, struct obdo **oap)
+{
+        struct obd_export *exp = req->rq_export;
+        struct obdo       *extra;
+        struct obdo       *oa;
+        int                rc;
+        int                i;
+        ENTRY;
+
+        rc = ost_validate_obdo(exp, &body->oa, ioo);
+        if (rc != 0)
+                RETURN(rc);
+        if (objcount == 1) {
+                *oap = &body->oa;
+                RETURN(0);
+        }
+
+        if (!(exp->exp_connect_flags & OBD_CONNECT_MULTIOBJ) ||
+            objcount > PTLRPC_MAX_BRW_OBJS || exp_connect_rmtclient(exp) ||
+            nb[0].flags & OBD_BRW_SRVLOCK ||
+            req_capsule_get_size(&req->rq_pill, &RMF_BRW_OBDOS, RCL_CLIENT) !=
+            (objcount - 1) * sizeof(*extra)) {
+                CERROR("%s: client %s sent a bad write of %d objects\n",
+                       exp->exp_obd->obd_name, obd_export_nid2str(exp),
+                       objcount);
+                RETURN(-EPROTO);
+        }
+
+        extra = req_capsule_client_get(&req->rq_pill, &RMF_BRW_OBDOS);
+        if (extra == NULL)
+                RETURN(-EFAULT);
+
+        OBD_ALLOC(oa, objcount * sizeof(*oa));
+        if (oa == NULL)
+                RETURN(-ENOMEM);
+        oa[0] = body->oa;
+        memcpy(&oa[1], extra, (objcount - 1) * sizeof(*oa));
+
+        for (i = 1; i < objcount; i++) {
+                rc = ost_validate_obdo(exp, &oa[i], &ioo[i]);
+                if (rc != 0)
+                        break;
+                if (ioo[i].ioo_seq < ioo[i - 1].ioo_seq ||
+                    (ioo[i].ioo_seq == ioo[i - 1].ioo_seq &&
+                     ioo[i].ioo_id <= ioo[i - 1].ioo_id)) {
+                        CERROR("%s: client %s sent unsorted objects "POSTID
+                               " "POSTID"\n", exp->exp_obd->obd_name,
+                               obd_export_nid2str(exp), ioo[i - 1].ioo_id,
+                               ioo[i - 1].ioo_seq, ioo[i].ioo_id,
+                               ioo[i].ioo_seq);
+                        rc = -EPROTO;
+                        break;
+                }
+        }
+        if (rc != 0) {
+                OBD_FREE(oa, objcount * sizeof(*oa));
+                RETURN(rc);
+        }
+
+        *oap = oa;
+        RETURN(0);
+}
+
+/* Return the obdos of a multi-object write, the first one in the ost_body */
+static void ost_brw_write_reply_oa(struct ptlrpc_request *req,
+                                   struct ost_body *repbody, struct obdo *oa,
+                                   int objcount)
+{
+        struct obdo *rep_oa;
+        int          i;
+
+        repbody->oa = oa[0];
+        rep_oa = req_capsule_server_get(&req->rq_pill, &RMF_BRW_OBDOS);
+        LASSERT(rep_oa != NULL);
+        for (i = 1; i < objcount; i++) {
+                rep_oa[i - 1] = oa[i];
+                /* see the comment about mtime in ost_brw_write() */
+                rep_oa[i - 1].o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLATIME);
+        }
+}
+
+/* Send the reply to an OST_WRITE, or drop it after a bulk comms error */
+static int ost_brw_write_reply(struct ptlrpc_request *req,
+                               struct obd_trans_info *oti, int rc,
+                               int no_reply)
+{
+        struct obd_export *exp = req->rq_export;
+
+        if (rc == 0) {
+                oti_to_request(oti, req);
+                target_committed_to_req(req);
+                rc = ptlrpc_reply(req);
+        } else if (!no_reply) {
+                /* Only reply if there was no comms problem with bulk */
+                target_committed_to_req(req);
+                req->rq_status = rc;
+                ptlrpc_error(req);
+        } else {
+                /* reply out callback would free */
+                ptlrpc_req_drop_rs(req);
+                CWARN("%s: ignoring bulk IO comm error with %s@%s id %s - "
+                      "client will retry\n",
+                      exp->exp_obd->obd_name,
+                      exp->exp_client_uuid.uuid,
+                      exp->exp_connection->c_remote_uuid.uuid,
+                      libcfs_id2str(req->rq_peer));
+        }
+        return rc;
+}
+
+/**
+ * Second half of ost_brw_write(): commit the pages of \a obc, whose bulk
+ * transfer finished with \a rc, release what ost_brw_write() set up but the
+ * tls buffers, and reply.  Runs either in the ll_ost_io thread itself or in
+ * a commit thread, see ost_brw_commit_queue().
+ */
+static int ost_brw_write_commit(struct ost_brw_commit *obc,
+                                struct obd_trans_info *oti, int rc)
+{
+        struct ptlrpc_request   *req = obc->obc_req;
+        struct obd_export       *exp = req->rq_export;
+        struct ptlrpc_bulk_desc *desc = obc->obc_desc;
+        struct ost_body         *body = obc->obc_body;
+        struct ost_body         *repbody = obc->obc_repbody;
+        struct obdo             *oa = obc->obc_oa;
+        struct niobuf_remote    *remote_nb = obc->obc_remote_nb;
+        struct niobuf_local     *local_nb = obc->obc_tls->local;
+        int                      objcount = obc->obc_objcount;
+        int                      npages = obc->obc_npages;
+        int                      no_reply = obc->obc_no_reply;
+        int                      i, j;
+        ENTRY;
+
+        /* Must commit after prep above in all cases */
+        if (objcount > 1) {
+                oa[0] = repbody->oa;
+                rc = obd_commitrw(OBD_BRW_WRITE, exp, oa, objcount,
+                                  obc->obc_ioo, remote_nb, npages, local_nb,
+                                  oti, rc);
+                ost_brw_write_reply_oa(req, repbody, oa, objcount);
+        } else {
+                rc = obd_commitrw(OBD_BRW_WRITE, exp, &repbody->oa, objcount,
+                                  obc->obc_ioo, remote_nb, npages, local_nb,
+                                  oti, rc);
+        }
+        if (rc == -ENOTCONN)
+                /* quota acquire process has been given up because
+                 * either the client has been evicted or the client
+                 * has timed out the request already */
+                no_reply = 1;
+
+        if (exp_connect_rmtclient(exp)) {
+                repbody->oa.o_uid = obc->obc_uid;
+                repbody->oa.o_gid = obc->obc_gid;
+        }
+
+        /*
+         * Disable sending mtime back to the client. If the client locked the
+         * whole object, then it has already updated the mtime on its side,
+         * otherwise it will have to glimpse anyway (see bug 21489, comment 32)
+         */
+        repbody->oa.o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLATIME);
+
+        if (unlikely(obc->obc_client_cksum != obc->obc_server_cksum &&
+                     rc == 0 && !obc->obc_mmap)) {
+                int  new_cksum = ost_checksum_bulk(desc, OST_WRITE,
+                                                   obc->obc_cksum_type);
+                char *msg;
+                char *via;
+                char *router;
+
+                if (new_cksum == obc->obc_server_cksum)
+                        msg = "changed in transit before arrival at OST";
+                else if (new_cksum == obc->obc_client_cksum)
+                        msg = "initial checksum before message complete";
+                else
+                        msg = "changed in transit AND after initial checksum";
+
+                if (req->rq_peer.nid == desc->bd_sender) {
+                        via = router = "";
+                } else {
+                        via = " via ";
+                        router = libcfs_nid2str(desc->bd_sender);
+                }
+
+                LCONSOLE_ERROR_MSG(0x168, "%s: BAD WRITE CHECKSUM: %s from "
+                                   "%s%s%s inode "DFID" object "
+                                   LPU64"/"LPU64" extent ["LPU64"-"LPU64"]\n",
+                                   exp->exp_obd->obd_name, msg,
+                                   libcfs_id2str(req->rq_peer),
+                                   via, router,
+                                   body->oa.o_valid & OBD_MD_FLFID ?
+                                                body->oa.o_parent_seq : (__u64)0,
+                                   body->oa.o_valid & OBD_MD_FLFID ?
+                                                body->oa.o_parent_oid : 0,
+                                   body->oa.o_valid & OBD_MD_FLFID ?
+                                                body->oa.o_parent_ver : 0,
+                                   body->oa.o_id,
+                                   body->oa.o_valid & OBD_MD_FLGROUP ?
+                                                body->oa.o_seq : (__u64)0,
+                                   local_nb[0].offset,
+                                   local_nb[npages-1].offset +
+                                   local_nb[npages-1].len - 1 );
+                CERROR("client csum %x, original server csum %x, "
+                       "server csum now %x\n",
+                       obc->obc_client_cksum, obc->obc_server_cksum,
+                       new_cksum);
+        }
+
+        if (rc == 0) {
+                int nob = 0;
+
+                /* set per-requested niobuf return codes */
+                for (i = j = 0; i < obc->obc_niocount; i++) {
+                        int len = remote_nb[i].len;
+
+                        nob += len;
+                        obc->obc_rcs[i] = 0;
+                        do {
+                                LASSERT(j < npages);
+                                if (local_nb[j].rc < 0)
+                                        obc->obc_rcs[i] = local_nb[j].rc;
+                                len -= local_nb[j].len;
+                                j++;
+                        } while (len > 0);
+                        LASSERT(len == 0);
+                }
+                LASSERT(j == npages);
+                ptlrpc_lprocfs_brw(req, nob);
+        }
+
+        ost_brw_lock_put(LCK_PW, obc->obc_ioo, remote_nb, &obc->obc_lockh);
+        if (desc)
+                ptlrpc_free_bulk(desc);
+        if (objcount > 1)
+                OBD_FREE(oa, objcount * sizeof(*oa));
+        RETURN(ost_brw_write_reply(req, oti, rc, no_reply));
+}
+
+/*
+ * The OSS is a single obd_device, so are its commit threads.  The parts are
+ * set up before the ll_ost_io threads start and freed after they stopped.
+ */
+static struct ost_commit_part *ost_commit_parts;
+static int                     ost_commit_nparts;
+
+/* take a spare tls buffer of \a ocp, allocate a new one if there is none */
+static struct ost_thread_local_cache *
+ost_commit_tls_get(struct ost_commit_part *ocp)
+{
+        struct ost_thread_local_cache *tls = NULL;
+
+        cfs_spin_lock(&ocp->ocp_lock);
+        if (!cfs_list_empty(&ocp->ocp_free_tls)) {
+                tls = cfs_list_entry(ocp->ocp_free_tls.next,
+                                     struct ost_thread_local_cache, list);
+                cfs_list_del_init(&tls->list);
+        }
+        cfs_spin_unlock(&ocp->ocp_lock);
+
+        if (tls == NULL)
+                OBD_ALLOC_PTR(tls);
+        return tls;
+}
+
+static void ost_commit_tls_put(struct ost_commit_part *ocp,
+                               struct ost_thread_local_cache *tls)
+{
+        cfs_spin_lock(&ocp->ocp_lock);
+        cfs_list_add(&tls->list, &ocp->ocp_free_tls);
+        cfs_spin_unlock(&ocp->ocp_lock);
+}
+
+/**
+ * Hand the commit of the write \a src, whose bulk transfer has completed,
+ * over to a commit thread of the current CPU partition.  The ll_ost_io
+ * thread gives its tls buffers, which hold the pages being committed, away
+ * with it and takes spare ones to prepare the next request with.
+ *
+ * Returns 1 if the commit was queued, the caller must not touch the request
+ * anymore then, or 0 if the caller has to commit the write itself: during
+ * recovery, under memory pressure, or when the commit threads are already
+ * behind.  The latter throttles the bulk transfers started on this
+ * partition to what its disks can take.
+ *
+ * The request is complete for ptlrpc once the ll_ost_io thread returns, so
+ * no early replies are sent for it while it waits for and goes through its
+ * commit.  The queue limit keeps that wait to a few commits, which has to
+ * fit within the timeout the client got from its last (early) reply.
+ */
+static int ost_brw_commit_queue(struct ost_brw_commit *src,
+                                struct obd_trans_info *oti)
+{
+        struct ptlrpc_request         *req = src->obc_req;
+        struct ost_commit_part        *ocp;
+        struct ost_brw_commit         *obc;
+        struct ost_thread_local_cache *tls;
+        ENTRY;
+
+        if (ost_commit_parts == NULL || src->obc_tls->temporary ||
+            req->rq_export->exp_obd->obd_recovering ||
+            cfs_memory_pressure_get())
+                RETURN(0);
+
+        ocp = &ost_commit_parts[cfs_cpt_current() % ost_commit_nparts];
+        if (ocp->ocp_nqueued >= ocp->ocp_nthreads * OST_COMMIT_QUEUE_FACTOR)
+                RETURN(0);
+
+        OBD_ALLOC_PTR(obc);
+        if (obc == NULL)
+                RETURN(0);
+
+        tls = ost_commit_tls_get(ocp);
+        if (tls == NULL) {
+                OBD_FREE_PTR(obc);
+                RETURN(0);
+        }
+
+        *obc = *src;
+        obc->obc_oti = *oti;
+        CFS_INIT_LIST_HEAD(&obc->obc_list);
+
+        cfs_spin_lock(&ocp->ocp_lock);
+        if (ocp->ocp_stopping ||
+            ocp->ocp_nqueued >= ocp->ocp_nthreads * OST_COMMIT_QUEUE_FACTOR) {
+                cfs_spin_unlock(&ocp->ocp_lock);
+                ost_commit_tls_put(ocp, tls);
+                OBD_FREE_PTR(obc);
+                RETURN(0);
+        }
+        /* the request and its export stay busy until the reply is sent */
+        ptlrpc_request_addref(req);
+        class_export_rpc_get(req->rq_export);
+        cfs_list_add_tail(&obc->obc_list, &ocp->ocp_queue);
+        ocp->ocp_nqueued++;
+        ocp->ocp_nhandoffs++;
+        cfs_spin_unlock(&ocp->ocp_lock);
+
+        req->rq_svc_thread->t_data = tls;
+        cfs_waitq_signal(&ocp->ocp_waitq);
+
+        CDEBUG(D_RPCTRACE, "x"LPU64": commit queued on CPT %d\n",
+               req->rq_xid, ocp->ocp_cpt);
+        RETURN(1);
+}
+
+/**
+ * The number of writes handed over to the commit threads of \a obd since
+ * setup.  ost_health_sem keeps the commit parts from going away meanwhile.
+ */
+__u64 ost_commit_handoffs(struct obd_device *obd)
+{
+        __u64 count = 0;
+        int   i;
+
+        cfs_down(&obd->u.ost.ost_health_sem);
+        for (i = 0; i < ost_commit_nparts; i++) {
+                cfs_spin_lock(&ost_commit_parts[i].ocp_lock);
+                count += ost_commit_parts[i].ocp_nhandoffs;
+                cfs_spin_unlock(&ost_commit_parts[i].ocp_lock);
+        }
+        cfs_up(&obd->u.ost.ost_health_sem);
+        return count;
+}
+
+static void ost_brw_commit_run(struct ost_commit_part *ocp,
+                               struct ost_brw_commit *obc,
+                               struct ptlrpc_thread *thread)
+{
+        struct ptlrpc_request *req = obc->obc_req;
+        struct obd_export     *exp = req->rq_export;
+
+        /* the filter takes the iobuf of \a thread, quota its watchdog */
+        obc->obc_oti.oti_thread = thread;
+        ost_brw_write_commit(obc, &obc->obc_oti, 0);
+        LASSERT(current->journal_info == NULL);
+
+        ost_commit_tls_put(ocp, obc->obc_tls);
+        class_export_rpc_put(exp);
+        ptlrpc_server_drop_request(req);
+        OBD_FREE_PTR(obc);
+}
+
+static int ost_commit_main(void *arg)
+{
+        struct ost_commit_thread *oct = arg;
+        struct ost_commit_part   *ocp = oct->oct_part;
+        struct ptlrpc_thread     *thread = &oct->oct_thread;
+        struct ost_brw_commit    *obc;
+        struct l_wait_info        lwi = { 0 };
+#ifdef WITH_GROUP_INFO
+        cfs_group_info_t         *ginfo;
+#endif
+        int                       rc;
+        ENTRY;
+
+        cfs_daemonize_ctxt(oct->oct_name);
+        thread->t_pid = cfs_curproc_pid();
+
+        rc = cfs_cpt_bind(ocp->ocp_cpt);
+        if (rc != 0)
+                CWARN("failed to bind %s on CPT %d: rc = %d\n",
+                      oct->oct_name, ocp->ocp_cpt, rc);
+
+#ifdef WITH_GROUP_INFO
+        ginfo = cfs_groups_alloc(0);
+        if (ginfo != NULL) {
+                cfs_set_current_groups(ginfo);
+                cfs_put_group_info(ginfo);
+        }
+#endif
+        thread->t_watchdog = lc_watchdog_add(CFS_GET_TIMEOUT(thread->t_svc),
+                                             NULL, NULL);
+        cfs_complete(&oct->oct_started);
+
+        cfs_spin_lock(&ocp->ocp_lock);
+        while (1) {
+                if (cfs_list_empty(&ocp->ocp_queue)) {
+                        if (ocp->ocp_stopping)
+                                break;
+                        cfs_spin_unlock(&ocp->ocp_lock);
+
+                        lc_watchdog_disable(thread->t_watchdog);
+                        l_wait_event_exclusive(ocp->ocp_waitq,
+                                         ocp->ocp_stopping ||
+                                         !cfs_list_empty(&ocp->ocp_queue),
+                                         &lwi);
+                        lc_watchdog_touch(thread->t_watchdog,
+                                          CFS_GET_TIMEOUT(thread->t_svc));
+
+                        cfs_spin_lock(&ocp->ocp_lock);
+                        continue;
+                }
+
+                obc = cfs_list_entry(ocp->ocp_queue.next,
+                                     struct ost_brw_commit, obc_list);
+                cfs_list_del_init(&obc->obc_list);
+                ocp->ocp_nqueued--;
+                cfs_spin_unlock(&ocp->ocp_lock);
+
+                ost_brw_commit_run(ocp, obc, thread);
+
+                cfs_spin_lock(&ocp->ocp_lock);
+        }
+        cfs_spin_unlock(&ocp->ocp_lock);
+
+        lc_watchdog_delete(thread->t_watchdog);
+        thread->t_watchdog = NULL;
+        cfs_complete(&oct->oct_done);
+        RETURN(0);
+}
+
 static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
 {
         struct ptlrpc_bulk_desc *desc = NULL;
@@ -998,17 +1466,19 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
         struct niobuf_local     *local_nb;
         struct obd_ioobj        *ioo;
         struct ost_body         *body, *repbody;
+        struct obdo             *oa = NULL;
         struct l_wait_info       lwi;
         struct lustre_handle     lockh = {0};
         struct lustre_capa      *capa = NULL;
         __u32                   *rcs;
-        int objcount, niocount, npages;
+        int objcount = 0, niocount, npages;
         int rc, i, j;
         obd_count                client_cksum = 0, server_cksum = 0;
         cksum_type_t             cksum_type = OBD_CKSUM_CRC32;
         int                      no_reply = 0, mmap = 0;
         __u32                    o_uid = 0, o_gid = 0;
         struct ost_thread_local_cache *tls;
+        struct ost_brw_commit    obc;
         ENTRY;
 
         req->rq_bulk_write = 1;
@@ -1044,10 +1514,6 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
         if (ioo == NULL)
                 GOTO(out, rc = -EFAULT);
 
-        rc = ost_validate_obdo(exp, &body->oa, ioo);
-        if (rc)
-                RETURN(rc);
-
         for (niocount = i = 0; i < objcount; i++)
                 niocount += ioo[i].ioo_bufcnt;
 
@@ -1061,6 +1527,10 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
             &RMF_NIOBUF_REMOTE, RCL_CLIENT) / sizeof(*remote_nb)))
                 GOTO(out, rc = -EFAULT);
 
+        rc = ost_brw_write_oa(req, body, ioo, objcount, remote_nb, &oa);
+        if (rc)
+                RETURN(rc);
+
         if ((remote_nb[0].flags & OBD_BRW_MEMALLOC) &&
             (exp->exp_connection->c_peer.nid == exp->exp_connection->c_self))
                 cfs_memory_pressure_set();
@@ -1075,6 +1545,8 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
 
         req_capsule_set_size(&req->rq_pill, &RMF_RCS, RCL_SERVER,
                              niocount * sizeof(*rcs));
+        req_capsule_set_size(&req->rq_pill, &RMF_BRW_OBDOS, RCL_SERVER,
+                             (objcount - 1) * sizeof(*oa));
         rc = req_capsule_server_pack(&req->rq_pill);
         if (rc != 0)
                 GOTO(out, rc);
@@ -1105,18 +1577,21 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
                 GOTO(out_lock, rc = -ETIMEDOUT);
         }
 
-        if (!lustre_handle_is_used(&lockh))
+        if (!lustre_handle_is_used(&lockh)) {
                 /* no needs to try to prolong lock if server is asked
                  * to handle locking (= OBD_BRW_SRVLOCK) */
-                ost_rw_prolong_locks(req, ioo, remote_nb,&body->oa,  LCK_PW);
+                for (i = j = 0; i < objcount; j += ioo[i++].ioo_bufcnt)
+                        ost_rw_prolong_locks(req, &ioo[i], &remote_nb[j],
+                                             &oa[i], LCK_PW);
+        }
 
         /* obd_preprw clobbers oa->valid, so save what we need */
-        if (body->oa.o_valid & OBD_MD_FLCKSUM) {
-                client_cksum = body->oa.o_cksum;
-                if (body->oa.o_valid & OBD_MD_FLFLAGS)
-                        cksum_type = cksum_type_unpack(body->oa.o_flags);
+        if (oa->o_valid & OBD_MD_FLCKSUM) {
+                client_cksum = oa->o_cksum;
+                if (oa->o_valid & OBD_MD_FLFLAGS)
+                        cksum_type = cksum_type_unpack(oa->o_flags);
         }
-        if (body->oa.o_valid & OBD_MD_FLFLAGS && body->oa.o_flags & OBD_FL_MMAP)
+        if (oa->o_valid & OBD_MD_FLFLAGS && oa->o_flags & OBD_FL_MMAP)
                 mmap = 1;
 
         /* Because we already sync grant info with client when reconnect,
@@ -1124,15 +1599,15 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
          * total_grant will not be modified in following preprw_write */
         if (lustre_msg_get_flags(req->rq_reqmsg) & (MSG_RESENT | MSG_REPLAY)) {
                 DEBUG_REQ(D_CACHE, req, "clear resent/replay req grant info");
-                body->oa.o_valid &= ~OBD_MD_FLGRANT;
+                oa->o_valid &= ~OBD_MD_FLGRANT;
         }
 
         if (exp_connect_rmtclient(exp)) {
-                o_uid = body->oa.o_uid;
-                o_gid = body->oa.o_gid;
+                o_uid = oa->o_uid;
+                o_gid = oa->o_gid;
         }
         npages = OST_THREAD_POOL_SIZE;
-        rc = obd_preprw(OBD_BRW_WRITE, exp, &body->oa, objcount,
+        rc = obd_preprw(OBD_BRW_WRITE, exp, oa, objcount,
                         ioo, remote_nb, &npages, local_nb, oti, capa);
         if (rc != 0)
                 GOTO(out_lock, rc);
@@ -1209,7 +1684,7 @@ static int ost_brw_write(struct ptlrpc_request *req, struct obd_trans_info *oti)
 
 skip_transfer:
         repbody = req_capsule_server_get(&req->rq_pill, &RMF_OST_BODY);
-        memcpy(&repbody->oa, &body->oa, sizeof(repbody->oa));
+        memcpy(&repbody->oa, oa, sizeof(repbody->oa));
 
         if (unlikely(client_cksum != 0 && rc == 0)) {
                 static int cksum_counter;
@@ -1231,91 +1706,36 @@ skip_transfer:
                 }
         }
 
-        /* Must commit after prep above in all cases */
-        rc = obd_commitrw(OBD_BRW_WRITE, exp, &repbody->oa, objcount, ioo,
-                          remote_nb, npages, local_nb, oti, rc);
-        if (rc == -ENOTCONN)
-                /* quota acquire process has been given up because
-                 * either the client has been evicted or the client
-                 * has timed out the request already */
-                no_reply = 1;
-
-        if (exp_connect_rmtclient(exp)) {
-                repbody->oa.o_uid = o_uid;
-                repbody->oa.o_gid = o_gid;
-        }
-
-        /*
-         * Disable sending mtime back to the client. If the client locked the
-         * whole object, then it has already updated the mtime on its side,
-         * otherwise it will have to glimpse anyway (see bug 21489, comment 32)
-         */
-        repbody->oa.o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLATIME);
-
-        if (unlikely(client_cksum != server_cksum && rc == 0 &&  !mmap)) {
-                int  new_cksum = ost_checksum_bulk(desc, OST_WRITE, cksum_type);
-                char *msg;
-                char *via;
-                char *router;
-
-                if (new_cksum == server_cksum)
-                        msg = "changed in transit before arrival at OST";
-                else if (new_cksum == client_cksum)
-                        msg = "initial checksum before message complete";
-                else
-                        msg = "changed in transit AND after initial checksum";
-
-                if (req->rq_peer.nid == desc->bd_sender) {
-                        via = router = "";
-                } else {
-                        via = " via ";
-                        router = libcfs_nid2str(desc->bd_sender);
-                }
-
-                LCONSOLE_ERROR_MSG(0x168, "%s: BAD WRITE CHECKSUM: %s from "
-                                   "%s%s%s inode "DFID" object "
-                                   LPU64"/"LPU64" extent ["LPU64"-"LPU64"]\n",
-                                   exp->exp_obd->obd_name, msg,
-                                   libcfs_id2str(req->rq_peer),
-                                   via, router,
-                                   body->oa.o_valid & OBD_MD_FLFID ?
-                                                body->oa.o_parent_seq : (__u64)0,
-                                   body->oa.o_valid & OBD_MD_FLFID ?
-                                                body->oa.o_parent_oid : 0,
-                                   body->oa.o_valid & OBD_MD_FLFID ?
-                                                body->oa.o_parent_ver : 0,
-                                   body->oa.o_id,
-                                   body->oa.o_valid & OBD_MD_FLGROUP ?
-                                                body->oa.o_seq : (__u64)0,
-                                   local_nb[0].offset,
-                                   local_nb[npages-1].offset +
-                                   local_nb[npages-1].len - 1 );
-                CERROR("client csum %x, original server csum %x, "
-                       "server csum now %x\n",
-                       client_cksum, server_cksum, new_cksum);
-        }
-
-        if (rc == 0) {
-                int nob = 0;
-
-                /* set per-requested niobuf return codes */
-                for (i = j = 0; i < niocount; i++) {
-                        int len = remote_nb[i].len;
+        obc.obc_req          = req;
+        obc.obc_tls          = tls;
+        obc.obc_desc         = desc;
+        obc.obc_body         = body;
+        obc.obc_repbody      = repbody;
+        obc.obc_oa           = oa;
+        obc.obc_ioo          = ioo;
+        obc.obc_remote_nb    = remote_nb;
+        obc.obc_rcs          = rcs;
+        obc.obc_lockh        = lockh;
+        obc.obc_objcount     = objcount;
+        obc.obc_niocount     = niocount;
+        obc.obc_npages       = npages;
+        obc.obc_client_cksum = client_cksum;
+        obc.obc_server_cksum = server_cksum;
+        obc.obc_cksum_type   = cksum_type;
+        obc.obc_uid          = o_uid;
+        obc.obc_gid          = o_gid;
+        obc.obc_mmap         = mmap;
+        obc.obc_no_reply     = no_reply;
+
+        /* a commit thread commits and replies while we go on with the
+         * bulk transfer of the next request */
+        if (rc == 0 && ost_brw_commit_queue(&obc, oti))
+                RETURN(0);
 
-                        nob += len;
-                        rcs[i] = 0;
-                        do {
-                                LASSERT(j < npages);
-                                if (local_nb[j].rc < 0)
-                                        rcs[i] = local_nb[j].rc;
-                                len -= local_nb[j].len;
-                                j++;
-                        } while (len > 0);
-                        LASSERT(len == 0);
-                }
-                LASSERT(j == npages);
-                ptlrpc_lprocfs_brw(req, nob);
-        }
+        rc = ost_brw_write_commit(&obc, oti, rc);
+        ost_tls_put(req);
+        cfs_memory_pressure_clr();
+        RETURN(rc);
 
 out_lock:
         ost_brw_lock_put(LCK_PW, ioo, remote_nb, &lockh);
@@ -1325,25 +1745,9 @@ out_bulk:
         if (desc)
                 ptlrpc_free_bulk(desc);
 out:
-        if (rc == 0) {
-                oti_to_request(oti, req);
-                target_committed_to_req(req);
-                rc = ptlrpc_reply(req);
-        } else if (!no_reply) {
-                /* Only reply if there was no comms problem with bulk */
-                target_committed_to_req(req);
-                req->rq_status = rc;
-                ptlrpc_error(req);
-        } else {
-                /* reply out callback would free */
-                ptlrpc_req_drop_rs(req);
-                CWARN("%s: ignoring bulk IO comm error with %s@%s id %s - "
-                      "client will retry\n",
-                      exp->exp_obd->obd_name,
-                      exp->exp_client_uuid.uuid,
-                      exp->exp_connection->c_remote_uuid.uuid,
-                      libcfs_id2str(req->rq_peer));
-        }
+        if (objcount > 1 && oa != NULL)
+                OBD_FREE(oa, objcount * sizeof(*oa));
+        rc = ost_brw_write_reply(req, oti, rc, no_reply);
         cfs_memory_pressure_clr();
         RETURN(rc);
 }
@@ -1908,15 +2312,20 @@ static int ost_rw_hpreq_lock_match(struct ptlrpc_request *req,
         if (opc == OST_READ)
                 mode |= LCK_PR;
 
-        start = nb[0].offset & CFS_PAGE_MASK;
-        end = (nb[ioo->ioo_bufcnt - 1].offset +
-               nb[ioo->ioo_bufcnt - 1].len - 1) | ~CFS_PAGE_MASK;
-
+        /* find the object of a multi-object write under the lock */
         LASSERT(lock->l_resource != NULL);
-        if (!osc_res_name_eq(ioo->ioo_id, ioo->ioo_seq,
-                             &lock->l_resource->lr_name))
+        for (i = 0; i < objcount; nb += ioo[i++].ioo_bufcnt) {
+                if (osc_res_name_eq(ioo[i].ioo_id, ioo[i].ioo_seq,
+                                    &lock->l_resource->lr_name))
+                        break;
+        }
+        if (i == objcount)
                 RETURN(0);
 
+        start = nb[0].offset & CFS_PAGE_MASK;
+        end = (nb[ioo[i].ioo_bufcnt - 1].offset +
+               nb[ioo[i].ioo_bufcnt - 1].len - 1) | ~CFS_PAGE_MASK;
+
         if (!(lock->l_granted_mode & mode))
                 RETURN(0);
 
@@ -1976,7 +2385,13 @@ static int ost_rw_hpreq_check(struct ptlrpc_request *req)
         mode = LCK_PW;
         if (opc == OST_READ)
                 mode |= LCK_PR;
-        RETURN(ost_rw_prolong_locks(req, ioo, nb, &body->oa, mode));
+
+        /* the lock handle is only known for the first object of a
+         * multi-object write, the others are looked up by extent */
+        for (rc = i = 0; i < objcount; nb += ioo[i++].ioo_bufcnt)
+                rc |= ost_rw_prolong_locks(req, &ioo[i], nb,
+                                           i == 0 ? &body->oa : NULL, mode);
+        RETURN(rc);
 }
 
 static int ost_punch_prolong_locks(struct ptlrpc_request *req, struct obdo *oa)
@@ -2112,7 +2527,11 @@ static int ost_hpreq_handler(struct ptlrpc_request *req)
                                 CERROR("Missing/short ioobj\n");
                                 RETURN(-EFAULT);
                         }
-                        if (objcount > 1) {
+                        if (objcount > 1 &&
+                            (opc != OST_WRITE ||
+                             objcount > PTLRPC_MAX_BRW_OBJS ||
+                             !(req->rq_export->exp_connect_flags &
+                               OBD_CONNECT_MULTIOBJ))) {
                                 CERROR("too many ioobjs (%d)\n", objcount);
                                 RETURN(-EFAULT);
                         }
@@ -2145,6 +2564,12 @@ static int ost_hpreq_handler(struct ptlrpc_request *req)
                                 RETURN(-EFAULT);
                         }
 
+                        /* object and offset for the ORR NRS policy */
+                        req->rq_nrs.nr_objid = ioo->ioo_id;
+                        req->rq_nrs.nr_objgr = ioo->ioo_seq;
+                        req->rq_nrs.nr_offset = nb[0].offset;
+                        req->rq_nrs.nr_has_obj = 1;
+
                         if (niocount == 0 || !(nb[0].flags & OBD_BRW_SRVLOCK))
                                 req->rq_ops = &ost_hpreq_rw;
                 } else if (opc == OST_PUNCH) {
@@ -2489,6 +2914,149 @@ static int ost_thread_init(struct ptlrpc_thread *thread)
         RETURN(0);
 }
 
+/*
+ * stop the commit threads once they have drained their queues, writes which
+ * complete their bulk transfer from now on are committed by the ll_ost_io
+ * threads themselves.
+ */
+static void ost_commit_stop(void)
+{
+        struct ost_commit_part *ocp;
+        int                     i;
+        int                     j;
+        ENTRY;
+
+        for (i = 0; i < ost_commit_nparts; i++) {
+                ocp = &ost_commit_parts[i];
+                cfs_spin_lock(&ocp->ocp_lock);
+                ocp->ocp_stopping = 1;
+                cfs_spin_unlock(&ocp->ocp_lock);
+                cfs_waitq_broadcast(&ocp->ocp_waitq);
+        }
+
+        for (i = 0; i < ost_commit_nparts; i++) {
+                ocp = &ost_commit_parts[i];
+                for (j = 0; j < ocp->ocp_nthreads; j++)
+                        cfs_wait_for_completion(&ocp->ocp_threads[j].oct_done);
+                ocp->ocp_nthreads = 0;
+                LASSERT(cfs_list_empty(&ocp->ocp_queue));
+        }
+        EXIT;
+}
+
+/* free the commit parts, after the ll_ost_io threads are gone */
+static void ost_commit_fini(void)
+{
+        struct ost_thread_local_cache *tls;
+        struct ost_commit_part        *ocp;
+        int                            i;
+        ENTRY;
+
+        if (ost_commit_parts == NULL) {
+                EXIT;
+                return;
+        }
+
+        for (i = 0; i < ost_commit_nparts; i++) {
+                ocp = &ost_commit_parts[i];
+                LASSERT(ocp->ocp_nthreads == 0);
+                while (!cfs_list_empty(&ocp->ocp_free_tls)) {
+                        tls = cfs_list_entry(ocp->ocp_free_tls.next,
+                                             struct ost_thread_local_cache,
+                                             list);
+                        cfs_list_del(&tls->list);
+                        OBD_FREE_PTR(tls);
+                }
+                if (ocp->ocp_threads != NULL)
+                        OBD_FREE(ocp->ocp_threads, oss_commit_threads *
+                                 sizeof(*ocp->ocp_threads));
+        }
+        OBD_FREE(ost_commit_parts,
+                 ost_commit_nparts * sizeof(*ost_commit_parts));
+        ost_commit_parts = NULL;
+        ost_commit_nparts = 0;
+        EXIT;
+}
+
+/*
+ * start oss_commit_threads commit threads on each CPU partition for the
+ * writes of \a svc.
+ */
+static int ost_commit_init(struct ptlrpc_service *svc)
+{
+        struct ost_commit_thread *oct;
+        struct ost_commit_part   *ocp;
+        int                       nparts = cfs_cpt_number();
+        int                       id = 0;
+        int                       rc = 0;
+        int                       i;
+        int                       j;
+        ENTRY;
+
+        if (oss_commit_threads <= 0)
+                RETURN(0);
+
+        if (oss_commit_threads * nparts > OSS_COMMIT_THREADS_MAX) {
+                oss_commit_threads = OSS_COMMIT_THREADS_MAX / nparts;
+                if (oss_commit_threads == 0) {
+                        CWARN("too many CPU partitions (%d) for commit "
+                              "threads, writes are committed by the I/O "
+                              "threads\n", nparts);
+                        RETURN(0);
+                }
+        }
+
+        OBD_ALLOC(ost_commit_parts, nparts * sizeof(*ost_commit_parts));
+        if (ost_commit_parts == NULL)
+                RETURN(-ENOMEM);
+        ost_commit_nparts = nparts;
+
+        for (i = 0; i < nparts; i++) {
+                ocp = &ost_commit_parts[i];
+                cfs_spin_lock_init(&ocp->ocp_lock);
+                CFS_INIT_LIST_HEAD(&ocp->ocp_queue);
+                CFS_INIT_LIST_HEAD(&ocp->ocp_free_tls);
+                cfs_waitq_init(&ocp->ocp_waitq);
+                ocp->ocp_cpt = i;
+        }
+
+        for (i = 0; i < nparts; i++) {
+                ocp = &ost_commit_parts[i];
+                OBD_ALLOC(ocp->ocp_threads,
+                          oss_commit_threads * sizeof(*ocp->ocp_threads));
+                if (ocp->ocp_threads == NULL)
+                        GOTO(failed, rc = -ENOMEM);
+
+                for (j = 0; j < oss_commit_threads; j++) {
+                        oct = &ocp->ocp_threads[j];
+                        oct->oct_part = ocp;
+                        oct->oct_thread.t_id = OSS_THREADS_MAX + id++;
+                        oct->oct_thread.t_svc = svc;
+                        CFS_INIT_LIST_HEAD(&oct->oct_thread.t_link);
+                        cfs_waitq_init(&oct->oct_thread.t_ctl_waitq);
+                        cfs_init_completion(&oct->oct_started);
+                        cfs_init_completion(&oct->oct_done);
+                        snprintf(oct->oct_name, sizeof(oct->oct_name),
+                                 "ll_ost_cmt%02d_%02d", i, j);
+
+                        rc = cfs_kernel_thread(ost_commit_main, oct, 0);
+                        if (rc < 0) {
+                                CERROR("cannot start %s: rc = %d\n",
+                                       oct->oct_name, rc);
+                                GOTO(failed, rc);
+                        }
+                        cfs_wait_for_completion(&oct->oct_started);
+                        ocp->ocp_nthreads++;
+                }
+        }
+        RETURN(0);
+
+failed:
+        ost_commit_stop();
+        ost_commit_fini();
+        RETURN(rc);
+}
+
 #define OST_WATCHDOG_TIMEOUT (obd_timeout * 1000)
 
 /* Sigh - really, this is an OSS, the _server_, not the _target_ */
@@ -2539,7 +3107,8 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
                                 ost_handle, LUSTRE_OSS_NAME,
                                 obd->obd_proc_entry, target_print_req,
                                 oss_min_threads, oss_max_threads,
-                                "ll_ost", LCT_DT_THREAD, NULL);
+                                "ll_ost", LCT_DT_THREAD, NULL,
+                                PTLRPC_SVC_CPT_PART);
         if (ost->ost_service == NULL) {
                 CERROR("failed to start service\n");
                 GOTO(out_lprocfs, rc = -ENOMEM);
@@ -2568,7 +3137,8 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
                                 ost_handle, "ost_create",
                                 obd->obd_proc_entry, target_print_req,
                                 oss_min_create_threads, oss_max_create_threads,
-                                "ll_ost_creat", LCT_DT_THREAD, NULL);
+                                "ll_ost_creat", LCT_DT_THREAD, NULL,
+                                PTLRPC_SVC_CPT_NONE);
         if (ost->ost_create_service == NULL) {
                 CERROR("failed to start OST create service\n");
                 GOTO(out_service, rc = -ENOMEM);
@@ -2585,7 +3155,8 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
                                 ost_handle, "ost_io",
                                 obd->obd_proc_entry, target_print_req,
                                 oss_min_threads, oss_max_threads,
-                                "ll_ost_io", LCT_DT_THREAD, ost_hpreq_handler);
+                                "ll_ost_io", LCT_DT_THREAD, ost_hpreq_handler,
+                                PTLRPC_SVC_CPT_PART);
         if (ost->ost_io_service == NULL) {
                 CERROR("failed to start OST I/O service\n");
                 GOTO(out_create, rc = -ENOMEM);
@@ -2594,17 +3165,29 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
         ost->ost_io_service->srv_init = ost_thread_init;
         ost->ost_io_service->srv_done = ost_thread_done;
         ost->ost_io_service->srv_cpu_affinity = 1;
+
+        cfs_down(&ost->ost_health_sem);
+        rc = ost_commit_init(ost->ost_io_service);
+        cfs_up(&ost->ost_health_sem);
+        if (rc)
+                GOTO(out_io, rc);
+
         rc = ptlrpc_start_threads(ost->ost_io_service);
         if (rc)
-                GOTO(out_io, rc = -EINVAL);
+                GOTO(out_commit, rc = -EINVAL);
 
         ping_evictor_start();
 
         RETURN(0);
 
+out_commit:
+        ost_commit_stop();
 out_io:
         ptlrpc_unregister_service(ost->ost_io_service);
         ost->ost_io_service = NULL;
+        cfs_down(&ost->ost_health_sem);
+        ost_commit_fini();
+        cfs_up(&ost->ost_health_sem);
 out_create:
         ptlrpc_unregister_service(ost->ost_create_service);
         ost->ost_create_service = NULL;
@@ -2628,9 +3211,12 @@ static int ost_cleanup(struct obd_device *obd)
          * obdfilter OBD */
         LASSERT(obd->obd_recovering == 0);
         cfs_down(&ost->ost_health_sem);
+        /* the queued commits hold requests of ost_io_service */
+        ost_commit_stop();
         ptlrpc_unregister_service(ost->ost_service);
         ptlrpc_unregister_service(ost->ost_create_service);
         ptlrpc_unregister_service(ost->ost_io_service);
+        ost_commit_fini();
         ost->ost_service = NULL;
         ost->ost_create_service = NULL;
         cfs_up(&ost->ost_health_sem);
@@ -60,16 +60,87 @@ struct ost_thread_local_cache {
          */
         struct niobuf_local   local[OST_THREAD_POOL_SIZE];
         unsigned int          temporary:1;
+        /*
+         * linkage in ocp_free_tls while not owned by any thread
+         */
+        cfs_list_t            list;
 };
 
 struct ost_thread_local_cache *ost_tls(struct ptlrpc_request *r);
 
+/*
+ * Write commit pipeline.
+ *
+ * Once the bulk GET of an OST_WRITE has completed, ost_brw_write() may hand
+ * the rest of the request (obd_commitrw() and the reply) over to a commit
+ * thread of its CPU partition, so that the ll_ost_io thread can start the
+ * bulk transfer of the next request while the pages of this one are written
+ * to disk.
+ */
+#define OST_COMMIT_THREADS_DEF  2       /* commit threads per CPU partition */
+#define OST_COMMIT_QUEUE_FACTOR 2       /* queued commits per commit thread */
+
+/* state of an OST_WRITE between its bulk transfer and its reply */
+struct ost_brw_commit {
+        cfs_list_t                     obc_list;
+        struct ptlrpc_request         *obc_req;
+        struct obd_trans_info          obc_oti;
+        struct ost_thread_local_cache *obc_tls;
+        struct ptlrpc_bulk_desc       *obc_desc;
+        struct ost_body               *obc_body;
+        struct ost_body               *obc_repbody;
+        struct obdo                   *obc_oa;
+        struct obd_ioobj              *obc_ioo;
+        struct niobuf_remote          *obc_remote_nb;
+        __u32                         *obc_rcs;
+        struct lustre_handle           obc_lockh;
+        int                            obc_objcount;
+        int                            obc_niocount;
+        int                            obc_npages;
+        obd_count                      obc_client_cksum;
+        obd_count                      obc_server_cksum;
+        cksum_type_t                   obc_cksum_type;
+        __u32                          obc_uid;
+        __u32                          obc_gid;
+        unsigned int                   obc_mmap:1,
+                                       obc_no_reply:1;
+};
+
+struct ost_commit_part;
+
+struct ost_commit_thread {
+        struct ptlrpc_thread           oct_thread;
+        struct ost_commit_part        *oct_part;
+        cfs_completion_t               oct_started;
+        cfs_completion_t               oct_done;
+        char                           oct_name[20];
+};
+
+/* commit threads and queue of one CPU partition */
+struct ost_commit_part {
+        cfs_spinlock_t                 ocp_lock;
+        /* struct ost_brw_commit waiting for a commit thread */
+        cfs_list_t                     ocp_queue;
+        int                            ocp_nqueued;
+        /* commits handed over to the threads so far */
+        __u64                          ocp_nhandoffs;
+        /* spare tls buffers, see ost_brw_commit_queue() */
+        cfs_list_t                     ocp_free_tls;
+        cfs_waitq_t                    ocp_waitq;
+        int                            ocp_cpt;
+        int                            ocp_nthreads;
+        unsigned int                   ocp_stopping:1;
+        struct ost_commit_thread      *ocp_threads;
+};
+
 #define OSS_MIN_CREATE_THREADS  2UL
 #define OSS_MAX_CREATE_THREADS 16UL
 
 /* Quota stuff */
 extern quota_interface_t *quota_interface;
 
+__u64 ost_commit_handoffs(struct obd_device *obd);
+
 #ifdef LPROCFS
 void lprocfs_ost_init_vars(struct lprocfs_static_vars *lvars);
 #else
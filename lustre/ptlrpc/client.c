@@ -610,6 +610,7 @@ static int __ptlrpc_request_bufs_pack(struct ptlrpc_request *request,
         cfs_atomic_set(&request->rq_refcount, 1);
 
         lustre_msg_set_opc(request->rq_reqmsg, opcode);
+        lustre_msg_set_jobid(request->rq_reqmsg, NULL);
 
         RETURN(0);
 out_ctx:
@@ -1007,6 +1008,7 @@ int ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
          */
         cfs_list_add_tail(&req->rq_set_chain, &set->set_new_requests);
         req->rq_set = set;
+        pc->pc_nr_queued++;
         cfs_spin_unlock(&set->set_new_req_lock);
 
         cfs_waitq_signal(&set->set_waitq);
@@ -223,6 +223,7 @@ void request_in_callback(lnet_event_t *ev)
 {
         struct ptlrpc_cb_id               *cbid = ev->md.user_ptr;
         struct ptlrpc_request_buffer_desc *rqbd = cbid->cbid_arg;
+        struct ptlrpc_service_part        *svcpt = rqbd->rqbd_svcpt;
         struct ptlrpc_service             *service = rqbd->rqbd_service;
         struct ptlrpc_request             *req;
         ENTRY;
@@ -251,7 +252,8 @@ void request_in_callback(lnet_event_t *ev)
                         /* We moaned above already... */
                         return;
                 }
-                OBD_ALLOC_GFP(req, sizeof(*req), CFS_ALLOC_ATOMIC_TRY);
+                OBD_CPT_ALLOC_GFP(req, svcpt->scp_cpt, sizeof(*req),
+                                  CFS_ALLOC_ATOMIC_TRY);
                 if (req == NULL) {
                         CERROR("Can't allocate incoming request descriptor: "
                                "Dropping %s RPC from %s\n",
@@ -285,21 +287,24 @@ void request_in_callback(lnet_event_t *ev)
 
         CDEBUG(D_RPCTRACE, "peer: %s\n", libcfs_id2str(req->rq_peer));
 
-        cfs_spin_lock(&service->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
 
-        req->rq_history_seq = service->srv_request_seq++;
-        cfs_list_add_tail(&req->rq_history_list, &service->srv_request_history);
+        /* the low bits of the sequence # tell which part it belongs to,
+         * see ptlrpc_lprocfs_svc_req_history_seek() */
+        req->rq_history_seq = (svcpt->scp_request_seq++ <<
+                               service->srv_cpt_bits) | svcpt->scp_index;
+        cfs_list_add_tail(&req->rq_history_list, &svcpt->scp_request_history);
 
         if (ev->unlinked) {
-                service->srv_nrqbd_receiving--;
+                svcpt->scp_nrqbd_receiving--;
                 CDEBUG(D_INFO, "Buffer complete: %d buffers still posted\n",
-                       service->srv_nrqbd_receiving);
+                       svcpt->scp_nrqbd_receiving);
 
                 /* Normally, don't complain about 0 buffers posted; LNET won't
                  * drop incoming reqs since we set the portal lazy */
                 if (test_req_buffer_pressure &&
                     ev->type != LNET_EVENT_UNLINK &&
-                    service->srv_nrqbd_receiving == 0)
+                    svcpt->scp_nrqbd_receiving == 0)
                         CWARN("All %s request buffers busy\n",
                               service->srv_name);
 
@@ -309,14 +314,14 @@ void request_in_callback(lnet_event_t *ev)
                 rqbd->rqbd_refcount++;
         }
 
-        cfs_list_add_tail(&req->rq_list, &service->srv_req_in_queue);
-        service->srv_n_queued_reqs++;
+        cfs_list_add_tail(&req->rq_list, &svcpt->scp_req_in_queue);
+        svcpt->scp_n_queued_reqs++;
 
         /* NB everything can disappear under us once the request
          * has been queued and we unlock, so do the wake now... */
-        cfs_waitq_signal(&service->srv_waitq);
+        cfs_waitq_signal(&svcpt->scp_waitq);
 
-        cfs_spin_unlock(&service->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
         EXIT;
 }
 
@@ -1056,13 +1056,8 @@ finish:
                                 cli->cl_cksum_type = OBD_CKSUM_CRC32;
                         } else {
                                 cli->cl_supp_cksum_types = ocd->ocd_cksum_types;
-
-                                if (ocd->ocd_cksum_types & OSC_DEFAULT_CKSUM)
-                                        cli->cl_cksum_type = OSC_DEFAULT_CKSUM;
-                                else if (ocd->ocd_cksum_types & OBD_CKSUM_ADLER)
-                                        cli->cl_cksum_type = OBD_CKSUM_ADLER;
-                                else
-                                        cli->cl_cksum_type = OBD_CKSUM_CRC32;
+                                cli->cl_cksum_type =
+                                      obd_cksum_type_select(ocd->ocd_cksum_types);
                         }
                 } else {
                         /* The server does not support OBD_CONNECT_CKSUM.
@@ -509,6 +509,15 @@ static const struct req_msg_field *ost_brw_client[] = {
         &RMF_CAPA1
 };
 
+static const struct req_msg_field *ost_brw_write_client[] = {
+        &RMF_PTLRPC_BODY,
+        &RMF_OST_BODY,
+        &RMF_OBD_IOOBJ,
+        &RMF_NIOBUF_REMOTE,
+        &RMF_CAPA1,
+        &RMF_BRW_OBDOS
+};
+
 static const struct req_msg_field *ost_brw_read_server[] = {
         &RMF_PTLRPC_BODY,
         &RMF_OST_BODY
@@ -517,7 +526,8 @@ static const struct req_msg_field *ost_brw_read_server[] = {
 static const struct req_msg_field *ost_brw_write_server[] = {
         &RMF_PTLRPC_BODY,
         &RMF_OST_BODY,
-        &RMF_RCS
+        &RMF_RCS,
+        &RMF_BRW_OBDOS
 };
 
 static const struct req_msg_field *ost_get_info_generic_server[] = {
@@ -901,6 +911,12 @@ struct req_msg_field RMF_RCS =
                     lustre_swab_generic_32s, dump_rcs);
 EXPORT_SYMBOL(RMF_RCS);
 
+/* obdos of the second and following objects of a multi-object write */
+struct req_msg_field RMF_BRW_OBDOS =
+        DEFINE_MSGF("brw_obdos", RMF_F_STRUCT_ARRAY, sizeof(struct obdo),
+                    lustre_swab_obdo, NULL);
+EXPORT_SYMBOL(RMF_BRW_OBDOS);
+
 struct req_msg_field RMF_OBD_ID =
         DEFINE_MSGF("obd_id", 0,
                     sizeof(obd_id), lustre_swab_ost_last_id, NULL);
@@ -1270,7 +1286,8 @@ struct req_format RQF_OST_BRW_READ =
 EXPORT_SYMBOL(RQF_OST_BRW_READ);
 
 struct req_format RQF_OST_BRW_WRITE =
-        DEFINE_REQ_FMT0("OST_BRW_WRITE", ost_brw_client, ost_brw_write_server);
+        DEFINE_REQ_FMT0("OST_BRW_WRITE", ost_brw_write_client,
+                        ost_brw_write_server);
 EXPORT_SYMBOL(RQF_OST_BRW_WRITE);
 
 struct req_format RQF_OST_STATFS =
@@ -167,19 +167,72 @@ const char *ll_opcode2str(__u32 opcode)
         return ll_rpc_opcode_table[offset].opname;
 }
 
+/**
+ * Opcode called \a name in ll_rpc_opcode_table, -1 if there is none.
+ */
+int ll_str2opcode(const char *name)
+{
+        int i;
+
+        for (i = 0; i < LUSTRE_MAX_OPCODES; i++) {
+                if (ll_rpc_opcode_table[i].opname != NULL &&
+                    strcmp(ll_rpc_opcode_table[i].opname, name) == 0)
+                        return ll_rpc_opcode_table[i].opcode;
+        }
+        return -1;
+}
+
 const char* ll_eopcode2str(__u32 opcode)
 {
         LASSERT(ll_eopcode_table[opcode].opcode == opcode);
         return ll_eopcode_table[opcode].opname;
 }
 #ifdef LPROCFS
+/* name the extra opcode and per-opcode counters of an obd_svc_stats array */
+static void ptlrpc_lprocfs_opcode_cntr_init(struct lprocfs_stats *stats,
+                                            unsigned int config)
+{
+        int i;
+
+        for (i = 0; i < EXTRA_LAST_OPC; i++) {
+                char *units;
+
+                switch(i) {
+                case BRW_WRITE_BYTES:
+                case BRW_READ_BYTES:
+                        units = "bytes";
+                        break;
+                default:
+                        units = "reqs";
+                        break;
+                }
+                lprocfs_counter_init(stats, PTLRPC_LAST_CNTR + i, config,
+                                     ll_eopcode2str(i), units);
+        }
+        for (i = 0; i < LUSTRE_MAX_OPCODES; i++) {
+                __u32 opcode = ll_rpc_opcode_table[i].opcode;
+                lprocfs_counter_init(stats, EXTRA_MAX_OPCODES + i, config,
+                                     ll_opcode2str(opcode), "usec");
+        }
+}
+
+/**
+ * Counter names of a job_stat, which has the obd_svc_stats layout, see
+ * lprocfs_job_stats_init().
+ */
+void ptlrpc_lprocfs_job_cntr_init(struct lprocfs_stats *stats)
+{
+        ptlrpc_lprocfs_opcode_cntr_init(stats, LPROCFS_CNTR_AVGMINMAX);
+}
+EXPORT_SYMBOL(ptlrpc_lprocfs_job_cntr_init);
+
 void ptlrpc_lprocfs_register(struct proc_dir_entry *root, char *dir,
                              char *name, struct proc_dir_entry **procroot_ret,
                              struct lprocfs_stats **stats_ret)
 {
         struct proc_dir_entry *svc_procroot;
         struct lprocfs_stats *svc_stats;
-        int i, rc;
+        int rc;
         unsigned int svc_counter_config = LPROCFS_CNTR_AVGMINMAX |
                                           LPROCFS_CNTR_STDDEV;
 
@@ -210,28 +263,7 @@ void ptlrpc_lprocfs_register(struct proc_dir_entry *root, char *dir,
                              svc_counter_config, "req_timeout", "sec");
         lprocfs_counter_init(svc_stats, PTLRPC_REQBUF_AVAIL_CNTR,
                              svc_counter_config, "reqbuf_avail", "bufs");
-        for (i = 0; i < EXTRA_LAST_OPC; i++) {
-                char *units;
-
-                switch(i) {
-                case BRW_WRITE_BYTES:
-                case BRW_READ_BYTES:
-                        units = "bytes";
-                        break;
-                default:
-                        units = "reqs";
-                        break;
-                }
-                lprocfs_counter_init(svc_stats, PTLRPC_LAST_CNTR + i,
-                                     svc_counter_config,
-                                     ll_eopcode2str(i), units);
-        }
-        for (i = 0; i < LUSTRE_MAX_OPCODES; i++) {
-                __u32 opcode = ll_rpc_opcode_table[i].opcode;
-                lprocfs_counter_init(svc_stats,
-                                     EXTRA_MAX_OPCODES + i, svc_counter_config,
-                                     ll_opcode2str(opcode), "usec");
-        }
+        ptlrpc_lprocfs_opcode_cntr_init(svc_stats, svc_counter_config);
 
         rc = lprocfs_register_stats(svc_procroot, name, svc_stats);
         if (rc < 0) {
@@ -249,10 +281,16 @@ static int
 ptlrpc_lprocfs_read_req_history_len(char *page, char **start, off_t off,
                                     int count, int *eof, void *data)
 {
-        struct ptlrpc_service *svc = data;
+        struct ptlrpc_service      *svc = data;
+        struct ptlrpc_service_part *svcpt;
+        int                         total = 0;
+        int                         i;
+
+        ptlrpc_service_for_each_part(svcpt, i, svc)
+                total += svcpt->scp_n_history_rqbds;
 
         *eof = 1;
-        return snprintf(page, count, "%d\n", svc->srv_n_history_rqbds);
+        return snprintf(page, count, "%d\n", total);
 }
 
 static int
@@ -331,9 +369,75 @@ static int
 ptlrpc_lprocfs_rd_threads_started(char *page, char **start, off_t off,
                                   int count, int *eof, void *data)
 {
-        struct ptlrpc_service *svc = data;
+        struct ptlrpc_service      *svc = data;
+        struct ptlrpc_service_part *svcpt;
+        int                         total = 0;
+        int                         i;
+
+        ptlrpc_service_for_each_part(svcpt, i, svc)
+                total += svcpt->scp_threads_running;
+
+        return snprintf(page, count, "%d\n", total);
+}
+
+/**
+ * One line per CPU partition of the service: its threads, queue depths,
+ * request buffers, lock contention and counters, so imbalance between the
+ * partitions is visible.
+ */
+static int
+ptlrpc_lprocfs_rd_cpt_stats(char *page, char **start, off_t off,
+                            int count, int *eof, void *data)
+{
+        struct ptlrpc_service      *svc = data;
+        struct ptlrpc_service_part *svcpt;
+        struct lprocfs_counter      req_in;
+        struct lprocfs_counter      handled;
+        struct lprocfs_counter      wait;
+        __u64                       avg_wait;
+        int                         rc;
+        int                         i;
+
+        *eof = 1;
+        rc = snprintf(page, count, "%-4s %-4s %-7s %-7s %-7s %-5s %-6s "
+                      "%-7s %-10s %-10s %s %s %s\n",
+                      "part", "cpt", "threads", "queued", "active", "bufs",
+                      "posted", "history", "lock_spin", "rqlock_spin",
+                      "req_in", "handled", "avg_wait_us");
+
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                lprocfs_stats_collect(svcpt->scp_stats,
+                                      PTLRPC_PART_REQ_IN_CNTR, &req_in);
+                lprocfs_stats_collect(svcpt->scp_stats,
+                                      PTLRPC_PART_REQ_HANDLED_CNTR, &handled);
+                lprocfs_stats_collect(svcpt->scp_stats,
+                                      PTLRPC_PART_REQWAIT_CNTR, &wait);
+                /* first argument to do_div MUST be __u64 */
+                avg_wait = wait.lc_sum;
+                if (wait.lc_count > 0)
+                        do_div(avg_wait, wait.lc_count);
 
-        return snprintf(page, count, "%d\n", svc->srv_threads_running);
+                rc += snprintf(page + rc, count - rc,
+                               "%-4d %-4d %-7d %-7d %-7d %-5d %-6d %-7d "
+                               "%-10lu %-10lu "LPU64" "LPU64" "LPU64"\n",
+                               svcpt->scp_index, svcpt->scp_cpt,
+                               svcpt->scp_threads_running,
+                               svcpt->scp_n_queued_reqs,
+                               svcpt->scp_n_active_reqs,
+                               svcpt->scp_nbufs,
+                               svcpt->scp_nrqbd_receiving,
+                               svcpt->scp_n_history_rqbds,
+                               svcpt->scp_lock_contended,
+                               svcpt->scp_rq_lock_contended,
+                               svcpt->scp_stats == NULL ? 0 :
+                               (__u64)req_in.lc_count,
+                               svcpt->scp_stats == NULL ? 0 :
+                               (__u64)handled.lc_count,
+                               svcpt->scp_stats == NULL ? 0 : avg_wait);
+                if (rc >= count)
+                        break;
+        }
+        return rc;
 }
 
 static int
@@ -370,12 +474,18 @@ ptlrpc_lprocfs_wr_threads_max(struct file *file, const char *buffer,
 }
 
 struct ptlrpc_srh_iterator {
+        /** index of the service part being walked */
+        int                    srhi_idx;
         __u64                  srhi_seq;
         struct ptlrpc_request *srhi_req;
 };
 
+/**
+ * Find the first request of part \a svcpt with sequence # >= \a seq.
+ * Must be called holding ptlrpc_service_part::scp_lock.
+ */
 int
-ptlrpc_lprocfs_svc_req_history_seek(struct ptlrpc_service *svc,
+ptlrpc_lprocfs_svc_req_history_seek(struct ptlrpc_service_part *svcpt,
                                     struct ptlrpc_srh_iterator *srhi,
                                     __u64 seq)
 {
@@ -383,7 +493,7 @@ ptlrpc_lprocfs_svc_req_history_seek(struct ptlrpc_service *svc,
         struct ptlrpc_request *req;
 
         if (srhi->srhi_req != NULL &&
-            srhi->srhi_seq > svc->srv_request_max_cull_seq &&
+            srhi->srhi_seq > svcpt->scp_request_max_cull_seq &&
             srhi->srhi_seq <= seq) {
                 /* If srhi_req was set previously, hasn't been culled and
                  * we're searching for a seq on or after it (i.e. more
@@ -392,14 +502,14 @@ ptlrpc_lprocfs_svc_req_history_seek(struct ptlrpc_service *svc,
                  * be near the head), we shouldn't have to do long
                  * re-scans */
                 LASSERT (srhi->srhi_seq == srhi->srhi_req->rq_history_seq);
-                LASSERT (!cfs_list_empty(&svc->srv_request_history));
+                LASSERT (!cfs_list_empty(&svcpt->scp_request_history));
                 e = &srhi->srhi_req->rq_history_list;
         } else {
                 /* search from start */
-                e = svc->srv_request_history.next;
+                e = svcpt->scp_request_history.next;
         }
 
-        while (e != &svc->srv_request_history) {
+        while (e != &svcpt->scp_request_history) {
                 req = cfs_list_entry(e, struct ptlrpc_request, rq_history_list);
 
                 if (req->rq_history_seq >= seq) {
@@ -413,6 +523,39 @@ ptlrpc_lprocfs_svc_req_history_seek(struct ptlrpc_service *svc,
         return -ENOENT;
 }
 
+/**
+ * Walk the history of the parts from \a srhi->srhi_idx onwards, looking
+ * for the first request with sequence # >= \a seq in the first part, or
+ * for any request in the following ones.  The history of each part is
+ * kept in sequence order and the low ptlrpc_service::srv_cpt_bits bits of
+ * the sequence # are the part index, so a position always tells which part
+ * to resume from.
+ */
+static int
+ptlrpc_lprocfs_svc_req_history_walk(struct ptlrpc_service *svc,
+                                    struct ptlrpc_srh_iterator *srhi,
+                                    __u64 seq)
+{
+        struct ptlrpc_service_part *svcpt;
+        int                         rc = -ENOENT;
+
+        for (; srhi->srhi_idx < svc->srv_nparts; srhi->srhi_idx++) {
+                svcpt = svc->srv_parts[srhi->srhi_idx];
+
+                ptlrpc_svcpt_lock(svcpt);
+                rc = ptlrpc_lprocfs_svc_req_history_seek(svcpt, srhi, seq);
+                ptlrpc_svcpt_unlock(svcpt);
+                if (rc == 0)
+                        break;
+
+                /* restart from the head of the next part */
+                srhi->srhi_req = NULL;
+                srhi->srhi_seq = 0;
+                seq = 0;
+        }
+        return rc;
+}
+
 static void *
 ptlrpc_lprocfs_svc_req_history_start(struct seq_file *s, loff_t *pos)
 {
@@ -426,11 +569,9 @@ ptlrpc_lprocfs_svc_req_history_start(struct seq_file *s, loff_t *pos)
 
         srhi->srhi_seq = 0;
         srhi->srhi_req = NULL;
+        srhi->srhi_idx = *pos & ((1 << svc->srv_cpt_bits) - 1);
 
-        cfs_spin_lock(&svc->srv_lock);
-        rc = ptlrpc_lprocfs_svc_req_history_seek(svc, srhi, *pos);
-        cfs_spin_unlock(&svc->srv_lock);
-
+        rc = ptlrpc_lprocfs_svc_req_history_walk(svc, srhi, *pos);
         if (rc == 0) {
                 *pos = srhi->srhi_seq;
                 return srhi;
@@ -457,10 +598,9 @@ ptlrpc_lprocfs_svc_req_history_next(struct seq_file *s,
         struct ptlrpc_srh_iterator  *srhi = iter;
         int                          rc;
 
-        cfs_spin_lock(&svc->srv_lock);
-        rc = ptlrpc_lprocfs_svc_req_history_seek(svc, srhi, *pos + 1);
-        cfs_spin_unlock(&svc->srv_lock);
-
+        /* the next seq # of the same part */
+        rc = ptlrpc_lprocfs_svc_req_history_walk(svc, srhi,
+                                                 *pos + (1 << svc->srv_cpt_bits));
         if (rc != 0) {
                 OBD_FREE(srhi, sizeof(*srhi));
                 return NULL;
@@ -473,7 +613,7 @@ ptlrpc_lprocfs_svc_req_history_next(struct seq_file *s,
 /* common ost/mdt srv_req_printfn */
 void target_print_req(void *seq_file, struct ptlrpc_request *req)
 {
-        /* Called holding srv_lock with irqs disabled.
+        /* Called holding scp_lock with irqs disabled.
          * Print specific req contents and a newline.
          * CAVEAT EMPTOR: check request message length before printing!!!
          * You might have received any old crap so you must be just as
@@ -504,12 +644,16 @@ static int ptlrpc_lprocfs_svc_req_history_show(struct seq_file *s, void *iter)
 {
         struct ptlrpc_service      *svc = s->private;
         struct ptlrpc_srh_iterator *srhi = iter;
+        struct ptlrpc_service_part *svcpt;
         struct ptlrpc_request      *req;
         int                         rc;
 
-        cfs_spin_lock(&svc->srv_lock);
+        LASSERT(srhi->srhi_idx < svc->srv_nparts);
+        svcpt = svc->srv_parts[srhi->srhi_idx];
 
-        rc = ptlrpc_lprocfs_svc_req_history_seek(svc, srhi, srhi->srhi_seq);
+        ptlrpc_svcpt_lock(svcpt);
+
+        rc = ptlrpc_lprocfs_svc_req_history_seek(svcpt, srhi, srhi->srhi_seq);
 
         if (rc == 0) {
                 req = srhi->srhi_req;
@@ -533,7 +677,7 @@ static int ptlrpc_lprocfs_svc_req_history_show(struct seq_file *s, void *iter)
                         svc->srv_req_printfn(s, srhi->srhi_req);
         }
 
-        cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
 
         return rc;
 }
@@ -617,6 +761,142 @@ static int ptlrpc_lprocfs_wr_hp_ratio(struct file *file, const char *buffer,
         return count;
 }
 
+/**
+ * NRS policies, the active one of the service in brackets.
+ */
+static int ptlrpc_lprocfs_rd_nrs_policy(char *page, char **start, off_t off,
+                                        int count, int *eof, void *data)
+{
+        struct ptlrpc_service      *svc = data;
+        struct ptlrpc_nrs_pol_desc *active;
+        int                         len = 0;
+        int                         i;
+
+        *eof = 1;
+        /* all parts run the same policy */
+        active = svc->srv_parts[0]->scp_nrs.nrs_policy;
+
+        for (i = 0; i < PTLRPC_NRS_POL_MAX && len < count; i++) {
+                if (&ptlrpc_nrs_policies[i] == active)
+                        len += snprintf(page + len, count - len, "[%s] ",
+                                        ptlrpc_nrs_policies[i].pd_name);
+                else
+                        len += snprintf(page + len, count - len, "%s ",
+                                        ptlrpc_nrs_policies[i].pd_name);
+        }
+        if (len < count)
+                len += sprintf(page + len, "\n");
+        return len;
+}
+
+static int ptlrpc_lprocfs_wr_nrs_policy(struct file *file, const char *buffer,
+                                        unsigned long count, void *data)
+{
+        struct ptlrpc_service      *svc = data;
+        struct ptlrpc_nrs_pol_desc *desc;
+        char                        kernbuf[16];
+        int                         rc;
+
+        if (count > sizeof(kernbuf) - 1)
+                return -EINVAL;
+        if (cfs_copy_from_user(kernbuf, buffer, count))
+                return -EFAULT;
+        if (count > 0 && kernbuf[count - 1] == '\n')
+                kernbuf[count - 1] = '\0';
+        else
+                kernbuf[count] = '\0';
+
+        desc = ptlrpc_nrs_policy_find(kernbuf);
+        if (desc == NULL)
+                return -EINVAL;
+
+        rc = ptlrpc_nrs_policy_set(svc, desc);
+        return rc != 0 ? rc : count;
+}
+
+/**
+ * One line per NRS policy, summed over the service parts: requests queued
+ * now, the deepest a part's queue has been, requests handled and their
+ * average and longest wait for a service thread.
+ */
+static int ptlrpc_lprocfs_rd_nrs_stats(char *page, char **start, off_t off,
+                                       int count, int *eof, void *data)
+{
+        struct ptlrpc_service       *svc = data;
+        struct ptlrpc_service_part  *svcpt;
+        struct ptlrpc_nrs_pol_stats *ps;
+        int                          rc;
+        int                          i;
+        int                          j;
+
+        *eof = 1;
+        rc = snprintf(page, count, "%-6s %-7s %-10s %-10s %-11s %s\n",
+                      "policy", "queued", "queued_max", "handled",
+                      "avg_wait_us", "max_wait_us");
+
+        for (i = 0; i < PTLRPC_NRS_POL_MAX && rc < count; i++) {
+                __u64 handled = 0;
+                __u64 wait_sum = 0;
+                long  wait_max = 0;
+                int   queued = 0;
+                int   queued_max = 0;
+
+                ptlrpc_service_for_each_part(svcpt, j, svc) {
+                        ps = &svcpt->scp_nrs.nrs_stats[i];
+                        queued += ps->ps_queued;
+                        queued_max = max(queued_max, ps->ps_queued_max);
+                        handled += ps->ps_handled;
+                        wait_sum += ps->ps_wait_sum;
+                        wait_max = max(wait_max, ps->ps_wait_max);
+                }
+                if (handled > 0)
+                        do_div(wait_sum, handled);
+
+                rc += snprintf(page + rc, count - rc,
+                               "%-6s %-7d %-10d "LPU64" "LPU64" %ld\n",
+                               ptlrpc_nrs_policies[i].pd_name, queued,
+                               queued_max, handled, wait_sum, wait_max);
+        }
+        return rc;
+}
+
+static int ptlrpc_lprocfs_rd_tbf_rules(char *page, char **start, off_t off,
+                                       int count, int *eof, void *data)
+{
+        struct ptlrpc_service *svc = data;
+
+        *eof = 1;
+        return ptlrpc_tbf_rules_print(svc, page, count);
+}
+
+/**
+ * Start, change or stop a TBF rule, see ptlrpc_tbf_ctl().
+ */
+static int ptlrpc_lprocfs_wr_tbf_rules(struct file *file, const char *buffer,
+                                       unsigned long count, void *data)
+{
+        struct ptlrpc_service *svc = data;
+        char                  *kernbuf;
+        int                    rc;
+
+        if (count > CFS_PAGE_SIZE - 1)
+                return -EINVAL;
+
+        OBD_ALLOC(kernbuf, count + 1);
+        if (kernbuf == NULL)
+                return -ENOMEM;
+
+        if (cfs_copy_from_user(kernbuf, buffer, count)) {
+                OBD_FREE(kernbuf, count + 1);
+                return -EFAULT;
+        }
+
+        rc = ptlrpc_tbf_ctl(svc, kernbuf);
+        OBD_FREE(kernbuf, count + 1);
+
+        return rc != 0 ? rc : count;
+}
+
 void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
                                      struct ptlrpc_service *svc)
 {
@@ -646,6 +926,20 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
                 {.name       = "timeouts",
                  .read_fptr  = ptlrpc_lprocfs_rd_timeouts,
                  .data       = svc},
+                {.name       = "cpt_stats",
+                 .read_fptr  = ptlrpc_lprocfs_rd_cpt_stats,
+                 .data       = svc},
+                {.name       = "nrs_policy",
+                 .read_fptr  = ptlrpc_lprocfs_rd_nrs_policy,
+                 .write_fptr = ptlrpc_lprocfs_wr_nrs_policy,
+                 .data       = svc},
+                {.name       = "nrs_stats",
+                 .read_fptr  = ptlrpc_lprocfs_rd_nrs_stats,
+                 .data       = svc},
+                {.name       = "tbf_rules",
+                 .read_fptr  = ptlrpc_lprocfs_rd_tbf_rules,
+                 .write_fptr = ptlrpc_lprocfs_wr_tbf_rules,
+                 .data       = svc},
                 {NULL}
         };
         static struct file_operations req_history_fops = {
@@ -656,6 +950,8 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
                 .release     = lprocfs_seq_release,
         };
 
+        struct ptlrpc_service_part *svcpt;
+        int i;
         int rc;
 
         ptlrpc_lprocfs_register(entry, svc->srv_name,
@@ -665,6 +961,27 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
         if (svc->srv_procroot == NULL)
                 return;
 
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                svcpt->scp_stats = lprocfs_alloc_stats(PTLRPC_PART_LAST_CNTR,
+                                                       0);
+                if (svcpt->scp_stats == NULL)
+                        continue;
+
+                lprocfs_counter_init(svcpt->scp_stats, PTLRPC_PART_REQ_IN_CNTR,
+                                     0, "req_in", "reqs");
+                lprocfs_counter_init(svcpt->scp_stats,
+                                     PTLRPC_PART_REQ_HANDLED_CNTR,
+                                     0, "req_handled", "reqs");
+                lprocfs_counter_init(svcpt->scp_stats,
+                                     PTLRPC_PART_REQWAIT_CNTR,
+                                     LPROCFS_CNTR_AVGMINMAX,
+                                     "req_waittime", "usec");
+                lprocfs_counter_init(svcpt->scp_stats,
+                                     PTLRPC_PART_REQQDEPTH_CNTR,
+                                     LPROCFS_CNTR_AVGMINMAX,
+                                     "req_qdepth", "reqs");
+        }
+
         lprocfs_add_vars(svc->srv_procroot, lproc_vars, NULL);
 
         rc = lprocfs_seq_create(svc->srv_procroot, "req_history",
@@ -700,11 +1017,6 @@ void ptlrpc_lprocfs_brw(struct ptlrpc_request *req, int bytes)
         struct lprocfs_stats *svc_stats;
         int idx;
 
-        if (!req->rq_import)
-                return;
-        svc_stats = req->rq_import->imp_obd->obd_svc_stats;
-        if (!svc_stats)
-                return;
         idx = lustre_msg_get_opc(req->rq_reqmsg);
         switch (idx) {
         case OST_READ:
@@ -718,6 +1030,18 @@ void ptlrpc_lprocfs_brw(struct ptlrpc_request *req, int bytes)
                 break;
         }
 
+        /* server side: account the bytes to the job that sent the RPC */
+        if (req->rq_export != NULL)
+                lprocfs_job_stats_log(req->rq_export->exp_obd,
+                                      lustre_msg_get_jobid(req->rq_reqmsg),
+                                      idx, bytes);
+
+        if (!req->rq_import)
+                return;
+        svc_stats = req->rq_import->imp_obd->obd_svc_stats;
+        if (!svc_stats)
+                return;
+
         lprocfs_counter_add(svc_stats, idx, bytes);
 }
 
@@ -725,11 +1049,19 @@ EXPORT_SYMBOL(ptlrpc_lprocfs_brw);
 
 void ptlrpc_lprocfs_unregister_service(struct ptlrpc_service *svc)
 {
+        struct ptlrpc_service_part *svcpt;
+        int                         i;
+
         if (svc->srv_procroot != NULL)
                 lprocfs_remove(&svc->srv_procroot);
 
         if (svc->srv_stats)
                 lprocfs_free_stats(&svc->srv_stats);
+
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                if (svcpt->scp_stats != NULL)
+                        lprocfs_free_stats(&svcpt->scp_stats);
+        }
 }
 
 void ptlrpc_lprocfs_unregister_obd(struct obd_device *obd)
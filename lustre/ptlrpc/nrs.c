@@ -0,0 +1,581 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * lustre/ptlrpc/nrs.c
+ *
+ * Network Request Scheduler: policies ordering the normal priority
+ * requests of a ptlrpc service.
+ *
+ * - fifo: requests are served in arrival order, as ptlrpc always did;
+ * - crr:  requests are queued per client NID and the clients are served
+ *         round-robin, so one client flooding the service can't starve
+ *         the others;
+ * - orr:  bulk I/O requests are queued per object, sorted by offset, and
+ *         the objects are served round-robin a few requests at a time, so
+ *         the disk sees mostly sequential I/O.  Other requests share one
+ *         FIFO queue which takes its turn like an object.
+ *
+ * The policy is chosen per service through the "nrs_policy" proc file and
+ * can be changed at any time: requests queued to the old policy are moved
+ * over to the new one.
+ */
+
+#ifndef EXPORT_SYMTAB
+# define EXPORT_SYMTAB
+#endif
+#define DEBUG_SUBSYSTEM S_RPC
+
+#ifndef __KERNEL__
+#include <liblustre.h>
+#endif
+
+#include <obd_support.h>
+#include <obd_class.h>
+#include <lustre_net.h>
+#include <libcfs/libcfs_hash.h>
+#include "ptlrpc_internal.h"
+
+/* serializes policy changes */
+static CFS_DECLARE_MUTEX(ptlrpc_nrs_sem);
+
+/*
+ * FIFO policy
+ */
+
+struct nrs_fifo_head {
+        cfs_list_t      fh_list;
+};
+
+static void *nrs_fifo_init(int cpt)
+{
+        struct nrs_fifo_head *head;
+
+        OBD_CPT_ALLOC_PTR(head, cpt);
+        if (head != NULL)
+                CFS_INIT_LIST_HEAD(&head->fh_list);
+        return head;
+}
+
+static void nrs_fifo_fini(void *priv)
+{
+        struct nrs_fifo_head *head = priv;
+
+        LASSERT(cfs_list_empty(&head->fh_list));
+        OBD_FREE_PTR(head);
+}
+
+static int nrs_fifo_enqueue(void *priv, struct ptlrpc_request *req)
+{
+        struct nrs_fifo_head *head = priv;
+
+        cfs_list_add_tail(&req->rq_list, &head->fh_list);
+        return 0;
+}
+
+static struct ptlrpc_request *nrs_fifo_peek(void *priv)
+{
+        struct nrs_fifo_head *head = priv;
+
+        if (cfs_list_empty(&head->fh_list))
+                return NULL;
+
+        return cfs_list_entry(head->fh_list.next,
+                              struct ptlrpc_request, rq_list);
+}
+
+static void nrs_fifo_dequeue(void *priv, struct ptlrpc_request *req)
+{
+        cfs_list_del_init(&req->rq_list);
+}
+
+static struct ptlrpc_nrs_pol_ops nrs_fifo_ops = {
+        .pop_init       = nrs_fifo_init,
+        .pop_fini       = nrs_fifo_fini,
+        .pop_enqueue    = nrs_fifo_enqueue,
+        .pop_peek       = nrs_fifo_peek,
+        .pop_dequeue    = nrs_fifo_dequeue,
+};
+
+/*
+ * Round-robin engine shared by the crr and orr policies: requests are
+ * queued in buckets by key, buckets with requests are served in turn,
+ * rh_quantum requests at a time.
+ */
+
+#define NRS_RR_HASH_BITS        6
+#define NRS_RR_HASH_SIZE        (1 << NRS_RR_HASH_BITS)
+
+/** # of requests of one object orr serves before moving to the next one */
+#define NRS_ORR_QUANTUM         8
+
+struct nrs_rr_bucket {
+        /** link in nrs_rr_head::rh_hash */
+        cfs_list_t      rb_hash;
+        /** link in nrs_rr_head::rh_round */
+        cfs_list_t      rb_round;
+        /** queued requests */
+        cfs_list_t      rb_reqs;
+        __u64           rb_key;
+        __u64           rb_key2;
+        /** # of requests served in this turn */
+        int             rb_served;
+};
+
+struct nrs_rr_head {
+        /** CPU partition to allocate buckets on */
+        int             rh_cpt;
+        /** # of requests served from a bucket in one turn */
+        int             rh_quantum;
+        /** keep requests of a bucket sorted by nr_offset */
+        int             rh_sorted;
+        void          (*rh_key)(struct ptlrpc_request *req,
+                                __u64 *key, __u64 *key2);
+        /** buckets with queued requests, in service order */
+        cfs_list_t      rh_round;
+        cfs_list_t      rh_hash[NRS_RR_HASH_SIZE];
+};
+
+static void *nrs_rr_init(int cpt, int quantum, int sorted,
+                         void (*key)(struct ptlrpc_request *,
+                                     __u64 *, __u64 *))
+{
+        struct nrs_rr_head *head;
+        int                 i;
+
+        OBD_CPT_ALLOC_PTR(head, cpt);
+        if (head == NULL)
+                return NULL;
+
+        head->rh_cpt = cpt;
+        head->rh_quantum = quantum;
+        head->rh_sorted = sorted;
+        head->rh_key = key;
+        CFS_INIT_LIST_HEAD(&head->rh_round);
+        for (i = 0; i < NRS_RR_HASH_SIZE; i++)
+                CFS_INIT_LIST_HEAD(&head->rh_hash[i]);
+
+        return head;
+}
+
+static void nrs_rr_fini(void *priv)
+{
+        struct nrs_rr_head *head = priv;
+        int                 i;
+
+        LASSERT(cfs_list_empty(&head->rh_round));
+        for (i = 0; i < NRS_RR_HASH_SIZE; i++)
+                LASSERT(cfs_list_empty(&head->rh_hash[i]));
+
+        OBD_FREE_PTR(head);
+}
+
+static int nrs_rr_enqueue(void *priv, struct ptlrpc_request *req)
+{
+        struct nrs_rr_head   *head = priv;
+        struct nrs_rr_bucket *bkt;
+        cfs_list_t           *chain;
+        cfs_list_t           *pos;
+        __u64                 key;
+        __u64                 key2;
+
+        head->rh_key(req, &key, &key2);
+        chain = &head->rh_hash[cfs_hash_u64_hash(key ^ key2,
+                                                 NRS_RR_HASH_SIZE - 1)];
+
+        cfs_list_for_each_entry(bkt, chain, rb_hash) {
+                if (bkt->rb_key == key && bkt->rb_key2 == key2)
+                        goto found;
+        }
+
+        /* called under a spinlock */
+        OBD_CPT_ALLOC_GFP(bkt, head->rh_cpt, sizeof(*bkt),
+                          CFS_ALLOC_ATOMIC);
+        if (bkt == NULL)
+                return -ENOMEM;
+
+        bkt->rb_key = key;
+        bkt->rb_key2 = key2;
+        CFS_INIT_LIST_HEAD(&bkt->rb_reqs);
+        cfs_list_add(&bkt->rb_hash, chain);
+        cfs_list_add_tail(&bkt->rb_round, &head->rh_round);
+found:
+        req->rq_nrs.nr_private = bkt;
+
+        if (!head->rh_sorted) {
+                cfs_list_add_tail(&req->rq_list, &bkt->rb_reqs);
+                return 0;
+        }
+
+        /* new I/O is usually at a higher offset, search from the tail */
+        cfs_list_for_each_prev(pos, &bkt->rb_reqs) {
+                struct ptlrpc_request *tmp;
+
+                tmp = cfs_list_entry(pos, struct ptlrpc_request, rq_list);
+                if (tmp->rq_nrs.nr_offset <= req->rq_nrs.nr_offset)
+                        break;
+        }
+        cfs_list_add(&req->rq_list, pos);
+        return 0;
+}
+
+static struct ptlrpc_request *nrs_rr_peek(void *priv)
+{
+        struct nrs_rr_head   *head = priv;
+        struct nrs_rr_bucket *bkt;
+
+        if (cfs_list_empty(&head->rh_round))
+                return NULL;
+
+        bkt = cfs_list_entry(head->rh_round.next, struct nrs_rr_bucket,
+                             rb_round);
+        LASSERT(!cfs_list_empty(&bkt->rb_reqs));
+
+        return cfs_list_entry(bkt->rb_reqs.next, struct ptlrpc_request,
+                              rq_list);
+}
+
+static void nrs_rr_dequeue(void *priv, struct ptlrpc_request *req)
+{
+        struct nrs_rr_head   *head = priv;
+        struct nrs_rr_bucket *bkt = req->rq_nrs.nr_private;
+        int                   served;
+
+        LASSERT(bkt != NULL);
+
+        /* taking the request nrs_rr_peek() returned counts as serving it */
+        served = head->rh_round.next == &bkt->rb_round &&
+                 bkt->rb_reqs.next == &req->rq_list;
+
+        cfs_list_del_init(&req->rq_list);
+        req->rq_nrs.nr_private = NULL;
+
+        if (cfs_list_empty(&bkt->rb_reqs)) {
+                cfs_list_del(&bkt->rb_round);
+                cfs_list_del(&bkt->rb_hash);
+                OBD_FREE_PTR(bkt);
+                return;
+        }
+
+        if (served && ++bkt->rb_served >= head->rh_quantum) {
+                /* end of turn */
+                bkt->rb_served = 0;
+                cfs_list_move_tail(&bkt->rb_round, &head->rh_round);
+        }
+}
+
+/*
+ * CRR policy: one bucket per client NID, one request per turn
+ */
+
+static void nrs_crr_key(struct ptlrpc_request *req, __u64 *key, __u64 *key2)
+{
+        *key = req->rq_peer.nid;
+        *key2 = 0;
+}
+
+static void *nrs_crr_init(int cpt)
+{
+        return nrs_rr_init(cpt, 1, 0, nrs_crr_key);
+}
+
+static struct ptlrpc_nrs_pol_ops nrs_crr_ops = {
+        .pop_init       = nrs_crr_init,
+        .pop_fini       = nrs_rr_fini,
+        .pop_enqueue    = nrs_rr_enqueue,
+        .pop_peek       = nrs_rr_peek,
+        .pop_dequeue    = nrs_rr_dequeue,
+};
+
+/*
+ * ORR policy: one bucket per object, sorted by offset, NRS_ORR_QUANTUM
+ * requests per turn.  The service fills in ptlrpc_nrs_request::nr_objid
+ * etc. of bulk I/O requests before they are queued (see
+ * ost_hpreq_handler()), all other requests go to the bucket of object 0.
+ */
+
+static void nrs_orr_key(struct ptlrpc_request *req, __u64 *key, __u64 *key2)
+{
+        if (req->rq_nrs.nr_has_obj) {
+                *key = req->rq_nrs.nr_objid;
+                *key2 = req->rq_nrs.nr_objgr;
+        } else {
+                *key = 0;
+                *key2 = 0;
+        }
+}
+
+static void *nrs_orr_init(int cpt)
+{
+        return nrs_rr_init(cpt, NRS_ORR_QUANTUM, 1, nrs_orr_key);
+}
+
+static struct ptlrpc_nrs_pol_ops nrs_orr_ops = {
+        .pop_init       = nrs_orr_init,
+        .pop_fini       = nrs_rr_fini,
+        .pop_enqueue    = nrs_rr_enqueue,
+        .pop_peek       = nrs_rr_peek,
+        .pop_dequeue    = nrs_rr_dequeue,
+};
+
+struct ptlrpc_nrs_pol_desc ptlrpc_nrs_policies[PTLRPC_NRS_POL_MAX] = {
+        [PTLRPC_NRS_FIFO] = {
+                .pd_name        = "fifo",
+                .pd_id          = PTLRPC_NRS_FIFO,
+                .pd_ops         = &nrs_fifo_ops,
+        },
+        [PTLRPC_NRS_CRR] = {
+                .pd_name        = "crr",
+                .pd_id          = PTLRPC_NRS_CRR,
+                .pd_ops         = &nrs_crr_ops,
+        },
+        [PTLRPC_NRS_ORR] = {
+                .pd_name        = "orr",
+                .pd_id          = PTLRPC_NRS_ORR,
+                .pd_ops         = &nrs_orr_ops,
+        },
+};
+
+/*
+ * NRS head of a service part
+ */
+
+/**
+ * Set up the request queue of \a svcpt, with the FIFO policy.
+ */
+int ptlrpc_nrs_init(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_nrs          *nrs = &svcpt->scp_nrs;
+        struct ptlrpc_nrs_pol_desc *desc;
+
+        memset(nrs, 0, sizeof(*nrs));
+        CFS_INIT_LIST_HEAD(&nrs->nrs_fallback);
+
+        desc = &ptlrpc_nrs_policies[PTLRPC_NRS_FIFO];
+        nrs->nrs_private = desc->pd_ops->pop_init(svcpt->scp_cpt);
+        if (nrs->nrs_private == NULL)
+                return -ENOMEM;
+
+        nrs->nrs_policy = desc;
+        return 0;
+}
+
+void ptlrpc_nrs_fini(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_nrs *nrs = &svcpt->scp_nrs;
+
+        if (nrs->nrs_policy == NULL)
+                return;
+
+        LASSERT(nrs->nrs_nreqs == 0);
+        LASSERT(cfs_list_empty(&nrs->nrs_fallback));
+
+        nrs->nrs_policy->pd_ops->pop_fini(nrs->nrs_private);
+        nrs->nrs_policy = NULL;
+        nrs->nrs_private = NULL;
+}
+
+/**
+ * Queue \a req for service.  Called holding scp_rq_lock.
+ */
+void ptlrpc_nrs_enqueue(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req)
+{
+        struct ptlrpc_nrs           *nrs = &svcpt->scp_nrs;
+        struct ptlrpc_nrs_pol_desc  *desc = nrs->nrs_policy;
+        struct ptlrpc_nrs_pol_stats *stats = &nrs->nrs_stats[desc->pd_id];
+
+        LASSERT(!req->rq_nrs.nr_enqueued);
+
+        if (desc->pd_ops->pop_enqueue(nrs->nrs_private, req) != 0) {
+                /* the policy is short of memory, don't lose the request */
+                cfs_list_add_tail(&req->rq_list, &nrs->nrs_fallback);
+                req->rq_nrs.nr_fallback = 1;
+        }
+
+        req->rq_nrs.nr_policy = desc->pd_id;
+        req->rq_nrs.nr_enqueued = 1;
+        nrs->nrs_nreqs++;
+
+        if (++stats->ps_queued > stats->ps_queued_max)
+                stats->ps_queued_max = stats->ps_queued;
+}
+
+/**
+ * The request to be served next, it stays queued.  Called holding
+ * scp_rq_lock.
+ */
+struct ptlrpc_request *ptlrpc_nrs_peek(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_nrs     *nrs = &svcpt->scp_nrs;
+        struct ptlrpc_request *req;
+
+        if (nrs->nrs_nreqs == 0)
+                return NULL;
+
+        req = nrs->nrs_policy->pd_ops->pop_peek(nrs->nrs_private);
+        if (req == NULL) {
+                LASSERT(!cfs_list_empty(&nrs->nrs_fallback));
+                req = cfs_list_entry(nrs->nrs_fallback.next,
+                                     struct ptlrpc_request, rq_list);
+        }
+        return req;
+}
+
+/**
+ * Unlink queued request \a req.  \a served tells whether it is going to be
+ * handled by a service thread, which is accounted in the policy stats.
+ * Called holding scp_rq_lock.
+ */
+void ptlrpc_nrs_dequeue(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req, int served)
+{
+        struct ptlrpc_nrs           *nrs = &svcpt->scp_nrs;
+        struct ptlrpc_nrs_pol_stats *stats;
+
+        LASSERT(req->rq_nrs.nr_enqueued);
+        LASSERT(req->rq_nrs.nr_policy == nrs->nrs_policy->pd_id);
+
+        if (req->rq_nrs.nr_fallback) {
+                cfs_list_del_init(&req->rq_list);
+                req->rq_nrs.nr_fallback = 0;
+        } else {
+                nrs->nrs_policy->pd_ops->pop_dequeue(nrs->nrs_private, req);
+        }
+
+        req->rq_nrs.nr_enqueued = 0;
+        nrs->nrs_nreqs--;
+
+        stats = &nrs->nrs_stats[req->rq_nrs.nr_policy];
+        stats->ps_queued--;
+
+        if (served) {
+                struct timeval now;
+                long           wait;
+
+                cfs_gettimeofday(&now);
+                wait = cfs_timeval_sub(&now, &req->rq_arrival_time, NULL);
+                stats->ps_handled++;
+                stats->ps_wait_sum += wait;
+                if (wait > stats->ps_wait_max)
+                        stats->ps_wait_max = wait;
+        }
+}
+
+/**
+ * Find policy \a name.
+ */
+struct ptlrpc_nrs_pol_desc *ptlrpc_nrs_policy_find(const char *name)
+{
+        int i;
+
+        for (i = 0; i < PTLRPC_NRS_POL_MAX; i++) {
+                if (strcmp(ptlrpc_nrs_policies[i].pd_name, name) == 0)
+                        return &ptlrpc_nrs_policies[i];
+        }
+        return NULL;
+}
+
+/**
+ * Switch part \a svcpt to policy \a desc, moving the queued requests over.
+ */
+static int ptlrpc_nrs_policy_switch(struct ptlrpc_service_part *svcpt,
+                                    struct ptlrpc_nrs_pol_desc *desc)
+{
+        struct ptlrpc_nrs          *nrs = &svcpt->scp_nrs;
+        struct ptlrpc_nrs_pol_desc *old_desc;
+        struct ptlrpc_request      *req;
+        cfs_list_t                  list;
+        void                       *old_priv;
+        void                       *priv;
+
+        if (nrs->nrs_policy == desc)
+                return 0;
+
+        priv = desc->pd_ops->pop_init(svcpt->scp_cpt);
+        if (priv == NULL)
+                return -ENOMEM;
+
+        CFS_INIT_LIST_HEAD(&list);
+
+        ptlrpc_svcpt_rq_lock(svcpt);
+
+        /* drain the old policy in its service order */
+        while ((req = ptlrpc_nrs_peek(svcpt)) != NULL) {
+                ptlrpc_nrs_dequeue(svcpt, req, 0);
+                cfs_list_add_tail(&req->rq_list, &list);
+        }
+
+        old_desc = nrs->nrs_policy;
+        old_priv = nrs->nrs_private;
+        nrs->nrs_policy = desc;
+        nrs->nrs_private = priv;
+
+        while (!cfs_list_empty(&list)) {
+                req = cfs_list_entry(list.next, struct ptlrpc_request,
+                                     rq_list);
+                cfs_list_del_init(&req->rq_list);
+                ptlrpc_nrs_enqueue(svcpt, req);
+        }
+
+        ptlrpc_svcpt_rq_unlock(svcpt);
+
+        old_desc->pd_ops->pop_fini(old_priv);
+
+        CDEBUG(D_RPCTRACE, "%s: part %d switched from %s to %s NRS policy\n",
+               svcpt->scp_service->srv_name, svcpt->scp_index,
+               old_desc->pd_name, desc->pd_name);
+        return 0;
+}
+
+/**
+ * Switch all parts of service \a svc to policy \a desc.
+ */
+int ptlrpc_nrs_policy_set(struct ptlrpc_service *svc,
+                          struct ptlrpc_nrs_pol_desc *desc)
+{
+        struct ptlrpc_service_part *svcpt;
+        int                         rc = 0;
+        int                         i;
+
+        cfs_down(&ptlrpc_nrs_sem);
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                rc = ptlrpc_nrs_policy_switch(svcpt, desc);
+                if (rc != 0)
+                        break;
+        }
+        cfs_up(&ptlrpc_nrs_sem);
+
+        return rc;
+}
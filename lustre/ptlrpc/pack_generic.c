@@ -1241,6 +1241,33 @@ __u32 lustre_msg_get_service_time(struct lustre_msg *msg)
         }
 }
 
+/**
+ * Job identifier the request was sent for, NULL if it has none.
+ */
+char *lustre_msg_get_jobid(struct lustre_msg *msg)
+{
+        switch (msg->lm_magic) {
+        case LUSTRE_MSG_MAGIC_V1:
+        case LUSTRE_MSG_MAGIC_V1_SWABBED:
+                return NULL;
+        case LUSTRE_MSG_MAGIC_V2: {
+                struct ptlrpc_body *pb = lustre_msg_ptlrpc_body(msg);
+                if (!pb) {
+                        CERROR("invalid msg %p: no ptlrpc body!\n", msg);
+                        return NULL;
+                }
+                if (pb->pb_jobid[0] == '\0')
+                        return NULL;
+                /* don't trust the peer to terminate it */
+                pb->pb_jobid[LUSTRE_JOBID_SIZE - 1] = '\0';
+                return pb->pb_jobid;
+        }
+        default:
+                CERROR("incorrect message magic: %08x\n", msg->lm_magic);
+                return NULL;
+        }
+}
+
 __u32 lustre_msg_get_cksum(struct lustre_msg *msg)
 {
         switch (msg->lm_magic) {
@@ -1329,6 +1356,28 @@ void lustre_msg_set_opc(struct lustre_msg *msg, __u32 opc)
         }
 }
 
+/**
+ * Tag \a msg with \a jobid, or with the job id of the current process if
+ * \a jobid is NULL.
+ */
+void lustre_msg_set_jobid(struct lustre_msg *msg, char *jobid)
+{
+        switch (msg->lm_magic) {
+        case LUSTRE_MSG_MAGIC_V2: {
+                struct ptlrpc_body *pb = lustre_msg_ptlrpc_body(msg);
+                LASSERTF(pb, "invalid msg %p: no ptlrpc body!\n", msg);
+
+                if (jobid != NULL)
+                        strncpy(pb->pb_jobid, jobid, LUSTRE_JOBID_SIZE - 1);
+                else
+                        lustre_get_jobid(pb->pb_jobid);
+                return;
+        }
+        default:
+                LASSERTF(0, "incorrect message magic: %08x\n", msg->lm_magic);
+        }
+}
+
 void lustre_msg_set_last_xid(struct lustre_msg *msg, __u64 last_xid)
 {
         switch (msg->lm_magic) {
@@ -1554,7 +1603,8 @@ void lustre_swab_ptlrpc_body(struct ptlrpc_body *b)
         __swab64s (&b->pb_pre_versions[1]);
         __swab64s (&b->pb_pre_versions[2]);
         __swab64s (&b->pb_pre_versions[3]);
-        CLASSERT(offsetof(typeof(*b), pb_padding) != 0);
+        /* pb_jobid is a string, no swabbing */
+        CLASSERT(offsetof(typeof(*b), pb_jobid) != 0);
 }
 
 void lustre_swab_connect(struct obd_connect_data *ocd)
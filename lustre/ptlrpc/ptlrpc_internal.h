@@ -65,6 +65,8 @@ void ptlrpc_initiate_recovery(struct obd_import *imp);
 int lustre_unpack_req_ptlrpc_body(struct ptlrpc_request *req, int offset);
 int lustre_unpack_rep_ptlrpc_body(struct ptlrpc_request *req, int offset);
 
+/* lproc_ptlrpc.c */
+int ll_str2opcode(const char *name);
 #ifdef LPROCFS
 void ptlrpc_lprocfs_register_service(struct proc_dir_entry *proc_entry,
                                      struct ptlrpc_service *svc);
@@ -144,6 +146,69 @@ void __exit sptlrpc_fini(void);
 int llog_recov_init(void);
 void llog_recov_fini(void);
 
+/* ptlrpcd.c */
+int  ptlrpcd_pool_init(void);
+void ptlrpcd_pool_fini(void);
+
+/* service.c */
+/**
+ * Take the lock of service part \a svcpt, counting the times it had to
+ * spin; the counters show up in the "cpt_stats" proc file.
+ */
+static inline void ptlrpc_svcpt_lock(struct ptlrpc_service_part *svcpt)
+{
+        if (!cfs_spin_trylock(&svcpt->scp_lock)) {
+                cfs_spin_lock(&svcpt->scp_lock);
+                svcpt->scp_lock_contended++;
+        }
+}
+
+static inline void ptlrpc_svcpt_unlock(struct ptlrpc_service_part *svcpt)
+{
+        cfs_spin_unlock(&svcpt->scp_lock);
+}
+
+/** same as ptlrpc_svcpt_lock(), for the request queue lock */
+static inline void ptlrpc_svcpt_rq_lock(struct ptlrpc_service_part *svcpt)
+{
+        if (!cfs_spin_trylock(&svcpt->scp_rq_lock)) {
+                cfs_spin_lock(&svcpt->scp_rq_lock);
+                svcpt->scp_rq_lock_contended++;
+        }
+}
+
+static inline void ptlrpc_svcpt_rq_unlock(struct ptlrpc_service_part *svcpt)
+{
+        cfs_spin_unlock(&svcpt->scp_rq_lock);
+}
+
+/* nrs.c */
+extern struct ptlrpc_nrs_pol_desc ptlrpc_nrs_policies[PTLRPC_NRS_POL_MAX];
+int  ptlrpc_nrs_init(struct ptlrpc_service_part *svcpt);
+void ptlrpc_nrs_fini(struct ptlrpc_service_part *svcpt);
+void ptlrpc_nrs_enqueue(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req);
+struct ptlrpc_request *ptlrpc_nrs_peek(struct ptlrpc_service_part *svcpt);
+void ptlrpc_nrs_dequeue(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req, int served);
+struct ptlrpc_nrs_pol_desc *ptlrpc_nrs_policy_find(const char *name);
+int  ptlrpc_nrs_policy_set(struct ptlrpc_service *svc,
+                           struct ptlrpc_nrs_pol_desc *desc);
+
+/* tbf.c */
+void ptlrpc_tbf_part_init(struct ptlrpc_service_part *svcpt);
+void ptlrpc_tbf_part_fini(struct ptlrpc_service_part *svcpt);
+void ptlrpc_tbf_fini(struct ptlrpc_service *svc);
+int  ptlrpc_tbf_defer(struct ptlrpc_service_part *svcpt,
+                      struct ptlrpc_request *req);
+void ptlrpc_tbf_undefer(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req);
+int  ptlrpc_tbf_release(struct ptlrpc_service_part *svcpt);
+#ifdef LPROCFS
+int  ptlrpc_tbf_ctl(struct ptlrpc_service *svc, char *cmd);
+int  ptlrpc_tbf_rules_print(struct ptlrpc_service *svc, char *page, int count);
+#endif
+
 static inline int ll_rpc_recoverable_error(int rc)
 {
         return (rc == -ENOTCONN || rc == -ENODEV);
@@ -84,12 +84,10 @@ struct ptlrpcd_scope_ctl {
         } pscope_thread[PT_NR];
 };
 
+/* a NULL pt_name means the requests are served by ptlrpcd_pool instead */
 static struct ptlrpcd_scope_ctl ptlrpcd_scopes[PSCOPE_NR] = {
         [PSCOPE_BRW] = {
                 .pscope_thread = {
-                        [PT_NORMAL] = {
-                                .pt_name = "ptlrpcd-brw"
-                        },
                         [PT_RECOVERY] = {
                                 .pt_name = "ptlrpcd-brw-rcv"
                         }
@@ -107,6 +105,44 @@ static struct ptlrpcd_scope_ctl ptlrpcd_scopes[PSCOPE_NR] = {
         }
 };
 
+/**
+ * Pool of ptlrpcd-brw_NN threads serving the PSCOPE_BRW requests that are
+ * not for recovery, which is where brw_interpret() and checksumming run.
+ *
+ * Every CPU partition gets its own threads, bound to the partition unless
+ * ptlrpcd_bind_cpt is 0; with one partition per CPU (libcfs
+ * cpu_npartitions) this gives one thread per CPU.  A request goes to a
+ * thread of the partition of the CPU it is submitted on, round-robin, and
+ * the threads of one partition are partners: one running out of work
+ * steals the requests still waiting in a partner's queue, see
+ * ptlrpcd_steal().
+ *
+ * The pool is set up when ptlrpc is loaded, its threads are only started
+ * while ptlrpcd has users.
+ */
+struct ptlrpcd_pool_part {
+        /** first thread of this partition in ptlrpcd_pool */
+        struct ptlrpcd_ctl *ppp_threads;
+        int                 ppp_nthreads;
+        /** next thread to dispatch to; racy, it only spreads the load */
+        unsigned int        ppp_cursor;
+};
+
+static int ptlrpcd_per_cpt = 0;
+CFS_MODULE_PARM(ptlrpcd_per_cpt, "i", int, 0444,
+                "ptlrpcd-brw threads per CPU partition (0: one per CPU)");
+static int ptlrpcd_bind_cpt = 1;
+CFS_MODULE_PARM(ptlrpcd_bind_cpt, "i", int, 0444,
+                "bind ptlrpcd-brw threads to their CPU partition");
+
+static struct ptlrpcd_ctl       *ptlrpcd_pool;
+static int                       ptlrpcd_pool_size;
+static struct ptlrpcd_pool_part *ptlrpcd_pool_parts;
+/** all pool threads are running, so that partners' sets are valid */
+static int                       ptlrpcd_pool_ready;
+/** held for read by a stealing thread, for write to change pool_ready */
+static cfs_rwlock_t              ptlrpcd_pool_lock;
+
 cfs_semaphore_t ptlrpcd_sem;
 static int ptlrpcd_users = 0;
 
@@ -119,6 +155,17 @@ void ptlrpcd_wake(struct ptlrpc_request *req)
         cfs_waitq_signal(&rq_set->set_waitq);
 }
 
+/**
+ * Pick the pool thread for a request submitted on the current CPU.
+ */
+static struct ptlrpcd_ctl *ptlrpcd_select(void)
+{
+        struct ptlrpcd_pool_part *ppp;
+
+        ppp = &ptlrpcd_pool_parts[cfs_cpt_current()];
+        return &ppp->ppp_threads[ppp->ppp_cursor++ % ppp->ppp_nthreads];
+}
+
 /**
  * Move all request from an existing request set to the ptlrpcd queue.
  * All requests from the set must be in phase RQ_PHASE_NEW.
@@ -179,7 +226,10 @@ int ptlrpcd_add_req(struct ptlrpc_request *req, enum ptlrpcd_scope scope)
         }
 
         pt = req->rq_send_state == LUSTRE_IMP_FULL ? PT_NORMAL : PT_RECOVERY;
-        pc = &ptlrpcd_scopes[scope].pscope_thread[pt].pt_ctl;
+        if (ptlrpcd_scopes[scope].pscope_thread[pt].pt_name == NULL)
+                pc = ptlrpcd_select();
+        else
+                pc = &ptlrpcd_scopes[scope].pscope_thread[pt].pt_ctl;
         rc = ptlrpc_set_add_new_req(pc, req);
         /*
          * XXX disable this for CLIO: environment is needed for interpreter.
@@ -207,6 +257,60 @@ int ptlrpcd_add_req(struct ptlrpc_request *req, enum ptlrpcd_scope scope)
         return rc;
 }
 
+/**
+ * Called by pool thread \a pc when it has nothing to do: move the new
+ * requests of the first partner that has any into the set of \a pc, so a
+ * burst submitted from one CPU does not wait behind a single busy thread.
+ * Returns the number of requests stolen.
+ */
+static int ptlrpcd_steal(struct ptlrpcd_ctl *pc)
+{
+        struct ptlrpc_request_set *ps;
+        struct ptlrpc_request     *req;
+        cfs_list_t                *pos, *tmp;
+        int                        rc = 0;
+        int                        i;
+
+        if (!ptlrpcd_pool_ready)
+                return 0;
+
+        /* ptlrpcd_fini() clears pool_ready under the write lock before it
+         * stops any thread, so the partners' sets stay valid until we are
+         * done; a thread being stopped does not take more work */
+        cfs_read_lock(&ptlrpcd_pool_lock);
+        if (!ptlrpcd_pool_ready || cfs_test_bit(LIOD_STOP, &pc->pc_flags)) {
+                cfs_read_unlock(&ptlrpcd_pool_lock);
+                return 0;
+        }
+
+        for (i = 0; i < pc->pc_npartners && rc == 0; i++) {
+                ps = pc->pc_partners[pc->pc_cursor].pc_set;
+                if (++pc->pc_cursor == pc->pc_npartners)
+                        pc->pc_cursor = 0;
+
+                /* unlocked peek, a missed request is found next time */
+                if (ps == pc->pc_set || cfs_list_empty(&ps->set_new_requests))
+                        continue;
+
+                cfs_spin_lock(&ps->set_new_req_lock);
+                cfs_list_for_each_safe(pos, tmp, &ps->set_new_requests) {
+                        req = cfs_list_entry(pos, struct ptlrpc_request,
+                                             rq_set_chain);
+                        cfs_list_del_init(&req->rq_set_chain);
+                        ptlrpc_set_add_req(pc->pc_set, req);
+                        rc++;
+                }
+                cfs_spin_unlock(&ps->set_new_req_lock);
+        }
+        cfs_read_unlock(&ptlrpcd_pool_lock);
+
+        if (rc > 0) {
+                CDEBUG(D_RPCTRACE, "%s: stole %d requests\n", pc->pc_name, rc);
+                pc->pc_nr_stolen += rc;
+        }
+        return rc;
+}
+
 /**
  * Check if there is more work to do on ptlrpcd set.
  * Returns 1 if yes.
@@ -246,6 +350,7 @@ static int ptlrpcd_check(const struct lu_env *env, struct ptlrpcd_ctl *pc)
                         cfs_list_del_init(&req->rq_set_chain);
                         req->rq_set = NULL;
                         ptlrpc_req_finished (req);
+                        pc->pc_nr_completed++;
                 }
         }
 
@@ -258,6 +363,9 @@ static int ptlrpcd_check(const struct lu_env *env, struct ptlrpcd_ctl *pc)
                 cfs_spin_unlock(&pc->pc_set->set_new_req_lock);
         }
 
+        if (rc == 0 && pc->pc_npartners > 1)
+                rc = ptlrpcd_steal(pc);
+
         RETURN(rc);
 }
 
@@ -276,6 +384,13 @@ static int ptlrpcd(void *arg)
         ENTRY;
 
         rc = cfs_daemonize_ctxt(pc->pc_name);
+        if (rc == 0 && cfs_test_bit(LIOD_BIND, &pc->pc_flags)) {
+                rc = cfs_cpt_bind(pc->pc_cpt);
+                if (rc != 0)
+                        CWARN("%s: failed to bind on CPT %d: rc = %d\n",
+                              pc->pc_name, pc->pc_cpt, rc);
+                rc = 0;
+        }
         if (rc == 0) {
                 /*
                  * XXX So far only "client" ptlrpcd uses an environment. In
@@ -421,6 +536,9 @@ int ptlrpcd_start(const char *name, struct ptlrpcd_ctl *pc)
         cfs_init_completion(&pc->pc_finishing);
         cfs_spin_lock_init(&pc->pc_lock);
         strncpy(pc->pc_name, name, sizeof(pc->pc_name) - 1);
+        pc->pc_nr_queued = 0;
+        pc->pc_nr_stolen = 0;
+        pc->pc_nr_completed = 0;
         pc->pc_set = ptlrpc_prep_set();
         if (pc->pc_set == NULL)
                 GOTO(out, rc = -ENOMEM);
@@ -432,6 +550,7 @@ int ptlrpcd_start(const char *name, struct ptlrpcd_ctl *pc)
         rc = lu_context_init(&pc->pc_env.le_ctx, LCT_CL_THREAD|LCT_REMEMBER);
         if (rc != 0) {
                 ptlrpc_set_destroy(pc->pc_set);
+                pc->pc_set = NULL;
                 GOTO(out, rc);
         }
 
@@ -440,6 +559,7 @@ int ptlrpcd_start(const char *name, struct ptlrpcd_ctl *pc)
         if (rc < 0)  {
                 lu_context_fini(&pc->pc_env.le_ctx);
                 ptlrpc_set_destroy(pc->pc_set);
+                pc->pc_set = NULL;
                 GOTO(out, rc);
         }
         rc = 0;
@@ -458,17 +578,18 @@ out:
         RETURN(rc);
 }
 
-void ptlrpcd_stop(struct ptlrpcd_ctl *pc, int force)
+/* ask the thread of \a pc to stop, without waiting for it */
+static void ptlrpcd_stop_begin(struct ptlrpcd_ctl *pc, int force)
 {
-        if (!cfs_test_bit(LIOD_START, &pc->pc_flags)) {
-                CERROR("Thread for pc %p was not started\n", pc);
-                return;
-        }
-
         cfs_set_bit(LIOD_STOP, &pc->pc_flags);
         if (force)
                 cfs_set_bit(LIOD_FORCE, &pc->pc_flags);
         cfs_waitq_signal(&pc->pc_set->set_waitq);
+}
+
+/* wait for the thread of \a pc to exit and free its set */
+static void ptlrpcd_stop_end(struct ptlrpcd_ctl *pc)
+{
 #ifdef __KERNEL__
         cfs_wait_for_completion(&pc->pc_finishing);
 #else
@@ -477,6 +598,18 @@ void ptlrpcd_stop(struct ptlrpcd_ctl *pc, int force)
 #endif
         lu_context_fini(&pc->pc_env.le_ctx);
         ptlrpc_set_destroy(pc->pc_set);
+        pc->pc_set = NULL;
+}
+
+void ptlrpcd_stop(struct ptlrpcd_ctl *pc, int force)
+{
+        if (!cfs_test_bit(LIOD_START, &pc->pc_flags)) {
+                CERROR("Thread for pc %p was not started\n", pc);
+                return;
+        }
+
+        ptlrpcd_stop_begin(pc, force);
+        ptlrpcd_stop_end(pc);
 }
 
 void ptlrpcd_fini(void)
@@ -496,6 +629,22 @@ void ptlrpcd_fini(void)
                                 ptlrpcd_stop(pc, 0);
                 }
         }
+
+        /*
+         * Pool threads may be stealing from each other's sets until they
+         * have all exited, so stop them all before freeing any set.
+         */
+        cfs_write_lock(&ptlrpcd_pool_lock);
+        ptlrpcd_pool_ready = 0;
+        cfs_write_unlock(&ptlrpcd_pool_lock);
+        for (i = 0; i < ptlrpcd_pool_size; i++) {
+                if (ptlrpcd_pool[i].pc_set != NULL)
+                        ptlrpcd_stop_begin(&ptlrpcd_pool[i], 0);
+        }
+        for (i = 0; i < ptlrpcd_pool_size; i++) {
+                if (ptlrpcd_pool[i].pc_set != NULL)
+                        ptlrpcd_stop_end(&ptlrpcd_pool[i]);
+        }
         EXIT;
 }
 
@@ -515,11 +664,24 @@ int ptlrpcd_addref(void)
 
                                 pt = &ptlrpcd_scopes[i].pscope_thread[j];
                                 pc = &pt->pt_ctl;
+                                if (pt->pt_name == NULL)
+                                        continue;
                                 if (j == PT_RECOVERY)
                                         cfs_set_bit(LIOD_RECOVERY, &pc->pc_flags);
                                 rc = ptlrpcd_start(pt->pt_name, pc);
                         }
                 }
+                for (i = 0; rc == 0 && i < ptlrpcd_pool_size; i++) {
+                        char name[16];
+
+                        snprintf(name, sizeof(name), "ptlrpcd-brw_%02d", i);
+                        rc = ptlrpcd_start(name, &ptlrpcd_pool[i]);
+                }
+                if (rc == 0) {
+                        cfs_write_lock(&ptlrpcd_pool_lock);
+                        ptlrpcd_pool_ready = 1;
+                        cfs_write_unlock(&ptlrpcd_pool_lock);
+                }
                 if (rc != 0) {
                         --ptlrpcd_users;
                         ptlrpcd_fini();
@@ -536,4 +698,164 @@ void ptlrpcd_decref(void)
                 ptlrpcd_fini();
         cfs_mutex_up(&ptlrpcd_sem);
 }
+#ifdef LPROCFS
+static void *ptlrpcd_seq_start(struct seq_file *p, loff_t *pos)
+{
+        if (*pos == 0)
+                return SEQ_START_TOKEN;
+        if (*pos > ptlrpcd_pool_size)
+                return NULL;
+        return &ptlrpcd_pool[*pos - 1];
+}
+
+static void *ptlrpcd_seq_next(struct seq_file *p, void *v, loff_t *pos)
+{
+        ++*pos;
+        return ptlrpcd_seq_start(p, pos);
+}
+
+static void ptlrpcd_seq_stop(struct seq_file *p, void *v)
+{
+}
+
+/*
+ * One line per pool thread; inflight counts the requests in its set,
+ * stolen the requests it took over from its partners.
+ */
+static int ptlrpcd_seq_show(struct seq_file *p, void *v)
+{
+        struct ptlrpcd_ctl        *pc = v;
+        struct ptlrpc_request_set *set;
+
+        if (v == SEQ_START_TOKEN) {
+                seq_printf(p, "%-16s %-4s %-10s %-10s %-10s %s\n",
+                           "thread", "cpt", "queued", "stolen", "completed",
+                           "inflight");
+                return 0;
+        }
+
+        /* the set is only valid while ptlrpcd has users */
+        cfs_mutex_down(&ptlrpcd_sem);
+        set = pc->pc_set;
+        seq_printf(p, "%-16s %-4d %-10lu %-10lu %-10lu %d\n",
+                   set != NULL ? pc->pc_name : "-", pc->pc_cpt,
+                   pc->pc_nr_queued, pc->pc_nr_stolen, pc->pc_nr_completed,
+                   set != NULL ? cfs_atomic_read(&set->set_remaining) : 0);
+        cfs_mutex_up(&ptlrpcd_sem);
+        return 0;
+}
+
+static struct seq_operations ptlrpcd_seq_sops = {
+        .start = ptlrpcd_seq_start,
+        .stop  = ptlrpcd_seq_stop,
+        .next  = ptlrpcd_seq_next,
+        .show  = ptlrpcd_seq_show,
+};
+
+static int ptlrpcd_seq_open(struct inode *inode, struct file *file)
+{
+        struct proc_dir_entry *dp = PDE(inode);
+        int rc;
+
+        if (LPROCFS_ENTRY_AND_CHECK(dp))
+                return -ENOENT;
+
+        rc = seq_open(file, &ptlrpcd_seq_sops);
+        if (rc)
+                LPROCFS_EXIT();
+        return rc;
+}
+
+static struct file_operations ptlrpcd_seq_fops = {
+        .owner   = THIS_MODULE,
+        .open    = ptlrpcd_seq_open,
+        .read    = seq_read,
+        .llseek  = seq_lseek,
+        .release = lprocfs_seq_release,
+};
+#endif /* LPROCFS */
+
+static int ptlrpcd_part_nthreads(int cpt)
+{
+        if (ptlrpcd_per_cpt > 0)
+                return ptlrpcd_per_cpt;
+#ifdef __KERNEL__
+        return max(cfs_cpt_weight(cpt), 1);
+#else
+        /* liblustre polls every thread from the application anyway */
+        return 1;
+#endif
+}
+
+/**
+ * Lay out the ptlrpcd-brw pool over the CPU partitions, called once when
+ * ptlrpc is loaded; the threads are started by ptlrpcd_addref().
+ */
+int ptlrpcd_pool_init(void)
+{
+        struct ptlrpcd_pool_part *ppp;
+        struct ptlrpcd_ctl       *pc;
+        int                       i;
+        int                       j;
+        ENTRY;
+
+        cfs_rwlock_init(&ptlrpcd_pool_lock);
+        OBD_ALLOC(ptlrpcd_pool_parts,
+                  cfs_cpt_number() * sizeof(*ptlrpcd_pool_parts));
+        if (ptlrpcd_pool_parts == NULL)
+                RETURN(-ENOMEM);
+
+        ptlrpcd_pool_size = 0;
+        cfs_cpt_for_each(i) {
+                ptlrpcd_pool_parts[i].ppp_nthreads = ptlrpcd_part_nthreads(i);
+                ptlrpcd_pool_size += ptlrpcd_pool_parts[i].ppp_nthreads;
+        }
+
+        OBD_ALLOC(ptlrpcd_pool, ptlrpcd_pool_size * sizeof(*ptlrpcd_pool));
+        if (ptlrpcd_pool == NULL) {
+                OBD_FREE(ptlrpcd_pool_parts,
+                         cfs_cpt_number() * sizeof(*ptlrpcd_pool_parts));
+                ptlrpcd_pool_parts = NULL;
+                ptlrpcd_pool_size = 0;
+                RETURN(-ENOMEM);
+        }
+
+        pc = ptlrpcd_pool;
+        cfs_cpt_for_each(i) {
+                ppp = &ptlrpcd_pool_parts[i];
+                ppp->ppp_threads = pc;
+                for (j = 0; j < ppp->ppp_nthreads; j++, pc++) {
+                        pc->pc_cpt = i;
+                        pc->pc_partners = ppp->ppp_threads;
+                        pc->pc_npartners = ppp->ppp_nthreads;
+                        pc->pc_cursor = (j + 1) % ppp->ppp_nthreads;
+                        if (ptlrpcd_bind_cpt)
+                                cfs_set_bit(LIOD_BIND, &pc->pc_flags);
+                }
+        }
+
+#ifdef LPROCFS
+        lprocfs_seq_create(proc_lustre_root, "ptlrpcd", 0444,
+                           &ptlrpcd_seq_fops, NULL);
+#endif
+        CDEBUG(D_RPCTRACE, "%d ptlrpcd-brw threads on %d CPU partitions\n",
+               ptlrpcd_pool_size, cfs_cpt_number());
+        RETURN(0);
+}
+
+void ptlrpcd_pool_fini(void)
+{
+        LASSERT(ptlrpcd_users == 0);
+
+        lprocfs_remove_proc_entry("ptlrpcd", proc_lustre_root);
+        if (ptlrpcd_pool != NULL)
+                OBD_FREE(ptlrpcd_pool,
+                         ptlrpcd_pool_size * sizeof(*ptlrpcd_pool));
+        if (ptlrpcd_pool_parts != NULL)
+                OBD_FREE(ptlrpcd_pool_parts,
+                         cfs_cpt_number() * sizeof(*ptlrpcd_pool_parts));
+        ptlrpcd_pool = NULL;
+        ptlrpcd_pool_parts = NULL;
+        ptlrpcd_pool_size = 0;
+}
 /** @} ptlrpcd */
@@ -63,20 +63,20 @@ CFS_MODULE_PARM(at_extra, "i", int, 0644,
 
 
 /* forward ref */
-static int ptlrpc_server_post_idle_rqbds (struct ptlrpc_service *svc);
+static int ptlrpc_server_post_idle_rqbds(struct ptlrpc_service_part *svcpt);
 
 static CFS_LIST_HEAD(ptlrpc_all_services);
 cfs_spinlock_t ptlrpc_all_services_lock;
 
 static char *
-ptlrpc_alloc_request_buffer (int size)
+ptlrpc_alloc_request_buffer(int cpt, int size)
 {
         char *ptr;
 
         if (size > SVC_BUF_VMALLOC_THRESHOLD)
-                OBD_VMALLOC(ptr, size);
+                OBD_CPT_VMALLOC(ptr, cpt, size);
         else
-                OBD_ALLOC(ptr, size);
+                OBD_CPT_ALLOC(ptr, cpt, size);
 
         return (ptr);
 }
@@ -91,30 +91,33 @@ ptlrpc_free_request_buffer (char *ptr, int size)
 }
 
 struct ptlrpc_request_buffer_desc *
-ptlrpc_alloc_rqbd (struct ptlrpc_service *svc)
+ptlrpc_alloc_rqbd(struct ptlrpc_service_part *svcpt)
 {
+        struct ptlrpc_service             *svc = svcpt->scp_service;
         struct ptlrpc_request_buffer_desc *rqbd;
 
-        OBD_ALLOC_PTR(rqbd);
+        OBD_CPT_ALLOC_PTR(rqbd, svcpt->scp_cpt);
         if (rqbd == NULL)
                 return (NULL);
 
         rqbd->rqbd_service = svc;
+        rqbd->rqbd_svcpt = svcpt;
         rqbd->rqbd_refcount = 0;
         rqbd->rqbd_cbid.cbid_fn = request_in_callback;
         rqbd->rqbd_cbid.cbid_arg = rqbd;
         CFS_INIT_LIST_HEAD(&rqbd->rqbd_reqs);
-        rqbd->rqbd_buffer = ptlrpc_alloc_request_buffer(svc->srv_buf_size);
+        rqbd->rqbd_buffer = ptlrpc_alloc_request_buffer(svcpt->scp_cpt,
+                                                        svc->srv_buf_size);
 
         if (rqbd->rqbd_buffer == NULL) {
                 OBD_FREE_PTR(rqbd);
                 return (NULL);
         }
 
-        cfs_spin_lock(&svc->srv_lock);
-        cfs_list_add(&rqbd->rqbd_list, &svc->srv_idle_rqbds);
-        svc->srv_nbufs++;
-        cfs_spin_unlock(&svc->srv_lock);
+        cfs_spin_lock(&svcpt->scp_lock);
+        cfs_list_add(&rqbd->rqbd_list, &svcpt->scp_idle_rqbds);
+        svcpt->scp_nbufs++;
+        cfs_spin_unlock(&svcpt->scp_lock);
 
         return (rqbd);
 }
@@ -122,31 +125,34 @@ ptlrpc_alloc_rqbd (struct ptlrpc_service *svc)
 void
 ptlrpc_free_rqbd (struct ptlrpc_request_buffer_desc *rqbd)
 {
-        struct ptlrpc_service *svc = rqbd->rqbd_service;
+        struct ptlrpc_service_part *svcpt = rqbd->rqbd_svcpt;
 
         LASSERT (rqbd->rqbd_refcount == 0);
         LASSERT (cfs_list_empty(&rqbd->rqbd_reqs));
 
-        cfs_spin_lock(&svc->srv_lock);
+        cfs_spin_lock(&svcpt->scp_lock);
         cfs_list_del(&rqbd->rqbd_list);
-        svc->srv_nbufs--;
-        cfs_spin_unlock(&svc->srv_lock);
+        svcpt->scp_nbufs--;
+        cfs_spin_unlock(&svcpt->scp_lock);
 
-        ptlrpc_free_request_buffer (rqbd->rqbd_buffer, svc->srv_buf_size);
+        ptlrpc_free_request_buffer(rqbd->rqbd_buffer,
+                                   svcpt->scp_service->srv_buf_size);
         OBD_FREE_PTR(rqbd);
 }
 
 int
-ptlrpc_grow_req_bufs(struct ptlrpc_service *svc)
+ptlrpc_grow_req_bufs(struct ptlrpc_service_part *svcpt)
 {
+        struct ptlrpc_service             *svc = svcpt->scp_service;
         struct ptlrpc_request_buffer_desc *rqbd;
         int                                i;
 
-        CDEBUG(D_RPCTRACE, "%s: allocate %d new %d-byte reqbufs (%d/%d left)\n",
-               svc->srv_name, svc->srv_nbuf_per_group, svc->srv_buf_size,
-               svc->srv_nrqbd_receiving, svc->srv_nbufs);
+        CDEBUG(D_RPCTRACE, "%s[%d]: allocate %d new %d-byte reqbufs "
+               "(%d/%d left)\n", svc->srv_name, svcpt->scp_index,
+               svc->srv_nbuf_per_group, svc->srv_buf_size,
+               svcpt->scp_nrqbd_receiving, svcpt->scp_nbufs);
         for (i = 0; i < svc->srv_nbuf_per_group; i++) {
-                rqbd = ptlrpc_alloc_rqbd(svc);
+                rqbd = ptlrpc_alloc_rqbd(svcpt);
 
                 if (rqbd == NULL) {
                         CERROR ("%s: Can't allocate request buffer\n",
@@ -154,7 +160,7 @@ ptlrpc_grow_req_bufs(struct ptlrpc_service *svc)
                         return (-ENOMEM);
                 }
 
-                if (ptlrpc_server_post_idle_rqbds(svc) < 0)
+                if (ptlrpc_server_post_idle_rqbds(svcpt) < 0)
                         return (-EAGAIN);
         }
 
@@ -401,30 +407,30 @@ void ptlrpc_commit_replies(struct obd_export *exp)
 }
 
 static int
-ptlrpc_server_post_idle_rqbds (struct ptlrpc_service *svc)
+ptlrpc_server_post_idle_rqbds(struct ptlrpc_service_part *svcpt)
 {
         struct ptlrpc_request_buffer_desc *rqbd;
         int                                rc;
         int                                posted = 0;
 
         for (;;) {
-                cfs_spin_lock(&svc->srv_lock);
+                cfs_spin_lock(&svcpt->scp_lock);
 
-                if (cfs_list_empty (&svc->srv_idle_rqbds)) {
-                        cfs_spin_unlock(&svc->srv_lock);
+                if (cfs_list_empty(&svcpt->scp_idle_rqbds)) {
+                        cfs_spin_unlock(&svcpt->scp_lock);
                         return (posted);
                 }
 
-                rqbd = cfs_list_entry(svc->srv_idle_rqbds.next,
+                rqbd = cfs_list_entry(svcpt->scp_idle_rqbds.next,
                                       struct ptlrpc_request_buffer_desc,
                                       rqbd_list);
                 cfs_list_del (&rqbd->rqbd_list);
 
                 /* assume we will post successfully */
-                svc->srv_nrqbd_receiving++;
-                cfs_list_add (&rqbd->rqbd_list, &svc->srv_active_rqbds);
+                svcpt->scp_nrqbd_receiving++;
+                cfs_list_add(&rqbd->rqbd_list, &svcpt->scp_active_rqbds);
 
-                cfs_spin_unlock(&svc->srv_lock);
+                cfs_spin_unlock(&svcpt->scp_lock);
 
                 rc = ptlrpc_register_rqbd(rqbd);
                 if (rc != 0)
@@ -433,16 +439,16 @@ ptlrpc_server_post_idle_rqbds (struct ptlrpc_service *svc)
                 posted = 1;
         }
 
-        cfs_spin_lock(&svc->srv_lock);
+        cfs_spin_lock(&svcpt->scp_lock);
 
-        svc->srv_nrqbd_receiving--;
+        svcpt->scp_nrqbd_receiving--;
         cfs_list_del(&rqbd->rqbd_list);
-        cfs_list_add_tail(&rqbd->rqbd_list, &svc->srv_idle_rqbds);
+        cfs_list_add_tail(&rqbd->rqbd_list, &svcpt->scp_idle_rqbds);
 
         /* Don't complain if no request buffers are posted right now; LNET
          * won't drop requests because we set the portal lazy! */
 
-        cfs_spin_unlock(&svc->srv_lock);
+        cfs_spin_unlock(&svcpt->scp_lock);
 
         return (-1);
 }
@@ -463,16 +469,54 @@ struct ptlrpc_service *ptlrpc_init_svc_conf(struct ptlrpc_service_conf *c,
                                c->psc_watchdog_factor,
                                h, name, proc_entry,
                                prntfn, c->psc_min_threads, c->psc_max_threads,
-                               threadname, c->psc_ctx_tags, NULL);
+                               threadname, c->psc_ctx_tags, NULL,
+                               c->psc_cpt_mode);
 }
 EXPORT_SYMBOL(ptlrpc_init_svc_conf);
 
 static void ptlrpc_at_timer(unsigned long castmeharder)
 {
-        struct ptlrpc_service *svc = (struct ptlrpc_service *)castmeharder;
+        struct ptlrpc_service      *svc = (struct ptlrpc_service *)castmeharder;
+        struct ptlrpc_service_part *svcpt;
+        int                         i;
+
         svc->srv_at_check = 1;
         svc->srv_at_checktime = cfs_time_current();
-        cfs_waitq_signal(&svc->srv_waitq);
+        /* any thread of any part can send the early replies */
+        ptlrpc_service_for_each_part(svcpt, i, svc)
+                cfs_waitq_signal(&svcpt->scp_waitq);
+}
+
+/**
+ * Initialize part \a index of service \a svc, bound to CPU partition \a cpt.
+ */
+static int ptlrpc_service_part_init(struct ptlrpc_service *svc,
+                                    struct ptlrpc_service_part *svcpt,
+                                    int index, int cpt)
+{
+        svcpt->scp_service = svc;
+        svcpt->scp_index = index;
+        svcpt->scp_cpt = cpt;
+
+        cfs_spin_lock_init(&svcpt->scp_lock);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_threads);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_req_in_queue);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_idle_rqbds);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_active_rqbds);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_history_rqbds);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_request_history);
+        /* valid seq #s start at 1 */
+        svcpt->scp_request_seq = 1;
+        svcpt->scp_request_max_cull_seq = 0;
+        cfs_waitq_init(&svcpt->scp_waitq);
+
+        cfs_spin_lock_init(&svcpt->scp_rq_lock);
+        CFS_INIT_LIST_HEAD(&svcpt->scp_request_hpq);
+        svcpt->scp_hpreq_count = 0;
+        svcpt->scp_n_active_hpreq = 0;
+        ptlrpc_tbf_part_init(svcpt);
+
+        return ptlrpc_nrs_init(svcpt);
 }
 
 /**
@@ -491,8 +535,13 @@ static void ptlrpc_at_timer(unsigned long castmeharder)
  * \a proc_entry - entry in the /proc tree for sttistics reporting
  * \a min_threads \a max_threads - min/max number of service threads to start.
  * \a threadname should be 11 characters or less - 3 will be added on
+ *               (6 for a partitioned service)
  * \a hp_handler - function to determine priority of the request, also called
  *                 on every new request.
+ * \a cpt_mode - PTLRPC_SVC_CPT_PART to give each libcfs CPU partition its
+ *               own request buffers, queues and threads, or
+ *               PTLRPC_SVC_CPT_NONE. \a nbufs and thread limits are then
+ *               shared between the partitions.
  */
 struct ptlrpc_service *
 ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
@@ -502,17 +551,24 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
                 svc_req_printfn_t svcreq_printfn,
                 int min_threads, int max_threads,
                 char *threadname, __u32 ctx_tags,
-                svc_hpreq_handler_t hp_handler)
-{
-        int                     rc;
-        struct ptlrpc_at_array *array;
-        struct ptlrpc_service  *service;
-        unsigned int            size, index;
+                svc_hpreq_handler_t hp_handler, int cpt_mode)
+{
+        int                         rc;
+        struct ptlrpc_at_array     *array;
+        struct ptlrpc_service      *service;
+        struct ptlrpc_service_part *svcpt;
+        unsigned int                size, index;
+        int                         nparts;
+        int                         i;
         ENTRY;
 
         LASSERT (nbufs > 0);
         LASSERT (bufsize >= max_req_size + SPTLRPC_MAX_PAYLOAD);
         LASSERT (ctx_tags != 0);
+        LASSERT (cpt_mode == PTLRPC_SVC_CPT_NONE ||
+                 cpt_mode == PTLRPC_SVC_CPT_PART);
+
+        nparts = cpt_mode == PTLRPC_SVC_CPT_PART ? cfs_cpt_number() : 1;
 
         OBD_ALLOC_PTR(service);
         if (service == NULL)
@@ -522,11 +578,45 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
 
         service->srv_name = name;
         cfs_spin_lock_init(&service->srv_lock);
-        cfs_spin_lock_init(&service->srv_rq_lock);
         cfs_spin_lock_init(&service->srv_rs_lock);
-        CFS_INIT_LIST_HEAD(&service->srv_threads);
-        cfs_waitq_init(&service->srv_waitq);
+        cfs_spin_lock_init(&service->srv_at_lock);
+        cfs_spin_lock_init(&service->srv_tbf_lock);
+        CFS_INIT_LIST_HEAD(&service->srv_tbf_rules);
 
+        service->srv_cpt_mode = cpt_mode;
+        service->srv_nparts = nparts;
+        while ((1 << service->srv_cpt_bits) < nparts)
+                service->srv_cpt_bits++;
+
+        OBD_ALLOC(service->srv_parts, nparts * sizeof(service->srv_parts[0]));
+        if (service->srv_parts == NULL) {
+                OBD_FREE_PTR(service);
+                RETURN(NULL);
+        }
+
+        for (i = 0; i < nparts; i++) {
+                int cpt = cpt_mode == PTLRPC_SVC_CPT_PART ? i : CFS_CPT_ANY;
+
+                OBD_CPT_ALLOC_PTR(svcpt, cpt);
+                if (svcpt != NULL &&
+                    ptlrpc_service_part_init(service, svcpt, i, cpt) != 0) {
+                        OBD_FREE_PTR(svcpt);
+                        svcpt = NULL;
+                }
+                if (svcpt == NULL) {
+                        while (--i >= 0) {
+                                ptlrpc_nrs_fini(service->srv_parts[i]);
+                                OBD_FREE_PTR(service->srv_parts[i]);
+                        }
+                        OBD_FREE(service->srv_parts,
+                                 nparts * sizeof(service->srv_parts[0]));
+                        OBD_FREE_PTR(service);
+                        RETURN(NULL);
+                }
+                service->srv_parts[i] = svcpt;
+        }
+
+        nbufs = (nbufs + nparts - 1) / nparts;
         service->srv_nbuf_per_group = test_req_buffer_pressure ? 1 : nbufs;
         service->srv_max_req_size = max_req_size + SPTLRPC_MAX_PAYLOAD;
         service->srv_buf_size = bufsize;
@@ -535,26 +625,16 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
         service->srv_watchdog_factor = watchdog_factor;
         service->srv_handler = handler;
         service->srv_req_printfn = svcreq_printfn;
-        service->srv_request_seq = 1;           /* valid seq #s start at 1 */
-        service->srv_request_max_cull_seq = 0;
         service->srv_threads_min = min_threads;
         service->srv_threads_max = max_threads;
         service->srv_thread_name = threadname;
         service->srv_ctx_tags = ctx_tags;
         service->srv_hpreq_handler = hp_handler;
         service->srv_hpreq_ratio = PTLRPC_SVC_HP_RATIO;
-        service->srv_hpreq_count = 0;
-        service->srv_n_active_hpreq = 0;
 
         rc = LNetSetLazyPortal(service->srv_req_portal);
         LASSERT (rc == 0);
 
-        CFS_INIT_LIST_HEAD(&service->srv_request_queue);
-        CFS_INIT_LIST_HEAD(&service->srv_request_hpq);
-        CFS_INIT_LIST_HEAD(&service->srv_idle_rqbds);
-        CFS_INIT_LIST_HEAD(&service->srv_active_rqbds);
-        CFS_INIT_LIST_HEAD(&service->srv_history_rqbds);
-        CFS_INIT_LIST_HEAD(&service->srv_request_history);
         CFS_INIT_LIST_HEAD(&service->srv_active_replies);
 #ifndef __KERNEL__
         CFS_INIT_LIST_HEAD(&service->srv_reply_queue);
@@ -563,9 +643,6 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
         cfs_waitq_init(&service->srv_free_rs_waitq);
         cfs_atomic_set(&service->srv_n_difficult_replies, 0);
 
-        cfs_spin_lock_init(&service->srv_at_lock);
-        CFS_INIT_LIST_HEAD(&service->srv_req_in_queue);
-
         array = &service->srv_at_array;
         size = at_est2timeout(at_max);
         array->paa_size = size;
@@ -594,11 +671,13 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
         cfs_spin_unlock (&ptlrpc_all_services_lock);
 
         /* Now allocate the request buffers */
-        rc = ptlrpc_grow_req_bufs(service);
-        /* We shouldn't be under memory pressure at startup, so
-         * fail if we can't post all our buffers at this time. */
-        if (rc != 0)
-                GOTO(failed, NULL);
+        ptlrpc_service_for_each_part(svcpt, i, service) {
+                rc = ptlrpc_grow_req_bufs(svcpt);
+                /* We shouldn't be under memory pressure at startup, so
+                 * fail if we can't post all our buffers at this time. */
+                if (rc != 0)
+                        GOTO(failed, NULL);
+        }
 
         /* Now allocate pool of reply buffers */
         /* Increase max reply size to next power of two */
@@ -610,8 +689,8 @@ ptlrpc_init_svc(int nbufs, int bufsize, int max_req_size, int max_reply_size,
         if (proc_entry != NULL)
                 ptlrpc_lprocfs_register_service(proc_entry, service);
 
-        CDEBUG(D_NET, "%s: Started, listening on portal %d\n",
-               service->srv_name, service->srv_req_portal);
+        CDEBUG(D_NET, "%s: Started, listening on portal %d, %d part(s)\n",
+               service->srv_name, service->srv_req_portal, nparts);
 
         RETURN(service);
 failed:
@@ -647,12 +726,11 @@ static void ptlrpc_server_free_request(struct ptlrpc_request *req)
  */
 void ptlrpc_server_active_request_inc(struct ptlrpc_request *req)
 {
-        struct ptlrpc_request_buffer_desc *rqbd = req->rq_rqbd;
-        struct ptlrpc_service *svc = rqbd->rqbd_service;
+        struct ptlrpc_service_part *svcpt = req->rq_rqbd->rqbd_svcpt;
 
-        cfs_spin_lock(&svc->srv_rq_lock);
-        svc->srv_n_active_reqs++;
-        cfs_spin_unlock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_lock(svcpt);
+        svcpt->scp_n_active_reqs++;
+        ptlrpc_svcpt_rq_unlock(svcpt);
 }
 
 /**
@@ -660,12 +738,11 @@ void ptlrpc_server_active_request_inc(struct ptlrpc_request *req)
  */
 void ptlrpc_server_active_request_dec(struct ptlrpc_request *req)
 {
-        struct ptlrpc_request_buffer_desc *rqbd = req->rq_rqbd;
-        struct ptlrpc_service *svc = rqbd->rqbd_service;
+        struct ptlrpc_service_part *svcpt = req->rq_rqbd->rqbd_svcpt;
 
-        cfs_spin_lock(&svc->srv_rq_lock);
-        svc->srv_n_active_reqs--;
-        cfs_spin_unlock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_lock(svcpt);
+        svcpt->scp_n_active_reqs--;
+        ptlrpc_svcpt_rq_unlock(svcpt);
 }
 
 /**
@@ -675,7 +752,9 @@ void ptlrpc_server_active_request_dec(struct ptlrpc_request *req)
 void ptlrpc_server_drop_request(struct ptlrpc_request *req)
 {
         struct ptlrpc_request_buffer_desc *rqbd = req->rq_rqbd;
+        struct ptlrpc_service_part        *svcpt = rqbd->rqbd_svcpt;
         struct ptlrpc_service             *svc = rqbd->rqbd_service;
+        int                                max_history;
         int                                refcount;
         cfs_list_t                        *tmp;
         cfs_list_t                        *nxt;
@@ -705,7 +784,11 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
                 req->rq_export = NULL;
         }
 
-        cfs_spin_lock(&svc->srv_lock);
+        /* history is kept per part, each part gets its share of it */
+        max_history = (svc->srv_max_history_rqbds + svc->srv_nparts - 1) /
+                      svc->srv_nparts;
+
+        ptlrpc_svcpt_lock(svcpt);
 
         cfs_list_add(&req->rq_list, &rqbd->rqbd_reqs);
 
@@ -713,33 +796,34 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
         if (refcount == 0) {
                 /* request buffer is now idle: add to history */
                 cfs_list_del(&rqbd->rqbd_list);
-                cfs_list_add_tail(&rqbd->rqbd_list, &svc->srv_history_rqbds);
-                svc->srv_n_history_rqbds++;
+                cfs_list_add_tail(&rqbd->rqbd_list,
+                                  &svcpt->scp_history_rqbds);
+                svcpt->scp_n_history_rqbds++;
 
                 /* cull some history?
                  * I expect only about 1 or 2 rqbds need to be recycled here */
-                while (svc->srv_n_history_rqbds > svc->srv_max_history_rqbds) {
-                        rqbd = cfs_list_entry(svc->srv_history_rqbds.next,
+                while (svcpt->scp_n_history_rqbds > max_history) {
+                        rqbd = cfs_list_entry(svcpt->scp_history_rqbds.next,
                                               struct ptlrpc_request_buffer_desc,
                                               rqbd_list);
 
                         cfs_list_del(&rqbd->rqbd_list);
-                        svc->srv_n_history_rqbds--;
+                        svcpt->scp_n_history_rqbds--;
 
                         /* remove rqbd's reqs from svc's req history while
-                         * I've got the service lock */
+                         * I've got the part lock */
                         cfs_list_for_each(tmp, &rqbd->rqbd_reqs) {
                                 req = cfs_list_entry(tmp, struct ptlrpc_request,
                                                      rq_list);
                                 /* Track the highest culled req seq */
                                 if (req->rq_history_seq >
-                                    svc->srv_request_max_cull_seq)
-                                        svc->srv_request_max_cull_seq =
+                                    svcpt->scp_request_max_cull_seq)
+                                        svcpt->scp_request_max_cull_seq =
                                                 req->rq_history_seq;
                                 cfs_list_del(&req->rq_history_list);
                         }
 
-                        cfs_spin_unlock(&svc->srv_lock);
+                        ptlrpc_svcpt_unlock(svcpt);
 
                         cfs_list_for_each_safe(tmp, nxt, &rqbd->rqbd_reqs) {
                                 req = cfs_list_entry(rqbd->rqbd_reqs.next,
@@ -749,7 +833,7 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
                                 ptlrpc_server_free_request(req);
                         }
 
-                        cfs_spin_lock(&svc->srv_lock);
+                        ptlrpc_svcpt_lock(svcpt);
                         /*
                          * now all reqs including the embedded req has been
                          * disposed, schedule request buffer for re-use.
@@ -757,19 +841,19 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
                         LASSERT(cfs_atomic_read(&rqbd->rqbd_req.rq_refcount) ==
                                 0);
                         cfs_list_add_tail(&rqbd->rqbd_list,
-                                          &svc->srv_idle_rqbds);
+                                          &svcpt->scp_idle_rqbds);
                 }
 
-                cfs_spin_unlock(&svc->srv_lock);
+                ptlrpc_svcpt_unlock(svcpt);
         } else if (req->rq_reply_state && req->rq_reply_state->rs_prealloc) {
                 /* If we are low on memory, we are not interested in history */
                 cfs_list_del(&req->rq_list);
                 cfs_list_del_init(&req->rq_history_list);
-                cfs_spin_unlock(&svc->srv_lock);
+                ptlrpc_svcpt_unlock(svcpt);
 
                 ptlrpc_server_free_request(req);
         } else {
-                cfs_spin_unlock(&svc->srv_lock);
+                ptlrpc_svcpt_unlock(svcpt);
         }
 }
 
@@ -777,14 +861,14 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
  * to finish a request: stop sending more early replies, and release
  * the request. should be called after we finished handling the request.
  */
-static void ptlrpc_server_finish_request(struct ptlrpc_service *svc,
+static void ptlrpc_server_finish_request(struct ptlrpc_service_part *svcpt,
                                          struct ptlrpc_request *req)
 {
-        cfs_spin_lock(&svc->srv_rq_lock);
-        svc->srv_n_active_reqs--;
+        ptlrpc_svcpt_rq_lock(svcpt);
+        svcpt->scp_n_active_reqs--;
         if (req->rq_hp)
-                svc->srv_n_active_hpreq--;
-        cfs_spin_unlock(&svc->srv_rq_lock);
+                svcpt->scp_n_active_hpreq--;
+        ptlrpc_svcpt_rq_unlock(svcpt);
 
         ptlrpc_server_drop_request(req);
 }
@@ -1205,11 +1289,21 @@ static int ptlrpc_at_check_timed(struct ptlrpc_service *svc)
         if (first < 0) {
                 /* We're already past request deadlines before we even get a
                    chance to send early replies */
+                struct ptlrpc_service_part *svcpt;
+                int                         queued = 0;
+                int                         active = 0;
+                int                         i;
+
+                ptlrpc_service_for_each_part(svcpt, i, svc) {
+                        queued += svcpt->scp_n_queued_reqs;
+                        active += svcpt->scp_n_active_reqs;
+                }
+
                 LCONSOLE_WARN("%s: This server is not able to keep up with "
                               "request traffic (cpu-bound).\n", svc->srv_name);
                 CWARN("earlyQ=%d reqQ=%d recA=%d, svcEst=%d, "
                       "delay="CFS_DURATION_T"(jiff)\n",
-                      counter, svc->srv_n_queued_reqs, svc->srv_n_active_reqs,
+                      counter, queued, active,
                       at_get(&svc->srv_at_estimate), delay);
         }
 
@@ -1270,23 +1364,28 @@ static void ptlrpc_hpreq_fini(struct ptlrpc_request *req)
  * Make the request a high priority one.
  *
  * All the high priority requests are queued in a separate FIFO
- * ptlrpc_service::srv_request_hpq list which is parallel to
- * ptlrpc_service::srv_request_queue list but has a higher priority
+ * ptlrpc_service_part::scp_request_hpq list which is parallel to
+ * the ptlrpc_service_part::scp_nrs queue but has a higher priority
  * for handling.
  *
  * \see ptlrpc_server_handle_request().
  */
-static void ptlrpc_hpreq_reorder_nolock(struct ptlrpc_service *svc,
+static void ptlrpc_hpreq_reorder_nolock(struct ptlrpc_service_part *svcpt,
                                         struct ptlrpc_request *req)
 {
         ENTRY;
-        LASSERT(svc != NULL);
+        LASSERT(svcpt != NULL);
         cfs_spin_lock(&req->rq_lock);
         if (req->rq_hp == 0) {
                 int opc = lustre_msg_get_opc(req->rq_reqmsg);
 
-                /* Add to the high priority queue. */
-                cfs_list_move_tail(&req->rq_list, &svc->srv_request_hpq);
+                /* Take it from the NRS policy or TBF, if it's queued
+                 * there already, and add to the high priority queue. */
+                if (req->rq_nrs.nr_enqueued)
+                        ptlrpc_nrs_dequeue(svcpt, req, 0);
+                else if (req->rq_tbf_rule != NULL)
+                        ptlrpc_tbf_undefer(svcpt, req);
+                cfs_list_move_tail(&req->rq_list, &svcpt->scp_request_hpq);
                 req->rq_hp = 1;
                 if (opc != OBD_PING)
                         DEBUG_REQ(D_NET, req, "high priority req");
@@ -1300,15 +1399,15 @@ static void ptlrpc_hpreq_reorder_nolock(struct ptlrpc_service *svc,
  */
 void ptlrpc_hpreq_reorder(struct ptlrpc_request *req)
 {
-        struct ptlrpc_service *svc = req->rq_rqbd->rqbd_service;
+        struct ptlrpc_service_part *svcpt = req->rq_rqbd->rqbd_svcpt;
         ENTRY;
 
-        cfs_spin_lock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_lock(svcpt);
         /* It may happen that the request is already taken for the processing
          * but still in the export list, do not re-add it into the HP list. */
         if (req->rq_phase == RQ_PHASE_NEW)
-                ptlrpc_hpreq_reorder_nolock(svc, req);
-        cfs_spin_unlock(&svc->srv_rq_lock);
+                ptlrpc_hpreq_reorder_nolock(svcpt, req);
+        ptlrpc_svcpt_rq_unlock(svcpt);
         EXIT;
 }
 
@@ -1330,7 +1429,7 @@ static int ptlrpc_server_hpreq_check(struct ptlrpc_request *req)
 }
 
 /** Check if a request is a high priority one. */
-static int ptlrpc_server_request_add(struct ptlrpc_service *svc,
+static int ptlrpc_server_request_add(struct ptlrpc_service_part *svcpt,
                                      struct ptlrpc_request *req)
 {
         int rc;
@@ -1340,43 +1439,44 @@ static int ptlrpc_server_request_add(struct ptlrpc_service *svc,
         if (rc < 0)
                 RETURN(rc);
 
-        cfs_spin_lock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_lock(svcpt);
         /* Before inserting the request into the queue, check if it is not
          * inserted yet, or even already handled -- it may happen due to
          * a racing ldlm_server_blocking_ast(). */
         if (req->rq_phase == RQ_PHASE_NEW && cfs_list_empty(&req->rq_list)) {
                 if (rc)
-                        ptlrpc_hpreq_reorder_nolock(svc, req);
-                else
-                        cfs_list_add_tail(&req->rq_list,
-                                          &svc->srv_request_queue);
+                        ptlrpc_hpreq_reorder_nolock(svcpt, req);
+                else if (!ptlrpc_tbf_defer(svcpt, req))
+                        ptlrpc_nrs_enqueue(svcpt, req);
         }
-        cfs_spin_unlock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_unlock(svcpt);
 
         RETURN(0);
 }
 
 /**
  * Allow to handle high priority request
- * User can call it w/o any lock but need to hold ptlrpc_service::srv_rq_lock
- * to get reliable result
+ * User can call it w/o any lock but need to hold
+ * ptlrpc_service_part::scp_rq_lock to get reliable result
  */
-static int ptlrpc_server_allow_high(struct ptlrpc_service *svc, int force)
+static int ptlrpc_server_allow_high(struct ptlrpc_service_part *svcpt,
+                                    int force)
 {
         if (force)
                 return 1;
 
-        if (svc->srv_n_active_reqs >= svc->srv_threads_running - 1)
+        if (svcpt->scp_n_active_reqs >= svcpt->scp_threads_running - 1)
                 return 0;
 
-        return cfs_list_empty(&svc->srv_request_queue) ||
-               svc->srv_hpreq_count < svc->srv_hpreq_ratio;
+        return svcpt->scp_nrs.nrs_nreqs == 0 ||
+               svcpt->scp_hpreq_count < svcpt->scp_service->srv_hpreq_ratio;
 }
 
-static int ptlrpc_server_high_pending(struct ptlrpc_service *svc, int force)
+static int ptlrpc_server_high_pending(struct ptlrpc_service_part *svcpt,
+                                      int force)
 {
-        return ptlrpc_server_allow_high(svc, force) &&
-               !cfs_list_empty(&svc->srv_request_hpq);
+        return ptlrpc_server_allow_high(svcpt, force) &&
+               !cfs_list_empty(&svcpt->scp_request_hpq);
 }
 
 /**
@@ -1385,40 +1485,43 @@ static int ptlrpc_server_high_pending(struct ptlrpc_service *svc, int force)
  * already being processed (i.e. those threads can service more high-priority
  * requests), or if there are enough idle threads that a later thread can do
  * a high priority request.
- * User can call it w/o any lock but need to hold ptlrpc_service::srv_rq_lock
- * to get reliable result
+ * User can call it w/o any lock but need to hold
+ * ptlrpc_service_part::scp_rq_lock to get reliable result
  */
-static int ptlrpc_server_allow_normal(struct ptlrpc_service *svc, int force)
+static int ptlrpc_server_allow_normal(struct ptlrpc_service_part *svcpt,
+                                      int force)
 {
         if (force ||
-            svc->srv_n_active_reqs < svc->srv_threads_running - 2)
+            svcpt->scp_n_active_reqs < svcpt->scp_threads_running - 2)
                 return 1;
 
-        if (svc->srv_n_active_reqs >= svc->srv_threads_running - 1)
+        if (svcpt->scp_n_active_reqs >= svcpt->scp_threads_running - 1)
                 return 0;
 
-        return svc->srv_n_active_hpreq > 0 || svc->srv_hpreq_handler == NULL;
+        return svcpt->scp_n_active_hpreq > 0 ||
+               svcpt->scp_service->srv_hpreq_handler == NULL;
 }
 
-static int ptlrpc_server_normal_pending(struct ptlrpc_service *svc, int force)
+static int ptlrpc_server_normal_pending(struct ptlrpc_service_part *svcpt,
+                                        int force)
 {
-        return ptlrpc_server_allow_normal(svc, force) &&
-               !cfs_list_empty(&svc->srv_request_queue);
+        return ptlrpc_server_allow_normal(svcpt, force) &&
+               svcpt->scp_nrs.nrs_nreqs != 0;
 }
 
 /**
  * Returns true if there are requests available in incoming
  * request queue for processing and it is allowed to fetch them.
- * User can call it w/o any lock but need to hold ptlrpc_service::srv_rq_lock
- * to get reliable result
+ * User can call it w/o any lock but need to hold
+ * ptlrpc_service_part::scp_rq_lock to get reliable result
  * \see ptlrpc_server_allow_normal
  * \see ptlrpc_server_allow high
  */
 static inline int
-ptlrpc_server_request_pending(struct ptlrpc_service *svc, int force)
+ptlrpc_server_request_pending(struct ptlrpc_service_part *svcpt, int force)
 {
-        return ptlrpc_server_high_pending(svc, force) ||
-               ptlrpc_server_normal_pending(svc, force);
+        return ptlrpc_server_high_pending(svcpt, force) ||
+               ptlrpc_server_normal_pending(svcpt, force);
 }
 
 /**
@@ -1427,28 +1530,43 @@ ptlrpc_server_request_pending(struct ptlrpc_service *svc, int force)
  * Returns a pointer to fetched request.
  */
 static struct ptlrpc_request *
-ptlrpc_server_request_get(struct ptlrpc_service *svc, int force)
+ptlrpc_server_request_get(struct ptlrpc_service_part *svcpt, int force)
 {
         struct ptlrpc_request *req;
         ENTRY;
 
-        if (ptlrpc_server_high_pending(svc, force)) {
-                req = cfs_list_entry(svc->srv_request_hpq.next,
+        if (ptlrpc_server_high_pending(svcpt, force)) {
+                req = cfs_list_entry(svcpt->scp_request_hpq.next,
                                      struct ptlrpc_request, rq_list);
-                svc->srv_hpreq_count++;
+                svcpt->scp_hpreq_count++;
                 RETURN(req);
 
         }
 
-        if (ptlrpc_server_normal_pending(svc, force)) {
-                req = cfs_list_entry(svc->srv_request_queue.next,
-                                     struct ptlrpc_request, rq_list);
-                svc->srv_hpreq_count = 0;
+        if (ptlrpc_server_normal_pending(svcpt, force)) {
+                req = ptlrpc_nrs_peek(svcpt);
+                LASSERT(req != NULL);
+                svcpt->scp_hpreq_count = 0;
                 RETURN(req);
         }
         RETURN(NULL);
 }
 
+/**
+ * Take request \a req returned by ptlrpc_server_request_get() off its
+ * queue, \a served tells whether a service thread is going to handle it.
+ * Called holding ptlrpc_service_part::scp_rq_lock.
+ */
+static void ptlrpc_server_request_unlink(struct ptlrpc_service_part *svcpt,
+                                         struct ptlrpc_request *req,
+                                         int served)
+{
+        if (req->rq_nrs.nr_enqueued)
+                ptlrpc_nrs_dequeue(svcpt, req, served);
+        else
+                cfs_list_del_init(&req->rq_list);
+}
+
 /**
  * Handle freshly incoming reqs, add to timed early reply list,
  * pass on to regular request queue.
@@ -1456,8 +1574,9 @@ ptlrpc_server_request_get(struct ptlrpc_service *svc, int force)
  * ptlrpc_server_handle_req later on.
  */
 static int
-ptlrpc_server_handle_req_in(struct ptlrpc_service *svc)
+ptlrpc_server_handle_req_in(struct ptlrpc_service_part *svcpt)
 {
+        struct ptlrpc_service *svc = svcpt->scp_service;
         struct ptlrpc_request *req;
         __u32                  deadline;
         int                    rc;
@@ -1465,16 +1584,16 @@ ptlrpc_server_handle_req_in(struct ptlrpc_service *svc)
 
         LASSERT(svc);
 
-        cfs_spin_lock(&svc->srv_lock);
-        if (cfs_list_empty(&svc->srv_req_in_queue)) {
-                cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
+        if (cfs_list_empty(&svcpt->scp_req_in_queue)) {
+                ptlrpc_svcpt_unlock(svcpt);
                 RETURN(0);
         }
 
-        req = cfs_list_entry(svc->srv_req_in_queue.next,
+        req = cfs_list_entry(svcpt->scp_req_in_queue.next,
                              struct ptlrpc_request, rq_list);
         cfs_list_del_init (&req->rq_list);
-        svc->srv_n_queued_reqs--;
+        svcpt->scp_n_queued_reqs--;
         /* Consider this still a "queued" request as far as stats are
            concerned */
         /* ptlrpc_hpreq_init() inserts it to the export list and by the time
@@ -1482,7 +1601,11 @@ ptlrpc_server_handle_req_in(struct ptlrpc_service *svc)
          * released. To not lose request in between, take an extra reference
          * on the request. */
         ptlrpc_request_addref(req);
-        cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
+
+        if (likely(svcpt->scp_stats != NULL))
+                lprocfs_counter_incr(svcpt->scp_stats,
+                                     PTLRPC_PART_REQ_IN_CNTR);
 
         /* go through security check/transform */
         rc = sptlrpc_svc_unwrap_request(req);
@@ -1587,19 +1710,19 @@ ptlrpc_server_handle_req_in(struct ptlrpc_service *svc)
                 GOTO(err_req, rc);
 
         /* Move it over to the request processing queue */
-        rc = ptlrpc_server_request_add(svc, req);
+        rc = ptlrpc_server_request_add(svcpt, req);
         if (rc)
                 GOTO(err_req, rc);
-        cfs_waitq_signal(&svc->srv_waitq);
+        cfs_waitq_signal(&svcpt->scp_waitq);
         ptlrpc_server_drop_request(req);
         RETURN(1);
 
 err_req:
         ptlrpc_server_drop_request(req);
-        cfs_spin_lock(&svc->srv_rq_lock);
-        svc->srv_n_active_reqs++;
-        cfs_spin_unlock(&svc->srv_rq_lock);
-        ptlrpc_server_finish_request(svc, req);
+        ptlrpc_svcpt_rq_lock(svcpt);
+        svcpt->scp_n_active_reqs++;
+        ptlrpc_svcpt_rq_unlock(svcpt);
+        ptlrpc_server_finish_request(svcpt, req);
 
         RETURN(1);
 }
@@ -1609,11 +1732,13 @@ err_req:
  * Calls handler function from service to do actual processing.
  */
 static int
-ptlrpc_server_handle_request(struct ptlrpc_service *svc,
+ptlrpc_server_handle_request(struct ptlrpc_service_part *svcpt,
                              struct ptlrpc_thread *thread)
 {
+        struct ptlrpc_service *svc = svcpt->scp_service;
         struct obd_export     *export = NULL;
         struct ptlrpc_request *request;
+        struct lu_context     *ses;
         struct timeval         work_start;
         struct timeval         work_end;
         long                   timediff;
@@ -1623,17 +1748,17 @@ ptlrpc_server_handle_request(struct ptlrpc_service *svc,
 
         LASSERT(svc);
 
-        cfs_spin_lock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_lock(svcpt);
 #ifndef __KERNEL__
         /* !@%$# liblustre only has 1 thread */
         if (cfs_atomic_read(&svc->srv_n_difficult_replies) != 0) {
-                cfs_spin_unlock(&svc->srv_rq_lock);
+                ptlrpc_svcpt_rq_unlock(svcpt);
                 RETURN(0);
         }
 #endif
-        request = ptlrpc_server_request_get(svc, 0);
+        request = ptlrpc_server_request_get(svcpt, 0);
         if  (request == NULL) {
-                cfs_spin_unlock(&svc->srv_rq_lock);
+                ptlrpc_svcpt_rq_unlock(svcpt);
                 RETURN(0);
         }
 
@@ -1645,26 +1770,26 @@ ptlrpc_server_handle_request(struct ptlrpc_service *svc,
 
         if (unlikely(fail_opc)) {
                 if (request->rq_export && request->rq_ops) {
-                        cfs_spin_unlock(&svc->srv_rq_lock);
+                        ptlrpc_svcpt_rq_unlock(svcpt);
                         OBD_FAIL_TIMEOUT(fail_opc, 4);
-                        cfs_spin_lock(&svc->srv_rq_lock);
-                        request = ptlrpc_server_request_get(svc, 0);
+                        ptlrpc_svcpt_rq_lock(svcpt);
+                        request = ptlrpc_server_request_get(svcpt, 0);
                         if  (request == NULL) {
-                                cfs_spin_unlock(&svc->srv_rq_lock);
+                                ptlrpc_svcpt_rq_unlock(svcpt);
                                 RETURN(0);
                         }
                 }
         }
 
-        cfs_list_del_init(&request->rq_list);
-        svc->srv_n_active_reqs++;
+        ptlrpc_server_request_unlink(svcpt, request, 1);
+        svcpt->scp_n_active_reqs++;
         if (request->rq_hp)
-                svc->srv_n_active_hpreq++;
+                svcpt->scp_n_active_hpreq++;
 
         /* The phase is changed under the lock here because we need to know
          * the request is under processing (see ptlrpc_hpreq_reorder()). */
         ptlrpc_rqphase_move(request, RQ_PHASE_INTERPRET);
-        cfs_spin_unlock(&svc->srv_rq_lock);
+        ptlrpc_svcpt_rq_unlock(svcpt);
 
         ptlrpc_hpreq_fini(request);
 
@@ -1677,28 +1802,38 @@ ptlrpc_server_handle_request(struct ptlrpc_service *svc,
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQWAIT_CNTR,
                                     timediff);
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQQDEPTH_CNTR,
-                                    svc->srv_n_queued_reqs);
+                                    svcpt->scp_n_queued_reqs);
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQACTIVE_CNTR,
-                                    svc->srv_n_active_reqs);
+                                    svcpt->scp_n_active_reqs);
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_TIMEOUT,
                                     at_get(&svc->srv_at_estimate));
         }
+        if (likely(svcpt->scp_stats != NULL)) {
+                lprocfs_counter_add(svcpt->scp_stats,
+                                    PTLRPC_PART_REQWAIT_CNTR, timediff);
+                lprocfs_counter_add(svcpt->scp_stats,
+                                    PTLRPC_PART_REQQDEPTH_CNTR,
+                                    svcpt->scp_n_queued_reqs);
+        }
 
-        rc = lu_context_init(&request->rq_session,
-                             LCT_SESSION|LCT_REMEMBER|LCT_NOREF);
-        if (rc) {
-                CERROR("Failure to initialize session: %d\n", rc);
-                goto out_req;
+        if (thread != NULL) {
+                /* the session of the thread, see ptlrpc_main() */
+                ses = thread->t_env->le_ses;
+        } else {
+                rc = lu_context_init(&request->rq_session,
+                                     LCT_SESSION|LCT_REMEMBER|LCT_NOREF);
+                if (rc) {
+                        CERROR("Failure to initialize session: %d\n", rc);
+                        goto out_req;
+                }
+                ses = &request->rq_session;
+                ses->lc_cookie = 0x5;
         }
-        request->rq_session.lc_thread = thread;
-        request->rq_session.lc_cookie = 0x5;
-        lu_context_enter(&request->rq_session);
+        lu_context_enter(ses);
 
         CDEBUG(D_NET, "got req "LPU64"\n", request->rq_xid);
 
         request->rq_svc_thread = thread;
-        if (thread)
-                request->rq_svc_thread->t_env->le_ses = &request->rq_session;
 
         if (likely(request->rq_export)) {
                 if (unlikely(ptlrpc_check_req(request)))
@@ -1741,8 +1876,9 @@ put_rpc_export:
         if (export != NULL)
                 class_export_rpc_put(export);
 put_conn:
-        lu_context_exit(&request->rq_session);
-        lu_context_fini(&request->rq_session);
+        lu_context_exit(ses);
+        if (ses == &request->rq_session)
+                lu_context_fini(ses);
 
         if (unlikely(cfs_time_current_sec() > request->rq_deadline)) {
                 DEBUG_REQ(D_WARNING, request, "Request x"LPU64" took longer "
@@ -1786,6 +1922,15 @@ put_conn:
                                             timediff);
                 }
         }
+        if (request->rq_export != NULL && request->rq_reqmsg != NULL &&
+            request->rq_export->exp_obd->obd_jobstats.ojs_hash != NULL) {
+                int opc = opcode_offset(lustre_msg_get_opc(request->rq_reqmsg));
+
+                if (opc > 0 && opc < LUSTRE_MAX_OPCODES)
+                        lprocfs_job_stats_log(request->rq_export->exp_obd,
+                                      lustre_msg_get_jobid(request->rq_reqmsg),
+                                      opc + EXTRA_MAX_OPCODES, timediff);
+        }
         if (unlikely(request->rq_early_count)) {
                 DEBUG_REQ(D_ADAPTTO, request,
                           "sent %d early replies before finishing in "
@@ -1796,7 +1941,10 @@ put_conn:
         }
 
 out_req:
-        ptlrpc_server_finish_request(svc, request);
+        if (likely(svcpt->scp_stats != NULL))
+                lprocfs_counter_incr(svcpt->scp_stats,
+                                     PTLRPC_PART_REQ_HANDLED_CNTR);
+        ptlrpc_server_finish_request(svcpt, request);
 
         RETURN(1);
 }
@@ -1897,9 +2045,10 @@ ptlrpc_handle_rs (struct ptlrpc_reply_state *rs)
                 class_export_put (exp);
                 rs->rs_export = NULL;
                 ptlrpc_rs_decref (rs);
+                /* ptlrpc_wait_replies() waits on the first part */
                 if (cfs_atomic_dec_and_test(&svc->srv_n_difficult_replies) &&
                     svc->srv_is_stopping)
-                        cfs_waitq_broadcast(&svc->srv_waitq);
+                        cfs_waitq_broadcast(&svc->srv_parts[0]->scp_waitq);
                 RETURN(1);
         }
 
@@ -1951,8 +2100,10 @@ liblustre_check_services (void *arg)
         cfs_list_for_each_safe (tmp, nxt, &ptlrpc_all_services) {
                 struct ptlrpc_service *svc =
                         cfs_list_entry (tmp, struct ptlrpc_service, srv_list);
+                /* liblustre services are never partitioned */
+                struct ptlrpc_service_part *svcpt = svc->srv_parts[0];
 
-                if (svc->srv_threads_running != 0)     /* I've recursed */
+                if (svcpt->scp_threads_running != 0)     /* I've recursed */
                         continue;
 
                 /* service threads can block for bulk, so this limits us
@@ -1960,18 +2111,19 @@ liblustre_check_services (void *arg)
                  * Note that the problem with recursion is that we have to
                  * unwind completely before our caller can resume. */
 
-                svc->srv_threads_running++;
+                svcpt->scp_threads_running++;
 
                 do {
-                        rc = ptlrpc_server_handle_req_in(svc);
+                        rc = ptlrpc_server_handle_req_in(svcpt);
                         rc |= ptlrpc_server_handle_reply(svc);
                         rc |= ptlrpc_at_check_timed(svc);
-                        rc |= ptlrpc_server_handle_request(svc, NULL);
-                        rc |= (ptlrpc_server_post_idle_rqbds(svc) > 0);
+                        rc |= (ptlrpc_tbf_release(svcpt) > 0);
+                        rc |= ptlrpc_server_handle_request(svcpt, NULL);
+                        rc |= (ptlrpc_server_post_idle_rqbds(svcpt) > 0);
                         did_something |= rc;
                 } while (rc);
 
-                svc->srv_threads_running--;
+                svcpt->scp_threads_running--;
         }
 
         RETURN(did_something);
@@ -1981,9 +2133,10 @@ liblustre_check_services (void *arg)
 #else /* __KERNEL__ */
 
 static void
-ptlrpc_check_rqbd_pool(struct ptlrpc_service *svc)
+ptlrpc_check_rqbd_pool(struct ptlrpc_service_part *svcpt)
 {
-        int avail = svc->srv_nrqbd_receiving;
+        struct ptlrpc_service *svc = svcpt->scp_service;
+        int avail = svcpt->scp_nrqbd_receiving;
         int low_water = test_req_buffer_pressure ? 0 :
                         svc->srv_nbuf_per_group/2;
 
@@ -1995,7 +2148,7 @@ ptlrpc_check_rqbd_pool(struct ptlrpc_service *svc)
          * space. */
 
         if (avail <= low_water)
-                ptlrpc_grow_req_bufs(svc);
+                ptlrpc_grow_req_bufs(svcpt);
 
         if (svc->srv_stats)
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQBUF_AVAIL_CNTR,
@@ -2005,38 +2158,82 @@ ptlrpc_check_rqbd_pool(struct ptlrpc_service *svc)
 static int
 ptlrpc_retry_rqbds(void *arg)
 {
-        struct ptlrpc_service *svc = (struct ptlrpc_service *)arg;
+        struct ptlrpc_service_part *svcpt = (struct ptlrpc_service_part *)arg;
 
-        svc->srv_rqbd_timeout = 0;
+        svcpt->scp_rqbd_timeout = 0;
         return (-ETIMEDOUT);
 }
 
+/**
+ * share of part \a svcpt in \a total threads of the service: the
+ * remainder goes to the first parts so that the shares add up to \a total.
+ */
 static inline int
-ptlrpc_threads_enough(struct ptlrpc_service *svc)
+ptlrpc_svcpt_threads_share(struct ptlrpc_service_part *svcpt, int total)
 {
-        return svc->srv_n_active_reqs <
-               svc->srv_threads_running - 1 - (svc->srv_hpreq_handler != NULL);
+        int nparts = svcpt->scp_service->srv_nparts;
+
+        return total / nparts + (svcpt->scp_index < total % nparts);
+}
+
+/**
+ * minimum # of threads of each part: ptlrpc_service::srv_threads_min is
+ * shared between the parts, but every part needs a few threads to be able
+ * to handle high priority requests.
+ */
+static inline int
+ptlrpc_svcpt_threads_min(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_service *svc = svcpt->scp_service;
+
+        if (svc->srv_nparts == 1)
+                return svc->srv_threads_min;
+
+        return max(ptlrpc_svcpt_threads_share(svcpt, svc->srv_threads_min),
+                   PTLRPC_NTHRS_PART_MIN);
+}
+
+/** maximum # of threads of each part */
+static inline int
+ptlrpc_svcpt_threads_max(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_service *svc = svcpt->scp_service;
+
+        if (svc->srv_nparts == 1)
+                return svc->srv_threads_max;
+
+        return max(ptlrpc_svcpt_threads_share(svcpt, svc->srv_threads_max),
+                   ptlrpc_svcpt_threads_min(svcpt));
+}
+
+static inline int
+ptlrpc_threads_enough(struct ptlrpc_service_part *svcpt)
+{
+        return svcpt->scp_n_active_reqs <
+               svcpt->scp_threads_running - 1 -
+               (svcpt->scp_service->srv_hpreq_handler != NULL);
 }
 
 /**
  * allowed to create more threads
- * user can call it w/o any lock but need to hold ptlrpc_service::srv_lock to
- * get reliable result
+ * user can call it w/o any lock but need to hold
+ * ptlrpc_service_part::scp_lock to get reliable result
  */
 static inline int
-ptlrpc_threads_increasable(struct ptlrpc_service *svc)
+ptlrpc_threads_increasable(struct ptlrpc_service_part *svcpt)
 {
-        return svc->srv_threads_running +
-               svc->srv_threads_starting < svc->srv_threads_max;
+        return svcpt->scp_threads_running +
+               svcpt->scp_threads_starting < ptlrpc_svcpt_threads_max(svcpt);
 }
 
 /**
  * too many requests and allowed to create more threads
  */
 static inline int
-ptlrpc_threads_need_create(struct ptlrpc_service *svc)
+ptlrpc_threads_need_create(struct ptlrpc_service_part *svcpt)
 {
-        return !ptlrpc_threads_enough(svc) && ptlrpc_threads_increasable(svc);
+        return !ptlrpc_threads_enough(svcpt) &&
+               ptlrpc_threads_increasable(svcpt);
 }
 
 static inline int
@@ -2047,10 +2244,10 @@ ptlrpc_thread_stopping(struct ptlrpc_thread *thread)
 }
 
 static inline int
-ptlrpc_rqbd_pending(struct ptlrpc_service *svc)
+ptlrpc_rqbd_pending(struct ptlrpc_service_part *svcpt)
 {
-        return !cfs_list_empty(&svc->srv_idle_rqbds) &&
-               svc->srv_rqbd_timeout == 0;
+        return !cfs_list_empty(&svcpt->scp_idle_rqbds) &&
+               svcpt->scp_rqbd_timeout == 0;
 }
 
 static inline int
@@ -2059,15 +2256,22 @@ ptlrpc_at_check(struct ptlrpc_service *svc)
         return svc->srv_at_check;
 }
 
+/** TBF deferred requests may be due */
+static inline int
+ptlrpc_tbf_check(struct ptlrpc_service_part *svcpt)
+{
+        return svcpt->scp_tbf_check;
+}
+
 /**
  * requests wait on preprocessing
- * user can call it w/o any lock but need to hold ptlrpc_service::srv_lock to
- * get reliable result
+ * user can call it w/o any lock but need to hold
+ * ptlrpc_service_part::scp_lock to get reliable result
  */
 static inline int
-ptlrpc_server_request_waiting(struct ptlrpc_service *svc)
+ptlrpc_server_request_waiting(struct ptlrpc_service_part *svcpt)
 {
-        return !cfs_list_empty(&svc->srv_req_in_queue);
+        return !cfs_list_empty(&svcpt->scp_req_in_queue);
 }
 
 /**
@@ -2079,23 +2283,32 @@ ptlrpc_server_request_waiting(struct ptlrpc_service *svc)
 static int ptlrpc_main(void *arg)
 {
         struct ptlrpc_svc_data *data = (struct ptlrpc_svc_data *)arg;
-        struct ptlrpc_service  *svc = data->svc;
+        struct ptlrpc_service_part *svcpt = data->svcpt;
+        struct ptlrpc_service  *svc = svcpt->scp_service;
         struct ptlrpc_thread   *thread = data->thread;
         struct ptlrpc_reply_state *rs;
 #ifdef WITH_GROUP_INFO
         cfs_group_info_t *ginfo = NULL;
 #endif
-        struct lu_env env;
+        struct lu_env env = { .le_ses = NULL };
+        struct lu_context ses;
         int counter = 0, rc = 0;
         ENTRY;
 
         thread->t_pid = cfs_curproc_pid();
         cfs_daemonize_ctxt(data->name);
 
-#if defined(HAVE_NODE_TO_CPUMASK) && defined(CONFIG_NUMA)
         /* we need to do this before any per-thread allocation is done so that
          * we get the per-thread allocations on local node.  bug 7342 */
-        if (svc->srv_cpu_affinity) {
+        if (svcpt->scp_cpt != CFS_CPT_ANY) {
+                rc = cfs_cpt_bind(svcpt->scp_cpt);
+                if (rc != 0)
+                        CWARN("%s: failed to bind %s on CPT %d: rc = %d\n",
+                              svc->srv_name, data->name, svcpt->scp_cpt, rc);
+                rc = 0;
+        }
+#if defined(HAVE_NODE_TO_CPUMASK) && defined(CONFIG_NUMA)
+        else if (svc->srv_cpu_affinity) {
                 int cpu, num_cpu;
 
                 for (cpu = 0, num_cpu = 0; cpu < cfs_num_possible_cpus();
@@ -2137,6 +2350,20 @@ static int ptlrpc_main(void *arg)
         env.le_ctx.lc_thread = thread;
         env.le_ctx.lc_cookie = 0x6;
 
+        /*
+         * One session for all requests handled by this thread: only the
+         * values of keys used by a request are created, and they are reset
+         * rather than freed and allocated again for the next request.
+         */
+        rc = lu_context_init(&ses, LCT_SESSION|LCT_LAZY|LCT_REMEMBER|LCT_NOREF);
+        if (rc) {
+                lu_context_fini(&ses);
+                goto out_srv_fini;
+        }
+        ses.lc_thread = thread;
+        ses.lc_cookie = 0x5;
+        env.le_ses = &ses;
+
         /* Alloc reply state structure for this one */
         OBD_ALLOC_GFP(rs, svc->srv_max_reply_size, CFS_ALLOC_STD);
         if (!rs) {
@@ -2144,19 +2371,19 @@ static int ptlrpc_main(void *arg)
                 goto out_srv_fini;
         }
 
-        cfs_spin_lock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
 
         LASSERT((thread->t_flags & SVC_STARTING) != 0);
         thread->t_flags &= ~SVC_STARTING;
-        svc->srv_threads_starting--;
+        svcpt->scp_threads_starting--;
 
         /* SVC_STOPPING may already be set here if someone else is trying
          * to stop the service while this new thread has been dynamically
          * forked. We still set SVC_RUNNING to let our creator know that
          * we are now running, however we will exit as soon as possible */
         thread->t_flags |= SVC_RUNNING;
-        svc->srv_threads_running++;
-        cfs_spin_unlock(&svc->srv_lock);
+        svcpt->scp_threads_running++;
+        ptlrpc_svcpt_unlock(svcpt);
 
         /*
          * wake up our creator. Note: @data is invalid after this point,
@@ -2171,41 +2398,42 @@ static int ptlrpc_main(void *arg)
         cfs_waitq_signal(&svc->srv_free_rs_waitq);
         cfs_spin_unlock(&svc->srv_rs_lock);
 
-        CDEBUG(D_NET, "service thread %d (#%d) started\n", thread->t_id,
-               svc->srv_threads_running);
+        CDEBUG(D_NET, "service thread %d (#%d) started on part %d\n",
+               thread->t_id, svcpt->scp_threads_running, svcpt->scp_index);
 
         /* XXX maintain a list of all managed devices: insert here */
         while (!ptlrpc_thread_stopping(thread)) {
                 /* Don't exit while there are replies to be handled */
-                struct l_wait_info lwi = LWI_TIMEOUT(svc->srv_rqbd_timeout,
-                                                     ptlrpc_retry_rqbds, svc);
+                struct l_wait_info lwi = LWI_TIMEOUT(svcpt->scp_rqbd_timeout,
+                                                     ptlrpc_retry_rqbds, svcpt);
 
                 lc_watchdog_disable(thread->t_watchdog);
 
                 cfs_cond_resched();
 
-                l_wait_event_exclusive_head(svc->srv_waitq,
-                                       ptlrpc_thread_stopping(thread) ||
-                                       ptlrpc_server_request_waiting(svc) ||
-                                       ptlrpc_server_request_pending(svc, 0) ||
-                                       ptlrpc_rqbd_pending(svc) ||
-                                       ptlrpc_at_check(svc), &lwi);
+                l_wait_event_exclusive_head(svcpt->scp_waitq,
+                                     ptlrpc_thread_stopping(thread) ||
+                                     ptlrpc_server_request_waiting(svcpt) ||
+                                     ptlrpc_server_request_pending(svcpt, 0) ||
+                                     ptlrpc_rqbd_pending(svcpt) ||
+                                     ptlrpc_tbf_check(svcpt) ||
+                                     ptlrpc_at_check(svc), &lwi);
 
                 if (ptlrpc_thread_stopping(thread))
                         break;
 
                 lc_watchdog_touch(thread->t_watchdog, CFS_GET_TIMEOUT(svc));
 
-                ptlrpc_check_rqbd_pool(svc);
+                ptlrpc_check_rqbd_pool(svcpt);
 
-                if (ptlrpc_threads_need_create(svc)) {
+                if (ptlrpc_threads_need_create(svcpt)) {
                         /* Ignore return code - we tried... */
-                        ptlrpc_start_thread(svc);
+                        ptlrpc_start_thread(svcpt);
                 }
 
                 /* Process all incoming reqs before handling any */
-                if (ptlrpc_server_request_waiting(svc)) {
-                        ptlrpc_server_handle_req_in(svc);
+                if (ptlrpc_server_request_waiting(svcpt)) {
+                        ptlrpc_server_handle_req_in(svcpt);
                         /* but limit ourselves in case of flood */
                         if (counter++ < 100)
                                 continue;
@@ -2215,20 +2443,23 @@ static int ptlrpc_main(void *arg)
                 if (ptlrpc_at_check(svc))
                         ptlrpc_at_check_timed(svc);
 
-                if (ptlrpc_server_request_pending(svc, 0)) {
+                if (ptlrpc_tbf_check(svcpt))
+                        ptlrpc_tbf_release(svcpt);
+
+                if (ptlrpc_server_request_pending(svcpt, 0)) {
                         lu_context_enter(&env.le_ctx);
-                        ptlrpc_server_handle_request(svc, thread);
+                        ptlrpc_server_handle_request(svcpt, thread);
                         lu_context_exit(&env.le_ctx);
                 }
 
-                if (ptlrpc_rqbd_pending(svc) &&
-                    ptlrpc_server_post_idle_rqbds(svc) < 0) {
+                if (ptlrpc_rqbd_pending(svcpt) &&
+                    ptlrpc_server_post_idle_rqbds(svcpt) < 0) {
                         /* I just failed to repost request buffers.
                          * Wait for a timeout (unless something else
                          * happens) before I try again */
-                        svc->srv_rqbd_timeout = cfs_time_seconds(1)/10;
+                        svcpt->scp_rqbd_timeout = cfs_time_seconds(1)/10;
                         CDEBUG(D_RPCTRACE,"Posted buffers: %d\n",
-                               svc->srv_nrqbd_receiving);
+                               svcpt->scp_nrqbd_receiving);
                 }
         }
 
@@ -2242,20 +2473,22 @@ out_srv_fini:
         if (svc->srv_done != NULL)
                 svc->srv_done(thread);
 
+        if (env.le_ses != NULL)
+                lu_context_fini(env.le_ses);
         lu_context_fini(&env.le_ctx);
 out:
         CDEBUG(D_RPCTRACE, "service thread [ %p : %u ] %d exiting: rc %d\n",
                thread, thread->t_pid, thread->t_id, rc);
 
-        cfs_spin_lock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
         if ((thread->t_flags & SVC_STARTING) != 0) {
-                svc->srv_threads_starting--;
+                svcpt->scp_threads_starting--;
                 thread->t_flags &= ~SVC_STARTING;
         }
 
         if ((thread->t_flags & SVC_RUNNING) != 0) {
                 /* must know immediately */
-                svc->srv_threads_running--;
+                svcpt->scp_threads_running--;
                 thread->t_flags &= ~SVC_RUNNING;
         }
 
@@ -2263,7 +2496,7 @@ out:
         thread->t_flags |= SVC_STOPPED;
 
         cfs_waitq_signal(&thread->t_ctl_waitq);
-        cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
 
         return rc;
 }
@@ -2410,7 +2643,7 @@ static int ptlrpc_start_hr_threads(struct ptlrpc_hr_service *hr)
         RETURN(0);
 }
 
-static void ptlrpc_stop_thread(struct ptlrpc_service *svc,
+static void ptlrpc_stop_thread(struct ptlrpc_service_part *svcpt,
                                struct ptlrpc_thread *thread)
 {
         struct l_wait_info lwi = { 0 };
@@ -2419,18 +2652,18 @@ static void ptlrpc_stop_thread(struct ptlrpc_service *svc,
         CDEBUG(D_RPCTRACE, "Stopping thread [ %p : %u ]\n",
                thread, thread->t_pid);
 
-        cfs_spin_lock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
         /* let the thread know that we would like it to stop asap */
         thread->t_flags |= SVC_STOPPING;
-        cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
 
-        cfs_waitq_broadcast(&svc->srv_waitq);
+        cfs_waitq_broadcast(&svcpt->scp_waitq);
         l_wait_event(thread->t_ctl_waitq,
                      (thread->t_flags & SVC_STOPPED), &lwi);
 
-        cfs_spin_lock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
         cfs_list_del(&thread->t_link);
-        cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_unlock(svcpt);
 
         OBD_FREE_PTR(thread);
         EXIT;
@@ -2441,50 +2674,60 @@ static void ptlrpc_stop_thread(struct ptlrpc_service *svc,
  */
 void ptlrpc_stop_all_threads(struct ptlrpc_service *svc)
 {
-        struct ptlrpc_thread *thread;
+        struct ptlrpc_service_part *svcpt;
+        struct ptlrpc_thread       *thread;
+        int                         i;
         ENTRY;
 
-        cfs_spin_lock(&svc->srv_lock);
-        while (!cfs_list_empty(&svc->srv_threads)) {
-                thread = cfs_list_entry(svc->srv_threads.next,
-                                        struct ptlrpc_thread, t_link);
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                ptlrpc_svcpt_lock(svcpt);
+                while (!cfs_list_empty(&svcpt->scp_threads)) {
+                        thread = cfs_list_entry(svcpt->scp_threads.next,
+                                                struct ptlrpc_thread, t_link);
 
-                cfs_spin_unlock(&svc->srv_lock);
-                ptlrpc_stop_thread(svc, thread);
-                cfs_spin_lock(&svc->srv_lock);
-        }
+                        ptlrpc_svcpt_unlock(svcpt);
+                        ptlrpc_stop_thread(svcpt, thread);
+                        ptlrpc_svcpt_lock(svcpt);
+                }
 
-        cfs_spin_unlock(&svc->srv_lock);
+                ptlrpc_svcpt_unlock(svcpt);
+        }
         EXIT;
 }
 
 int ptlrpc_start_threads(struct ptlrpc_service *svc)
 {
-        int i, rc = 0;
+        struct ptlrpc_service_part *svcpt;
+        int i, j, rc = 0;
         ENTRY;
 
         /* We require 2 threads min - see note in
            ptlrpc_server_handle_request */
         LASSERT(svc->srv_threads_min >= 2);
-        for (i = 0; i < svc->srv_threads_min; i++) {
-                rc = ptlrpc_start_thread(svc);
-                /* We have enough threads, don't start more.  b=15759 */
-                if (rc == -EMFILE) {
-                        rc = 0;
-                        break;
-                }
-                if (rc) {
-                        CERROR("cannot start %s thread #%d: rc %d\n",
-                               svc->srv_thread_name, i, rc);
-                        ptlrpc_stop_all_threads(svc);
-                        break;
+        ptlrpc_service_for_each_part(svcpt, j, svc) {
+                for (i = 0; i < ptlrpc_svcpt_threads_min(svcpt); i++) {
+                        rc = ptlrpc_start_thread(svcpt);
+                        /* We have enough threads, don't start more.
+                         * b=15759 */
+                        if (rc == -EMFILE) {
+                                rc = 0;
+                                break;
+                        }
+                        if (rc) {
+                                CERROR("cannot start %s thread #%d of "
+                                       "part %d: rc %d\n",
+                                       svc->srv_thread_name, i, j, rc);
+                                ptlrpc_stop_all_threads(svc);
+                                RETURN(rc);
+                        }
                 }
         }
         RETURN(rc);
 }
 
-int ptlrpc_start_thread(struct ptlrpc_service *svc)
+int ptlrpc_start_thread(struct ptlrpc_service_part *svcpt)
 {
+        struct ptlrpc_service *svc = svcpt->scp_service;
         struct l_wait_info lwi = { 0 };
         struct ptlrpc_svc_data d;
         struct ptlrpc_thread *thread;
@@ -2492,40 +2735,60 @@ int ptlrpc_start_thread(struct ptlrpc_service *svc)
         int rc;
         ENTRY;
 
-        CDEBUG(D_RPCTRACE, "%s started %d min %d max %d running %d\n",
-               svc->srv_name, svc->srv_threads_running, svc->srv_threads_min,
-               svc->srv_threads_max, svc->srv_threads_running);
+        CDEBUG(D_RPCTRACE, "%s part %d started %d min %d max %d running %d\n",
+               svc->srv_name, svcpt->scp_index, svcpt->scp_threads_running,
+               ptlrpc_svcpt_threads_min(svcpt),
+               ptlrpc_svcpt_threads_max(svcpt), svcpt->scp_threads_running);
 
         if (unlikely(svc->srv_is_stopping))
                 RETURN(-ESRCH);
 
-        if (!ptlrpc_threads_increasable(svc) ||
+        if (!ptlrpc_threads_increasable(svcpt) ||
             (OBD_FAIL_CHECK(OBD_FAIL_TGT_TOOMANY_THREADS) &&
-             svc->srv_threads_running == svc->srv_threads_min - 1))
+             svcpt->scp_threads_running ==
+             ptlrpc_svcpt_threads_min(svcpt) - 1))
                 RETURN(-EMFILE);
 
-        OBD_ALLOC_PTR(thread);
+        OBD_CPT_ALLOC_PTR(thread, svcpt->scp_cpt);
         if (thread == NULL)
                 RETURN(-ENOMEM);
         cfs_waitq_init(&thread->t_ctl_waitq);
 
-        cfs_spin_lock(&svc->srv_lock);
-        if (!ptlrpc_threads_increasable(svc)) {
-                cfs_spin_unlock(&svc->srv_lock);
+        ptlrpc_svcpt_lock(svcpt);
+        if (!ptlrpc_threads_increasable(svcpt)) {
+                ptlrpc_svcpt_unlock(svcpt);
                 OBD_FREE_PTR(thread);
                 RETURN(-EMFILE);
         }
 
-        svc->srv_threads_starting++;
-        thread->t_id    = svc->srv_threads_next_id++;
+        svcpt->scp_threads_starting++;
         thread->t_flags |= SVC_STARTING;
         thread->t_svc   = svc;
+        thread->t_svcpt = svcpt;
+
+        cfs_list_add(&thread->t_link, &svcpt->scp_threads);
+        ptlrpc_svcpt_unlock(svcpt);
 
-        cfs_list_add(&thread->t_link, &svc->srv_threads);
+        /* thread ids are unique within the whole service */
+        cfs_spin_lock(&svc->srv_lock);
+        thread->t_id    = svc->srv_threads_next_id++;
         cfs_spin_unlock(&svc->srv_lock);
 
-        sprintf(name, "%s_%02d", svc->srv_thread_name, thread->t_id);
+        if (svcpt->scp_cpt != CFS_CPT_ANY) {
+                char suffix[16];
+                int  len;
+
+                /* task names are cut at 15 characters, shorten the service
+                 * name rather than lose the partition and thread id */
+                len = snprintf(suffix, sizeof(suffix), "%d_%d",
+                               svcpt->scp_cpt, thread->t_id);
+                snprintf(name, sizeof(name), "%.*s%s",
+                         max(15 - len, 0), svc->srv_thread_name, suffix);
+        } else {
+                sprintf(name, "%s_%02d", svc->srv_thread_name, thread->t_id);
+        }
         d.svc = svc;
+        d.svcpt = svcpt;
         d.name = name;
         d.thread = thread;
 
@@ -2538,10 +2801,10 @@ int ptlrpc_start_thread(struct ptlrpc_service *svc)
         if (rc < 0) {
                 CERROR("cannot start thread '%s': rc %d\n", name, rc);
 
-                cfs_spin_lock(&svc->srv_lock);
+                ptlrpc_svcpt_lock(svcpt);
                 cfs_list_del(&thread->t_link);
-                --svc->srv_threads_starting;
-                cfs_spin_unlock(&svc->srv_lock);
+                --svcpt->scp_threads_starting;
+                ptlrpc_svcpt_unlock(svcpt);
 
                 OBD_FREE(thread, sizeof(*thread));
                 RETURN(rc);
@@ -2609,7 +2872,8 @@ static void ptlrpc_wait_replies(struct ptlrpc_service *svc)
                 int rc;
                 struct l_wait_info lwi = LWI_TIMEOUT(cfs_time_seconds(10),
                                                      NULL, NULL);
-                rc = l_wait_event(svc->srv_waitq, cfs_atomic_read(&svc-> \
+                rc = l_wait_event(svc->srv_parts[0]->scp_waitq,
+                                  cfs_atomic_read(&svc-> \
                                   srv_n_difficult_replies) == 0,
                                   &lwi);
                 if (rc == 0)
@@ -2618,39 +2882,20 @@ static void ptlrpc_wait_replies(struct ptlrpc_service *svc)
         }
 }
 
-int ptlrpc_unregister_service(struct ptlrpc_service *service)
+/**
+ * Unlink all request buffers of part \a svcpt and wait for LNet to release
+ * them.
+ */
+static void ptlrpc_svcpt_unlink_rqbd(struct ptlrpc_service_part *svcpt)
 {
-        int                   rc;
-        struct l_wait_info    lwi;
-        cfs_list_t           *tmp;
-        struct ptlrpc_reply_state *rs, *t;
-        struct ptlrpc_at_array *array = &service->srv_at_array;
-        ENTRY;
-
-        service->srv_is_stopping = 1;
-        cfs_timer_disarm(&service->srv_at_timer);
-
-        ptlrpc_stop_all_threads(service);
-        LASSERT(cfs_list_empty(&service->srv_threads));
-
-        cfs_spin_lock (&ptlrpc_all_services_lock);
-        cfs_list_del_init (&service->srv_list);
-        cfs_spin_unlock (&ptlrpc_all_services_lock);
-
-        ptlrpc_lprocfs_unregister_service(service);
-
-        /* All history will be culled when the next request buffer is
-         * freed */
-        service->srv_max_history_rqbds = 0;
-
-        CDEBUG(D_NET, "%s: tearing down\n", service->srv_name);
-
-        rc = LNetClearLazyPortal(service->srv_req_portal);
-        LASSERT (rc == 0);
+        struct ptlrpc_service *service = svcpt->scp_service;
+        struct l_wait_info     lwi;
+        cfs_list_t            *tmp;
+        int                    rc;
 
         /* Unlink all the request buffers.  This forces a 'final' event with
          * its 'unlink' flag set for each posted rqbd */
-        cfs_list_for_each(tmp, &service->srv_active_rqbds) {
+        cfs_list_for_each(tmp, &svcpt->scp_active_rqbds) {
                 struct ptlrpc_request_buffer_desc *rqbd =
                         cfs_list_entry(tmp, struct ptlrpc_request_buffer_desc,
                                        rqbd_list);
@@ -2662,9 +2907,9 @@ int ptlrpc_unregister_service(struct ptlrpc_service *service)
         /* Wait for the network to release any buffers it's currently
          * filling */
         for (;;) {
-                cfs_spin_lock(&service->srv_lock);
-                rc = service->srv_nrqbd_receiving;
-                cfs_spin_unlock(&service->srv_lock);
+                ptlrpc_svcpt_lock(svcpt);
+                rc = svcpt->scp_nrqbd_receiving;
+                ptlrpc_svcpt_unlock(svcpt);
 
                 if (rc == 0)
                         break;
@@ -2673,65 +2918,121 @@ int ptlrpc_unregister_service(struct ptlrpc_service *service)
                  * timeout lets us CWARN for visibility of sluggish NALs */
                 lwi = LWI_TIMEOUT_INTERVAL(cfs_time_seconds(LONG_UNLINK),
                                            cfs_time_seconds(1), NULL, NULL);
-                rc = l_wait_event(service->srv_waitq,
-                                  service->srv_nrqbd_receiving == 0,
+                rc = l_wait_event(svcpt->scp_waitq,
+                                  svcpt->scp_nrqbd_receiving == 0,
                                   &lwi);
                 if (rc == -ETIMEDOUT)
                         CWARN("Service %s waiting for request buffers\n",
                               service->srv_name);
         }
+}
 
-        /* schedule all outstanding replies to terminate them */
-        cfs_spin_lock(&service->srv_rs_lock);
-        while (!cfs_list_empty(&service->srv_active_replies)) {
-                struct ptlrpc_reply_state *rs =
-                        cfs_list_entry(service->srv_active_replies.next,
-                                       struct ptlrpc_reply_state, rs_list);
-                cfs_spin_lock(&rs->rs_lock);
-                ptlrpc_schedule_difficult_reply(rs);
-                cfs_spin_unlock(&rs->rs_lock);
-        }
-        cfs_spin_unlock(&service->srv_rs_lock);
-
+/**
+ * Purge requests and free request buffers of part \a svcpt.
+ */
+static void ptlrpc_svcpt_free_reqs(struct ptlrpc_service_part *svcpt)
+{
         /* purge the request queue.  NB No new replies (rqbds all unlinked)
          * and no service threads, so I'm the only thread noodling the
          * request queue now */
-        while (!cfs_list_empty(&service->srv_req_in_queue)) {
+        while (!cfs_list_empty(&svcpt->scp_req_in_queue)) {
                 struct ptlrpc_request *req =
-                        cfs_list_entry(service->srv_req_in_queue.next,
+                        cfs_list_entry(svcpt->scp_req_in_queue.next,
                                        struct ptlrpc_request,
                                        rq_list);
 
                 cfs_list_del(&req->rq_list);
-                service->srv_n_queued_reqs--;
-                service->srv_n_active_reqs++;
-                ptlrpc_server_finish_request(service, req);
+                svcpt->scp_n_queued_reqs--;
+                svcpt->scp_n_active_reqs++;
+                ptlrpc_server_finish_request(svcpt, req);
         }
-        while (ptlrpc_server_request_pending(service, 1)) {
+        while (ptlrpc_server_request_pending(svcpt, 1)) {
                 struct ptlrpc_request *req;
 
-                req = ptlrpc_server_request_get(service, 1);
-                cfs_list_del(&req->rq_list);
-                service->srv_n_queued_reqs--;
-                service->srv_n_active_reqs++;
+                req = ptlrpc_server_request_get(svcpt, 1);
+                ptlrpc_server_request_unlink(svcpt, req, 0);
+                svcpt->scp_n_queued_reqs--;
+                svcpt->scp_n_active_reqs++;
                 ptlrpc_hpreq_fini(req);
-                ptlrpc_server_finish_request(service, req);
+                ptlrpc_server_finish_request(svcpt, req);
         }
-        LASSERT(service->srv_n_queued_reqs == 0);
-        LASSERT(service->srv_n_active_reqs == 0);
-        LASSERT(service->srv_n_history_rqbds == 0);
-        LASSERT(cfs_list_empty(&service->srv_active_rqbds));
+        while (!cfs_list_empty(&svcpt->scp_tbf_deferred)) {
+                struct ptlrpc_request *req =
+                        cfs_list_entry(svcpt->scp_tbf_deferred.next,
+                                       struct ptlrpc_request,
+                                       rq_list);
+
+                ptlrpc_tbf_undefer(svcpt, req);
+                svcpt->scp_n_queued_reqs--;
+                svcpt->scp_n_active_reqs++;
+                ptlrpc_hpreq_fini(req);
+                ptlrpc_server_finish_request(svcpt, req);
+        }
+        LASSERT(svcpt->scp_n_queued_reqs == 0);
+        LASSERT(svcpt->scp_n_active_reqs == 0);
+        LASSERT(svcpt->scp_n_history_rqbds == 0);
+        LASSERT(cfs_list_empty(&svcpt->scp_active_rqbds));
 
         /* Now free all the request buffers since nothing references them
          * any more... */
-        while (!cfs_list_empty(&service->srv_idle_rqbds)) {
+        while (!cfs_list_empty(&svcpt->scp_idle_rqbds)) {
                 struct ptlrpc_request_buffer_desc *rqbd =
-                        cfs_list_entry(service->srv_idle_rqbds.next,
+                        cfs_list_entry(svcpt->scp_idle_rqbds.next,
                                        struct ptlrpc_request_buffer_desc,
                                        rqbd_list);
 
                 ptlrpc_free_rqbd(rqbd);
         }
+}
+
+int ptlrpc_unregister_service(struct ptlrpc_service *service)
+{
+        int                   rc;
+        int                   i;
+        struct ptlrpc_service_part *svcpt;
+        struct ptlrpc_reply_state *rs, *t;
+        struct ptlrpc_at_array *array = &service->srv_at_array;
+        ENTRY;
+
+        service->srv_is_stopping = 1;
+        cfs_timer_disarm(&service->srv_at_timer);
+
+        ptlrpc_stop_all_threads(service);
+        ptlrpc_service_for_each_part(svcpt, i, service)
+                LASSERT(cfs_list_empty(&svcpt->scp_threads));
+
+        cfs_spin_lock (&ptlrpc_all_services_lock);
+        cfs_list_del_init (&service->srv_list);
+        cfs_spin_unlock (&ptlrpc_all_services_lock);
+
+        ptlrpc_lprocfs_unregister_service(service);
+
+        /* All history will be culled when the next request buffer is
+         * freed */
+        service->srv_max_history_rqbds = 0;
+
+        CDEBUG(D_NET, "%s: tearing down\n", service->srv_name);
+
+        rc = LNetClearLazyPortal(service->srv_req_portal);
+        LASSERT (rc == 0);
+
+        ptlrpc_service_for_each_part(svcpt, i, service)
+                ptlrpc_svcpt_unlink_rqbd(svcpt);
+
+        /* schedule all outstanding replies to terminate them */
+        cfs_spin_lock(&service->srv_rs_lock);
+        while (!cfs_list_empty(&service->srv_active_replies)) {
+                struct ptlrpc_reply_state *rs =
+                        cfs_list_entry(service->srv_active_replies.next,
+                                       struct ptlrpc_reply_state, rs_list);
+                cfs_spin_lock(&rs->rs_lock);
+                ptlrpc_schedule_difficult_reply(rs);
+                cfs_spin_unlock(&rs->rs_lock);
+        }
+        cfs_spin_unlock(&service->srv_rs_lock);
+
+        ptlrpc_service_for_each_part(svcpt, i, service)
+                ptlrpc_svcpt_free_reqs(svcpt);
 
         ptlrpc_wait_replies(service);
 
@@ -2756,6 +3057,15 @@ int ptlrpc_unregister_service(struct ptlrpc_service *service)
                 array->paa_reqs_count= NULL;
         }
 
+        ptlrpc_tbf_fini(service);
+        ptlrpc_service_for_each_part(svcpt, i, service) {
+                ptlrpc_tbf_part_fini(svcpt);
+                ptlrpc_nrs_fini(svcpt);
+                OBD_FREE_PTR(svcpt);
+        }
+        OBD_FREE(service->srv_parts,
+                 service->srv_nparts * sizeof(service->srv_parts[0]));
+
         OBD_FREE_PTR(service);
         RETURN(0);
 }
@@ -2768,35 +3078,43 @@ int ptlrpc_unregister_service(struct ptlrpc_service *service)
  * to be shot, so it's intentionally non-aggressive. */
 int ptlrpc_service_health_check(struct ptlrpc_service *svc)
 {
-        struct ptlrpc_request *request;
-        struct timeval         right_now;
-        long                   timediff;
+        struct ptlrpc_service_part *svcpt;
+        struct ptlrpc_request      *request;
+        struct timeval              right_now;
+        long                        timediff;
+        long                        max_timediff = 0;
+        int                         i;
 
         if (svc == NULL)
                 return 0;
 
         cfs_gettimeofday(&right_now);
 
-        cfs_spin_lock(&svc->srv_rq_lock);
-        if (!ptlrpc_server_request_pending(svc, 1)) {
-                cfs_spin_unlock(&svc->srv_rq_lock);
-                return 0;
-        }
+        ptlrpc_service_for_each_part(svcpt, i, svc) {
+                ptlrpc_svcpt_rq_lock(svcpt);
+                if (!ptlrpc_server_request_pending(svcpt, 1)) {
+                        ptlrpc_svcpt_rq_unlock(svcpt);
+                        continue;
+                }
 
-        /* How long has the next entry been waiting? */
-        if (cfs_list_empty(&svc->srv_request_queue))
-                request = cfs_list_entry(svc->srv_request_hpq.next,
-                                         struct ptlrpc_request, rq_list);
-        else
-                request = cfs_list_entry(svc->srv_request_queue.next,
-                                         struct ptlrpc_request, rq_list);
-        timediff = cfs_timeval_sub(&right_now, &request->rq_arrival_time, NULL);
-        cfs_spin_unlock(&svc->srv_rq_lock);
+                /* How long has the next entry been waiting? */
+                request = ptlrpc_nrs_peek(svcpt);
+                if (request == NULL)
+                        request = cfs_list_entry(svcpt->scp_request_hpq.next,
+                                                 struct ptlrpc_request,
+                                                 rq_list);
+                timediff = cfs_timeval_sub(&right_now,
+                                           &request->rq_arrival_time, NULL);
+                ptlrpc_svcpt_rq_unlock(svcpt);
+
+                if (timediff > max_timediff)
+                        max_timediff = timediff;
+        }
 
-        if ((timediff / ONE_MILLION) > (AT_OFF ? obd_timeout * 3/2 :
-                                        at_max)) {
+        if ((max_timediff / ONE_MILLION) > (AT_OFF ? obd_timeout * 3/2 :
+                                            at_max)) {
                 CERROR("%s: unhealthy - request has been waiting %lds\n",
-                       svc->srv_name, timediff / ONE_MILLION);
+                       svc->srv_name, max_timediff / ONE_MILLION);
                 return (-1);
         }
 
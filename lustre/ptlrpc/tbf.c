@@ -0,0 +1,565 @@
+/* -*- mode: c; c-basic-offset: 8; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.sun.com/software/products/lustre/docs/GPLv2.pdf
+ *
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa Clara,
+ * CA 95054 USA or visit www.sun.com if you need additional information or
+ * have any questions.
+ *
+ * GPL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ * Use is subject to license terms.
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ * Lustre is a trademark of Sun Microsystems, Inc.
+ *
+ * lustre/ptlrpc/tbf.c
+ *
+ * Token Bucket Filter: rate limits requests of a service by client NID,
+ * opcode and job identifier, see \ref tbf.
+ *
+ * A request leaving ptlrpc_server_handle_req_in() is checked against the
+ * rules of the service before it is given to the NRS policy.  The bucket of
+ * every rule is kept as the theoretical arrival time of the next request
+ * conforming to the rate (GCRA); a request arriving earlier than its burst
+ * allows is put on the deferred list of its service part, sorted by the
+ * time it may go, and a timer wakes a service thread to move it over to the
+ * NRS queue then.
+ *
+ * Deferred requests are on the AT timed list like any queued request, so
+ * ptlrpc_at_check_timed() keeps sending early replies for them and clients
+ * don't time out while being throttled.
+ */
+
+#ifndef EXPORT_SYMTAB
+# define EXPORT_SYMTAB
+#endif
+#define DEBUG_SUBSYSTEM S_RPC
+
+#ifndef __KERNEL__
+#include <liblustre.h>
+#endif
+
+#include <obd_support.h>
+#include <obd_class.h>
+#include <lustre_net.h>
+#include "ptlrpc_internal.h"
+
+/** current time in usec */
+static __u64 ptlrpc_tbf_now(void)
+{
+        struct timeval tv;
+
+        cfs_gettimeofday(&tv);
+        return (__u64)tv.tv_sec * ONE_MILLION + tv.tv_usec;
+}
+
+static void ptlrpc_tbf_rule_put(struct ptlrpc_tbf_rule *rule)
+{
+        if (!cfs_atomic_dec_and_test(&rule->tr_ref))
+                return;
+
+        LASSERT(rule->tr_queued == 0);
+        if (rule->tr_nids_str != NULL) {
+                cfs_free_nidlist(&rule->tr_nids);
+                OBD_FREE(rule->tr_nids_str, strlen(rule->tr_nids_str) + 1);
+        }
+        OBD_FREE_PTR(rule);
+}
+
+static int ptlrpc_tbf_rule_match(struct ptlrpc_tbf_rule *rule,
+                                 struct ptlrpc_request *req)
+{
+        char *jobid;
+
+        if (!cfs_list_empty(&rule->tr_nids) &&
+            !cfs_match_nid(req->rq_peer.nid, &rule->tr_nids))
+                return 0;
+
+        if (rule->tr_opc != -1 &&
+            lustre_msg_get_opc(req->rq_reqmsg) != rule->tr_opc)
+                return 0;
+
+        if (rule->tr_jobid[0] != '\0') {
+                jobid = lustre_msg_get_jobid(req->rq_reqmsg);
+                if (jobid == NULL || strcmp(jobid, rule->tr_jobid) != 0)
+                        return 0;
+        }
+        return 1;
+}
+
+static void ptlrpc_tbf_timer(unsigned long castmeharder)
+{
+        struct ptlrpc_service_part *svcpt =
+                (struct ptlrpc_service_part *)castmeharder;
+
+        svcpt->scp_tbf_check = 1;
+        cfs_waitq_signal(&svcpt->scp_waitq);
+}
+
+/** arm the release timer of \a svcpt for \a release usec, \a now is now */
+static void ptlrpc_tbf_arm(struct ptlrpc_service_part *svcpt,
+                           __u64 release, __u64 now)
+{
+        __u64 delay = 0;
+
+        if (release > now) {
+                /* round up to a whole tick */
+                delay = (release - now) * cfs_time_seconds(1) +
+                        ONE_MILLION - 1;
+                do_div(delay, ONE_MILLION);
+        }
+        cfs_timer_arm(&svcpt->scp_tbf_timer,
+                      cfs_time_add(cfs_time_current(),
+                                   (cfs_duration_t)delay));
+}
+
+void ptlrpc_tbf_part_init(struct ptlrpc_service_part *svcpt)
+{
+        CFS_INIT_LIST_HEAD(&svcpt->scp_tbf_deferred);
+        svcpt->scp_tbf_check = 0;
+        cfs_timer_init(&svcpt->scp_tbf_timer, ptlrpc_tbf_timer, svcpt);
+}
+
+void ptlrpc_tbf_part_fini(struct ptlrpc_service_part *svcpt)
+{
+        cfs_timer_disarm(&svcpt->scp_tbf_timer);
+        LASSERT(cfs_list_empty(&svcpt->scp_tbf_deferred));
+}
+
+/**
+ * Drop all rules of \a svc, no request is deferred any more.
+ */
+void ptlrpc_tbf_fini(struct ptlrpc_service *svc)
+{
+        struct ptlrpc_tbf_rule *rule;
+
+        while (!cfs_list_empty(&svc->srv_tbf_rules)) {
+                rule = cfs_list_entry(svc->srv_tbf_rules.next,
+                                      struct ptlrpc_tbf_rule, tr_list);
+                cfs_list_del(&rule->tr_list);
+                ptlrpc_tbf_rule_put(rule);
+        }
+}
+
+/**
+ * Check non high priority request \a req against the TBF rules of its
+ * service and defer it if the first matching rule is over its rate.
+ * Called holding ptlrpc_service_part::scp_rq_lock.
+ *
+ * \retval 1 \a req is deferred, it is not to be queued for service yet
+ * \retval 0 \a req can be served now
+ */
+int ptlrpc_tbf_defer(struct ptlrpc_service_part *svcpt,
+                     struct ptlrpc_request *req)
+{
+        struct ptlrpc_service  *svc = svcpt->scp_service;
+        struct ptlrpc_tbf_rule *rule;
+        struct ptlrpc_request  *tmp;
+        cfs_list_t             *pos;
+        __u64                   now;
+        __u64                   tat;
+        __u64                   burst;
+
+        /* services without rules don't pay for the lock */
+        if (cfs_list_empty(&svc->srv_tbf_rules))
+                return 0;
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        cfs_list_for_each_entry(rule, &svc->srv_tbf_rules, tr_list) {
+                if (ptlrpc_tbf_rule_match(rule, req))
+                        goto found;
+        }
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+        return 0;
+
+found:
+        rule->tr_hits++;
+        now = ptlrpc_tbf_now();
+        tat = max(rule->tr_tat, now);
+        burst = (rule->tr_depth - 1) * rule->tr_interval;
+        rule->tr_tat = tat + rule->tr_interval;
+        if (tat - now <= burst) {
+                /* a token is available */
+                cfs_spin_unlock(&svc->srv_tbf_lock);
+                return 0;
+        }
+
+        rule->tr_deferred++;
+        rule->tr_queued++;
+        cfs_atomic_inc(&rule->tr_ref);
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        req->rq_tbf_rule = rule;
+        req->rq_tbf_release = tat - burst;
+
+        /* release times mostly grow, search from the tail */
+        cfs_list_for_each_prev(pos, &svcpt->scp_tbf_deferred) {
+                tmp = cfs_list_entry(pos, struct ptlrpc_request, rq_list);
+                if (tmp->rq_tbf_release <= req->rq_tbf_release)
+                        break;
+        }
+        cfs_list_add(&req->rq_list, pos);
+        if (pos == &svcpt->scp_tbf_deferred)
+                ptlrpc_tbf_arm(svcpt, req->rq_tbf_release, now);
+
+        DEBUG_REQ(D_RPCTRACE, req, "deferred "LPU64"us by TBF rule %s",
+                  req->rq_tbf_release - now, rule->tr_name);
+        return 1;
+}
+
+/**
+ * Take deferred request \a req off the deferred list of \a svcpt.
+ * Called holding ptlrpc_service_part::scp_rq_lock, or by the last user of
+ * the service.
+ */
+void ptlrpc_tbf_undefer(struct ptlrpc_service_part *svcpt,
+                        struct ptlrpc_request *req)
+{
+        struct ptlrpc_service  *svc = svcpt->scp_service;
+        struct ptlrpc_tbf_rule *rule = req->rq_tbf_rule;
+
+        LASSERT(rule != NULL);
+
+        cfs_list_del_init(&req->rq_list);
+        req->rq_tbf_rule = NULL;
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        rule->tr_queued--;
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        ptlrpc_tbf_rule_put(rule);
+}
+
+/**
+ * Move the deferred requests of \a svcpt which are due to the NRS queue.
+ * Returns the number of requests moved.
+ */
+int ptlrpc_tbf_release(struct ptlrpc_service_part *svcpt)
+{
+        struct ptlrpc_request *req;
+        __u64                  now;
+        int                    n = 0;
+
+        svcpt->scp_tbf_check = 0;
+        if (cfs_list_empty(&svcpt->scp_tbf_deferred))
+                return 0;
+
+        now = ptlrpc_tbf_now();
+
+        ptlrpc_svcpt_rq_lock(svcpt);
+        while (!cfs_list_empty(&svcpt->scp_tbf_deferred)) {
+                req = cfs_list_entry(svcpt->scp_tbf_deferred.next,
+                                     struct ptlrpc_request, rq_list);
+                if (req->rq_tbf_release > now) {
+                        ptlrpc_tbf_arm(svcpt, req->rq_tbf_release, now);
+                        break;
+                }
+
+                ptlrpc_tbf_undefer(svcpt, req);
+                ptlrpc_nrs_enqueue(svcpt, req);
+                n++;
+        }
+        ptlrpc_svcpt_rq_unlock(svcpt);
+
+        /* the caller serves one of them, wake up others for the rest */
+        if (n > 1)
+                cfs_waitq_broadcast(&svcpt->scp_waitq);
+
+        return n;
+}
+
+#ifdef LPROCFS
+
+/**
+ * Next blank separated token of \a *str, blanks between braces don't
+ * count so that NID lists can be given as "nid={nid1 nid2}".
+ */
+static char *ptlrpc_tbf_token(char **str)
+{
+        char *s = *str;
+        char *tok;
+        int   brace = 0;
+
+        while (*s == ' ' || *s == '\t' || *s == '\n')
+                s++;
+        if (*s == '\0')
+                return NULL;
+
+        for (tok = s; *s != '\0'; s++) {
+                if (*s == '{')
+                        brace = 1;
+                else if (*s == '}')
+                        brace = 0;
+                else if (!brace && (*s == ' ' || *s == '\t' || *s == '\n'))
+                        break;
+        }
+        if (*s != '\0')
+                *s++ = '\0';
+
+        *str = s;
+        return tok;
+}
+
+/**
+ * Parse "key=value" settings of a rule from \a str into \a rule.  Only
+ * "rate" and "depth" can be given unless \a start.
+ */
+static int ptlrpc_tbf_rule_parse(struct ptlrpc_tbf_rule *rule, char *str,
+                                 int start)
+{
+        char          *tok;
+        char          *val;
+        char          *end;
+        unsigned long  num;
+        int            len;
+
+        while ((tok = ptlrpc_tbf_token(&str)) != NULL) {
+                val = strchr(tok, '=');
+                if (val == NULL)
+                        return -EINVAL;
+                *val++ = '\0';
+
+                if (strcmp(tok, "rate") == 0) {
+                        num = simple_strtoul(val, &end, 0);
+                        if (*end != '\0' || num == 0 || num > ONE_MILLION)
+                                return -EINVAL;
+                        rule->tr_rate = num;
+                } else if (strcmp(tok, "depth") == 0) {
+                        num = simple_strtoul(val, &end, 0);
+                        if (*end != '\0' || num == 0 || num > 65536)
+                                return -EINVAL;
+                        rule->tr_depth = num;
+                } else if (start && strcmp(tok, "nid") == 0 &&
+                           rule->tr_nids_str == NULL) {
+                        len = strlen(val);
+                        if (val[0] == '{') {
+                                if (len < 2 || val[len - 1] != '}')
+                                        return -EINVAL;
+                                val[len - 1] = '\0';
+                                val++;
+                                len -= 2;
+                        }
+                        if (!cfs_parse_nidlist(val, len, &rule->tr_nids))
+                                return -EINVAL;
+                        OBD_ALLOC(rule->tr_nids_str, len + 1);
+                        if (rule->tr_nids_str == NULL) {
+                                cfs_free_nidlist(&rule->tr_nids);
+                                return -ENOMEM;
+                        }
+                        memcpy(rule->tr_nids_str, val, len);
+                } else if (start && strcmp(tok, "opc") == 0) {
+                        rule->tr_opc = ll_str2opcode(val);
+                        if (rule->tr_opc < 0) {
+                                num = simple_strtoul(val, &end, 0);
+                                if (*end != '\0' || num > INT_MAX)
+                                        return -EINVAL;
+                                rule->tr_opc = num;
+                        }
+                } else if (start && strcmp(tok, "jobid") == 0) {
+                        if (strlen(val) >= LUSTRE_JOBID_SIZE)
+                                return -EINVAL;
+                        strcpy(rule->tr_jobid, val);
+                } else {
+                        return -EINVAL;
+                }
+        }
+
+        if (rule->tr_rate == 0)
+                return -EINVAL;
+        return 0;
+}
+
+static struct ptlrpc_tbf_rule *
+ptlrpc_tbf_rule_find(struct ptlrpc_service *svc, const char *name)
+{
+        struct ptlrpc_tbf_rule *rule;
+
+        cfs_list_for_each_entry(rule, &svc->srv_tbf_rules, tr_list) {
+                if (strcmp(rule->tr_name, name) == 0)
+                        return rule;
+        }
+        return NULL;
+}
+
+static int ptlrpc_tbf_rule_start(struct ptlrpc_service *svc, char *name,
+                                 char *str)
+{
+        struct ptlrpc_tbf_rule *rule;
+        int                     rc;
+
+        OBD_ALLOC_PTR(rule);
+        if (rule == NULL)
+                return -ENOMEM;
+
+        cfs_atomic_set(&rule->tr_ref, 1);
+        CFS_INIT_LIST_HEAD(&rule->tr_nids);
+        strncpy(rule->tr_name, name, sizeof(rule->tr_name) - 1);
+        rule->tr_opc = -1;
+        rule->tr_depth = PTLRPC_TBF_DEPTH_DEFAULT;
+
+        rc = ptlrpc_tbf_rule_parse(rule, str, 1);
+        if (rc != 0) {
+                ptlrpc_tbf_rule_put(rule);
+                return rc;
+        }
+        rule->tr_interval = max_t(__u64, ONE_MILLION / rule->tr_rate, 1);
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        if (ptlrpc_tbf_rule_find(svc, rule->tr_name) != NULL) {
+                cfs_spin_unlock(&svc->srv_tbf_lock);
+                ptlrpc_tbf_rule_put(rule);
+                return -EEXIST;
+        }
+        cfs_list_add_tail(&rule->tr_list, &svc->srv_tbf_rules);
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        CDEBUG(D_RPCTRACE, "%s: TBF rule %s started, %u req/s\n",
+               svc->srv_name, rule->tr_name, rule->tr_rate);
+        return 0;
+}
+
+static int ptlrpc_tbf_rule_change(struct ptlrpc_service *svc, char *name,
+                                  char *str)
+{
+        struct ptlrpc_tbf_rule *rule;
+        struct ptlrpc_tbf_rule  tmp;
+        int                     rc;
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        rule = ptlrpc_tbf_rule_find(svc, name);
+        if (rule == NULL) {
+                cfs_spin_unlock(&svc->srv_tbf_lock);
+                return -ENOENT;
+        }
+        tmp.tr_rate = rule->tr_rate;
+        tmp.tr_depth = rule->tr_depth;
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        rc = ptlrpc_tbf_rule_parse(&tmp, str, 0);
+        if (rc != 0)
+                return rc;
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        /* the rule may have been stopped meanwhile */
+        rule = ptlrpc_tbf_rule_find(svc, name);
+        if (rule != NULL) {
+                rule->tr_rate = tmp.tr_rate;
+                rule->tr_depth = tmp.tr_depth;
+                rule->tr_interval = max_t(__u64, ONE_MILLION / tmp.tr_rate,
+                                          1);
+        }
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        return rule != NULL ? 0 : -ENOENT;
+}
+
+static int ptlrpc_tbf_rule_stop(struct ptlrpc_service *svc, char *name)
+{
+        struct ptlrpc_tbf_rule *rule;
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        rule = ptlrpc_tbf_rule_find(svc, name);
+        if (rule != NULL)
+                cfs_list_del(&rule->tr_list);
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        if (rule == NULL)
+                return -ENOENT;
+
+        /* requests it deferred are still released on time */
+        ptlrpc_tbf_rule_put(rule);
+        return 0;
+}
+
+/**
+ * Handle a command written to the "tbf_rules" proc file:
+ *
+ *   start <name> [nid=<nidlist>] [opc=<opcode>] [jobid=<jobid>] rate=<n>
+ *         [depth=<n>]
+ *   change <name> [rate=<n>] [depth=<n>]
+ *   stop <name>
+ *
+ * \a cmd is modified.
+ */
+int ptlrpc_tbf_ctl(struct ptlrpc_service *svc, char *cmd)
+{
+        char *op;
+        char *name;
+
+        op = ptlrpc_tbf_token(&cmd);
+        name = ptlrpc_tbf_token(&cmd);
+        if (op == NULL || name == NULL ||
+            strlen(name) >= PTLRPC_TBF_NAME_LEN)
+                return -EINVAL;
+
+        if (strcmp(op, "start") == 0)
+                return ptlrpc_tbf_rule_start(svc, name, cmd);
+        if (strcmp(op, "change") == 0)
+                return ptlrpc_tbf_rule_change(svc, name, cmd);
+        if (strcmp(op, "stop") == 0 && ptlrpc_tbf_token(&cmd) == NULL)
+                return ptlrpc_tbf_rule_stop(svc, name);
+
+        return -EINVAL;
+}
+
+/**
+ * Print the rules of \a svc, one per line, in match order.
+ */
+int ptlrpc_tbf_rules_print(struct ptlrpc_service *svc, char *page, int count)
+{
+        struct ptlrpc_tbf_rule *rule;
+        char                    opc[16];
+        int                     rc;
+
+        rc = snprintf(page, count, "%-15s %s %s %s %s %s %s %s %s\n",
+                      "name", "{nid}", "opc", "jobid", "rate", "depth",
+                      "hits", "deferred", "queued");
+
+        cfs_spin_lock(&svc->srv_tbf_lock);
+        cfs_list_for_each_entry(rule, &svc->srv_tbf_rules, tr_list) {
+                if (rc >= count)
+                        break;
+
+                if (rule->tr_opc == -1)
+                        strcpy(opc, "*");
+                else
+                        snprintf(opc, sizeof(opc), "%d", rule->tr_opc);
+
+                rc += snprintf(page + rc, count - rc,
+                               "%-15s {%s} %s %s %u %u "LPU64" "LPU64
+                               " %d\n", rule->tr_name,
+                               rule->tr_nids_str != NULL ?
+                               rule->tr_nids_str : "*", opc,
+                               rule->tr_jobid[0] != '\0' ?
+                               rule->tr_jobid : "*",
+                               rule->tr_rate, rule->tr_depth,
+                               rule->tr_hits, rule->tr_deferred,
+                               rule->tr_queued);
+        }
+        cfs_spin_unlock(&svc->srv_tbf_lock);
+
+        return min(rc, count);
+}
+
+#endif /* LPROCFS */
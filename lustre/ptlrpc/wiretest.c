@@ -408,6 +408,10 @@ void lustre_assert_wire_constants(void)
                  (long long)(int)offsetof(struct ptlrpc_body, pb_pre_versions[4]));
         LASSERTF((int)sizeof(((struct ptlrpc_body *)0)->pb_pre_versions[4]) == 8, " found %lld\n",
                  (long long)(int)sizeof(((struct ptlrpc_body *)0)->pb_pre_versions[4]));
+        LASSERTF((int)offsetof(struct ptlrpc_body, pb_jobid) == 120, " found %lld\n",
+                 (long long)(int)offsetof(struct ptlrpc_body, pb_jobid));
+        LASSERTF((int)sizeof(((struct ptlrpc_body *)0)->pb_jobid) == 32, " found %lld\n",
+                 (long long)(int)sizeof(((struct ptlrpc_body *)0)->pb_jobid));
 
         /* Checks for struct obd_connect_data */
         LASSERTF((int)sizeof(struct obd_connect_data) == 72, " found %lld\n",
@@ -493,6 +497,7 @@ void lustre_assert_wire_constants(void)
         CLASSERT(OBD_CONNECT_VBR == 0x80000000ULL);
         CLASSERT(OBD_CONNECT_SKIP_ORPHAN == 0x400000000ULL);
         CLASSERT(OBD_CONNECT_FULL20 == 0x1000000000ULL);
+        CLASSERT(OBD_CONNECT_MULTIOBJ == 0x4000000000ULL);
 
         /* Checks for struct obdo */
         LASSERTF((int)sizeof(struct obdo) == 208, " found %lld\n",
@@ -660,10 +665,12 @@ void lustre_assert_wire_constants(void)
         CLASSERT(OBD_FL_SRVLOCK == 2048);
         CLASSERT(OBD_FL_CKSUM_CRC32 == 4096);
         CLASSERT(OBD_FL_CKSUM_ADLER == 8192);
+        CLASSERT(OBD_FL_CKSUM_CRC32C == 16384);
         CLASSERT(OBD_FL_SHRINK_GRANT == 131072);
         CLASSERT(OBD_FL_MMAP == (0x00040000));
         CLASSERT(OBD_CKSUM_CRC32 == 1);
         CLASSERT(OBD_CKSUM_ADLER == 2);
+        CLASSERT(OBD_CKSUM_CRC32C == 4);
 
         /* Checks for struct lov_mds_md_v1 */
         LASSERTF((int)sizeof(struct lov_mds_md_v1) == 32, " found %lld\n",
@@ -20,6 +20,20 @@ if [ "$SLOW" = no ]; then
     lst_LOOP=1000
 fi
 
+# concurrencies and seconds per step of test_match
+match_CONCR=${match_CONCR:-"1 16 128 1024"}
+match_DURATION=${match_DURATION:-60}
+if [ "$SLOW" = no ]; then
+    match_CONCR="1 256"
+    match_DURATION=20
+fi
+
+rails_DURATION=${rails_DURATION:-60}
+[ "$SLOW" = no ] && rails_DURATION=20
+
+socknal_DURATION=${socknal_DURATION:-30}
+[ "$SLOW" = no ] && socknal_DURATION=10
+
 smoke_DURATION=${smoke_DURATION:-1800}
 if [ "$SLOW" = no ]; then
     [ $smoke_DURATION -le 300 ] || smoke_DURATION=300
@@ -153,6 +167,162 @@ test_smoke () {
 }
 run_test smoke "lst regression test"
 
+# run a session named $1 for $2 seconds, adding to its batch one test from
+# the clients to the servers per remaining argument, e.g.
+# "--concurrency 8 brw write size=1M"
+lst_run_session () {
+    local name=$1
+    local duration=$2
+    local nc=$(echo ${lst_CLIENTS//,/ } | wc -w)
+    local ns=$(echo ${lst_SERVERS//,/ } | wc -w)
+    local t
+
+    shift 2
+    export LST_SESSION=$$
+
+    $LST new_session --timeo 100000 $name
+    $LST add_group c $(nids_list $lst_CLIENTS)
+    $LST add_group s $(nids_list $lst_SERVERS)
+    $LST add_batch b
+    for t in "$@"; do
+        $LST add_test --batch b --distribute ${nc}:${ns} --from c --to s $t
+    done
+    $LST run b
+    sleep $duration
+    lst_end_session --verbose
+}
+
+# SRPC_RDMA_PORTAL: every reply and bulk ME of lnet_selftest is posted there
+LST_RDMA_PORTAL=52
+
+# "matched scanned" match counters of the selftest RDMA portal, summed over
+# the nodes $1
+lst_rdma_match_stat () {
+    local nodes=$1
+
+    do_nodes $nodes "awk '\$1 == $LST_RDMA_PORTAL { print \$5, \$6 }' \
+                     /proc/sys/lnet/portals" |
+        awk '{ m += $(NF - 1); s += $NF } END { print m + 0, s + 0 }'
+}
+
+test_match () {
+    local clients=$lst_CLIENTS
+    local before
+    local after
+    local scan
+    local scan1=
+    local c
+
+    lst_prepare
+
+    for c in $match_CONCR; do
+        before=$(lst_rdma_match_stat $clients)
+        # the clients post one reply and one bulk ME per in-flight RPC
+        lst_run_session match $match_DURATION \
+            "--concurrency $c brw read size=4k"
+        after=$(lst_rdma_match_stat $clients)
+
+        scan=$(echo $before $after |
+               awk '{ m = $3 - $1; if (m > 0) printf "%.2f", ($4 - $2) / m }')
+        [ -n "$scan" ] || error "no match on portal $LST_RDMA_PORTAL"
+        echo "concurrency $c: $scan MEs scanned per match"
+        scan1=${scan1:-$scan}
+    done
+
+    # unique MEs are hashed: the cost must not grow with the # in-flight RPCs
+    awk "BEGIN { exit !($scan <= 2 * $scan1 + 1) }" ||
+        error "match cost grew from $scan1 to $scan MEs scanned per match"
+
+    lst_cleanup_all
+}
+run_test match "match cost stays flat as in-flight RPCs grow"
+
+test_rails () {
+    local clients=$lst_CLIENTS
+    local idle
+
+    do_nodes $clients "awk 'NR > 1' /proc/sys/lnet/rails 2>/dev/null" |
+        grep -q . || { skip_env "no multi-rail peer, see lnet peer_rails";
+                       return 0; }
+
+    lst_prepare
+    lst_run_session rails $rails_DURATION "--concurrency 8 brw write size=1M"
+
+    # every rail which is up must have carried some of the traffic to a
+    # multi-rail peer
+    idle=$(do_nodes $clients "awk 'NR > 1 { sent[\$1] += \$4 }
+        NR > 1 && \$3 != \"down\" && \$4 == 0 { idle[\$1] = idle[\$1] \" \" \$2 }
+        END { for (p in idle) if (sent[p] > 0) print p \":\" idle[p] }' \
+        /proc/sys/lnet/rails")
+    [ -z "$idle" ] || error "rails not used: $idle"
+
+    lst_cleanup_all
+}
+run_test rails "messages are spread over the rails of multi-rail peers"
+
+socknal_stat () {
+    local nodes=$1
+    local name=$2
+
+    do_nodes $nodes "awk '\$1 == \"$name\" { print \$2 }' \
+        /proc/sys/socknal/stats" | awk '{ sum += $NF } END { print sum + 0 }'
+}
+
+test_socknal () {
+    local servers=$lst_SERVERS
+    local clients=$lst_CLIENTS
+    local direct
+    local batched
+
+    do_nodes $servers "cat /proc/sys/socknal/stats" > /dev/null 2>&1 ||
+        { skip_env "no socklnd stats, not a tcp network"; return 0; }
+    do_nodes $servers "cat /proc/sys/socknal/rx_direct" | grep -q "^0$" &&
+        { skip_env "socklnd rx_direct disabled"; return 0; }
+
+    direct=$(socknal_stat $servers rx_direct_bytes)
+    batched=$(socknal_stat "$clients,$servers" tx_batched)
+
+    lst_prepare
+    lst_run_session socknal $socknal_DURATION \
+        "--concurrency 8 brw write size=1M" "--concurrency 64 ping"
+
+    # bulk payload lands in the pages straight from the socket buffers
+    [ $(socknal_stat $servers rx_direct_bytes) -gt $direct ] ||
+        error "no payload read directly into pages"
+
+    # concurrent pings queue up behind each other and go out together
+    [ $(socknal_stat "$clients,$servers" tx_batched) -gt $batched ] ||
+        error "no small message was batched"
+
+    lst_cleanup_all
+}
+run_test socknal "socklnd reads pages directly and batches small sends"
+
+test_socknal_sched () {
+    local servers=$lst_SERVERS
+    local bad
+
+    do_nodes $servers "cat /proc/sys/socknal/schedulers" > /dev/null 2>&1 ||
+        { skip_env "no socklnd schedulers, not a tcp network"; return 0; }
+
+    lst_prepare
+    lst_run_session socknal_sched $socknal_DURATION \
+        "--concurrency 16 brw read size=1M"
+
+    do_nodes $servers "cat /proc/sys/socknal/schedulers"
+
+    # every partition has its pool, and the connections are progressed
+    bad=$(do_nodes $servers "awk 'NR > 1 { if (!(\$2 in pool)) npool++;
+        pool[\$2]++; conns += \$3; passes += \$5 }
+        END { for (c = 0; c in pool; c++); if (c != npool ||
+        conns == 0 || passes == 0) print FILENAME }' \
+        /proc/sys/socknal/schedulers")
+    [ -z "$bad" ] || error "scheduler pools not used: $bad"
+
+    lst_cleanup_all
+}
+run_test socknal_sched "socklnd runs connections in per-partition scheduler pools"
+
 equals_msg `basename $0`: test complete, cleaning up
 if [ "$RESTORE_MOUNT" = yes ]; then
     setupall
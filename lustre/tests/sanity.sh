@@ -4086,7 +4086,7 @@ set_checksums()
 }
 
 export ORIG_CSUM_TYPE=""
-CKSUM_TYPES=${CKSUM_TYPES:-"crc32 adler"}
+CKSUM_TYPES=${CKSUM_TYPES:-"crc32 adler crc32c"}
 set_checksum_type()
 {
 	[ "$ORIG_CSUM_TYPE" ] || \
@@ -4250,6 +4250,22 @@ test_77j() { # bug 13805
 }
 run_test 77j "client only supporting ADLER32 ===================="
 
+test_77k() { # CRC32C bulk checksums
+	$GSS && skip "could not run with gss" && return
+	lctl get_param -n osc.*osc-[^mM]*.checksum_type | grep -q crc32c ||
+		{ skip "crc32c not supported by all OSTs" && return; }
+	[ ! -f $F77_TMP ] && setup_f77
+	set_checksums 1
+	set_checksum_type crc32c
+	dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ || error "dd error"
+	cancel_lru_locks osc
+	cmp $F77_TMP $DIR/$tfile || error "file compare failed"
+	set_checksum_type $ORIG_CSUM_TYPE
+	set_checksums 0
+	rm -f $DIR/$tfile
+}
+run_test 77k "normal read/write with crc32c checksums =========="
+
 [ "$ORIG_CSUM" ] && set_checksums $ORIG_CSUM || true
 rm -f $F77_TMP
 unset F77_TMP
@@ -7606,12 +7622,12 @@ test_215() { # for bugs 18102, 21079, 21517
 
 	# /proc/sys/lnet/routes should look like this:
 	# Routing disabled/enabled
-	# net hops state router
+	# net hops state health router
 	# where net is a string like tcp0, hops >= 0, state is up/down,
-	# router is a string like 192.168.1.1@tcp2
+	# health >= 0, router is a string like 192.168.1.1@tcp2
 	L1="^Routing (disabled|enabled)$"
-	L2="^net +hops +state +router$"
-	BR="^$NET +$N +(up|down) +$NID$"
+	L2="^net +hops +state +health +router$"
+	BR="^$NET +$N +(up|down) +$N +$NID$"
 	create_lnet_proc_files "routes"
 	check_lnet_proc_entry "routes.out" "/proc/sys/lnet/routes" "$BR" "$L1" "$L2"
 	check_lnet_proc_entry "routes.sys" "lnet.routes" "$BR" "$L1" "$L2"
@@ -7642,10 +7658,11 @@ test_215() { # for bugs 18102, 21079, 21517
 	remove_lnet_proc_files "peers"
 
 	# /proc/sys/lnet/buffers  should look like this:
-	# pages count credits min
-	# where pages >=0, count >=0, credits and min are numeric (0 or >0 or <0)
-	L1="^pages +count +credits +min$"
-	BR="^ +$N +$N +$I +$I$"
+	# cpt pages count credits min
+	# where cpt >=0, pages >=0, count >=0, credits and min are numeric
+	# (0 or >0 or <0)
+	L1="^cpt +pages +count +credits +min$"
+	BR="^ +$N +$N +$N +$I +$I$"
 	create_lnet_proc_files "buffers"
 	check_lnet_proc_entry "buffers.out" "/proc/sys/lnet/buffers" "$BR" "$L1"
 	check_lnet_proc_entry "buffers.sys" "lnet.buffers" "$BR" "$L1"
@@ -7735,6 +7752,688 @@ test_218() {
 }
 run_test 218 "parallel read and truncate should not deadlock ======================="
 
+test_219() {
+        local param="ost.OSS.ost_io"
+        local started
+        local total
+
+        started=$(do_facet ost1 "lctl get_param -n $param.threads_started")
+        [ -z "$started" ] && skip "no $param on ost1" && return 0
+
+        do_facet ost1 "lctl get_param -n $param.cpt_stats" ||
+                error "cannot read $param.cpt_stats"
+        # sum of the threads of all CPU partitions
+        total=$(do_facet ost1 "lctl get_param -n $param.cpt_stats" |
+                awk 'NR > 1 { n += $3 } END { print n + 0 }')
+        [ $total -eq $started ] ||
+                error "cpt_stats threads $total != threads_started $started"
+}
+run_test 219 "ptlrpc per-CPU-partition service stats ======================="
+
+test_220() {
+        local param="ost.OSS.ost_io.nrs_policy"
+        local pol
+
+        do_facet ost1 "lctl get_param -n $param" ||
+                { skip "no $param on ost1" && return 0; }
+
+        for pol in crr orr fifo; do
+                # switch with I/O in flight, queued requests move over
+                dd if=/dev/zero of=$DIR/$tfile-$pol bs=1M count=20 &
+                do_facet ost1 "lctl set_param $param=$pol" ||
+                        error "cannot set $param=$pol"
+                wait $! || error "dd failed under $pol"
+                do_facet ost1 "lctl get_param -n $param" |
+                        grep -q "\[$pol\]" || error "$pol is not active"
+                cancel_lru_locks osc
+                cmp $DIR/$tfile-$pol /dev/zero -n 20971520 ||
+                        error "data mismatch under $pol"
+                rm -f $DIR/$tfile-$pol
+        done
+
+        do_facet ost1 "lctl get_param -n ost.OSS.ost_io.nrs_stats"
+        do_facet ost1 "lctl set_param $param=bogus" &&
+                error "bogus policy accepted"
+        return 0
+}
+run_test 220 "ptlrpc NRS policy switch under I/O ==========================="
+
+test_221() {
+        local param="ost.OSS.ost_io.tbf_rules"
+        local start
+        local elapsed
+        local deferred
+
+        do_facet ost1 "lctl get_param -n $param" ||
+                { skip "no $param on ost1" && return 0; }
+
+        $SETSTRIPE $DIR/$tfile -i 0 -c 1 || error "setstripe failed"
+        do_facet ost1 "lctl set_param $param='start t221 opc=ost_write rate=5'" ||
+                error "cannot start TBF rule"
+        start=$(date +%s)
+        # 20 1M RPCs at 5 RPC/s take about 3s more than the burst allows
+        dd if=/dev/zero of=$DIR/$tfile bs=1M count=20 oflag=direct ||
+                { do_facet ost1 "lctl set_param $param='stop t221'";
+                  error "dd failed"; }
+        elapsed=$(($(date +%s) - start))
+        do_facet ost1 "lctl get_param -n $param"
+        deferred=$(do_facet ost1 "lctl get_param -n $param" |
+                   awk '$1 == "t221" { print $8 }')
+        do_facet ost1 "lctl set_param $param='stop t221'" ||
+                error "cannot stop TBF rule"
+
+        [ "$deferred" -gt 0 ] || error "no request was deferred"
+        [ $elapsed -ge 3 ] || error "writes took only ${elapsed}s"
+        do_facet ost1 "lctl get_param -n $param" | grep -q t221 &&
+                error "rule t221 still listed"
+        rm -f $DIR/$tfile
+}
+run_test 221 "ptlrpc TBF rate limits and defers requests ================="
+
+test_222() {
+        local old_var=$($LCTL get_param -n jobid_var)
+        local jobid=sanity222.$$
+        local stats
+
+        do_facet ost1 "lctl get_param -n obdfilter.*.job_stats" > /dev/null ||
+                { skip "no job_stats on ost1" && return 0; }
+
+        $LCTL set_param jobid_var=SANITY_JOBID || error "cannot set jobid_var"
+        do_facet ost1 "lctl set_param obdfilter.*.job_stats=clear"
+        $SETSTRIPE $DIR/$tfile -i 0 -c 1 || error "setstripe failed"
+        SANITY_JOBID=$jobid dd if=/dev/zero of=$DIR/$tfile bs=1M count=4 \
+                oflag=direct || error "dd failed"
+        $LCTL set_param jobid_var=$old_var
+
+        stats=$(do_facet ost1 "lctl get_param -n obdfilter.*.job_stats")
+        echo "$stats"
+        echo "$stats" | grep -q "job_id:.*$jobid" ||
+                error "no job_stats entry for $jobid"
+        echo "$stats" | grep -A8 "job_id:.*$jobid" |
+                grep -q "write_bytes:.*sum: *4194304" ||
+                error "write_bytes of $jobid not accounted"
+
+        do_facet ost1 "lctl set_param obdfilter.*.job_stats=$jobid" ||
+                error "cannot clear $jobid"
+        do_facet ost1 "lctl get_param -n obdfilter.*.job_stats" |
+                grep -q "job_id:.*$jobid" && error "$jobid still listed"
+        rm -f $DIR/$tfile
+}
+run_test 222 "per-job RPC statistics on OST ============================="
+
+test_223() {
+        local before
+        local after
+
+        $LCTL get_param -n ptlrpcd > /dev/null ||
+                { skip "no ptlrpcd pool stats" && return 0; }
+        $LCTL get_param -n ptlrpcd
+        [ $($LCTL get_param -n ptlrpcd | grep -c "^ptlrpcd-brw_") -ge 1 ] ||
+                error "no ptlrpcd-brw thread running"
+
+        before=$($LCTL get_param -n ptlrpcd | awk 'NR > 1 { n += $5 }
+                                                   END { print n + 0 }')
+        dd if=/dev/zero of=$DIR/$tfile bs=1M count=16 || error "dd failed"
+        cancel_lru_locks osc
+        after=$($LCTL get_param -n ptlrpcd | awk 'NR > 1 { n += $5 }
+                                                  END { print n + 0 }')
+        [ $after -gt $before ] ||
+                error "no BRW RPC completed by the pool ($before -> $after)"
+        rm -f $DIR/$tfile
+}
+run_test 223 "ptlrpcd-brw pool handles async writes ===================="
+
+test_224() {
+        local proc_osc0="osc.${FSNAME}-OST0000-osc-[^MDT]*"
+        local pagesz=$(page_size)
+        local ppr=$($LCTL get_param -n $proc_osc0/max_pages_per_rpc)
+        local chunk=$((pagesz * 16))
+        local i
+
+        $SETSTRIPE -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+        cancel_lru_locks osc
+        $LCTL set_param $proc_osc0/rpc_stats 0
+
+        # dirty one RPC worth of pages back to front, the extent cache has
+        # to put them back in order for a single full-sized RPC
+        for ((i = ppr / 16 - 1; i >= 0; i--)); do
+                dd if=/dev/zero of=$DIR/$tfile bs=$chunk seek=$i count=1 \
+                        conv=notrunc 2>/dev/null || error "dd failed"
+        done
+        sync
+        $LCTL get_param $proc_osc0/rpc_stats
+
+        $LCTL get_param $proc_osc0/rpc_stats |
+                while read PPR RRPC RPCT RCUM BAR WRPC WPCT WCUM; do
+                        [ "$PPR" != "$ppr:" ] && continue
+                        [ $WPCT -lt 100 ] &&
+                                error "only $WPCT% of writes were $ppr pages"
+                        break # we only want the "pages per rpc" stat
+                done
+        rm -f $DIR/$tfile
+}
+run_test 224 "reverse order writes make full-sized RPCs ================"
+
+test_225() {
+        local proc_osc0="osc.${FSNAME}-OST0000-osc-[^MDT]*"
+        local multi
+        local i
+
+        $LCTL get_param -n $proc_osc0/connect_flags | grep -q multi_obj_brw ||
+                { skip "OST does not support multi-object writes" && return 0; }
+
+        mkdir -p $DIR/$tdir
+        $SETSTRIPE -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+        cancel_lru_locks osc
+        $LCTL set_param $proc_osc0/rpc_stats 0
+
+        # every file gets its own content, so pages mixed up between the
+        # objects of one RPC are caught below
+        mkdir -p $TMP/$tdir
+        for ((i = 0; i < 64; i++)); do
+                yes "$tfile $i" | head -c 4096 > $TMP/$tdir/f$i
+        done
+
+        # small files are each too small for an RPC of their own, their
+        # pages have to share write RPCs
+        for ((i = 0; i < 64; i++)); do
+                dd if=$TMP/$tdir/f$i of=$DIR/$tdir/f$i bs=4k count=1 \
+                        2>/dev/null || error "dd failed"
+        done
+        sync
+        $LCTL get_param $proc_osc0/rpc_stats
+
+        multi=$($LCTL get_param -n $proc_osc0/rpc_stats |
+                awk '/^objects per rpc/ { t = 1; next }
+                     t && /^[0-9]+:/ { if ($1 + 0 > 1) n += $2 }
+                     END { print n + 0 }')
+        [ $multi -gt 0 ] || error "no write RPC carried several objects"
+
+        cancel_lru_locks osc
+        for ((i = 0; i < 64; i++)); do
+                cmp -s $TMP/$tdir/f$i $DIR/$tdir/f$i ||
+                        error "$DIR/$tdir/f$i has bad data"
+        done
+        rm -rf $DIR/$tdir $TMP/$tdir
+}
+run_test 225 "small files share multi-object write RPCs ================"
+
+test_226() {
+        local threads
+        local before
+        local after
+        local i
+
+        threads=$(do_facet ost1 "ps -e | grep -c ll_ost_cmt")
+        [ $threads -gt 0 ] ||
+                { skip "OSS commits writes in its I/O threads" && return 0; }
+
+        mkdir -p $DIR/$tdir
+        $SETSTRIPE -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+        dd if=/dev/urandom of=$TMP/$tfile bs=1M count=4 ||
+                error "dd to $TMP/$tfile failed"
+
+        before=$(do_facet ost1 $LCTL get_param -n ost.OSS.commit_handoffs)
+
+        # enough concurrent 1MB writes for bulk transfers to overlap commits
+        for ((i = 0; i < 16; i++)); do
+                dd if=$TMP/$tfile of=$DIR/$tdir/f$i bs=1M oflag=direct \
+                        2>/dev/null &
+        done
+        wait
+        sync
+
+        after=$(do_facet ost1 $LCTL get_param -n ost.OSS.commit_handoffs)
+        echo "commits handed to the commit threads: $((after - before))"
+        [ $after -gt $before ] ||
+                error "no write was committed by a commit thread"
+
+        cancel_lru_locks osc
+        for ((i = 0; i < 16; i++)); do
+                cmp $TMP/$tfile $DIR/$tdir/f$i ||
+                        error "$DIR/$tdir/f$i differs"
+        done
+        rm -rf $DIR/$tdir $TMP/$tfile
+}
+run_test 226 "pipelined OST write commits keep data intact ============"
+
+test_227() {
+        local stats=/proc/sys/lnet/stats
+        local cpt_stats=/proc/sys/lnet/cpt_stats
+        local sends
+        local recvs
+        local cpt_sends
+        local cpt_recvs
+
+        [ -r $cpt_stats ] ||
+                { skip "no per-CPT LNet counters" && return 0; }
+
+        dd if=/dev/zero of=$DIR/$tfile bs=1M count=4 || error "dd failed"
+        cancel_lru_locks osc
+        cat $DIR/$tfile > /dev/null || error "read $DIR/$tfile failed"
+
+        # the global counters are the sum of the per-CPT ones, which are
+        # read later and can only have grown since
+        sends=$(awk '{ print $4 }' $stats)
+        recvs=$(awk '{ print $5 }' $stats)
+        cpt_sends=$(awk 'NR > 1 { n += $4 } END { print n }' $cpt_stats)
+        cpt_recvs=$(awk 'NR > 1 { n += $5 } END { print n }' $cpt_stats)
+        echo "sends $sends/$cpt_sends recvs $recvs/$cpt_recvs"
+        [ $cpt_sends -ge $sends ] || error "CPT sends $cpt_sends < $sends"
+        [ $cpt_recvs -ge $recvs ] || error "CPT recvs $cpt_recvs < $recvs"
+        [ $sends -gt 0 ] || error "no LNet sends counted"
+        rm -f $DIR/$tfile
+}
+run_test 227 "LNet per-CPT counters add up to the global ones ======"
+
+# total number of router buffers of each size, "<tiny> <small> <large>"
+lnet_rtrbufs() {
+        awk 'NR > 1 { n[$2] += $3 } END {
+                for (p in n) print p, n[p] }' /proc/sys/lnet/buffers |
+                sort -n | awk '{ printf "%s%d", (NR > 1 ? " " : ""), $2 }'
+}
+
+test_228() {
+        local buffers=/proc/sys/lnet/buffers
+        local ncpt
+        local old
+        local new
+        local want
+        local i
+
+        grep -q "^Routing enabled" /proc/sys/lnet/routes ||
+                { skip "not an LNet router" && return 0; }
+
+        ncpt=$(awk 'NR > 1 { print $1 }' $buffers | sort -u | wc -l)
+        old=$(lnet_rtrbufs)
+        new=$(echo $old | awk '{ print $1 * 2, $2 * 2, $3 * 2 }')
+        # the buffers are shared evenly between the CPU partitions
+        want=$(echo $new | awk -v ncpt=$ncpt '{
+                for (i = 1; i <= NF; i++)
+                        printf "%s%d", (i > 1 ? " " : ""),
+                               (int($i / ncpt) > 0 ? int($i / ncpt) : 1) * ncpt
+                }')
+        echo "router buffers $old -> $want over $ncpt partitions"
+
+        echo "$new" > $buffers || error "cannot resize router buffers"
+        # the router checker applies the new sizes within a second
+        for i in $(seq 10); do
+                [ "$(lnet_rtrbufs)" = "$want" ] && break
+                sleep 1
+        done
+        cat $buffers
+        [ "$(lnet_rtrbufs)" = "$want" ] ||
+                error "router buffers $(lnet_rtrbufs), expected $want"
+
+        echo "0 0 0" > $buffers 2>/dev/null &&
+                error "empty router buffer pools accepted"
+        echo "$old" > $buffers || error "cannot restore router buffers"
+}
+run_test 228 "LNet router buffer pools resize through /proc ========"
+
+test_229() {
+        local routes=/proc/sys/lnet/routes
+        local nid=$($LCTL get_param -n osc.*OST0000*.ost_conn_uuid |
+                    head -1)
+        local net=${nid#*@}
+        local gw
+        local health
+        local other
+
+        gw=$(awk -v net=$net 'NR > 2 && $1 == net { print $5; exit }' $routes)
+        [ -n "$gw" ] || { skip "OST0000 ($nid) is not routed" && return 0; }
+        other=$(awk -v net=$net -v gw=$gw \
+                'NR > 2 && $1 == net && $5 != gw { print $5; exit }' $routes)
+        cat $routes
+
+        # each send through $gw fails: health halves per failure
+        $LCTL fail $gw 2
+        $LCTL ping $nid 2
+        $LCTL ping $nid 2
+        health=$(awk -v net=$net -v gw=$gw \
+                 'NR > 2 && $1 == net && $5 == gw { print $4 }' $routes)
+        $LCTL fail $gw 0
+        cat $routes
+        [ -n "$health" -a "$health" -lt 500 ] ||
+                error "route via $gw health $health after 2 failures"
+
+        if [ -z "$other" ]; then
+                echo "only one route to $net, not checking ranking"
+                return 0
+        fi
+
+        # $gw is sick now, so traffic must take $other while $gw still fails
+        $LCTL fail $gw
+        $LCTL ping $nid 2
+        local rc=$?
+        $LCTL fail $gw 0
+        [ $rc -eq 0 ] || error "ping $nid via $other failed: $rc"
+}
+run_test 229 "LNet route health drops on failures, sick routes rank last"
+
+# aggregate IOC_MDC_LOOKUP rate of $1 statmany processes over $2 files
+statmany_rate() {
+        local nthr=$1
+        local nfiles=$2
+        local i
+
+        for i in $(seq $nthr); do
+                statmany -l -5 $DIR/$tdir/f $nfiles > $TMP/$tfile.$i &
+        done
+        wait
+        for i in $(seq $nthr); do
+                awk '/^total:/ { print int($(NF - 1)) }' $TMP/$tfile.$i
+        done | awk '{ sum += $1 } END { print sum + 0 }'
+        rm -f $TMP/$tfile.*
+}
+
+# sum of field $1 of the MDT site_stats: 4 created, 5 cache_hit, 6 cache_miss,
+# 9 lru_purged
+mdt_site_stat() {
+        do_facet $SINGLEMDS $LCTL get_param -n mdt.*.site_stats |
+                awk '{ sum += $'$1' } END { print sum + 0 }'
+}
+
+# look up $1 files with 1, 2, 4... statmany processes, up to 16 or twice
+# the CPUs, and print the lookup rate of each run
+statmany_threads() {
+        local nfiles=$1
+        local maxthr=$(($(getconf _NPROCESSORS_ONLN) * 2))
+        local nthr
+        local rate
+
+        [ $maxthr -gt 16 ] && maxthr=16
+        for nthr in 1 2 4 8 16; do
+                [ $nthr -gt $maxthr ] && break
+                rate=$(statmany_rate $nthr $nfiles)
+                echo "$nthr threads: $rate lookups/s"
+                [ $rate -gt 0 ] || error "no lookup with $nthr threads"
+        done
+}
+
+test_230() {
+        local nfiles=10
+        local hit
+        local miss
+
+        which statmany > /dev/null 2>&1 ||
+                { skip "no statmany" && return 0; }
+
+        mkdir -p $DIR/$tdir
+        createmany -o $DIR/$tdir/f $nfiles || error "createmany failed"
+        # every lookup is an MDS getattr: a lu_site lookup of the busy
+        # directory and of the file, and a ldlm resource lookup of the
+        # directory lock, all hitting the same hash chains
+        hit=$(mdt_site_stat 5)
+        miss=$(mdt_site_stat 6)
+        statmany_threads $nfiles
+        hit=$(($(mdt_site_stat 5) - hit))
+        miss=$(($(mdt_site_stat 6) - miss))
+        echo "$hit cache hits, $miss misses"
+
+        # the hot objects stay cached, however many threads look them up
+        [ $hit -gt 0 ] || error "no MDT cache hit"
+        [ $miss -le $nfiles ] ||
+                error "$miss MDT cache misses looking up $nfiles hot files"
+        unlinkmany $DIR/$tdir/f $nfiles || error "unlinkmany failed"
+}
+run_test 230 "hash lookup throughput vs. threads on hot MDS objects"
+
+test_231() {
+        local param=/proc/sys/lnet/debug_deferred
+        local records=/proc/sys/lnet/debug_deferred_records
+        local old
+        local nrec
+        local log=$TMP/$tfile.dk
+
+        [ -f $param ] || { skip "no deferred debug records" && return 0; }
+        old=$(cat $param)
+
+        echo 1 > $param
+        $LCTL clear
+        nrec=$(cat $records)
+        touch $DIR/$tfile || error "touch failed"
+        stat $DIR/$tfile > /dev/null || error "stat failed"
+        rm -f $DIR/$tfile || error "rm failed"
+        nrec=$(($(cat $records) - nrec))
+        $LCTL dk $log > /dev/null
+        echo $old > $param
+
+        echo "$nrec records deferred"
+        [ $nrec -gt 0 ] || error "no debug record was deferred"
+
+        # names are "%.*s" and "%s" arguments, formatted at dump time
+        grep -q "VFS Op:name=$tfile," $log ||
+                error "no formatted VFS Op record for $tfile in $log"
+        rm -f $log
+}
+run_test 231 "debug log records formatted when dumped"
+
+# total workitems run by all schedulers, from /proc/sys/lnet/workitem_stats
+wi_total_run() {
+        awk 'NR > 1 { sum += $6 } END { print sum + 0 }' \
+                /proc/sys/lnet/workitem_stats
+}
+
+test_232() {
+        local stats=/proc/sys/lnet/workitem_stats
+        local before
+        local after
+
+        [ -f $stats ] || { skip "no workitem scheduler stats" && return 0; }
+        cat $stats
+
+        # a scheduler per CPU partition, plus the serial one
+        [ $(awk 'NR > 1' $stats | wc -l) -ge 2 ] ||
+                error "expected at least 2 workitem schedulers"
+
+        # ldlm pools are recalculated by a workitem every second
+        before=$(wi_total_run)
+        sleep 3
+        after=$(wi_total_run)
+        cat $stats
+        [ $after -gt $before ] ||
+                error "no workitems ran in 3s ($before -> $after)"
+}
+run_test 232 "ldlm background work runs on workitem schedulers"
+
+test_233() {
+        local param=/sys/module/obdclass/parameters/lu_cache_nr
+        local nfiles=2000
+        local old
+        local miss
+        local purged
+
+        which statmany > /dev/null 2>&1 ||
+                { skip "no statmany" && return 0; }
+        do_facet $SINGLEMDS "test -f $param" ||
+                { skip "no lu_cache_nr on $SINGLEMDS" && return 0; }
+
+        mkdir -p $DIR/$tdir
+        createmany -o $DIR/$tdir/f $nfiles || error "createmany failed"
+        # keep fewer objects cached than files looked up, so that
+        # lu_object_find() and lu_object_put() cycles churn the cache and
+        # the background purge runs all the time
+        old=$(do_facet $SINGLEMDS "cat $param")
+        do_facet $SINGLEMDS "echo $((nfiles / 4)) > $param"
+        miss=$(mdt_site_stat 6)
+        purged=$(mdt_site_stat 9)
+        statmany_threads $nfiles
+        miss=$(($(mdt_site_stat 6) - miss))
+        purged=$(($(mdt_site_stat 9) - purged))
+        do_facet $SINGLEMDS "echo $old > $param"
+        echo "$miss cache misses, $purged objects purged"
+        do_facet $SINGLEMDS $LCTL get_param mdt.*.site_stats
+
+        # purged objects were looked up again and had to be reloaded
+        [ $purged -gt 0 ] || error "no object purged from the MDT cache"
+        [ $miss -gt 0 ] || error "no MDT cache miss after purging"
+        unlinkmany $DIR/$tdir/f $nfiles || error "unlinkmany failed"
+}
+run_test 233 "lu_site cache churn throughput vs. threads"
+
+# samples of counter $1 of the lu_context_stats of $SINGLEMDS
+lu_context_stat() {
+        do_facet $SINGLEMDS $LCTL get_param -n lu_context_stats |
+                awk '$1 == "'$1'" { n = $2 } END { print n + 0 }'
+}
+
+test_234() {
+        local nfiles=200
+        local init
+        local reset
+
+        do_facet $SINGLEMDS $LCTL get_param -n lu_context_stats \
+                > /dev/null 2>&1 ||
+                { skip "no lu_context_stats" && return 0; }
+
+        mkdir -p $DIR/$tdir
+        createmany -o $DIR/$tdir/f $nfiles || error "createmany failed"
+        # let the MDS threads create their session values
+        cancel_lru_locks mdc
+        ls -l $DIR/$tdir > /dev/null || error "ls failed"
+        cancel_lru_locks mdc
+
+        init=$(lu_context_stat value_init)
+        reset=$(lu_context_stat value_reset)
+        ls -l $DIR/$tdir > /dev/null || error "ls failed"
+        init=$(($(lu_context_stat value_init) - init))
+        reset=$(($(lu_context_stat value_reset) - reset))
+        echo "$nfiles getattrs: $init key values created, $reset reset"
+        do_facet $SINGLEMDS $LCTL get_param lu_context_stats
+
+        # session values used to be created for every request
+        [ $init -lt $((nfiles / 2)) ] ||
+                error "$init key values created for $nfiles getattrs"
+        [ $reset -gt 0 ] || error "no session value was reused"
+        unlinkmany $DIR/$tdir/f $nfiles || error "unlinkmany failed"
+}
+run_test 234 "request sessions reuse lu_context key values"
+
+test_235() {
+        local size=64
+        local sum
+        local hits
+        local gang
+
+        $SETSTRIPE -c -1 $DIR/$tfile || error "setstripe failed"
+        dd if=/dev/urandom of=$DIR/$tfile bs=1M count=$size ||
+                error "dd write failed"
+        sum=$(md5sum < $DIR/$tfile)
+        cancel_lru_locks osc
+        $LCTL set_param -n llite.*.read_ahead_stats 0
+
+        # the pages of a sequential read are created in batches by
+        # read-ahead, dd reports the throughput
+        dd if=$DIR/$tfile of=/dev/null bs=1M || error "dd read failed"
+        hits=$($LCTL get_param -n llite.*.read_ahead_stats |
+               get_named_value 'hits' | awk '{ print $1 }' | calc_total)
+        gang=$($LCTL get_param -n llite.*.read_ahead_stats |
+               get_named_value 'pages created in batches' |
+               awk '{ print $1 }' | calc_total)
+        $LCTL get_param llite.*.read_ahead_stats
+        [ $hits -gt 0 ] || error "no read-ahead hits"
+        [ $gang -gt 0 ] || error "no read-ahead page created in a batch"
+
+        cancel_lru_locks osc
+        [ "$(md5sum < $DIR/$tfile)" = "$sum" ] ||
+                error "data read through read-ahead differ"
+        rm -f $DIR/$tfile
+}
+run_test 235 "read-ahead creates cl_pages in batches"
+
+# write $2 MB to $DIR/$tfile with llite extent_kb set to $1, print the write
+# pages queued and their average queueing cost in usec per MB
+osc_write_queue_stats() {
+        local extent_kb=$1
+        local size=$2
+
+        $LCTL set_param -n llite.*.extent_kb $extent_kb
+        $LCTL set_param -n osc.*.rpc_stats 0
+        dd if=/dev/zero of=$DIR/$tfile bs=1M count=$size conv=notrunc \
+                2> /dev/null || error "dd write failed"
+        sync
+        $LCTL get_param -n osc.*.rpc_stats |
+                awk '/write queue pages:/ { pages += $4 }
+                     /write queue usec\/MB:/ { sum += $4; n++ }
+                     END { print pages + 0, n ? int(sum / n) : 0 }'
+}
+
+test_236() {
+        local size=256
+        local pages=$((size * 1048576 / $(getconf PAGE_SIZE)))
+        local old
+        local base
+        local stats
+        local sum
+
+        old=$($LCTL get_param -n llite.*.extent_kb 2> /dev/null | head -1)
+        [ -n "$old" ] || { skip "no llite extent_kb" && return 0; }
+
+        $SETSTRIPE -c -1 $DIR/$tfile || error "setstripe failed"
+        base=($(osc_write_queue_stats 0 $size))
+        stats=($(osc_write_queue_stats 1024 $size))
+        echo "per-page: ${base[0]} pages, ${base[1]} usec/MB;" \
+             "1MB extents: ${stats[0]} pages, ${stats[1]} usec/MB"
+        [ ${base[0]} -ge $pages ] ||
+                error "${base[0]} pages accounted per page for ${size}MB"
+        [ ${stats[0]} -ge $pages ] ||
+                error "${stats[0]} pages accounted in extent mode for ${size}MB"
+        [ ${stats[1]} -le $((base[1] * 2 + 1)) ] ||
+                error "extent mode costs ${stats[1]} usec/MB," \
+                      "per-page mode ${base[1]}"
+
+        # data written in extent mode must be the same
+        dd if=/dev/urandom of=$TMP/$tfile bs=1M count=4 ||
+                error "dd urandom failed"
+        sum=$(md5sum < $TMP/$tfile)
+        dd if=$TMP/$tfile of=$DIR/$tfile bs=4k || error "dd copy failed"
+        $LCTL set_param -n llite.*.extent_kb $old
+        cancel_lru_locks osc
+        [ "$(head -c 4M $DIR/$tfile | md5sum)" = "$sum" ] ||
+                error "data written in extent mode differ"
+        rm -f $DIR/$tfile $TMP/$tfile
+}
+run_test 236 "osc extent mode write queue cost"
+
+oi_cache_stat() {
+        do_facet $SINGLEMDS $LCTL get_param -n osd.*MDT0000.oi_cache_stats |
+                awk '/^'$1' / { print $2 }'
+}
+
+test_237() {
+        local nr=200
+        local entries
+        local hits
+
+        do_facet $SINGLEMDS $LCTL get_param -n osd.*MDT0000.oi_cache_stats \
+                > /dev/null 2>&1 ||
+                { skip "no oi_cache_stats on MDS" && return 0; }
+
+        mkdir -p $DIR/$tdir || error "mkdir failed"
+        createmany -o $DIR/$tdir/f $nr || error "createmany failed"
+        ls -l $DIR/$tdir > /dev/null || error "ls failed"
+
+        # the most recently used entries are saved at umount and preloaded
+        # by the MDS at mount
+        fail $SINGLEMDS
+        wait_update $(facet_active_host $SINGLEMDS) \
+                "[ \$($LCTL get_param -n osd.*MDT0000.oi_cache_entries) \
+                   -ge $nr ] && echo preloaded" preloaded 30
+        entries=$(do_facet $SINGLEMDS $LCTL get_param -n \
+                  osd.*MDT0000.oi_cache_entries)
+        echo "$entries OI cache entries after remount"
+        [ ${entries:-0} -ge $nr ] || error "only $entries entries preloaded"
+
+        cancel_lru_locks mdc
+        ls -l $DIR/$tdir > /dev/null || error "ls after remount failed"
+        hits=$(oi_cache_stat hit)
+        echo "${hits:-0} OI cache hits after remount"
+        [ ${hits:-0} -gt 0 ] || error "no OI cache hits after remount"
+        rm -rf $DIR/$tdir
+}
+run_test 237 "OI cache is preloaded at MDS mount"
+
 #
 # tests that do cleanup/setup should be run at the end
 #
@@ -173,6 +173,7 @@ check_ptlrpc_body(void)
         CHECK_MEMBER(ptlrpc_body, pb_limit);
         CHECK_CVALUE(PTLRPC_NUM_VERSIONS);
         CHECK_MEMBER(ptlrpc_body, pb_pre_versions[PTLRPC_NUM_VERSIONS]);
+        CHECK_MEMBER(ptlrpc_body, pb_jobid);
 }
 
 static void check_obd_connect_data(void)
@@ -222,6 +223,7 @@ static void check_obd_connect_data(void)
         CHECK_CDEFINE(OBD_CONNECT_VBR);
         CHECK_CDEFINE(OBD_CONNECT_SKIP_ORPHAN);
         CHECK_CDEFINE(OBD_CONNECT_FULL20);
+        CHECK_CDEFINE(OBD_CONNECT_MULTIOBJ);
 }
 
 static void
@@ -307,10 +309,12 @@ check_obdo(void)
         CHECK_CVALUE(OBD_FL_SRVLOCK);
         CHECK_CVALUE(OBD_FL_CKSUM_CRC32);
         CHECK_CVALUE(OBD_FL_CKSUM_ADLER);
+        CHECK_CVALUE(OBD_FL_CKSUM_CRC32C);
         CHECK_CVALUE(OBD_FL_SHRINK_GRANT);
         CHECK_CVALUE(OBD_FL_MMAP);
         CHECK_CVALUE(OBD_CKSUM_CRC32);
         CHECK_CVALUE(OBD_CKSUM_ADLER);
+        CHECK_CVALUE(OBD_CKSUM_CRC32C);
 }
 
 static void
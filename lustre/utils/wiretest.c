@@ -405,6 +405,10 @@ void lustre_assert_wire_constants(void)
                  (long long)(int)offsetof(struct ptlrpc_body, pb_pre_versions[4]));
         LASSERTF((int)sizeof(((struct ptlrpc_body *)0)->pb_pre_versions[4]) == 8, " found %lld\n",
                  (long long)(int)sizeof(((struct ptlrpc_body *)0)->pb_pre_versions[4]));
+        LASSERTF((int)offsetof(struct ptlrpc_body, pb_jobid) == 120, " found %lld\n",
+                 (long long)(int)offsetof(struct ptlrpc_body, pb_jobid));
+        LASSERTF((int)sizeof(((struct ptlrpc_body *)0)->pb_jobid) == 32, " found %lld\n",
+                 (long long)(int)sizeof(((struct ptlrpc_body *)0)->pb_jobid));
 
         /* Checks for struct obd_connect_data */
         LASSERTF((int)sizeof(struct obd_connect_data) == 72, " found %lld\n",